@@ -7,6 +7,7 @@
 #include "mqtt_client.h"
 #include "secrets.h"  // Keeps your credentials secure
 #include "mqtt_config.h"  // Includes necessary MQTT configurations
+#include "sensor_aggregate.h"  // Report-by-exception, also built by esp-idf/esp32-s3-wroom-1 from this folder
 
 static esp_mqtt_client_handle_t client;
 Adafruit_BME280 bme; // BME280 sensor instance
@@ -15,6 +16,15 @@ Adafruit_BME280 bme; // BME280 sensor instance
 #define SDA_PIN 18
 #define SCL_PIN 17
 
+/* Report-by-exception: a reading is published only when a value left its deadband
+   around the last published one, or at least every HEARTBEAT_MS */
+#define DEADBAND_TEMPERATURE 0.2f  // °C
+#define DEADBAND_HUMIDITY 1.0f     // %
+#define DEADBAND_PRESSURE 0.5f     // hPa
+#define HEARTBEAT_MS 1800000       // 30 min
+
+static sensor_aggregate_t aggregate;
+
 // WiFi Event Handler
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                int32_t event_id, void* event_data) {
@@ -80,15 +90,27 @@ void initBME280() {
     Serial.println("\nBME280 sensor found!");
 }
 
-// Publish Sensor Data to MQTT
+// Publish Sensor Data to MQTT, only when it changed (or as a heartbeat)
 void publishSensorData() {
     float temperature = bme.readTemperature();
     float humidity = bme.readHumidity();
     float pressure = bme.readPressure() / 100.0F; // Convert to hPa
 
-    char payload[100];
-    snprintf(payload, sizeof(payload), "{\"temp\": %.2f, \"humidity\": %.2f, \"pressure\": %.2f}", 
-             temperature, humidity, pressure);
+    const float values[3] = {temperature, humidity, pressure};
+    sensor_report_t report;
+    if (sensor_aggregate_add(&aggregate, millis(), values, &report) == SENSOR_REPORT_NONE) {
+        return; // within the deadbands of the last published reading
+    }
+
+    // Last reading, plus min/max/mean of the readings since the previous publish
+    char payload[256];
+    snprintf(payload, sizeof(payload),
+             "{\"temp\": %.2f, \"humidity\": %.2f, \"pressure\": %.2f, \"samples\": %lu, "
+             "\"min\": [%.2f, %.2f, %.2f], \"max\": [%.2f, %.2f, %.2f], \"mean\": [%.2f, %.2f, %.2f]}",
+             temperature, humidity, pressure, (unsigned long)report.samples,
+             report.field[0].min, report.field[1].min, report.field[2].min,
+             report.field[0].max, report.field[1].max, report.field[2].max,
+             report.field[0].mean, report.field[1].mean, report.field[2].mean);
     
     // Print to Serial Monitor for Debugging
     Serial.print("Payload: ");
@@ -102,11 +124,14 @@ void setup() {
     initWiFi();
     initMQTT();
     initBME280();
+
+    const float deadband[3] = {DEADBAND_TEMPERATURE, DEADBAND_HUMIDITY, DEADBAND_PRESSURE};
+    sensor_aggregate_init(&aggregate, 3, deadband, HEARTBEAT_MS);
 }
 
 void loop() {
     static unsigned long lastPublishTime = 0;
-    if (millis() - lastPublishTime > 30000) {  // Publish every 5 min
+    if (millis() - lastPublishTime > 30000) {  // Sample every 30 s, published on change
         publishSensorData();
         lastPublishTime = millis();
     }
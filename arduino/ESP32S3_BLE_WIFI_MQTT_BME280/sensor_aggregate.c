@@ -0,0 +1,78 @@
+/**
+ * @file sensor_aggregate.c
+ * @brief Report-by-exception for periodic sensor readings
+ */
+
+#include <math.h>
+#include <string.h>
+#include "sensor_aggregate.h"
+
+static void window_reset(sensor_aggregate_t *agg) {
+    agg->samples = 0;
+    for (int f = 0; f < agg->fields; f++) {
+        agg->sum[f] = 0;
+    }
+}
+
+void sensor_aggregate_init(sensor_aggregate_t *agg, int fields, const float *deadband, uint32_t max_silence_ms) {
+    memset(agg, 0, sizeof(*agg));
+    agg->fields = fields > SENSOR_AGGREGATE_MAX_FIELDS ? SENSOR_AGGREGATE_MAX_FIELDS : fields;
+    for (int f = 0; f < agg->fields; f++) {
+        agg->deadband[f] = deadband[f];
+    }
+    agg->max_silence_ms = max_silence_ms;
+}
+
+sensor_report_reason_t sensor_aggregate_add(sensor_aggregate_t *agg, int64_t now_ms, const float *values,
+                                            sensor_report_t *report) {
+    if (agg->samples == 0) {
+        agg->start_ms = now_ms;
+        for (int f = 0; f < agg->fields; f++) {
+            agg->min[f] = values[f];
+            agg->max[f] = values[f];
+        }
+    }
+    agg->samples++;
+    agg->total_samples++;
+    for (int f = 0; f < agg->fields; f++) {
+        agg->min[f] = fminf(agg->min[f], values[f]);
+        agg->max[f] = fmaxf(agg->max[f], values[f]);
+        agg->sum[f] += values[f];
+    }
+
+    sensor_report_reason_t reason = SENSOR_REPORT_NONE;
+    if (!agg->reported) {
+        reason = SENSOR_REPORT_FIRST;
+    } else {
+        for (int f = 0; f < agg->fields; f++) {
+            if (fabsf(values[f] - agg->reported_value[f]) > agg->deadband[f]) {
+                reason = SENSOR_REPORT_CHANGE;
+                break;
+            }
+        }
+        if (reason == SENSOR_REPORT_NONE && now_ms - agg->reported_ms >= (int64_t)agg->max_silence_ms) {
+            reason = SENSOR_REPORT_HEARTBEAT;
+            agg->heartbeats++;
+        }
+    }
+    if (reason == SENSOR_REPORT_NONE) {
+        return reason;
+    }
+
+    report->reason = reason;
+    report->start_ms = agg->start_ms;
+    report->end_ms = now_ms;
+    report->samples = agg->samples;
+    for (int f = 0; f < agg->fields; f++) {
+        report->field[f].min = agg->min[f];
+        report->field[f].max = agg->max[f];
+        report->field[f].mean = (float)(agg->sum[f] / agg->samples);
+        report->field[f].last = values[f];
+        agg->reported_value[f] = values[f];
+    }
+    agg->reported = true;
+    agg->reported_ms = now_ms;
+    agg->reports++;
+    window_reset(agg);
+    return reason;
+}
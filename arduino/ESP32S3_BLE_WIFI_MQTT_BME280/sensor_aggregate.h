@@ -0,0 +1,96 @@
+/**
+ * @file sensor_aggregate.h
+ * @brief Report-by-exception for periodic sensor readings
+ *
+ * Every reading is added to the current window (min/max/mean/last per
+ * field). A report closes the window when a field moved beyond its
+ * deadband from the last reported value, or as a heartbeat when nothing
+ * was reported for max_silence_ms. Between reports every reading stayed
+ * within the deadband of the last reported one, so holding the reported
+ * value reconstructs the series with an error of at most the deadband.
+ *
+ * No ESP-IDF dependencies: the one copy lives in this Arduino sketch, the
+ * esp32-s3-wroom-1 firmware and the cloud-tier host test build it from here.
+ */
+
+#ifndef SENSOR_AGGREGATE_H
+#define SENSOR_AGGREGATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSOR_AGGREGATE_MAX_FIELDS 4
+
+typedef enum {
+    SENSOR_REPORT_NONE = 0,
+    SENSOR_REPORT_FIRST,     // first reading after init
+    SENSOR_REPORT_CHANGE,    // a field left its deadband
+    SENSOR_REPORT_HEARTBEAT, // nothing reported for max_silence_ms
+} sensor_report_reason_t;
+
+typedef struct {
+    float min;
+    float max;
+    float mean;
+    float last;
+} sensor_field_summary_t;
+
+typedef struct {
+    sensor_report_reason_t reason;
+    int64_t start_ms;   // first reading of the window
+    int64_t end_ms;     // last reading (the one that triggered the report)
+    uint32_t samples;   // readings in the window
+    sensor_field_summary_t field[SENSOR_AGGREGATE_MAX_FIELDS];
+} sensor_report_t;
+
+typedef struct {
+    int fields;
+    float deadband[SENSOR_AGGREGATE_MAX_FIELDS];
+    uint32_t max_silence_ms;
+
+    // Current window
+    int64_t start_ms;
+    uint32_t samples;
+    float min[SENSOR_AGGREGATE_MAX_FIELDS];
+    float max[SENSOR_AGGREGATE_MAX_FIELDS];
+    double sum[SENSOR_AGGREGATE_MAX_FIELDS];
+
+    // Last report
+    bool reported;
+    int64_t reported_ms;
+    float reported_value[SENSOR_AGGREGATE_MAX_FIELDS];
+
+    // Totals
+    uint32_t total_samples;
+    uint32_t reports;
+    uint32_t heartbeats;
+} sensor_aggregate_t;
+
+/**
+ * @brief Sets up an aggregator.
+ *
+ * @param deadband Per field, a report is sent when |value - last reported| > deadband.
+ * @param max_silence_ms Heartbeat, a report is sent at least this often.
+ */
+void sensor_aggregate_init(sensor_aggregate_t *agg, int fields, const float *deadband, uint32_t max_silence_ms);
+
+/**
+ * @brief Adds a reading.
+ *
+ * @param now_ms Time of the reading, monotonic.
+ * @param values fields values.
+ * @param[out] report Filled when a report is due.
+ * @return Report reason, SENSOR_REPORT_NONE if nothing is to be published.
+ */
+sensor_report_reason_t sensor_aggregate_add(sensor_aggregate_t *agg, int64_t now_ms, const float *values,
+                                            sensor_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SENSOR_AGGREGATE_H
@@ -0,0 +1,23 @@
+#pragma once
+#include <stddef.h>
+
+// cJSON of ESP-IDF is not built for the host: nothing parses, database_import_json() fails
+typedef struct cJSON {
+    struct cJSON* next;
+    struct cJSON* child;
+    char* valuestring;
+    int valueint;
+} cJSON;
+
+static inline cJSON* cJSON_Parse(const char* value) { (void)value; return NULL; }
+static inline void cJSON_Delete(cJSON* item) { (void)item; }
+static inline int cJSON_IsArray(const cJSON* item) { (void)item; return 0; }
+static inline int cJSON_IsNumber(const cJSON* item) { (void)item; return 0; }
+static inline int cJSON_IsString(const cJSON* item) { (void)item; return 0; }
+static inline cJSON* cJSON_GetObjectItem(const cJSON* object, const char* key) {
+    (void)object;
+    (void)key;
+    return NULL;
+}
+
+#define cJSON_ArrayForEach(element, array) for (element = (array) ? (array)->child : NULL; element; element = element->next)
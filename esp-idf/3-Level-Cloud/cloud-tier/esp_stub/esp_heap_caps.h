@@ -0,0 +1,28 @@
+#pragma once
+#include <stdlib.h>
+#include <string.h>
+
+#define HEAP_IRAM_ATTR
+
+#define MALLOC_CAP_DEFAULT 0
+#define MALLOC_CAP_INTERNAL 0
+#define MALLOC_CAP_SPIRAM 0
+#define MALLOC_CAP_8BIT 0
+#define MALLOC_CAP_DMA 0
+
+static inline void* heap_caps_malloc(size_t size, int caps) { (void)caps; return malloc(size); }
+static inline void* heap_caps_calloc(size_t n, size_t size, int caps) { (void)caps; return calloc(n, size); }
+static inline void* heap_caps_aligned_alloc(size_t align, size_t size, int caps) {
+    (void)caps;
+    return aligned_alloc(align, (size + align - 1) / align * align);
+}
+static inline void* heap_caps_aligned_calloc(size_t align, size_t n, size_t size, int caps) {
+    void* ptr = heap_caps_aligned_alloc(align, n * size, caps);
+    if (ptr) {
+        memset(ptr, 0, n * size);
+    }
+    return ptr;
+}
+static inline void heap_caps_free(void* ptr) { free(ptr); }
+static inline size_t heap_caps_get_free_size(int caps) { (void)caps; return 0; } // only logged by the camera esp-dl
+static inline size_t heap_caps_get_largest_free_block(int caps) { (void)caps; return 0; }
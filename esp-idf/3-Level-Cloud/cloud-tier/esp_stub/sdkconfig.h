@@ -0,0 +1,2 @@
+#pragma once
+// No target: the ESP32-P4 (PPA) and ISA specific paths of esp-dl are left out
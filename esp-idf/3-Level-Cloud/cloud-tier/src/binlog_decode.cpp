@@ -0,0 +1,367 @@
+/**
+ * @file binlog_decode.cpp
+ * @brief Prints the deferred binary log of a firmware (esp32-s3-websocket_server/main/binlog.h) as text.
+ *
+ *   binlog_decode FIRMWARE.elf [LOG]
+ *
+ * Reads the console output of the device (LOG, or stdin: idf.py monitor | binlog_decode build/app.elf),
+ * copies the normal lines and replaces each "BL:" line by its messages. The format strings and tags are
+ * read from the sections of the ELF at the addresses of the records, the arguments are formatted along
+ * the format, as ESP_LOGx would. Times in ms since boot, to the us.
+ */
+
+#include <elf.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "binlog.h"
+
+namespace {
+
+// The allocated sections of an ELF, to read strings at their run-time addresses
+class Elf {
+public:
+    bool load(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        m_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (m_data.size() < EI_NIDENT || memcmp(m_data.data(), ELFMAG, SELFMAG) != 0) {
+            return false;
+        }
+        return m_data[EI_CLASS] == ELFCLASS32 ? load_sections<Elf32_Ehdr, Elf32_Shdr>()
+                                               : load_sections<Elf64_Ehdr, Elf64_Shdr>();
+    }
+
+    // The NUL-terminated string at addr, nullptr if no section holds one there
+    const char *string_at(uint32_t addr) const
+    {
+        for (const Section &s : m_sections) {
+            if (addr >= s.addr && addr < s.addr + s.size) {
+                const char *begin = m_data.data() + s.offset + (addr - s.addr);
+                const char *end = m_data.data() + s.offset + s.size;
+                return memchr(begin, '\0', end - begin) ? begin : nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    struct Section {
+        uint64_t addr;
+        uint64_t size;
+        uint64_t offset;
+    };
+    std::vector<char> m_data;
+    std::vector<Section> m_sections;
+
+    template <typename Ehdr, typename Shdr> bool load_sections()
+    {
+        if (m_data.size() < sizeof(Ehdr)) {
+            return false;
+        }
+        Ehdr eh;
+        memcpy(&eh, m_data.data(), sizeof(eh));
+        for (int i = 0; i < eh.e_shnum; i++) {
+            uint64_t at = eh.e_shoff + (uint64_t)i * eh.e_shentsize;
+            if (at + sizeof(Shdr) > m_data.size()) {
+                return false;
+            }
+            Shdr sh;
+            memcpy(&sh, m_data.data() + at, sizeof(sh));
+            if ((sh.sh_flags & SHF_ALLOC) && sh.sh_type != SHT_NOBITS && sh.sh_offset + sh.sh_size <= m_data.size()) {
+                m_sections.push_back({ sh.sh_addr, sh.sh_size, sh.sh_offset });
+            }
+        }
+        return !m_sections.empty();
+    }
+};
+
+std::vector<uint8_t> base64_decode(const char *s)
+{
+    std::vector<uint8_t> out;
+    uint32_t v = 0;
+    int bits = 0;
+    for (; *s; s++) {
+        const char *digit = strchr("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/", *s);
+        if (*s == '=' || !digit) {
+            break;
+        }
+        v = v << 6 | (uint32_t)(digit - "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back((uint8_t)(v >> bits));
+        }
+    }
+    return out;
+}
+
+uint32_t read32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// The argument words of a record, read in the order of the conversions
+class Args {
+public:
+    Args(const uint8_t *data, size_t len) : m_data(data), m_len(len) {}
+
+    bool get32(uint32_t &v)
+    {
+        if (m_pos + 4 > m_len) {
+            return false;
+        }
+        v = read32(m_data + m_pos);
+        m_pos += 4;
+        return true;
+    }
+
+    bool get64(uint64_t &v)
+    {
+        uint32_t lo, hi;
+        if (m_pos + 8 > m_len || !get32(lo) || !get32(hi)) {
+            return false;
+        }
+        v = (uint64_t)hi << 32 | lo;
+        return true;
+    }
+
+    bool get_string(std::string &s, bool &truncated)
+    {
+        if (m_pos >= m_len) {
+            return false;
+        }
+        size_t n = m_data[m_pos] & 0x7F;
+        truncated = m_data[m_pos] & 0x80;
+        if (m_pos + 1 + n > m_len) {
+            return false;
+        }
+        s.assign((const char *)m_data + m_pos + 1, n);
+        m_pos += (1 + n + 3) & ~(size_t)3;
+        return true;
+    }
+
+private:
+    const uint8_t *m_data;
+    size_t m_len;
+    size_t m_pos = 0;
+};
+
+template <typename T> std::string printf_string(const std::string &spec, T value)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), spec.c_str(), value);
+    return buf;
+}
+
+// Same walk of the format as encode_args() in binlog.c
+std::string format_message(const char *fmt, Args &args)
+{
+    std::string out;
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') {
+            out += *p;
+            continue;
+        }
+        if (*++p == '%') {
+            out += '%';
+            continue;
+        }
+        std::string spec = "%";
+        bool missing = false;
+        while (*p && strchr("-+ #0", *p)) {
+            spec += *p++;
+        }
+        for (int part = 0; part < 2; part++) { // width, then precision
+            if (part == 1) {
+                if (*p != '.') {
+                    break;
+                }
+                spec += *p++;
+            }
+            if (*p == '*') {
+                uint32_t v = 0;
+                missing |= !args.get32(v);
+                spec += std::to_string((int32_t)v);
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') {
+                spec += *p++;
+            }
+        }
+        bool wide = false; // ll, j: 64 bits; l, z, t: 32 bits on the target
+        std::string length;
+        if (*p == 'h' || *p == 'l') {
+            char c = *p++;
+            if (*p == c) {
+                p++;
+                if (c == 'h') {
+                    length = "hh";
+                } else {
+                    wide = true;
+                }
+            } else if (c == 'h') {
+                length = "h";
+            }
+        } else if (*p == 'j') {
+            wide = true;
+            p++;
+        } else if (*p == 'z' || *p == 't') {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+        char conv = *p;
+        uint32_t v32 = 0;
+        uint64_t v64 = 0;
+        switch (conv) {
+        case 'd': case 'i':
+            if (wide) {
+                missing |= !args.get64(v64);
+                out += missing ? "?" : printf_string(spec + "ll" + conv, (long long)v64);
+            } else {
+                missing |= !args.get32(v32);
+                out += missing ? "?" : printf_string(spec + length + conv, (int)(int32_t)v32);
+            }
+            break;
+        case 'u': case 'x': case 'X': case 'o':
+            if (wide) {
+                missing |= !args.get64(v64);
+                out += missing ? "?" : printf_string(spec + "ll" + conv, (unsigned long long)v64);
+            } else {
+                missing |= !args.get32(v32);
+                out += missing ? "?" : printf_string(spec + length + conv, (unsigned)v32);
+            }
+            break;
+        case 'c':
+            missing |= !args.get32(v32);
+            out += missing ? "?" : printf_string(spec + conv, (int)v32);
+            break;
+        case 'p':
+            missing |= !args.get32(v32);
+            out += missing ? "?" : printf_string("0x%08" PRIx32, v32);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            missing |= !args.get64(v64);
+            double d;
+            memcpy(&d, &v64, sizeof(d));
+            out += missing ? "?" : printf_string(spec + conv, d);
+            break;
+        }
+        case 's': {
+            std::string s;
+            bool truncated = false;
+            missing |= !args.get_string(s, truncated);
+            out += missing ? "?" : printf_string(spec + conv, s.c_str()) + (truncated ? "..." : "");
+            break;
+        }
+        default:
+            out += spec + conv; // not supported by the device either
+            break;
+        }
+    }
+    return out;
+}
+
+// The messages of one "BL:" line, false if a record is cut
+bool decode_line(const Elf &elf, const char *base64)
+{
+    std::vector<uint8_t> bytes = base64_decode(base64);
+    size_t pos = 0;
+    while (pos + BINLOG_HEADER_WORDS * 4 <= bytes.size()) {
+        const uint8_t *h = bytes.data() + pos;
+        uint32_t fmt_addr = read32(h), tag_addr = read32(h + 4);
+        uint64_t t_us = (uint64_t)read32(h + 12) << 32 | read32(h + 8);
+        uint32_t info = read32(h + 16);
+        size_t arg_bytes = (info >> 8 & 0xFF) * 4;
+        if (pos + BINLOG_HEADER_WORDS * 4 + arg_bytes > bytes.size()) {
+            break;
+        }
+        Args args(h + BINLOG_HEADER_WORDS * 4, arg_bytes);
+        pos += BINLOG_HEADER_WORDS * 4 + arg_bytes;
+
+        unsigned level = info & 0xF, core = info >> 4 & 0xF, suppressed = info >> 16;
+        char prefix[64];
+        snprintf(prefix, sizeof(prefix), "%c (%" PRIu64 ".%03u) ", level <= BINLOG_DEBUG ? "?EWID"[level] : '?',
+                 t_us / 1000, (unsigned)(t_us % 1000));
+        if (fmt_addr == 0) {
+            uint32_t lost = 0;
+            args.get32(lost);
+            printf("%sbinlog: %u messages lost on core %u\n", prefix, (unsigned)lost, core);
+            continue;
+        }
+        const char *fmt = elf.string_at(fmt_addr);
+        const char *tag = elf.string_at(tag_addr);
+        std::string message;
+        if (fmt) {
+            message = format_message(fmt, args);
+        } else {
+            // Not this firmware's ELF, or not a literal
+            char raw[32];
+            snprintf(raw, sizeof(raw), "<format 0x%08" PRIx32 ">", fmt_addr);
+            message = raw;
+            uint32_t v;
+            while (args.get32(v)) {
+                snprintf(raw, sizeof(raw), " %08" PRIx32, v);
+                message += raw;
+            }
+        }
+        printf("%s%s: %s", prefix, tag ? tag : "?", message.c_str());
+        if (suppressed) {
+            printf(" (+%u suppressed)", suppressed);
+        }
+        printf("\n");
+    }
+    return pos == bytes.size();
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s FIRMWARE.elf [LOG]\n", argv[0]);
+        return 2;
+    }
+    Elf elf;
+    if (!elf.load(argv[1])) {
+        fprintf(stderr, "%s: not an ELF with sections\n", argv[1]);
+        return 1;
+    }
+    std::ifstream file;
+    if (argc == 3) {
+        file.open(argv[2]);
+        if (!file) {
+            fprintf(stderr, "cannot open %s\n", argv[2]);
+            return 1;
+        }
+    }
+    std::istream &in = argc == 3 ? file : std::cin;
+    const size_t prefix = strlen(BINLOG_LINE_PREFIX);
+    std::string line;
+    int bad = 0;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.compare(0, prefix, BINLOG_LINE_PREFIX) == 0) {
+            if (!decode_line(elf, line.c_str() + prefix)) {
+                bad++;
+            }
+        } else {
+            printf("%s\n", line.c_str());
+        }
+        fflush(stdout);
+    }
+    if (bad) {
+        fprintf(stderr, "%d binlog lines cut or corrupted\n", bad);
+    }
+    return 0;
+}
@@ -0,0 +1,377 @@
+/**
+ * @file camera_load.cpp
+ * @brief Load generator for the S3 WebSocket server: virtual ESP32-CAMs sending face crops.
+ *
+ *   camera_load [options] [JPEG|DIR...]
+ *
+ * Each camera has its own connection and thread and sends like
+ * esp32-face-detect-websocket-client: {"type":"frame_start","size","id","w","h"}, the
+ * RGB565 (big endian, as the camera's frame buffer) crop in binary messages of
+ * --chunk bytes, {"type":"frame_end"}, then waits for {"type":"frame_ack"} before
+ * the next face. The faces are the JPEGs given (default: the bundled
+ * esp32-s3-face-recogn/main/database), decoded once, in turn per camera.
+ *
+ * Options: --host H (127.0.0.1) --port P (80) --path /ws
+ *          --cameras N (4) --rate F (faces/s per camera, 0: back to back, 1)
+ *          --duration S (10) --frames N (per camera, stops before --duration, 0: no limit)
+ *          --chunk N (8192) --gap MS (after frame_start and each chunk, as the camera's vTaskDelay, 10)
+ *          --scale N (faces decoded at 1/2^N, 0..3, 0) --ack-timeout MS (30000)
+ *          --heartbeat S (heartbeat between faces, as the camera, 0: none, 10) --report S (progress, 1)
+ *
+ * Prints the acked faces/s of all cameras, and per camera the faces sent and acked, the
+ * errors and the latency p50/p95/p99/max from frame_start to frame_ack. The ACK carries no
+ * frame id: a camera without ACK in --ack-timeout counts a timeout and reconnects.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tjpgd.h"
+#include "ws_lite.hpp"
+
+namespace {
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 80;
+    std::string path = "/ws";
+    int cameras = 4;
+    double rate = 1;
+    int duration_s = 10;
+    int frames = 0;
+    size_t chunk = 8192;
+    int gap_ms = 10;
+    int scale = 0;
+    int ack_timeout_ms = 30000;
+    int heartbeat_s = 10;
+    int report_s = 1;
+    std::vector<std::string> inputs;
+};
+
+struct Face {
+    std::string name;
+    int width;
+    int height;
+    std::vector<uint8_t> rgb565; // big endian
+};
+
+struct CameraStats {
+    std::atomic<int> sent{ 0 };
+    std::atomic<int> acked{ 0 };
+    std::atomic<int> timeouts{ 0 };
+    std::atomic<int> send_errors{ 0 };   // connection lost while sending or waiting for the ACK
+    std::atomic<int> connect_errors{ 0 };
+    std::atomic<int64_t> bytes{ 0 };
+    std::vector<int64_t> latency_us;     // written by the camera thread, read after it ends
+};
+
+int64_t now_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+bool parse_args(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--host" && has_value) {
+            opt.host = argv[++i];
+        } else if (arg == "--port" && has_value) {
+            opt.port = atoi(argv[++i]);
+        } else if (arg == "--path" && has_value) {
+            opt.path = argv[++i];
+        } else if (arg == "--cameras" && has_value) {
+            opt.cameras = atoi(argv[++i]);
+        } else if (arg == "--rate" && has_value) {
+            opt.rate = atof(argv[++i]);
+        } else if (arg == "--duration" && has_value) {
+            opt.duration_s = atoi(argv[++i]);
+        } else if (arg == "--frames" && has_value) {
+            opt.frames = atoi(argv[++i]);
+        } else if (arg == "--chunk" && has_value) {
+            opt.chunk = (size_t)atoi(argv[++i]);
+        } else if (arg == "--gap" && has_value) {
+            opt.gap_ms = atoi(argv[++i]);
+        } else if (arg == "--scale" && has_value) {
+            opt.scale = atoi(argv[++i]);
+        } else if (arg == "--ack-timeout" && has_value) {
+            opt.ack_timeout_ms = atoi(argv[++i]);
+        } else if (arg == "--heartbeat" && has_value) {
+            opt.heartbeat_s = atoi(argv[++i]);
+        } else if (arg == "--report" && has_value) {
+            opt.report_s = atoi(argv[++i]);
+        } else if (arg.compare(0, 2, "--") == 0) {
+            return false;
+        } else {
+            opt.inputs.push_back(arg);
+        }
+    }
+    return opt.cameras > 0 && opt.chunk > 0 && opt.rate >= 0 && opt.scale >= 0 && opt.scale <= 3 &&
+           (opt.duration_s > 0 || opt.frames > 0);
+}
+
+// TJpgDec (the esp32-camera copy) reading from memory, writing RGB565 big endian
+struct JpegSource {
+    const std::vector<uint8_t>* data;
+    size_t pos;
+    Face* face;
+};
+
+UINT jpeg_input(JDEC* jd, BYTE* buf, UINT len) {
+    JpegSource* src = static_cast<JpegSource*>(jd->device);
+    size_t n = std::min<size_t>(len, src->data->size() - src->pos);
+    if (buf) {
+        memcpy(buf, src->data->data() + src->pos, n);
+    }
+    src->pos += n;
+    return (UINT)n;
+}
+
+UINT jpeg_output(JDEC* jd, void* bitmap, JRECT* rect) {
+    Face* face = static_cast<JpegSource*>(jd->device)->face;
+    const uint8_t* rgb = static_cast<const uint8_t*>(bitmap);
+    for (int y = rect->top; y <= rect->bottom; y++) {
+        for (int x = rect->left; x <= rect->right; x++, rgb += 3) {
+            if (x >= face->width || y >= face->height) {
+                continue; // last MCU of a scaled odd size
+            }
+            uint16_t v = (uint16_t)((rgb[0] & 0xF8) << 8 | (rgb[1] & 0xFC) << 3 | rgb[2] >> 3);
+            uint8_t* out = face->rgb565.data() + ((size_t)y * face->width + x) * 2;
+            out[0] = (uint8_t)(v >> 8);
+            out[1] = (uint8_t)v;
+        }
+    }
+    return 1;
+}
+
+bool decode_jpeg(const std::string& path, int scale, Face& face) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    JpegSource src = { &data, 0, &face };
+    std::vector<uint8_t> pool(4096);
+    JDEC jd;
+    if (data.empty() || jd_prepare(&jd, jpeg_input, pool.data(), (UINT)pool.size(), &src) != JDR_OK) {
+        return false;
+    }
+    face.name = std::filesystem::path(path).filename().string();
+    face.width = (int)(jd.width >> scale);
+    face.height = (int)(jd.height >> scale);
+    face.rgb565.assign((size_t)face.width * face.height * 2, 0);
+    return jd_decomp(&jd, jpeg_output, (BYTE)scale) == JDR_OK;
+}
+
+std::vector<Face> load_faces(const Options& opt) {
+    std::vector<std::string> paths;
+    for (const std::string& input : opt.inputs) {
+        if (std::filesystem::is_directory(input)) {
+            std::vector<std::string> found;
+            for (const auto& entry : std::filesystem::directory_iterator(input)) {
+                std::string ext = entry.path().extension().string();
+                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+                if (ext == ".jpg" || ext == ".jpeg") {
+                    found.push_back(entry.path().string());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            paths.insert(paths.end(), found.begin(), found.end());
+        } else {
+            paths.push_back(input);
+        }
+    }
+    std::vector<Face> faces;
+    for (const std::string& path : paths) {
+        Face face;
+        if (decode_jpeg(path, opt.scale, face)) {
+            faces.push_back(std::move(face));
+        } else {
+            fprintf(stderr, "%s: not a baseline JPEG, skipped\n", path.c_str());
+        }
+    }
+    return faces;
+}
+
+// Reads the socket until `until_us` (the ACK, heartbeat answers), sleeps if it is down
+void wait_until(WsClient& ws, int64_t until_us) {
+    for (int64_t now = now_us(); now < until_us; now = now_us()) {
+        int ms = (int)std::max<int64_t>(1, (until_us - now + 999) / 1000);
+        if (!ws.connected() || !ws.loop(ms)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(std::max<int64_t>(0, until_us - now_us())));
+            return;
+        }
+    }
+}
+
+void run_camera(const Options& opt, const std::vector<Face>& faces, int camera, int64_t end_us,
+                CameraStats& stats) {
+    WsClient ws;
+    bool acked = false;
+    ws.on_text([&acked](const std::string& text) {
+        if (text.find("frame_ack") != std::string::npos) {
+            acked = true;
+        }
+    });
+    const int64_t period_us = opt.rate > 0 ? (int64_t)(1e6 / opt.rate) : 0;
+    // Cameras spread over one period, not in lockstep
+    int64_t next_us = now_us() + period_us * camera / opt.cameras;
+    int64_t next_heartbeat_us = 0;
+    const int64_t gap_us = opt.gap_ms * 1000LL;
+
+    for (int n = 0; (opt.frames == 0 || n < opt.frames) && now_us() < end_us; n++) {
+        wait_until(ws, std::min(next_us, end_us));
+        if (now_us() >= end_us) {
+            break;
+        }
+        if (!ws.connected()) {
+            if (!ws.connect(opt.host, opt.port, opt.path)) {
+                stats.connect_errors++;
+                wait_until(ws, std::min(now_us() + 1000000, end_us));
+                n--;
+                continue;
+            }
+            next_heartbeat_us = 0;
+        }
+        if (opt.heartbeat_s > 0 && now_us() >= next_heartbeat_us) {
+            ws.send_text("{\"type\":\"heartbeat\",\"t\":" + std::to_string(now_us()) + "}");
+            next_heartbeat_us = now_us() + opt.heartbeat_s * 1000000LL;
+        }
+
+        const Face& face = faces[(size_t)(camera + n) % faces.size()];
+        int id = n + 1;
+        char start_msg[128];
+        snprintf(start_msg, sizeof(start_msg), "{\"type\":\"frame_start\", \"size\":%zu, \"id\":%d, \"w\":%d, \"h\":%d}",
+                 face.rgb565.size(), id, face.width, face.height);
+        int64_t start_us = now_us();
+        next_us = std::max(next_us + period_us, start_us);
+        acked = false;
+        stats.sent++;
+        bool ok = ws.send_text(start_msg);
+        wait_until(ws, now_us() + gap_us);
+        for (size_t pos = 0; ok && pos < face.rgb565.size(); pos += opt.chunk) {
+            ok = ws.send_binary(face.rgb565.data() + pos, std::min(opt.chunk, face.rgb565.size() - pos));
+            wait_until(ws, now_us() + gap_us);
+        }
+        ok = ok && ws.send_text("{\"type\":\"frame_end\"}");
+        int64_t deadline_us = now_us() + opt.ack_timeout_ms * 1000LL;
+        while (ok && !acked && now_us() < deadline_us) {
+            ok = ws.loop((int)std::max<int64_t>(1, (deadline_us - now_us()) / 1000));
+        }
+        if (acked) {
+            stats.acked++;
+            stats.bytes += (int64_t)face.rgb565.size();
+            stats.latency_us.push_back(now_us() - start_us);
+        } else if (!ok) {
+            stats.send_errors++;
+        } else {
+            // The ACK carries no id: a late one would be taken for the next face's
+            stats.timeouts++;
+            ws.disconnect();
+        }
+    }
+    ws.disconnect();
+}
+
+double percentile_ms(std::vector<int64_t> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))] / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        fprintf(stderr,
+                "usage: %s [--host H] [--port P] [--path /ws] [--cameras N] [--rate F] [--duration S] [--frames N] "
+                "[--chunk N] [--gap MS] [--scale N] [--ack-timeout MS] [--heartbeat S] [--report S] [JPEG|DIR...]\n",
+                argv[0]);
+        return 2;
+    }
+    if (opt.inputs.empty()) {
+        opt.inputs.push_back(CAMERA_LOAD_FACES_DIR);
+    }
+    std::vector<Face> faces = load_faces(opt);
+    if (faces.empty()) {
+        fprintf(stderr, "no faces to send\n");
+        return 1;
+    }
+    for (const Face& face : faces) {
+        printf("%s: %dx%d, %zu bytes RGB565\n", face.name.c_str(), face.width, face.height, face.rgb565.size());
+    }
+    char rate[32] = "back to back";
+    if (opt.rate > 0) {
+        snprintf(rate, sizeof(rate), "%.2f faces/s each", opt.rate);
+    }
+    printf("%d cameras -> ws://%s:%d%s, %s, chunk %zu, gap %d ms\n", opt.cameras, opt.host.c_str(), opt.port,
+           opt.path.c_str(), rate, opt.chunk, opt.gap_ms);
+
+    std::vector<CameraStats> stats(opt.cameras);
+    int64_t start_us = now_us();
+    int64_t end_us = opt.duration_s > 0 ? start_us + opt.duration_s * 1000000LL : INT64_MAX;
+    std::vector<std::thread> threads;
+    std::atomic<int> running{ opt.cameras };
+    for (int i = 0; i < opt.cameras; i++) {
+        threads.emplace_back([&, i] {
+            run_camera(opt, faces, i, end_us, stats[i]);
+            running--;
+        });
+    }
+
+    auto totals = [&stats](int& acked, int& errors) {
+        acked = errors = 0;
+        for (const CameraStats& s : stats) {
+            acked += s.acked;
+            errors += s.timeouts + s.send_errors + s.connect_errors;
+        }
+    };
+    int reported = 0;
+    int64_t next_report_us = start_us + opt.report_s * 1000000LL;
+    while (running > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (opt.report_s > 0 && running > 0 && now_us() >= next_report_us) {
+            int acked, errors;
+            totals(acked, errors);
+            printf("%6.1f s: %d acked (%.1f/s), %d errors\n", (now_us() - start_us) / 1e6, acked,
+                   (acked - reported) / (double)opt.report_s, errors);
+            reported = acked;
+            next_report_us += opt.report_s * 1000000LL;
+            fflush(stdout);
+        }
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    double elapsed_s = (now_us() - start_us) / 1e6;
+
+    printf("\ncamera  sent  acked  timeouts  send_err  conn_err  p50_ms  p95_ms  p99_ms  max_ms  KB/s\n");
+    std::vector<int64_t> all;
+    int sent = 0, acked = 0, errors = 0;
+    for (int i = 0; i < opt.cameras; i++) {
+        const CameraStats& s = stats[i];
+        printf("%6d %5d %6d %9d %9d %9d %7.1f %7.1f %7.1f %7.1f %5.0f\n", i, s.sent.load(), s.acked.load(),
+               s.timeouts.load(), s.send_errors.load(), s.connect_errors.load(), percentile_ms(s.latency_us, 0.5),
+               percentile_ms(s.latency_us, 0.95), percentile_ms(s.latency_us, 0.99), percentile_ms(s.latency_us, 1.0),
+               s.bytes / 1024.0 / elapsed_s);
+        all.insert(all.end(), s.latency_us.begin(), s.latency_us.end());
+        sent += s.sent;
+        acked += s.acked;
+        errors += s.timeouts + s.send_errors + s.connect_errors;
+    }
+    printf("all    %5d %6d  errors %d, %.2f acked faces/s over %.1f s, latency p50 %.1f p95 %.1f p99 %.1f ms\n", sent,
+           acked, errors, acked / elapsed_s, elapsed_s, percentile_ms(all, 0.5), percentile_ms(all, 0.95),
+           percentile_ms(all, 0.99));
+    return acked > 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file face_db_bench.cpp
+ * @brief Host benchmark of the S3 face metadata log (esp32-s3-websocket_server/main/face_database.c).
+ *
+ *   face_db_bench [--records N] [--lookups N] [--dir DIR]
+ *
+ * Same records as the on-device benchmark of app_diagnostics.c, on a scratch file of the host: insert, load,
+ * lookup, update, delete half, compact, reload. Prints the time of each phase and the file size after it.
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "face_database.h"
+
+// Embedded faces.json of the firmware, only read by database_init()
+extern "C" const uint8_t faces_json_start[] asm("_binary_faces_json_start");
+extern "C" const uint8_t faces_json_end[] asm("_binary_faces_json_end");
+const uint8_t faces_json_start[] = "[]";
+const uint8_t faces_json_end[] = "";
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* const kTitles[] = { "Tester", "Developer", "Manager", "Guard" };
+
+std::string s_path;
+
+long file_size() {
+    struct stat st;
+    return stat(s_path.c_str(), &st) == 0 ? (long)st.st_size : -1;
+}
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void report(const char* phase, double ms, long ops) {
+    printf("%-8s %9.2f ms  %8.2f us/op  %7d records  %8ld bytes\n", phase, ms, ms * 1000.0 / ops,
+           database_get_count(), file_size());
+}
+
+bool put(int id, const char* status) {
+    char name[32], image_file[48], embedding_file[48];
+    snprintf(name, sizeof(name), "User %d", id);
+    snprintf(image_file, sizeof(image_file), "/spiffs/face_%d.jpg", id);
+    snprintf(embedding_file, sizeof(embedding_file), "/spiffs/face_%d.dat", id);
+    face_info_t info = { id, id % 4, name, kTitles[id % 4], status, image_file, embedding_file };
+    return database_put_face(&info) == ESP_OK;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int records = 10000;
+    long lookups = 1000000;
+    std::string dir = "/tmp";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--records" && has_value) {
+            records = atoi(argv[++i]);
+        } else if (arg == "--lookups" && has_value) {
+            lookups = atol(argv[++i]);
+        } else if (arg == "--dir" && has_value) {
+            dir = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--records N] [--lookups N] [--dir DIR]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (records <= 0 || lookups <= 0) {
+        fprintf(stderr, "--records and --lookups must be > 0\n");
+        return 2;
+    }
+    s_path = dir + "/face_db_bench.db";
+    remove(s_path.c_str());
+    if (database_open(s_path.c_str()) != ESP_OK) {
+        fprintf(stderr, "cannot open %s\n", s_path.c_str());
+        return 1;
+    }
+
+    Clock::time_point start = Clock::now();
+    for (int id = 1; id <= records; id++) {
+        if (!put(id, "active")) {
+            fprintf(stderr, "insert of record %d failed\n", id);
+            return 1;
+        }
+    }
+    report("insert", ms_since(start), records);
+
+    database_deinit();
+    start = Clock::now();
+    if (database_open(s_path.c_str()) != ESP_OK || database_get_count() != records) {
+        fprintf(stderr, "reload failed\n");
+        return 1;
+    }
+    report("load", ms_since(start), records);
+
+    // Same spread as the on-device benchmark, one id in n+1 misses
+    long found = 0;
+    start = Clock::now();
+    for (long i = 0; i < lookups; i++) {
+        found += database_find_by_id((int)((i * 7919) % (records + 1)) + 1) != nullptr;
+    }
+    double ms = ms_since(start);
+    printf("%-8s %9.2f ms  %8.1f ns/op  %7ld found\n", "lookup", ms, ms * 1e6 / lookups, found);
+
+    // Every record again with a new status: superseded entries pile up until the automatic compaction
+    start = Clock::now();
+    for (int id = 1; id <= records; id++) {
+        put(id, id % 2 ? "away" : "active");
+    }
+    report("update", ms_since(start), records);
+
+    start = Clock::now();
+    for (int id = 2; id <= records; id += 2) {
+        database_delete_face(id);
+    }
+    report("delete", ms_since(start), records / 2);
+
+    start = Clock::now();
+    if (database_compact() != ESP_OK) {
+        fprintf(stderr, "compaction failed\n");
+        return 1;
+    }
+    report("compact", ms_since(start), database_get_count());
+
+    int count = database_get_count();
+    database_deinit();
+    start = Clock::now();
+    if (database_open(s_path.c_str()) != ESP_OK || database_get_count() != count) {
+        fprintf(stderr, "reload after compaction failed\n");
+        return 1;
+    }
+    report("reload", ms_since(start), count);
+
+    database_deinit();
+    remove(s_path.c_str());
+    return 0;
+}
@@ -0,0 +1,348 @@
+#include "hnsw_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <queue>
+
+namespace {
+
+const char MAGIC[8] = { 'F', 'A', 'C', 'E', 'H', 'N', 'S', 'W' };
+const uint32_t FILE_VERSION = 1;
+
+int32_t dot_i8(const int8_t* a, const int8_t* b, int len) {
+    int32_t sum = 0;
+    for (int i = 0; i < len; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Nodes seen by the current search, per thread: a mark per node, a new epoch clears them all
+struct Visited {
+    std::vector<uint32_t> marks;
+    uint32_t epoch = 0;
+
+    void reset(size_t size) {
+        if (marks.size() < size) {
+            marks.resize(size, 0);
+        }
+        if (++epoch == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            epoch = 1;
+        }
+    }
+    bool insert(uint32_t id) {
+        if (marks[id] == epoch) {
+            return false;
+        }
+        marks[id] = epoch;
+        return true;
+    }
+};
+
+thread_local Visited t_visited;
+
+template <typename T>
+bool write_vec(FILE* f, const std::vector<T>& v) {
+    uint64_t n = v.size();
+    return fwrite(&n, sizeof(n), 1, f) == 1 && (n == 0 || fwrite(v.data(), sizeof(T), n, f) == n);
+}
+
+template <typename T>
+bool read_vec(FILE* f, std::vector<T>& v) {
+    uint64_t n;
+    if (fread(&n, sizeof(n), 1, f) != 1) {
+        return false;
+    }
+    v.resize(n);
+    return n == 0 || fread(v.data(), sizeof(T), n, f) == n;
+}
+
+} // namespace
+
+HnswIndex::HnswIndex(const Params& params)
+    : m_params(params), m_level_mult(1.0 / std::log((double)std::max(2, params.M))), m_rng(params.seed) {}
+
+float HnswIndex::quantize(const float* feat, int8_t* out) const {
+    float max_abs = 0;
+    for (int i = 0; i < m_params.dim; i++) {
+        max_abs = std::max(max_abs, std::fabs(feat[i]));
+    }
+    float scale = max_abs > 0 ? max_abs / 127.0f : 1.0f;
+    for (int i = 0; i < m_params.dim; i++) {
+        out[i] = (int8_t)std::max(-127L, std::min(127L, std::lrint(feat[i] / scale)));
+    }
+    return scale;
+}
+
+float HnswIndex::distance(const int8_t* q, float q_scale, uint32_t id) const {
+    const int8_t* v = &m_vectors[(size_t)id * m_params.dim];
+    return 1.0f - dot_i8(q, v, m_params.dim) * q_scale * m_scales[id];
+}
+
+float HnswIndex::distance(uint32_t a, uint32_t b) const {
+    return distance(&m_vectors[(size_t)a * m_params.dim], m_scales[a], b);
+}
+
+uint32_t* HnswIndex::links(uint32_t id, int level) {
+    if (level == 0) {
+        return &m_links0[(size_t)id * (1 + 2 * m_params.M)];
+    }
+    return &m_upper[id][(size_t)(level - 1) * (1 + m_params.M)];
+}
+
+const uint32_t* HnswIndex::links(uint32_t id, int level) const {
+    return const_cast<HnswIndex*>(this)->links(id, level);
+}
+
+std::vector<HnswIndex::Candidate> HnswIndex::search_level(const int8_t* q, float q_scale, uint32_t entry, int ef,
+                                                          int level) const {
+    Visited& visited = t_visited;
+    visited.reset(size());
+    visited.insert(entry);
+    Candidate first = { distance(q, q_scale, entry), entry };
+    // Nearest unexpanded candidate on top (min-heap), farthest result on top (max-heap)
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    std::priority_queue<Candidate> results;
+    candidates.push(first);
+    results.push(first);
+    while (!candidates.empty()) {
+        Candidate c = candidates.top();
+        if (c.dist > results.top().dist && (int)results.size() >= ef) {
+            break;
+        }
+        candidates.pop();
+        const uint32_t* l = links(c.id, level);
+        for (uint32_t i = 1; i <= l[0]; i++) {
+            uint32_t n = l[i];
+            if (!visited.insert(n)) {
+                continue;
+            }
+            float d = distance(q, q_scale, n);
+            if ((int)results.size() < ef || d < results.top().dist) {
+                candidates.push({ d, n });
+                results.push({ d, n });
+                if ((int)results.size() > ef) {
+                    results.pop();
+                }
+            }
+        }
+    }
+    std::vector<Candidate> out;
+    out.reserve(results.size());
+    while (!results.empty()) {
+        out.push_back(results.top());
+        results.pop();
+    }
+    return out;
+}
+
+std::vector<HnswIndex::Candidate> HnswIndex::select_neighbors(std::vector<Candidate> candidates, int m) const {
+    std::sort(candidates.begin(), candidates.end());
+    std::vector<Candidate> kept;
+    for (const Candidate& c : candidates) {
+        if ((int)kept.size() >= m) {
+            break;
+        }
+        bool diverse = true;
+        for (const Candidate& k : kept) {
+            if (distance(c.id, k.id) < c.dist) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse) {
+            kept.push_back(c);
+        }
+    }
+    return kept;
+}
+
+void HnswIndex::connect(uint32_t id, uint32_t neighbor, int level) {
+    uint32_t* l = links(neighbor, level);
+    int max = max_links(level);
+    if ((int)l[0] < max) {
+        l[++l[0]] = id;
+        return;
+    }
+    // Full: the new node competes with the current links
+    std::vector<Candidate> candidates = { { distance(neighbor, id), id } };
+    for (uint32_t i = 1; i <= l[0]; i++) {
+        candidates.push_back({ distance(neighbor, l[i]), l[i] });
+    }
+    std::vector<Candidate> kept = select_neighbors(std::move(candidates), max);
+    l[0] = (uint32_t)kept.size();
+    for (size_t i = 0; i < kept.size(); i++) {
+        l[1 + i] = kept[i].id;
+    }
+}
+
+uint32_t HnswIndex::add(const float* feat) {
+    uint32_t id = (uint32_t)size();
+    int dim = m_params.dim;
+    m_vectors.resize(m_vectors.size() + dim);
+    m_scales.push_back(quantize(feat, &m_vectors[(size_t)id * dim]));
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    int level = std::min(255, (int)(-std::log(1.0 - uniform(m_rng)) * m_level_mult));
+    m_levels.push_back((uint8_t)level);
+    m_links0.resize(m_links0.size() + 1 + 2 * m_params.M, 0);
+    m_upper.emplace_back((size_t)level * (1 + m_params.M), 0);
+    if (m_max_level < 0) {
+        m_entry = id;
+        m_max_level = level;
+        return id;
+    }
+
+    const int8_t* q = &m_vectors[(size_t)id * dim];
+    float q_scale = m_scales[id];
+    uint32_t entry = m_entry;
+    // Greedy descent on the levels above the node
+    for (int l = m_max_level; l > level; l--) {
+        float best = distance(q, q_scale, entry);
+        for (bool moved = true; moved;) {
+            moved = false;
+            const uint32_t* nl = links(entry, l);
+            for (uint32_t i = 1; i <= nl[0]; i++) {
+                float d = distance(q, q_scale, nl[i]);
+                if (d < best) {
+                    best = d;
+                    entry = nl[i];
+                    moved = true;
+                }
+            }
+        }
+    }
+    for (int l = std::min(level, m_max_level); l >= 0; l--) {
+        std::vector<Candidate> found = search_level(q, q_scale, entry, m_params.ef_construction, l);
+        entry = std::min_element(found.begin(), found.end())->id;
+        std::vector<Candidate> neighbors = select_neighbors(std::move(found), m_params.M);
+        uint32_t* own = links(id, l);
+        own[0] = (uint32_t)neighbors.size();
+        for (size_t i = 0; i < neighbors.size(); i++) {
+            own[1 + i] = neighbors[i].id;
+            connect(id, neighbors[i].id, l);
+        }
+    }
+    if (level > m_max_level) {
+        m_entry = id;
+        m_max_level = level;
+    }
+    return id;
+}
+
+std::vector<HnswIndex::Result> HnswIndex::search(const float* feat, size_t k, int ef) const {
+    std::vector<Result> out;
+    if (m_max_level < 0 || k == 0) {
+        return out;
+    }
+    std::vector<int8_t> q(m_params.dim);
+    float q_scale = quantize(feat, q.data());
+    uint32_t entry = m_entry;
+    float best = distance(q.data(), q_scale, entry);
+    for (int l = m_max_level; l > 0; l--) {
+        for (bool moved = true; moved;) {
+            moved = false;
+            const uint32_t* nl = links(entry, l);
+            for (uint32_t i = 1; i <= nl[0]; i++) {
+                float d = distance(q.data(), q_scale, nl[i]);
+                if (d < best) {
+                    best = d;
+                    entry = nl[i];
+                    moved = true;
+                }
+            }
+        }
+    }
+    std::vector<Candidate> found = search_level(q.data(), q_scale, entry, std::max(ef, (int)k), 0);
+    std::sort(found.begin(), found.end());
+    for (size_t i = 0; i < found.size() && i < k; i++) {
+        out.push_back({ found[i].id, 1.0f - found[i].dist });
+    }
+    return out;
+}
+
+std::vector<HnswIndex::Result> HnswIndex::exact_search(const float* feat, size_t k) const {
+    std::vector<int8_t> q(m_params.dim);
+    float q_scale = quantize(feat, q.data());
+    std::vector<Candidate> all(size());
+    for (uint32_t id = 0; id < size(); id++) {
+        all[id] = { distance(q.data(), q_scale, id), id };
+    }
+    k = std::min(k, all.size());
+    std::partial_sort(all.begin(), all.begin() + k, all.end());
+    std::vector<Result> out;
+    for (size_t i = 0; i < k; i++) {
+        out.push_back({ all[i].id, 1.0f - all[i].dist });
+    }
+    return out;
+}
+
+void HnswIndex::get(uint32_t id, float* out) const {
+    const int8_t* v = &m_vectors[(size_t)id * m_params.dim];
+    for (int i = 0; i < m_params.dim; i++) {
+        out[i] = v[i] * m_scales[id];
+    }
+}
+
+size_t HnswIndex::memory_bytes() const {
+    size_t bytes = m_vectors.capacity() + m_scales.capacity() * sizeof(float) + m_levels.capacity() +
+                   m_links0.capacity() * sizeof(uint32_t) + m_upper.capacity() * sizeof(m_upper[0]);
+    for (const auto& upper : m_upper) {
+        bytes += upper.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+bool HnswIndex::save(const std::string& path) const {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    int32_t header[6] = { (int32_t)FILE_VERSION, m_params.dim, m_params.M, m_params.ef_construction,
+                          (int32_t)m_entry, m_max_level };
+    bool ok = fwrite(MAGIC, sizeof(MAGIC), 1, f) == 1 && fwrite(header, sizeof(header), 1, f) == 1 &&
+              write_vec(f, m_vectors) && write_vec(f, m_scales) && write_vec(f, m_levels) && write_vec(f, m_links0);
+    for (size_t i = 0; ok && i < m_upper.size(); i++) {
+        ok = m_upper[i].empty() || fwrite(m_upper[i].data(), sizeof(uint32_t), m_upper[i].size(), f) ==
+                                       m_upper[i].size();
+    }
+    return fclose(f) == 0 && ok;
+}
+
+bool HnswIndex::load(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    char magic[sizeof(MAGIC)];
+    int32_t header[6];
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 &&
+              fread(header, sizeof(header), 1, f) == 1 && header[0] == (int32_t)FILE_VERSION;
+    if (ok) {
+        m_params.dim = header[1];
+        m_params.M = header[2];
+        m_params.ef_construction = header[3];
+        m_entry = (uint32_t)header[4];
+        m_max_level = header[5];
+        m_level_mult = 1.0 / std::log((double)std::max(2, m_params.M));
+        ok = read_vec(f, m_vectors) && read_vec(f, m_scales) && read_vec(f, m_levels) && read_vec(f, m_links0) &&
+             m_vectors.size() == m_scales.size() * m_params.dim && m_levels.size() == m_scales.size() &&
+             m_links0.size() == m_scales.size() * (1 + 2 * m_params.M);
+    }
+    if (ok) {
+        m_upper.assign(m_levels.size(), {});
+        for (size_t i = 0; ok && i < m_levels.size(); i++) {
+            m_upper[i].resize((size_t)m_levels[i] * (1 + m_params.M));
+            ok = m_upper[i].empty() || fread(m_upper[i].data(), sizeof(uint32_t), m_upper[i].size(), f) ==
+                                           m_upper[i].size();
+        }
+    }
+    fclose(f);
+    if (!ok) {
+        *this = HnswIndex(m_params);
+    }
+    return ok;
+}
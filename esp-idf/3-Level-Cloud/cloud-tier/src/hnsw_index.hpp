@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @class HnswIndex
+ * @brief Approximate nearest neighbor index (HNSW) over face embeddings.
+ *
+ * Hierarchical navigable small world graph (Malkov & Yashunin): every
+ * embedding is a node on level 0 and, with a geometrically falling
+ * probability, on the levels above. A search descends greedily from the
+ * top level and runs a beam search of width ef on level 0. Inserts are
+ * incremental, ids are dense in insertion order.
+ *
+ * Vectors are stored as int8 with one scale each, as the S3 sends them
+ * (512 bytes + links per face, ~800 MB for a million faces at M 32).
+ * The similarity is the cosine of L2 normalized embeddings, from an
+ * integer dot product.
+ *
+ * One writer: add() must not run concurrently with anything else.
+ * search() is const and may run from several threads at once.
+ */
+class HnswIndex {
+public:
+    struct Params {
+        int dim = 512;
+        int M = 32;                // links per node and level, 2*M on level 0 (high for 512-d)
+        int ef_construction = 200; // beam width of the inserts
+        uint32_t seed = 100;
+    };
+
+    struct Result {
+        uint32_t id;
+        float similarity;
+    };
+
+    explicit HnswIndex(const Params& params);
+
+    /** @brief Inserts an embedding (dim floats, L2 normalized), returns its id. */
+    uint32_t add(const float* feat);
+
+    /** @brief The k most similar embeddings, most similar first. ef < k is raised to k. */
+    std::vector<Result> search(const float* feat, size_t k, int ef) const;
+
+    /** @brief Same, by a linear scan over every embedding, for the recall. */
+    std::vector<Result> exact_search(const float* feat, size_t k) const;
+
+    /** @brief Stored embedding, dequantized. */
+    void get(uint32_t id, float* out) const;
+
+    size_t size() const { return m_scales.size(); }
+    int dim() const { return m_params.dim; }
+    size_t memory_bytes() const;
+
+    /** @brief Writes the index to a file, binary, this host's byte order. */
+    bool save(const std::string& path) const;
+
+    /** @brief Replaces the index by the one in the file. */
+    bool load(const std::string& path);
+
+private:
+    struct Candidate {
+        float dist; // 1 - similarity, smaller is closer
+        uint32_t id;
+        bool operator<(const Candidate& other) const { return dist < other.dist; }
+        bool operator>(const Candidate& other) const { return dist > other.dist; }
+    };
+
+    float quantize(const float* feat, int8_t* out) const;
+    float distance(const int8_t* q, float q_scale, uint32_t id) const;
+    float distance(uint32_t a, uint32_t b) const;
+    uint32_t* links(uint32_t id, int level);
+    const uint32_t* links(uint32_t id, int level) const;
+    int max_links(int level) const { return level == 0 ? 2 * m_params.M : m_params.M; }
+
+    // Beam search on one level, returns up to ef candidates, unordered
+    std::vector<Candidate> search_level(const int8_t* q, float q_scale, uint32_t entry, int ef, int level) const;
+    // Keeps up to m candidates that are closer to the node than to the ones kept (diversity heuristic)
+    std::vector<Candidate> select_neighbors(std::vector<Candidate> candidates, int m) const;
+    void connect(uint32_t id, uint32_t neighbor, int level);
+
+    Params m_params;
+    double m_level_mult;
+    std::mt19937 m_rng;
+    std::vector<int8_t> m_vectors;    // size * dim
+    std::vector<float> m_scales;
+    std::vector<uint8_t> m_levels;
+    std::vector<uint32_t> m_links0;   // size * (1 + 2M): count, then the links
+    std::vector<std::vector<uint32_t>> m_upper; // per node, levels 1.. each (1 + M)
+    uint32_t m_entry = 0;
+    int m_max_level = -1;
+};
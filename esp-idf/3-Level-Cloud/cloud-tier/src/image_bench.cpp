@@ -0,0 +1,490 @@
+/**
+ * @file image_bench.cpp
+ * @brief Host benchmark of the esp-dl image code used by the S3 preprocessing.
+ *
+ *   image_bench [--width W] [--height H] [--sizes WxH,WxH...] [--frames WxH,WxH...] [--reps N]
+ *
+ * resize: resizes a synthetic camera frame (RGB888 and big-endian RGB565,
+ * --width x --height, 320x240 by default) to each of --sizes with the
+ * per-pixel float path (dl::image::resize_loop) and with the table-driven
+ * fixed-point path (dl::image::resize with a cached ResizeTable), to RGB888
+ * and to normalized int8 model input.
+ * convert: converts whole frames of each of --frames (QVGA and VGA) with
+ * convert_pixel() on every pixel, as convert_img() did, and with convert_img()
+ * and its row kernels.
+ * preprocess: the detector (MSR full frame, MNP crops) and feature model
+ * (aligned face) inputs from an RGB565 frame, staged (the ROI converted to
+ * RGB888, then resized or warped) and fused (ImagePreprocessor: crop, decode,
+ * resize and normalization in one pass over the frame), with the bytes read.
+ * warp: the aligned 112x112 face of the feature model with the per-pixel float
+ * warp (warp_affine_loop) and the 16.16 fixed-point one (warp_affine), with
+ * the largest difference and the share of output values that differ.
+ * Prints the time per frame of both, and the largest difference and PSNR of the output.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dl_image_process.hpp"
+
+using namespace dl::image;
+
+namespace {
+
+struct Options {
+    int width = 320;
+    int height = 240;
+    std::vector<std::pair<int, int>> sizes = { { 160, 120 }, { 120, 160 }, { 224, 224 }, { 112, 112 }, { 96, 72 } };
+    std::vector<std::pair<int, int>> frames = { { 320, 240 }, { 640, 480 } };
+    int reps = 50;
+};
+
+int64_t now_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// WxH,WxH...
+bool parse_sizes(const char* arg, std::vector<std::pair<int, int>>& sizes) {
+    sizes.clear();
+    for (const char* p = arg; *p; p++) {
+        int w = 0, h = 0;
+        if (sscanf(p, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0 || w > 65535 || h > 65535) {
+            return false;
+        }
+        sizes.push_back({ w, h });
+        while (p[1] && *p != ',') {
+            p++;
+        }
+    }
+    return true;
+}
+
+bool parse_args(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--width" && has_value) {
+            opt.width = atoi(argv[++i]);
+        } else if (arg == "--height" && has_value) {
+            opt.height = atoi(argv[++i]);
+        } else if (arg == "--reps" && has_value) {
+            opt.reps = atoi(argv[++i]);
+        } else if (arg == "--sizes" && has_value) {
+            if (!parse_sizes(argv[++i], opt.sizes)) {
+                return false;
+            }
+        } else if (arg == "--frames" && has_value) {
+            if (!parse_sizes(argv[++i], opt.frames)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return opt.width > 1 && opt.height > 1 && opt.width < 65536 && opt.height < 65536 && opt.reps > 0 &&
+        !opt.sizes.empty() && !opt.frames.empty();
+}
+
+struct Frame {
+    const char* name;
+    pix_type_t pix_type;
+    uint32_t caps;
+    void* data;
+};
+
+struct Output {
+    const char* name;
+    pix_type_t pix_type;
+    void* norm_lut;
+};
+
+// Gradients with noise, roughly the statistics of a camera frame. The buffers get one spare row:
+// the float path reads one pixel past the last column/row (with weight 0).
+void make_frames(int width, int height, std::vector<uint8_t>& rgb888, std::vector<uint16_t>& rgb565) {
+    std::mt19937 rng(1);
+    rgb888.assign((size_t)(height + 1) * width * 3, 0);
+    rgb565.assign((size_t)(height + 1) * width, 0);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t r = (uint8_t)(x * 255 / width + rng() % 32);
+            uint8_t g = (uint8_t)(y * 255 / height + rng() % 32);
+            uint8_t b = (uint8_t)((x + y) * 2 + rng() % 64);
+            uint8_t* p = &rgb888[((size_t)y * width + x) * 3];
+            p[0] = r;
+            p[1] = g;
+            p[2] = b;
+            uint16_t le = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+            rgb565[(size_t)y * width + x] = (uint16_t)((le << 8) | (le >> 8)); // camera byte order
+        }
+    }
+}
+
+// Same normalization as ImagePreprocessor (mean 128, std 2, exponent 0)
+std::vector<int8_t> make_norm_lut() {
+    std::vector<int8_t> lut(3 * 256);
+    for (int c = 0; c < 3; c++) {
+        for (int v = 0; v < 256; v++) {
+            lut[c * 256 + v] = (int8_t)std::lround(std::max(-128.f, std::min(127.f, (v - 128) / 2.f)));
+        }
+    }
+    return lut;
+}
+
+void resize_reference(const img_t& src, img_t& dst, interpolate_type_t interpolate, uint32_t caps, void* norm_lut) {
+    float scale_x = (float)dst.width / src.width;
+    float scale_y = (float)dst.height / src.height;
+    if (dst.pix_type == DL_IMAGE_PIX_TYPE_RGB888) {
+        resize_loop<uint8_t>(src, dst, interpolate, caps, norm_lut, {}, scale_x, scale_y);
+    } else {
+        resize_loop<int8_t>(src, dst, interpolate, caps, norm_lut, {}, scale_x, scale_y);
+    }
+}
+
+// The outputs compared as bytes of the pixel type, with the difference in its units
+void compare(const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual, pix_type_t pix_type,
+             int* max_diff, char* psnr_str, size_t psnr_len) {
+    *max_diff = 0;
+    double squared = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        int diff;
+        if (pix_type == DL_IMAGE_PIX_TYPE_RGB888 || pix_type == DL_IMAGE_PIX_TYPE_GRAY) {
+            diff = (int)expected[i] - (int)actual[i];
+        } else if (pix_type == DL_IMAGE_PIX_TYPE_RGB888_QINT8) {
+            diff = (int)(int8_t)expected[i] - (int)(int8_t)actual[i];
+        } else {
+            diff = expected[i] != actual[i]; // packed or wider types: only exactness is meaningful
+        }
+        *max_diff = std::max(*max_diff, std::abs(diff));
+        squared += (double)diff * diff;
+        count++;
+    }
+    if (squared > 0) {
+        snprintf(psnr_str, psnr_len, "%.1f", 10 * std::log10(255.0 * 255.0 / (squared / count)));
+    } else {
+        snprintf(psnr_str, psnr_len, "exact");
+    }
+}
+
+int run_resize(const Options& opt) {
+    std::vector<uint8_t> rgb888;
+    std::vector<uint16_t> rgb565;
+    make_frames(opt.width, opt.height, rgb888, rgb565);
+    std::vector<int8_t> norm_lut = make_norm_lut();
+    const Frame frames[] = {
+        { "rgb888", DL_IMAGE_PIX_TYPE_RGB888, 0, rgb888.data() },
+        { "rgb565be", DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_CAP_RGB565_BIG_ENDIAN, rgb565.data() },
+    };
+    const Output outputs[] = {
+        { "rgb888", DL_IMAGE_PIX_TYPE_RGB888, nullptr },
+        { "int8", DL_IMAGE_PIX_TYPE_RGB888_QINT8, norm_lut.data() },
+    };
+    const interpolate_type_t interpolations[] = { DL_IMAGE_INTERPOLATE_BILINEAR, DL_IMAGE_INTERPOLATE_NEAREST };
+
+    printf("resize: %dx%d frame, %d reps, us per frame\n", opt.width, opt.height, opt.reps);
+    printf("%-9s %-7s %-9s %-9s %9s %9s %8s %8s %8s\n", "src", "dst", "size", "interp", "float", "table",
+           "speedup", "max diff", "PSNR dB");
+    for (const Frame& frame : frames) {
+        img_t src = { frame.data, (uint16_t)opt.width, (uint16_t)opt.height, frame.pix_type };
+        for (const Output& output : outputs) {
+            for (const auto& size : opt.sizes) {
+                for (interpolate_type_t interpolate : interpolations) {
+                    std::vector<uint8_t> expected((size_t)size.first * size.second * 3);
+                    std::vector<uint8_t> actual(expected.size());
+                    img_t ref = { expected.data(), (uint16_t)size.first, (uint16_t)size.second, output.pix_type };
+                    img_t dst = { actual.data(), (uint16_t)size.first, (uint16_t)size.second, output.pix_type };
+                    int64_t start = now_us();
+                    for (int r = 0; r < opt.reps; r++) {
+                        resize_reference(src, ref, interpolate, frame.caps, output.norm_lut);
+                    }
+                    double float_us = (double)(now_us() - start) / opt.reps;
+                    ResizeTable table;
+                    start = now_us();
+                    for (int r = 0; r < opt.reps; r++) {
+                        resize(src, dst, interpolate, frame.caps, output.norm_lut, {}, nullptr, nullptr, &table);
+                    }
+                    double table_us = (double)(now_us() - start) / opt.reps;
+
+                    int max_diff;
+                    char psnr_str[16];
+                    compare(expected, actual, output.pix_type, &max_diff, psnr_str, sizeof(psnr_str));
+                    char size_str[16];
+                    snprintf(size_str, sizeof(size_str), "%dx%d", size.first, size.second);
+                    printf("%-9s %-7s %-9s %-9s %9.1f %9.1f %7.1fx %8d %8s\n", frame.name, output.name, size_str,
+                           interpolate == DL_IMAGE_INTERPOLATE_BILINEAR ? "bilinear" : "nearest", float_us, table_us,
+                           float_us / table_us, max_diff, psnr_str);
+                    if (table.get_builds() != 1) {
+                        fprintf(stderr, "table rebuilt %u times for one geometry\n", (unsigned)table.get_builds());
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int run_convert(const Options& opt) {
+    std::vector<int8_t> norm_lut = make_norm_lut();
+    struct Conversion {
+        const char* src_name;
+        pix_type_t src_type;
+        uint32_t caps;
+        const char* dst_name;
+        pix_type_t dst_type;
+        void* norm_lut;
+    };
+    const Conversion conversions[] = {
+        { "rgb565be", DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_CAP_RGB565_BIG_ENDIAN, "rgb888", DL_IMAGE_PIX_TYPE_RGB888,
+          nullptr },
+        { "rgb565be", DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_CAP_RGB565_BIG_ENDIAN, "gray", DL_IMAGE_PIX_TYPE_GRAY,
+          nullptr },
+        { "rgb888", DL_IMAGE_PIX_TYPE_RGB888, 0, "int8", DL_IMAGE_PIX_TYPE_RGB888_QINT8, norm_lut.data() },
+        { "rgb888", DL_IMAGE_PIX_TYPE_RGB888, DL_IMAGE_CAP_RGB_SWAP, "int8 bgr", DL_IMAGE_PIX_TYPE_RGB888_QINT8,
+          norm_lut.data() },
+    };
+
+    printf("convert: %d reps, us per frame\n", opt.reps);
+    printf("%-9s %-9s %-9s %9s %9s %8s %8s\n", "src", "dst", "frame", "pixel", "row", "speedup", "exact");
+    for (const auto& size : opt.frames) {
+        std::vector<uint8_t> rgb888;
+        std::vector<uint16_t> rgb565;
+        make_frames(size.first, size.second, rgb888, rgb565);
+        size_t pixels = (size_t)size.first * size.second;
+        for (const Conversion& c : conversions) {
+            img_t src = { c.src_type == DL_IMAGE_PIX_TYPE_RGB565 ? (void*)rgb565.data() : (void*)rgb888.data(),
+                          (uint16_t)size.first, (uint16_t)size.second, c.src_type };
+            std::vector<uint8_t> expected(pixels * 3);
+            std::vector<uint8_t> actual(expected.size());
+            img_t dst = { actual.data(), (uint16_t)size.first, (uint16_t)size.second, c.dst_type };
+            int src_bytes = c.src_type == DL_IMAGE_PIX_TYPE_RGB565 ? 2 : 3;
+            int dst_bytes = c.dst_type == DL_IMAGE_PIX_TYPE_GRAY ? 1 : 3;
+            int64_t start = now_us();
+            for (int r = 0; r < opt.reps; r++) {
+                pix_t src_pix = { nullptr, c.src_type };
+                pix_t dst_pix = { nullptr, c.dst_type };
+                for (size_t i = 0; i < pixels; i++) {
+                    src_pix.data = (uint8_t*)src.data + i * src_bytes;
+                    dst_pix.data = expected.data() + i * dst_bytes;
+                    convert_pixel(src_pix, dst_pix, c.caps, c.norm_lut);
+                }
+            }
+            double pixel_us = (double)(now_us() - start) / opt.reps;
+            start = now_us();
+            for (int r = 0; r < opt.reps; r++) {
+                convert_img(src, dst, c.caps, c.norm_lut);
+            }
+            double row_us = (double)(now_us() - start) / opt.reps;
+            char frame_str[16];
+            snprintf(frame_str, sizeof(frame_str), "%dx%d", size.first, size.second);
+            bool exact = expected == actual;
+            printf("%-9s %-9s %-9s %9.1f %9.1f %7.1fx %8s\n", c.src_name, c.dst_name, frame_str, pixel_us, row_us,
+                   pixel_us / row_us, exact ? "yes" : "NO");
+            if (!exact) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Similarity transform of an aligned face: output center on (cx, cy), scale source pixels per output pixel
+void face_transform(dl::math::Matrix<float>& M, int width, int height, float cx, float cy, float scale, float angle) {
+    float a = angle * (float)M_PI / 180.f;
+    M.array[0][0] = scale * std::cos(a);
+    M.array[0][1] = -scale * std::sin(a);
+    M.array[1][0] = scale * std::sin(a);
+    M.array[1][1] = scale * std::cos(a);
+    M.array[0][2] = cx - M.array[0][0] * width / 2 - M.array[0][1] * height / 2;
+    M.array[1][2] = cy - M.array[1][0] * width / 2 - M.array[1][1] * height / 2;
+}
+
+int run_warp(const Options& opt) {
+    std::vector<uint8_t> rgb888;
+    std::vector<uint16_t> rgb565;
+    make_frames(opt.width, opt.height, rgb888, rgb565);
+    std::vector<int8_t> norm_lut = make_norm_lut();
+    const uint32_t caps = DL_IMAGE_CAP_RGB_SWAP | DL_IMAGE_CAP_RGB565_BIG_ENDIAN;
+    img_t frame = { rgb565.data(), (uint16_t)opt.width, (uint16_t)opt.height, DL_IMAGE_PIX_TYPE_RGB565 };
+    struct Alignment {
+        float scale, angle;
+        float cx, cy; // face center, as a fraction of the frame
+    };
+    // Faces of 67, 112 and 168 pixels; the last one partly outside the frame
+    const Alignment alignments[] = {
+        { 0.6f, 0, 0.5f, 0.5f }, { 1.0f, 12, 0.5f, 0.5f }, { 1.5f, -25, 0.5f, 0.5f }, { 1.0f, 30, 0.1f, 0.9f }
+    };
+    const interpolate_type_t interpolations[] = { DL_IMAGE_INTERPOLATE_NEAREST, DL_IMAGE_INTERPOLATE_BILINEAR };
+
+    printf("warp: 112x112 int8 feat input from a %dx%d rgb565 frame, %d reps, us per face\n", opt.width, opt.height,
+           opt.reps);
+    printf("%-6s %-6s %-9s %-9s %9s %9s %8s %8s %9s\n", "scale", "angle", "center", "interp", "float", "fixed",
+           "speedup", "max diff", "differing");
+    for (const Alignment& al : alignments) {
+        dl::math::Matrix<float> M(2, 3);
+        face_transform(M, 112, 112, al.cx * opt.width, al.cy * opt.height, al.scale, al.angle);
+        for (interpolate_type_t interpolate : interpolations) {
+            std::vector<uint8_t> expected(112 * 112 * 3);
+            std::vector<uint8_t> actual(expected.size());
+            img_t ref = { expected.data(), 112, 112, DL_IMAGE_PIX_TYPE_RGB888_QINT8 };
+            img_t dst = { actual.data(), 112, 112, DL_IMAGE_PIX_TYPE_RGB888_QINT8 };
+            int64_t start = now_us();
+            for (int r = 0; r < opt.reps; r++) {
+                warp_affine_loop<int8_t>(frame, ref, interpolate, &M, caps, norm_lut.data());
+            }
+            double float_us = (double)(now_us() - start) / opt.reps;
+            start = now_us();
+            for (int r = 0; r < opt.reps; r++) {
+                warp_affine(frame, dst, interpolate, &M, caps, norm_lut.data());
+            }
+            double fixed_us = (double)(now_us() - start) / opt.reps;
+
+            int max_diff = 0;
+            size_t differing = 0;
+            for (size_t i = 0; i < expected.size(); i++) {
+                int diff = std::abs((int)(int8_t)expected[i] - (int)(int8_t)actual[i]);
+                max_diff = std::max(max_diff, diff);
+                differing += diff != 0;
+            }
+            char center_str[16];
+            snprintf(center_str, sizeof(center_str), "%.0f,%.0f", al.cx * opt.width, al.cy * opt.height);
+            printf("%-6.1f %-6.0f %-9s %-9s %9.1f %9.1f %7.1fx %8d %8.2f%%\n", al.scale, al.angle, center_str,
+                   interpolate == DL_IMAGE_INTERPOLATE_BILINEAR ? "bilinear" : "nearest", float_us, fixed_us,
+                   float_us / fixed_us, max_diff, 100.0 * differing / expected.size());
+        }
+    }
+    return 0;
+}
+
+// The face models' input geometries on a camera frame, each from a ROI converted to RGB888 first (staged)
+// and in one pass from the frame (fused, ImagePreprocessor)
+int run_preprocess(const Options& opt) {
+    std::vector<uint8_t> rgb888;
+    std::vector<uint16_t> rgb565;
+    make_frames(opt.width, opt.height, rgb888, rgb565);
+    std::vector<int8_t> norm_lut = make_norm_lut();
+    const uint32_t caps = DL_IMAGE_CAP_RGB_SWAP | DL_IMAGE_CAP_RGB565_BIG_ENDIAN; // as the S3 detector and feat
+    img_t frame = { rgb565.data(), (uint16_t)opt.width, (uint16_t)opt.height, DL_IMAGE_PIX_TYPE_RGB565 };
+    int cx = opt.width / 2, cy = opt.height / 2;
+    struct Case {
+        const char* name;
+        int width, height;
+        interpolate_type_t interpolate;
+        std::vector<int> box; // resize: the crop, empty for the whole frame
+        float scale, angle;   // warp: source pixels per output pixel, rotation in degrees, around the center
+    };
+    const Case cases[] = {
+        { "msr", 160, 120, DL_IMAGE_INTERPOLATE_NEAREST, {}, 0, 0 },
+        { "msr bilinear", 160, 120, DL_IMAGE_INTERPOLATE_BILINEAR, {}, 0, 0 },
+        { "mnp small", 48, 48, DL_IMAGE_INTERPOLATE_NEAREST, { cx - 20, cy - 20, cx + 20, cy + 20 }, 0, 0 },
+        { "mnp large", 48, 48, DL_IMAGE_INTERPOLATE_NEAREST, { cx - 48, cy - 48, cx + 48, cy + 48 }, 0, 0 },
+        { "feat", 112, 112, DL_IMAGE_INTERPOLATE_NEAREST, {}, 0.6f, 12 },
+    };
+
+    printf("preprocess: %dx%d rgb565 frame, %d reps, us per call, KB read from the frame and the RGB888 ROI\n",
+           opt.width, opt.height, opt.reps);
+    printf("%-13s %-9s %9s %9s %8s %10s %10s %8s\n", "model", "input", "staged", "fused", "speedup", "staged KB",
+           "fused KB", "exact");
+    for (const Case& c : cases) {
+        std::vector<uint8_t> expected((size_t)c.width * c.height * 3);
+        std::vector<uint8_t> actual(expected.size());
+        img_t ref = { expected.data(), (uint16_t)c.width, (uint16_t)c.height, DL_IMAGE_PIX_TYPE_RGB888_QINT8 };
+        img_t dst = { actual.data(), (uint16_t)c.width, (uint16_t)c.height, DL_IMAGE_PIX_TYPE_RGB888_QINT8 };
+        bool warp = c.scale > 0;
+        std::vector<int> roi = c.box.empty() ? std::vector<int>{ 0, 0, opt.width, opt.height } : c.box;
+        dl::math::Matrix<float> M_inv(2, 3), M_roi(2, 3);
+        if (warp) {
+            // Output center on the frame center, the ROI is the bounding box of the corners
+            float a = c.angle * (float)M_PI / 180.f;
+            float m00 = c.scale * std::cos(a), m01 = -c.scale * std::sin(a);
+            float m02 = cx - m00 * c.width / 2 - m01 * c.height / 2;
+            float m10 = -m01, m11 = m00;
+            float m12 = cy - m10 * c.width / 2 - m11 * c.height / 2;
+            float M[2][3] = { { m00, m01, m02 }, { m10, m11, m12 } };
+            float x_min = 1e9f, x_max = -1e9f, y_min = 1e9f, y_max = -1e9f;
+            for (int corner = 0; corner < 4; corner++) {
+                float u = (corner & 1) ? c.width - 1 : 0, v = (corner & 2) ? c.height - 1 : 0;
+                float x = m00 * u + m01 * v + m02, y = m10 * u + m11 * v + m12;
+                x_min = std::min(x_min, x), x_max = std::max(x_max, x);
+                y_min = std::min(y_min, y), y_max = std::max(y_max, y);
+            }
+            roi = { (int)x_min - 1, (int)y_min - 1, (int)x_max + 2, (int)y_max + 2 };
+            for (int r = 0; r < 2; r++) {
+                for (int k = 0; k < 3; k++) {
+                    M_inv.array[r][k] = M[r][k];
+                    M_roi.array[r][k] = M[r][k] - (k == 2 ? roi[r] : 0);
+                }
+            }
+        }
+        int roi_w = roi[2] - roi[0], roi_h = roi[3] - roi[1];
+        std::vector<uint8_t> roi_buf((size_t)roi_w * roi_h * 3);
+        img_t roi_img = { roi_buf.data(), (uint16_t)roi_w, (uint16_t)roi_h, DL_IMAGE_PIX_TYPE_RGB888 };
+
+        ResizeTable staged_table, table;
+        int64_t start = now_us();
+        for (int r = 0; r < opt.reps; r++) {
+            convert_img(frame, roi_img, caps, nullptr, roi);
+            if (warp) {
+                warp_affine(roi_img, ref, c.interpolate, &M_roi, 0, norm_lut.data());
+            } else {
+                resize(roi_img, ref, c.interpolate, 0, norm_lut.data(), {}, nullptr, nullptr, &staged_table);
+            }
+        }
+        double staged_us = (double)(now_us() - start) / opt.reps;
+        start = now_us();
+        for (int r = 0; r < opt.reps; r++) {
+            if (warp) {
+                warp_affine(frame, dst, c.interpolate, &M_inv, caps, norm_lut.data());
+            } else {
+                resize(frame, dst, c.interpolate, caps, norm_lut.data(), c.box, nullptr, nullptr, &table);
+            }
+        }
+        double fused_us = (double)(now_us() - start) / opt.reps;
+
+        // The nearest warp reads one pixel per output pixel
+        size_t warp_bytes = (size_t)c.width * c.height;
+        size_t staged_bytes = (size_t)roi_w * roi_h * 2 + (warp ? warp_bytes * 3 : staged_table.get_src_bytes());
+        size_t fused_bytes = warp ? warp_bytes * 2 : table.get_src_bytes();
+        char input_str[16];
+        snprintf(input_str, sizeof(input_str), "%dx%d", c.width, c.height);
+        bool exact = expected == actual;
+        printf("%-13s %-9s %9.1f %9.1f %7.1fx %10.1f %10.1f %8s\n", c.name, input_str, staged_us, fused_us,
+               staged_us / fused_us, staged_bytes / 1024.0, fused_bytes / 1024.0, exact ? "yes" : "NO");
+        if (!exact) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        fprintf(stderr, "usage: %s [--width W] [--height H] [--sizes WxH,WxH...] [--frames WxH,WxH...] [--reps N]\n",
+                argv[0]);
+        return 2;
+    }
+    int ret = run_resize(opt);
+    if (ret == 0) {
+        printf("\n");
+        ret = run_convert(opt);
+    }
+    if (ret == 0) {
+        printf("\n");
+        ret = run_preprocess(opt);
+    }
+    if (ret == 0) {
+        printf("\n");
+        ret = run_warp(opt);
+    }
+    return ret;
+}
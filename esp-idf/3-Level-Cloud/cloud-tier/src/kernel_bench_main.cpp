@@ -0,0 +1,45 @@
+/**
+ * @file kernel_bench_main.cpp
+ * @brief Host entry of the S3 kernel microbenchmarks (esp32-s3-websocket_server/main/kernel_bench.cpp).
+ *
+ *   kernel_bench [--warmup N] [--reps N] [--format csv|json] [--filter KERNEL]
+ *
+ * Prints one line per kernel and input to stdout, times in ns. Two builds
+ * are compared by diffing or joining their outputs on (kernel, variant, size, format).
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "kernel_bench.h"
+
+int main(int argc, char** argv) {
+    kernel_bench_config_t config = { 5, 50, KERNEL_BENCH_CSV, nullptr };
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--warmup" && has_value) {
+            config.warmup = atoi(argv[++i]);
+        } else if (arg == "--reps" && has_value) {
+            config.reps = atoi(argv[++i]);
+        } else if (arg == "--format" && has_value) {
+            std::string format = argv[++i];
+            if (format != "csv" && format != "json") {
+                fprintf(stderr, "unknown format %s\n", format.c_str());
+                return 2;
+            }
+            config.format = format == "json" ? KERNEL_BENCH_JSON : KERNEL_BENCH_CSV;
+        } else if (arg == "--filter" && has_value) {
+            config.filter = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--warmup N] [--reps N] [--format csv|json] [--filter KERNEL]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (config.warmup < 0 || config.reps <= 0) {
+        fprintf(stderr, "--warmup must be >= 0 and --reps > 0\n");
+        return 2;
+    }
+    return kernel_bench_run(&config) > 0 ? 0 : 1;
+}
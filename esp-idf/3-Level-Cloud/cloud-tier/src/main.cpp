@@ -0,0 +1,921 @@
+/**
+ * @file main.cpp
+ * @brief Cloud tier: receives the face uploads of the S3 edge devices over MQTT.
+ *
+ *   cloud_tier receive [options]          reassemble uploads, log size/latency/throughput
+ *   cloud_tier send [options] FILE...     upload files as the S3 does (test sender)
+ *   cloud_tier cluster-bench [options]    replay synthetic strangers through the S3 unknown-face clustering
+ *   cloud_tier ann-bench [options]        identification throughput/latency/recall of the HNSW index
+ *
+ * Options: --host H (127.0.0.1) --port P (1883)
+ *          --topic T (receive: filter, +/faces/upload; send: edge/faces/upload)
+ *          --out DIR (receive: save the uploads) --chunk N (4096) --window N (4)
+ *          --repeat N (1) --camera N (0)
+ *          --request-every N (receive: ask for the image of every Nth embedding-only face)
+ *          --count N (receive: stop after N faces and print the summary)
+ *          --embedding-only (send: int8 embedding only, images on request)
+ *          --linger MS (send: keep answering image requests this long at the end, 2000)
+ *          --identify (receive: match the embeddings in the HNSW index, answer with the identity on
+ *                      .../faces/identity, unknown faces are added to the index)
+ *          --top-k K (receive: also send the K best matches on .../faces/match, 0)
+ *          --index FILE (receive: load the index at start, save it at the end; ann-bench: load instead of build)
+ *          --preload N (receive: add N synthetic faces to the index first, capacity tests)
+ *          --ef N[,N...] (search beam width, 64; ann-bench: every value is measured)
+ *          --M N (32) --ef-construction N (200): index build parameters
+ *          --size N (ann-bench: faces indexed, 100000) --queries N (ann-bench: 2000)
+ *          --k N (ann-bench: results per query, 10) --threads N (ann-bench: query threads, 1)
+ *          --save FILE (ann-bench: save the index built)
+ *          --ttl S (receive: TTL of the identities sent, 0 = the S3 default)
+ *          --people N (send: synthetic embeddings of N people, keep the identities the cloud sends
+ *                      back like the S3 write-back and skip the upload of a face known locally)
+ *          --capacity N (send: identities kept locally with --people, 32; cluster-bench: clusters, 32)
+ *          --visits N (cluster-bench: passes in front of a camera, 500)
+ *          --burst N (cluster-bench: frames per pass, 10)
+ *
+ * cluster-bench uses --people as the number of strangers (50). Clock simulated, no broker needed.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "face_upload_proto.h"
+#include "hnsw_index.hpp"
+#include "mqtt_lite.hpp"
+#include "unknown_cluster.h"
+
+namespace {
+
+struct Options {
+    std::string mode;
+    std::string host = "127.0.0.1";
+    int port = 1883;
+    std::string topic = "+/faces/upload";
+    bool topic_set = false;
+    std::string out_dir;
+    size_t chunk = 4096;
+    int window = 4;
+    int repeat = 1;
+    int camera = 0;
+    int request_every = 0;
+    int count = 0;
+    bool embedding_only = false;
+    int linger_ms = 2000;
+    bool identify = false;
+    uint32_t ttl_s = 0;
+    int people = 0;
+    size_t capacity = 32;
+    int visits = 500;
+    int burst = 10;
+    int top_k = 0;
+    std::string index_path;
+    size_t preload = 0;
+    std::vector<int> efs = { 64 };
+    int M = 32;
+    int ef_construction = 200;
+    size_t size = 100000;
+    int queries = 2000;
+    int k = 10;
+    int threads = 1;
+    std::string save_path;
+    std::vector<std::string> files;
+};
+
+int64_t now_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+bool parse_args(int argc, char** argv, Options& opt) {
+    if (argc < 2) {
+        return false;
+    }
+    opt.mode = argv[1];
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--host" && has_value) {
+            opt.host = argv[++i];
+        } else if (arg == "--port" && has_value) {
+            opt.port = atoi(argv[++i]);
+        } else if (arg == "--topic" && has_value) {
+            opt.topic = argv[++i];
+            opt.topic_set = true;
+        } else if (arg == "--out" && has_value) {
+            opt.out_dir = argv[++i];
+        } else if (arg == "--chunk" && has_value) {
+            opt.chunk = (size_t)atoi(argv[++i]);
+        } else if (arg == "--window" && has_value) {
+            opt.window = atoi(argv[++i]);
+        } else if (arg == "--repeat" && has_value) {
+            opt.repeat = atoi(argv[++i]);
+        } else if (arg == "--camera" && has_value) {
+            opt.camera = atoi(argv[++i]);
+        } else if (arg == "--request-every" && has_value) {
+            opt.request_every = atoi(argv[++i]);
+        } else if (arg == "--count" && has_value) {
+            opt.count = atoi(argv[++i]);
+        } else if (arg == "--embedding-only") {
+            opt.embedding_only = true;
+        } else if (arg == "--linger" && has_value) {
+            opt.linger_ms = atoi(argv[++i]);
+        } else if (arg == "--identify") {
+            opt.identify = true;
+        } else if (arg == "--ttl" && has_value) {
+            opt.ttl_s = (uint32_t)atoi(argv[++i]);
+        } else if (arg == "--people" && has_value) {
+            opt.people = atoi(argv[++i]);
+        } else if (arg == "--capacity" && has_value) {
+            opt.capacity = (size_t)atoi(argv[++i]);
+        } else if (arg == "--visits" && has_value) {
+            opt.visits = atoi(argv[++i]);
+        } else if (arg == "--burst" && has_value) {
+            opt.burst = atoi(argv[++i]);
+        } else if (arg == "--top-k" && has_value) {
+            opt.top_k = std::min(atoi(argv[++i]), FACE_UPLOAD_MATCH_MAX);
+        } else if (arg == "--index" && has_value) {
+            opt.index_path = argv[++i];
+        } else if (arg == "--preload" && has_value) {
+            opt.preload = (size_t)atol(argv[++i]);
+        } else if (arg == "--ef" && has_value) {
+            opt.efs.clear();
+            for (const char* p = argv[++i]; *p; p++) {
+                opt.efs.push_back(atoi(p));
+                while (p[1] && *p != ',') {
+                    p++;
+                }
+            }
+        } else if (arg == "--M" && has_value) {
+            opt.M = atoi(argv[++i]);
+        } else if (arg == "--ef-construction" && has_value) {
+            opt.ef_construction = atoi(argv[++i]);
+        } else if (arg == "--size" && has_value) {
+            opt.size = (size_t)atol(argv[++i]);
+        } else if (arg == "--queries" && has_value) {
+            opt.queries = atoi(argv[++i]);
+        } else if (arg == "--k" && has_value) {
+            opt.k = atoi(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            opt.threads = atoi(argv[++i]);
+        } else if (arg == "--save" && has_value) {
+            opt.save_path = argv[++i];
+        } else if (arg.rfind("--", 0) == 0) {
+            return false;
+        } else {
+            opt.files.push_back(arg);
+        }
+    }
+    if (opt.mode == "cluster-bench") {
+        return opt.visits > 0 && opt.burst > 0 && opt.capacity > 0;
+    }
+    if (opt.efs.empty() || opt.M < 2 || opt.ef_construction < 1) {
+        return false;
+    }
+    if (opt.mode == "ann-bench") {
+        return opt.size > 0 && opt.queries > 0 && opt.k > 0 && opt.threads > 0;
+    }
+    return opt.mode == "receive" || (opt.mode == "send" && !opt.files.empty() && opt.chunk > 0 && opt.window > 0);
+}
+
+// Topic filter match with the MQTT wildcards + and #
+bool topic_matches(const std::string& filter, const std::string& topic) {
+    size_t f = 0, t = 0;
+    while (f < filter.size()) {
+        if (filter[f] == '#') {
+            return true;
+        }
+        if (filter[f] == '+') {
+            while (t < topic.size() && topic[t] != '/') {
+                t++;
+            }
+            f++;
+            continue;
+        }
+        if (t >= topic.size() || filter[f] != topic[t]) {
+            return false;
+        }
+        f++;
+        t++;
+    }
+    return t == topic.size();
+}
+
+// Other topic of the same device (or filter): .../faces/upload -> .../faces/<name>
+std::string sibling_topic(const std::string& upload_topic, const std::string& name) {
+    const std::string suffix = "/faces/upload";
+    if (upload_topic.size() >= suffix.size() &&
+        upload_topic.compare(upload_topic.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        return upload_topic.substr(0, upload_topic.size() - suffix.size()) + "/faces/" + name;
+    }
+    return upload_topic + "/" + name;
+}
+
+void normalize(std::vector<float>& v) {
+    float norm = 0;
+    for (float x : v) {
+        norm += x * x;
+    }
+    norm = std::sqrt(norm);
+    for (float& x : v) {
+        x /= norm;
+    }
+}
+
+float dot(const std::vector<float>& a, const std::vector<float>& b) {
+    float sum = 0;
+    for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Synthetic face: a random unit vector
+void random_face(std::mt19937& rng, std::vector<float>& feat) {
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    for (float& x : feat) {
+        x = normal(rng);
+    }
+    normalize(feat);
+}
+
+HnswIndex::Params index_params(const Options& opt) {
+    HnswIndex::Params params;
+    params.M = opt.M;
+    params.ef_construction = opt.ef_construction;
+    return params;
+}
+
+// Identity message for the S3 write-back, int8 embedding so it fits one MQTT buffer there
+std::vector<uint8_t> encode_identity(uint32_t ref_id, int face_id, uint32_t ttl_s, const std::vector<float>& feat) {
+    std::string name = "cloud-" + std::to_string(face_id);
+    std::vector<uint8_t> feat_i8(face_upload_feat_bytes(FACE_UPLOAD_FEAT_I8, (uint16_t)feat.size()));
+    face_upload_quantize_i8(feat.data(), (uint16_t)feat.size(), feat_i8.data());
+    face_upload_identity_t identity = {};
+    identity.ref_id = ref_id;
+    identity.face_id = face_id;
+    identity.ttl_s = ttl_s;
+    identity.feat_type = FACE_UPLOAD_FEAT_I8;
+    identity.feat_len = (uint16_t)feat.size();
+    identity.name = name.c_str();
+    identity.name_len = (uint8_t)name.size();
+    identity.title = "visitor";
+    identity.title_len = 7;
+    identity.feat = feat_i8.data();
+    std::vector<uint8_t> msg(face_upload_identity_len(&identity));
+    face_upload_write_identity(msg.data(), &identity);
+    return msg;
+}
+
+double percentile_ms(std::vector<int64_t> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))] / 1000.0;
+}
+
+// Image replies are saved under the id of the upload they belong to. Embeddings as floats, whatever the wire type
+void save_upload(const std::string& dir, const face_upload_rx_done_t& done) {
+    char name[256];
+    uint32_t id = (done.meta.flags & FACE_UPLOAD_FLAG_IMAGE_REPLY) ? done.meta.ref_id : done.upload_id;
+    if (done.meta.image_len > 0) {
+        snprintf(name, sizeof(name), "%s/upload_%08x_cam%u_%ux%u_fmt%u.img", dir.c_str(), id, done.meta.camera_id,
+                 done.meta.width, done.meta.height, done.meta.format);
+        std::ofstream(name, std::ios::binary).write((const char*)done.image, done.meta.image_len);
+    }
+    if (done.meta.feat_len > 0) {
+        std::vector<float> feat(done.meta.feat_len);
+        face_upload_decode_feat(done.meta.feat_type, done.meta.feat_len, done.feat, feat.data());
+        snprintf(name, sizeof(name), "%s/upload_%08x.feat", dir.c_str(), id);
+        std::ofstream(name, std::ios::binary).write((const char*)feat.data(), feat.size() * sizeof(float));
+    }
+}
+
+int run_receive(const Options& opt) {
+    MqttClient mqtt;
+    if (!mqtt.connect(opt.host, opt.port, "cloud_tier_receiver") || !mqtt.subscribe(opt.topic, 1)) {
+        return 1;
+    }
+    printf("Receiving uploads on %s (%s:%d)\n", opt.topic.c_str(), opt.host.c_str(), opt.port);
+
+    face_upload_rx_t rx;
+    face_upload_rx_init(&rx);
+    uint32_t completed = 0;
+    uint64_t bytes = 0;
+
+    // Bytes per face: embedding/meta objects, image replies, and the chunk headers on top
+    uint32_t faces = 0;
+    uint64_t face_bytes = 0;
+    uint64_t image_bytes = 0;
+    uint64_t wire_bytes = 0;
+    // Image requests sent, by upload id: time of the request
+    std::map<uint32_t, int64_t> requested;
+    std::vector<int64_t> rtts;
+    int64_t stop_us = 0;
+    // --identify: every face seen so far, the index id is the cloud id
+    HnswIndex index(index_params(opt));
+    uint32_t identified = 0;
+    std::vector<int64_t> search_us;
+    if (opt.identify && !opt.index_path.empty() && index.load(opt.index_path)) {
+        printf("Index %s: %zu faces\n", opt.index_path.c_str(), index.size());
+    }
+    if (opt.identify && opt.preload > 0) {
+        std::mt19937 rng(3);
+        std::vector<float> feat(index.dim());
+        int64_t start = now_us();
+        for (size_t i = 0; i < opt.preload; i++) {
+            random_face(rng, feat);
+            index.add(feat.data());
+        }
+        printf("Preloaded %zu synthetic faces in %.1f s, index %zu faces, %.0f MB\n", opt.preload,
+               (now_us() - start) / 1e6, index.size(), index.memory_bytes() / 1048576.0);
+    }
+    // Sightings of unknown faces the S3 clustered and did not upload
+    std::string sighting_filter = sibling_topic(opt.topic, "sighting");
+    if (!mqtt.subscribe(sighting_filter, 0)) {
+        return 1;
+    }
+    uint64_t sightings = 0;
+    mqtt.on_message([&](const std::string& topic, const uint8_t* data, size_t len) {
+        face_upload_sighting_t sighting;
+        if (topic_matches(sighting_filter, topic) && face_upload_parse_sighting(data, len, &sighting)) {
+            sightings += sighting.new_sightings;
+            printf("cluster %u camera %u: %u more sightings, %u in %u s\n", sighting.cluster_id, sighting.camera_id,
+                   sighting.new_sightings, sighting.sightings, sighting.duration_s);
+            fflush(stdout);
+            return;
+        }
+        if (!topic_matches(opt.topic, topic)) {
+            return;
+        }
+        face_upload_rx_done_t done;
+        if (!face_upload_rx_feed(&rx, data, len, now_us(), &done)) {
+            return;
+        }
+        completed++;
+        bytes += done.object_len;
+        face_upload_chunk_t chunk;
+        const uint8_t* payload;
+        size_t payload_len;
+        face_upload_parse_chunk(data, len, &chunk, &payload, &payload_len); // valid, it completed the upload
+        wire_bytes += done.object_len + (size_t)chunk.count * FACE_UPLOAD_CHUNK_HEADER_LEN;
+        int64_t span = done.last_us - done.first_us;
+        printf("upload %08x camera %u %ux%u fmt %u: %zu bytes (%u feat, ref %u), %lld us first-to-last chunk, "
+               "%.1f KB/s, %u duplicates, %u dropped so far\n",
+               done.upload_id, done.meta.camera_id, done.meta.width, done.meta.height, done.meta.format,
+               done.object_len, done.meta.feat_len, done.meta.ref_id, (long long)span,
+               span > 0 ? done.object_len * 1e6 / span / 1024 : 0.0, rx.duplicates, rx.dropped);
+        if (!opt.out_dir.empty()) {
+            save_upload(opt.out_dir, done);
+        }
+        if (done.meta.flags & FACE_UPLOAD_FLAG_IMAGE_REPLY) {
+            image_bytes += done.object_len;
+            auto it = requested.find(done.meta.ref_id);
+            if (it != requested.end()) {
+                rtts.push_back(done.last_us - it->second);
+                printf("  image of %08x: %.2f ms from request to last chunk\n", done.meta.ref_id,
+                       rtts.back() / 1000.0);
+                requested.erase(it);
+            }
+        } else {
+            faces++;
+            face_bytes += done.object_len;
+            if (opt.identify && done.meta.feat_len == index.dim()) {
+                std::vector<float> feat(done.meta.feat_len);
+                face_upload_decode_feat(done.meta.feat_type, done.meta.feat_len, done.feat, feat.data());
+                int64_t start = now_us();
+                std::vector<HnswIndex::Result> top =
+                    index.search(feat.data(), std::max(1, opt.top_k), opt.efs.front());
+                search_us.push_back(now_us() - start);
+                uint32_t id;
+                if (!top.empty() && top.front().similarity > 0.5f) { // FACE_MATCH_THRESHOLD of the S3
+                    id = top.front().id;
+                    identified++;
+                } else {
+                    id = index.add(feat.data());
+                }
+                index.get(id, feat.data());
+                std::vector<uint8_t> msg = encode_identity(done.upload_id, (int)id, opt.ttl_s, feat);
+                mqtt.publish(sibling_topic(topic, "identity"), msg.data(), msg.size(), 1);
+                if (opt.top_k > 0) {
+                    std::vector<face_upload_match_t> matches;
+                    for (const HnswIndex::Result& r : top) {
+                        matches.push_back({ (int32_t)r.id, r.similarity });
+                    }
+                    std::vector<uint8_t> list(face_upload_matches_len((uint8_t)matches.size()));
+                    face_upload_write_matches(list.data(), done.upload_id, matches.data(), (uint8_t)matches.size());
+                    mqtt.publish(sibling_topic(topic, "match"), list.data(), list.size(), 0);
+                }
+            }
+            if ((done.meta.flags & FACE_UPLOAD_FLAG_IMAGE_HELD) && opt.request_every > 0 &&
+                faces % opt.request_every == 0) {
+                uint8_t request[FACE_UPLOAD_REQUEST_LEN];
+                face_upload_write_request(request, done.upload_id);
+                requested[done.upload_id] = now_us();
+                mqtt.publish(sibling_topic(topic, "request"), request, sizeof(request), 1);
+            }
+        }
+        fflush(stdout);
+        if (opt.count > 0 && (int)faces >= opt.count && stop_us == 0) {
+            stop_us = now_us() + 5000000; // wait for the images still requested
+        }
+    });
+    while (mqtt.loop(100)) {
+        if (stop_us != 0 && (requested.empty() || now_us() > stop_us)) {
+            printf("%u faces: %.0f bytes/face uplink (%.0f embedding/meta + %.0f image), %.0f bytes/face with "
+                   "chunk headers; %zu images requested, %zu missing, request to image p50 %.2f ms p95 %.2f ms\n",
+                   faces, (double)(face_bytes + image_bytes) / faces, (double)face_bytes / faces,
+                   (double)image_bytes / faces, (double)wire_bytes / faces, rtts.size() + requested.size(),
+                   requested.size(), percentile_ms(rtts, 0.5), percentile_ms(rtts, 0.95));
+            if (opt.identify) {
+                printf("%zu identities, %u faces matched a known one, search p50 %.0f us p95 %.0f us p99 %.0f us "
+                       "(ef %d)\n", index.size(), identified, percentile_ms(search_us, 0.5) * 1000,
+                       percentile_ms(search_us, 0.95) * 1000, percentile_ms(search_us, 0.99) * 1000,
+                       opt.efs.front());
+                if (!opt.index_path.empty() && !index.save(opt.index_path)) {
+                    fprintf(stderr, "Cannot save the index to %s\n", opt.index_path.c_str());
+                }
+            }
+            printf("%llu sightings reported without upload\n", (unsigned long long)sightings);
+            face_upload_rx_free(&rx);
+            return requested.empty() ? 0 : 1;
+        }
+    }
+    printf("Connection lost after %u uploads (%llu bytes)\n", completed, (unsigned long long)bytes);
+    face_upload_rx_free(&rx);
+    return 1;
+}
+
+// Same scheme as face_upload.c on the S3: QoS1 chunks, at most `window` unacknowledged
+int run_send(const Options& opt) {
+    MqttClient mqtt;
+    if (!mqtt.connect(opt.host, opt.port, "cloud_tier_sender")) {
+        return 1;
+    }
+    // A concrete topic under the receiver's default filter, like MQTT_TOPIC_BASE "/faces/upload"
+    std::string topic = opt.topic_set ? opt.topic : "edge/faces/upload";
+
+    std::vector<uint16_t> inflight;
+    mqtt.on_puback([&](uint16_t id) {
+        auto it = std::find(inflight.begin(), inflight.end(), id);
+        if (it != inflight.end()) {
+            inflight.erase(it);
+        }
+    });
+    // Image requests of the cloud, answered between uploads like the S3 uploader task does
+    std::string request_topic = sibling_topic(topic, "request");
+    std::vector<uint32_t> requests;
+    // --people: the S3 write-back, identities from the cloud, the least recently seen one evicted
+    struct LocalIdentity {
+        int cloud_id;
+        std::vector<float> feat;
+        int last_seen;
+    };
+    std::vector<LocalIdentity> local;
+    int sighting = 0;
+    std::string identity_topic = sibling_topic(topic, "identity");
+    mqtt.on_message([&](const std::string& msg_topic, const uint8_t* data, size_t len) {
+        uint32_t id;
+        face_upload_identity_t identity;
+        if (msg_topic == request_topic && face_upload_parse_request(data, len, &id)) {
+            requests.push_back(id);
+        } else if (msg_topic == identity_topic && face_upload_parse_identity(data, len, &identity)) {
+            for (const LocalIdentity& l : local) {
+                if (l.cloud_id == identity.face_id) {
+                    return;
+                }
+            }
+            LocalIdentity entry = { identity.face_id, std::vector<float>(identity.feat_len), sighting };
+            face_upload_decode_feat(identity.feat_type, identity.feat_len, identity.feat, entry.feat.data());
+            if (local.size() >= opt.capacity) {
+                auto lru = std::min_element(local.begin(), local.end(), [](const LocalIdentity& a,
+                                                                           const LocalIdentity& b) {
+                    return a.last_seen < b.last_seen;
+                });
+                *lru = std::move(entry);
+            } else {
+                local.push_back(std::move(entry));
+            }
+        }
+    });
+    if (opt.embedding_only && !mqtt.subscribe(request_topic, 1)) {
+        return 1;
+    }
+    if (opt.people > 0 && !mqtt.subscribe(identity_topic, 1)) {
+        return 1;
+    }
+    // Synthetic people: a random unit vector each, a sighting adds noise (cosine to the person ~0.8)
+    std::mt19937 rng(1);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<std::vector<float>> people(opt.people, std::vector<float>(512));
+    for (auto& person : people) {
+        for (float& x : person) {
+            x = normal(rng);
+        }
+        normalize(person);
+    }
+    int total_sightings = opt.repeat * (int)opt.files.size();
+    int hit_window = std::max(1, total_sightings / 10);
+    int local_hits = 0;
+    int window_hits = 0;
+    // Waits until fewer than `limit` chunks are unacknowledged
+    auto wait_window = [&](size_t limit) {
+        int64_t deadline = now_us() + 5000000;
+        while (inflight.size() >= limit && now_us() < deadline) {
+            if (!mqtt.loop(50)) {
+                return false;
+            }
+        }
+        return inflight.size() < limit;
+    };
+    std::vector<uint8_t> msg(FACE_UPLOAD_CHUNK_HEADER_LEN + opt.chunk);
+    // Publishes one object, returns the latency (first publish to last PUBACK), -1 on failure
+    auto send_object = [&](const std::vector<uint8_t>& object, uint32_t upload_id) -> int64_t {
+        face_upload_chunk_t chunk = {};
+        chunk.upload_id = upload_id;
+        chunk.count = face_upload_chunk_count(object.size(), opt.chunk);
+        chunk.total_len = (uint32_t)object.size();
+        int64_t start = now_us();
+        for (uint16_t i = 0; i < chunk.count; i++) {
+            if (!wait_window(opt.window)) {
+                fprintf(stderr, "No PUBACK, giving up\n");
+                return -1;
+            }
+            chunk.index = i;
+            chunk.offset = (uint32_t)(i * opt.chunk);
+            size_t payload = std::min(opt.chunk, object.size() - chunk.offset);
+            face_upload_write_chunk_header(msg.data(), &chunk);
+            memcpy(msg.data() + FACE_UPLOAD_CHUNK_HEADER_LEN, &object[chunk.offset], payload);
+            int id = mqtt.publish(topic, msg.data(), FACE_UPLOAD_CHUNK_HEADER_LEN + payload, 1);
+            if (id < 0) {
+                return -1;
+            }
+            inflight.push_back((uint16_t)id);
+            mqtt.loop(0);
+        }
+        if (!wait_window(1)) {
+            fprintf(stderr, "Last chunks not acknowledged\n");
+            return -1;
+        }
+        int64_t latency = now_us() - start;
+        printf("upload %08x: %zu bytes in %u chunks, %.2f ms, %.1f KB/s\n", upload_id, object.size(), chunk.count,
+               latency / 1000.0, latency > 0 ? object.size() * 1e6 / latency / 1024 : 0.0);
+        return latency;
+    };
+
+    uint32_t upload_id = (uint32_t)now_us();
+    std::map<uint32_t, std::pair<face_upload_meta_t, std::vector<uint8_t>>> held;
+    std::vector<int64_t> latencies;
+    uint64_t total_bytes = 0;
+    int64_t busy_us = 0; // all objects, the images sent on request too
+    uint32_t images_sent = 0;
+    auto serve_requests = [&]() {
+        for (uint32_t ref_id : requests) {
+            auto it = held.find(ref_id);
+            if (it == held.end()) {
+                fprintf(stderr, "Image of %08x requested, not held\n", ref_id);
+                continue;
+            }
+            face_upload_meta_t meta = it->second.first;
+            meta.flags = FACE_UPLOAD_FLAG_IMAGE_REPLY;
+            meta.ref_id = ref_id;
+            std::vector<uint8_t> object(face_upload_object_len(&meta));
+            face_upload_write_meta(object.data(), &meta);
+            memcpy(&object[FACE_UPLOAD_META_LEN], it->second.second.data(), it->second.second.size());
+            int64_t latency = send_object(object, upload_id++);
+            if (latency >= 0) {
+                images_sent++;
+                total_bytes += object.size();
+                busy_us += latency;
+            }
+            held.erase(it);
+        }
+        requests.clear();
+    };
+
+    for (int r = 0; r < opt.repeat; r++) {
+        for (const std::string& file : opt.files) {
+            std::ifstream in(file, std::ios::binary);
+            std::vector<uint8_t> image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            if (image.empty()) {
+                fprintf(stderr, "Cannot read %s\n", file.c_str());
+                return 1;
+            }
+            // Synthetic 512-d embedding, as the S3 feature model gives
+            std::vector<float> feat(512);
+            if (opt.people > 0) {
+                const std::vector<float>& person = people[rng() % people.size()];
+                for (size_t i = 0; i < feat.size(); i++) {
+                    feat[i] = person[i] + normal(rng) * 0.5f / std::sqrt((float)feat.size());
+                }
+                normalize(feat);
+                sighting++;
+                int hit = -1;
+                float best_sim = 0.5f; // FACE_MATCH_THRESHOLD of the S3
+                for (size_t i = 0; i < local.size(); i++) {
+                    float sim = dot(local[i].feat, feat);
+                    if (sim > best_sim) {
+                        best_sim = sim;
+                        hit = (int)i;
+                    }
+                }
+                if (hit >= 0) {
+                    local[hit].last_seen = sighting;
+                    local_hits++;
+                    window_hits++;
+                }
+                if (sighting % hit_window == 0) {
+                    printf("faces %d-%d: local hit rate %.0f%%, %zu identities written back\n",
+                           sighting - hit_window + 1, sighting, 100.0 * window_hits / hit_window, local.size());
+                    window_hits = 0;
+                }
+                if (hit >= 0) {
+                    continue; // recognized on the S3, nothing to upload
+                }
+            } else {
+                for (size_t i = 0; i < feat.size(); i++) {
+                    feat[i] = (float)((i * 37 + r) % 101) / 101.0f - 0.5f;
+                }
+            }
+            face_upload_meta_t meta = {};
+            meta.camera_id = (uint16_t)opt.camera;
+            meta.format = 0;
+            meta.feat_len = (uint16_t)feat.size();
+            meta.feat_type = opt.embedding_only ? FACE_UPLOAD_FEAT_I8 : FACE_UPLOAD_FEAT_F32;
+            meta.flags = opt.embedding_only ? FACE_UPLOAD_FLAG_IMAGE_HELD : 0;
+            meta.image_len = opt.embedding_only ? 0 : (uint32_t)image.size();
+            std::vector<uint8_t> object(face_upload_object_len(&meta));
+            face_upload_write_meta(object.data(), &meta);
+            uint8_t* feat_out = &object[FACE_UPLOAD_META_LEN];
+            if (opt.embedding_only) {
+                face_upload_quantize_i8(feat.data(), meta.feat_len, feat_out);
+            } else {
+                memcpy(feat_out, feat.data(), feat.size() * sizeof(float));
+                memcpy(feat_out + feat.size() * sizeof(float), image.data(), image.size());
+            }
+
+            uint32_t id = upload_id++;
+            if (opt.embedding_only) {
+                face_upload_meta_t image_meta = meta;
+                image_meta.feat_len = 0;
+                image_meta.image_len = (uint32_t)image.size();
+                held[id] = { image_meta, std::move(image) };
+            }
+            int64_t latency = send_object(object, id);
+            if (latency < 0) {
+                return 1;
+            }
+            latencies.push_back(latency);
+            total_bytes += object.size();
+            busy_us += latency;
+            serve_requests();
+            if (opt.people > 0) {
+                mqtt.loop(1); // the identity, if the cloud knows the face
+            }
+        }
+    }
+    // Requests for the last faces
+    int64_t linger_end = now_us() + (opt.embedding_only ? opt.linger_ms * 1000LL : 0);
+    while (now_us() < linger_end && mqtt.loop(50)) {
+        serve_requests();
+    }
+    printf("%zu uploads, %.0f bytes/face (%u images sent on request), %.1f KB/s, latency p50 %.2f ms, "
+           "max %.2f ms (chunk %zu, window %d)\n",
+           latencies.size(), (double)total_bytes / latencies.size(), images_sent,
+           busy_us > 0 ? total_bytes * 1e6 / busy_us / 1024 : 0.0, percentile_ms(latencies, 0.5),
+           percentile_ms(latencies, 1.0), opt.chunk, opt.window);
+    if (opt.people > 0) {
+        printf("%d faces, %d recognized locally (%.1f%%), %zu uploaded\n", sighting, local_hits,
+               100.0 * local_hits / std::max(1, sighting), latencies.size());
+    }
+    return 0;
+}
+
+// Strangers passing cameras: a pass is a burst of frames 200 ms apart, passes ~1 min apart on average.
+// Every frame is an unknown face for the S3; without clustering every one is uploaded.
+int run_cluster_bench(const Options& opt) {
+    const int feat_len = 512;
+    int strangers = opt.people > 0 ? opt.people : 50;
+    unknown_cluster_config_t config = {};
+    config.capacity = (int)opt.capacity;
+    config.feat_len = feat_len;
+    config.threshold = 0.5f;       // UNKNOWN_CLUSTER_* defaults of config.h
+    config.half_life_ms = 600000;
+    config.min_weight = 0.25f;
+    config.best_margin = 0.2f;
+    config.max_uploads = 2;
+    config.report_ms = 10000;
+    if (!unknown_cluster_init(&config)) {
+        return 1;
+    }
+
+    std::mt19937 rng(1);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::exponential_distribution<double> gap(1.0 / 60.0);
+    std::vector<std::vector<float>> people(strangers, std::vector<float>(feat_len));
+    for (auto& person : people) {
+        for (float& x : person) {
+            x = normal(rng);
+        }
+        normalize(person);
+    }
+
+    // Faces of each cluster by person, for the purity
+    std::map<uint32_t, std::map<int, int>> members;
+    std::vector<bool> seen(strangers);
+    int faces = 0;
+    int uploads = 0;
+    int reports = 0;
+    int64_t add_ns = 0;
+    int64_t clock_us = 0;
+    std::vector<float> feat(feat_len);
+    unknown_cluster_report_t report;
+    for (int v = 0; v < opt.visits; v++) {
+        clock_us += (int64_t)(gap(rng) * 1e6);
+        int person = (int)(rng() % strangers);
+        int camera = (int)(rng() % 4);
+        seen[person] = true;
+        for (int f = 0; f < opt.burst; f++, clock_us += 200000) {
+            // Same noise as send --people (cosine to the person ~0.9), quality from score x size
+            for (int i = 0; i < feat_len; i++) {
+                feat[i] = people[person][i] + normal(rng) * 0.5f / std::sqrt((float)feat_len);
+            }
+            normalize(feat);
+            unknown_cluster_result_t result;
+            auto start = std::chrono::steady_clock::now();
+            unknown_cluster_add(feat.data(), uniform(rng), camera, clock_us, &result);
+            add_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                          start).count();
+            faces++;
+            uploads += result.upload;
+            members[result.cluster_id][person]++;
+            while (unknown_cluster_next_report(clock_us, &report)) {
+                reports++;
+            }
+        }
+    }
+    while (unknown_cluster_next_report(INT64_MAX, &report)) {
+        reports++;
+    }
+
+    int majority = 0;
+    int mixed = 0;
+    for (const auto& cluster : members) {
+        int best = 0;
+        for (const auto& person : cluster.second) {
+            best = std::max(best, person.second);
+        }
+        majority += best;
+        mixed += cluster.second.size() > 1;
+    }
+    int people_seen = (int)std::count(seen.begin(), seen.end(), true);
+    face_upload_meta_t meta = {};
+    meta.feat_type = FACE_UPLOAD_FEAT_I8;
+    meta.feat_len = feat_len;
+    size_t upload_bytes = face_upload_object_len(&meta) + FACE_UPLOAD_CHUNK_HEADER_LEN;
+    uint64_t bytes = (uint64_t)uploads * upload_bytes + (uint64_t)reports * FACE_UPLOAD_SIGHTING_LEN;
+    unknown_cluster_stats_t stats;
+    unknown_cluster_get_stats(&stats);
+    printf("%d faces of %d strangers (%d visits x %d frames), capacity %zu\n", faces, people_seen, opt.visits,
+           opt.burst, opt.capacity);
+    printf("uploads: %d without clustering, %d with (%.1f%% fewer), %d sighting reports\n", faces, uploads,
+           100.0 * (faces - uploads) / faces, reports);
+    printf("uplink: %.0f KB without, %.0f KB with (embedding-only, %zu bytes/upload)\n",
+           faces * upload_bytes / 1024.0, bytes / 1024.0, upload_bytes);
+    printf("clusters: %u created (%.2f per stranger), %u expired, %u evicted, purity %.1f%%, %d mixed\n",
+           stats.clusters, (double)stats.clusters / std::max(1, people_seen), stats.expired, stats.evicted,
+           100.0 * majority / faces, mixed);
+    printf("clustering: %.0f ns/face\n", (double)add_ns / faces);
+    unknown_cluster_deinit();
+    return 0;
+}
+
+// Capacity planning: builds (or loads) an index of synthetic faces, then identifies noisy
+// sightings of indexed faces (cosine ~0.9, as send --people) for every --ef.
+int run_ann_bench(const Options& opt) {
+    HnswIndex index(index_params(opt));
+    std::mt19937 rng(7);
+    std::vector<float> feat(index.dim());
+    if (!opt.index_path.empty() && index.load(opt.index_path)) {
+        printf("Index %s: %zu faces\n", opt.index_path.c_str(), index.size());
+    } else {
+        int64_t start = now_us();
+        size_t step = std::max<size_t>(1, opt.size / 10);
+        for (size_t i = 0; i < opt.size; i++) {
+            random_face(rng, feat);
+            index.add(feat.data());
+            if ((i + 1) % step == 0) {
+                printf("  %zu faces, %.0f inserts/s\n", i + 1, (i + 1) * 1e6 / (now_us() - start));
+                fflush(stdout);
+            }
+        }
+        printf("Built %zu faces in %.1f s (M %d, ef_construction %d)\n", index.size(), (now_us() - start) / 1e6,
+               opt.M, opt.ef_construction);
+    }
+    printf("Memory %.0f MB, %.0f bytes/face\n", index.memory_bytes() / 1048576.0,
+           (double)index.memory_bytes() / index.size());
+    if (!opt.save_path.empty() && !index.save(opt.save_path)) {
+        fprintf(stderr, "Cannot save the index to %s\n", opt.save_path.c_str());
+    }
+
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<std::vector<float>> queries(opt.queries, std::vector<float>(index.dim()));
+    std::vector<uint32_t> truth(opt.queries);
+    for (int q = 0; q < opt.queries; q++) {
+        truth[q] = (uint32_t)(rng() % index.size());
+        index.get(truth[q], queries[q].data());
+        for (float& x : queries[q]) {
+            x += normal(rng) * 0.5f / std::sqrt((float)index.dim());
+        }
+        normalize(queries[q]);
+    }
+    // Exact top-k of the first queries, for the recall, and the brute-force cost it replaces
+    size_t exact_n = std::min<size_t>(opt.queries, 200);
+    std::vector<std::vector<HnswIndex::Result>> exact(exact_n);
+    std::vector<int64_t> exact_us;
+    for (size_t q = 0; q < exact_n; q++) {
+        int64_t start = now_us();
+        exact[q] = index.exact_search(queries[q].data(), opt.k);
+        exact_us.push_back(now_us() - start);
+    }
+    printf("Linear scan: p50 %.2f ms per query\n", percentile_ms(exact_us, 0.5));
+
+    for (int ef : opt.efs) {
+        std::vector<std::vector<HnswIndex::Result>> results(opt.queries);
+        std::vector<std::vector<int64_t>> latencies(opt.threads);
+        int64_t start = now_us();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < opt.threads; t++) {
+            workers.emplace_back([&, t]() {
+                for (int q = t; q < opt.queries; q += opt.threads) {
+                    int64_t begin = now_us();
+                    results[q] = index.search(queries[q].data(), opt.k, ef);
+                    latencies[t].push_back(now_us() - begin);
+                }
+            });
+        }
+        for (std::thread& w : workers) {
+            w.join();
+        }
+        int64_t wall = now_us() - start;
+        std::vector<int64_t> all;
+        for (const auto& l : latencies) {
+            all.insert(all.end(), l.begin(), l.end());
+        }
+        int top1 = 0;
+        for (int q = 0; q < opt.queries; q++) {
+            top1 += !results[q].empty() && results[q].front().id == truth[q];
+        }
+        size_t found = 0;
+        size_t wanted = 0;
+        for (size_t q = 0; q < exact_n; q++) {
+            for (const HnswIndex::Result& e : exact[q]) {
+                wanted++;
+                found += std::any_of(results[q].begin(), results[q].end(),
+                                     [&](const HnswIndex::Result& r) { return r.id == e.id; });
+            }
+        }
+        printf("ef %d: p50 %.0f us p95 %.0f us p99 %.0f us, %.0f queries/s (%d threads), recall@1 %.1f%%, "
+               "recall@%d %.1f%%\n",
+               ef, percentile_ms(all, 0.5) * 1000, percentile_ms(all, 0.95) * 1000, percentile_ms(all, 0.99) * 1000,
+               opt.queries * 1e6 / wall, opt.threads, 100.0 * top1 / opt.queries, opt.k,
+               100.0 * found / std::max<size_t>(1, wanted));
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        fprintf(stderr,
+                "usage: %s receive [--host H] [--port P] [--topic T] [--out DIR] [--request-every N] [--count N] "
+                "[--identify] [--ttl S] [--top-k K] [--ef N] [--index FILE] [--preload N]\n"
+                "       %s send [--host H] [--port P] [--topic T] [--chunk N] [--window N] [--repeat N] "
+                "[--camera N] [--embedding-only] [--linger MS] FILE...\n"
+                "       %s cluster-bench [--people N] [--visits N] [--burst N] [--capacity N]\n"
+                "       %s ann-bench [--size N] [--queries N] [--k N] [--ef N,N...] [--M N] [--ef-construction N] "
+                "[--threads N] [--index FILE] [--save FILE]\n",
+                argv[0], argv[0], argv[0], argv[0]);
+        return 2;
+    }
+    if (opt.mode == "cluster-bench") {
+        return run_cluster_bench(opt);
+    }
+    if (opt.mode == "ann-bench") {
+        return run_ann_bench(opt);
+    }
+    return opt.mode == "receive" ? run_receive(opt) : run_send(opt);
+}
@@ -0,0 +1,307 @@
+#include "mqtt_lite.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+enum : uint8_t {
+    CONNECT = 0x10,
+    CONNACK = 0x20,
+    PUBLISH = 0x30,
+    PUBACK = 0x40,
+    SUBSCRIBE = 0x82, // reserved flags 0b0010
+    SUBACK = 0x90,
+    PINGREQ = 0xC0,
+    PINGRESP = 0xD0,
+    DISCONNECT = 0xE0,
+};
+
+int64_t now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void put_u16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(v >> 8);
+    out.push_back(v & 0xFF);
+}
+
+void put_str(std::vector<uint8_t>& out, const std::string& s) {
+    put_u16(out, (uint16_t)s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+} // namespace
+
+MqttClient::~MqttClient() {
+    disconnect();
+}
+
+uint16_t MqttClient::next_id() {
+    if (m_next_id == 0) {
+        m_next_id = 1; // 0 is not a valid packet id
+    }
+    return m_next_id++;
+}
+
+bool MqttClient::connect(const std::string& host, int port, const std::string& client_id, int keepalive_s) {
+    disconnect();
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0) {
+        fprintf(stderr, "mqtt: cannot resolve %s\n", host.c_str());
+        return false;
+    }
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            m_fd = fd;
+            break;
+        }
+        close(fd);
+    }
+    freeaddrinfo(res);
+    if (m_fd < 0) {
+        fprintf(stderr, "mqtt: cannot connect to %s:%d\n", host.c_str(), port);
+        return false;
+    }
+    int one = 1;
+    setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    m_keepalive_s = keepalive_s;
+    std::vector<uint8_t> body;
+    put_str(body, "MQTT");
+    body.push_back(4);    // protocol level 3.1.1
+    body.push_back(0x02); // clean session
+    put_u16(body, (uint16_t)keepalive_s);
+    put_str(body, client_id);
+    m_connack = false;
+    if (!send_packet(CONNECT, body)) {
+        return false;
+    }
+    int64_t deadline = now_ms() + 5000;
+    while (!m_connack && m_fd >= 0 && now_ms() < deadline) {
+        loop(100);
+    }
+    if (!m_connack) {
+        fprintf(stderr, "mqtt: no CONNACK from %s:%d\n", host.c_str(), port);
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+void MqttClient::disconnect() {
+    if (m_fd >= 0) {
+        send_packet(DISCONNECT, {});
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_rx.clear();
+}
+
+bool MqttClient::subscribe(const std::string& topic, int qos) {
+    std::vector<uint8_t> body;
+    uint16_t id = next_id();
+    put_u16(body, id);
+    put_str(body, topic);
+    body.push_back((uint8_t)qos);
+    m_suback_id = -1;
+    if (!send_packet(SUBSCRIBE, body)) {
+        return false;
+    }
+    int64_t deadline = now_ms() + 5000;
+    while (m_suback_id != id && m_fd >= 0 && now_ms() < deadline) {
+        loop(100);
+    }
+    return m_suback_id == id;
+}
+
+int MqttClient::publish(const std::string& topic, const void* data, size_t len, int qos, bool retain) {
+    std::vector<uint8_t> body;
+    body.reserve(topic.size() + len + 4);
+    put_str(body, topic);
+    uint16_t id = 0;
+    if (qos > 0) {
+        id = next_id();
+        put_u16(body, id);
+    }
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    body.insert(body.end(), p, p + len);
+    uint8_t flags = (uint8_t)((qos & 0x3) << 1) | (retain ? 1 : 0);
+    if (!send_packet(PUBLISH | flags, body)) {
+        return -1;
+    }
+    return id;
+}
+
+bool MqttClient::send_packet(uint8_t type_flags, const std::vector<uint8_t>& body) {
+    if (m_fd < 0) {
+        return false;
+    }
+    uint8_t header[5];
+    size_t n = 0;
+    header[n++] = type_flags;
+    size_t remaining = body.size();
+    do {
+        uint8_t byte = remaining % 128;
+        remaining /= 128;
+        header[n++] = byte | (remaining > 0 ? 0x80 : 0);
+    } while (remaining > 0 && n < sizeof(header));
+
+    iovec parts[2] = { { header, n }, { (void*)body.data(), body.size() } };
+    size_t total = n + body.size();
+    size_t sent = 0;
+    while (sent < total) {
+        msghdr msg = {};
+        // Skip what was already sent
+        iovec iov[2];
+        int cnt = 0;
+        size_t skip = sent;
+        for (auto& part : parts) {
+            if (skip >= part.iov_len) {
+                skip -= part.iov_len;
+                continue;
+            }
+            iov[cnt].iov_base = (uint8_t*)part.iov_base + skip;
+            iov[cnt].iov_len = part.iov_len - skip;
+            skip = 0;
+            cnt++;
+        }
+        msg.msg_iov = iov;
+        msg.msg_iovlen = cnt;
+        ssize_t r = sendmsg(m_fd, &msg, MSG_NOSIGNAL);
+        if (r <= 0) {
+            close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+        sent += (size_t)r;
+    }
+    m_last_tx_ms = now_ms();
+    return true;
+}
+
+bool MqttClient::read_available(int timeout_ms) {
+    pollfd pfd = { m_fd, POLLIN, 0 };
+    int r = poll(&pfd, 1, timeout_ms);
+    if (r <= 0) {
+        return r == 0;
+    }
+    uint8_t buf[16384];
+    ssize_t n = recv(m_fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_rx.insert(m_rx.end(), buf, buf + n);
+    return true;
+}
+
+bool MqttClient::loop(int timeout_ms) {
+    if (m_fd < 0) {
+        return false;
+    }
+    if (m_keepalive_s > 0 && now_ms() - m_last_tx_ms > m_keepalive_s * 500) {
+        send_packet(PINGREQ, {});
+    }
+    if (!read_available(timeout_ms)) {
+        return false;
+    }
+    return dispatch();
+}
+
+// Handles every complete packet in the receive buffer
+bool MqttClient::dispatch() {
+    size_t pos = 0;
+    while (m_fd >= 0) {
+        // Fixed header: type byte + remaining length (1-4 bytes)
+        size_t avail = m_rx.size() - pos;
+        if (avail < 2) {
+            break;
+        }
+        size_t remaining = 0;
+        size_t n = 1;
+        int shift = 0;
+        bool complete = false;
+        while (n < avail && n <= 4) {
+            uint8_t byte = m_rx[pos + n++];
+            remaining |= (size_t)(byte & 0x7F) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete || avail < n + remaining) {
+            break;
+        }
+        uint8_t type = m_rx[pos] & 0xF0;
+        uint8_t flags = m_rx[pos] & 0x0F;
+        const uint8_t* body = m_rx.data() + pos + n;
+        pos += n + remaining;
+
+        switch (type) {
+        case CONNACK:
+            m_connack = remaining >= 2 && body[1] == 0;
+            if (!m_connack) {
+                fprintf(stderr, "mqtt: connection refused, code %d\n", remaining >= 2 ? body[1] : -1);
+            }
+            break;
+        case SUBACK:
+            if (remaining >= 2) {
+                m_suback_id = (body[0] << 8) | body[1];
+            }
+            break;
+        case PUBACK:
+            if (remaining >= 2 && m_on_puback) {
+                m_on_puback((uint16_t)((body[0] << 8) | body[1]));
+            }
+            break;
+        case PUBLISH: {
+            if (remaining < 2) {
+                break;
+            }
+            size_t topic_len = (body[0] << 8) | body[1];
+            int qos = (flags >> 1) & 0x3;
+            size_t header_len = 2 + topic_len + (qos > 0 ? 2 : 0);
+            if (header_len > remaining) {
+                break;
+            }
+            std::string topic((const char*)body + 2, topic_len);
+            if (qos == 1) {
+                send_packet(PUBACK, { body[2 + topic_len], body[3 + topic_len] });
+            }
+            if (m_on_message) {
+                m_on_message(topic, body + header_len, remaining - header_len);
+            }
+            break;
+        }
+        case PINGRESP:
+        default:
+            break;
+        }
+    }
+    if (m_fd < 0) {
+        m_rx.clear();
+        return false;
+    }
+    m_rx.erase(m_rx.begin(), m_rx.begin() + pos);
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @class MqttClient
+ * @brief Minimal MQTT 3.1.1 client over a plain TCP socket.
+ *
+ * Enough for the cloud tier: connect, subscribe and publish with QoS 0/1,
+ * PUBACK notifications. Single threaded: loop() reads the socket and calls
+ * the handlers. No TLS, put the broker (e.g. Mosquitto) on the same host
+ * or bridge it to AWS IoT.
+ */
+class MqttClient {
+public:
+    using MessageHandler = std::function<void(const std::string& topic, const uint8_t* data, size_t len)>;
+    using AckHandler = std::function<void(uint16_t msg_id)>;
+
+    MqttClient() = default;
+    ~MqttClient();
+    MqttClient(const MqttClient&) = delete;
+    MqttClient& operator=(const MqttClient&) = delete;
+
+    /**
+     * @brief Connects (clean session) and waits for the CONNACK.
+     * @return false on socket error, refusal or timeout.
+     */
+    bool connect(const std::string& host, int port, const std::string& client_id, int keepalive_s = 60);
+    void disconnect();
+    bool connected() const { return m_fd >= 0; }
+
+    /** @brief Subscribes and waits for the SUBACK, messages received meanwhile are dispatched. */
+    bool subscribe(const std::string& topic, int qos);
+
+    /**
+     * @brief Publishes a message (binary safe).
+     * @return The msg_id for QoS 1 (acknowledged through the AckHandler), 0 for QoS 0, -1 on error.
+     */
+    int publish(const std::string& topic, const void* data, size_t len, int qos, bool retain = false);
+
+    /**
+     * @brief Waits up to timeout_ms for data, dispatches every complete packet, sends keepalive pings.
+     * @return false if the connection was lost.
+     */
+    bool loop(int timeout_ms);
+
+    void on_message(MessageHandler handler) { m_on_message = std::move(handler); }
+    void on_puback(AckHandler handler) { m_on_puback = std::move(handler); }
+
+private:
+    bool send_packet(uint8_t type_flags, const std::vector<uint8_t>& body);
+    bool read_available(int timeout_ms);
+    bool dispatch();
+    uint16_t next_id();
+
+    int m_fd = -1;
+    int m_keepalive_s = 60;
+    int64_t m_last_tx_ms = 0;
+    uint16_t m_next_id = 1;
+    std::vector<uint8_t> m_rx;
+    bool m_connack = false;
+    int m_suback_id = -1;
+    MessageHandler m_on_message;
+    AckHandler m_on_puback;
+};
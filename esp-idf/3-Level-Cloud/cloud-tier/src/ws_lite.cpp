@@ -0,0 +1,303 @@
+#include "ws_lite.hpp"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace {
+
+enum : uint8_t {
+    CONTINUATION = 0x0,
+    TEXT = 0x1,
+    BINARY = 0x2,
+    CLOSE = 0x8,
+    PING = 0x9,
+    PONG = 0xA,
+    FIN = 0x80,
+    MASKED = 0x80,
+};
+
+int64_t now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+bool send_all(int fd, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        ssize_t r = send(fd, data, len, MSG_NOSIGNAL);
+        if (r <= 0) {
+            return false;
+        }
+        data += r;
+        len -= (size_t)r;
+    }
+    return true;
+}
+
+std::string base64(const uint8_t* data, size_t len) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16 | (i + 1 < len ? data[i + 1] << 8 : 0) | (i + 2 < len ? data[i + 2] : 0);
+        out += digits[v >> 18 & 63];
+        out += digits[v >> 12 & 63];
+        out += i + 1 < len ? digits[v >> 6 & 63] : '=';
+        out += i + 2 < len ? digits[v & 63] : '=';
+    }
+    return out;
+}
+
+} // namespace
+
+WsClient::~WsClient() {
+    disconnect();
+}
+
+bool WsClient::connect(const std::string& host, int port, const std::string& path, int timeout_ms) {
+    disconnect();
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0) {
+        fprintf(stderr, "ws: cannot resolve %s\n", host.c_str());
+        return false;
+    }
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            m_fd = fd;
+            break;
+        }
+        close(fd);
+    }
+    freeaddrinfo(res);
+    if (m_fd < 0) {
+        fprintf(stderr, "ws: cannot connect to %s:%d\n", host.c_str(), port);
+        return false;
+    }
+    int one = 1;
+    setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    std::random_device rd;
+    m_mask_seed = rd() | 1;
+    uint8_t key[16];
+    for (uint8_t& b : key) {
+        b = (uint8_t)rd();
+    }
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + ":" + std::to_string(port) +
+                          "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: " +
+                          base64(key, sizeof(key)) + "\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    if (!send_all(m_fd, (const uint8_t*)request.data(), request.size())) {
+        disconnect();
+        return false;
+    }
+    // Status line and headers, frames may follow in the same read
+    int64_t deadline = now_ms() + timeout_ms;
+    const char* end_marker = "\r\n\r\n";
+    while (m_fd >= 0 && now_ms() < deadline) {
+        auto end = std::search(m_rx.begin(), m_rx.end(), end_marker, end_marker + 4);
+        if (end != m_rx.end()) {
+            std::string status(m_rx.begin(), std::find(m_rx.begin(), end, '\r'));
+            m_rx.erase(m_rx.begin(), end + 4);
+            if (status.compare(0, 9, "HTTP/1.1 ") != 0 || status.compare(9, 3, "101") != 0) {
+                fprintf(stderr, "ws: upgrade refused: %s\n", status.c_str());
+                disconnect();
+                return false;
+            }
+            return true;
+        }
+        if (!read_available((int)std::max<int64_t>(1, deadline - now_ms()))) {
+            break;
+        }
+    }
+    fprintf(stderr, "ws: no upgrade answer from %s:%d\n", host.c_str(), port);
+    disconnect();
+    return false;
+}
+
+void WsClient::disconnect() {
+    if (m_fd >= 0) {
+        uint8_t code[2] = { 0x03, 0xE8 }; // 1000, normal closure
+        send_frame(CLOSE, code, sizeof(code));
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_rx.clear();
+    m_fragments.clear();
+    m_binary = false;
+}
+
+bool WsClient::send_text(const std::string& text) {
+    return send_frame(TEXT, text.data(), text.size());
+}
+
+bool WsClient::send_binary(const void* data, size_t len) {
+    return send_frame(BINARY, data, len);
+}
+
+// One final frame, masked as a client must
+bool WsClient::send_frame(uint8_t opcode, const void* data, size_t len) {
+    if (m_fd < 0) {
+        return false;
+    }
+    m_tx.clear();
+    m_tx.push_back(FIN | opcode);
+    if (len < 126) {
+        m_tx.push_back(MASKED | (uint8_t)len);
+    } else if (len <= 0xFFFF) {
+        m_tx.push_back(MASKED | 126);
+        m_tx.push_back((uint8_t)(len >> 8));
+        m_tx.push_back((uint8_t)len);
+    } else {
+        m_tx.push_back(MASKED | 127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            m_tx.push_back((uint8_t)((uint64_t)len >> shift));
+        }
+    }
+    // xorshift32: masks only need to be unpredictable to intermediaries, not secret
+    m_mask_seed ^= m_mask_seed << 13;
+    m_mask_seed ^= m_mask_seed >> 17;
+    m_mask_seed ^= m_mask_seed << 5;
+    uint8_t mask[4] = { (uint8_t)(m_mask_seed >> 24), (uint8_t)(m_mask_seed >> 16), (uint8_t)(m_mask_seed >> 8),
+                        (uint8_t)m_mask_seed };
+    m_tx.insert(m_tx.end(), mask, mask + 4);
+    size_t header = m_tx.size();
+    m_tx.resize(header + len);
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+        m_tx[header + i] = p[i] ^ mask[i & 3];
+    }
+    if (!send_all(m_fd, m_tx.data(), m_tx.size())) {
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool WsClient::read_available(int timeout_ms) {
+    pollfd pfd = { m_fd, POLLIN, 0 };
+    int r = poll(&pfd, 1, timeout_ms);
+    if (r <= 0) {
+        return r == 0;
+    }
+    uint8_t buf[16384];
+    ssize_t n = recv(m_fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_rx.insert(m_rx.end(), buf, buf + n);
+    return true;
+}
+
+bool WsClient::loop(int timeout_ms) {
+    if (m_fd < 0) {
+        return false;
+    }
+    // Frames left over from the handshake or an earlier read first
+    if (!m_rx.empty() && !dispatch()) {
+        return false;
+    }
+    if (!read_available(timeout_ms)) {
+        return false;
+    }
+    return dispatch();
+}
+
+// Handles every complete frame in the receive buffer
+bool WsClient::dispatch() {
+    size_t pos = 0;
+    while (m_fd >= 0) {
+        size_t avail = m_rx.size() - pos;
+        if (avail < 2) {
+            break;
+        }
+        const uint8_t* h = m_rx.data() + pos;
+        bool fin = h[0] & FIN;
+        uint8_t opcode = h[0] & 0x0F;
+        bool masked = h[1] & MASKED;
+        uint64_t len = h[1] & 0x7F;
+        size_t n = 2;
+        if (len == 126 || len == 127) {
+            size_t bytes = len == 126 ? 2 : 8;
+            if (avail < n + bytes) {
+                break;
+            }
+            len = 0;
+            for (size_t i = 0; i < bytes; i++) {
+                len = len << 8 | h[n + i];
+            }
+            n += bytes;
+        }
+        uint8_t mask[4] = { 0, 0, 0, 0 };
+        if (masked) { // servers must not, but accept it
+            if (avail < n + 4) {
+                break;
+            }
+            memcpy(mask, h + n, 4);
+            n += 4;
+        }
+        if (avail < n + len) {
+            break;
+        }
+        std::string payload((const char*)h + n, (size_t)len);
+        if (masked) {
+            for (size_t i = 0; i < payload.size(); i++) {
+                payload[i] ^= mask[i & 3];
+            }
+        }
+        pos += n + (size_t)len;
+
+        switch (opcode) {
+        case BINARY: // the S3 sends none, skipped with its continuations
+            m_binary = !fin;
+            break;
+        case TEXT:
+        case CONTINUATION:
+            if (opcode == CONTINUATION && m_binary) {
+                m_binary = !fin;
+                break;
+            }
+            m_fragments += payload;
+            if (fin) {
+                if (m_on_text) {
+                    m_on_text(m_fragments);
+                }
+                m_fragments.clear();
+            }
+            break;
+        case PING:
+            send_frame(PONG, payload.data(), payload.size());
+            break;
+        case CLOSE:
+            send_frame(CLOSE, payload.data(), std::min<size_t>(payload.size(), 2));
+            close(m_fd);
+            m_fd = -1;
+            break;
+        case PONG:
+        default:
+            break;
+        }
+    }
+    if (m_fd < 0) {
+        m_rx.clear();
+        return false;
+    }
+    m_rx.erase(m_rx.begin(), m_rx.begin() + pos);
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @class WsClient
+ * @brief Minimal WebSocket (RFC 6455) client over a plain TCP socket.
+ *
+ * Enough to stand in for the ESP32-CAM: connect, send text and binary
+ * messages (one masked frame each, as esp_websocket_client sends them),
+ * receive text messages. Single threaded: loop() reads the socket and calls
+ * the handler, answers pings. No TLS, no extensions, the accept key of the
+ * server is not checked.
+ */
+class WsClient {
+public:
+    using TextHandler = std::function<void(const std::string& text)>;
+
+    WsClient() = default;
+    ~WsClient();
+    WsClient(const WsClient&) = delete;
+    WsClient& operator=(const WsClient&) = delete;
+
+    /**
+     * @brief Connects and waits for the 101 answer to the upgrade request.
+     * @return false on socket error, refusal or timeout.
+     */
+    bool connect(const std::string& host, int port, const std::string& path, int timeout_ms = 5000);
+    void disconnect();
+    bool connected() const { return m_fd >= 0; }
+
+    bool send_text(const std::string& text);
+    bool send_binary(const void* data, size_t len);
+
+    /**
+     * @brief Waits up to timeout_ms for data, dispatches every complete text message.
+     * @return false if the connection was lost or closed by the server.
+     */
+    bool loop(int timeout_ms);
+
+    void on_text(TextHandler handler) { m_on_text = std::move(handler); }
+
+private:
+    bool send_frame(uint8_t opcode, const void* data, size_t len);
+    bool read_available(int timeout_ms);
+    bool dispatch();
+
+    int m_fd = -1;
+    uint32_t m_mask_seed = 0;
+    std::vector<uint8_t> m_rx;
+    std::vector<uint8_t> m_tx;
+    std::string m_fragments; // text message continued in later frames
+    bool m_binary = false;   // in a fragmented binary message
+    TextHandler m_on_text;
+};
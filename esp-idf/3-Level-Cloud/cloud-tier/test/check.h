@@ -0,0 +1,48 @@
+/**
+ * @file check.h
+ * @brief Checks of the host tests: a failed one is printed and counted, the test goes on.
+ *
+ * main() ends with `return check_summary("name");`, 0 when every check passed.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+
+static int s_check_count;
+static int s_check_failed;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        s_check_count++;                                                             \
+        if (!(cond)) {                                                               \
+            s_check_failed++;                                                        \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        }                                                                            \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                             \
+    do {                                                                                                       \
+        long long a_ = (long long)(actual), e_ = (long long)(expected);                                        \
+        s_check_count++;                                                                                       \
+        if (a_ != e_) {                                                                                        \
+            s_check_failed++;                                                                                  \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_);       \
+        }                                                                                                      \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                                                                \
+    do {                                                                                                       \
+        double a_ = (double)(actual), e_ = (double)(expected);                                                 \
+        s_check_count++;                                                                                       \
+        if (!(fabs(a_ - e_) <= (tolerance))) {                                                                 \
+            s_check_failed++;                                                                                  \
+            fprintf(stderr, "%s:%d: %s is %g, expected %g\n", __FILE__, __LINE__, #actual, a_, e_);           \
+        }                                                                                                      \
+    } while (0)
+
+static inline int check_summary(const char* name) {
+    printf("%s: %d checks, %d failed\n", name, s_check_count, s_check_failed);
+    return s_check_failed ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file sim_partition.c
+ * @brief One simulated flash data partition behind esp_partition.h, for the modules that store on flash.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "esp_partition.h"
+
+#define SECTOR_SIZE 4096
+
+sim_partition_t *sim_partition;
+static size_t s_mapped;
+
+void sim_partition_create(const char *label, uint32_t size) {
+    if (sim_partition) {
+        munmap(sim_partition, s_mapped);
+    }
+    s_mapped = sizeof(sim_partition_t) + size;
+    sim_partition = mmap(NULL, s_mapped, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    memset(sim_partition, 0, sizeof(*sim_partition));
+    sim_partition->partition.type = ESP_PARTITION_TYPE_DATA;
+    sim_partition->partition.size = size;
+    sim_partition->partition.erase_size = SECTOR_SIZE;
+    sim_partition->partition.label = label;
+    sim_partition->data = (uint8_t *)(sim_partition + 1);
+    memset(sim_partition->data, 0xFF, size);
+}
+
+// Counts down to a power loss, true for the operation it cuts
+static bool power_lost(void) {
+    return sim_partition->power_loss_after > 0 && --sim_partition->power_loss_after == 0;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    (void)subtype;
+    if (!sim_partition) {
+        return NULL;
+    }
+    const esp_partition_t *p = &sim_partition->partition;
+    if (type != p->type || (label && strcmp(label, p->label) != 0)) {
+        return NULL;
+    }
+    return p;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) {
+    if (src_offset > partition->size || size > partition->size - src_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, sim_partition->data + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) {
+    if (dst_offset > partition->size || size > partition->size - dst_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    bool lost = power_lost();
+    const uint8_t *s = src;
+    uint8_t *d = sim_partition->data + dst_offset;
+    for (size_t i = 0; i < (lost ? size / 2 : size); i++) {
+        if (s[i] & ~d[i]) {
+            sim_partition->set_bits++;
+        }
+        d[i] &= s[i];
+    }
+    if (lost) {
+        _exit(SIM_POWER_LOSS_EXIT);
+    }
+    sim_partition->writes++;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    if (offset % SECTOR_SIZE || size % SECTOR_SIZE || offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool lost = power_lost();
+    memset(sim_partition->data + offset, 0xFF, lost ? size / 2 : size);
+    if (lost) {
+        _exit(SIM_POWER_LOSS_EXIT);
+    }
+    sim_partition->erases++;
+    return ESP_OK;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Partition API of ESP-IDF over one simulated data partition (test/sim_partition.c)
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    uint32_t size;
+    uint32_t erase_size;
+    const char *label;
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+
+// NOR flash: erased bytes read 0xFF, a write can only clear bits, erases are whole sectors. It lives in shared
+// memory: a test can run each boot of the firmware in a child process, a reset drops only the RAM state.
+#define SIM_POWER_LOSS_EXIT 99
+
+typedef struct {
+    esp_partition_t partition;
+    uint8_t *data;
+    uint32_t writes;
+    uint32_t erases;
+    uint32_t set_bits;          // writes that needed a 0 bit to become 1, the flash would have kept the 0
+    uint32_t power_loss_after;  // > 0: the write or erase that counts it down to 0 is cut halfway, then the
+                                // process exits with SIM_POWER_LOSS_EXIT
+} sim_partition_t;
+
+extern sim_partition_t *sim_partition;
+
+/** @brief Creates the partition, erased. */
+void sim_partition_create(const char *label, uint32_t size);
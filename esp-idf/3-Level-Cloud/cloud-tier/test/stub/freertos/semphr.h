@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+
+// One thread: a mutex is always free
+typedef void *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    static int mutex;
+    return &mutex;
+}
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks_to_wait) {
+    (void)ticks_to_wait;
+    return mutex != NULL ? pdTRUE : pdFALSE;
+}
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    return mutex != NULL ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,596 @@
+/**
+ * @file test_bme280.c
+ * @brief BME280 firmware of esp32-s3-wroom-1 (bme280.c, sampler.c, batches and offline store) on a simulated sensor.
+ *
+ * The sensor is a register map behind the I2C driver calls: chip id, calibration, a forced measurement
+ * that sets the status bit for its duration and then latches the ADC values. The sampler task and its
+ * timer run on the simulated clock, the published batches are decoded, the offline store writes to a
+ * simulated flash partition.
+ */
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "check.h"
+#include "config.h"
+#include "driver/i2c_master.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "bme280.h"
+#include "mqtt.h"
+#include "sampler.h"
+#include "telemetry_batch.h"
+#include "ts_store.h"
+
+#define SENSOR_ADDR 0x76 // the firmware tries 0x77 first
+#define HOUR_US (3600LL * 1000000)
+#define WALL_CLOCK_AT_BOOT_US 1760000000000000LL
+
+int64_t test_time_us = 1000000;
+
+/* Simulated BME280 */
+
+static struct {
+    uint8_t reg[256];
+    int64_t done_us;           // end of the measurement in progress, -1 for none
+    int32_t adc_t, adc_p, adc_h;
+    int32_t adc_t_alt;         // alternate: every other measurement reads this temperature
+    bool alternate;
+    uint32_t measurements;
+    uint32_t transactions;
+    uint32_t early_reads;      // data registers read while measuring
+} s_sensor;
+
+static int oversampling(int code) {
+    return code ? 1 << (code - 1) : 0;
+}
+
+static void put16(int reg, int value) {
+    s_sensor.reg[reg] = (uint8_t)value;
+    s_sensor.reg[reg + 1] = (uint8_t)(value >> 8);
+}
+
+// Power-on state, datasheet example calibration with the given humidity trimming H4/H5 (signed 12 bit)
+static void sensor_reset(int h4, int h5) {
+    memset(&s_sensor, 0, sizeof(s_sensor));
+    s_sensor.done_us = -1;
+    uint8_t *r = s_sensor.reg;
+    r[0xD0] = 0x60;
+    put16(0x88, 27504);
+    put16(0x8A, 26435);
+    put16(0x8C, -1000);
+    put16(0x8E, 36477);
+    put16(0x90, -10685);
+    put16(0x92, 3024);
+    put16(0x94, 2855);
+    put16(0x96, 140);
+    put16(0x98, -7);
+    put16(0x9A, 15500);
+    put16(0x9C, -14600);
+    put16(0x9E, 6000);
+    r[0xA1] = 75;
+    put16(0xE1, 362);
+    r[0xE3] = 0;
+    r[0xE4] = (uint8_t)(h4 >> 4);
+    r[0xE5] = (uint8_t)((h4 & 0x0F) | (h5 & 0x0F) << 4);
+    r[0xE6] = (uint8_t)(h5 >> 4);
+    r[0xE7] = 30;
+    r[0xF7] = r[0xFA] = r[0xFD] = 0x80; // data registers after reset
+}
+
+// Latches the ADC values once the measurement time has passed
+static void sensor_update(void) {
+    uint8_t *r = s_sensor.reg;
+    if (s_sensor.done_us < 0 || test_time_us < s_sensor.done_us) {
+        return;
+    }
+    int32_t adc_t = s_sensor.alternate && (s_sensor.measurements & 1) ? s_sensor.adc_t_alt : s_sensor.adc_t;
+    r[0xF7] = (uint8_t)(s_sensor.adc_p >> 12);
+    r[0xF8] = (uint8_t)(s_sensor.adc_p >> 4);
+    r[0xF9] = (uint8_t)(s_sensor.adc_p << 4);
+    r[0xFA] = (uint8_t)(adc_t >> 12);
+    r[0xFB] = (uint8_t)(adc_t >> 4);
+    r[0xFC] = (uint8_t)(adc_t << 4);
+    r[0xFD] = (uint8_t)(s_sensor.adc_h >> 8);
+    r[0xFE] = (uint8_t)s_sensor.adc_h;
+    r[0xF3] &= (uint8_t)~0x08;
+    r[0xF4] &= (uint8_t)~0x03; // back to sleep mode
+    s_sensor.done_us = -1;
+    s_sensor.measurements++;
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *config, i2c_master_bus_handle_t *bus) {
+    (void)config;
+    *bus = (i2c_master_bus_handle_t)&s_sensor;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus, uint16_t address, int timeout_ms) {
+    (void)bus;
+    (void)timeout_ms;
+    s_sensor.transactions++;
+    return address == SENSOR_ADDR ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus, const i2c_device_config_t *config,
+                                    i2c_master_dev_handle_t *dev) {
+    (void)bus;
+    CHECK_EQ(config->device_address, SENSOR_ADDR);
+    *dev = (i2c_master_dev_handle_t)&s_sensor;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t dev) {
+    (void)dev;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t dev, const uint8_t *write, size_t write_len, int timeout_ms) {
+    (void)dev;
+    (void)timeout_ms;
+    s_sensor.transactions++;
+    sensor_update();
+    for (size_t i = 1; i < write_len; i++) {
+        uint8_t reg = (uint8_t)(write[0] + i - 1);
+        if (reg == 0xE0) {
+            continue; // soft reset, the registers keep the test's state
+        }
+        s_sensor.reg[reg] = write[i];
+        if (reg == 0xF4 && (write[i] & 0x03) == 0x01) {
+            // Forced mode: typical time (datasheet 9.1), less than the maximum the firmware waits for
+            int t = oversampling(write[i] >> 5), p = oversampling((write[i] >> 2) & 7);
+            int h = oversampling(s_sensor.reg[0xF2] & 7);
+            int64_t us = 1000 + 2000 * t + (p ? 2000 * p + 500 : 0) + (h ? 2000 * h + 500 : 0);
+            s_sensor.done_us = test_time_us + us;
+            s_sensor.reg[0xF3] |= 0x08;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t dev, const uint8_t *write, size_t write_len,
+                                      uint8_t *read, size_t read_len, int timeout_ms) {
+    (void)dev;
+    (void)write_len;
+    (void)timeout_ms;
+    s_sensor.transactions++;
+    sensor_update();
+    uint8_t reg = write[0];
+    if ((s_sensor.reg[0xF3] & 0x08) && reg + read_len > 0xF7 && reg <= 0xFE && reg != 0xF3) {
+        s_sensor.early_reads++; // the burst from 0xF3 is fine, its status byte says to wait
+    }
+    memcpy(read, s_sensor.reg + reg, read_len);
+    return ESP_OK;
+}
+
+/* Sampler task and timer on the simulated clock */
+
+static struct {
+    TaskFunction_t task;
+    bool notified;
+    jmp_buf idle;                // where the task goes back to wait for a notification
+    esp_timer_cb_t timer_callback;
+    int64_t timer_at;            // -1 when stopped
+} s_rtos = { .timer_at = -1 };
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stack_depth, void *arg, UBaseType_t priority,
+                       TaskHandle_t *handle) {
+    (void)name;
+    (void)stack_depth;
+    (void)arg;
+    (void)priority;
+    s_rtos.task = task;
+    *handle = (TaskHandle_t)&s_rtos;
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    test_time_us += (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    (void)task;
+    s_rtos.notified = true;
+    return pdPASS;
+}
+
+// The task waits at the top of its loop: without a notification it is left there, back in run_task()
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    (void)clear_on_exit;
+    (void)ticks_to_wait;
+    if (!s_rtos.notified) {
+        longjmp(s_rtos.idle, 1);
+    }
+    s_rtos.notified = false;
+    return 1;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *timer) {
+    s_rtos.timer_callback = args->callback;
+    *timer = (esp_timer_handle_t)&s_rtos;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    (void)timer;
+    s_rtos.timer_at = test_time_us + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    (void)timer;
+    s_rtos.timer_at = -1;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    (void)timer;
+    return ESP_OK;
+}
+
+// Wall clock as if SNTP had set it at boot, moving with the simulated uptime: the batches are stamped with it
+int gettimeofday(struct timeval *restrict tv, void *restrict tz) {
+    (void)tz;
+    int64_t us = WALL_CLOCK_AT_BOOT_US + test_time_us;
+    tv->tv_sec = (time_t)(us / 1000000);
+    tv->tv_usec = (suseconds_t)(us % 1000000);
+    return 0;
+}
+
+static void run_task(void) {
+    if (setjmp(s_rtos.idle) == 0) {
+        s_rtos.task(NULL);
+    }
+}
+
+// Runs the task whenever it is notified and the timer when it is due, then sets the clock to end_us
+static void run_until(int64_t end_us) {
+    while (true) {
+        if (s_rtos.notified) {
+            run_task();
+        } else if (s_rtos.timer_at >= 0 && s_rtos.timer_at <= end_us) {
+            test_time_us = s_rtos.timer_at;
+            s_rtos.timer_at = -1;
+            s_rtos.timer_callback(NULL);
+        } else {
+            break;
+        }
+    }
+    test_time_us = end_us;
+}
+
+/* MQTT: the batches are decoded as they are published */
+
+#define MAX_RECEIVED 4096
+#define MAX_TOPICS 8
+
+static struct {
+    bool connected;
+    const char *topics[MAX_TOPICS];
+    int topic_count;
+    uint32_t publishes;
+    uint32_t bad_batches;
+    uint32_t not_unix;         // samples without TELEMETRY_FLAG_UNIX_TIME
+    telemetry_sample_t received[MAX_RECEIVED];
+    int received_count;
+} s_mqtt = { .connected = true };
+
+bool mqtt_is_connected(void) {
+    return s_mqtt.connected;
+}
+
+mqtt_topic_t mqtt_topic_register(const char *topic) {
+    for (int i = 0; i < s_mqtt.topic_count; i++) {
+        if (strcmp(s_mqtt.topics[i], topic) == 0) {
+            return i;
+        }
+    }
+    if (s_mqtt.topic_count == MAX_TOPICS) {
+        return MQTT_TOPIC_INVALID;
+    }
+    s_mqtt.topics[s_mqtt.topic_count] = topic;
+    return s_mqtt.topic_count++;
+}
+
+int mqtt_publish_topic(esp_mqtt_client_handle_t client, mqtt_topic_t topic, const void *data, int len, int qos,
+                       int retain) {
+    (void)client;
+    (void)qos;
+    (void)retain;
+    if (!s_mqtt.connected || topic < 0 || topic >= s_mqtt.topic_count) {
+        return -1;
+    }
+    s_mqtt.publishes++;
+    if (strcmp(s_mqtt.topics[topic], MQTT_TOPIC_BME280 "/batch") == 0) {
+        int fields;
+        uint8_t flags;
+        int n = telemetry_batch_decode(data, (size_t)len, &fields, &flags, s_mqtt.received + s_mqtt.received_count,
+                                       MAX_RECEIVED - s_mqtt.received_count);
+        if (n < 0 || fields != 3) {
+            s_mqtt.bad_batches++;
+            return 1;
+        }
+        if (!(flags & TELEMETRY_FLAG_UNIX_TIME)) {
+            s_mqtt.not_unix += n;
+        }
+        s_mqtt.received_count += n;
+    }
+    return 1;
+}
+
+esp_err_t mqtt_topic_get_stats(mqtt_topic_t topic, mqtt_topic_stats_t *stats) {
+    (void)topic;
+    memset(stats, 0, sizeof(*stats));
+    return ESP_OK;
+}
+
+/* Double-precision compensation of the datasheet (8.1), calibration as sensor_reset() */
+
+static double ref_t_fine;
+
+static double ref_temperature(int32_t adc) {
+    const double t1 = 27504, t2 = 26435, t3 = -1000;
+    double v1 = (adc / 16384.0 - t1 / 1024.0) * t2;
+    double v2 = (adc / 131072.0 - t1 / 8192.0) * (adc / 131072.0 - t1 / 8192.0) * t3;
+    ref_t_fine = v1 + v2;
+    return ref_t_fine / 5120.0;
+}
+
+static double ref_pressure(int32_t adc) {
+    const double p1 = 36477, p2 = -10685, p3 = 3024, p4 = 2855, p5 = 140, p6 = -7, p7 = 15500, p8 = -14600, p9 = 6000;
+    double v1 = ref_t_fine / 2.0 - 64000.0;
+    double v2 = v1 * v1 * p6 / 32768.0;
+    v2 = v2 + v1 * p5 * 2.0;
+    v2 = v2 / 4.0 + p4 * 65536.0;
+    v1 = (p3 * v1 * v1 / 524288.0 + p2 * v1) / 524288.0;
+    v1 = (1.0 + v1 / 32768.0) * p1;
+    double p = 1048576.0 - adc;
+    p = (p - v2 / 4096.0) * 6250.0 / v1;
+    v1 = p9 * p * p / 2147483648.0;
+    v2 = p * p8 / 32768.0;
+    return p + (v1 + v2 + p7) / 16.0;
+}
+
+static double ref_humidity(int32_t adc, int h4, int h5) {
+    const double h1 = 75, h2 = 362, h3 = 0, h6 = 30;
+    double h = ref_t_fine - 76800.0;
+    h = (adc - (h4 * 64.0 + h5 / 16384.0 * h)) * (h2 / 65536.0 * (1.0 + h6 / 67108864.0 * h * (1.0 + h3 / 67108864.0 * h)));
+    h = h * (1.0 - h1 * h / 524288.0);
+    return h > 100 ? 100 : h < 0 ? 0 : h;
+}
+
+/* Tests */
+
+static void test_init(void) {
+    // Another chip at the address: not taken, init can be retried
+    sensor_reset(324, -30);
+    s_sensor.reg[0xD0] = 0x58; // BMP280
+    CHECK_EQ(bme280_init(), ESP_ERR_NOT_FOUND);
+    bme280_reading_t reading;
+    CHECK_EQ(bme280_read_data(&reading), ESP_ERR_INVALID_STATE);
+
+    sensor_reset(324, -30);
+    CHECK_EQ(bme280_init(), ESP_OK);
+    // Probes of 0x77 and 0x76, chip id, reset, two calibration bursts, ctrl_hum, config
+    CHECK_EQ(s_sensor.transactions, 8);
+    CHECK_EQ(s_sensor.reg[0xF2], 1); // humidity x1
+    CHECK_EQ(s_sensor.reg[0xF5], 0); // IIR filter off
+    CHECK_EQ(s_sensor.reg[0xF4] & 0x03, 0); // asleep until the first forced measurement
+    CHECK_EQ(s_sensor.measurements, 0);
+}
+
+// Datasheet example: adc_T 519888 is 25.08 °C, adc_P 415148 is 100653.27 Pa (floating point version)
+static void test_forced_measurement(void) {
+    s_sensor.adc_t = 519888;
+    s_sensor.adc_p = 415148;
+    s_sensor.adc_h = 30000;
+    s_sensor.transactions = 0;
+    int64_t start = test_time_us;
+    bme280_reading_t reading;
+    CHECK_EQ(bme280_read_data(&reading), ESP_OK);
+    CHECK_EQ(reading.temperature_centi, 2508);
+    CHECK_NEAR(reading.pressure_q8 / 256.0, 100653.27, 0.05);
+    CHECK_NEAR(reading.temperature, 25.08, 1e-5);
+    CHECK_NEAR(reading.pressure, 1006.5327, 1e-3);
+    CHECK_EQ(s_sensor.measurements, 1);
+    CHECK_EQ(s_sensor.early_reads, 0);
+    // Trigger, then one burst read after the maximum measurement time (46 ms for 2/16/1) in whole ticks
+    CHECK_EQ(s_sensor.transactions, 2);
+    CHECK(test_time_us - start >= 46000 && test_time_us - start <= 60000);
+    CHECK_EQ(s_sensor.reg[0xF4] & 0x03, 0);
+}
+
+// Integer compensation of the firmware against the double-precision one over the sensor range
+static void test_compensation(void) {
+    const int h4[] = { 324, 324, -100 };
+    const int h5[] = { 0, -30, 50 };
+    double max_t = 0, max_p = 0, max_h = 0;
+    srand(3);
+    for (int k = 0; k < 3; k++) {
+        sensor_reset(h4[k], h5[k]);
+        CHECK_EQ(bme280_init(), ESP_OK); // re-reads the calibration
+        for (int i = 0; i < 2000; i++) {
+            s_sensor.adc_t = 400000 + rand() % 250000;
+            s_sensor.adc_p = 250000 + rand() % 250000;
+            s_sensor.adc_h = 20000 + rand() % 20000;
+            bme280_reading_t reading;
+            if (bme280_read_data(&reading) != ESP_OK) {
+                CHECK(0);
+                break;
+            }
+            double t = ref_temperature(s_sensor.adc_t);
+            double p = ref_pressure(s_sensor.adc_p);
+            double h = ref_humidity(s_sensor.adc_h, h4[k], h5[k]);
+            max_t = fmax(max_t, fabs(reading.temperature_centi / 100.0 - t));
+            max_p = fmax(max_p, fabs(reading.pressure_q8 / 256.0 - p));
+            if (h > 0 && h < 100) {
+                max_h = fmax(max_h, fabs(reading.humidity_q10 / 1024.0 - h));
+            }
+        }
+    }
+    printf("integer vs double compensation: |dT| %.4f degC, |dP| %.3f Pa, |dH| %.4f %%RH\n", max_t, max_p, max_h);
+    CHECK(max_t <= 0.01);
+    CHECK(max_p < 1.0);
+    CHECK(max_h < 0.01);
+    CHECK_EQ(s_sensor.early_reads, 0);
+}
+
+// Periodic readings through 2 h online, 10 h without MQTT (offline store), 4 h online again: every reading
+// reaches the broker once, the stored ones backfilled from flash
+static void test_offline_store(void) {
+    sensor_reset(324, -30);
+    CHECK_EQ(bme280_init(), ESP_OK);
+    s_sensor.adc_p = 415148;
+    s_sensor.adc_h = 30000;
+    // Every reading leaves the temperature deadband, so every reading is reported: 25.08 and 25.58 °C
+    bme280_reading_t low, high;
+    s_sensor.adc_t = 521500;
+    bme280_read_data(&high);
+    s_sensor.adc_t = 519888;
+    bme280_read_data(&low);
+    CHECK(high.temperature - low.temperature > 2 * SENSOR_DEADBAND_TEMPERATURE);
+    s_sensor.adc_t_alt = 521500;
+    s_sensor.alternate = true;
+    s_sensor.measurements = 0;
+
+    sim_partition_create(TS_STORE_PARTITION, 64 * TS_STORE_BLOCK_SIZE);
+    CHECK_EQ(bme280_start_periodic_reading(NULL), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(bme280_start_periodic_reading((void *)&s_mqtt), ESP_OK);
+    int64_t start = test_time_us;
+    run_until(start + 2 * HOUR_US - 1);
+    int online = s_mqtt.received_count;
+    s_mqtt.connected = false;
+    run_until(start + 12 * HOUR_US - 1);
+    CHECK_EQ(s_mqtt.received_count, online);
+    s_mqtt.connected = true;
+    run_until(start + 16 * HOUR_US - 1);
+
+    sampler_stats_t sampler;
+    CHECK_EQ(sampler_get_stats("bme280", &sampler), ESP_OK);
+    ts_store_stats_t store;
+    ts_store_get_stats(&store);
+    printf("offline store: %lu readings, %d received (%d before the outage), %lu stored in %lu frames, "
+           "%lu bytes, %lu erases\n",
+           (unsigned long)sampler.samples, s_mqtt.received_count, online, (unsigned long)store.appended,
+           (unsigned long)store.frames, (unsigned long)store.bytes_written, (unsigned long)store.erases);
+    CHECK_EQ(sampler.samples, 16 * 30);
+    CHECK_EQ(sampler.errors + sampler.missed, 0);
+    CHECK_EQ(online, 2 * 30);
+    CHECK_EQ(store.appended, 10 * 30);
+    CHECK_EQ(store.uploaded, 10 * 30);
+    CHECK_EQ(store.pending_blocks, 0);
+    CHECK_EQ(sim_partition->set_bits, 0);
+    CHECK_EQ(s_mqtt.bad_batches, 0);
+    CHECK_EQ(s_mqtt.not_unix, 0);
+
+    // Every reading once: the times 2 minutes apart (the store rounds to TS_STORE_RESOLUTION_MS), the values
+    // as measured
+    CHECK_EQ(s_mqtt.received_count, 16 * 30);
+    int n = s_mqtt.received_count;
+    telemetry_sample_t *rx = s_mqtt.received;
+    for (int i = 1; i < n; i++) {
+        telemetry_sample_t s = rx[i];
+        int j = i;
+        for (; j > 0 && rx[j - 1].time_ms > s.time_ms; j--) {
+            rx[j] = rx[j - 1];
+        }
+        rx[j] = s;
+    }
+    int bad_steps = 0, bad_values = 0;
+    for (int i = 0; i < n; i++) {
+        int64_t step_ms = i ? rx[i].time_ms - rx[i - 1].time_ms : BME280_SAMPLING_INTERVAL_MS;
+        if (llabs(step_ms - BME280_SAMPLING_INTERVAL_MS) > TS_STORE_RESOLUTION_MS) {
+            bad_steps++;
+        }
+        const bme280_reading_t *expected = i & 1 ? &high : &low;
+        if (rx[i].value[0] != expected->temperature_centi ||
+            rx[i].value[1] != (int32_t)((expected->humidity_q10 * 100 + 512) >> 10) ||
+            rx[i].value[2] != (int32_t)((expected->pressure_q8 + 128) >> 8)) {
+            bad_values++;
+        }
+    }
+    CHECK_EQ(bad_steps, 0);
+    CHECK_EQ(bad_values, 0);
+
+    CHECK_EQ(bme280_stop_periodic_reading(), ESP_OK);
+    run_until(test_time_us + 1);
+    CHECK_EQ(sampler_get_stats("bme280", &sampler), ESP_ERR_NOT_FOUND);
+}
+
+typedef struct {
+    int32_t measurement_us;
+    int32_t read_us;     // time the read takes
+    int starts, reads, early;
+    int64_t first_start_us, last_start_us, started_us;
+} fake_sensor_t;
+
+static int32_t fake_start(void *ctx) {
+    fake_sensor_t *f = ctx;
+    if (f->starts++ == 0) {
+        f->first_start_us = test_time_us;
+    }
+    f->last_start_us = f->started_us = test_time_us;
+    return f->measurement_us;
+}
+
+static int32_t fake_read(void *ctx) {
+    fake_sensor_t *f = ctx;
+    if (test_time_us - f->started_us < f->measurement_us) {
+        f->early++;
+    }
+    f->reads++;
+    test_time_us += f->read_us;
+    return 0;
+}
+
+// A day of the BME280 and two other sensors on one sampler: no drift, no missed deadline, no early read
+static void test_sampler(void) {
+    s_sensor.alternate = false;
+    s_sensor.early_reads = 0;
+    fake_sensor_t fast = { .measurement_us = 2500 }, slow = { .measurement_us = 200000 };
+    const sampler_sensor_t fast_sensor = { "fast", 1000, fake_start, fake_read, &fast };
+    const sampler_sensor_t slow_sensor = { "slow", 7000, fake_start, fake_read, &slow };
+    int64_t start = test_time_us;
+    CHECK_EQ(bme280_start_periodic_reading((void *)&s_mqtt), ESP_OK);
+    CHECK_EQ(sampler_add(&fast_sensor), ESP_OK);
+    CHECK_EQ(sampler_add(&slow_sensor), ESP_OK);
+    CHECK_EQ(sampler_add(&fast_sensor), ESP_ERR_INVALID_STATE);
+    run_until(start + 24 * HOUR_US);
+
+    sampler_stats_t stats;
+    CHECK_EQ(sampler_get_stats("bme280", &stats), ESP_OK);
+    CHECK_EQ(stats.samples, 24 * 30);
+    CHECK_EQ(stats.errors + stats.missed, 0);
+    CHECK_EQ(fast.reads, 86400);
+    CHECK_EQ(slow.reads, 86400 / 7 + 1);
+    CHECK_EQ(fast.last_start_us - fast.first_start_us, (int64_t)(fast.starts - 1) * 1000000);
+    CHECK_EQ(slow.last_start_us - slow.first_start_us, (int64_t)(slow.starts - 1) * 7000000);
+    CHECK_EQ(fast.early + slow.early, 0);
+    CHECK_EQ(s_sensor.early_reads, 0);
+
+    // A sensor slower than its period: deadlines skipped and counted, not piled up
+    fake_sensor_t lag = { .measurement_us = 1000, .read_us = 2500000 };
+    const sampler_sensor_t lag_sensor = { "lag", 1000, fake_start, fake_read, &lag };
+    CHECK_EQ(sampler_add(&lag_sensor), ESP_OK);
+    start = test_time_us;
+    run_until(start + 60 * 1000000LL);
+    CHECK_EQ(sampler_get_stats("lag", &stats), ESP_OK);
+    CHECK(stats.missed > 0);
+    CHECK(stats.samples + stats.missed >= 58 && stats.samples + stats.missed <= 61);
+
+    CHECK_EQ(sampler_remove("lag"), ESP_OK);
+    CHECK_EQ(sampler_remove("lag"), ESP_ERR_NOT_FOUND);
+    CHECK_EQ(bme280_stop_periodic_reading(), ESP_OK);
+}
+
+int main(void) {
+    test_init();
+    test_forced_measurement();
+    test_compensation();
+    test_offline_store();
+    test_sampler();
+    return check_summary("bme280");
+}
@@ -0,0 +1,256 @@
+/**
+ * @file test_face_database.c
+ * @brief Face metadata log of the S3 (face_database.c): replay, undo of failed appends, compaction.
+ *
+ * The log is a file in a scratch directory of the host. A state is compared as the decoded records of every id,
+ * before and after a reopen replays the file.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "check.h"
+#include "face_database.h"
+
+#define MAX_ID 2000
+
+// Embedded faces.json of the firmware, only read by database_init()
+extern const uint8_t faces_json_start[] asm("_binary_faces_json_start");
+extern const uint8_t faces_json_end[] asm("_binary_faces_json_end");
+const uint8_t faces_json_start[] = "[]";
+const uint8_t faces_json_end[] = "";
+
+static char s_dir[] = "/tmp/face_db_XXXXXX";
+static char s_path[64];
+
+static long file_size(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static void put(int id, const char* status, int variant) {
+    char name[32], image_file[48];
+    snprintf(name, sizeof(name), "User %d", id);
+    snprintf(image_file, sizeof(image_file), "/spiffs/face_%d_%d.jpg", id, variant);
+    static const char* titles[] = { "Tester", "Developer", "Manager", "Guard" };
+    face_info_t info = {
+        .id = id,
+        .access_level = (id + variant) % 4,
+        .name = name,
+        .title = titles[id % 4],
+        .status = status,
+        .image_file = image_file,
+        .embedding_file = NULL,
+    };
+    CHECK_EQ(database_put_face(&info), ESP_OK);
+}
+
+// Every record decoded, ids in order: one line per id, empty for a missing one
+static char* snapshot(void) {
+    size_t cap = MAX_ID * 128, len = 0;
+    char* out = malloc(cap);
+    for (int id = 1; id <= MAX_ID; id++) {
+        face_info_t info;
+        if (database_get_info(id, &info) == ESP_OK) {
+            len += snprintf(out + len, cap - len, "%d %d %s|%s|%s|%s|%s", info.id, info.access_level, info.name,
+                            info.title, info.status, info.image_file, info.embedding_file);
+        }
+        len += snprintf(out + len, cap - len, "\n");
+    }
+    return out;
+}
+
+// The file replays to the state in memory
+static void check_reopen(void) {
+    char* before = snapshot();
+    int count = database_get_count();
+    database_deinit();
+    CHECK_EQ(database_open(s_path), ESP_OK);
+    char* after = snapshot();
+    CHECK_EQ(database_get_count(), count);
+    CHECK(strcmp(before, after) == 0);
+    free(before);
+    free(after);
+}
+
+static void new_database(void) {
+    database_deinit();
+    remove(s_path);
+    CHECK_EQ(database_open(s_path), ESP_OK);
+    CHECK_EQ(database_get_count(), 0);
+}
+
+// Puts, updates and deletes replay to the same records, strings are interned once
+static void test_replay(void) {
+    new_database();
+    for (int id = 1; id <= 500; id++) {
+        put(id, "active", 0);
+    }
+    for (int id = 1; id <= 500; id += 5) {
+        put(id, "suspended", 1);
+    }
+    for (int id = 3; id <= 500; id += 10) {
+        CHECK_EQ(database_delete_face(id), ESP_OK);
+    }
+    CHECK_EQ(database_delete_face(3), ESP_ERR_NOT_FOUND);
+    CHECK_EQ(database_get_count(), 450);
+    CHECK(database_find_by_id(13) == NULL);
+    const face_record_t* rec = database_find_by_id(6);
+    CHECK(rec && rec->id == 6);
+    CHECK(rec && strcmp(database_get_str(rec->str[FACE_FIELD_STATUS]), "suspended") == 0);
+    // Titles and statuses are shared by every record that uses them
+    CHECK(rec && database_find_by_id(10)->str[FACE_FIELD_TITLE] == database_find_by_id(2)->str[FACE_FIELD_TITLE]);
+    check_reopen();
+}
+
+// A change whose log entries cannot be written leaves the memory as the file replays: no record, no string id
+// that a later append would reuse for another string
+static void test_undo(void) {
+    new_database();
+    for (int id = 1; id <= 100; id++) {
+        put(id, "active", 0);
+    }
+    char* before = snapshot();
+    // The log path turns into a directory, every append fails
+    char moved[80];
+    snprintf(moved, sizeof(moved), "%s.moved", s_path);
+    CHECK_EQ(rename(s_path, moved), 0);
+    CHECK_EQ(mkdir(s_path, 0700), 0);
+    face_info_t info = { .id = 101, .name = "New person", .title = "New title", .status = "new status" };
+    CHECK(database_put_face(&info) != ESP_OK);
+    info.id = 7; // update of an existing record, new strings too
+    CHECK(database_put_face(&info) != ESP_OK);
+    CHECK(database_delete_face(8) != ESP_OK);
+    CHECK_EQ(database_get_count(), 100);
+    CHECK(database_find_by_id(101) == NULL);
+    char* after = snapshot();
+    CHECK(strcmp(before, after) == 0);
+    free(before);
+    free(after);
+
+    CHECK_EQ(rmdir(s_path), 0);
+    CHECK_EQ(rename(moved, s_path), 0);
+    // Other new strings take the ids the failed change had staged
+    face_info_t other = { .id = 102, .name = "Other person", .title = "Other title", .status = "other status" };
+    CHECK_EQ(database_put_face(&other), ESP_OK);
+    face_info_t decoded;
+    CHECK_EQ(database_get_info(102, &decoded), ESP_OK);
+    CHECK(strcmp(decoded.name, "Other person") == 0 && strcmp(decoded.title, "Other title") == 0);
+    check_reopen();
+    CHECK_EQ(database_get_info(102, &decoded), ESP_OK);
+    CHECK(strcmp(decoded.status, "other status") == 0);
+}
+
+// Superseded entries are dropped once they outnumber the live ones, the records stay the same
+static void test_compaction(void) {
+    new_database();
+    for (int id = 1; id <= 200; id++) {
+        put(id, "active", 0);
+    }
+    long grown = 0;
+    for (int round = 1; round <= 5; round++) {
+        for (int id = 1; id <= 200; id++) {
+            put(id, round % 2 ? "away" : "active", round);
+        }
+        grown = file_size(s_path) > grown ? file_size(s_path) : grown;
+    }
+    char tmp_path[80];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", s_path);
+    CHECK_EQ(file_size(tmp_path), -1);
+    // At most twice the live records, not six versions of each
+    CHECK(file_size(s_path) < grown);
+    char* before = snapshot();
+    long size = file_size(s_path);
+    CHECK_EQ(database_compact(), ESP_OK);
+    CHECK(file_size(s_path) <= size);
+    char* after = snapshot();
+    CHECK(strcmp(before, after) == 0);
+    free(before);
+    free(after);
+    // Deletes too: half the records gone, the strings only they used with them
+    for (int id = 2; id <= 200; id += 2) {
+        CHECK_EQ(database_delete_face(id), ESP_OK);
+    }
+    size = file_size(s_path);
+    CHECK_EQ(database_compact(), ESP_OK);
+    long compacted = file_size(s_path);
+    CHECK(compacted < size);
+    CHECK_EQ(database_get_count(), 100);
+    check_reopen();
+    // As small as a log that only ever held the live records
+    before = snapshot();
+    new_database();
+    for (int id = 1; id <= 200; id += 2) {
+        put(id, "away", 5);
+    }
+    after = snapshot();
+    CHECK(strcmp(before, after) == 0);
+    CHECK_EQ(file_size(s_path), compacted);
+    free(before);
+    free(after);
+
+    // A compaction cut between the remove and the rename leaves only the copy, it is taken at open
+    database_deinit();
+    CHECK_EQ(rename(s_path, tmp_path), 0);
+    CHECK_EQ(database_open(s_path), ESP_OK);
+    CHECK_EQ(database_get_count(), 100);
+    CHECK_EQ(file_size(tmp_path), -1);
+    CHECK_EQ(file_size(s_path), compacted);
+}
+
+// A reset in the middle of an append leaves a partial entry: the entries before it are loaded, the log rewritten
+static void test_torn_tail(void) {
+    new_database();
+    for (int id = 1; id <= 50; id++) {
+        put(id, "active", 0);
+    }
+    put(10, "changed", 1);
+    char* before = snapshot();
+    put(51, "last", 0); // new strings and a PUT, cut in the PUT
+    database_deinit();
+    CHECK_EQ(truncate(s_path, file_size(s_path) - 3), 0);
+    CHECK_EQ(database_open(s_path), ESP_OK);
+    CHECK_EQ(database_get_count(), 50);
+    CHECK(database_find_by_id(51) == NULL);
+    char* after = snapshot();
+    CHECK(strcmp(before, after) == 0);
+    free(before);
+    free(after);
+    // Rewritten clean: appends after the cut are kept
+    put(52, "after", 0);
+    check_reopen();
+    CHECK(database_find_by_id(52) != NULL);
+}
+
+static void test_not_open(void) {
+    database_deinit();
+    face_info_t info = { .id = 1 };
+    CHECK_EQ(database_put_face(&info), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(database_delete_face(1), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(database_compact(), ESP_ERR_INVALID_STATE);
+    CHECK(database_find_by_id(1) == NULL);
+    // Not a database file
+    FILE* f = fopen(s_path, "wb");
+    fputs("not a database", f);
+    fclose(f);
+    CHECK(database_open(s_path) != ESP_OK);
+    CHECK_EQ(database_get_count(), 0);
+}
+
+int main(void) {
+    if (!mkdtemp(s_dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(s_path, sizeof(s_path), "%s/faces.db", s_dir);
+    test_replay();
+    test_undo();
+    test_compaction();
+    test_torn_tail();
+    test_not_open();
+    database_deinit();
+    remove(s_path);
+    rmdir(s_dir);
+    return check_summary("face_database");
+}
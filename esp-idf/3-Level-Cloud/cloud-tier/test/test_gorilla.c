@@ -0,0 +1,201 @@
+/**
+ * @file test_gorilla.c
+ * @brief Gorilla packing of the sensor firmware (gorilla.c): round trip and size of BME280-like series.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "gorilla.h"
+#include "telemetry_batch.h"
+
+#define WEEK_S (7 * 86400)
+
+static uint64_t s_rng = 88172645463325252ull;
+
+static uint32_t rnd(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)s_rng;
+}
+
+static int noise(int amplitude) {
+    return amplitude ? (int)(rnd() % (2 * amplitude + 1)) - amplitude : 0;
+}
+
+// BME280 sample i in the firmware's units (0.01 °C, 0.01 %RH, Pa): daily cycles, a 3-day pressure swing, noise
+static void bme280_like(long i, int period_s, int noise_lsb, int32_t *values) {
+    double t = (double)i * period_s;
+    values[0] = (int32_t)lround(2150 + 300 * sin(2 * M_PI * t / 86400)) + noise(noise_lsb);
+    values[1] = (int32_t)lround(4500 - 800 * sin(2 * M_PI * t / 86400)) + noise(2 * noise_lsb);
+    values[2] = (int32_t)lround(101325 + 400 * sin(2 * M_PI * t / 259200)) + noise(noise_lsb);
+}
+
+// Every time step class and XOR window case, extremes included, in one stream
+static void test_round_trip(void) {
+    static uint8_t buf[16384];
+    enum { N = 300 };
+    int64_t times[N];
+    int32_t values[N][GORILLA_MAX_FIELDS];
+    gorilla_encoder_t enc;
+    gorilla_encoder_init(&enc, buf, sizeof(buf), GORILLA_MAX_FIELDS, -5);
+    int64_t t = -5;
+    const int64_t steps[] = { 1, 100, 3000, 1000000, 1, 1, 0, 70000, 2147483647LL, 1 };
+    int appended = 0;
+    for (int i = 0; i < N; i++) {
+        t += steps[i % 10];
+        times[i] = t;
+        for (int f = 0; f < GORILLA_MAX_FIELDS; f++) {
+            values[i][f] = i % 7 == 0 ? (int32_t)rnd() : i % 5 ? INT32_MIN + f : f * 3 - (i & 1);
+        }
+        appended += gorilla_append(&enc, t, values[i]) == GORILLA_OK;
+    }
+    CHECK_EQ(appended, N);
+    CHECK_EQ(enc.count, N);
+    // A step that changes by more than 32 bits needs a new stream, nothing is written
+    size_t bits = enc.bits;
+    CHECK_EQ(gorilla_append(&enc, t + 10000000000LL, values[0]), GORILLA_RANGE);
+    CHECK_EQ(enc.bits, bits);
+
+    size_t len = gorilla_flush(&enc);
+    CHECK_EQ(len, (bits + 7) / 8);
+    gorilla_decoder_t dec;
+    gorilla_decoder_init(&dec, GORILLA_MAX_FIELDS, -5);
+    gorilla_decoder_input(&dec, buf, len);
+    int same = 0;
+    for (int i = 0; i < N; i++) {
+        int64_t time;
+        int32_t v[GORILLA_MAX_FIELDS];
+        if (!gorilla_decode(&dec, &time, v)) {
+            break;
+        }
+        same += time == times[i] && memcmp(v, values[i], sizeof(v)) == 0;
+    }
+    CHECK_EQ(same, N);
+
+    // A truncated piece fails, it does not make up samples
+    gorilla_decoder_init(&dec, GORILLA_MAX_FIELDS, -5);
+    gorilla_decoder_input(&dec, buf, 3);
+    int64_t time;
+    int32_t v[GORILLA_MAX_FIELDS];
+    CHECK(!gorilla_decode(&dec, &time, v));
+}
+
+// A small buffer drained whenever it is full: the pieces decode in order, the state carries over. The padding
+// of a piece could read as more samples, its count is kept aside (as in the frames of ts_store.c)
+static void test_pieces(void) {
+    enum { N = 5000, MAX_PIECES = 1024 };
+    uint8_t buf[64];
+    static uint8_t stream[65536];
+    size_t piece_len[MAX_PIECES];
+    int piece_count[MAX_PIECES];
+    int pieces = 0, in_piece = 0, failed = 0;
+    size_t stream_len = 0;
+    gorilla_encoder_t enc;
+    gorilla_encoder_init(&enc, buf, sizeof(buf), 3, 0);
+    for (long i = 0; i <= N && pieces < MAX_PIECES; i++) {
+        int32_t values[3];
+        s_rng = 1000 + i;
+        bme280_like(i, 120, 1, values);
+        gorilla_status_t status = i < N ? gorilla_append(&enc, i * 120 + i % 3, values) : GORILLA_FULL;
+        if (status == GORILLA_FULL) {
+            piece_len[pieces] = gorilla_flush(&enc);
+            piece_count[pieces++] = in_piece;
+            memcpy(stream + stream_len, buf, piece_len[pieces - 1]);
+            stream_len += piece_len[pieces - 1];
+            in_piece = 0;
+            status = i < N ? gorilla_append(&enc, i * 120 + i % 3, values) : GORILLA_OK;
+        }
+        failed += status != GORILLA_OK;
+        in_piece += i < N && status == GORILLA_OK;
+    }
+    CHECK_EQ(failed, 0);
+    CHECK(pieces > 10);
+
+    gorilla_decoder_t dec;
+    gorilla_decoder_init(&dec, 3, 0);
+    long decoded = 0, same = 0;
+    const uint8_t *piece = stream;
+    for (int p = 0; p < pieces; p++) {
+        gorilla_decoder_input(&dec, piece, piece_len[p]);
+        piece += piece_len[p];
+        for (int k = 0; k < piece_count[p]; k++) {
+            int64_t time;
+            int32_t v[3], expected[3];
+            if (!gorilla_decode(&dec, &time, v)) {
+                break;
+            }
+            s_rng = 1000 + decoded;
+            bme280_like(decoded, 120, 1, expected);
+            same += time == decoded * 120 + decoded % 3 && memcmp(v, expected, sizeof(v)) == 0;
+            decoded++;
+        }
+    }
+    CHECK_EQ(decoded, N);
+    CHECK_EQ(same, N);
+}
+
+// Packed bytes per sample of a week of readings, against 20 bytes raw (int64 time, 3 x int32) and the
+// varint batches of telemetry_batch.c that go over MQTT
+static double packed_bytes(int period_s, int noise_lsb, double *batch_bytes) {
+    static uint8_t buf[4096];
+    long n = WEEK_S / period_s;
+    telemetry_sample_t *samples = calloc(n, sizeof(*samples));
+    s_rng = 88172645463325252ull;
+    for (long i = 0; i < n; i++) {
+        samples[i].time_ms = i * period_s * 1000LL;
+        bme280_like(i, period_s, noise_lsb, samples[i].value);
+    }
+    gorilla_encoder_t enc;
+    gorilla_encoder_init(&enc, buf, sizeof(buf), 3, 0);
+    size_t bytes = 0;
+    for (long i = 0; i < n; i++) {
+        // Time in ticks of the store's 1 s resolution
+        if (gorilla_append(&enc, samples[i].time_ms / 1000, samples[i].value) == GORILLA_FULL) {
+            bytes += gorilla_flush(&enc);
+            i--;
+        }
+    }
+    bytes += gorilla_flush(&enc);
+
+    uint8_t msg[TELEMETRY_BATCH_MAX_LEN(3, 60)];
+    telemetry_batch_t batch;
+    telemetry_batch_init(&batch, samples, (int)n, 3);
+    batch.count = (int)n;
+    size_t batched = 0;
+    while (batch.count > 0) {
+        int encoded;
+        batched += telemetry_batch_encode(&batch, 0, 0, 60, msg, sizeof(msg), &encoded);
+        telemetry_batch_consume(&batch, encoded);
+    }
+    free(samples);
+    *batch_bytes = (double)batched / n;
+    return (double)bytes / n;
+}
+
+static void test_compression(void) {
+    const struct {
+        int period_s, noise_lsb;
+        double max_bytes; // per sample
+    } cases[] = {
+        { 1, 0, 1.0 },   // smooth: mostly unchanged values
+        { 1, 1, 2.5 },   // the sensor's noise in the last digit
+        { 120, 1, 4.0 }, // the firmware's period
+    };
+    for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+        double batch;
+        double packed = packed_bytes(cases[k].period_s, cases[k].noise_lsb, &batch);
+        printf("every %d s, noise +-%d: %.2f bytes/sample packed, %.1fx vs raw, %.1fx vs varint batches (%.2f)\n",
+               cases[k].period_s, cases[k].noise_lsb, packed, 20 / packed, batch / packed, batch);
+        CHECK(packed <= cases[k].max_bytes);
+        CHECK(packed < batch);
+    }
+}
+
+int main(void) {
+    test_round_trip();
+    test_pieces();
+    test_compression();
+    return check_summary("gorilla");
+}
@@ -0,0 +1,336 @@
+/**
+ * @file test_identity_cache.c
+ * @brief identity_cache.c of the S3: hits, TTL, LRU and camera slots, on a simulated clock.
+ *
+ * The replays stand in for the face pipeline of face_recognizer.cpp: each frame is a jittered copy of a person's
+ * base embedding, looked up in the cache first, then on a miss in a database of the enrolled base embeddings.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "config.h"
+#include "identity_cache.h"
+
+#define FEAT_LEN 16
+#define THR 0.5f
+#define TTL_US ((int64_t)IDENTITY_CACHE_TTL_MS * 1000)
+
+int64_t test_time_us = 1000000;
+
+// Unit embedding along axis k: orthogonal to every other axis
+static const float* axis(int k) {
+    static float feats[FEAT_LEN][FEAT_LEN];
+    memset(feats[k], 0, sizeof(feats[k]));
+    feats[k][k] = 1.0f;
+    return feats[k];
+}
+
+static void test_hit_and_miss(void) {
+    identity_cache_init(FEAT_LEN);
+    CHECK_EQ(identity_cache_lookup(0, axis(0), THR, NULL), -1);
+    identity_cache_insert(0, 7, axis(0));
+    float sim = 0;
+    CHECK_EQ(identity_cache_lookup(0, axis(0), THR, &sim), 7);
+    CHECK_NEAR(sim, 1.0, 1e-6);
+    CHECK_EQ(identity_cache_lookup(0, axis(1), THR, NULL), -1); // another face
+    CHECK_EQ(identity_cache_lookup(1, axis(0), THR, NULL), -1); // another camera
+
+    // Similarity must be above the threshold, as in the database
+    float edge[FEAT_LEN] = { THR };
+    CHECK_EQ(identity_cache_lookup(0, edge, THR, NULL), -1);
+    edge[0] = THR + 0.01f;
+    CHECK_EQ(identity_cache_lookup(0, edge, THR, NULL), 7);
+
+    identity_cache_invalidate(7);
+    CHECK_EQ(identity_cache_lookup(0, axis(0), THR, NULL), -1);
+
+    identity_cache_stats_t stats;
+    identity_cache_get_stats(&stats);
+    CHECK_EQ(stats.lookups, 7);
+    CHECK_EQ(stats.hits, 2);
+    CHECK_EQ(stats.inserts, 1);
+    identity_cache_deinit();
+}
+
+// A hit does not extend the TTL, only a database match (insert) does
+static void test_ttl(void) {
+    identity_cache_init(FEAT_LEN);
+    identity_cache_insert(0, 3, axis(3));
+    int64_t confirmed = test_time_us;
+    for (int i = 1; i < 10; i++) {
+        test_time_us = confirmed + TTL_US * i / 10;
+        CHECK_EQ(identity_cache_lookup(0, axis(3), THR, NULL), 3);
+    }
+    test_time_us = confirmed + TTL_US;
+    CHECK_EQ(identity_cache_lookup(0, axis(3), THR, NULL), -1);
+
+    // The database confirms it again: cached for another TTL from now
+    identity_cache_insert(0, 3, axis(3));
+    test_time_us += TTL_US - 1;
+    CHECK_EQ(identity_cache_lookup(0, axis(3), THR, NULL), 3);
+    test_time_us += 1;
+    CHECK_EQ(identity_cache_lookup(0, axis(3), THR, NULL), -1);
+    identity_cache_deinit();
+}
+
+// A full camera evicts its least recently used identity, an expired entry is reused first
+static void test_lru(void) {
+    identity_cache_init(FEAT_LEN);
+    for (int id = 0; id < IDENTITY_CACHE_SIZE; id++) {
+        identity_cache_insert(0, id, axis(id));
+    }
+    CHECK_EQ(identity_cache_lookup(0, axis(0), THR, NULL), 0); // 0 used, 1 is now the oldest
+    identity_cache_insert(0, IDENTITY_CACHE_SIZE, axis(IDENTITY_CACHE_SIZE));
+    CHECK_EQ(identity_cache_lookup(0, axis(0), THR, NULL), 0);
+    CHECK_EQ(identity_cache_lookup(0, axis(1), THR, NULL), -1);
+    CHECK_EQ(identity_cache_lookup(0, axis(IDENTITY_CACHE_SIZE), THR, NULL), IDENTITY_CACHE_SIZE);
+
+    identity_cache_stats_t stats;
+    identity_cache_get_stats(&stats);
+    CHECK_EQ(stats.evictions, 1);
+
+    // Same id again: refreshed in place, nothing evicted
+    identity_cache_insert(0, 2, axis(2));
+    identity_cache_get_stats(&stats);
+    CHECK_EQ(stats.evictions, 1);
+    identity_cache_deinit();
+}
+
+// Cameras keep their own slots whatever their ids, only one too many takes over the least recently seen
+static void test_camera_slots(void) {
+    identity_cache_init(FEAT_LEN);
+    const int stride = IDENTITY_CACHE_MAX_CAMERAS; // same id modulo the number of slots
+    for (int c = 0; c < IDENTITY_CACHE_MAX_CAMERAS; c++) {
+        identity_cache_insert(c * stride, 100 + c, axis(c));
+    }
+    for (int c = 0; c < IDENTITY_CACHE_MAX_CAMERAS; c++) {
+        CHECK_EQ(identity_cache_lookup(c * stride, axis(c), THR, NULL), 100 + c);
+    }
+    identity_cache_stats_t stats;
+    identity_cache_get_stats(&stats);
+    CHECK_EQ(stats.camera_evictions, 0);
+
+    // Camera 0 seen again: the least recently seen is now camera 1 * stride
+    CHECK_EQ(identity_cache_lookup(0, axis(0), THR, NULL), 100);
+    const int extra = IDENTITY_CACHE_MAX_CAMERAS * stride;
+    identity_cache_insert(extra, 200, axis(9));
+    CHECK_EQ(identity_cache_lookup(extra, axis(9), THR, NULL), 200);
+    CHECK_EQ(identity_cache_lookup(stride, axis(1), THR, NULL), -1);
+    CHECK_EQ(identity_cache_lookup(0, axis(0), THR, NULL), 100);
+    for (int c = 2; c < IDENTITY_CACHE_MAX_CAMERAS; c++) {
+        CHECK_EQ(identity_cache_lookup(c * stride, axis(c), THR, NULL), 100 + c);
+    }
+    identity_cache_get_stats(&stats);
+    CHECK_EQ(stats.camera_evictions, 1);
+
+    identity_cache_reset_camera(0);
+    CHECK_EQ(identity_cache_lookup(0, axis(0), THR, NULL), -1);
+    CHECK_EQ(identity_cache_lookup(extra, axis(9), THR, NULL), 200);
+    identity_cache_deinit();
+}
+
+// Replays: embeddings of the feature model (512 floats), a frame every 200 ms
+#define EMB_LEN 512
+#define FRAME_US 200000
+#define PEOPLE 12
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static float uniform(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return ((rng_state >> 40) + 0.5f) / (float)(1 << 24);
+}
+
+static float gaussian(void) {
+    return sqrtf(-2.0f * logf(uniform())) * cosf(6.2831853f * uniform());
+}
+
+static void normalize(float* v) {
+    float norm = 0;
+    for (int i = 0; i < EMB_LEN; i++) {
+        norm += v[i] * v[i];
+    }
+    norm = sqrtf(norm);
+    for (int i = 0; i < EMB_LEN; i++) {
+        v[i] /= norm;
+    }
+}
+
+static void random_embedding(float* v) {
+    for (int i = 0; i < EMB_LEN; i++) {
+        v[i] = gaussian();
+    }
+    normalize(v);
+}
+
+// Another frame of the same face: base plus noise of norm ~sigma. Two frames have a similarity of about
+// 1 / (1 + sigma^2), a frame and the base 1 / sqrt(1 + sigma^2).
+static void jitter(const float* base, float sigma, float* out) {
+    for (int i = 0; i < EMB_LEN; i++) {
+        out[i] = base[i] + sigma * gaussian() / sqrtf(EMB_LEN);
+    }
+    normalize(out);
+}
+
+static float enrolled[PEOPLE][EMB_LEN];
+
+// Full query of the database (DataBase::query_feat with top_k 1): the best enrolled face above the threshold
+static int db_query(const float* feat) {
+    int best = -1;
+    float best_sim = THR;
+    for (int id = 0; id < PEOPLE; id++) {
+        float sim = 0;
+        for (int i = 0; i < EMB_LEN; i++) {
+            sim += feat[i] * enrolled[id][i];
+        }
+        if (sim > best_sim) {
+            best_sim = sim;
+            best = id;
+        }
+    }
+    return best;
+}
+
+typedef struct {
+    int frames;
+    int hits;
+    int queries;
+    int wrong;   // an id other than the person's, by the cache or the database
+    int unknown; // frames of an enrolled person nobody recognized
+} replay_t;
+
+// One frame through the cache, then the database, as FaceRecognizer::recognize_face() does
+static int recognize(int camera, const float* feat, replay_t* r) {
+    test_time_us += FRAME_US;
+    r->frames++;
+    int id = identity_cache_lookup(camera, feat, THR, NULL);
+    if (id >= 0) {
+        r->hits++;
+        return id;
+    }
+    r->queries++;
+    id = db_query(feat);
+    if (id >= 0) {
+        identity_cache_insert(camera, id, feat);
+    }
+    return id;
+}
+
+// A person walks past the camera: `frames` frames of their face
+static void visit(int camera, int person, float sigma, int frames, replay_t* r) {
+    float feat[EMB_LEN];
+    for (int f = 0; f < frames; f++) {
+        jitter(enrolled[person], sigma, feat);
+        int id = recognize(camera, feat, r);
+        r->wrong += id >= 0 && id != person;
+        r->unknown += id < 0;
+    }
+}
+
+// Visits of a few regulars: a cache of IDENTITY_CACHE_SIZE holds them all
+static replay_t replay_regulars(float sigma) {
+    identity_cache_init(EMB_LEN);
+    replay_t r = { 0 };
+    for (int v = 0; v < 200; v++) {
+        visit(0, (int)(uniform() * IDENTITY_CACHE_SIZE / 2), sigma, 10, &r);
+    }
+    identity_cache_stats_t stats;
+    identity_cache_get_stats(&stats);
+    CHECK_EQ(stats.lookups, r.frames);
+    CHECK_EQ(stats.hits, r.hits);
+    CHECK_EQ(stats.hits + stats.inserts, r.frames); // every miss was a database match
+    identity_cache_deinit();
+    return r;
+}
+
+// Clear frames (similarity ~0.8 between them) hit almost always. Frames around the threshold (~0.5 between
+// them, ~0.71 to the enrolled face) miss about half the time, the database answers those. Either way no frame
+// gets a wrong id.
+static void test_noisy_replay(void) {
+    for (int id = 0; id < PEOPLE; id++) {
+        random_embedding(enrolled[id]);
+    }
+    replay_t clear = replay_regulars(0.5f);
+    replay_t blurry = replay_regulars(1.0f);
+    printf("regulars, frame similarity ~0.8: %d frames, hit rate %.2f\n", clear.frames,
+           (float)clear.hits / clear.frames);
+    printf("regulars, frame similarity ~0.5: %d frames, hit rate %.2f\n", blurry.frames,
+           (float)blurry.hits / blurry.frames);
+    CHECK_EQ(clear.wrong, 0);
+    CHECK_EQ(clear.unknown, 0);
+    CHECK_EQ(blurry.wrong, 0);
+    CHECK_EQ(blurry.unknown, 0);
+    CHECK(clear.hits > clear.frames * 85 / 100);
+    CHECK(blurry.hits > blurry.frames * 20 / 100);
+    CHECK(blurry.hits < blurry.frames * 80 / 100);
+    CHECK_EQ(clear.hits + clear.queries, clear.frames);
+}
+
+// Faces nobody enrolled are never answered from the cache: every frame goes to the database, which does not
+// know them either, and nothing is cached for them. The stream stays within the TTL of the regular.
+static void test_strangers(void) {
+    identity_cache_init(EMB_LEN);
+    replay_t r = { 0 };
+    visit(0, 1, 0.5f, 10, &r); // a regular in the cache meanwhile
+    float stranger[EMB_LEN], feat[EMB_LEN];
+    int stranger_frames = 0;
+    for (int s = 0; s < 20; s++) {
+        random_embedding(stranger);
+        for (int f = 0; f < 5; f++) {
+            jitter(stranger, 0.5f, feat);
+            CHECK_EQ(recognize(0, feat, &r), -1);
+            stranger_frames++;
+        }
+    }
+    CHECK_EQ(r.queries, 1 + stranger_frames);
+    identity_cache_stats_t stats;
+    identity_cache_get_stats(&stats);
+    CHECK_EQ(stats.inserts, 1);
+    CHECK_EQ(stats.evictions, 0);
+    visit(0, 1, 0.5f, 1, &r); // the regular is still cached
+    CHECK_EQ(r.queries, 1 + stranger_frames);
+    CHECK_EQ(r.wrong, 0);
+    identity_cache_deinit();
+}
+
+// More people than IDENTITY_CACHE_SIZE in turn: each visit evicts the least recently seen one, which is the one
+// coming back next, so the cache never hits. Up to IDENTITY_CACHE_SIZE people it hits after their first visit.
+static void test_stream_eviction(void) {
+    for (int people = IDENTITY_CACHE_SIZE - 1; people <= PEOPLE; people++) {
+        identity_cache_init(EMB_LEN);
+        replay_t r = { 0 };
+        const int rounds = 5;
+        for (int round = 0; round < rounds; round++) {
+            for (int p = 0; p < people; p++) {
+                visit(0, p, 0.3f, 1, &r);
+            }
+        }
+        identity_cache_stats_t stats;
+        identity_cache_get_stats(&stats);
+        CHECK_EQ(r.wrong, 0);
+        CHECK_EQ(r.unknown, 0);
+        if (people <= IDENTITY_CACHE_SIZE) {
+            CHECK_EQ(r.hits, (rounds - 1) * people);
+            CHECK_EQ(stats.evictions, 0);
+        } else {
+            CHECK_EQ(r.hits, 0);
+            CHECK_EQ(stats.evictions, rounds * people - IDENTITY_CACHE_SIZE);
+        }
+        identity_cache_deinit();
+    }
+}
+
+int main(void) {
+    test_hit_and_miss();
+    test_ttl();
+    test_lru();
+    test_camera_slots();
+    test_noisy_replay();
+    test_strangers();
+    test_stream_eviction();
+    return check_summary("identity_cache");
+}
@@ -0,0 +1,263 @@
+/**
+ * @file test_image_simd.cpp
+ * @brief Image kernels of the camera's esp-dl (dl_image_simd.cpp): KERNEL_SWAR bit-exact against KERNEL_SCALAR.
+ *
+ * Both kernel tables run on random images, sizes, crops past the edges and misaligned buffers, and are compared
+ * with a per-pixel reference of the sampling documented in dl_image_simd.hpp.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "check.h"
+#include "dl_image_simd.hpp"
+
+// Tensor and dl::tool code used by the conversion lives in the prebuilt libdl.a of the camera
+template <>
+dl::Tensor<uint8_t>& dl::Tensor<uint8_t>::set_shape(const std::vector<int> shape) {
+    this->shape = shape;
+    size = 1;
+    for (int s : shape) {
+        size *= s;
+    }
+    return *this;
+}
+
+namespace dl {
+namespace tool {
+void set_zero(void* ptr, const int n) {
+    memset(ptr, 0, n);
+}
+} // namespace tool
+} // namespace dl
+
+using namespace dl::image;
+
+namespace {
+
+constexpr int ITERATIONS = 3000;
+
+std::mt19937 rng(45);
+
+int rnd(int lo, int hi) {
+    return std::uniform_int_distribution<int>(lo, hi)(rng);
+}
+
+int clamp(int v, int lo, int hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+// Channels of a source pixel, RGB565 decoded to (blue, green, red)
+template <typename S>
+void pixel(const S* src, int width, int channels, int y, int x, int* out) {
+    if (sizeof(S) == 2) {
+        uint8_t bgr[3];
+        convert_pixel_rgb565_to_rgb888(((const uint16_t*)src)[y * width + x], bgr);
+        std::copy(bgr, bgr + 3, out);
+    } else {
+        for (int c = 0; c < channels; c++) {
+            out[c] = ((const uint8_t*)src)[(y * width + x) * channels + c];
+        }
+    }
+}
+
+// One destination pixel at a time, straight from the documented formulas
+template <typename T, typename S>
+void reference_crop(T* dst, int dw, int dch, int dy0, int dy1, int dx0, int dx1, const S* src, int sh, int sw,
+                    int sch, int sy0, int sy1, int sx0, int sx1, resize_type_t type, int shift) {
+    int ch = sizeof(S) == 2 ? 3 : sch, cols = dx1 - dx0, rows = dy1 - dy0;
+    for (int r = 0; r < rows; r++) {
+        for (int i = 0; i < cols; i++) {
+            int v[3];
+            if (type == IMAGE_RESIZE_BILINEAR) {
+                int py = sy0 * 256 + (int)((int64_t)(2 * r + 1) * (sy1 - sy0) * 256 / (2 * rows)) - 128;
+                int px = sx0 * 256 + (int)((int64_t)(2 * i + 1) * (sx1 - sx0) * 256 / (2 * cols)) - 128;
+                int y0 = clamp(py >> 8, 0, sh - 1), y1 = clamp((py >> 8) + 1, 0, sh - 1), wy = py & 255;
+                int x0 = clamp(px >> 8, 0, sw - 1), x1 = clamp((px >> 8) + 1, 0, sw - 1), wx = px & 255;
+                int a[3], b[3], c[3], d[3];
+                pixel(src, sw, sch, y0, x0, a);
+                pixel(src, sw, sch, y0, x1, b);
+                pixel(src, sw, sch, y1, x0, c);
+                pixel(src, sw, sch, y1, x1, d);
+                for (int k = 0; k < ch; k++) {
+                    int left = (a[k] * (256 - wy) + c[k] * wy + 128) >> 8;
+                    int right = (b[k] * (256 - wy) + d[k] * wy + 128) >> 8;
+                    v[k] = (left * (256 - wx) + right * wx + 128) >> 8;
+                }
+            } else {
+                int y = clamp(sy0 + (int)((int64_t)r * (sy1 - sy0) / rows), 0, sh - 1);
+                int x = clamp(sx0 + (int)((int64_t)i * (sx1 - sx0) / cols), 0, sw - 1);
+                pixel(src, sw, sch, y, x, v);
+                if (type == IMAGE_RESIZE_MEAN) {
+                    int b[3], c[3], d[3];
+                    int xn = std::min(x + 1, sw - 1), yn = std::min(y + 1, sh - 1);
+                    pixel(src, sw, sch, y, xn, b);
+                    pixel(src, sw, sch, yn, x, c);
+                    pixel(src, sw, sch, yn, xn, d);
+                    for (int k = 0; k < ch; k++) {
+                        v[k] = (v[k] + b[k] + c[k] + d[k]) >> 2;
+                    }
+                }
+            }
+            T* out = dst + ((dy0 + r) * dw + dx0 + i) * dch;
+            if (dch == ch) {
+                for (int k = 0; k < dch; k++) {
+                    out[k] = (T)(v[k] << shift);
+                }
+            } else if (dch == 1) {
+                out[0] = (T)(convert_pixel_rgb888_to_gray(v[2], v[1], v[0]) << shift);
+            } else {
+                out[0] = out[1] = out[2] = (T)(v[0] << shift);
+            }
+        }
+    }
+}
+
+// Random crop of a random source into a random window of the destination, pixels outside it left as they were
+template <typename T, typename S>
+int check_crop() {
+    int sh = rnd(1, 60), sw = rnd(1, 60), sch = sizeof(S) == 2 ? 3 : (rnd(0, 1) ? 3 : 1);
+    std::vector<S> src(sh * sw * (sizeof(S) == 2 ? 1 : sch) + 1);
+    for (S& p : src) {
+        p = (S)rng();
+    }
+    S* s = src.data() + (sizeof(S) == 2 ? rnd(0, 1) : 0); // RGB565 rows not word aligned
+    int dw = rnd(1, 50), dh = rnd(1, 50), dch = rnd(0, 1) ? 3 : 1;
+    int dx0 = rnd(0, dw - 1), dx1 = rnd(dx0 + 1, dw), dy0 = rnd(0, dh - 1), dy1 = rnd(dy0 + 1, dh);
+    int sx0 = rnd(-5, sw - 1), sx1 = rnd(sx0 + 1, sw + 5), sy0 = rnd(-5, sh - 1), sy1 = rnd(sy0 + 1, sh + 5);
+    resize_type_t type = (resize_type_t)rnd(0, 2);
+    int shift = sizeof(T) == 2 ? rnd(0, 4) : 0;
+    std::vector<T> scalar(dw * dh * dch + 1, 7), swar = scalar, reference = scalar;
+    int offset = rnd(0, 1);
+    simd::set_kernel(simd::KERNEL_SCALAR);
+    simd::crop_and_resize(scalar.data() + offset, dw, dch, dy0, dy1, dx0, dx1, s, sh, sw, sch, sy0, sy1, sx0, sx1,
+                          type, shift);
+    simd::set_kernel(simd::KERNEL_SWAR);
+    simd::crop_and_resize(swar.data() + offset, dw, dch, dy0, dy1, dx0, dx1, s, sh, sw, sch, sy0, sy1, sx0, sx1,
+                          type, shift);
+    reference_crop(reference.data() + offset, dw, dch, dy0, dy1, dx0, dx1, s, sh, sw, sch, sy0, sy1, sx0, sx1,
+                   type, shift);
+    if (swar != scalar || scalar != reference) {
+        fprintf(stderr, "crop_and_resize: type %d, %dx%dx%d source, %d channel destination: swar %s, scalar %s\n",
+                type, sw, sh, sch, dch, swar == scalar ? "ok" : "differs", scalar == reference ? "ok" : "wrong");
+        return 1;
+    }
+    return 0;
+}
+
+template <typename T>
+int check_resize() {
+    int sh = rnd(1, 60), sw = rnd(1, 60), ch = rnd(1, 3), th = rnd(1, 80), tw = rnd(1, 80);
+    std::vector<T> src(sh * sw * ch);
+    for (T& p : src) {
+        p = (T)rng();
+    }
+    std::vector<T> scalar(th * tw * ch), swar(scalar.size()), reference(scalar.size());
+    for (int y = 0; y < th; y++) {
+        for (int x = 0; x < tw; x++) {
+            for (int c = 0; c < ch; c++) {
+                reference[(y * tw + x) * ch + c] = src[((y * sh / th) * sw + x * sw / tw) * ch + c];
+            }
+        }
+    }
+    simd::set_kernel(simd::KERNEL_SCALAR);
+    simd::resize_image_nearest(src.data(), { sh, sw, ch }, scalar.data(), { th, tw, ch });
+    simd::set_kernel(simd::KERNEL_SWAR);
+    simd::resize_image_nearest(src.data(), { sh, sw, ch }, swar.data(), { th, tw, ch });
+    T* allocated = simd::resize_image_nearest(src.data(), { sh, sw, ch }, { th, tw, ch });
+    bool same = swar == scalar && scalar == reference && memcmp(allocated, swar.data(), swar.size() * sizeof(T)) == 0;
+    free(allocated);
+    if (!same) {
+        fprintf(stderr, "resize_image_nearest: %dx%dx%d to %dx%d differs\n", sw, sh, ch, tw, th);
+        return 1;
+    }
+    return 0;
+}
+
+// Moving points of two RGB565 and two RGB888 frames, mostly small changes around the threshold
+int check_moving_points() {
+    int h = rnd(1, 64), w = rnd(1, 64), stride = rnd(1, 9), threshold = rnd(0, 300);
+    std::vector<uint16_t> a565(h * w), b565(h * w);
+    std::vector<uint8_t> a888(h * w * 3), b888(h * w * 3);
+    for (int i = 0; i < h * w; i++) {
+        a565[i] = rng();
+        b565[i] = rnd(0, 3) ? a565[i] ^ (rng() & 0x1F1F) : rng();
+    }
+    for (int i = 0; i < h * w * 3; i++) {
+        a888[i] = rng();
+        b888[i] = rnd(0, 1) ? a888[i] + rnd(-40, 40) : rng();
+    }
+    uint32_t reference565 = 0, reference888 = 0;
+    for (int y = 0; y < h; y += stride) {
+        for (int x = 0; x < w; x += stride) {
+            int i = y * w + x;
+            reference565 += abs(convert_pixel_rgb565_to_gray(a565[i]) - convert_pixel_rgb565_to_gray(b565[i])) >
+                            threshold;
+            reference888 += abs(convert_pixel_rgb888_to_gray(a888[3 * i + 2], a888[3 * i + 1], a888[3 * i]) -
+                                convert_pixel_rgb888_to_gray(b888[3 * i + 2], b888[3 * i + 1], b888[3 * i])) >
+                            threshold;
+        }
+    }
+    int wrong = 0;
+    for (simd::kernel_t kernel : { simd::KERNEL_SCALAR, simd::KERNEL_SWAR }) {
+        simd::set_kernel(kernel);
+        uint32_t n565 = simd::get_moving_point_number(a565.data(), b565.data(), h, w, stride, threshold);
+        uint32_t n888 = simd::get_moving_point_number(a888.data(), b888.data(), h, w, stride, threshold);
+        if (n565 != reference565 || n888 != reference888) {
+            fprintf(stderr, "get_moving_point_number: kernel %d, %dx%d stride %d: %u/%u, expected %u/%u\n", kernel,
+                    w, h, stride, n565, n888, reference565, reference888);
+            wrong = 1;
+        }
+    }
+    return wrong;
+}
+
+int check_convert() {
+    int h = rnd(1, 40), w = rnd(1, 40);
+    std::vector<uint16_t> src(h * w + 1);
+    for (uint16_t& p : src) {
+        p = rng();
+    }
+    uint16_t* image = src.data() + rnd(0, 1);
+    std::vector<int> shape = { h, w, 3 };
+    simd::set_kernel(simd::KERNEL_SCALAR);
+    dl::Tensor<uint8_t>* scalar = simd::convert_image_rgb565_to_rgb888(image, shape);
+    simd::set_kernel(simd::KERNEL_SWAR);
+    dl::Tensor<uint8_t>* swar = simd::convert_image_rgb565_to_rgb888(image, shape);
+    bool same = memcmp(scalar->element, swar->element, h * w * 3) == 0;
+    for (int i = 0; i < h * w && same; i++) {
+        uint8_t bgr[3];
+        convert_pixel_rgb565_to_rgb888(image[i], bgr);
+        same = memcmp(bgr, scalar->element + 3 * i, 3) == 0;
+    }
+    delete scalar;
+    delete swar;
+    if (!same) {
+        fprintf(stderr, "convert_image_rgb565_to_rgb888: %dx%d differs\n", w, h);
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main() {
+    // The firmware runs the SWAR kernels unless told otherwise
+    CHECK_EQ(simd::get_kernel(), simd::KERNEL_SWAR);
+    int crop565 = 0, crop888 = 0, resize = 0, moving = 0, convert = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        crop565 += check_crop<uint8_t, uint16_t>() + check_crop<int8_t, uint16_t>() + check_crop<int16_t, uint16_t>();
+        crop888 += check_crop<uint8_t, uint8_t>() + check_crop<int8_t, uint8_t>() + check_crop<int16_t, uint8_t>();
+        resize += check_resize<uint8_t>() + check_resize<int8_t>() + check_resize<uint16_t>() +
+                  check_resize<int16_t>();
+        moving += check_moving_points();
+        convert += check_convert();
+    }
+    CHECK_EQ(crop565, 0);
+    CHECK_EQ(crop888, 0);
+    CHECK_EQ(resize, 0);
+    CHECK_EQ(moving, 0);
+    CHECK_EQ(convert, 0);
+    return check_summary("image_simd");
+}
@@ -0,0 +1,216 @@
+/**
+ * @file test_model_arena.cpp
+ * @brief Activation arena shared by the S3 models (dl_model_arena.cpp of its esp-dl): bind, attach, commit,
+ * rebase_variables.
+ *
+ * A model is stood in for by its ModelContext: root_alloc() with the sizes its memory manager planned, then
+ * variable tensors placed at offsets of the roots, as MemoryManagerGreedy does.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "check.h"
+#include "dl_model_arena.hpp"
+#include "dl_model_context.hpp"
+
+namespace {
+
+// A planned model: its context and where its tensors are, as offsets of the internal and PSRAM roots
+struct Plan {
+    dl::ModelContext context;
+    size_t internal_size;
+    size_t psram_size;
+    std::vector<size_t> internal_offsets;
+    std::vector<size_t> psram_offsets;
+    dl::TensorBase *own = nullptr; // tensor with its own memory, never moved
+
+    Plan(size_t internal, size_t psram, std::vector<size_t> internal_at, std::vector<size_t> psram_at) :
+        internal_size(internal), psram_size(psram), internal_offsets(internal_at), psram_offsets(psram_at)
+    {
+    }
+
+    bool alloc()
+    {
+        if (!context.root_alloc(internal_size, psram_size)) {
+            return false;
+        }
+        context.push_back_tensor(nullptr);
+        for (size_t offset : internal_offsets) {
+            uint8_t *data = (uint8_t *)context.get_internal_root() + offset;
+            context.push_back_tensor(new dl::TensorBase({ 16 }, data, 0, dl::DATA_TYPE_INT8, false));
+        }
+        for (size_t offset : psram_offsets) {
+            uint8_t *data = (uint8_t *)context.get_psram_root() + offset;
+            context.push_back_tensor(new dl::TensorBase({ 16 }, data, 0, dl::DATA_TYPE_INT8, false));
+        }
+        own = new dl::TensorBase({ 16 }, nullptr, 0, dl::DATA_TYPE_INT8);
+        context.push_back_tensor(own);
+        return true;
+    }
+
+    uint8_t *internal_tensor(int i) { return (uint8_t *)context.m_variables[1 + i]->data; }
+    uint8_t *psram_tensor(int i) { return (uint8_t *)context.m_variables[1 + internal_offsets.size() + i]->data; }
+};
+
+bool inside(const void *p, const void *begin, size_t size)
+{
+    return (uintptr_t)p >= (uintptr_t)begin && (uintptr_t)p < (uintptr_t)begin + size;
+}
+
+// Every planned tensor sits at its offset of the roots the context uses now
+void check_placed(Plan &plan)
+{
+    for (size_t i = 0; i < plan.internal_offsets.size(); i++) {
+        CHECK(plan.internal_tensor(i) == (uint8_t *)plan.context.get_internal_root() + plan.internal_offsets[i]);
+    }
+    for (size_t i = 0; i < plan.psram_offsets.size(); i++) {
+        CHECK(plan.psram_tensor(i) == (uint8_t *)plan.context.get_psram_root() + plan.psram_offsets[i]);
+    }
+}
+
+void test_bind()
+{
+    CHECK(dl::ModelArena::get_bound() == nullptr);
+    dl::ModelArena a, b;
+    a.bind();
+    CHECK(dl::ModelArena::get_bound() == &a);
+    b.bind(); // replaces a
+    CHECK(dl::ModelArena::get_bound() == &b);
+    a.unbind(); // not the bound one, no change
+    CHECK(dl::ModelArena::get_bound() == &b);
+    b.unbind();
+    CHECK(dl::ModelArena::get_bound() == nullptr);
+    {
+        dl::ModelArena gone;
+        gone.bind();
+    }
+    CHECK(dl::ModelArena::get_bound() == nullptr);
+
+    // Built without a bound arena: own memory
+    Plan plan(256, 1024, { 0, 128 }, { 512 });
+    CHECK(plan.alloc());
+    CHECK(plan.context.get_internal_root() != nullptr && plan.context.get_psram_root() != nullptr);
+    CHECK_EQ(a.get_model_count(), 0);
+    check_placed(plan);
+}
+
+// Detector and feature model planned against one arena, committed: the arena is the larger plan, both alias it
+void test_commit()
+{
+    dl::ModelArena arena;
+    arena.bind();
+    Plan detect(4096, 640, { 0, 1024, 4000 }, { 0, 600 });
+    Plan feat(1024, 8192, { 0, 1000 }, { 16, 4096, 8000 });
+    CHECK(detect.alloc());
+    CHECK(feat.alloc());
+    arena.unbind();
+    CHECK_EQ(arena.get_model_count(), 2);
+    CHECK_EQ(arena.get_internal_size(), 4096);
+    CHECK_EQ(arena.get_psram_size(), 8192);
+    size_t internal_sum, psram_sum;
+    arena.get_private_size(internal_sum, psram_sum);
+    CHECK_EQ(internal_sum, 4096 + 1024);
+    CHECK_EQ(psram_sum, 640 + 8192);
+
+    // Before commit: placeholder roots, never nullptr (TensorBase would allocate), internal and PSRAM apart
+    CHECK(detect.context.get_internal_root() != nullptr && detect.context.get_psram_root() != nullptr);
+    CHECK((uintptr_t)detect.context.get_internal_root() + 4096 <= (uintptr_t)detect.context.get_psram_root());
+    check_placed(detect);
+    check_placed(feat);
+    uint8_t *detect_own = (uint8_t *)detect.own->data;
+
+    CHECK(arena.commit());
+    void *internal_root = detect.context.get_internal_root();
+    void *psram_root = detect.context.get_psram_root();
+    CHECK(feat.context.get_internal_root() == internal_root);
+    CHECK(feat.context.get_psram_root() == psram_root);
+    CHECK(!inside(psram_root, internal_root, 4096) && !inside(internal_root, psram_root, 8192));
+    // Moved to the same offsets of the arena memory
+    check_placed(detect);
+    check_placed(feat);
+    CHECK(inside(detect.internal_tensor(2) + 15, internal_root, 4096));
+    CHECK(inside(feat.psram_tensor(2) + 15, psram_root, 8192));
+    CHECK(detect.own->data == detect_own);
+
+    // Same memory: what one model writes, the other reads
+    memset(detect.internal_tensor(0), 0x5A, 16);
+    CHECK(feat.internal_tensor(0)[7] == 0x5A);
+    memset(feat.psram_tensor(0), 0xA5, 16);
+    CHECK(detect.psram_tensor(0)[0] == 0); // offset 0, not 16
+    CHECK(((uint8_t *)psram_root)[16] == 0xA5);
+
+    CHECK(arena.commit()); // once only, nothing moves
+    CHECK(detect.context.get_internal_root() == internal_root);
+    check_placed(feat);
+
+    // The models go first (as in ~FaceRecognizer), detaching from the arena
+    detect.context.clear();
+    CHECK_EQ(arena.get_model_count(), 1);
+    arena.get_private_size(internal_sum, psram_sum);
+    CHECK_EQ(internal_sum, 1024);
+    CHECK_EQ(psram_sum, 8192);
+    feat.context.clear();
+    CHECK_EQ(arena.get_model_count(), 0);
+}
+
+// A model built after commit uses the arena if its plan fits, otherwise its own memory
+void test_after_commit()
+{
+    dl::ModelArena arena;
+    arena.bind();
+    Plan first(2048, 2048, { 0 }, { 0 });
+    CHECK(first.alloc());
+    CHECK(arena.commit());
+
+    Plan fits(1024, 2048, { 512 }, { 2032 });
+    CHECK(fits.alloc());
+    CHECK(fits.context.get_internal_root() == first.context.get_internal_root());
+    CHECK(fits.context.get_psram_root() == first.context.get_psram_root());
+    check_placed(fits);
+    CHECK_EQ(arena.get_model_count(), 2);
+    CHECK_EQ(arena.get_internal_size(), 2048);
+
+    Plan larger(4096, 16, { 4000 }, { 0 });
+    CHECK(larger.alloc());
+    CHECK(!inside(larger.context.get_internal_root(), first.context.get_internal_root(), 2048));
+    check_placed(larger);
+    CHECK_EQ(arena.get_model_count(), 2);
+    CHECK_EQ(arena.get_internal_size(), 2048);
+    arena.unbind();
+    larger.context.clear();
+    fits.context.clear();
+    first.context.clear();
+    CHECK_EQ(arena.get_model_count(), 0);
+}
+
+// rebase_variables() moves only the tensors inside the current roots
+void test_rebase()
+{
+    Plan plan(256, 256, { 0, 200 }, { 64 });
+    CHECK(plan.alloc());
+    uint8_t outside[16];
+    plan.context.push_back_tensor(new dl::TensorBase({ 16 }, outside, 0, dl::DATA_TYPE_INT8, false));
+    std::vector<uint8_t> internal(256), psram(256);
+    void *old_internal = plan.context.get_internal_root();
+    void *old_psram = plan.context.get_psram_root();
+    plan.context.rebase_variables(internal.data(), psram.data());
+    CHECK(plan.internal_tensor(0) == internal.data());
+    CHECK(plan.internal_tensor(1) == internal.data() + 200);
+    CHECK(plan.psram_tensor(0) == psram.data() + 64);
+    CHECK(plan.context.m_variables.back()->data == outside);
+    // Own memory of the context, freed by clear(): give it back first
+    plan.context.rebase_variables(old_internal, old_psram);
+    check_placed(plan);
+}
+
+} // namespace
+
+int main()
+{
+    test_bind();
+    test_commit();
+    test_after_commit();
+    test_rebase();
+    return check_summary("model_arena");
+}
@@ -0,0 +1,514 @@
+/**
+ * @file test_mqtt_topic.c
+ * @brief Topic registry and MQTT 5 topic aliases of the firmwares (mqtt_topic.c of esp32-s3-wroom-1).
+ *
+ * esp_mqtt_client_publish() is a stand-in that serializes the PUBLISH packet as esp-mqtt sends it (MQTT 3.1.1
+ * or 5) and hands it to a broker, which parses it and resolves the topic aliases of the connection. A bare
+ * alias the broker does not know on that connection is a protocol error. The registry keeps its state in
+ * statics: each case runs in a child process, its checks and figures go to the parent through `shared`.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "check.h"
+#include "mqtt_topic.h"
+
+#define BASE "embed/esp32-s3-wroom-1/bme280" // MQTT_TOPIC_BME280
+#define BROKER_MAX_ALIASES 16
+#define PUBLISH_COST_US 40 // simulated time of a publish that is sent
+
+int64_t test_time_us;
+
+typedef struct {
+    int checks, failed;
+    // Day of readings, per mode
+    uint32_t bytes[3]; // field, JSON, batch messages
+    uint32_t messages, protocol_errors;
+    double registry_ns; // per publish, host CPU, stand-in and broker excluded
+} shared_t;
+
+static shared_t *shared;
+
+// Client stand-in and broker
+static struct {
+    bool mqtt5;
+    bool connected;
+    uint16_t alias_max;                            // Topic Alias Maximum of the broker's CONNACK
+    esp_mqtt5_publish_property_config_t property; // for the next publish
+    int msg_id;
+    char aliases[BROKER_MAX_ALIASES + 1][128];     // broker side, this connection
+    uint32_t bytes;                                // PUBLISH packets sent
+    uint32_t packets;
+    uint32_t protocol_errors;
+    uint32_t bare_aliases;                         // packets with an empty topic name
+    char topic[128];                               // as the broker resolved it
+    uint8_t payload[256];
+    int payload_len;
+    int64_t stand_in_ns;
+} s_net;
+
+static esp_mqtt_client_handle_t const client = (esp_mqtt_client_handle_t)&s_net;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static size_t put_varint(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    do {
+        p[n] = v & 0x7F;
+        v >>= 7;
+        p[n] |= v ? 0x80 : 0;
+        n++;
+    } while (v);
+    return n;
+}
+
+static uint32_t get_varint(const uint8_t **p) {
+    uint32_t v = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t b = *(*p)++;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+}
+
+// Broker: parses one PUBLISH, resolves its topic. false for a protocol error.
+static bool broker_receive(const uint8_t *packet, size_t len) {
+    const uint8_t *p = packet;
+    int qos = (*p++ >> 1) & 3;
+    uint32_t remaining = get_varint(&p);
+    if ((size_t)(p - packet) + remaining != len) {
+        return false;
+    }
+    const uint8_t *end = p + remaining;
+    uint16_t name_len = (uint16_t)(p[0] << 8 | p[1]);
+    p += 2;
+    char name[128];
+    memcpy(name, p, name_len);
+    name[name_len] = '\0';
+    p += name_len;
+    if (qos > 0) {
+        p += 2;
+    }
+    uint16_t alias = 0;
+    if (s_net.mqtt5) {
+        uint32_t props_len = get_varint(&p);
+        const uint8_t *props_end = p + props_len;
+        while (p < props_end) {
+            if (*p++ != 0x23) {
+                return false; // only Topic Alias is sent
+            }
+            alias = (uint16_t)(p[0] << 8 | p[1]);
+            p += 2;
+        }
+    }
+    if (alias > 0) {
+        if (alias > s_net.alias_max) {
+            return false;
+        }
+        if (name_len > 0) {
+            strcpy(s_net.aliases[alias], name);
+        } else if (s_net.aliases[alias][0] == '\0') {
+            return false;
+        }
+        strcpy(s_net.topic, s_net.aliases[alias]);
+    } else if (name_len == 0) {
+        return false;
+    } else {
+        strcpy(s_net.topic, name);
+    }
+    s_net.bare_aliases += name_len == 0;
+    s_net.payload_len = (int)(end - p);
+    memcpy(s_net.payload, p, s_net.payload_len);
+    return true;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t c, const char *topic, const char *data, int len, int qos,
+                            int retain) {
+    int64_t start = now_ns();
+    CHECK(c == client);
+    if (!s_net.connected) {
+        s_net.stand_in_ns += now_ns() - start;
+        return -1; // QoS 0 only here: QoS 1/2 would go to the outbox
+    }
+    if (len == 0) {
+        len = (int)strlen(data);
+    }
+    uint8_t body[512];
+    size_t n = 0;
+    size_t name_len = strlen(topic);
+    body[n++] = (uint8_t)(name_len >> 8);
+    body[n++] = (uint8_t)name_len;
+    memcpy(body + n, topic, name_len);
+    n += name_len;
+    if (qos > 0) {
+        s_net.msg_id++;
+        body[n++] = (uint8_t)(s_net.msg_id >> 8);
+        body[n++] = (uint8_t)s_net.msg_id;
+    }
+    if (s_net.mqtt5) {
+        if (s_net.property.topic_alias) {
+            n += put_varint(body + n, 3);
+            body[n++] = 0x23;
+            body[n++] = (uint8_t)(s_net.property.topic_alias >> 8);
+            body[n++] = (uint8_t)s_net.property.topic_alias;
+        } else {
+            n += put_varint(body + n, 0);
+        }
+        s_net.property = (esp_mqtt5_publish_property_config_t){ 0 }; // used by this publish only
+    }
+    memcpy(body + n, data, len);
+    n += len;
+    uint8_t packet[520];
+    size_t size = 0;
+    packet[size++] = (uint8_t)(0x30 | qos << 1 | (retain ? 1 : 0));
+    size += put_varint(packet + size, (uint32_t)n);
+    memcpy(packet + size, body, n);
+    size += n;
+
+    s_net.bytes += size;
+    s_net.packets++;
+    if (!broker_receive(packet, size)) {
+        s_net.protocol_errors++; // the broker closes the connection
+        s_net.connected = false;
+        mqtt_topic_handle_event(client, MQTT_EVENT_DISCONNECTED);
+    }
+    test_time_us += PUBLISH_COST_US;
+    s_net.stand_in_ns += now_ns() - start;
+    return qos > 0 ? s_net.msg_id : 0;
+}
+
+esp_err_t esp_mqtt5_client_set_publish_property(esp_mqtt_client_handle_t c,
+                                                const esp_mqtt5_publish_property_config_t *property) {
+    int64_t start = now_ns();
+    CHECK(c == client);
+    CHECK(s_net.mqtt5);
+    // esp-mqtt checks the alias against the CONNACK of the current connection
+    esp_err_t ret = ESP_FAIL;
+    if (property->topic_alias <= s_net.alias_max) {
+        s_net.property = *property;
+        ret = ESP_OK;
+    }
+    s_net.stand_in_ns += now_ns() - start;
+    return ret;
+}
+
+static void connect(uint16_t alias_max) {
+    mqtt_topic_handle_event(client, MQTT_EVENT_BEFORE_CONNECT);
+    memset(s_net.aliases, 0, sizeof(s_net.aliases));
+    s_net.alias_max = alias_max;
+    s_net.connected = true;
+    mqtt_topic_handle_event(client, MQTT_EVENT_CONNECTED);
+}
+
+static void disconnect(void) {
+    s_net.connected = false;
+    mqtt_topic_handle_event(client, MQTT_EVENT_DISCONNECTED);
+}
+
+static void init(bool mqtt5, uint16_t alias_max) {
+    s_net.mqtt5 = mqtt5;
+    mqtt_topic_init(xSemaphoreCreateMutex(), mqtt5, alias_max);
+}
+
+// Publishes and checks that the broker got the message on the topic
+static int publish(mqtt_topic_t topic, const char *name, const char *text, int qos) {
+    uint32_t packets = s_net.packets;
+    int msg_id = mqtt_publish_topic(client, topic, text, (int)strlen(text), qos, 0);
+    if (msg_id >= 0) {
+        CHECK_EQ(s_net.packets, packets + 1);
+        CHECK(strcmp(s_net.topic, name) == 0);
+        CHECK(s_net.payload_len == (int)strlen(text) && memcmp(s_net.payload, text, s_net.payload_len) == 0);
+    }
+    return msg_id;
+}
+
+// Runs one case in a child process
+static void run(void (*test)(void)) {
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        s_check_count = s_check_failed = 0;
+        test();
+        shared->checks += s_check_count;
+        shared->failed += s_check_failed;
+        fflush(stdout);
+        fflush(stderr);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static void test_registry(void) {
+    CHECK_EQ(mqtt_topic_register(BASE), MQTT_TOPIC_INVALID); // before mqtt_topic_init()
+    init(true, 8);
+    static const char *names[MQTT_MAX_TOPICS] = { BASE "/0", BASE "/1", BASE "/2", BASE "/3",
+                                                  BASE "/4", BASE "/5", BASE "/6", BASE "/7" };
+    for (int i = 0; i < MQTT_MAX_TOPICS; i++) {
+        CHECK_EQ(mqtt_topic_register(names[i]), i);
+    }
+    char copy[64];
+    strcpy(copy, names[3]);
+    CHECK_EQ(mqtt_topic_register(copy), 3); // same name, same handle
+    CHECK_EQ(mqtt_topic_register(BASE "/8"), MQTT_TOPIC_INVALID);
+    CHECK_EQ(mqtt_topic_register(""), MQTT_TOPIC_INVALID);
+    CHECK_EQ(mqtt_topic_register(NULL), MQTT_TOPIC_INVALID);
+    connect(8);
+    CHECK_EQ(mqtt_publish_topic(client, MQTT_MAX_TOPICS, "1", 1, 0, 0), -1);
+    CHECK_EQ(mqtt_publish_topic(client, 0, "1", 0, 0, 0), -1);
+    CHECK_EQ(mqtt_publish_topic(NULL, 0, "1", 1, 0, 0), -1);
+    mqtt_topic_stats_t stats;
+    CHECK_EQ(mqtt_topic_get_stats(MQTT_MAX_TOPICS, &stats), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(mqtt_topic_get_stats(0, &stats), ESP_OK);
+    CHECK_EQ(stats.publishes, 0);
+    CHECK_EQ(s_net.packets, 0);
+}
+
+// The first QoS 0 publish of a connection announces the alias, the later ones send it alone. QoS 1 keeps the
+// name. The counters are the bytes that went out.
+static void test_aliases(void) {
+    init(true, 8);
+    mqtt_topic_t temp = mqtt_topic_register(BASE "/temperature");
+    mqtt_topic_t batch = mqtt_topic_register(BASE "/batch");
+    connect(8);
+    CHECK_EQ(publish(temp, BASE "/temperature", "21.53", 0), 0);
+    CHECK_EQ(s_net.bare_aliases, 0);
+    uint32_t announced = s_net.bytes;
+    CHECK_EQ(publish(temp, BASE "/temperature", "21.54", 0), 0);
+    CHECK_EQ(s_net.bare_aliases, 1);
+    uint32_t bare = s_net.bytes - announced;
+    CHECK_EQ(bare, 1 + 1 + 2 + 1 + 3 + 5); // header, length, empty name, properties, payload
+    CHECK_EQ(announced - bare, strlen(BASE "/temperature"));
+    CHECK(publish(batch, BASE "/batch", "binary batch", 1) > 0);
+    CHECK_EQ(s_net.bare_aliases, 1); // QoS 1: name, no alias
+    CHECK(publish(batch, BASE "/batch", "binary batch", 1) > 0);
+    CHECK_EQ(s_net.bare_aliases, 1);
+
+    // A new connection does not know the alias: announced again
+    disconnect();
+    CHECK_EQ(publish(temp, BASE "/temperature", "21.55", 0), -1);
+    connect(8);
+    CHECK_EQ(publish(temp, BASE "/temperature", "21.56", 0), 0);
+    CHECK_EQ(s_net.bare_aliases, 1);
+    CHECK_EQ(publish(temp, BASE "/temperature", "21.57", 0), 0);
+    CHECK_EQ(s_net.bare_aliases, 2);
+    CHECK_EQ(s_net.protocol_errors, 0);
+
+    mqtt_topic_stats_t t, b;
+    CHECK_EQ(mqtt_topic_get_stats(temp, &t), ESP_OK);
+    CHECK_EQ(mqtt_topic_get_stats(batch, &b), ESP_OK);
+    CHECK_EQ(t.publishes, 4); // the one while disconnected failed
+    CHECK_EQ(t.aliased, 2);
+    CHECK_EQ(b.publishes, 2);
+    CHECK_EQ(b.aliased, 0);
+    CHECK_EQ(t.wire_bytes + b.wire_bytes, s_net.bytes);
+    CHECK_EQ(t.publish_us + b.publish_us, s_net.packets * PUBLISH_COST_US);
+}
+
+// Aliases over the broker's Topic Alias Maximum are refused for that connection: sent by name, no error
+static void test_broker_limit(void) {
+    init(true, 8);
+    static const char *names[4] = { BASE "/temperature", BASE "/humidity", BASE "/pressure", BASE };
+    mqtt_topic_t topics[4];
+    for (int i = 0; i < 4; i++) {
+        topics[i] = mqtt_topic_register(names[i]);
+    }
+    connect(2);
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 4; i++) {
+            CHECK_EQ(publish(topics[i], names[i], "42.00", 0), 0);
+        }
+    }
+    CHECK_EQ(s_net.bare_aliases, 2 * 2); // topics 0 and 1, rounds 1 and 2
+    // A broker without aliases (no Topic Alias Maximum in its CONNACK)
+    connect(0);
+    uint32_t bare = s_net.bare_aliases;
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ(publish(topics[i], names[i], "42.00", 0), 0);
+        CHECK_EQ(publish(topics[i], names[i], "42.01", 0), 0);
+    }
+    CHECK_EQ(s_net.bare_aliases, bare);
+    // Back to a broker with 8: all four aliased
+    connect(8);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ(publish(topics[i], names[i], "42.00", 0), 0);
+        CHECK_EQ(publish(topics[i], names[i], "42.01", 0), 0);
+    }
+    CHECK_EQ(s_net.bare_aliases, bare + 4);
+    CHECK_EQ(s_net.protocol_errors, 0);
+    uint32_t wire = 0;
+    for (int i = 0; i < 4; i++) {
+        mqtt_topic_stats_t st;
+        mqtt_topic_get_stats(topics[i], &st);
+        wire += st.wire_bytes;
+    }
+    CHECK_EQ(wire, s_net.bytes);
+}
+
+// An alias set up for a publish that could not be sent must not go out with the next one. Also after a reconnect
+// (the MQTT task drops it on MQTT_EVENT_CONNECTED).
+static void test_failed_publish(void) {
+    init(true, 8);
+    mqtt_topic_t a = mqtt_topic_register(BASE "/a");
+    mqtt_topic_t b = mqtt_topic_register(BASE "/b");
+    connect(8);
+    CHECK_EQ(publish(a, BASE "/a", "1", 0), 0);
+    mqtt_topic_handle_event(client, MQTT_EVENT_DISCONNECTED); // lost, the client has not noticed yet
+    s_net.connected = false;
+    CHECK_EQ(publish(a, BASE "/a", "2", 0), -1);
+    CHECK_EQ(s_net.property.topic_alias, 0);
+    connect(8);
+    // Plain publish of the firmware (connect status message) right after the connect
+    CHECK_EQ(esp_mqtt_client_publish(client, BASE "/status/connect", "{}", 0, 1, 0), 1);
+    CHECK(strcmp(s_net.topic, BASE "/status/connect") == 0);
+    CHECK_EQ(publish(b, BASE "/b", "3", 0), 0);
+    CHECK_EQ(publish(a, BASE "/a", "4", 0), 0);
+    CHECK_EQ(publish(a, BASE "/a", "5", 0), 0);
+    CHECK_EQ(s_net.protocol_errors, 0);
+}
+
+// MQTT 3.1.1: no properties, no aliases, the counters still exact
+static void test_mqtt311(void) {
+    init(false, 8);
+    mqtt_topic_t t = mqtt_topic_register(BASE "/temperature");
+    connect(0);
+    for (int i = 0; i < 5; i++) {
+        CHECK_EQ(publish(t, BASE "/temperature", "21.53", 0), 0);
+    }
+    CHECK_EQ(s_net.bare_aliases, 0);
+    CHECK_EQ(s_net.bytes, 5 * (1 + 1 + 2 + strlen(BASE "/temperature") + 5));
+    mqtt_topic_stats_t st;
+    mqtt_topic_get_stats(t, &st);
+    CHECK_EQ(st.wire_bytes, s_net.bytes);
+    CHECK_EQ(st.aliased, 0);
+}
+
+// A day of the BME280 firmware at its 2-minute period with TELEMETRY_BATCH_ENABLED 0: three field messages and
+// the JSON one per reading at QoS 0, plus a QoS 1 batch every 30 min. A reconnect every 100 readings.
+enum { DAY_FIELD, DAY_JSON, DAY_BATCH };
+
+static void run_day(bool mqtt5, uint16_t alias_max, uint16_t broker_max) {
+    init(mqtt5, alias_max);
+    static const char *fields[3] = { BASE "/temperature", BASE "/humidity", BASE "/pressure" };
+    // Registered in the order of bme280.c
+    mqtt_topic_t json = mqtt_topic_register(BASE);
+    mqtt_topic_t batch = mqtt_topic_register(BASE "/batch");
+    mqtt_topic_t field[3];
+    for (int i = 0; i < 3; i++) {
+        field[i] = mqtt_topic_register(fields[i]);
+    }
+    char batch_data[111];
+    memset(batch_data, 'B', 110);
+    batch_data[110] = '\0';
+    int64_t registry_ns = 0;
+    s_net.stand_in_ns = 0;
+    for (int reading = 0; reading < 720; reading++) {
+        if (reading % 100 == 0) {
+            connect(mqtt5 ? broker_max : 0);
+        }
+        double t = 21.5 + reading % 37 * 0.07, h = 45.2 + reading % 23 * 0.11, p = 1013.25 + reading % 11 * 0.13;
+        double values[3] = { t, h, p };
+        char text[128];
+        uint32_t before;
+        int64_t start;
+        for (int i = 0; i < 3; i++) {
+            snprintf(text, sizeof(text), "%.2f", values[i]);
+            before = s_net.bytes;
+            start = now_ns();
+            CHECK_EQ(publish(field[i], fields[i], text, 0), 0);
+            registry_ns += now_ns() - start;
+            shared->bytes[DAY_FIELD] += s_net.bytes - before;
+        }
+        snprintf(text, sizeof(text), "{\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f}", t, h, p);
+        before = s_net.bytes;
+        start = now_ns();
+        CHECK_EQ(publish(json, BASE, text, 0), 0);
+        registry_ns += now_ns() - start;
+        shared->bytes[DAY_JSON] += s_net.bytes - before;
+        if (reading % 15 == 14) {
+            before = s_net.bytes;
+            start = now_ns();
+            CHECK(publish(batch, BASE "/batch", batch_data, 1) > 0);
+            registry_ns += now_ns() - start;
+            shared->bytes[DAY_BATCH] += s_net.bytes - before;
+        }
+    }
+    uint32_t wire = 0;
+    for (mqtt_topic_t topic = 0; topic < 5; topic++) {
+        mqtt_topic_stats_t st;
+        mqtt_topic_get_stats(topic, &st);
+        wire += st.wire_bytes;
+    }
+    CHECK_EQ(wire, s_net.bytes);
+    shared->messages = s_net.packets;
+    shared->protocol_errors = s_net.protocol_errors;
+    shared->registry_ns = (double)(registry_ns - s_net.stand_in_ns) / s_net.packets;
+}
+
+static void day_mqtt311(void) {
+    run_day(false, 8, 0);
+}
+
+static void day_mqtt5(void) {
+    run_day(true, 0, 8);
+}
+
+static void day_aliases(void) {
+    run_day(true, 8, 8);
+}
+
+static void day_broker_limit(void) {
+    run_day(true, 8, 2);
+}
+
+// Prints the bytes per PUBLISH of each message and the registry's CPU time per publish on the host
+static void test_day(void) {
+    static const struct {
+        const char *mode;
+        void (*run)(void);
+    } modes[] = { { "MQTT 3.1.1", day_mqtt311 },
+                  { "MQTT 5, no alias", day_mqtt5 },
+                  { "MQTT 5, 8 aliases", day_aliases },
+                  { "MQTT 5, broker 2", day_broker_limit } };
+    uint32_t total[4];
+    for (int m = 0; m < 4; m++) {
+        memset(shared->bytes, 0, sizeof(shared->bytes));
+        run(modes[m].run);
+        CHECK_EQ(shared->messages, 720 * 4 + 48);
+        CHECK_EQ(shared->protocol_errors, 0);
+        total[m] = shared->bytes[DAY_FIELD] + shared->bytes[DAY_JSON] + shared->bytes[DAY_BATCH];
+        printf("day, %-17s: field %.1f B, JSON %.1f B, batch %.1f B per PUBLISH, %u B/day, registry %.0f ns/publish\n",
+               modes[m].mode, shared->bytes[DAY_FIELD] / (720.0 * 3), shared->bytes[DAY_JSON] / 720.0,
+               shared->bytes[DAY_BATCH] / 48.0, (unsigned)total[m], shared->registry_ns);
+        if (m == 2) {
+            CHECK(shared->bytes[DAY_FIELD] < 720 * 3 * 16); // ~13 B: header, length, alias, value
+        }
+    }
+    CHECK(total[2] < total[0] * 6 / 10);
+    CHECK(total[2] < total[3] && total[3] < total[1]);
+}
+
+int main(void) {
+    shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    run(test_registry);
+    run(test_aliases);
+    run(test_broker_limit);
+    run(test_failed_publish);
+    run(test_mqtt311);
+    test_day();
+    s_check_count += shared->checks;
+    s_check_failed += shared->failed;
+    return check_summary("mqtt_topic");
+}
@@ -0,0 +1,117 @@
+/**
+ * @file test_sensor_aggregate.c
+ * @brief Report-by-exception of the BME280 readings (sensor_aggregate.c, shared with the Arduino sketch).
+ */
+
+#include <stdlib.h>
+#include "check.h"
+#include "sensor_aggregate.h"
+
+static const float DEADBAND[3] = { 0.2f, 1.0f, 0.5f }; // degC, %RH, hPa, as the firmware
+#define HEARTBEAT_MS 1800000
+
+// First reading, a window inside the deadbands, then the change that closes it
+static void test_window(void) {
+    sensor_aggregate_t agg;
+    sensor_report_t report;
+    sensor_aggregate_init(&agg, 3, DEADBAND, HEARTBEAT_MS);
+
+    float v[3] = { 21.0f, 40.0f, 1000.0f };
+    CHECK_EQ(sensor_aggregate_add(&agg, 0, v, &report), SENSOR_REPORT_FIRST);
+    CHECK_EQ(report.samples, 1);
+    CHECK_NEAR(report.field[0].last, 21.0, 0);
+
+    const float temps[] = { 21.1f, 20.9f, 21.15f, 20.85f }; // within 0.2, off the float boundary
+    for (int i = 0; i < 4; i++) {
+        v[0] = temps[i];
+        CHECK_EQ(sensor_aggregate_add(&agg, 120000 * (i + 1), v, &report), SENSOR_REPORT_NONE);
+    }
+    v[0] = 21.25f; // 0.25 above the last report
+    v[1] = 40.5f;
+    CHECK_EQ(sensor_aggregate_add(&agg, 600000, v, &report), SENSOR_REPORT_CHANGE);
+    CHECK_EQ(report.start_ms, 120000);
+    CHECK_EQ(report.end_ms, 600000);
+    CHECK_EQ(report.samples, 5);
+    CHECK_NEAR(report.field[0].min, 20.85, 1e-6);
+    CHECK_NEAR(report.field[0].max, 21.25, 1e-6);
+    CHECK_NEAR(report.field[0].mean, (21.1 + 20.9 + 21.15 + 20.85 + 21.25) / 5, 1e-5);
+    CHECK_NEAR(report.field[0].last, 21.25, 0);
+    CHECK_NEAR(report.field[1].min, 40.0, 0);
+    CHECK_NEAR(report.field[1].max, 40.5, 0);
+    CHECK_NEAR(report.field[2].mean, 1000.0, 1e-4);
+
+    // The deadband is around the new report: 21.25 +- 0.2
+    v[0] = 21.1f;
+    CHECK_EQ(sensor_aggregate_add(&agg, 720000, v, &report), SENSOR_REPORT_NONE);
+    v[0] = 21.0f;
+    CHECK_EQ(sensor_aggregate_add(&agg, 840000, v, &report), SENSOR_REPORT_CHANGE);
+    CHECK_EQ(report.samples, 2);
+    CHECK_EQ(agg.reports, 3);
+    CHECK_EQ(agg.total_samples, 8);
+
+    // Any field leaves its deadband
+    v[2] = 1000.6f;
+    CHECK_EQ(sensor_aggregate_add(&agg, 960000, v, &report), SENSOR_REPORT_CHANGE);
+}
+
+static void test_heartbeat(void) {
+    sensor_aggregate_t agg;
+    sensor_report_t report;
+    sensor_aggregate_init(&agg, 3, DEADBAND, HEARTBEAT_MS);
+    float v[3] = { 21.0f, 40.0f, 1000.0f };
+    CHECK_EQ(sensor_aggregate_add(&agg, 5000, v, &report), SENSOR_REPORT_FIRST);
+    int reports = 0;
+    for (int64_t t = 5000 + 120000; t <= 5000 + 2 * HEARTBEAT_MS; t += 120000) {
+        sensor_report_reason_t reason = sensor_aggregate_add(&agg, t, v, &report);
+        if (reason != SENSOR_REPORT_NONE) {
+            CHECK_EQ(reason, SENSOR_REPORT_HEARTBEAT);
+            CHECK_EQ(report.end_ms - 5000, (int64_t)HEARTBEAT_MS * (reports + 1));
+            CHECK_EQ(report.samples, HEARTBEAT_MS / 120000);
+            reports++;
+        }
+    }
+    CHECK_EQ(reports, 2);
+    CHECK_EQ(agg.heartbeats, 2);
+}
+
+// Holding the last reported value reconstructs every reading within its deadband
+static void test_reconstruction(void) {
+    sensor_aggregate_t agg;
+    sensor_report_t report;
+    sensor_aggregate_init(&agg, 3, DEADBAND, HEARTBEAT_MS);
+    srand(37);
+    float v[3] = { 21.0f, 40.0f, 1000.0f };
+    const float step[3] = { 0.05f, 0.3f, 0.1f };
+    float held[3] = { 0 };
+    float max_error[3] = { 0 };
+    int readings = 7 * 24 * 30, published = 0;
+    for (int i = 0; i < readings; i++) {
+        for (int f = 0; f < 3; f++) {
+            v[f] += step[f] * ((float)rand() / RAND_MAX * 2 - 1);
+        }
+        if (sensor_aggregate_add(&agg, (int64_t)i * 120000, v, &report) != SENSOR_REPORT_NONE) {
+            for (int f = 0; f < 3; f++) {
+                held[f] = report.field[f].last;
+            }
+            published++;
+        }
+        for (int f = 0; f < 3; f++) {
+            float error = fabsf(v[f] - held[f]);
+            max_error[f] = error > max_error[f] ? error : max_error[f];
+        }
+    }
+    for (int f = 0; f < 3; f++) {
+        CHECK(max_error[f] <= DEADBAND[f]);
+    }
+    CHECK(published < readings / 2);
+    CHECK_EQ(agg.reports, published);
+    printf("random walk: %d readings, %d published, max error %.3f / %.3f / %.3f\n", readings, published,
+           max_error[0], max_error[1], max_error[2]);
+}
+
+int main(void) {
+    test_window();
+    test_heartbeat();
+    test_reconstruction();
+    return check_summary("sensor_aggregate");
+}
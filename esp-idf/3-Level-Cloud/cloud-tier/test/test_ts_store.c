@@ -0,0 +1,323 @@
+/**
+ * @file test_ts_store.c
+ * @brief Flash time-series store of the sensor firmware (ts_store.c) across resets and power losses.
+ *
+ * The store keeps its state in statics and has no close: each boot runs in a child process, so a reset drops
+ * the RAM state and keeps the flash (shared memory, see sim_partition.c). What a boot uploads and counts goes
+ * through `shared` to the parent, which checks it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "check.h"
+#include "esp_partition.h"
+#include "telemetry_batch.h"
+#include "ts_store.h"
+
+#define PARTITION "tsdb"
+#define START_MS 1760000000000LL
+#define MAX_RECEIVED 50000
+
+typedef struct {
+    long appended;      // samples the boot appended, as far as it got
+    long received;      // samples uploaded
+    int upload_calls;
+    int fail_upload_at; // upload call that fails, -1: none
+    ts_store_stats_t stats;
+    int checks, failed; // CHECKs of the boots
+    telemetry_sample_t samples[MAX_RECEIVED];
+} shared_t;
+
+static shared_t *shared;
+static ts_store_config_t s_config = { .partition = PARTITION, .fields = 3, .resolution_ms = 1000, .flush_samples = 4 };
+static uint64_t s_rng;
+
+static uint32_t rnd(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)s_rng;
+}
+
+// BME280 reading i every period_s (0.01 °C, 0.01 %RH, Pa), a few ms of jitter on the time, one seed per sample
+static void reading(long i, int period_s, telemetry_sample_t *s) {
+    double t = (double)i * period_s;
+    s_rng = 1000 + i;
+    s->time_ms = START_MS + (int64_t)i * period_s * 1000 + rnd() % 4;
+    s->value[0] = (int32_t)lround(2150 + 300 * sin(2 * M_PI * t / 86400)) + (int)(rnd() % 3) - 1;
+    s->value[1] = (int32_t)lround(4500 - 800 * sin(2 * M_PI * t / 86400)) + (int)(rnd() % 5) - 2;
+    s->value[2] = (int32_t)lround(101325 + 400 * sin(2 * M_PI * t / 259200)) + (int)(rnd() % 3) - 1;
+    s->value[3] = 0;
+}
+
+static void append(long from, long n, int period_s) {
+    for (long i = from; i < from + n; i++) {
+        telemetry_sample_t s;
+        reading(i, period_s, &s);
+        ts_store_append(s.time_ms, true, s.value);
+        shared->appended = i + 1;
+    }
+}
+
+static esp_err_t upload(const telemetry_sample_t *samples, int count, bool unix_time, bool this_boot, void *ctx) {
+    (void)unix_time;
+    (void)this_boot;
+    (void)ctx;
+    if (shared->upload_calls++ == shared->fail_upload_at) {
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < count && shared->received < MAX_RECEIVED; i++) {
+        shared->samples[shared->received++] = samples[i];
+    }
+    return ESP_OK;
+}
+
+static esp_err_t backfill_all(void) {
+    esp_err_t ret;
+    while ((ret = ts_store_backfill(8, upload, NULL)) == ESP_ERR_NOT_FINISHED) {
+    }
+    return ret;
+}
+
+// Runs one boot: opens the store, then run(arg). Returns the exit status, SIM_POWER_LOSS_EXIT if the power was cut.
+static int boot(void (*run)(long), long arg) {
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        s_check_count = s_check_failed = 0;
+        CHECK_EQ(ts_store_open(&s_config), ESP_OK);
+        run(arg);
+        ts_store_get_stats(&shared->stats);
+        shared->checks += s_check_count;
+        shared->failed += s_check_failed;
+        fflush(stdout);
+        fflush(stderr);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void new_partition(int blocks) {
+    sim_partition_create(PARTITION, blocks * TS_STORE_BLOCK_SIZE);
+    shared->appended = 0;
+    shared->received = 0;
+    shared->upload_calls = 0;
+    shared->fail_upload_at = -1;
+}
+
+// The received samples are readings from..from+n, times within the store's resolution
+static void check_received(long from, long n, int period_s) {
+    CHECK_EQ(shared->received, n);
+    long same = 0;
+    for (long i = 0; i < n && i < shared->received; i++) {
+        telemetry_sample_t s;
+        reading(from + i, period_s, &s);
+        const telemetry_sample_t *r = &shared->samples[i];
+        same += llabs(r->time_ms - s.time_ms) <= s_config.resolution_ms / 2 && memcmp(r->value, s.value, 12) == 0;
+    }
+    CHECK_EQ(same, n);
+}
+
+static void run_append(long n) {
+    append(0, n, 120);
+}
+
+static void run_backfill(long unused) {
+    (void)unused;
+    CHECK_EQ(backfill_all(), ESP_OK);
+    CHECK(!ts_store_pending());
+}
+
+// A reset loses at most the samples not flushed yet, the next boot seals the interrupted block
+static void test_reboot(void) {
+    new_partition(64);
+    CHECK_EQ(boot(run_append, 1003), 0);
+    CHECK_EQ(boot(run_backfill, 0), 0);
+    CHECK_EQ(shared->stats.boot, 2);
+    long lost = 1003 - shared->received;
+    CHECK(lost >= 0 && lost < s_config.flush_samples);
+    check_received(0, shared->received, 120);
+}
+
+static void run_failed_upload(long fail_at) {
+    append(0, 500, 120);
+    ts_store_seal();
+    shared->fail_upload_at = (int)fail_at;
+    CHECK_EQ(ts_store_backfill(8, upload, NULL), ESP_FAIL);
+    CHECK(ts_store_pending());
+}
+
+// A block whose upload failed is sent whole again, after a reset too
+static void test_failed_upload(void) {
+    new_partition(64);
+    CHECK_EQ(boot(run_failed_upload, 3), 0);
+    CHECK_EQ(shared->received, 3 * TS_STORE_UPLOAD_SAMPLES);
+    shared->received = 0;
+    shared->fail_upload_at = -1;
+    CHECK_EQ(boot(run_backfill, 0), 0);
+    check_received(0, 500, 120);
+}
+
+static void run_fill(long n) {
+    append(0, n, 1);
+    ts_store_seal();
+    ts_store_get_stats(&shared->stats);
+    CHECK_EQ(backfill_all(), ESP_OK);
+}
+
+// A full store reuses the oldest block, uploaded or not: the dropped samples are counted, the newest kept
+static void test_full(void) {
+    new_partition(8);
+    CHECK_EQ(boot(run_fill, 40000), 0);
+    CHECK(shared->stats.dropped > 0);
+    CHECK_EQ(shared->received + shared->stats.dropped, 40000);
+    check_received(40000 - shared->received, shared->received, 1);
+}
+
+static void run_merge(long rounds) {
+    // Reconnects seal a small block each
+    for (long k = 0; k < rounds; k++) {
+        append(k * 30, 30, 120);
+        ts_store_seal();
+    }
+    ts_store_stats_t before, after;
+    ts_store_get_stats(&before);
+    CHECK_EQ(ts_store_compact(0, true, INT64_MAX / 2), ESP_OK);
+    ts_store_get_stats(&after);
+    CHECK(after.pending_blocks < before.pending_blocks);
+    CHECK(after.merged_blocks > 0);
+    CHECK_EQ(backfill_all(), ESP_OK);
+}
+
+static void test_merge(void) {
+    new_partition(64);
+    CHECK_EQ(boot(run_merge, 20), 0);
+    check_received(0, 600, 120);
+    CHECK_EQ(sim_partition->set_bits, 0);
+}
+
+static void run_retention(long n) {
+    append(0, n, 120);
+    ts_store_seal();
+    telemetry_sample_t last;
+    reading(n - 1, 120, &last);
+    CHECK_EQ(ts_store_compact(last.time_ms, true, 86400000LL), ESP_OK);
+    ts_store_get_stats(&shared->stats);
+    CHECK_EQ(backfill_all(), ESP_OK);
+}
+
+// Blocks whose newest sample is older than the retention are erased, sent or not
+static void test_retention(void) {
+    new_partition(64);
+    CHECK_EQ(boot(run_retention, 2000), 0); // 2.8 days
+    CHECK(shared->stats.expired > 0);
+    CHECK_EQ(shared->received + shared->stats.expired, 2000);
+    // Whole blocks go, the kept ones cover the last day
+    CHECK(shared->received >= 720);
+    check_received(2000 - shared->received, shared->received, 120);
+}
+
+static void run_workload(long unused) {
+    (void)unused;
+    for (int k = 0; k < 12; k++) {
+        append(k * 25, 25, 120);
+        ts_store_seal();
+        if (k % 4 == 3) {
+            ts_store_compact(0, true, INT64_MAX / 2);
+        }
+    }
+}
+
+// Drops the samples a cut boot uploaded but could not mark, sent again by the next one. Uploads are at least
+// once, receivers dedupe by timestamp.
+static long dedupe(long from) {
+    long n = from;
+    for (long i = from; i < shared->received; i++) {
+        if (n == 0 || shared->samples[i].time_ms > shared->samples[n - 1].time_ms) {
+            shared->samples[n++] = shared->samples[i];
+        }
+    }
+    long dropped = shared->received - n;
+    shared->received = n;
+    return dropped;
+}
+
+// The power is cut at every other flash operation of appends, seals and merges, and in some runs again in the
+// recovery. The samples must be uploaded in order, none corrupt, every flushed one. Only a cut upload sends a
+// block twice.
+static void test_power_loss(void) {
+    int cuts = 0, complete = 0;
+    long unflushed = 0, resent = 0;
+    for (uint32_t at = 1; complete < 3; at += 2) {
+        new_partition(16);
+        sim_partition->power_loss_after = at;
+        int status = boot(run_workload, 0);
+        if (status == 0) {
+            complete++;
+            continue;
+        }
+        CHECK_EQ(status, SIM_POWER_LOSS_EXIT);
+        cuts++;
+        long appended = shared->appended;
+        sim_partition->power_loss_after = at % 5 == 1 ? 2 : 0;
+        if (boot(run_backfill, 0) == SIM_POWER_LOSS_EXIT) {
+            long before = shared->received;
+            CHECK_EQ(boot(run_backfill, 0), 0);
+            resent += dedupe(before);
+        }
+        long lost = appended - shared->received;
+        CHECK(lost >= -1 && lost < s_config.flush_samples); // the cut sample may be complete on flash
+        check_received(0, shared->received, 120);
+        CHECK_EQ(sim_partition->set_bits, 0);
+        unflushed += lost;
+    }
+    printf("power loss: %d cuts, %ld unflushed samples lost, %ld sent twice after a cut upload\n", cuts, unflushed,
+           resent);
+    CHECK(cuts > 100);
+}
+
+static void run_week(long unused) {
+    (void)unused;
+    append(0, 7 * 720, 120);
+    ts_store_seal();
+    ts_store_get_stats(&shared->stats);
+    CHECK_EQ(backfill_all(), ESP_OK);
+}
+
+// A week at the firmware's period: bytes programmed per sample for a flush every sample and every 15
+static void test_week(void) {
+    const uint16_t flushes[] = { 1, 15 };
+    for (size_t k = 0; k < sizeof(flushes) / sizeof(flushes[0]); k++) {
+        s_config.flush_samples = flushes[k];
+        new_partition(256);
+        CHECK_EQ(boot(run_week, 0), 0);
+        check_received(0, 7 * 720, 120);
+        CHECK_EQ(shared->stats.dropped, 0);
+        const ts_store_stats_t *st = &shared->stats;
+        printf("week every 120 s, flush every %u: %.2f bytes/sample programmed, %lu blocks, %lu frames\n",
+               flushes[k], (double)st->bytes_written / st->appended, (unsigned long)(st->blocks - st->free_blocks),
+               (unsigned long)st->frames);
+        CHECK(st->bytes_written < 7 * 720 * 20); // smaller than raw (int64 time, 3 x int32)
+    }
+    s_config.flush_samples = 4;
+}
+
+int main(void) {
+    shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    test_reboot();
+    test_failed_upload();
+    test_full();
+    test_merge();
+    test_retention();
+    test_power_loss();
+    test_week();
+    s_check_count += shared->checks;
+    s_check_failed += shared->failed;
+    return check_summary("ts_store");
+}
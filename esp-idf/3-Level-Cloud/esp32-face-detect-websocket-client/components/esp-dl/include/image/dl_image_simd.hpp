@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "dl_image.hpp"
+
+namespace dl
+{
+    namespace image
+    {
+        /**
+         * @brief Source built versions of the image utilities of dl_image.hpp.
+         *
+         * The functions have the signatures of their dl::image counterparts, whose code is only in the
+         * prebuilt libdl.a. The work of each call is split into row kernels (gather, RGB565 decode, vertical
+         * blend, moving point count) taken from a kernel table:
+         *   - KERNEL_SCALAR one pixel at a time, the reference
+         *   - KERNEL_SWAR   word-parallel, 2 pixels or 4 bytes per 32-bit register
+         * Both tables give bit-exact equal results. KERNEL_SWAR is the default on every target, the
+         * classic ESP32 of the camera has no vector unit and the ESP32-S3 PIE is not used yet.
+         *
+         * Pixel math is the one of the inline helpers of dl_image.hpp: RGB565 is decoded with
+         * convert_pixel_rgb565_to_rgb888(), so a decoded pixel is (blue, green, red), and gray is
+         * convert_pixel_rgb888_to_gray() of it. Sampling:
+         *   - nearest   src = src_start + i * src_span / dst_span
+         *   - bilinear  pixel centers aligned, 8-bit weights, rounded after the vertical and after the
+         *               horizontal blend
+         *   - mean      (p[y][x] + p[y][x + 1] + p[y + 1][x] + p[y + 1][x + 1]) >> 2 at the nearest position
+         * Coordinates out of the source image are clamped to its edge.
+         */
+        namespace simd
+        {
+            typedef enum
+            {
+                KERNEL_SCALAR = 0, /*<! one pixel at a time */
+                KERNEL_SWAR = 1,   /*<! 32-bit word-parallel */
+            } kernel_t;
+
+            /**
+             * @brief Select the row kernels of the following calls, for comparisons and benchmarks.
+             *
+             * @param kernel one of KERNEL_SCALAR or KERNEL_SWAR
+             */
+            void set_kernel(kernel_t kernel);
+
+            /**
+             * @brief Get the kernels in use.
+             *
+             * @return kernel_t the selected kernels
+             */
+            kernel_t get_kernel();
+
+            /**
+             * @brief Convert RGB565 image to RGB888 image.
+             *
+             * @param image       ptr of RGB565 image
+             * @param image_shape shape of the input image, (height, width, ...)
+             * @return Tensor<uint8_t>* output RGB888 image, (height, width, 3)
+             */
+            Tensor<uint8_t> *convert_image_rgb565_to_rgb888(uint16_t *image, std::vector<int> &image_shape);
+
+            /**
+             * @brief Crop a patch from an RGB565 image, resize it and store it to the destination image.
+             * Same as dl::image::crop_and_resize(), T is one of uint8_t, int8_t and int16_t.
+             *
+             * @param src_channel must be 3
+             * @param dst_channel 3 for (blue, green, red), 1 for gray
+             */
+            template <typename T>
+            void crop_and_resize(T *dst_image,
+                                 int dst_width,
+                                 int dst_channel,
+                                 int dst_y_start, int dst_y_end,
+                                 int dst_x_start, int dst_x_end,
+                                 uint16_t *src_image,
+                                 int src_height,
+                                 int src_width,
+                                 int src_channel,
+                                 int src_y_start, int src_y_end,
+                                 int src_x_start, int src_x_end,
+                                 resize_type_t resize_type = IMAGE_RESIZE_NEAREST,
+                                 int shift_left = 0);
+
+            /**
+             * @brief Crop a patch from an 8-bit image, resize it and store it to the destination image.
+             * Same as dl::image::crop_and_resize(), T is one of uint8_t, int8_t and int16_t.
+             *
+             * @param src_channel 1 or 3
+             * @param dst_channel 1 or 3, 3 channels are converted to gray, gray is copied to 3 channels
+             */
+            template <typename T>
+            void crop_and_resize(T *dst_image,
+                                 int dst_width,
+                                 int dst_channel,
+                                 int dst_y_start, int dst_y_end,
+                                 int dst_x_start, int dst_x_end,
+                                 uint8_t *src_image,
+                                 int src_height,
+                                 int src_width,
+                                 int src_channel,
+                                 int src_y_start, int src_y_end,
+                                 int src_x_start, int src_x_end,
+                                 resize_type_t resize_type = IMAGE_RESIZE_NEAREST,
+                                 int shift_left = 0);
+
+            /**
+             * @brief Detect target moving by activated detection point number, on RGB565 frames.
+             * Same as dl::image::get_moving_point_number().
+             *
+             * @return activated detection point number
+             */
+            uint32_t get_moving_point_number(uint16_t *f1, uint16_t *f2, const uint32_t height, const uint32_t width, const uint32_t stride, const uint32_t threshold = 5);
+
+            /**
+             * @brief Detect target moving by activated detection point number, on RGB888 frames.
+             * Same as dl::image::get_moving_point_number().
+             *
+             * @return activated detection point number
+             */
+            uint32_t get_moving_point_number(uint8_t *f1, uint8_t *f2, const uint32_t height, const uint32_t width, const uint32_t stride, const uint32_t threshold = 5);
+
+            /**
+             * @brief resize an image to the target shape with nearest method, T is one of uint8_t, int8_t,
+             * uint16_t and int16_t.
+             *
+             * @return T* the resized image, free it with dl::tool::free_aligned()
+             */
+            template <typename T>
+            T *resize_image_nearest(T *image, std::vector<int> input_shape, std::vector<int> target_shape);
+
+            /**
+             * @brief resize an image to the target shape with nearest method, T is one of uint8_t, int8_t,
+             * uint16_t and int16_t.
+             */
+            template <typename T>
+            void resize_image_nearest(T *image, std::vector<int> input_shape, T *resized_image, std::vector<int> target_shape);
+        } // namespace simd
+    }     // namespace image
+} // namespace dl
@@ -0,0 +1,619 @@
+#include "dl_image_simd.hpp"
+
+#include <assert.h>
+#include <string.h>
+#include <utility>
+#include "dl_tool.hpp"
+
+namespace dl
+{
+    namespace image
+    {
+        namespace simd
+        {
+            namespace
+            {
+                /**
+                 * @brief Row kernels. Rows of bytes, pixel_bytes per pixel, n counts pixels unless noted.
+                 */
+                struct kernels_t
+                {
+                    void (*gather)(const uint8_t *src, const int *index, uint8_t *dst, int n, int pixel_bytes);
+                    void (*decode_rgb565)(const uint16_t *src, uint8_t *dst, int n);
+                    /* (top * (256 - weight) + bottom * weight + 128) >> 8 of n bytes */
+                    void (*blend)(const uint8_t *top, const uint8_t *bottom, uint8_t *dst, int n, int weight);
+                    /* top + bottom of n bytes */
+                    void (*sum)(const uint8_t *top, const uint8_t *bottom, uint16_t *dst, int n);
+                    /* points of a row are step pixels apart, threshold <= 255 */
+                    uint32_t (*moving_rgb565)(const uint16_t *f1, const uint16_t *f2, int n, int step, int threshold);
+                    uint32_t (*moving_rgb888)(const uint8_t *f1, const uint8_t *f2, int n, int step, int threshold);
+                };
+
+                inline int clamp(int value, int low, int high)
+                {
+                    return value < low ? low : (value > high ? high : value);
+                }
+
+                inline bool is_aligned(const void *ptr)
+                {
+                    return ((uintptr_t)ptr & 3) == 0;
+                }
+
+                /* ------------------------------------------------------------------ scalar */
+
+                void gather_scalar(const uint8_t *src, const int *index, uint8_t *dst, int n, int pixel_bytes)
+                {
+                    for (int i = 0; i < n; i++)
+                    {
+                        const uint8_t *pixel = src + index[i] * pixel_bytes;
+                        for (int b = 0; b < pixel_bytes; b++)
+                            *dst++ = pixel[b];
+                    }
+                }
+
+                void decode_rgb565_scalar(const uint16_t *src, uint8_t *dst, int n)
+                {
+                    for (int i = 0; i < n; i++, dst += 3)
+                        convert_pixel_rgb565_to_rgb888(src[i], dst);
+                }
+
+                void blend_scalar(const uint8_t *top, const uint8_t *bottom, uint8_t *dst, int n, int weight)
+                {
+                    for (int i = 0; i < n; i++)
+                        dst[i] = (top[i] * (256 - weight) + bottom[i] * weight + 128) >> 8;
+                }
+
+                void sum_scalar(const uint8_t *top, const uint8_t *bottom, uint16_t *dst, int n)
+                {
+                    for (int i = 0; i < n; i++)
+                        dst[i] = top[i] + bottom[i];
+                }
+
+                uint32_t moving_rgb565_scalar(const uint16_t *f1, const uint16_t *f2, int n, int step, int threshold)
+                {
+                    uint32_t count = 0;
+                    for (int i = 0; i < n; i++)
+                    {
+                        int f1_gray = convert_pixel_rgb565_to_gray(f1[i * step]);
+                        int f2_gray = convert_pixel_rgb565_to_gray(f2[i * step]);
+                        if (DL_ABS(f1_gray - f2_gray) > threshold)
+                            count++;
+                    }
+                    return count;
+                }
+
+                uint32_t moving_rgb888_scalar(const uint8_t *f1, const uint8_t *f2, int n, int step, int threshold)
+                {
+                    uint32_t count = 0;
+                    for (int i = 0; i < n; i++)
+                    {
+                        const uint8_t *p1 = f1 + i * step * 3;
+                        const uint8_t *p2 = f2 + i * step * 3;
+                        int f1_gray = convert_pixel_rgb888_to_gray(p1[2], p1[1], p1[0]);
+                        int f2_gray = convert_pixel_rgb888_to_gray(p2[2], p2[1], p2[0]);
+                        if (DL_ABS(f1_gray - f2_gray) > threshold)
+                            count++;
+                    }
+                    return count;
+                }
+
+                const kernels_t scalar_kernels = {
+                    gather_scalar,
+                    decode_rgb565_scalar,
+                    blend_scalar,
+                    sum_scalar,
+                    moving_rgb565_scalar,
+                    moving_rgb888_scalar,
+                };
+
+                /* ------------------------------------------------------------------ SWAR */
+
+                /* Bytes are packed into aligned words and stored one word at a time. */
+                void gather_swar(const uint8_t *src, const int *index, uint8_t *dst, int n, int pixel_bytes)
+                {
+                    if (pixel_bytes != 1 && pixel_bytes != 2 && pixel_bytes != 3)
+                    {
+                        for (int i = 0; i < n; i++, dst += pixel_bytes)
+                            memcpy(dst, src + index[i] * pixel_bytes, pixel_bytes);
+                        return;
+                    }
+
+                    // at most 3 pixels until dst is aligned, 3 is odd and 1 and 2 byte pixels start aligned
+                    int head = 0;
+                    while (head < n && !is_aligned(dst + head * pixel_bytes) && head < 4)
+                        head++;
+                    if (!is_aligned(dst + head * pixel_bytes))
+                        head = n;
+                    gather_scalar(src, index, dst, head, pixel_bytes);
+                    index += head;
+                    dst += head * pixel_bytes;
+                    n -= head;
+
+                    uint32_t *out = (uint32_t *)__builtin_assume_aligned(dst, 4);
+                    int i = 0;
+                    if (pixel_bytes == 1)
+                    {
+                        for (; i + 4 <= n; i += 4)
+                            *out++ = src[index[i]] | (src[index[i + 1]] << 8) | (src[index[i + 2]] << 16) |
+                                     ((uint32_t)src[index[i + 3]] << 24);
+                    }
+                    else if (pixel_bytes == 2)
+                    {
+                        const uint16_t *pixels = (const uint16_t *)src;
+                        for (; i + 2 <= n; i += 2)
+                            *out++ = pixels[index[i]] | ((uint32_t)pixels[index[i + 1]] << 16);
+                    }
+                    else
+                    {
+                        for (; i + 4 <= n; i += 4)
+                        {
+                            const uint8_t *a = src + index[i] * 3;
+                            const uint8_t *b = src + index[i + 1] * 3;
+                            const uint8_t *c = src + index[i + 2] * 3;
+                            const uint8_t *d = src + index[i + 3] * 3;
+                            out[0] = a[0] | (a[1] << 8) | (a[2] << 16) | ((uint32_t)b[0] << 24);
+                            out[1] = b[1] | (b[2] << 8) | (c[0] << 16) | ((uint32_t)c[1] << 24);
+                            out[2] = c[2] | (d[0] << 8) | (d[1] << 16) | ((uint32_t)d[2] << 24);
+                            out += 3;
+                        }
+                    }
+                    gather_scalar(src, index + i, (uint8_t *)out, n - i, pixel_bytes);
+                }
+
+                /* Two RGB565 pixels, one per 16-bit lane, to blue, green and red lanes. */
+                inline void decode_rgb565_lanes(uint32_t w, uint32_t &blue, uint32_t &green, uint32_t &red)
+                {
+                    blue = (w & 0x1F001F00) >> 5;
+                    green = ((w & 0x00070007) << 5) | ((w & 0xE000E000) >> 11);
+                    red = w & 0x00F800F8;
+                }
+
+                /* Four pixels, two words, to 12 bytes: B0 G0 R0 B1 | G1 R1 B2 G2 | R2 B3 G3 R3 */
+                inline void decode_rgb565_x4(uint32_t w0, uint32_t w1, uint32_t *out)
+                {
+                    uint32_t b0, g0, r0, b1, g1, r1;
+                    decode_rgb565_lanes(w0, b0, g0, r0);
+                    decode_rgb565_lanes(w1, b1, g1, r1);
+                    out[0] = (b0 & 0xFF) | ((g0 << 8) & 0xFF00) | ((r0 & 0xFF) << 16) | ((b0 << 8) & 0xFF000000);
+                    out[1] = (g0 >> 16) | ((r0 >> 8) & 0xFF00) | ((b1 & 0xFF) << 16) | ((g1 & 0xFF) << 24);
+                    out[2] = (r1 & 0xFF) | ((b1 >> 8) & 0xFF00) | (g1 & 0xFF0000) | ((r1 << 8) & 0xFF000000);
+                }
+
+                void decode_rgb565_swar(const uint16_t *src, uint8_t *dst, int n)
+                {
+                    // 3 is odd, so dst is aligned after at most 3 pixels
+                    int head = 0;
+                    while (head < n && !is_aligned(dst + head * 3))
+                        head++;
+                    decode_rgb565_scalar(src, dst, head);
+                    src += head;
+                    dst += head * 3;
+                    n -= head;
+
+                    uint32_t *out = (uint32_t *)__builtin_assume_aligned(dst, 4);
+                    int i = 0;
+                    if (is_aligned(src))
+                    {
+                        const uint32_t *words = (const uint32_t *)__builtin_assume_aligned(src, 4);
+                        for (; i + 4 <= n; i += 4, words += 2, out += 3)
+                            decode_rgb565_x4(words[0], words[1], out);
+                    }
+                    else
+                    {
+                        for (; i + 4 <= n; i += 4, out += 3)
+                            decode_rgb565_x4(src[i] | ((uint32_t)src[i + 1] << 16), src[i + 2] | ((uint32_t)src[i + 3] << 16), out);
+                    }
+                    decode_rgb565_scalar(src + i, (uint8_t *)out, n - i);
+                }
+
+                /* Even and odd bytes in 16-bit lanes, a lane holds 255 * 256 + 128. */
+                void blend_swar(const uint8_t *top, const uint8_t *bottom, uint8_t *dst, int n, int weight)
+                {
+                    int i = 0;
+                    if (is_aligned(top) && is_aligned(bottom) && is_aligned(dst))
+                    {
+                        const uint32_t *t = (const uint32_t *)__builtin_assume_aligned(top, 4);
+                        const uint32_t *b = (const uint32_t *)__builtin_assume_aligned(bottom, 4);
+                        uint32_t *out = (uint32_t *)__builtin_assume_aligned(dst, 4);
+                        const uint32_t wt = 256 - weight, wb = weight;
+                        for (; i + 4 <= n; i += 4)
+                        {
+                            uint32_t tw = *t++, bw = *b++;
+                            uint32_t even = (tw & 0x00FF00FF) * wt + (bw & 0x00FF00FF) * wb + 0x00800080;
+                            uint32_t odd = ((tw >> 8) & 0x00FF00FF) * wt + ((bw >> 8) & 0x00FF00FF) * wb + 0x00800080;
+                            *out++ = ((even >> 8) & 0x00FF00FF) | (odd & 0xFF00FF00);
+                        }
+                    }
+                    blend_scalar(top + i, bottom + i, dst + i, n - i, weight);
+                }
+
+                void sum_swar(const uint8_t *top, const uint8_t *bottom, uint16_t *dst, int n)
+                {
+                    int i = 0;
+                    if (is_aligned(top) && is_aligned(bottom) && is_aligned(dst))
+                    {
+                        const uint32_t *t = (const uint32_t *)__builtin_assume_aligned(top, 4);
+                        const uint32_t *b = (const uint32_t *)__builtin_assume_aligned(bottom, 4);
+                        uint32_t *out = (uint32_t *)__builtin_assume_aligned(dst, 4);
+                        for (; i + 4 <= n; i += 4, out += 2)
+                        {
+                            uint32_t tw = *t++, bw = *b++;
+                            uint32_t even = (tw & 0x00FF00FF) + (bw & 0x00FF00FF);               // bytes 0, 2
+                            uint32_t odd = ((tw >> 8) & 0x00FF00FF) + ((bw >> 8) & 0x00FF00FF); // bytes 1, 3
+                            out[0] = (even & 0xFFFF) | (odd << 16);
+                            out[1] = (even >> 16) | (odd & 0xFFFF0000);
+                        }
+                    }
+                    sum_scalar(top + i, bottom + i, dst + i, n - i);
+                }
+
+                /* Gray of two pixels, 16-bit lanes, as convert_pixel_rgb888_to_gray(): a lane holds 255 * 128. */
+                inline uint32_t gray_lanes(uint32_t blue, uint32_t green, uint32_t red)
+                {
+                    return ((red * 38 + green * 75 + blue * 15) >> 7) & 0x00FF00FF;
+                }
+
+                /*
+                 * Activated lanes of two gray pairs. t = g1 - g2 + 256 is in [1, 511] per lane, the point is
+                 * activated if t >= 257 + threshold or t <= 255 - threshold, each test sets bit 15 of a lane.
+                 */
+                inline uint32_t count_moving_lanes(uint32_t gray1, uint32_t gray2, uint32_t above, uint32_t below)
+                {
+                    uint32_t t = gray1 + 0x01000100 - gray2;
+                    uint32_t active = ((t + above) | (below - t)) & 0x80008000;
+                    return ((active >> 15) & 1) + (active >> 31);
+                }
+
+                uint32_t moving_rgb565_swar(const uint16_t *f1, const uint16_t *f2, int n, int step, int threshold)
+                {
+                    const uint32_t above = (uint32_t)(0x8000 - 257 - threshold) * 0x00010001;
+                    const uint32_t below = (uint32_t)(0x8000 + 255 - threshold) * 0x00010001;
+                    uint32_t count = 0;
+                    int i = 0;
+                    for (; i + 2 <= n; i += 2, f1 += 2 * step, f2 += 2 * step)
+                    {
+                        uint32_t b, g, r;
+                        decode_rgb565_lanes(f1[0] | ((uint32_t)f1[step] << 16), b, g, r);
+                        uint32_t gray1 = gray_lanes(b, g, r);
+                        decode_rgb565_lanes(f2[0] | ((uint32_t)f2[step] << 16), b, g, r);
+                        uint32_t gray2 = gray_lanes(b, g, r);
+                        count += count_moving_lanes(gray1, gray2, above, below);
+                    }
+                    return count + moving_rgb565_scalar(f1, f2, n - i, step, threshold);
+                }
+
+                const kernels_t swar_kernels = {
+                    gather_swar,
+                    decode_rgb565_swar,
+                    blend_swar,
+                    sum_swar,
+                    moving_rgb565_swar,
+                    moving_rgb888_scalar, // packing 3 byte pixels into lanes costs more than it saves
+                };
+
+                const kernels_t *s_kernels = &swar_kernels;
+
+                /* ------------------------------------------------------------------ geometry */
+
+                void nearest_index(int *index, int n, int start, int span, int size)
+                {
+                    for (int i = 0; i < n; i++)
+                        index[i] = clamp(start + (int)((int64_t)i * span / n), 0, size - 1);
+                }
+
+                /* Pixel centers aligned, 8 fractional bits. index holds the pairs of taps. */
+                void bilinear_index(int *index, uint8_t *weight, int n, int start, int span, int size)
+                {
+                    for (int i = 0; i < n; i++)
+                    {
+                        int position = start * 256 + (int)((int64_t)(2 * i + 1) * span * 256 / (2 * n)) - 128;
+                        int low = position >> 8;
+                        index[2 * i] = clamp(low, 0, size - 1);
+                        index[2 * i + 1] = clamp(low + 1, 0, size - 1);
+                        weight[i] = position & 0xFF;
+                    }
+                }
+
+                /* index holds the pairs of taps, the nearest pixel and the next one. */
+                void mean_index(int *index, int n, int start, int span, int size)
+                {
+                    nearest_index(index, n, start, span, size);
+                    for (int i = n - 1; i >= 0; i--)
+                    {
+                        index[2 * i] = index[i];
+                        index[2 * i + 1] = DL_MIN(index[i] + 1, size - 1);
+                    }
+                }
+
+                /* ------------------------------------------------------------------ rows */
+
+                /* RGB565 row to (blue, green, red) bytes. */
+                void read_row(const uint16_t *row, int channel, const int *index, int n, uint8_t *line, uint16_t *scratch)
+                {
+                    s_kernels->gather((const uint8_t *)row, index, (uint8_t *)scratch, n, 2);
+                    s_kernels->decode_rgb565(scratch, line, n);
+                }
+
+                void read_row(const uint8_t *row, int channel, const int *index, int n, uint8_t *line, uint16_t *scratch)
+                {
+                    s_kernels->gather(row, index, line, n, channel);
+                }
+
+                template <typename T>
+                void store_row(const uint8_t *line, int n, int line_channel, T *dst, int dst_channel, int shift_left)
+                {
+                    if (dst_channel == line_channel)
+                    {
+                        if (sizeof(T) == 1 && shift_left == 0)
+                            memcpy(dst, line, n * dst_channel);
+                        else
+                            for (int i = 0; i < n * dst_channel; i++)
+                                dst[i] = (T)(line[i] << shift_left);
+                    }
+                    else if (dst_channel == 1)
+                    {
+                        for (int i = 0; i < n; i++, line += 3)
+                            dst[i] = (T)(convert_pixel_rgb888_to_gray(line[2], line[1], line[0]) << shift_left);
+                    }
+                    else
+                    {
+                        for (int i = 0; i < n; i++, dst += 3)
+                            dst[0] = dst[1] = dst[2] = (T)(line[i] << shift_left);
+                    }
+                }
+
+                template <typename T, typename S>
+                void crop_and_resize_rows(T *dst_image,
+                                          int dst_width,
+                                          int dst_channel,
+                                          int dst_y_start, int dst_y_end,
+                                          int dst_x_start, int dst_x_end,
+                                          const S *src_image,
+                                          int src_height,
+                                          int src_width,
+                                          int src_channel,
+                                          int src_y_start, int src_y_end,
+                                          int src_x_start, int src_x_end,
+                                          resize_type_t resize_type,
+                                          int shift_left)
+                {
+                    const int n = dst_x_end - dst_x_start;
+                    const int rows = dst_y_end - dst_y_start;
+                    if (n <= 0 || rows <= 0)
+                        return;
+
+                    const int line_channel = sizeof(S) == 2 ? 3 : src_channel; // RGB565 is decoded
+                    const int src_row_elements = src_width * (sizeof(S) == 2 ? 1 : src_channel);
+                    const int span_x = src_x_end - src_x_start, span_y = src_y_end - src_y_start;
+                    const int taps = resize_type == IMAGE_RESIZE_NEAREST ? 1 : 2;
+                    const int tap_bytes = n * taps * line_channel;
+
+                    std::vector<int> x_index(n * taps);
+                    std::vector<uint8_t> x_weight(resize_type == IMAGE_RESIZE_BILINEAR ? n : 0);
+                    if (resize_type == IMAGE_RESIZE_BILINEAR)
+                        bilinear_index(x_index.data(), x_weight.data(), n, src_x_start, span_x, src_width);
+                    else if (resize_type == IMAGE_RESIZE_MEAN)
+                        mean_index(x_index.data(), n, src_x_start, span_x, src_width);
+                    else
+                        nearest_index(x_index.data(), n, src_x_start, span_x, src_width);
+
+                    // words keep the rows aligned for the kernels
+                    std::vector<uint32_t> top((tap_bytes + 3) / 4), bottom(taps == 2 ? top.size() : 0);
+                    std::vector<uint32_t> mixed(taps == 2 ? (tap_bytes + 1) / 2 : 0), line(taps == 2 ? (n * line_channel + 3) / 4 : 0);
+                    std::vector<uint32_t> scratch(sizeof(S) == 2 ? (n * taps + 1) / 2 : 0);
+                    uint8_t *top_row = (uint8_t *)top.data(), *bottom_row = (uint8_t *)bottom.data();
+                    uint16_t *scratch_row = (uint16_t *)scratch.data();
+                    int top_y = -1, bottom_y = -1;
+
+                    const int dst_row_elements = dst_width * dst_channel;
+                    T *dst = dst_image + dst_y_start * dst_row_elements + dst_x_start * dst_channel;
+                    for (int r = 0; r < rows; r++, dst += dst_row_elements)
+                    {
+                        if (resize_type == IMAGE_RESIZE_NEAREST)
+                        {
+                            int y = clamp(src_y_start + (int)((int64_t)r * span_y / rows), 0, src_height - 1);
+                            if (y == top_y)
+                            {
+                                memcpy(dst, dst - dst_row_elements, n * dst_channel * sizeof(T));
+                                continue;
+                            }
+                            read_row(src_image + y * src_row_elements, src_channel, x_index.data(), n, top_row, scratch_row);
+                            top_y = y;
+                            store_row(top_row, n, line_channel, dst, dst_channel, shift_left);
+                            continue;
+                        }
+
+                        int y0, y1, weight = 0;
+                        if (resize_type == IMAGE_RESIZE_BILINEAR)
+                        {
+                            int position = src_y_start * 256 + (int)((int64_t)(2 * r + 1) * span_y * 256 / (2 * rows)) - 128;
+                            y0 = clamp(position >> 8, 0, src_height - 1);
+                            y1 = clamp((position >> 8) + 1, 0, src_height - 1);
+                            weight = position & 0xFF;
+                        }
+                        else
+                        {
+                            y0 = clamp(src_y_start + (int)((int64_t)r * span_y / rows), 0, src_height - 1);
+                            y1 = DL_MIN(y0 + 1, src_height - 1);
+                        }
+
+                        // going down, the bottom row of the previous output row is often the top row of this one
+                        if (y0 != top_y)
+                        {
+                            if (y0 == bottom_y)
+                            {
+                                std::swap(top_row, bottom_row);
+                                std::swap(top_y, bottom_y);
+                            }
+                            else
+                            {
+                                read_row(src_image + y0 * src_row_elements, src_channel, x_index.data(), n * 2, top_row, scratch_row);
+                                top_y = y0;
+                            }
+                        }
+                        if (y1 != bottom_y)
+                        {
+                            read_row(src_image + y1 * src_row_elements, src_channel, x_index.data(), n * 2, bottom_row, scratch_row);
+                            bottom_y = y1;
+                        }
+
+                        uint8_t *out = (uint8_t *)line.data();
+                        if (resize_type == IMAGE_RESIZE_BILINEAR)
+                        {
+                            uint8_t *blended = (uint8_t *)mixed.data();
+                            s_kernels->blend(top_row, bottom_row, blended, tap_bytes, weight);
+                            for (int i = 0; i < n; i++, blended += 2 * line_channel)
+                            {
+                                int wx = x_weight[i];
+                                for (int c = 0; c < line_channel; c++)
+                                    *out++ = (blended[c] * (256 - wx) + blended[line_channel + c] * wx + 128) >> 8;
+                            }
+                        }
+                        else
+                        {
+                            uint16_t *sums = (uint16_t *)mixed.data();
+                            s_kernels->sum(top_row, bottom_row, sums, tap_bytes);
+                            for (int i = 0; i < n; i++, sums += 2 * line_channel)
+                                for (int c = 0; c < line_channel; c++)
+                                    *out++ = (sums[c] + sums[line_channel + c]) >> 2;
+                        }
+                        store_row((uint8_t *)line.data(), n, line_channel, dst, dst_channel, shift_left);
+                    }
+                }
+            } // namespace
+
+            void set_kernel(kernel_t kernel)
+            {
+                s_kernels = kernel == KERNEL_SCALAR ? &scalar_kernels : &swar_kernels;
+            }
+
+            kernel_t get_kernel()
+            {
+                return s_kernels == &scalar_kernels ? KERNEL_SCALAR : KERNEL_SWAR;
+            }
+
+            Tensor<uint8_t> *convert_image_rgb565_to_rgb888(uint16_t *image, std::vector<int> &image_shape)
+            {
+                Tensor<uint8_t> *output = new Tensor<uint8_t>;
+                output->set_shape({image_shape[0], image_shape[1], 3}).malloc_element();
+                s_kernels->decode_rgb565(image, output->get_element_ptr(), image_shape[0] * image_shape[1]);
+                return output;
+            }
+
+            template <typename T>
+            void crop_and_resize(T *dst_image,
+                                 int dst_width,
+                                 int dst_channel,
+                                 int dst_y_start, int dst_y_end,
+                                 int dst_x_start, int dst_x_end,
+                                 uint16_t *src_image,
+                                 int src_height,
+                                 int src_width,
+                                 int src_channel,
+                                 int src_y_start, int src_y_end,
+                                 int src_x_start, int src_x_end,
+                                 resize_type_t resize_type,
+                                 int shift_left)
+            {
+                assert(src_channel == 3);
+                assert(dst_channel == 3 || dst_channel == 1);
+                crop_and_resize_rows(dst_image, dst_width, dst_channel, dst_y_start, dst_y_end, dst_x_start, dst_x_end,
+                                     (const uint16_t *)src_image, src_height, src_width, src_channel, src_y_start, src_y_end, src_x_start, src_x_end,
+                                     resize_type, shift_left);
+            }
+
+            template <typename T>
+            void crop_and_resize(T *dst_image,
+                                 int dst_width,
+                                 int dst_channel,
+                                 int dst_y_start, int dst_y_end,
+                                 int dst_x_start, int dst_x_end,
+                                 uint8_t *src_image,
+                                 int src_height,
+                                 int src_width,
+                                 int src_channel,
+                                 int src_y_start, int src_y_end,
+                                 int src_x_start, int src_x_end,
+                                 resize_type_t resize_type,
+                                 int shift_left)
+            {
+                assert(src_channel == 3 || src_channel == 1);
+                assert(dst_channel == 3 || dst_channel == 1);
+                crop_and_resize_rows(dst_image, dst_width, dst_channel, dst_y_start, dst_y_end, dst_x_start, dst_x_end,
+                                     (const uint8_t *)src_image, src_height, src_width, src_channel, src_y_start, src_y_end, src_x_start, src_x_end,
+                                     resize_type, shift_left);
+            }
+
+            uint32_t get_moving_point_number(uint16_t *f1, uint16_t *f2, const uint32_t height, const uint32_t width, const uint32_t stride, const uint32_t threshold)
+            {
+                const int n = (width + stride - 1) / stride;
+                const int limit = DL_MIN(threshold, 255); // gray differences are at most 255
+                uint32_t count = 0;
+                for (uint32_t y = 0; y < height; y += stride)
+                    count += s_kernels->moving_rgb565(f1 + y * width, f2 + y * width, n, stride, limit);
+                return count;
+            }
+
+            uint32_t get_moving_point_number(uint8_t *f1, uint8_t *f2, const uint32_t height, const uint32_t width, const uint32_t stride, const uint32_t threshold)
+            {
+                const int n = (width + stride - 1) / stride;
+                const int limit = DL_MIN(threshold, 255);
+                uint32_t count = 0;
+                for (uint32_t y = 0; y < height; y += stride)
+                    count += s_kernels->moving_rgb888(f1 + y * width * 3, f2 + y * width * 3, n, stride, limit);
+                return count;
+            }
+
+            template <typename T>
+            void resize_image_nearest(T *image, std::vector<int> input_shape, T *resized_image, std::vector<int> target_shape)
+            {
+                const int src_height = input_shape[0], src_width = input_shape[1];
+                const int channel = input_shape.size() > 2 ? input_shape[2] : 1;
+                const int dst_height = target_shape[0], dst_width = target_shape[1];
+                const int pixel_bytes = channel * sizeof(T);
+                const int row_bytes = dst_width * pixel_bytes;
+
+                std::vector<int> x_index(dst_width);
+                nearest_index(x_index.data(), dst_width, 0, src_width, src_width);
+
+                uint8_t *dst = (uint8_t *)resized_image;
+                int previous_y = -1;
+                for (int y = 0; y < dst_height; y++, dst += row_bytes)
+                {
+                    int src_y = y * src_height / dst_height;
+                    if (src_y == previous_y)
+                        memcpy(dst, dst - row_bytes, row_bytes);
+                    else
+                        s_kernels->gather((const uint8_t *)(image + src_y * src_width * channel), x_index.data(), dst, dst_width, pixel_bytes);
+                    previous_y = src_y;
+                }
+            }
+
+            template <typename T>
+            T *resize_image_nearest(T *image, std::vector<int> input_shape, std::vector<int> target_shape)
+            {
+                const int channel = input_shape.size() > 2 ? input_shape[2] : 1;
+                T *resized_image = (T *)dl::tool::malloc_aligned(target_shape[0] * target_shape[1] * channel, sizeof(T), 16);
+                if (resized_image)
+                    resize_image_nearest(image, input_shape, resized_image, target_shape);
+                return resized_image;
+            }
+
+            template void crop_and_resize(uint8_t *, int, int, int, int, int, int, uint16_t *, int, int, int, int, int, int, int, resize_type_t, int);
+            template void crop_and_resize(int8_t *, int, int, int, int, int, int, uint16_t *, int, int, int, int, int, int, int, resize_type_t, int);
+            template void crop_and_resize(int16_t *, int, int, int, int, int, int, uint16_t *, int, int, int, int, int, int, int, resize_type_t, int);
+            template void crop_and_resize(uint8_t *, int, int, int, int, int, int, uint8_t *, int, int, int, int, int, int, int, resize_type_t, int);
+            template void crop_and_resize(int8_t *, int, int, int, int, int, int, uint8_t *, int, int, int, int, int, int, int, resize_type_t, int);
+            template void crop_and_resize(int16_t *, int, int, int, int, int, int, uint8_t *, int, int, int, int, int, int, int, resize_type_t, int);
+
+            template void resize_image_nearest(uint8_t *, std::vector<int>, uint8_t *, std::vector<int>);
+            template void resize_image_nearest(int8_t *, std::vector<int>, int8_t *, std::vector<int>);
+            template void resize_image_nearest(uint16_t *, std::vector<int>, uint16_t *, std::vector<int>);
+            template void resize_image_nearest(int16_t *, std::vector<int>, int16_t *, std::vector<int>);
+            template uint8_t *resize_image_nearest(uint8_t *, std::vector<int>, std::vector<int>);
+            template int8_t *resize_image_nearest(int8_t *, std::vector<int>, std::vector<int>);
+            template uint16_t *resize_image_nearest(uint16_t *, std::vector<int>, std::vector<int>);
+            template int16_t *resize_image_nearest(int16_t *, std::vector<int>, std::vector<int>);
+        } // namespace simd
+    }     // namespace image
+} // namespace dl
@@ -17,6 +17,7 @@
 
 #include "esp_log.h"
 #include "esp_camera.h"
+#include "esp_timer.h"
 
 #include "dl_image.hpp"
 #include "who_human_face_detection.hpp"
@@ -37,6 +38,7 @@ static QueueHandle_t xQueueFrameO = NULL;
 static QueueHandle_t xQueueResult = NULL;
 
 static bool gEvent = true;
+static uint32_t s_frame_id = 0; // ids of the frames sent, the latency trace follows a frame by it
 
 void task_process_handler(void* arg)
 {
@@ -53,11 +55,15 @@ void task_process_handler(void* arg)
             if (xQueueReceive(xQueueFrameI, &frame, portMAX_DELAY))
             {
                 bool is_detected = false;
+                int64_t detect_us[2] = { 0, 0 };
 #if TWO_STAGE_ON
                 std::list<dl::detect::result_t>& detect_candidates = detector.infer((uint16_t*)frame->buf, { (int)frame->height, (int)frame->width, 3 });
+                detect_us[0] = esp_timer_get_time();
                 std::list<dl::detect::result_t>& detect_results = detector2.infer((uint16_t*)frame->buf, { (int)frame->height, (int)frame->width, 3 }, detect_candidates);
+                detect_us[1] = esp_timer_get_time();
 #else
                 std::list<dl::detect::result_t>& detect_results = detector.infer((uint16_t*)frame->buf, { (int)frame->height, (int)frame->width, 3 });
+                detect_us[0] = esp_timer_get_time();
 #endif
 
                 if (detect_results.size() > 0)
@@ -78,6 +84,9 @@ void task_process_handler(void* arg)
                             face_data->box.y = first_face.box[1];
                             face_data->box.w = first_face.box[2];
                             face_data->box.h = first_face.box[3];
+                            face_data->id = ++s_frame_id;
+                            face_data->detect_us[0] = detect_us[0];
+                            face_data->detect_us[1] = detect_us[1];
 
                             if (xQueueSend(xQueueFrameO, &face_data, 0) != pdTRUE)
                             {
@@ -17,6 +17,7 @@ typedef struct {
     camera_fb_t* fb;
     face_box_t box;
     uint32_t id; // The struct with a unique ID.
+    int64_t detect_us[2]; // esp_timer time the detection stages finished (MSR, MNP), 0 if not run
 } face_to_send_t;
 
 
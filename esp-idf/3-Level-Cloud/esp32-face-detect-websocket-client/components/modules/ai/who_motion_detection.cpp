@@ -4,6 +4,7 @@
 #include "esp_camera.h"
 
 #include "dl_image.hpp"
+#include "dl_image_simd.hpp"
 
 static const char *TAG = "motion_detection";
 
@@ -28,7 +29,7 @@ static void task_process_handler(void *arg)
             {
                 if (xQueueReceive(xQueueFrameI, &(frame2), portMAX_DELAY))
                 {
-                    uint32_t moving_point_number = dl::image::get_moving_point_number((uint16_t *)frame1->buf, (uint16_t *)frame2->buf, frame1->height, frame1->width, 8, 15);
+                    uint32_t moving_point_number = dl::image::simd::get_moving_point_number((uint16_t *)frame1->buf, (uint16_t *)frame2->buf, frame1->height, frame1->width, 8, 15);
                     if (moving_point_number > 50)
                     {
                         ESP_LOGI(TAG, "Something moved!");
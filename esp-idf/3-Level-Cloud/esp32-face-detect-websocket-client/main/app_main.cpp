@@ -6,6 +6,7 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -13,6 +14,10 @@
 #include "who_human_face_detection.hpp" // George added custom struct for the image
 #include "wifi.h"
 #include "websocket_client.h"
+#include "kernel_bench.h"
+#include "latency_trace.h"
+#include "binlog.h"
+#include "health_telemetry.h"
 
 static EventGroupHandle_t s_app_event_group;
 const static int WIFI_CONNECTED_BIT = (1 << 0);
@@ -28,14 +33,65 @@ static const char* TAG_APP_MAIN = "MAIN_APP";
 #define HEARTBEAT_ON 1
 #define SERVER_ACK_TIMEOUT_MS 30
 #define POST_DETECTION_COOLDOWN_S 30
+#define KERNEL_BENCH_ON 0 // Image kernel microbenchmarks at boot, before the camera starts
+#define LATENCY_TRACE_ON 1 // Stage timestamps of the faces sent, also sent to the S3 in frame_start
+#define LATENCY_TRACE_RING_SIZE 128 // power of 2
+#define LATENCY_TRACE_LOG_EVERY 10 // faces between two logs of the stage latencies
+#define CLOCK_SYNC_INTERVAL_S 10 // heartbeat period while tracing, the S3 clock offset comes from the heartbeats
+#define BINLOG_ON 1 // Messages of the face transfer as binary records, printed as "BL:" lines (cloud-tier binlog_decode)
+#define BINLOG_RECORDS 64 // per core, power of 2
+#define BINLOG_RATE_BURST 20 // messages of one line per window, the rest are counted
+#define BINLOG_RATE_WINDOW_MS 1000
+#define BINLOG_PRINT_PERIOD_MS 200
+#define HEALTH_TELEMETRY_ON 1 // Heap, PSRAM, stack and CPU snapshot sent to the S3 ({"type":"health"}), published there
+#define HEALTH_TELEMETRY_PERIOD_S 60
 
 #if HEARTBEAT_ON
 static void heartbeat_task(void* pvParameters) {
+#if LATENCY_TRACE_ON
+    const int interval_s = CLOCK_SYNC_INTERVAL_S;
+#else
+    const int interval_s = HEARTBEAT_INTERVAL_S;
+#endif
     while(true) {
         xEventGroupWaitBits(s_app_event_group, WIFI_CONNECTED_BIT | WEBSOCKET_CONNECTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
-        vTaskDelay(pdMS_TO_TICKS(HEARTBEAT_INTERVAL_S * 1000));
-        websocket_send_heartbeat();
+        websocket_send_heartbeat(); // right after connecting too, for the first clock offset
+        vTaskDelay(pdMS_TO_TICKS(interval_s * 1000));
+    }
+}
+#endif
+
+#if HEALTH_TELEMETRY_ON
+// Sent to the S3 while connected, it publishes the snapshots of the cameras with its own
+static void send_health(const char* source, const char* json, void* ctx) {
+    EventBits_t connected = WIFI_CONNECTED_BIT | WEBSOCKET_CONNECTED_BIT;
+    if ((xEventGroupGetBits(s_app_event_group) & connected) != connected || websocket_send_text(json) != ESP_OK) {
+        ESP_LOGI(TAG_APP_MAIN, "Health: %s", json);
+    }
+}
+#endif
+
+#if LATENCY_TRACE_ON
+static void log_trace_stats(void) {
+    int count = latency_trace_interval_count();
+    latency_trace_interval_t* stats = (latency_trace_interval_t*)malloc(count * sizeof(latency_trace_interval_t));
+    latency_trace_counters_t counters;
+    if (!stats || !latency_trace_get_stats(stats, &counters)) {
+        free(stats);
+        return;
+    }
+    int64_t offset_us = 0, rtt_us = 0;
+    bool synced = websocket_get_clock_offset(&offset_us, &rtt_us);
+    ESP_LOGI(TAG_APP_MAIN, "Latency trace: %lu faces, S3 clock %s%lld us (rtt %lld us)", (unsigned long)counters.traces,
+             synced ? "+" : "not synced ", (long long)offset_us, (long long)rtt_us);
+    for (int i = 0; i < count; i++) {
+        if (stats[i].count > 0) {
+            ESP_LOGI(TAG_APP_MAIN, "  %-14s n=%-4lu p50 %6.1f ms  p95 %6.1f ms  p99 %6.1f ms  max %6.1f ms",
+                     stats[i].name, (unsigned long)stats[i].count, stats[i].p50_us / 1000.0f,
+                     stats[i].p95_us / 1000.0f, stats[i].p99_us / 1000.0f, stats[i].max_us / 1000.0f);
+        }
     }
+    free(stats);
 }
 #endif
 
@@ -51,11 +107,17 @@ static void face_sending_task(void* pvParameters) {
             }
 
             camera_fb_t* full_frame = face_data->fb;
+            // Stage times of this face, stamped into the trace when it is done (0: not reached)
+            int64_t trace_us[TRACE_STAGE_COUNT] = {};
+            trace_us[TRACE_CAPTURE] = (int64_t)full_frame->timestamp.tv_sec * 1000000 + full_frame->timestamp.tv_usec;
+            trace_us[TRACE_DETECT_1] = face_data->detect_us[0];
+            trace_us[TRACE_DETECT_2] = face_data->detect_us[1];
+            trace_us[TRACE_DEQUEUE] = esp_timer_get_time();
 
-            ESP_LOGI(TAG_APP_MAIN, "Face detected in frame %d. Stopping camera.", (int)face_data->id);
+            BINLOGI(TAG_APP_MAIN, "Face detected in frame %d. Stopping camera.", (int)face_data->id);
             camera_stop();
 
-            ESP_LOGI(TAG_APP_MAIN, "Flushing processing queues.");
+            BINLOGI(TAG_APP_MAIN, "Flushing processing queues.");
             xQueueReset(xQueueAIFrame);
             xQueueReset(xQueueFaceFrame);
             
@@ -94,18 +156,33 @@ static void face_sending_task(void* pvParameters) {
                         w * 2
                     );
                 }
+                trace_us[TRACE_CROP] = esp_timer_get_time();
                 
-                ESP_LOGI(TAG_APP_MAIN, "Waiting for WIFI...");
+                BINLOGI(TAG_APP_MAIN, "Waiting for WIFI...");
                 xEventGroupWaitBits(s_app_event_group, WIFI_CONNECTED_BIT | WEBSOCKET_CONNECTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
                 
                 xEventGroupClearBits(s_app_event_group, FRAME_ACK_BIT);
                 
                 // NEW: Updated log message to include all requested info
-                ESP_LOGI(TAG_APP_MAIN, "Starting transfer for frame  %d, size: %zu Bytes, Box: [x=%d, y=%d, w=%d, h=%d]",
+                BINLOGI(TAG_APP_MAIN, "Starting transfer for frame  %d, size: %zu Bytes, Box: [x=%d, y=%d, w=%d, h=%d]",
                          (int)frame_id, cropped_len, x, y, w, h);
                 
-                char start_msg[128];
-                snprintf(start_msg, sizeof(start_msg), "{\"type\":\"frame_start\", \"size\":%zu, \"id\":%d}", cropped_len, (int)frame_id);
+                char start_msg[256];
+                int start_len = snprintf(start_msg, sizeof(start_msg), "{\"type\":\"frame_start\", \"size\":%zu, \"id\":%d, \"w\":%d, \"h\":%d", cropped_len, (int)frame_id, w, h);
+                trace_us[TRACE_TX_START] = esp_timer_get_time();
+#if LATENCY_TRACE_ON
+                // Our stages up to now, in the S3 clock, once the offset is known
+                int64_t offset_us;
+                if (websocket_get_clock_offset(&offset_us, NULL)) {
+                    start_len += snprintf(start_msg + start_len, sizeof(start_msg) - start_len, ", \"trace\":[");
+                    for (int stage = TRACE_CAPTURE; stage <= TRACE_TX_START; stage++) {
+                        start_len += snprintf(start_msg + start_len, sizeof(start_msg) - start_len, "%s%lld", stage ? "," : "",
+                                              (long long)(trace_us[stage] ? trace_us[stage] + offset_us : 0));
+                    }
+                    start_len += snprintf(start_msg + start_len, sizeof(start_msg) - start_len, "]");
+                }
+#endif
+                snprintf(start_msg + start_len, sizeof(start_msg) - start_len, "}");
                 if(websocket_send_text(start_msg) != ESP_OK) { break; }
                 vTaskDelay(pdMS_TO_TICKS(10));
 
@@ -125,29 +202,42 @@ static void face_sending_task(void* pvParameters) {
 
                 if (remaining > 0) { break; }
 
-                ESP_LOGI(TAG_APP_MAIN, "Finished sending chunks for frame %d", (int)frame_id);
+                BINLOGI(TAG_APP_MAIN, "Finished sending chunks for frame %d", (int)frame_id);
                 if(websocket_send_text("{\"type\":\"frame_end\"}") != ESP_OK) { break; }
+                trace_us[TRACE_TX_END] = esp_timer_get_time();
 
                 EventBits_t bits = xEventGroupWaitBits(s_app_event_group, FRAME_ACK_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(SERVER_ACK_TIMEOUT_MS*1000));
                 if (bits & FRAME_ACK_BIT) {
-                    ESP_LOGI(TAG_APP_MAIN, "Got ACK for frame %d!", (int)frame_id);
+                    trace_us[TRACE_ACK] = esp_timer_get_time();
+                    BINLOGI(TAG_APP_MAIN, "Got ACK for frame %d!", (int)frame_id);
                 } else {
                     ESP_LOGE(TAG_APP_MAIN, "No ACK for frame %d within %d ms.", (int)frame_id, SERVER_ACK_TIMEOUT_MS*1000);
                 }
 
             } while(0);
 
+#if LATENCY_TRACE_ON
+            for (int stage = 0; stage < TRACE_DONE; stage++) {
+                latency_trace_stamp(face_data->id, 0, (trace_stage_t)stage, trace_us[stage]);
+            }
+            latency_trace_stamp(face_data->id, 0, TRACE_DONE, esp_timer_get_time());
+            latency_trace_collect();
+            static uint32_t traced = 0;
+            if (++traced % LATENCY_TRACE_LOG_EVERY == 0) {
+                log_trace_stats();
+            }
+#endif
             esp_camera_fb_return(full_frame);
-            ESP_LOGI(TAG_APP_MAIN, "Frame buffer released.");
+            BINLOGI(TAG_APP_MAIN, "Frame buffer released.");
             if (cropped_buf) {
                 free(cropped_buf);
-                ESP_LOGI(TAG_APP_MAIN, "Cropped frame buffer released.");
+                BINLOGI(TAG_APP_MAIN, "Cropped frame buffer released.");
             }
             free(face_data);
             
-            ESP_LOGI(TAG_APP_MAIN, "Halt camera for %d sec.", POST_DETECTION_COOLDOWN_S);
+            BINLOGI(TAG_APP_MAIN, "Halt camera for %d sec.", POST_DETECTION_COOLDOWN_S);
             vTaskDelay(pdMS_TO_TICKS(POST_DETECTION_COOLDOWN_S * 1000));
-            ESP_LOGI(TAG_APP_MAIN, "Restarting camera.");
+            BINLOGI(TAG_APP_MAIN, "Restarting camera.");
             camera_start();
         }
     }
@@ -182,6 +272,25 @@ extern "C" void app_main() {
     
     wifi_init_sta();
 
+#if LATENCY_TRACE_ON
+    if (!latency_trace_init(LATENCY_TRACE_RING_SIZE)) {
+        ESP_LOGE(TAG_APP_MAIN, "Latency trace failed, faces are not traced.");
+    }
+#endif
+
+#if KERNEL_BENCH_ON
+    kernel_bench_config_t bench_config = { 3, 20, KERNEL_BENCH_CSV, NULL };
+    ESP_LOGI(TAG_APP_MAIN, "Kernel benchmark: %d cases", kernel_bench_run(&bench_config));
+#endif
+
+#if BINLOG_ON
+    binlog_config_t binlog_config = { BINLOG_RECORDS, BINLOG_RATE_BURST, BINLOG_RATE_WINDOW_MS };
+    if (!binlog_init(&binlog_config) || !binlog_start_console_task(BINLOG_PRINT_PERIOD_MS, 1)) {
+        binlog_deinit();
+        ESP_LOGE(TAG_APP_MAIN, "Binary log failed, messages go through esp_log.");
+    }
+#endif
+
     xQueueAIFrame = xQueueCreate(FRAME_QUEUE_SIZE, sizeof(camera_fb_t*));
     xQueueFaceFrame = xQueueCreate(FRAME_QUEUE_SIZE, sizeof(face_to_send_t *)); 
     
@@ -192,6 +301,12 @@ extern "C" void app_main() {
 #if HEARTBEAT_ON
     ESP_LOGI(TAG_APP_MAIN, "Ping ON, every %d sec.", HEARTBEAT_INTERVAL_S);
     xTaskCreate(heartbeat_task, "heartbeat_task", 3072, NULL, 5, NULL);
+#endif
+#if HEALTH_TELEMETRY_ON
+    esp_err_t health_ret = health_telemetry_start("cam", HEALTH_TELEMETRY_PERIOD_S * 1000, send_health, NULL);
+    if (health_ret != ESP_OK) {
+        ESP_LOGE(TAG_APP_MAIN, "Health telemetry failed: %s", esp_err_to_name(health_ret));
+    }
 #endif
     ESP_LOGI(TAG_APP_MAIN, "App started all workers.");
 }
\ No newline at end of file
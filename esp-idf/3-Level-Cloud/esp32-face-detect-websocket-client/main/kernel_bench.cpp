@@ -0,0 +1,128 @@
+/**
+ * @file kernel_bench.cpp
+ * @brief Camera suite of the kernel microbenchmarks: the image code between the sensor and the sender.
+ *
+ * On a QVGA RGB565 frame in camera byte order:
+ *   moving    get_moving_point_number of the motion detection, stride 8 and 1, scalar and SWAR kernels
+ *   resize    crop_and_resize of a frame to the 160x120 input of the detector, scalar and SWAR kernels
+ *   draw      draw_detection_result of one face, box and 5 keypoints
+ *   jpeg      fmt2jpg (quality 80) and jpg2rgb565 of esp32-camera
+ * Target only: the draw helpers and the JPEG codecs need libdl.a and esp32-camera. The runner and the
+ * output format are the ones of the S3 suite (esp32-s3-websocket_server/main/kernel_bench.hpp).
+ */
+
+#include <cstdlib>
+#include <list>
+
+#include "kernel_bench.hpp"
+#include "dl_image_simd.hpp"
+#include "img_converters.h"
+#include "who_ai_utils.hpp"
+
+namespace {
+
+const int WIDTH = 320;
+const int HEIGHT = 240;
+
+// Frees a malloc'ed buffer at the end of the scope
+struct Buffer {
+    void *data;
+    explicit Buffer(size_t size) : data(malloc(size)) {}
+    ~Buffer() { free(data); }
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+};
+
+// Gradients with noise, shifted by `offset` pixels for a second frame of a moving scene
+void fill_frame(uint16_t *rgb565, int offset)
+{
+    uint32_t seed = 1;
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t noise = seed >> 16;
+            int sx = x + offset;
+            uint8_t r = (uint8_t)(sx * 255 / WIDTH + noise % 32);
+            uint8_t g = (uint8_t)(y * 255 / HEIGHT + (noise >> 5) % 32);
+            uint8_t b = (uint8_t)((sx + y) * 2 + (noise >> 10) % 64);
+            uint16_t le = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+            rgb565[y * WIDTH + x] = (uint16_t)((le << 8) | (le >> 8)); // camera byte order
+        }
+    }
+}
+
+const char *kernel_name(dl::image::simd::kernel_t kernel)
+{
+    return kernel == dl::image::simd::KERNEL_SWAR ? "swar" : "scalar";
+}
+
+} // namespace
+
+int kernel_bench_run(const kernel_bench_config_t *config)
+{
+    KernelBench bench("cam", *config);
+    const size_t pixels = (size_t)WIDTH * HEIGHT;
+    Buffer frame_buf(pixels * 2), previous_buf(pixels * 2), out_buf(pixels * 3);
+    if (!frame_buf.data || !previous_buf.data || !out_buf.data) {
+        printf("# %dx%d frame skipped, no memory\n", WIDTH, HEIGHT);
+        return 0;
+    }
+    uint16_t *frame = (uint16_t *)frame_buf.data;
+    uint16_t *previous = (uint16_t *)previous_buf.data;
+    fill_frame(frame, 0);
+    fill_frame(previous, 4);
+
+    const dl::image::simd::kernel_t in_use = dl::image::simd::get_kernel();
+    const dl::image::simd::kernel_t kernels[] = { dl::image::simd::KERNEL_SCALAR, dl::image::simd::KERNEL_SWAR };
+    for (dl::image::simd::kernel_t kernel : kernels) {
+        dl::image::simd::set_kernel(kernel);
+        for (uint32_t stride : { 8u, 1u }) {
+            char variant[24];
+            snprintf(variant, sizeof(variant), "stride%u_%s", (unsigned)stride, kernel_name(kernel));
+            bench.run("moving", variant, WIDTH, HEIGHT, "rgb565be", [&] {
+                dl::image::simd::get_moving_point_number(frame, previous, HEIGHT, WIDTH, stride, 10);
+            });
+        }
+        for (dl::image::resize_type_t resize_type :
+             { dl::image::IMAGE_RESIZE_NEAREST, dl::image::IMAGE_RESIZE_BILINEAR }) {
+            char variant[40];
+            snprintf(variant, sizeof(variant), "msr_160x120_%s_%s",
+                     resize_type == dl::image::IMAGE_RESIZE_BILINEAR ? "bilinear" : "nearest", kernel_name(kernel));
+            bench.run("resize", variant, WIDTH, HEIGHT, "rgb565be", [&] {
+                dl::image::simd::crop_and_resize((uint8_t *)out_buf.data, 160, 3, 0, 120, 0, 160, frame, HEIGHT,
+                                                 WIDTH, 3, 0, HEIGHT, 0, WIDTH, resize_type);
+            });
+        }
+    }
+    dl::image::simd::set_kernel(in_use);
+
+    // One face of a third of the frame height, keypoints as the detector returns them
+    const int crop = HEIGHT / 3;
+    const int x1 = WIDTH / 2 - crop / 2, y1 = HEIGHT / 2 - crop / 2, x2 = x1 + crop, y2 = y1 + crop;
+    dl::detect::result_t face = { 0, 0.9f, { x1, y1, x2, y2 },
+                                  { x1 + crop / 3, y1 + crop / 3, x2 - crop / 3, y1 + crop / 3, (x1 + x2) / 2,
+                                    (y1 + y2) / 2, x1 + crop / 3, y2 - crop / 4, x2 - crop / 3, y2 - crop / 4 } };
+    std::list<dl::detect::result_t> results = { face };
+    bench.run("draw", "box_keypoints", WIDTH, HEIGHT, "rgb565be",
+              [&] { draw_detection_result(frame, HEIGHT, WIDTH, results); });
+    bench.run("draw", "box_keypoints", WIDTH, HEIGHT, "rgb888",
+              [&] { draw_detection_result((uint8_t *)out_buf.data, HEIGHT, WIDTH, results); });
+
+    if (bench.selected("jpeg")) {
+        bench.run("jpeg", "encode_q80", WIDTH, HEIGHT, "rgb565be", [&] {
+            uint8_t *jpeg = NULL;
+            size_t jpeg_len = 0;
+            if (fmt2jpg((uint8_t *)frame, pixels * 2, WIDTH, HEIGHT, PIXFORMAT_RGB565, 80, &jpeg, &jpeg_len)) {
+                free(jpeg);
+            }
+        });
+        uint8_t *jpeg = NULL;
+        size_t jpeg_len = 0;
+        if (fmt2jpg((uint8_t *)frame, pixels * 2, WIDTH, HEIGHT, PIXFORMAT_RGB565, 80, &jpeg, &jpeg_len)) {
+            bench.run("jpeg", "decode_rgb565", WIDTH, HEIGHT, "jpeg_q80",
+                      [&] { jpg2rgb565(jpeg, jpeg_len, (uint8_t *)out_buf.data, JPG_SCALE_NONE); });
+            free(jpeg);
+        }
+    }
+    return bench.cases();
+}
@@ -3,11 +3,14 @@
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "freertos/semphr.h"
+#include <stdio.h>
 #include <string.h>
 
 #include "esp_websocket_client.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "secret.h"
+#include "binlog.h"
 
 static const char* TAG = "WEBSOCK_CL";
 static EventGroupHandle_t s_app_event_group = NULL;
@@ -19,12 +22,49 @@ static SemaphoreHandle_t client_mutex = NULL;
 static esp_websocket_client_handle_t client = NULL;
 static bool websocket_connected_flag = false;
 
+// Offset of the server clock from ours, one sample per heartbeat. The sample with the
+// smallest round trip of the last CLOCK_SAMPLES is used: its error is at most rtt / 2.
+#define CLOCK_SAMPLES 8
+typedef struct {
+    int64_t offset_us;
+    int64_t rtt_us;
+} clock_sample_t;
+static clock_sample_t clock_samples[CLOCK_SAMPLES];
+static int clock_sample_count = 0;
+static int clock_sample_next = 0;
+static portMUX_TYPE clock_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// {"type":"heartbeat_ack","t1":..,"t2":..,"t3":..}: our send time, server receive and send times
+static void clock_sample_add(const char* msg, int64_t t4) {
+    const char* p1 = strstr(msg, "\"t1\":");
+    const char* p2 = strstr(msg, "\"t2\":");
+    const char* p3 = strstr(msg, "\"t3\":");
+    long long t1, t2, t3;
+    if (!p1 || !p2 || !p3 || sscanf(p1 + 5, "%lld", &t1) != 1 || sscanf(p2 + 5, "%lld", &t2) != 1 ||
+        sscanf(p3 + 5, "%lld", &t3) != 1) {
+        return;
+    }
+    clock_sample_t sample;
+    sample.offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+    sample.rtt_us = (t4 - t1) - (t3 - t2);
+    portENTER_CRITICAL(&clock_lock);
+    clock_samples[clock_sample_next] = sample;
+    clock_sample_next = (clock_sample_next + 1) % CLOCK_SAMPLES;
+    if (clock_sample_count < CLOCK_SAMPLES) clock_sample_count++;
+    portEXIT_CRITICAL(&clock_lock);
+    ESP_LOGD(TAG, "Clock sample: offset %lld us, rtt %lld us", (long long)sample.offset_us, (long long)sample.rtt_us);
+}
+
 static void websocket_event_handler(void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data) {
     esp_websocket_event_data_t* data = (esp_websocket_event_data_t*)event_data;
     switch (event_id) {
         case WEBSOCKET_EVENT_CONNECTED:
             ESP_LOGI(TAG, "WEBSOCKET_EVENT_CONNECTED");
             websocket_connected_flag = true;
+            // The server may have rebooted, its clock with it
+            portENTER_CRITICAL(&clock_lock);
+            clock_sample_count = 0;
+            portEXIT_CRITICAL(&clock_lock);
             if (s_app_event_group) xEventGroupSetBits(s_app_event_group, WEBSOCKET_CONNECTED_BIT);
             break;
         case WEBSOCKET_EVENT_DISCONNECTED:
@@ -41,10 +81,17 @@ static void websocket_event_handler(void* handler_args, esp_event_base_t base, i
                 ESP_LOGW(TAG, "Got closed message, code=%d", (data->data_ptr[0] << 8) | data->data_ptr[1]);
             } else if (data->op_code == 1 && data->data_ptr) { // Text frame
                 if (strstr((const char*)data->data_ptr, "frame_ack") != NULL) {
-                    ESP_LOGI(TAG, "Got frame ACK.");
+                    BINLOGI(TAG, "Got frame ACK.");
                     if (s_app_event_group) xEventGroupSetBits(s_app_event_group, FRAME_ACK_BIT);
+                } else if (strstr((const char*)data->data_ptr, "heartbeat_ack") != NULL) {
+                    int64_t t4 = esp_timer_get_time();
+                    char msg[128];
+                    int len = data->data_len < (int)sizeof(msg) - 1 ? data->data_len : (int)sizeof(msg) - 1;
+                    memcpy(msg, data->data_ptr, len);
+                    msg[len] = '\0';
+                    clock_sample_add(msg, t4);
                 } else {
-                    ESP_LOGI(TAG, "Got '%.*s'", data->data_len, (char*)data->data_ptr);
+                    BINLOGI(TAG, "Got '%.*s'", data->data_len, (char*)data->data_ptr);
                 }
             }
             break;
@@ -139,7 +186,7 @@ esp_err_t websocket_send_text(const char* text) {
 
     if (client && websocket_connected_flag) {
         if (text != NULL) {
-            ESP_LOGI(TAG, "Sending: %s", text);
+            BINLOGI(TAG, "Sending: %s", text);
             int bytes_sent = esp_websocket_client_send_text(client, text, strlen(text), pdMS_TO_TICKS(5000));
             if (bytes_sent < 0) {
                 ESP_LOGE(TAG, "Messageend error");
@@ -157,6 +204,25 @@ esp_err_t websocket_send_text(const char* text) {
 }
 
 esp_err_t websocket_send_heartbeat(void) {
-    const char* heartbeat_msg = "{\"type\":\"heartbeat\"}";
+    char heartbeat_msg[64];
+    snprintf(heartbeat_msg, sizeof(heartbeat_msg), "{\"type\":\"heartbeat\", \"t\":%lld}", (long long)esp_timer_get_time());
     return websocket_send_text(heartbeat_msg);
+}
+
+bool websocket_get_clock_offset(int64_t* offset_us, int64_t* rtt_us) {
+    bool found = false;
+    clock_sample_t best = {};
+    portENTER_CRITICAL(&clock_lock);
+    for (int i = 0; i < clock_sample_count; i++) {
+        if (!found || clock_samples[i].rtt_us < best.rtt_us) {
+            best = clock_samples[i];
+            found = true;
+        }
+    }
+    portEXIT_CRITICAL(&clock_lock);
+    if (found) {
+        if (offset_us) *offset_us = best.offset_us;
+        if (rtt_us) *rtt_us = best.rtt_us;
+    }
+    return found;
 }
\ No newline at end of file
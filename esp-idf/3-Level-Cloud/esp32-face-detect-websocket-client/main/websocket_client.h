@@ -15,6 +15,8 @@ void websocket_client_stop(void);
 esp_err_t websocket_send_heartbeat(void);
 esp_err_t websocket_send_frame(const uint8_t *data, size_t len);
 esp_err_t websocket_send_text(const char* text); 
+// Server clock minus ours (us), from the heartbeat round trips; false before the first heartbeat_ack
+bool websocket_get_clock_offset(int64_t *offset_us, int64_t *rtt_us);
 
 #ifdef __cplusplus
 }
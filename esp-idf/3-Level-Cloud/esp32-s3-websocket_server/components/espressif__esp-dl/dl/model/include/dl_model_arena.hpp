@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace dl {
+class ModelContext;
+
+/**
+ * @brief Activation (intermediate tensor) memory shared by several models.
+ *
+ * Each model normally owns the internal/PSRAM chunks planned by its memory manager, even when the models never
+ * run at the same time (e.g. a detector followed by a feature model). Models built while an arena is bound plan
+ * their tensors against the arena instead, and commit() allocates a single region sized to the largest plan.
+ *
+ * @note Models sharing an arena must never run at the same time, and the outputs of one model are overwritten
+ * by the next model that runs. The arena must outlive the models attached to it. commit() moves the tensors, so
+ * code that keeps a tensor's data address from before it (ImagePreprocessor's output) must read it again.
+ *
+ * Usage:
+ * @code
+ * dl::ModelArena arena;
+ * arena.bind();
+ * detect = new HumanFaceDetect();
+ * feat = new HumanFaceFeat();
+ * arena.unbind();
+ * arena.commit();
+ * @endcode
+ */
+class ModelArena {
+public:
+    /**
+     * @brief Construct a new Model Arena object
+     *
+     * @param alignment Memory address alignment
+     */
+    ModelArena(int alignment = 16);
+
+    /**
+     * @brief Destroy the Model Arena object. Return resource.
+     */
+    ~ModelArena();
+
+    /**
+     * @brief Models built from now on (on any task) plan against this arena.
+     */
+    void bind();
+
+    /**
+     * @brief Stop attaching newly built models.
+     */
+    void unbind();
+
+    /**
+     * @brief Allocate the arena (max of the attached plans) and move the tensors of the attached models into it.
+     *
+     * Models must not run before commit(). A model built after commit() uses the arena directly if its plan fits,
+     * otherwise it gets its own memory.
+     *
+     * @return true if the allocation is successful, false otherwise.
+     */
+    bool commit();
+
+    /**
+     * @brief Get the arena that is currently bound.
+     *
+     * @return ModelArena* nullptr if no arena is bound.
+     */
+    static ModelArena *get_bound() { return s_bound; }
+
+    /**
+     * @brief Called by ModelContext::root_alloc() of a model built while the arena is bound.
+     *
+     * @param context       Model context
+     * @param internal_size In bytes. Internal RAM the model planned.
+     * @param psram_size    In bytes. PSRAM the model planned.
+     * @return true if the context now uses the arena, false if it must allocate its own memory.
+     */
+    bool attach(ModelContext *context, size_t internal_size, size_t psram_size);
+
+    /**
+     * @brief Called when an attached model releases its memory.
+     *
+     * @param context Model context
+     */
+    void detach(ModelContext *context);
+
+    /**
+     * @brief Get the internal RAM size of the arena, the largest internal plan.
+     *
+     * @return size_t In bytes.
+     */
+    size_t get_internal_size() { return m_internal_size; }
+
+    /**
+     * @brief Get the PSRAM size of the arena, the largest PSRAM plan.
+     *
+     * @return size_t In bytes.
+     */
+    size_t get_psram_size() { return m_psram_size; }
+
+    /**
+     * @brief Get the memory the attached models would use with their own chunks (sum of the plans).
+     *
+     * @param internal_size In bytes. Sum of the internal plans.
+     * @param psram_size    In bytes. Sum of the PSRAM plans.
+     */
+    void get_private_size(size_t &internal_size, size_t &psram_size);
+
+    /**
+     * @brief Get the number of attached models.
+     *
+     * @return int
+     */
+    int get_model_count() { return m_contexts.size(); }
+
+private:
+    int m_alignment;
+    bool m_committed;
+    void *m_internal_root;
+    void *m_psram_root;
+    size_t m_internal_size;
+    size_t m_psram_size;
+    std::vector<ModelContext *> m_contexts;
+    std::vector<size_t> m_internal_plans;
+    std::vector<size_t> m_psram_plans;
+    static ModelArena *s_bound;
+};
+
+} // namespace dl
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "dl_model_arena.hpp"
 #include "dl_tensor_base.hpp"
 #include "esp_log.h"
 #include <map>
@@ -20,6 +21,7 @@ private:
     void *m_internal_root;                   /*!< Internal root pointer */
     int m_psram_size;                        /*!< In bytes. PSRAM size usage. Only take effect when there's a PSRAM */
     int m_internal_size;                     /*!< In bytes. Internal size usage. */
+    ModelArena *m_arena;                     /*!< Shared activation arena, nullptr when the roots are owned */
     std::map<std::string, int> m_name2index; /*!< Tensor name to index map
                                                >=0: variable tensor
                                                <0: parameter tensor */
@@ -50,6 +52,7 @@ public:
         m_internal_root = nullptr;
         m_psram_size = 0;
         m_internal_size = 0;
+        m_arena = nullptr;
     }
 
     /**
@@ -143,6 +146,26 @@ public:
      */
     bool root_alloc(size_t internal_size, size_t psram_size, int alignment = 16);
 
+    /**
+     * @brief Uses memory of a shared arena as PSRAM and internal roots. Called by ModelArena.
+     *
+     * @param arena The arena owning the memory.
+     * @param internal_root Internal root pointer.
+     * @param psram_root PSRAM root pointer.
+     */
+    void set_arena_roots(ModelArena *arena, void *internal_root, void *psram_root);
+
+    /**
+     * @brief Moves the variable tensors from the current roots to new ones. Called by ModelArena.
+     *
+     * Tensors planned against an arena that is not committed yet point into placeholder roots, they are moved
+     * into the arena memory once it is allocated.
+     *
+     * @param internal_root Internal root pointer.
+     * @param psram_root PSRAM root pointer.
+     */
+    void rebase_variables(void *internal_root, void *psram_root);
+
     /**
      * @brief Gets the pointer to the PSRAM root.
      *
@@ -180,6 +203,14 @@ public:
      */
     void root_free()
     {
+        if (m_arena) {
+            // The memory belongs to the shared arena
+            m_arena->detach(this);
+            m_arena = nullptr;
+            m_internal_root = nullptr;
+            m_psram_root = nullptr;
+            return;
+        }
         // In IDF, free(p) is equivalent to heap_caps_free(p).
         if (m_internal_root) {
             free(m_internal_root);
@@ -207,7 +238,7 @@ public:
      */
     void clear()
     {
-        if (m_internal_root || m_psram_root) {
+        if (m_internal_root || m_psram_root || m_arena) {
             for (int i = 0; i < m_variables.size(); i++) {
                 delete m_variables[i];
             }
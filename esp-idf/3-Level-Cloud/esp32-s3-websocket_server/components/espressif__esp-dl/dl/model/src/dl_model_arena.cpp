@@ -0,0 +1,150 @@
+#include <stdint.h>
+
+#include "dl_model_arena.hpp"
+#include "dl_model_context.hpp"
+#include "dl_tool.hpp"
+#include <algorithm>
+
+static const char *TAG = "dl::ModelArena";
+
+namespace dl {
+
+ModelArena *ModelArena::s_bound = nullptr;
+
+ModelArena::ModelArena(int alignment) :
+    m_alignment(alignment),
+    m_committed(false),
+    m_internal_root(nullptr),
+    m_psram_root(nullptr),
+    m_internal_size(0),
+    m_psram_size(0)
+{
+}
+
+ModelArena::~ModelArena()
+{
+    if (s_bound == this) {
+        s_bound = nullptr;
+    }
+    if (!m_contexts.empty()) {
+        ESP_LOGW(TAG, "%d models are still attached to the arena", (int)m_contexts.size());
+    }
+    // In IDF, free(p) is equivalent to heap_caps_free(p).
+    if (m_internal_root) {
+        free(m_internal_root);
+    }
+    if (m_psram_root) {
+        free(m_psram_root);
+    }
+}
+
+void ModelArena::bind()
+{
+    if (s_bound && s_bound != this) {
+        ESP_LOGW(TAG, "Another arena was bound, replacing it");
+    }
+    s_bound = this;
+}
+
+void ModelArena::unbind()
+{
+    if (s_bound == this) {
+        s_bound = nullptr;
+    }
+}
+
+bool ModelArena::attach(ModelContext *context, size_t internal_size, size_t psram_size)
+{
+    if (m_committed) {
+        if (internal_size > m_internal_size || psram_size > m_psram_size) {
+            ESP_LOGW(TAG,
+                     "Model needs %.2fKB internal RAM, %.2fKB PSRAM, more than the committed arena. Not shared.",
+                     internal_size / 1024.f,
+                     psram_size / 1024.f);
+            return false;
+        }
+        context->set_arena_roots(this, m_internal_root, m_psram_root);
+    } else {
+        // Placeholder roots (never dereferenced), the tensors are moved into the arena by commit().
+        // They must not be nullptr, TensorBase allocates its own memory for a nullptr element.
+        uintptr_t internal_root = m_alignment;
+        uintptr_t psram_root = internal_root + (internal_size + m_alignment - 1) / m_alignment * m_alignment;
+        context->set_arena_roots(this, (void *)internal_root, (void *)psram_root);
+        m_internal_size = std::max(m_internal_size, internal_size);
+        m_psram_size = std::max(m_psram_size, psram_size);
+    }
+    m_contexts.push_back(context);
+    m_internal_plans.push_back(internal_size);
+    m_psram_plans.push_back(psram_size);
+    return true;
+}
+
+void ModelArena::detach(ModelContext *context)
+{
+    for (int i = 0; i < m_contexts.size(); i++) {
+        if (m_contexts[i] == context) {
+            m_contexts.erase(m_contexts.begin() + i);
+            m_internal_plans.erase(m_internal_plans.begin() + i);
+            m_psram_plans.erase(m_psram_plans.begin() + i);
+            return;
+        }
+    }
+}
+
+bool ModelArena::commit()
+{
+    if (m_committed) {
+        return true;
+    }
+    if (m_psram_size > 0) {
+        m_psram_root = tool::calloc_aligned(m_alignment, m_psram_size, 1, MALLOC_CAP_SPIRAM);
+        if (!m_psram_root) {
+            ESP_LOGE(TAG,
+                     "Failed to alloc %.2fKB PSRAM, largest available PSRAM block size %.2fKB",
+                     m_psram_size / 1024.f,
+                     heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) / 1024.f);
+            return false;
+        }
+    }
+    if (m_internal_size > 0) {
+        m_internal_root = tool::calloc_aligned(m_alignment, m_internal_size, 1, MALLOC_CAP_INTERNAL);
+        if (!m_internal_root) {
+            ESP_LOGE(TAG,
+                     "Failed to alloc %.2fKB internal RAM, largest available internal RAM block size %.2fKB",
+                     m_internal_size / 1024.f,
+                     heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL) / 1024.f);
+            if (m_psram_root) {
+                free(m_psram_root);
+                m_psram_root = nullptr;
+            }
+            return false;
+        }
+    }
+    for (int i = 0; i < m_contexts.size(); i++) {
+        m_contexts[i]->rebase_variables(m_internal_root, m_psram_root);
+    }
+    m_committed = true;
+
+    size_t internal_sum, psram_sum;
+    get_private_size(internal_sum, psram_sum);
+    ESP_LOGI(TAG,
+             "%d models share %.2fKB internal RAM, %.2fKB PSRAM (%.2fKB, %.2fKB if not shared)",
+             (int)m_contexts.size(),
+             m_internal_size / 1024.f,
+             m_psram_size / 1024.f,
+             internal_sum / 1024.f,
+             psram_sum / 1024.f);
+    return true;
+}
+
+void ModelArena::get_private_size(size_t &internal_size, size_t &psram_size)
+{
+    internal_size = 0;
+    psram_size = 0;
+    for (int i = 0; i < m_contexts.size(); i++) {
+        internal_size += m_internal_plans[i];
+        psram_size += m_psram_plans[i];
+    }
+}
+
+} // namespace dl
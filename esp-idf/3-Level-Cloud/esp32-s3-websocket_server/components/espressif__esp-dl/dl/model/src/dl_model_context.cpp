@@ -151,6 +151,10 @@ bool ModelContext::root_alloc(size_t internal_size, size_t psram_size, int align
 {
     m_internal_size = internal_size;
     m_psram_size = psram_size;
+    ModelArena *arena = ModelArena::get_bound();
+    if (arena && arena->attach(this, internal_size, psram_size)) {
+        return true;
+    }
     if (m_psram_size > 0) {
         m_psram_root = tool::calloc_aligned(alignment, m_psram_size, 1, MALLOC_CAP_SPIRAM);
         if (!m_psram_root) {
@@ -176,4 +180,31 @@ bool ModelContext::root_alloc(size_t internal_size, size_t psram_size, int align
     return true;
 }
 
+void ModelContext::set_arena_roots(ModelArena *arena, void *internal_root, void *psram_root)
+{
+    m_arena = arena;
+    m_internal_root = internal_root;
+    m_psram_root = psram_root;
+}
+
+void ModelContext::rebase_variables(void *internal_root, void *psram_root)
+{
+    uintptr_t internal_begin = (uintptr_t)m_internal_root;
+    uintptr_t psram_begin = (uintptr_t)m_psram_root;
+    for (int i = 0; i < m_variables.size(); i++) {
+        TensorBase *tensor = m_variables[i];
+        if (!tensor || tensor->auto_free) {
+            continue;
+        }
+        uintptr_t addr = (uintptr_t)tensor->data;
+        if (addr >= internal_begin && addr < internal_begin + m_internal_size) {
+            tensor->set_element_ptr((uint8_t *)internal_root + (addr - internal_begin));
+        } else if (addr >= psram_begin && addr < psram_begin + m_psram_size) {
+            tensor->set_element_ptr((uint8_t *)psram_root + (addr - psram_begin));
+        }
+    }
+    m_internal_root = internal_root;
+    m_psram_root = psram_root;
+}
+
 } // namespace dl
@@ -0,0 +1,528 @@
+#include "dl_image_color.hpp"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the row kernels take two RGB565 pixels out of one little endian word"
+#endif
+
+namespace dl {
+namespace image {
+namespace {
+template <pix_type_t TYPE>
+struct pix_elem {
+    typedef uint8_t type;
+};
+template <>
+struct pix_elem<DL_IMAGE_PIX_TYPE_RGB565> {
+    typedef uint16_t type;
+};
+template <>
+struct pix_elem<DL_IMAGE_PIX_TYPE_RGB888_QINT8> {
+    typedef int8_t type;
+};
+template <>
+struct pix_elem<DL_IMAGE_PIX_TYPE_GRAY_QINT8> {
+    typedef int8_t type;
+};
+template <>
+struct pix_elem<DL_IMAGE_PIX_TYPE_RGB888_QINT16> {
+    typedef int16_t type;
+};
+template <>
+struct pix_elem<DL_IMAGE_PIX_TYPE_GRAY_QINT16> {
+    typedef int16_t type;
+};
+
+constexpr int pix_elems(pix_type_t type)
+{
+    return DL_IMAGE_IS_PIX_TYPE_RGB888(type) ? 3 : 1;
+}
+
+// The caps bits a pair depends on: pairs that ignore a bit share one instantiation
+constexpr uint32_t convert_caps_mask(pix_type_t src, pix_type_t dst)
+{
+    if (src == DL_IMAGE_PIX_TYPE_RGB565) {
+        return (dst == DL_IMAGE_PIX_TYPE_RGB565)
+            ? (DL_IMAGE_CAP_RGB_SWAP | DL_IMAGE_CAP_RGB565_BYTE_SWAP | DL_IMAGE_CAP_RGB565_BIG_ENDIAN)
+            : (DL_IMAGE_CAP_RGB_SWAP | DL_IMAGE_CAP_RGB565_BIG_ENDIAN);
+    }
+    if (src == DL_IMAGE_PIX_TYPE_RGB888) {
+        return (dst == DL_IMAGE_PIX_TYPE_RGB565) ? (DL_IMAGE_CAP_RGB_SWAP | DL_IMAGE_CAP_RGB565_BIG_ENDIAN)
+                                                 : DL_IMAGE_CAP_RGB_SWAP;
+    }
+    return 0;
+}
+
+// One pixel, the convert_pixel() branch of the pair
+template <pix_type_t SRC, pix_type_t DST, uint32_t CAPS>
+inline void convert_one(const typename pix_elem<SRC>::type *src, typename pix_elem<DST>::type *dst, void *norm_lut)
+{
+    typedef typename pix_elem<DST>::type T;
+    uint16_t *src16 = (uint16_t *)src;
+    uint8_t *src8 = (uint8_t *)src;
+    if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB565 && DST == DL_IMAGE_PIX_TYPE_RGB565) {
+        convert_pixel_from_rgb565_to_rgb565(src16, dst, CAPS);
+    } else if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB565 && DST == DL_IMAGE_PIX_TYPE_RGB888) {
+        convert_pixel_from_rgb565_to_rgb888(src16, dst, CAPS);
+    } else if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB565 && DST == DL_IMAGE_PIX_TYPE_GRAY) {
+        convert_pixel_from_rgb565_to_gray(src16, dst, CAPS);
+    } else if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB565 && DL_IMAGE_IS_PIX_TYPE_RGB888(DST)) {
+        convert_pixel_from_rgb565_to_rgb888_quant<T>(src16, dst, CAPS, (T *)norm_lut);
+    } else if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB565) {
+        convert_pixel_from_rgb565_to_gray_quant<T>(src16, dst, CAPS, (T *)norm_lut);
+    } else if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB888 && DST == DL_IMAGE_PIX_TYPE_RGB888) {
+        convert_pixel_from_rgb888_to_rgb888(src8, dst, CAPS);
+    } else if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB888 && DST == DL_IMAGE_PIX_TYPE_RGB565) {
+        convert_pixel_from_rgb888_to_rgb565(src8, dst, CAPS);
+    } else if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB888 && DST == DL_IMAGE_PIX_TYPE_GRAY) {
+        convert_pixel_from_rgb888_to_gray(src8, dst, CAPS);
+    } else if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB888 && DL_IMAGE_IS_PIX_TYPE_RGB888(DST)) {
+        convert_pixel_from_rgb888_to_rgb888_quant<T>(src8, dst, CAPS, (T *)norm_lut);
+    } else if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB888) {
+        convert_pixel_from_rgb888_to_gray_quant<T>(src8, dst, CAPS, (T *)norm_lut);
+    } else {
+        convert_pixel_from_gray_to_gray_quant<T>(src8, dst, (T *)norm_lut);
+    }
+}
+
+// Pairs with a word-wide kernel: RGB565 to RGB888/gray/quantized RGB888, RGB888 to gray/quantized RGB888
+template <pix_type_t SRC, pix_type_t DST>
+constexpr bool has_word_kernel()
+{
+    if (SRC == DL_IMAGE_PIX_TYPE_RGB565) {
+        return DL_IMAGE_IS_PIX_TYPE_RGB888(DST) || DST == DL_IMAGE_PIX_TYPE_GRAY;
+    }
+    if (SRC == DL_IMAGE_PIX_TYPE_RGB888) {
+        return DST == DL_IMAGE_PIX_TYPE_RGB888_QINT8 || DST == DL_IMAGE_PIX_TYPE_RGB888_QINT16 ||
+            DST == DL_IMAGE_PIX_TYPE_GRAY;
+    }
+    return false;
+}
+
+// One RGB565 pixel of a loaded word, same results as the convert_pixel_from_rgb565_* functions
+template <pix_type_t DST, uint32_t CAPS>
+inline void store_rgb565(uint16_t v, typename pix_elem<DST>::type *dst, void *norm_lut)
+{
+    typedef typename pix_elem<DST>::type T;
+    if (CAPS & DL_IMAGE_CAP_RGB565_BIG_ENDIAN) {
+        v = (uint16_t)((v << 8) | (v >> 8));
+    }
+    uint8_t r = (v >> 8) & 0xf8;
+    uint8_t g = (v >> 3) & 0xfc;
+    uint8_t b = (v << 3) & 0xf8;
+    if constexpr (DST == DL_IMAGE_PIX_TYPE_RGB888) {
+        dst[(CAPS & DL_IMAGE_CAP_RGB_SWAP) ? 2 : 0] = r;
+        dst[1] = g;
+        dst[(CAPS & DL_IMAGE_CAP_RGB_SWAP) ? 0 : 2] = b;
+    } else if constexpr (DST == DL_IMAGE_PIX_TYPE_GRAY) {
+        // rgb888 (swapped by the caps) to gray
+        if (CAPS & DL_IMAGE_CAP_RGB_SWAP) {
+            *dst = (uint8_t)((r * 38 + g * 75 + b * 15) >> 7);
+        } else {
+            *dst = (uint8_t)((b * 38 + g * 75 + r * 15) >> 7);
+        }
+    } else {
+        // The lut channel follows the color, the caps only move it
+        T *lut = (T *)norm_lut;
+        dst[(CAPS & DL_IMAGE_CAP_RGB_SWAP) ? 2 : 0] = lut[r];
+        dst[1] = lut[256 + g];
+        dst[(CAPS & DL_IMAGE_CAP_RGB_SWAP) ? 0 : 2] = lut[512 + b];
+    }
+}
+
+// One RGB888 pixel, same results as the convert_pixel_from_rgb888_* functions
+template <pix_type_t DST, uint32_t CAPS>
+inline void store_rgb888(uint8_t c0, uint8_t c1, uint8_t c2, typename pix_elem<DST>::type *dst, void *norm_lut)
+{
+    typedef typename pix_elem<DST>::type T;
+    if constexpr (DST == DL_IMAGE_PIX_TYPE_GRAY) {
+        if (CAPS & DL_IMAGE_CAP_RGB_SWAP) {
+            *dst = (uint8_t)((c0 * 38 + c1 * 75 + c2 * 15) >> 7);
+        } else {
+            *dst = (uint8_t)((c2 * 38 + c1 * 75 + c0 * 15) >> 7);
+        }
+    } else {
+        // One lut for all three channels, as convert_pixel_from_rgb888_to_rgb888_quant()
+        T *lut = (T *)norm_lut;
+        dst[(CAPS & DL_IMAGE_CAP_RGB_SWAP) ? 2 : 0] = lut[c0];
+        dst[1] = lut[c1];
+        dst[(CAPS & DL_IMAGE_CAP_RGB_SWAP) ? 0 : 2] = lut[c2];
+    }
+}
+
+template <pix_type_t SRC, pix_type_t DST, uint32_t CAPS>
+void convert_row(const void *src_ptr, void *dst_ptr, int n, void *norm_lut)
+{
+    typedef typename pix_elem<SRC>::type S;
+    typedef typename pix_elem<DST>::type T;
+    constexpr int src_step = pix_elems(SRC);
+    constexpr int dst_step = pix_elems(DST);
+    const S *src = (const S *)src_ptr;
+    T *dst = (T *)dst_ptr;
+    int i = 0;
+    if constexpr (has_word_kernel<SRC, DST>()) {
+        // Single pixels up to a word boundary, the word loads need it
+        while (i < n && ((uintptr_t)src & 3)) {
+            convert_one<SRC, DST, CAPS>(src, dst, norm_lut);
+            src += src_step;
+            dst += dst_step;
+            i++;
+        }
+        const uint32_t *words = (const uint32_t *)__builtin_assume_aligned(src, 4);
+        if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB565 && DST == DL_IMAGE_PIX_TYPE_RGB888) {
+            // 4 pixels from 2 words to 3 words, if the destination is aligned as well
+            if (!((uintptr_t)dst & 3)) {
+                uint32_t *out = (uint32_t *)__builtin_assume_aligned(dst, 4);
+                for (; i + 4 <= n; i += 4) {
+                    uint32_t w0 = words[0], w1 = words[1];
+                    words += 2;
+                    uint8_t c[12];
+                    store_rgb565<DST, CAPS>((uint16_t)w0, c, norm_lut);
+                    store_rgb565<DST, CAPS>((uint16_t)(w0 >> 16), c + 3, norm_lut);
+                    store_rgb565<DST, CAPS>((uint16_t)w1, c + 6, norm_lut);
+                    store_rgb565<DST, CAPS>((uint16_t)(w1 >> 16), c + 9, norm_lut);
+                    out[0] = c[0] | (c[1] << 8) | (c[2] << 16) | ((uint32_t)c[3] << 24);
+                    out[1] = c[4] | (c[5] << 8) | (c[6] << 16) | ((uint32_t)c[7] << 24);
+                    out[2] = c[8] | (c[9] << 8) | (c[10] << 16) | ((uint32_t)c[11] << 24);
+                    out += 3;
+                }
+                dst = (T *)out;
+            }
+        }
+        if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB565) {
+            for (; i + 2 <= n; i += 2) {
+                uint32_t w = *words++;
+                store_rgb565<DST, CAPS>((uint16_t)w, dst, norm_lut);
+                store_rgb565<DST, CAPS>((uint16_t)(w >> 16), dst + dst_step, norm_lut);
+                dst += 2 * dst_step;
+            }
+        } else {
+            // 4 pixels in 3 words
+            for (; i + 4 <= n; i += 4) {
+                uint32_t w0 = words[0], w1 = words[1], w2 = words[2];
+                words += 3;
+                store_rgb888<DST, CAPS>(w0, w0 >> 8, w0 >> 16, dst, norm_lut);
+                store_rgb888<DST, CAPS>(w0 >> 24, w1, w1 >> 8, dst + dst_step, norm_lut);
+                store_rgb888<DST, CAPS>(w1 >> 16, w1 >> 24, w2, dst + 2 * dst_step, norm_lut);
+                store_rgb888<DST, CAPS>(w2 >> 8, w2 >> 16, w2 >> 24, dst + 3 * dst_step, norm_lut);
+                dst += 4 * dst_step;
+            }
+        }
+        src = (const S *)words;
+    }
+    for (; i < n; i++) {
+        convert_one<SRC, DST, CAPS>(src, dst, norm_lut);
+        src += src_step;
+        dst += dst_step;
+    }
+}
+
+template <pix_type_t SRC, pix_type_t DST, uint32_t CAPS>
+void gather_row(const void *src_ptr, const int *index, void *dst_ptr, int n, void *norm_lut)
+{
+    typedef typename pix_elem<SRC>::type S;
+    typedef typename pix_elem<DST>::type T;
+    constexpr int src_step = pix_elems(SRC);
+    constexpr int dst_step = pix_elems(DST);
+    const S *src = (const S *)src_ptr;
+    T *dst = (T *)dst_ptr;
+    for (int i = 0; i < n; i++) {
+        const S *p = src + src_step * index[i];
+        if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB565 && has_word_kernel<SRC, DST>()) {
+            store_rgb565<DST, CAPS>(*p, dst, norm_lut);
+        } else if constexpr (SRC == DL_IMAGE_PIX_TYPE_GRAY && DST == DL_IMAGE_PIX_TYPE_GRAY) {
+            *dst = *p;
+        } else {
+            convert_one<SRC, DST, CAPS>(p, dst, norm_lut);
+        }
+        dst += dst_step;
+    }
+}
+
+// The kernel families, one instantiation per caps value the pair depends on
+struct convert_row_kernels {
+    typedef convert_row_fn_t fn_t;
+    template <pix_type_t SRC, pix_type_t DST>
+    static fn_t get(uint32_t caps)
+    {
+        if constexpr (SRC == DL_IMAGE_PIX_TYPE_GRAY && DST == DL_IMAGE_PIX_TYPE_GRAY) {
+            return nullptr;
+        } else {
+            constexpr uint32_t M = convert_caps_mask(SRC, DST);
+            static constexpr fn_t fns[8] = {convert_row<SRC, DST, 0 & M>,
+                                            convert_row<SRC, DST, 1 & M>,
+                                            convert_row<SRC, DST, 2 & M>,
+                                            convert_row<SRC, DST, 3 & M>,
+                                            convert_row<SRC, DST, 4 & M>,
+                                            convert_row<SRC, DST, 5 & M>,
+                                            convert_row<SRC, DST, 6 & M>,
+                                            convert_row<SRC, DST, 7 & M>};
+            return fns[caps & 7];
+        }
+    }
+};
+
+struct gather_row_kernels {
+    typedef gather_row_fn_t fn_t;
+    template <pix_type_t SRC, pix_type_t DST>
+    static fn_t get(uint32_t caps)
+    {
+        constexpr uint32_t M = convert_caps_mask(SRC, DST);
+        static constexpr fn_t fns[8] = {gather_row<SRC, DST, 0 & M>,
+                                        gather_row<SRC, DST, 1 & M>,
+                                        gather_row<SRC, DST, 2 & M>,
+                                        gather_row<SRC, DST, 3 & M>,
+                                        gather_row<SRC, DST, 4 & M>,
+                                        gather_row<SRC, DST, 5 & M>,
+                                        gather_row<SRC, DST, 6 & M>,
+                                        gather_row<SRC, DST, 7 & M>};
+        return fns[caps & 7];
+    }
+};
+
+template <typename KERNELS>
+typename KERNELS::fn_t select_kernel(pix_type_t src_type, pix_type_t dst_type, uint32_t caps)
+{
+    switch (src_type) {
+    case DL_IMAGE_PIX_TYPE_RGB565:
+        switch (dst_type) {
+        case DL_IMAGE_PIX_TYPE_RGB565:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_PIX_TYPE_RGB565>(caps);
+        case DL_IMAGE_PIX_TYPE_RGB888:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_PIX_TYPE_RGB888>(caps);
+        case DL_IMAGE_PIX_TYPE_RGB888_QINT8:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_PIX_TYPE_RGB888_QINT8>(caps);
+        case DL_IMAGE_PIX_TYPE_RGB888_QINT16:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_PIX_TYPE_RGB888_QINT16>(caps);
+        case DL_IMAGE_PIX_TYPE_GRAY:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_PIX_TYPE_GRAY>(caps);
+        case DL_IMAGE_PIX_TYPE_GRAY_QINT8:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_PIX_TYPE_GRAY_QINT8>(caps);
+        case DL_IMAGE_PIX_TYPE_GRAY_QINT16:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_PIX_TYPE_GRAY_QINT16>(caps);
+        }
+        break;
+    case DL_IMAGE_PIX_TYPE_RGB888:
+        switch (dst_type) {
+        case DL_IMAGE_PIX_TYPE_RGB888:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB888, DL_IMAGE_PIX_TYPE_RGB888>(caps);
+        case DL_IMAGE_PIX_TYPE_RGB565:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB888, DL_IMAGE_PIX_TYPE_RGB565>(caps);
+        case DL_IMAGE_PIX_TYPE_RGB888_QINT8:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB888, DL_IMAGE_PIX_TYPE_RGB888_QINT8>(caps);
+        case DL_IMAGE_PIX_TYPE_RGB888_QINT16:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB888, DL_IMAGE_PIX_TYPE_RGB888_QINT16>(caps);
+        case DL_IMAGE_PIX_TYPE_GRAY:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB888, DL_IMAGE_PIX_TYPE_GRAY>(caps);
+        case DL_IMAGE_PIX_TYPE_GRAY_QINT8:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB888, DL_IMAGE_PIX_TYPE_GRAY_QINT8>(caps);
+        case DL_IMAGE_PIX_TYPE_GRAY_QINT16:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_RGB888, DL_IMAGE_PIX_TYPE_GRAY_QINT16>(caps);
+        }
+        break;
+    case DL_IMAGE_PIX_TYPE_GRAY:
+        switch (dst_type) {
+        case DL_IMAGE_PIX_TYPE_GRAY:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_GRAY, DL_IMAGE_PIX_TYPE_GRAY>(caps);
+        case DL_IMAGE_PIX_TYPE_GRAY_QINT8:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_GRAY, DL_IMAGE_PIX_TYPE_GRAY_QINT8>(caps);
+        case DL_IMAGE_PIX_TYPE_GRAY_QINT16:
+            return KERNELS::template get<DL_IMAGE_PIX_TYPE_GRAY, DL_IMAGE_PIX_TYPE_GRAY_QINT16>(caps);
+        default:
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+    return nullptr;
+}
+} // namespace
+
+convert_row_fn_t get_convert_row_fn(pix_type_t src_type, pix_type_t dst_type, uint32_t caps)
+{
+    return select_kernel<convert_row_kernels>(src_type, dst_type, caps);
+}
+
+gather_row_fn_t get_gather_row_fn(pix_type_t src_type, pix_type_t dst_type, uint32_t caps)
+{
+    return select_kernel<gather_row_kernels>(src_type, dst_type, caps);
+}
+
+template <typename T1, typename T2>
+void convert_img_loop(
+    const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area)
+{
+    convert_row_fn_t convert_row = get_convert_row_fn(src_img.pix_type, dst_img.pix_type, caps);
+    assert(convert_row);
+    int step_src = DL_IMAGE_IS_PIX_TYPE_RGB888(src_img.pix_type) ? 3 : 1;
+    int step_dst = DL_IMAGE_IS_PIX_TYPE_RGB888(dst_img.pix_type) ? 3 : 1;
+
+    if (crop_area.empty()) {
+        convert_row(src_img.data, dst_img.data, dst_img.height * dst_img.width, norm_lut);
+    } else {
+        T1 *src_pix_ptr = (T1 *)src_img.data + crop_area[0] * step_src + crop_area[1] * step_src * src_img.width;
+        T2 *dst_pix_ptr = (T2 *)dst_img.data;
+        for (int i = 0; i < dst_img.height; i++) {
+            convert_row(src_pix_ptr, dst_pix_ptr, dst_img.width, norm_lut);
+            src_pix_ptr += step_src * src_img.width;
+            dst_pix_ptr += step_dst * dst_img.width;
+        }
+    }
+}
+template void convert_img_loop<uint16_t, uint16_t>(
+    const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area);
+template void convert_img_loop<uint16_t, uint8_t>(
+    const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area);
+template void convert_img_loop<uint16_t, int8_t>(
+    const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area);
+template void convert_img_loop<uint16_t, int16_t>(
+    const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area);
+template void convert_img_loop<uint8_t, uint8_t>(
+    const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area);
+template void convert_img_loop<uint8_t, uint16_t>(
+    const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area);
+template void convert_img_loop<uint8_t, int8_t>(
+    const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area);
+template void convert_img_loop<uint8_t, int16_t>(
+    const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area);
+
+void convert_img(const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area)
+{
+    // TODO if do nothing ,just copy.
+    assert(src_img.data);
+    assert(dst_img.data);
+    assert(src_img.height > 0 && src_img.width > 0);
+    if (crop_area.empty()) {
+        dst_img.height = src_img.height;
+        dst_img.width = src_img.width;
+    } else {
+        assert(crop_area.size() == 4);
+        assert(crop_area[2] > crop_area[0]);
+        assert(crop_area[3] > crop_area[1]);
+        assert(crop_area[0] < src_img.width && crop_area[0] >= 0);
+        assert(crop_area[1] < src_img.height && crop_area[1] >= 0);
+        assert(crop_area[2] <= src_img.width && crop_area[2] > 0);
+        assert(crop_area[3] <= src_img.height && crop_area[3] > 0);
+        dst_img.height = crop_area[3] - crop_area[1];
+        dst_img.width = crop_area[2] - crop_area[0];
+    }
+    if (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565) {
+        convert_img_loop<uint16_t, uint16_t>(src_img, dst_img, caps, norm_lut, crop_area);
+    } else if ((src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888) ||
+               (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY)) {
+        convert_img_loop<uint16_t, uint8_t>(src_img, dst_img, caps, norm_lut, crop_area);
+    } else if ((src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888_QINT8) ||
+               (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY_QINT8)) {
+        convert_img_loop<uint16_t, int8_t>(src_img, dst_img, caps, norm_lut, crop_area);
+    } else if ((src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888_QINT16) ||
+               (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY_QINT16)) {
+        convert_img_loop<uint16_t, int16_t>(src_img, dst_img, caps, norm_lut, crop_area);
+    } else if ((src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888) ||
+               (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY)) {
+        convert_img_loop<uint8_t, uint8_t>(src_img, dst_img, caps, norm_lut, crop_area);
+    } else if (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565) {
+        convert_img_loop<uint8_t, uint16_t>(src_img, dst_img, caps, norm_lut, crop_area);
+    } else if ((src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY_QINT8) ||
+               (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888_QINT8) ||
+               (src_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY && dst_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY_QINT8)) {
+        convert_img_loop<uint8_t, int8_t>(src_img, dst_img, caps, norm_lut, crop_area);
+    } else if ((src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY_QINT16) ||
+               (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888 && dst_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888_QINT16) ||
+               (src_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY && dst_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY_QINT16)) {
+        convert_img_loop<uint8_t, int16_t>(src_img, dst_img, caps, norm_lut, crop_area);
+    } else {
+        ESP_LOGE("dl_image_color",
+                 "img conversion between fmt %s and %s is not implemented yet.",
+                 pix_type_to_str(src_img.pix_type).c_str(),
+                 pix_type_to_str(dst_img.pix_type).c_str());
+    }
+}
+
+#if CONFIG_IDF_TARGET_ESP32P4
+esp_err_t convert_img_ppa(const img_t &src_img,
+                          img_t &dst_img,
+                          ppa_client_handle_t ppa_handle,
+                          void *ppa_buffer,
+                          size_t ppa_buffer_size,
+                          uint32_t caps,
+                          void *norm_lut,
+                          const std::vector<int> &crop_area)
+{
+    // TODO if do nothing ,just copy.
+    if (!(caps & DL_IMAGE_CAP_PPA)) {
+        return ESP_FAIL;
+    }
+    // Input only support rgb565/rgb888. If output is not rgb565/rgb888, additional convert is needed, just call
+    // convert_img.
+    ppa_srm_color_mode_t input_srm_color_mode;
+    if (convert_pix_type_to_ppa_srm_fmt(src_img.pix_type, &input_srm_color_mode) == ESP_FAIL) {
+        return ESP_FAIL;
+    }
+    ppa_srm_color_mode_t output_srm_color_mode;
+    if (convert_pix_type_to_ppa_srm_fmt(src_img.pix_type, &output_srm_color_mode) == ESP_FAIL) {
+        return ESP_FAIL;
+    }
+    assert(ppa_handle);
+    assert(ppa_buffer);
+    assert(src_img.data);
+    assert(dst_img.data);
+    assert(src_img.height > 0 && src_img.width > 0);
+
+    ppa_srm_oper_config_t srm_oper_config;
+    memset(&srm_oper_config, 0, sizeof(ppa_srm_oper_config_t));
+    if (crop_area.empty()) {
+        dst_img.height = src_img.height;
+        dst_img.width = src_img.width;
+        srm_oper_config.in.block_offset_y = 0;
+        srm_oper_config.in.block_offset_x = 0;
+        srm_oper_config.in.block_h = src_img.height;
+        srm_oper_config.in.block_w = src_img.width;
+    } else {
+        assert(crop_area.size() == 4);
+        assert(crop_area[2] > crop_area[0]);
+        assert(crop_area[3] > crop_area[1]);
+        assert(crop_area[0] < src_img.width && crop_area[0] >= 0);
+        assert(crop_area[1] < src_img.height && crop_area[1] >= 0);
+        assert(crop_area[2] <= src_img.width && crop_area[2] > 0);
+        assert(crop_area[3] <= src_img.height && crop_area[3] > 0);
+        dst_img.height = crop_area[3] - crop_area[1];
+        dst_img.width = crop_area[2] - crop_area[0];
+        srm_oper_config.in.block_offset_y = crop_area[1];
+        srm_oper_config.in.block_offset_x = crop_area[0];
+        srm_oper_config.in.block_h = dst_img.height;
+        srm_oper_config.in.block_w = dst_img.width;
+    }
+    srm_oper_config.in.buffer = (const void *)src_img.data;
+    srm_oper_config.in.pic_h = src_img.height;
+    srm_oper_config.in.pic_w = src_img.width;
+    srm_oper_config.in.srm_cm = input_srm_color_mode;
+    srm_oper_config.rgb_swap = caps & DL_IMAGE_CAP_RGB_SWAP;
+    srm_oper_config.byte_swap =
+        (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565) && (caps & DL_IMAGE_CAP_RGB565_BIG_ENDIAN);
+
+    srm_oper_config.out.buffer = ppa_buffer;
+    srm_oper_config.out.buffer_size = ppa_buffer_size;
+    srm_oper_config.out.pic_h = dst_img.height;
+    srm_oper_config.out.pic_w = dst_img.width;
+    srm_oper_config.out.block_offset_x = 0;
+    srm_oper_config.out.block_offset_y = 0;
+
+    srm_oper_config.out.srm_cm =
+        (dst_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565) ? PPA_SRM_COLOR_MODE_RGB565 : PPA_SRM_COLOR_MODE_RGB888;
+    srm_oper_config.rotation_angle = PPA_SRM_ROTATION_ANGLE_0;
+
+    srm_oper_config.scale_x = 1;
+    srm_oper_config.scale_y = 1;
+    srm_oper_config.mirror_x = false;
+    srm_oper_config.mirror_y = false;
+    srm_oper_config.mode = PPA_TRANS_MODE_BLOCKING;
+
+    ESP_ERROR_CHECK(ppa_do_scale_rotate_mirror(ppa_handle, &srm_oper_config));
+    // additional memory copy needed, performance tradeoff should be considered.
+    tool::copy_memory(dst_img.data, ppa_buffer, get_img_byte_size(dst_img));
+    return ESP_OK;
+}
+#endif
+
+} // namespace image
+} // namespace dl
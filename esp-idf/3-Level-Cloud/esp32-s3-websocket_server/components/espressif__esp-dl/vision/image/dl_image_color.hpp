@@ -239,6 +239,38 @@ inline void convert_pixel(const pix_t &src_pix, pix_t &dst_pix, uint32_t caps, v
     }
 }
 
+/**
+ * @brief Converts n consecutive pixels, see get_convert_row_fn().
+ */
+typedef void (*convert_row_fn_t)(const void *src, void *dst, int n, void *norm_lut);
+
+/**
+ * @brief Row kernel for a pair of pixel types, same results as convert_pixel() on each pixel.
+ *
+ * One instantiation per (src type, dst type, caps): the type and caps checks
+ * of convert_pixel() are resolved at compile time, and RGB565/RGB888 sources
+ * are read a 32-bit word at a time. Pick it once per image, not per pixel.
+ *
+ * @return nullptr if convert_pixel() does not support the pair either.
+ */
+convert_row_fn_t get_convert_row_fn(pix_type_t src_type, pix_type_t dst_type, uint32_t caps);
+
+/**
+ * @brief Converts the pixels src[index[0]], ..., src[index[n - 1]] into n consecutive pixels.
+ */
+typedef void (*gather_row_fn_t)(const void *src, const int *index, void *dst, int n, void *norm_lut);
+
+/**
+ * @brief Gather kernel for a pair of pixel types: picks, decodes and normalizes in one pass.
+ *
+ * For resize and warp, the source pixels go straight into the model input
+ * without an intermediate row. Same pairs as get_convert_row_fn(), plus
+ * gray to gray.
+ *
+ * @return nullptr if the pair is not supported.
+ */
+gather_row_fn_t get_gather_row_fn(pix_type_t src_type, pix_type_t dst_type, uint32_t caps);
+
 template <typename T1, typename T2>
 void convert_img_loop(
     const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut, const std::vector<int> &crop_area);
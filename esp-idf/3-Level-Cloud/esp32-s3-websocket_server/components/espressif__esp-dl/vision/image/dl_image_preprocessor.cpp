@@ -1,5 +1,7 @@
 #include "dl_image_preprocessor.hpp"
 
+static const char *TAG = "dl_image_preprocessor";
+
 namespace dl {
 namespace image {
 
@@ -68,9 +70,20 @@ void ImagePreprocessor::create_norm_lut()
 template void ImagePreprocessor::create_norm_lut<int8_t>();
 template void ImagePreprocessor::create_norm_lut<int16_t>();
 
+// A model built while a dl::ModelArena is bound gets placeholder tensor addresses, and ModelArena::commit() moves
+// its input after this preprocessor was constructed. The output is checked against the model input at every call.
+void ImagePreprocessor::bind_output()
+{
+    if (m_output.data != m_model_input->data) {
+        ESP_LOGD(TAG, "Model input moved from %p to %p", m_output.data, m_model_input->data);
+        m_output.data = m_model_input->data;
+    }
+}
+
 void ImagePreprocessor::preprocess(const img_t &img, const std::vector<int> &crop_area)
 {
     assert(get_img_channel(img) == m_mean.size());
+    bind_output();
     m_crop_area = crop_area;
 #if CONFIG_IDF_TARGET_ESP32P4
     if (resize_ppa(img,
@@ -92,7 +105,8 @@ void ImagePreprocessor::preprocess(const img_t &img, const std::vector<int> &cro
                m_norm_lut,
                crop_area,
                &m_resize_scale_x,
-               &m_resize_scale_y);
+               &m_resize_scale_y,
+               &m_resize_table);
     }
 #else
     resize(img,
@@ -102,13 +116,15 @@ void ImagePreprocessor::preprocess(const img_t &img, const std::vector<int> &cro
            m_norm_lut,
            crop_area,
            &m_resize_scale_x,
-           &m_resize_scale_y);
+           &m_resize_scale_y,
+           &m_resize_table);
 #endif
 }
 
 void ImagePreprocessor::preprocess(const img_t &img, dl::math::Matrix<float> *M_inv)
 {
     assert(get_img_channel(img) == m_mean.size());
+    bind_output();
     warp_affine(img, m_output, DL_IMAGE_INTERPOLATE_NEAREST, M_inv, m_caps, m_norm_lut);
 }
 } // namespace image
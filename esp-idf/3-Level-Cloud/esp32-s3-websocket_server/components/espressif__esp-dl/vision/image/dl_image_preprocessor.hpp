@@ -27,6 +27,7 @@ private:
     float m_resize_scale_x;
     float m_resize_scale_y;
     img_t m_output;
+    ResizeTable m_resize_table; // same input size frame after frame, built once
 #if CONFIG_IDF_TARGET_ESP32P4
     ppa_client_handle_t m_ppa_srm_handle;
     size_t m_ppa_buffer_size;
@@ -34,6 +35,7 @@ private:
 #endif
     template <typename T>
     void create_norm_lut();
+    void bind_output();
 
 public:
     ImagePreprocessor(Model *model,
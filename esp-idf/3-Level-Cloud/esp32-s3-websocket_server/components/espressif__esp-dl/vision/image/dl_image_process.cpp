@@ -321,6 +321,289 @@ template void resize_loop<uint16_t>(const img_t &src_img,
                                     float scale_x,
                                     float scale_y);
 
+bool ResizeTable::update(const img_t &src_img,
+                         const img_t &dst_img,
+                         interpolate_type_t interpolate_type,
+                         const std::vector<int> &crop_area)
+{
+    if (m_builds > 0 && src_img.width == m_src_width && src_img.height == m_src_height &&
+        dst_img.width == m_dst_width && dst_img.height == m_dst_height && src_img.pix_type == m_src_pix_type &&
+        interpolate_type == m_interpolate_type && crop_area == m_crop_area) {
+        return false;
+    }
+    m_src_width = src_img.width;
+    m_src_height = src_img.height;
+    m_dst_width = dst_img.width;
+    m_dst_height = dst_img.height;
+    m_src_pix_type = src_img.pix_type;
+    m_interpolate_type = interpolate_type;
+    m_crop_area = crop_area;
+
+    int left = 0, top = 0, right = src_img.width, bottom = src_img.height;
+    if (!crop_area.empty()) {
+        left = crop_area[0];
+        top = crop_area[1];
+        right = crop_area[2];
+        bottom = crop_area[3];
+    }
+    // Same float arithmetic as resize_loop(), so the source pixels are the same
+    float scale_x_inv = 1.f / ((float)dst_img.width / (float)(right - left));
+    float scale_y_inv = 1.f / ((float)dst_img.height / (float)(bottom - top));
+    m_x0.resize(m_dst_width);
+    m_x1.resize(m_dst_width);
+    m_x_weight.resize(m_dst_width);
+    for (int j = 0; j < m_dst_width; j++) {
+        float x = (j + 0.5f) * scale_x_inv - 0.5f;
+        x = std::max(std::min(x + left, (float)(right - 1)), (float)left);
+        if (interpolate_type == DL_IMAGE_INTERPOLATE_NEAREST) {
+            m_x0[j] = (int)(x + 0.5f);
+            m_x1[j] = m_x0[j];
+            m_x_weight[j] = 0;
+        } else {
+            m_x0[j] = (int)x;
+            m_x1[j] = std::min(m_x0[j] + 1, right - 1);
+            m_x_weight[j] = (uint16_t)((x - m_x0[j]) * 256.f + 0.5f);
+        }
+    }
+    m_y0.resize(m_dst_height);
+    m_y1.resize(m_dst_height);
+    m_y_weight.resize(m_dst_height);
+    for (int i = 0; i < m_dst_height; i++) {
+        float y = (i + 0.5f) * scale_y_inv - 0.5f;
+        y = std::max(std::min(y + top, (float)(bottom - 1)), (float)top);
+        if (interpolate_type == DL_IMAGE_INTERPOLATE_NEAREST) {
+            m_y0[i] = (uint16_t)(y + 0.5f);
+            m_y1[i] = m_y0[i];
+            m_y_weight[i] = 0;
+        } else {
+            m_y0[i] = (uint16_t)y;
+            m_y1[i] = (uint16_t)std::min(m_y0[i] + 1, bottom - 1);
+            m_y_weight[i] = (uint16_t)((y - m_y0[i]) * 32768.f + 0.5f);
+        }
+    }
+    int channel = (src_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY) ? 1 : 3;
+    if (interpolate_type == DL_IMAGE_INTERPOLATE_BILINEAR) {
+        m_rows.resize(2 * m_dst_width * channel);
+        m_line.resize(m_dst_width * channel);
+    } else {
+        // gathered straight into the destination
+        m_rows.clear();
+        m_line.clear();
+    }
+    m_builds++;
+    ESP_LOGD(TAG, "resize table %dx%d -> %dx%d built", right - left, bottom - top, m_dst_width, m_dst_height);
+    return true;
+}
+
+// Source row y interpolated at the destination columns, Q8
+void ResizeTable::interpolate_row(const img_t &src_img, int y, uint16_t *row, uint32_t caps)
+{
+    int src_step = (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888) ? 3
+        : (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565)         ? 2
+                                                                 : 1;
+    m_src_bytes += 2 * src_step * m_dst_width; // the left and the right column
+    if (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888) {
+        const uint8_t *src_row = (const uint8_t *)src_img.data + 3 * src_img.width * y;
+        for (int j = 0; j < m_dst_width; j++) {
+            const uint8_t *p0 = src_row + 3 * m_x0[j];
+            const uint8_t *p1 = src_row + 3 * m_x1[j];
+            uint16_t w1 = m_x_weight[j];
+            uint16_t w0 = 256 - w1;
+            row[0] = p0[0] * w0 + p1[0] * w1;
+            row[1] = p0[1] * w0 + p1[1] * w1;
+            row[2] = p0[2] * w0 + p1[2] * w1;
+            row += 3;
+        }
+    } else if (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565) {
+        uint16_t *src_row = (uint16_t *)src_img.data + src_img.width * y;
+        uint8_t p0[3], p1[3];
+        for (int j = 0; j < m_dst_width; j++) {
+            convert_pixel_from_rgb565_to_rgb888(src_row + m_x0[j], p0, caps);
+            convert_pixel_from_rgb565_to_rgb888(src_row + m_x1[j], p1, caps);
+            uint16_t w1 = m_x_weight[j];
+            uint16_t w0 = 256 - w1;
+            row[0] = p0[0] * w0 + p1[0] * w1;
+            row[1] = p0[1] * w0 + p1[1] * w1;
+            row[2] = p0[2] * w0 + p1[2] * w1;
+            row += 3;
+        }
+    } else {
+        const uint8_t *src_row = (const uint8_t *)src_img.data + src_img.width * y;
+        for (int j = 0; j < m_dst_width; j++) {
+            uint16_t w1 = m_x_weight[j];
+            row[j] = src_row[m_x0[j]] * (256 - w1) + src_row[m_x1[j]] * w1;
+        }
+    }
+}
+
+template <typename T>
+void ResizeTable::run_nearest(const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut)
+{
+    int step = DL_IMAGE_IS_PIX_TYPE_RGB888(dst_img.pix_type) ? 3 : 1;
+    int src_step = (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888) ? 3
+        : (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565)         ? 2
+                                                                 : 1;
+    uint32_t pix_caps = (src_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY) ? 0 : caps;
+    // Picks, decodes and normalizes the source pixels of a row straight into the destination
+    gather_row_fn_t gather_row = get_gather_row_fn(src_img.pix_type, dst_img.pix_type, pix_caps);
+    if (!gather_row) {
+        ESP_LOGE(TAG,
+                 "pixel conversion between fmt %s and %s is not implemented yet.",
+                 pix_type_to_str(src_img.pix_type).c_str(),
+                 pix_type_to_str(dst_img.pix_type).c_str());
+        return;
+    }
+    T *pix_ptr = (T *)dst_img.data;
+    int row_len = step * m_dst_width;
+    for (int i = 0; i < m_dst_height; i++) {
+        if (i > 0 && m_y0[i] == m_y0[i - 1]) {
+            // Upscaled: same source row as the row above, which is not read again
+            memcpy(pix_ptr, pix_ptr - row_len, row_len * sizeof(T));
+        } else {
+            const uint8_t *src_row = (const uint8_t *)src_img.data + src_step * src_img.width * m_y0[i];
+            gather_row(src_row, m_x0.data(), pix_ptr, m_dst_width, norm_lut);
+            m_src_bytes += src_step * m_dst_width;
+        }
+        pix_ptr += row_len;
+    }
+}
+
+// Blends two horizontally interpolated rows into the lut values of the model input
+template <typename T>
+static void normalize_row(
+    const uint16_t *h0, const uint16_t *h1, uint32_t wy0, uint32_t wy1, int n, int channel, bool swap, T *out, T *lut)
+{
+    if (channel == 1) {
+        for (int k = 0; k < n; k++) {
+            out[k] = lut[(h0[k] * wy0 + h1[k] * wy1 + (1 << 22)) >> 23];
+        }
+        return;
+    }
+    // Channels 0 and 2 trade places with RGB_SWAP, one lut for all, as convert_pixel_from_rgb888_to_rgb888_quant()
+    int first = swap ? 2 : 0;
+    int last = swap ? 0 : 2;
+    for (int k = 0; k < n; k += 3) {
+        out[k + first] = lut[(h0[k] * wy0 + h1[k] * wy1 + (1 << 22)) >> 23];
+        out[k + 1] = lut[(h0[k + 1] * wy0 + h1[k + 1] * wy1 + (1 << 22)) >> 23];
+        out[k + last] = lut[(h0[k + 2] * wy0 + h1[k + 2] * wy1 + (1 << 22)) >> 23];
+    }
+}
+
+template <typename T>
+void ResizeTable::run_bilinear(const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut)
+{
+    int channel = (src_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY) ? 1 : 3;
+    int n = m_dst_width * channel;
+    int step = DL_IMAGE_IS_PIX_TYPE_RGB888(dst_img.pix_type) ? 3 : 1;
+    // rgb565 is swapped when it is read, gray has no caps: only rgb888 applies them on the way out
+    uint32_t line_caps = (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888) ? caps : 0;
+    pix_type_t line_type = (channel == 3) ? DL_IMAGE_PIX_TYPE_RGB888 : DL_IMAGE_PIX_TYPE_GRAY;
+    bool direct = (dst_img.pix_type == line_type) && !(line_caps & DL_IMAGE_CAP_RGB_SWAP);
+    // Model input with the channels of the rows: normalized in the vertical pass, no rgb888 row in between
+    bool normalize = DL_IMAGE_IS_PIX_TYPE_QUANT(dst_img.pix_type) && step == channel;
+    convert_row_fn_t convert_row = nullptr;
+    if (!direct && !normalize) {
+        convert_row = get_convert_row_fn(line_type, dst_img.pix_type, line_caps);
+        if (!convert_row) {
+            ESP_LOGE(TAG,
+                     "pixel conversion between fmt %s and %s is not implemented yet.",
+                     pix_type_to_str(line_type).c_str(),
+                     pix_type_to_str(dst_img.pix_type).c_str());
+            return;
+        }
+    }
+
+    uint16_t *rows[2] = {m_rows.data(), m_rows.data() + n};
+    int row_y[2] = {-1, -1}; // source rows in the buffers, a new frame starts empty
+    T *pix_ptr = (T *)dst_img.data;
+    for (int i = 0; i < m_dst_height; i++) {
+        int y0 = m_y0[i];
+        int y1 = m_y1[i];
+        uint32_t wy1 = m_y_weight[i];
+        uint32_t wy0 = 32768 - wy1;
+        // Consecutive destination rows mostly share their source rows, or move down by one
+        if (row_y[0] != y0) {
+            if (row_y[1] == y0) {
+                std::swap(rows[0], rows[1]);
+                std::swap(row_y[0], row_y[1]);
+            } else {
+                interpolate_row(src_img, y0, rows[0], caps);
+                row_y[0] = y0;
+            }
+        }
+        const uint16_t *h0 = rows[0];
+        const uint16_t *h1 = h0;
+        if (wy1 != 0) {
+            if (row_y[1] != y1) {
+                interpolate_row(src_img, y1, rows[1], caps);
+                row_y[1] = y1;
+            }
+            h1 = rows[1];
+        }
+        if (normalize) {
+            normalize_row<T>(
+                h0, h1, wy0, wy1, n, channel, line_caps & DL_IMAGE_CAP_RGB_SWAP, pix_ptr, (T *)norm_lut);
+        } else {
+            uint8_t *out = direct ? (uint8_t *)pix_ptr : m_line.data();
+            if (wy1 == 0) {
+                for (int k = 0; k < n; k++) {
+                    out[k] = (uint8_t)((h0[k] + 128) >> 8);
+                }
+            } else {
+                for (int k = 0; k < n; k++) {
+                    out[k] = (uint8_t)((h0[k] * wy0 + h1[k] * wy1 + (1 << 22)) >> 23);
+                }
+            }
+            if (!direct) {
+                convert_row(out, pix_ptr, m_dst_width, norm_lut);
+            }
+        }
+        pix_ptr += step * m_dst_width;
+    }
+}
+
+void ResizeTable::run(const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut)
+{
+    assert(src_img.width == m_src_width && src_img.height == m_src_height && src_img.pix_type == m_src_pix_type);
+    assert(dst_img.width == m_dst_width && dst_img.height == m_dst_height);
+    assert(!DL_IMAGE_IS_PIX_TYPE_QUANT(src_img.pix_type));
+
+    m_src_bytes = 0;
+    switch (dst_img.pix_type) {
+    case DL_IMAGE_PIX_TYPE_RGB888:
+    case DL_IMAGE_PIX_TYPE_GRAY:
+        if (m_interpolate_type == DL_IMAGE_INTERPOLATE_BILINEAR) {
+            run_bilinear<uint8_t>(src_img, dst_img, caps, norm_lut);
+        } else {
+            run_nearest<uint8_t>(src_img, dst_img, caps, norm_lut);
+        }
+        break;
+    case DL_IMAGE_PIX_TYPE_RGB888_QINT8:
+    case DL_IMAGE_PIX_TYPE_GRAY_QINT8:
+        if (m_interpolate_type == DL_IMAGE_INTERPOLATE_BILINEAR) {
+            run_bilinear<int8_t>(src_img, dst_img, caps, norm_lut);
+        } else {
+            run_nearest<int8_t>(src_img, dst_img, caps, norm_lut);
+        }
+        break;
+    case DL_IMAGE_PIX_TYPE_RGB888_QINT16:
+    case DL_IMAGE_PIX_TYPE_GRAY_QINT16:
+        if (m_interpolate_type == DL_IMAGE_INTERPOLATE_BILINEAR) {
+            run_bilinear<int16_t>(src_img, dst_img, caps, norm_lut);
+        } else {
+            run_nearest<int16_t>(src_img, dst_img, caps, norm_lut);
+        }
+        break;
+    case DL_IMAGE_PIX_TYPE_RGB565:
+        if (m_interpolate_type == DL_IMAGE_INTERPOLATE_BILINEAR) {
+            run_bilinear<uint16_t>(src_img, dst_img, caps, norm_lut);
+        } else {
+            run_nearest<uint16_t>(src_img, dst_img, caps, norm_lut);
+        }
+        break;
+    }
+}
+
 void resize(const img_t &src_img,
             img_t &dst_img,
             interpolate_type_t interpolate_type,
@@ -328,7 +611,8 @@ void resize(const img_t &src_img,
             void *norm_lut,
             const std::vector<int> &crop_area,
             float *scale_x_ret,
-            float *scale_y_ret)
+            float *scale_y_ret,
+            ResizeTable *table)
 {
     assert(src_img.data);
     assert(dst_img.data);
@@ -360,6 +644,15 @@ void resize(const img_t &src_img,
         convert_img(src_img, dst_img, caps, norm_lut, crop_area);
         return;
     }
+    if (!DL_IMAGE_IS_PIX_TYPE_QUANT(src_img.pix_type)) {
+        ResizeTable local_table;
+        if (!table) {
+            table = &local_table;
+        }
+        table->update(src_img, dst_img, interpolate_type, crop_area);
+        table->run(src_img, dst_img, caps, norm_lut);
+        return;
+    }
 
     switch (dst_img.pix_type) {
     case DL_IMAGE_PIX_TYPE_RGB888:
@@ -533,6 +826,20 @@ esp_err_t resize_ppa(const img_t &src_img,
     return ESP_OK;
 }
 #endif
+// Source pixel of output (i, j) for the nearest warp. Not inlined: warp_affine() recomputes the positions close to a
+// pixel boundary with it, and -ffast-math may evaluate the same float expression differently in another loop.
+__attribute__((noinline)) static int warp_nearest_index(const img_t &src_img,
+                                                        const dl::math::Matrix<float> *M_inv,
+                                                        int i,
+                                                        int j)
+{
+    float x = M_inv->array[0][0] * j + M_inv->array[0][1] * i + M_inv->array[0][2];
+    float y = M_inv->array[1][0] * j + M_inv->array[1][1] * i + M_inv->array[1][2];
+    x = std::max(std::min(x, (float)(src_img.width - 1)), 0.f);
+    y = std::max(std::min(y, (float)(src_img.height - 1)), 0.f);
+    return (int)(x + 0.5f) + src_img.width * (int)(y + 0.5f);
+}
+
 template <typename T>
 void warp_affine_loop(const img_t &src_img,
                       img_t &dst_img,
@@ -596,54 +903,28 @@ void warp_affine_loop(const img_t &src_img,
             ESP_LOGE(TAG, "Do not support quant img type.");
         }
         break;
-    case DL_IMAGE_INTERPOLATE_NEAREST:
-        if (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB888) {
-            for (int i = 0; i < dst_img.height; i++) {
-                Bx = M_inv->array[0][1] * i;
-                By = M_inv->array[1][1] * i;
-                for (int j = 0; j < dst_img.width; j++) {
-                    Ax = M_inv->array[0][0] * j;
-                    Ay = M_inv->array[1][0] * j;
-                    x = Ax + Bx + M_inv->array[0][2];
-                    y = Ay + By + M_inv->array[1][2];
-                    pix.data = (void *)pix_ptr;
-                    nearest_interpolate_rgb888(src_img, x, y, pix, caps, norm_lut);
-                    pix_ptr += step;
-                }
-            }
-        } else if (src_img.pix_type == DL_IMAGE_PIX_TYPE_RGB565) {
-            for (int i = 0; i < dst_img.height; i++) {
-                Bx = M_inv->array[0][1] * i;
-                By = M_inv->array[1][1] * i;
-                for (int j = 0; j < dst_img.width; j++) {
-                    Ax = M_inv->array[0][0] * j;
-                    Ay = M_inv->array[1][0] * j;
-                    x = Ax + Bx + M_inv->array[0][2];
-                    y = Ay + By + M_inv->array[1][2];
-                    pix.data = (void *)pix_ptr;
-                    nearest_interpolate_rgb565(src_img, x, y, pix, caps, norm_lut);
-                    pix_ptr += step;
-                }
-            }
-        } else if (src_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY) {
-            for (int i = 0; i < dst_img.height; i++) {
-                Bx = M_inv->array[0][1] * i;
-                By = M_inv->array[1][1] * i;
-                for (int j = 0; j < dst_img.width; j++) {
-                    Ax = M_inv->array[0][0] * j;
-                    Ay = M_inv->array[1][0] * j;
-                    x = Ax + Bx + M_inv->array[0][2];
-                    y = Ay + By + M_inv->array[1][2];
-                    pix.data = (void *)pix_ptr;
-                    nearest_interpolate_gray(src_img, x, y, pix, norm_lut);
-                    pix_ptr += step;
-                }
+    case DL_IMAGE_INTERPOLATE_NEAREST: {
+        uint32_t pix_caps = (src_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY) ? 0 : caps;
+        gather_row_fn_t gather_row = get_gather_row_fn(src_img.pix_type, dst_img.pix_type, pix_caps);
+        if (!gather_row) {
+            ESP_LOGE(TAG,
+                     "pixel conversion between fmt %s and %s is not implemented yet.",
+                     pix_type_to_str(src_img.pix_type).c_str(),
+                     pix_type_to_str(dst_img.pix_type).c_str());
+            break;
+        }
+        // The source pixels of a row, as nearest_interpolate_*(), then one pass into the destination
+        std::vector<int> index(dst_img.width);
+        for (int i = 0; i < dst_img.height; i++) {
+            for (int j = 0; j < dst_img.width; j++) {
+                index[j] = warp_nearest_index(src_img, M_inv, i, j);
             }
-        } else {
-            ESP_LOGE(TAG, "Do not support quant img type");
+            gather_row(src_img.data, index.data(), pix_ptr, dst_img.width, norm_lut);
+            pix_ptr += step * dst_img.width;
         }
         break;
     }
+    }
 }
 
 template void warp_affine_loop<uint8_t>(const img_t &src_img,
@@ -671,6 +952,239 @@ template void warp_affine_loop<uint16_t>(const img_t &src_img,
                                          uint32_t caps,
                                          void *norm_lut);
 
+// Columns j in [*begin, *end) for which lo <= x0 + j * dx <= hi, the span is only narrowed
+static void clip_span(int64_t x0, int64_t dx, int64_t lo, int64_t hi, int *begin, int *end)
+{
+    auto floor_div = [](int64_t a, int64_t b) -> int64_t {
+        int64_t q = a / b;
+        return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+    };
+    int64_t first, last;
+    if (dx > 0) {
+        first = -floor_div(x0 - lo, dx);
+        last = floor_div(hi - x0, dx);
+    } else if (dx < 0) {
+        first = -floor_div(hi - x0, -dx);
+        last = floor_div(x0 - lo, -dx);
+    } else {
+        first = (x0 >= lo && x0 <= hi) ? *begin : *end;
+        last = *end;
+    }
+    *begin = (int)std::max<int64_t>(*begin, std::min<int64_t>(first, *end));
+    *end = (int)std::max<int64_t>(*begin, std::min<int64_t>(*end, last + 1));
+}
+
+// Bilinear pixel at the 16.16 source position, Q11 weights (255 * 2^22 fits 32 bits). dx_next/dy_next are 0 on
+// the last column/row
+template <pix_type_t SRC>
+inline void warp_bilinear_pixel(
+    const img_t &img, int32_t x, int32_t y, int dx_next, int dy_next, uint32_t caps, uint8_t *out)
+{
+    int x1 = x >> 16;
+    int y1 = y >> 16;
+    uint32_t wx = (x >> 5) & 0x7ff;
+    uint32_t wy = (y >> 5) & 0x7ff;
+    int offset = x1 + img.width * y1;
+    int right = dx_next;
+    int down = dy_next * img.width;
+    if constexpr (SRC == DL_IMAGE_PIX_TYPE_GRAY) {
+        const uint8_t *q = (const uint8_t *)img.data + offset;
+        uint32_t top = q[0] * (2048 - wx) + q[right] * wx;
+        uint32_t bottom = q[down] * (2048 - wx) + q[down + right] * wx;
+        out[0] = (uint8_t)((top * (2048 - wy) + bottom * wy + (1 << 21)) >> 22);
+    } else {
+        uint8_t p[4][3];
+        if constexpr (SRC == DL_IMAGE_PIX_TYPE_RGB565) {
+            uint16_t *q = (uint16_t *)img.data + offset;
+            convert_pixel_from_rgb565_to_rgb888(q, p[0], caps);
+            convert_pixel_from_rgb565_to_rgb888(q + right, p[1], caps);
+            convert_pixel_from_rgb565_to_rgb888(q + down, p[2], caps);
+            convert_pixel_from_rgb565_to_rgb888(q + down + right, p[3], caps);
+        } else {
+            const uint8_t *q = (const uint8_t *)img.data + 3 * offset;
+            memcpy(p[0], q, 3);
+            memcpy(p[1], q + 3 * right, 3);
+            memcpy(p[2], q + 3 * down, 3);
+            memcpy(p[3], q + 3 * (down + right), 3);
+        }
+        for (int c = 0; c < 3; c++) {
+            uint32_t top = p[0][c] * (2048 - wx) + p[1][c] * wx;
+            uint32_t bottom = p[2][c] * (2048 - wx) + p[3][c] * wx;
+            out[c] = (uint8_t)((top * (2048 - wy) + bottom * wy + (1 << 21)) >> 22);
+        }
+    }
+}
+
+template <typename T, pix_type_t SRC>
+static void warp_affine_bilinear_fixed(const img_t &src_img,
+                                       img_t &dst_img,
+                                       const int32_t row_start[],
+                                       int32_t dx,
+                                       int32_t dy,
+                                       uint32_t caps,
+                                       void *norm_lut)
+{
+    int channel = (SRC == DL_IMAGE_PIX_TYPE_GRAY) ? 1 : 3;
+    int step = DL_IMAGE_IS_PIX_TYPE_RGB888(dst_img.pix_type) ? 3 : 1;
+    // As ResizeTable: rgb565 is swapped when it is read, rgb888 on the way out
+    uint32_t line_caps = (SRC == DL_IMAGE_PIX_TYPE_RGB888) ? caps : 0;
+    pix_type_t line_type = (channel == 3) ? DL_IMAGE_PIX_TYPE_RGB888 : DL_IMAGE_PIX_TYPE_GRAY;
+    bool direct = (dst_img.pix_type == line_type) && !(line_caps & DL_IMAGE_CAP_RGB_SWAP);
+    bool normalize = DL_IMAGE_IS_PIX_TYPE_QUANT(dst_img.pix_type) && step == channel;
+    convert_row_fn_t convert_row = nullptr;
+    if (!direct && !normalize) {
+        convert_row = get_convert_row_fn(line_type, dst_img.pix_type, line_caps);
+        if (!convert_row) {
+            ESP_LOGE(TAG,
+                     "pixel conversion between fmt %s and %s is not implemented yet.",
+                     pix_type_to_str(line_type).c_str(),
+                     pix_type_to_str(dst_img.pix_type).c_str());
+            return;
+        }
+    }
+    int first = (line_caps & DL_IMAGE_CAP_RGB_SWAP) ? 2 : 0;
+    int last = 2 - first;
+    T *lut = (T *)norm_lut;
+    int32_t x_max = (src_img.width - 1) << 16;
+    int32_t y_max = (src_img.height - 1) << 16;
+    std::vector<uint8_t> line((direct || normalize) ? 0 : dst_img.width * channel);
+    T *pix_ptr = (T *)dst_img.data;
+    for (int i = 0; i < dst_img.height; i++) {
+        int32_t x = row_start[2 * i];
+        int32_t y = row_start[2 * i + 1];
+        // Both neighbors inside the image: no clamps
+        int begin = 0, end = dst_img.width;
+        clip_span(x, dx, 0, x_max - 1, &begin, &end);
+        clip_span(y, dy, 0, y_max - 1, &begin, &end);
+        uint8_t *out = direct ? (uint8_t *)pix_ptr : line.data();
+        for (int j = 0; j < dst_img.width; j++) {
+            uint8_t v[3];
+            if (j >= begin && j < end) {
+                warp_bilinear_pixel<SRC>(src_img, x, y, 1, 1, caps, v);
+            } else {
+                int32_t cx = std::max(std::min(x, x_max), 0);
+                int32_t cy = std::max(std::min(y, y_max), 0);
+                warp_bilinear_pixel<SRC>(src_img, cx, cy, cx < x_max, cy < y_max, caps, v);
+            }
+            if (normalize) {
+                if (channel == 1) {
+                    pix_ptr[j] = lut[v[0]];
+                } else {
+                    // one lut for all channels, as convert_pixel_from_rgb888_to_rgb888_quant()
+                    pix_ptr[3 * j + first] = lut[v[0]];
+                    pix_ptr[3 * j + 1] = lut[v[1]];
+                    pix_ptr[3 * j + last] = lut[v[2]];
+                }
+            } else {
+                memcpy(out + channel * j, v, channel);
+            }
+            x += dx;
+            y += dy;
+        }
+        if (convert_row) {
+            convert_row(line.data(), pix_ptr, dst_img.width, norm_lut);
+        }
+        pix_ptr += step * dst_img.width;
+    }
+}
+
+template <typename T>
+void warp_affine_fixed(const img_t &src_img,
+                       img_t &dst_img,
+                       interpolate_type_t interpolate_type,
+                       dl::math::Matrix<float> *M_inv,
+                       uint32_t caps,
+                       void *norm_lut)
+{
+    // Largest source coordinate of the output, the 16.16 positions must not overflow
+    float extent = 0;
+    for (int r = 0; r < 2; r++) {
+        extent = std::max(extent,
+                          std::fabs(M_inv->array[r][0]) * dst_img.width + std::fabs(M_inv->array[r][1]) * dst_img.height +
+                              std::fabs(M_inv->array[r][2]));
+    }
+    if (!(extent < 32000.f) || src_img.width >= 32768 || src_img.height >= 32768) {
+        warp_affine_loop<T>(src_img, dst_img, interpolate_type, M_inv, caps, norm_lut);
+        return;
+    }
+    // Source position of the first column of each row and the step per column, 16.16
+    std::vector<int32_t> row_start(2 * dst_img.height);
+    for (int i = 0; i < dst_img.height; i++) {
+        row_start[2 * i] = (int32_t)lroundf((M_inv->array[0][1] * i + M_inv->array[0][2]) * 65536.f);
+        row_start[2 * i + 1] = (int32_t)lroundf((M_inv->array[1][1] * i + M_inv->array[1][2]) * 65536.f);
+    }
+    int32_t dx = (int32_t)lroundf(M_inv->array[0][0] * 65536.f);
+    int32_t dy = (int32_t)lroundf(M_inv->array[1][0] * 65536.f);
+
+    if (interpolate_type == DL_IMAGE_INTERPOLATE_BILINEAR) {
+        switch (src_img.pix_type) {
+        case DL_IMAGE_PIX_TYPE_RGB888:
+            warp_affine_bilinear_fixed<T, DL_IMAGE_PIX_TYPE_RGB888>(
+                src_img, dst_img, row_start.data(), dx, dy, caps, norm_lut);
+            break;
+        case DL_IMAGE_PIX_TYPE_RGB565:
+            warp_affine_bilinear_fixed<T, DL_IMAGE_PIX_TYPE_RGB565>(
+                src_img, dst_img, row_start.data(), dx, dy, caps, norm_lut);
+            break;
+        case DL_IMAGE_PIX_TYPE_GRAY:
+            warp_affine_bilinear_fixed<T, DL_IMAGE_PIX_TYPE_GRAY>(
+                src_img, dst_img, row_start.data(), dx, dy, caps, norm_lut);
+            break;
+        default:
+            ESP_LOGE(TAG, "Do not support quant img type.");
+            break;
+        }
+        return;
+    }
+
+    uint32_t pix_caps = (src_img.pix_type == DL_IMAGE_PIX_TYPE_GRAY) ? 0 : caps;
+    gather_row_fn_t gather_row = get_gather_row_fn(src_img.pix_type, dst_img.pix_type, pix_caps);
+    if (!gather_row) {
+        ESP_LOGE(TAG,
+                 "pixel conversion between fmt %s and %s is not implemented yet.",
+                 pix_type_to_str(src_img.pix_type).c_str(),
+                 pix_type_to_str(dst_img.pix_type).c_str());
+        return;
+    }
+    int step = DL_IMAGE_IS_PIX_TYPE_RGB888(dst_img.pix_type) ? 3 : 1;
+    int32_t x_max = (src_img.width - 1) << 16;
+    int32_t y_max = (src_img.height - 1) << 16;
+    int width = src_img.width;
+    // Largest distance, in 2^-16 pixel, between the stepped position and the float one of warp_affine_loop(): half a
+    // unit per column from the rounded step, plus a few float roundings at the largest coordinate (2^-23 relative)
+    int32_t margin = dst_img.width / 2 + 4 * ((int32_t)(extent / 128) + 1) + 1;
+    // Closer than that to a pixel boundary, the rounding is left to the float position
+    auto pick = [&](int i, int j, int32_t x, int32_t y) -> int {
+        if ((uint32_t)((x & 0xffff) - 0x8000 + margin) <= (uint32_t)(2 * margin) ||
+            (uint32_t)((y & 0xffff) - 0x8000 + margin) <= (uint32_t)(2 * margin)) {
+            return warp_nearest_index(src_img, M_inv, i, j);
+        }
+        return ((x + 0x8000) >> 16) + width * ((y + 0x8000) >> 16);
+    };
+    std::vector<int> index(dst_img.width);
+    T *pix_ptr = (T *)dst_img.data;
+    for (int i = 0; i < dst_img.height; i++) {
+        int32_t x = row_start[2 * i];
+        int32_t y = row_start[2 * i + 1];
+        // Rounds to a pixel of the image without clamps
+        int begin = 0, end = dst_img.width;
+        clip_span(x, dx, 0, x_max, &begin, &end);
+        clip_span(y, dy, 0, y_max, &begin, &end);
+        int j = 0;
+        for (; j < begin; j++, x += dx, y += dy) {
+            index[j] = pick(i, j, std::max(std::min(x, x_max), 0), std::max(std::min(y, y_max), 0));
+        }
+        for (; j < end; j++, x += dx, y += dy) {
+            index[j] = pick(i, j, x, y);
+        }
+        for (; j < dst_img.width; j++, x += dx, y += dy) {
+            index[j] = pick(i, j, std::max(std::min(x, x_max), 0), std::max(std::min(y, y_max), 0));
+        }
+        gather_row(src_img.data, index.data(), pix_ptr, dst_img.width, norm_lut);
+        pix_ptr += step * dst_img.width;
+    }
+}
+
 void warp_affine(const img_t &src_img,
                  img_t &dst_img,
                  interpolate_type_t interpolate_type,
@@ -686,18 +1200,18 @@ void warp_affine(const img_t &src_img,
     switch (dst_img.pix_type) {
     case DL_IMAGE_PIX_TYPE_RGB888:
     case DL_IMAGE_PIX_TYPE_GRAY:
-        warp_affine_loop<uint8_t>(src_img, dst_img, interpolate_type, M_inv, caps, norm_lut);
+        warp_affine_fixed<uint8_t>(src_img, dst_img, interpolate_type, M_inv, caps, norm_lut);
         break;
     case DL_IMAGE_PIX_TYPE_RGB888_QINT8:
     case DL_IMAGE_PIX_TYPE_GRAY_QINT8:
-        warp_affine_loop<int8_t>(src_img, dst_img, interpolate_type, M_inv, caps, norm_lut);
+        warp_affine_fixed<int8_t>(src_img, dst_img, interpolate_type, M_inv, caps, norm_lut);
         break;
     case DL_IMAGE_PIX_TYPE_RGB888_QINT16:
     case DL_IMAGE_PIX_TYPE_GRAY_QINT16:
-        warp_affine_loop<int16_t>(src_img, dst_img, interpolate_type, M_inv, caps, norm_lut);
+        warp_affine_fixed<int16_t>(src_img, dst_img, interpolate_type, M_inv, caps, norm_lut);
         break;
     case DL_IMAGE_PIX_TYPE_RGB565:
-        warp_affine_loop<uint16_t>(src_img, dst_img, interpolate_type, M_inv, caps, norm_lut);
+        warp_affine_fixed<uint16_t>(src_img, dst_img, interpolate_type, M_inv, caps, norm_lut);
         break;
     }
 }
@@ -0,0 +1,173 @@
+#pragma once
+#include "dl_image_color.hpp"
+#include "dl_image_define.hpp"
+#include "dl_math_matrix.hpp"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace dl {
+namespace image {
+
+void bilinear_interpolate_rgb888(const img_t &img,
+                                 float x,
+                                 float y,
+                                 pix_t &pix,
+                                 uint32_t caps,
+                                 void *norm_lut,
+                                 const std::vector<int> &crop_area = {});
+void bilinear_interpolate_rgb565(const img_t &img,
+                                 float x,
+                                 float y,
+                                 pix_t &pix,
+                                 uint32_t caps,
+                                 void *norm_lut,
+                                 const std::vector<int> &crop_area = {});
+void bilinear_interpolate_gray(
+    const img_t &img, float x, float y, pix_t &pix, void *norm_lut, const std::vector<int> &crop_area = {});
+void nearest_interpolate_rgb888(const img_t &img,
+                                float x,
+                                float y,
+                                pix_t &pix,
+                                uint32_t caps,
+                                void *norm_lut,
+                                const std::vector<int> &crop_area = {});
+void nearest_interpolate_rgb565(const img_t &img,
+                                float x,
+                                float y,
+                                pix_t &pix,
+                                uint32_t caps,
+                                void *norm_lut,
+                                const std::vector<int> &crop_area = {});
+void nearest_interpolate_gray(
+    const img_t &img, float x, float y, pix_t &pix, void *norm_lut, const std::vector<int> &crop_area = {});
+template <typename T>
+void resize_loop(const img_t &src_img,
+                 img_t &dst_img,
+                 interpolate_type_t interpolate_type,
+                 uint32_t caps,
+                 void *norm_lut,
+                 const std::vector<int> &crop_area,
+                 float scale_x,
+                 float scale_y);
+/**
+ * @brief Source coordinates of a resize, computed once per (src size, dst size, crop, interpolation).
+ *
+ * Every destination column has its source column(s), every destination row its
+ * source row(s); bilinear adds the weight of the second one, Q8 for columns and
+ * Q15 for rows. A bilinear resize interpolates each source row it needs once
+ * horizontally into a Q8 row buffer (16 bit), then blends two such rows
+ * vertically, and converts the result row to the destination type.
+ * Keep one per stream of same-sized frames: it is only rebuilt when the
+ * geometry changes. Not thread-safe, one per task.
+ */
+class ResizeTable {
+public:
+    /**
+     * @brief Rebuilds the tables if the geometry differs from the last call.
+     *
+     * @return true if they were rebuilt.
+     */
+    bool update(const img_t &src_img,
+                const img_t &dst_img,
+                interpolate_type_t interpolate_type,
+                const std::vector<int> &crop_area = {});
+    void run(const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut);
+    uint32_t get_builds() { return m_builds; };
+    /**
+     * @brief Bytes the last run() read from the source image, the frame in PSRAM.
+     */
+    uint32_t get_src_bytes() { return m_src_bytes; };
+
+private:
+    uint16_t m_src_width = 0;
+    uint16_t m_src_height = 0;
+    uint16_t m_dst_width = 0;
+    uint16_t m_dst_height = 0;
+    pix_type_t m_src_pix_type = DL_IMAGE_PIX_TYPE_RGB888;
+    interpolate_type_t m_interpolate_type = DL_IMAGE_INTERPOLATE_NEAREST;
+    std::vector<int> m_crop_area;
+    std::vector<int> m_x0;            // left source column, nearest column for nearest (gather index)
+    std::vector<int> m_x1;            // right source column, clamped to the crop
+    std::vector<uint16_t> m_x_weight; // of the right column, Q8
+    std::vector<uint16_t> m_y0;
+    std::vector<uint16_t> m_y1;
+    std::vector<uint16_t> m_y_weight; // of the lower row, Q15
+    std::vector<uint16_t> m_rows;     // two horizontally interpolated source rows, Q8
+    std::vector<uint8_t> m_line;      // one blended row before a conversion that is not a normalization
+    uint32_t m_builds = 0;
+    uint32_t m_src_bytes = 0;
+
+    template <typename T>
+    void run_nearest(const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut);
+    template <typename T>
+    void run_bilinear(const img_t &src_img, img_t &dst_img, uint32_t caps, void *norm_lut);
+    void interpolate_row(const img_t &src_img, int y, uint16_t *row, uint32_t caps);
+};
+/**
+ * @brief Resizes (and crops) src_img to the size of dst_img, converting to its pixel type.
+ *
+ * RGB888/RGB565/GRAY sources go through a ResizeTable, the given one or a
+ * temporary one.
+ */
+void resize(const img_t &src_img,
+            img_t &dst_img,
+            interpolate_type_t interpolate_type,
+            uint32_t caps = 0,
+            void *norm_lut = nullptr,
+            const std::vector<int> &crop_area = {},
+            float *scale_x_ret = nullptr,
+            float *scale_y_ret = nullptr,
+            ResizeTable *table = nullptr);
+#if CONFIG_SOC_PPA_SUPPORTED
+float get_ppa_scale(uint16_t src, uint16_t dst, float *err_pct = nullptr);
+esp_err_t resize_ppa(const img_t &src_img,
+                     img_t &dst_img,
+                     ppa_client_handle_t ppa_handle,
+                     void *ppa_buffer,
+                     size_t ppa_buffer_size,
+                     ppa_trans_mode_t ppa_mode = PPA_TRANS_MODE_BLOCKING,
+                     void *ppa_user_data = nullptr,
+                     uint32_t caps = DL_IMAGE_CAP_PPA,
+                     void *norm_lut = nullptr,
+                     const std::vector<int> &crop_area = {},
+                     float *scale_x_ret = nullptr,
+                     float *scale_y_ret = nullptr,
+                     float ppa_error_thr = 0.3);
+#endif
+/**
+ * @brief Per-pixel float warp, the reference for warp_affine().
+ */
+template <typename T>
+void warp_affine_loop(const img_t &src_img,
+                      img_t &dst_img,
+                      interpolate_type_t interpolate_type,
+                      dl::math::Matrix<float> *M_inv,
+                      uint32_t caps,
+                      void *norm_lut);
+/**
+ * @brief Affine warp (face alignment), the source position of a row stepped in 16.16 fixed point.
+ *
+ * The columns whose source pixels (and bilinear neighbors) are inside the image
+ * are computed once per row, only the ones outside are clamped. Bilinear uses
+ * Q11 weights and writes the normalized model input directly.
+ * Nearest picks the same pixels as warp_affine_loop(): a position too close to
+ * a pixel boundary for the fixed-point step is computed in float as there.
+ * Bilinear differs from warp_affine_loop() by at most 1.
+ * Source positions beyond +-32000 pixels go through warp_affine_loop().
+ *
+ * @param M_inv Destination to source.
+ */
+void warp_affine(const img_t &src_img,
+                 img_t &dst_img,
+                 interpolate_type_t interpolate_type,
+                 dl::math::Matrix<float> *M_inv,
+                 uint32_t caps = 0,
+                 void *norm_lut = nullptr);
+} // namespace image
+} // namespace dl
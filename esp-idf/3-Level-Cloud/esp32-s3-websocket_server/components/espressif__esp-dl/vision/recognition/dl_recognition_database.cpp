@@ -105,6 +105,14 @@ esp_err_t DataBase::load_database_from_storage(int feat_len)
             continue;
         }
         float *feat = (float *)heap_caps_malloc(m_meta.feat_len * sizeof(float), MALLOC_CAP_SPIRAM);
+        if (!feat) {
+            feat = (float *)heap_caps_malloc(m_meta.feat_len * sizeof(float), MALLOC_CAP_DEFAULT);
+        }
+        if (!feat) {
+            ESP_LOGE(TAG, "No memory to load the database.");
+            fclose(f);
+            return ESP_ERR_NO_MEM;
+        }
         size = fread(feat, sizeof(float), m_meta.feat_len, f);
         if (size != m_meta.feat_len) {
             ESP_LOGE(TAG, "Failed to read feature data.");
@@ -133,6 +141,14 @@ esp_err_t DataBase::enroll_feat(TensorBase *feat)
         return ESP_FAIL;
     }
     float *feat_copy = (float *)heap_caps_malloc(m_meta.feat_len * sizeof(float), MALLOC_CAP_SPIRAM);
+    if (!feat_copy) {
+        // Boards without PSRAM
+        feat_copy = (float *)heap_caps_malloc(m_meta.feat_len * sizeof(float), MALLOC_CAP_DEFAULT);
+    }
+    if (!feat_copy) {
+        ESP_LOGE(TAG, "No memory to enroll the feature.");
+        return ESP_ERR_NO_MEM;
+    }
     memcpy(feat_copy, feat->data, feat->get_bytes());
 
     m_feats.emplace_back(m_meta.num_feats_total + 1, feat_copy);
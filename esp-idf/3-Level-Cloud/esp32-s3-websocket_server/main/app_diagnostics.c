@@ -1,9 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h> // For free()
+#include <math.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "storage_manager.h"
 #include "app_diagnostics.h"
 #include "face_database.h"
+#include "identity_cache.h"
+#include "face_upload.h"
+#include "cloud_identity.h"
+#include "unknown_cluster.h"
+#include "latency_trace.h"
 
 static const char* TAG = "DIAGNOSTICS";
 
@@ -33,7 +40,7 @@ void diagnostics_run_storage_test(void) {
 void diagnostics_run_database_test(void) {
     ESP_LOGI(TAG, "Running database diagnostics...");
 
-    face_record_t* faces = NULL;
+    const face_record_t* faces = NULL;
     int count = 0;
     esp_err_t err = database_get_all_faces(&faces, &count);
 
@@ -46,10 +53,258 @@ void diagnostics_run_database_test(void) {
         ESP_LOGI(TAG, "Database is empty, normal on first boot.");
     } else {
         ESP_LOGI(TAG, "Loaded %d faces from database", count);
+        // The first record must be reachable through the id index
+        face_info_t info;
+        if (database_get_info(faces[0].id, &info) != ESP_OK) {
+            ESP_LOGE(TAG, "Database test FAILED: id %d not found in index.", (int)faces[0].id);
+            return;
+        }
         //Be careful, will print the whole database to terminal!
         //for (int i = 0; i < count; i++) {
-        //    ESP_LOGI(TAG, "  - ID: %d, Name: %s, Title: %s", faces[i].id, faces[i].name, faces[i].title);
+        //    database_get_info(faces[i].id, &info);
+        //    ESP_LOGI(TAG, "  - ID: %d, Name: %s, Title: %s", info.id, info.name, info.title);
         //}
     }
     ESP_LOGI(TAG, "Database diagnostics PASSED.");
-}
\ No newline at end of file
+}
+
+void diagnostics_run_database_benchmark(int num_records) {
+    const char* bench_path = "/spiffs/bench.db";
+    ESP_LOGI(TAG, "Running database benchmark with %d records...", num_records);
+
+    // The database is a single instance, park the real one while benchmarking
+    database_deinit();
+    remove(bench_path);
+
+    if (database_open(bench_path) != ESP_OK) {
+        ESP_LOGE(TAG, "Database benchmark FAILED: Could not create %s.", bench_path);
+        database_init();
+        return;
+    }
+
+    static const char* titles[] = { "Tester", "Developer", "Manager", "Guard" };
+    char name[32], image_file[48], embedding_file[48];
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < num_records; i++) {
+        snprintf(name, sizeof(name), "User %d", i + 1);
+        snprintf(image_file, sizeof(image_file), "/spiffs/face_%d.jpg", i + 1);
+        snprintf(embedding_file, sizeof(embedding_file), "/spiffs/face_%d.dat", i + 1);
+        face_info_t info = {
+            .id = i + 1,
+            .access_level = i % 4,
+            .name = name,
+            .title = titles[i % 4],
+            .status = "active",
+            .image_file = image_file,
+            .embedding_file = embedding_file,
+        };
+        if (database_put_face(&info) != ESP_OK) {
+            ESP_LOGE(TAG, "Database benchmark FAILED at record %d.", i + 1);
+            break;
+        }
+    }
+    int64_t insert_us = esp_timer_get_time() - start;
+    database_deinit();
+
+    start = esp_timer_get_time();
+    esp_err_t err = database_open(bench_path);
+    int64_t load_us = esp_timer_get_time() - start;
+
+    const int lookups = 100000;
+    int found = 0;
+    start = esp_timer_get_time();
+    for (int i = 0; i < lookups; i++) {
+        if (database_find_by_id((i * 7919) % (num_records + 1) + 1)) found++;
+    }
+    int64_t lookup_us = esp_timer_get_time() - start;
+
+    ESP_LOGI(TAG, "Benchmark: %d records, insert %lld ms, load %lld ms, lookup %.2f us (%d/%d hits)",
+             database_get_count(), (long long)(insert_us / 1000), (long long)(load_us / 1000),
+             (double)lookup_us / lookups, found, lookups);
+
+    database_deinit();
+    remove(bench_path);
+    database_init();
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Database benchmark PASSED.");
+    } else {
+        ESP_LOGE(TAG, "Database benchmark FAILED: reload error %s.", esp_err_to_name(err));
+    }
+}
+
+// Small deterministic generator, the replay must give the same stream on every run
+static uint32_t diag_rand(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static void diag_random_unit(float* v, int len, uint32_t* state) {
+    float norm = 0;
+    for (int i = 0; i < len; i++) {
+        v[i] = (float)(diag_rand(state) % 2001) / 1000.0f - 1.0f;
+        norm += v[i] * v[i];
+    }
+    norm = sqrtf(norm);
+    for (int i = 0; i < len; i++) v[i] /= norm;
+}
+
+void diagnostics_run_identity_cache_test(void) {
+    const int feat_len = 128;
+    const int num_ids = 64;      // enrolled identities in the simulated database
+    const int num_frames = 600;  // replayed crops
+    const int num_cameras = 2;
+    const float thr = 0.5f;
+    ESP_LOGI(TAG, "Running identity cache diagnostics (%d frames, %d cameras)...", num_frames, num_cameras);
+
+    float* db = malloc((size_t)num_ids * feat_len * sizeof(float));
+    float* feat = malloc(feat_len * sizeof(float));
+    if (!db || !feat || identity_cache_init(feat_len) != ESP_OK) {
+        ESP_LOGE(TAG, "Identity cache test FAILED: no memory.");
+        free(db);
+        free(feat);
+        return;
+    }
+
+    uint32_t seed = 12345;
+    for (int i = 0; i < num_ids; i++) {
+        diag_random_unit(&db[i * feat_len], feat_len, &seed);
+    }
+
+    // Each camera sees a few regulars in runs (someone stays in view for several frames),
+    // mixed with strangers that are not in the database.
+    int mismatches = 0;
+    int person[2] = { 0, 0 };
+    for (int f = 0; f < num_frames; f++) {
+        int cam = f % num_cameras;
+        bool stranger = (diag_rand(&seed) % 10) == 0;
+        if (stranger) {
+            diag_random_unit(feat, feat_len, &seed);
+        } else {
+            if (diag_rand(&seed) % 8 == 0) {
+                person[cam] = (diag_rand(&seed) % 10) + cam * 10; // 10 regulars per camera
+            }
+            // Same person, new crop: the enrolled embedding plus noise
+            diag_random_unit(feat, feat_len, &seed);
+            const float* ref = &db[person[cam] * feat_len];
+            float norm = 0;
+            for (int i = 0; i < feat_len; i++) {
+                feat[i] = ref[i] + 0.6f * feat[i];
+                norm += feat[i] * feat[i];
+            }
+            norm = sqrtf(norm);
+            for (int i = 0; i < feat_len; i++) feat[i] /= norm;
+        }
+
+        // Reference answer: the full database scan
+        int64_t start = esp_timer_get_time();
+        int db_id = -1;
+        float best = thr;
+        for (int i = 0; i < num_ids; i++) {
+            float sim = 0;
+            for (int k = 0; k < feat_len; k++) sim += db[i * feat_len + k] * feat[k];
+            if (sim > best) {
+                best = sim;
+                db_id = i + 1;
+            }
+        }
+        int64_t query_us = esp_timer_get_time() - start;
+
+        int id = identity_cache_lookup(cam, feat, thr, NULL);
+        if (id >= 0) {
+            if (id != db_id) mismatches++;
+            continue;
+        }
+        identity_cache_record_query(query_us);
+        if (db_id >= 0) {
+            identity_cache_insert(cam, db_id, feat);
+        }
+    }
+
+    identity_cache_stats_t stats;
+    identity_cache_get_stats(&stats);
+    identity_cache_deinit();
+    free(db);
+    free(feat);
+
+    ESP_LOGI(TAG, "Identity cache: %lu lookups, %lu hits (%.1f%%), %lu evictions, lookup %lld us, query %lld us",
+             (unsigned long)stats.lookups, (unsigned long)stats.hits, stats.hit_rate * 100.0f,
+             (unsigned long)stats.evictions, (long long)stats.avg_lookup_us, (long long)stats.avg_query_us);
+    if (mismatches > 0 || stats.hits == 0) {
+        ESP_LOGE(TAG, "Identity cache test FAILED: %d hits disagree with the database.", mismatches);
+        return;
+    }
+    ESP_LOGI(TAG, "Identity cache diagnostics PASSED.");
+}
+
+void diagnostics_print_identity_cache_stats(void) {
+    identity_cache_stats_t stats;
+    identity_cache_get_stats(&stats);
+    ESP_LOGI(TAG, "Identity cache: %lu lookups, hit rate %.1f%%, %lu evictions (%lu camera slots), lookup %lld us, "
+             "query %lld us, saved %lld ms",
+             (unsigned long)stats.lookups, stats.hit_rate * 100.0f, (unsigned long)stats.evictions,
+             (unsigned long)stats.camera_evictions, (long long)stats.avg_lookup_us, (long long)stats.avg_query_us, (long long)(stats.saved_us / 1000));
+}
+
+void diagnostics_print_face_upload_stats(void) {
+    face_upload_stats_t stats;
+    face_upload_get_stats(&stats);
+    ESP_LOGI(TAG, "Face upload: %lu done, %lu failed, %lu dropped, %lu retries, %lu chunks, latency avg %lld ms max %lld ms, %.1f KB/s",
+             (unsigned long)stats.completed, (unsigned long)stats.failed, (unsigned long)stats.dropped,
+             (unsigned long)stats.retries, (unsigned long)stats.chunks, (long long)(stats.avg_latency_us / 1000),
+             (long long)(stats.max_latency_us / 1000), stats.avg_kbps);
+    ESP_LOGI(TAG, "Face upload: %llu bytes, %lu image requests, %lu images sent, %lu misses, %lu held",
+             (unsigned long long)stats.bytes, (unsigned long)stats.requests, (unsigned long)stats.images_sent,
+             (unsigned long)stats.request_misses, (unsigned long)stats.held);
+}
+
+void diagnostics_print_unknown_cluster_stats(void) {
+    unknown_cluster_stats_t stats;
+    unknown_cluster_get_stats(&stats);
+    face_upload_stats_t upload;
+    face_upload_get_stats(&upload);
+    ESP_LOGI(TAG, "Unknown faces: %lu seen, %lu uploaded (%.1f%%), %lu clusters (%lu now), %lu expired, %lu evicted, %lu sighting reports",
+             (unsigned long)stats.faces, (unsigned long)stats.uploads,
+             stats.faces ? stats.uploads * 100.0f / stats.faces : 0.0f, (unsigned long)stats.clusters,
+             (unsigned long)stats.active, (unsigned long)stats.expired, (unsigned long)stats.evicted,
+             (unsigned long)upload.sightings);
+}
+
+void diagnostics_print_cloud_identity_stats(void) {
+    cloud_identity_stats_t stats;
+    cloud_identity_get_stats(&stats);
+    ESP_LOGI(TAG, "Cloud identities: %lu received, %lu stored (%lu now), %lu refreshed, %lu evicted, %lu expired, %lu invalid",
+             (unsigned long)stats.received, (unsigned long)stats.stored, (unsigned long)stats.entries,
+             (unsigned long)stats.refreshed, (unsigned long)stats.evicted, (unsigned long)stats.expired,
+             (unsigned long)stats.invalid);
+    // Rising local hit rate = fewer faces going to the cloud
+    char history[CLOUD_IDENTITY_HISTORY * 6 + 1] = "";
+    int pos = 0;
+    for (int i = 0; i < stats.windows; i++) {
+        pos += snprintf(history + pos, sizeof(history) - pos, " %.0f%%", stats.window_hit_rate[i] * 100.0f);
+    }
+    ESP_LOGI(TAG, "Local hit rate %.1f%% of %lu faces (%lu from the cloud), per %d min:%s",
+             stats.hit_rate * 100.0f, (unsigned long)stats.faces, (unsigned long)stats.writeback_hits,
+             CLOUD_IDENTITY_WINDOW_MS / 60000, stats.windows ? history : " -");
+}
+
+void diagnostics_print_latency_trace_stats(void) {
+    int count = latency_trace_interval_count();
+    latency_trace_interval_t *stats = malloc(count * sizeof(latency_trace_interval_t));
+    latency_trace_counters_t counters;
+    if (!stats || !latency_trace_get_stats(stats, &counters)) {
+        free(stats);
+        return;
+    }
+    ESP_LOGI(TAG, "Latency trace: %lu frames, %lu events lost, %lu frames abandoned", (unsigned long)counters.traces,
+             (unsigned long)counters.lost, (unsigned long)counters.abandoned);
+    for (int i = 0; i < count; i++) {
+        if (stats[i].count > 0) {
+            ESP_LOGI(TAG, "  %-14s n=%-5lu p50 %6.1f ms  p95 %6.1f ms  p99 %6.1f ms  max %6.1f ms  mean %6.1f ms",
+                     stats[i].name, (unsigned long)stats[i].count, stats[i].p50_us / 1000.0f,
+                     stats[i].p95_us / 1000.0f, stats[i].p99_us / 1000.0f, stats[i].max_us / 1000.0f,
+                     stats[i].mean_us / 1000.0f);
+        }
+    }
+    free(stats);
+}
@@ -24,4 +24,51 @@ void diagnostics_run_storage_test(void);
  */
 void diagnostics_run_database_test(void);
 
+/**
+ * @brief Face database load/lookup benchmark.
+ *
+ * Builds a scratch database of num_records synthetic faces, then times
+ * the insert, the reload (boot load) and id lookups. The real database
+ * is closed during the run and re-initialized afterwards.
+ *
+ * @param num_records Number of synthetic records (e.g. 10000).
+ */
+void diagnostics_run_database_benchmark(int num_records);
+
+/**
+ * @brief Identity cache test on a replayed embedding stream.
+ *
+ * Replays synthetic crops (regulars in runs, some strangers) from two
+ * cameras and checks that every cache hit gives the same id as a full
+ * database scan. Logs the hit rate.
+ *
+ * @note Re-initializes the identity cache, run it before image processing starts.
+ */
+void diagnostics_run_identity_cache_test(void);
+
+/**
+ * @brief Logs the identity cache hit rate and the query time it saved.
+ */
+void diagnostics_print_identity_cache_stats(void);
+
+/**
+ * @brief Logs the cloud upload counters, latency and throughput.
+ */
+void diagnostics_print_face_upload_stats(void);
+
+/**
+ * @brief Logs the unknown-face clusters and the share of unknown faces uploaded.
+ */
+void diagnostics_print_unknown_cluster_stats(void);
+
+/**
+ * @brief Logs the identities written back from the cloud and the local hit rate per window.
+ */
+void diagnostics_print_cloud_identity_stats(void);
+
+/**
+ * @brief Logs the latency of each stage of the traced frames: p50/p95/p99, max and mean.
+ */
+void diagnostics_print_latency_trace_stats(void);
+
 #endif // APP_DIAGNOSTICS_H
\ No newline at end of file
@@ -0,0 +1,427 @@
+/**
+ * @file binlog.c
+ * @brief Deferred binary log: raw records in per-core lock-free rings, drained in time order as base64 lines.
+ */
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "binlog.h"
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#define CORES portNUM_PROCESSORS
+#else
+#include <time.h>
+#define CORES 1
+#endif
+
+#define RECORD_WORDS (BINLOG_HEADER_WORDS + BINLOG_MAX_ARG_WORDS)
+#define LINE_RECORD_BYTES 384 // record bytes per line at most, 512 characters of base64
+#define STRING_MAX 127        // length byte, bit 7 is the truncated flag
+
+// Words are 32-bit atomics, accessed relaxed (plain loads and stores): seq tells if they are whole
+typedef struct {
+    atomic_uint seq;      // ring index + 1 once written, 0 while being written
+    atomic_uint words[RECORD_WORDS];
+} slot_t;
+
+typedef struct {
+    slot_t *slots;
+    atomic_uint head;     // next index to write
+    uint32_t tail;        // next index to drain
+    uint32_t lost;        // overwritten before drained, not reported yet
+    bool pending;         // record holds the next record of the ring
+    uint32_t record[RECORD_WORDS];
+} ring_t;
+
+static struct {
+    ring_t rings[CORES];
+    uint32_t mask;
+    uint32_t burst;
+    uint32_t window_ms;
+    atomic_flag busy;     // a task is draining
+} s_log = { .busy = ATOMIC_FLAG_INIT };
+
+static int64_t now_us(void) {
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static int core_id(void) {
+#ifdef ESP_PLATFORM
+    return (int)xPortGetCoreID(); // a task moved to the other core meanwhile still writes safely, rings are multi-producer
+#else
+    return 0;
+#endif
+}
+
+// Not initialized: formatted now, as ESP_LOGx would
+static void write_text(binlog_level_t level, const char *tag, const char *fmt, va_list ap) {
+    char msg[192];
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    char letter = level >= BINLOG_ERROR && level <= BINLOG_DEBUG ? "?EWID"[level] : '?';
+#ifdef ESP_PLATFORM
+    esp_log_write((esp_log_level_t)level, tag, "%c (%lu) %s: %s\n", letter, (unsigned long)esp_log_timestamp(), tag, msg);
+#else
+    fprintf(stderr, "%c %s: %s\n", letter, tag, msg);
+#endif
+}
+
+// Sites are shared by the tasks running the same line: GCC atomics on the plain fields of the public struct
+static bool rate_allow(binlog_site_t *site, uint32_t now_ms, uint32_t *suppressed) {
+    if (s_log.burst == 0) {
+        return true;
+    }
+    uint32_t start = __atomic_load_n(&site->window_start_ms, __ATOMIC_RELAXED);
+    if (now_ms - start >= s_log.window_ms &&
+        __atomic_compare_exchange_n(&site->window_start_ms, &start, now_ms, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+    }
+    if (__atomic_fetch_add(&site->count, 1, __ATOMIC_RELAXED) < s_log.burst) {
+        *suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+        return true;
+    }
+    __atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+typedef struct {
+    uint8_t *bytes;
+    size_t used;
+    bool full;
+} arg_writer_t;
+
+static void put32(arg_writer_t *w, uint32_t v) {
+    if (w->full || w->used + 4 > BINLOG_MAX_ARG_WORDS * 4) {
+        w->full = true;
+        return;
+    }
+    memcpy(w->bytes + w->used, &v, 4);
+    w->used += 4;
+}
+
+static void put64(arg_writer_t *w, uint64_t v) {
+    if (w->used + 8 > BINLOG_MAX_ARG_WORDS * 4) {
+        w->full = true;
+    }
+    put32(w, (uint32_t)v);
+    put32(w, (uint32_t)(v >> 32));
+}
+
+static void put_string(arg_writer_t *w, const char *s, int precision) {
+    if (w->full || w->used + 4 > BINLOG_MAX_ARG_WORDS * 4) {
+        w->full = true;
+        return;
+    }
+    if (!s) {
+        s = "(null)";
+    }
+    size_t room = BINLOG_MAX_ARG_WORDS * 4 - w->used - 1;
+    size_t limit = precision >= 0 && (size_t)precision < room ? (size_t)precision : room;
+    if (limit > STRING_MAX) {
+        limit = STRING_MAX;
+    }
+    size_t n = strnlen(s, limit); // %.*s strings need no terminating 0
+    bool truncated = n == limit && limit != (size_t)precision && s[limit] != '\0';
+    w->bytes[w->used] = (uint8_t)(n | (truncated ? 0x80 : 0));
+    memcpy(w->bytes + w->used + 1, s, n);
+    size_t padded = (1 + n + 3) & ~(size_t)3;
+    memset(w->bytes + w->used + 1 + n, 0, padded - 1 - n);
+    w->used += padded;
+}
+
+static int parse_number(const char **p) {
+    int v = 0;
+    while (**p >= '0' && **p <= '9') {
+        v = v * 10 + (*(*p)++ - '0');
+    }
+    return v;
+}
+
+// The arguments as the decoder reads them back along the same format
+static int encode_args(uint32_t *words, const char *fmt, va_list ap) {
+    arg_writer_t w = { (uint8_t *)words, 0, false };
+    for (const char *p = fmt; *p && !w.full; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        p++;
+        if (*p == '%') {
+            continue;
+        }
+        while (*p && strchr("-+ #0", *p)) {
+            p++;
+        }
+        if (*p == '*') {
+            put32(&w, (uint32_t)va_arg(ap, int));
+            p++;
+        } else {
+            parse_number(&p);
+        }
+        int precision = -1;
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                precision = va_arg(ap, int);
+                put32(&w, (uint32_t)precision);
+                p++;
+            } else {
+                precision = parse_number(&p);
+            }
+        }
+        char length = 0; // 'H' hh, 'L' ll
+        if (*p == 'h' || *p == 'l') {
+            length = *p++;
+            if (*p == length) {
+                length = length == 'h' ? 'H' : 'L';
+                p++;
+            }
+        } else if (*p == 'j' || *p == 'z' || *p == 't') {
+            length = *p++;
+        }
+        switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            if (length == 'L' || length == 'j') {
+                put64(&w, (uint64_t)va_arg(ap, long long));
+            } else if (length == 'l') {
+                put32(&w, (uint32_t)va_arg(ap, long));
+            } else if (length == 'z' || length == 't') {
+                put32(&w, (uint32_t)va_arg(ap, size_t));
+            } else {
+                put32(&w, (uint32_t)va_arg(ap, int));
+            }
+            break;
+        case 'p':
+            put32(&w, (uint32_t)(uintptr_t)va_arg(ap, void *));
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            double d = va_arg(ap, double);
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            put64(&w, bits);
+            break;
+        }
+        case 's':
+            put_string(&w, va_arg(ap, const char *), precision);
+            break;
+        case '\0':
+            return (int)(w.used / 4);
+        default:
+            break; // not supported, no argument taken
+        }
+    }
+    return (int)(w.used / 4);
+}
+
+bool binlog_init(const binlog_config_t *config) {
+    binlog_deinit();
+    int records = config->records;
+    if (records <= 0 || (records & (records - 1)) != 0) {
+        return false;
+    }
+    for (int core = 0; core < CORES; core++) {
+        ring_t *ring = &s_log.rings[core];
+        ring->slots = calloc(records, sizeof(slot_t));
+        if (!ring->slots) {
+            binlog_deinit();
+            return false;
+        }
+        atomic_store(&ring->head, 0);
+    }
+    s_log.mask = (uint32_t)records - 1;
+    s_log.burst = config->burst > 0 ? (uint32_t)config->burst : 0;
+    s_log.window_ms = config->window_ms > 0 ? (uint32_t)config->window_ms : 1000;
+    return true;
+}
+
+void binlog_deinit(void) {
+    for (int core = 0; core < CORES; core++) {
+        free(s_log.rings[core].slots);
+        memset(&s_log.rings[core], 0, sizeof(ring_t));
+    }
+}
+
+void binlog_write(binlog_site_t *site, binlog_level_t level, const char *tag, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    if (!s_log.rings[0].slots) {
+        write_text(level, tag, fmt, ap);
+        va_end(ap);
+        return;
+    }
+    int64_t t_us = now_us();
+    uint32_t suppressed = 0;
+    if (site && !rate_allow(site, (uint32_t)(t_us / 1000), &suppressed)) {
+        va_end(ap);
+        return;
+    }
+    uint32_t args[BINLOG_MAX_ARG_WORDS];
+    int arg_words = encode_args(args, fmt, ap);
+    va_end(ap);
+
+    int core = core_id();
+    uint32_t header[BINLOG_HEADER_WORDS] = {
+        (uint32_t)(uintptr_t)fmt,
+        (uint32_t)(uintptr_t)tag,
+        (uint32_t)t_us,
+        (uint32_t)((uint64_t)t_us >> 32),
+        (uint32_t)level | (uint32_t)core << 4 | (uint32_t)arg_words << 8 | (suppressed > 0xFFFF ? 0xFFFF : suppressed) << 16,
+    };
+    ring_t *ring = &s_log.rings[core];
+    uint32_t index = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+    slot_t *slot = &ring->slots[index & s_log.mask];
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int i = 0; i < BINLOG_HEADER_WORDS; i++) {
+        atomic_store_explicit(&slot->words[i], header[i], memory_order_relaxed);
+    }
+    for (int i = 0; i < arg_words; i++) {
+        atomic_store_explicit(&slot->words[BINLOG_HEADER_WORDS + i], args[i], memory_order_relaxed);
+    }
+    atomic_store_explicit(&slot->seq, index + 1, memory_order_release);
+}
+
+// Next whole record of the ring into ring->record, false if there is none yet
+static bool ring_peek(ring_t *ring) {
+    if (ring->pending) {
+        return true;
+    }
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t size = s_log.mask + 1;
+    if (head - ring->tail > size) {
+        ring->lost += head - ring->tail - size;
+        ring->tail = head - size;
+    }
+    while (ring->tail != head) {
+        slot_t *slot = &ring->slots[ring->tail & s_log.mask];
+        uint32_t expected = ring->tail + 1;
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != expected) {
+            if (seq != 0 && (int32_t)(seq - expected) > 0) {
+                ring->lost++; // overwritten by a later lap
+                ring->tail++;
+                continue;
+            }
+            return false; // still being written, next time
+        }
+        for (int i = 0; i < RECORD_WORDS; i++) {
+            ring->record[i] = atomic_load_explicit(&slot->words[i], memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        bool whole = atomic_load_explicit(&slot->seq, memory_order_relaxed) == expected;
+        ring->tail++;
+        if (whole) {
+            ring->pending = true;
+            return true;
+        }
+        ring->lost++; // overwritten while read
+    }
+    return false;
+}
+
+static size_t base64_encode(char *out, const uint8_t *in, size_t n) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < n; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < n ? (uint32_t)in[i + 1] << 8 : 0) | (i + 2 < n ? in[i + 2] : 0);
+        out[o++] = digits[v >> 18 & 63];
+        out[o++] = digits[v >> 12 & 63];
+        out[o++] = i + 1 < n ? digits[v >> 6 & 63] : '=';
+        out[o++] = i + 2 < n ? digits[v & 63] : '=';
+    }
+    return o;
+}
+
+size_t binlog_read_line(char *line, size_t len) {
+    const size_t prefix = sizeof(BINLOG_LINE_PREFIX) - 1;
+    if (!s_log.rings[0].slots || len < prefix + 3) {
+        return 0;
+    }
+    size_t capacity = (len - prefix - 2) / 4 * 3; // '\n' and the terminating 0
+    if (capacity > LINE_RECORD_BYTES) {
+        capacity = LINE_RECORD_BYTES;
+    }
+    if (atomic_flag_test_and_set_explicit(&s_log.busy, memory_order_acquire)) {
+        return 0;
+    }
+    uint8_t bytes[LINE_RECORD_BYTES];
+    size_t used = 0;
+    while (true) {
+        // Losses first, then the oldest record of all the rings
+        ring_t *next = NULL;
+        int lost_core = -1;
+        for (int core = 0; core < CORES && lost_core < 0; core++) {
+            ring_t *ring = &s_log.rings[core];
+            if (ring_peek(ring) || ring->lost) {
+                if (ring->lost) {
+                    lost_core = core;
+                } else if (!next || (int64_t)((uint64_t)ring->record[3] << 32 | ring->record[2]) <
+                                        (int64_t)((uint64_t)next->record[3] << 32 | next->record[2])) {
+                    next = ring;
+                }
+            }
+        }
+        if (lost_core >= 0) {
+            ring_t *ring = &s_log.rings[lost_core];
+            int64_t t_us = ring->pending ? (int64_t)((uint64_t)ring->record[3] << 32 | ring->record[2]) : now_us();
+            uint32_t marker[BINLOG_HEADER_WORDS + 1] = {
+                0, 0, (uint32_t)t_us, (uint32_t)((uint64_t)t_us >> 32), BINLOG_WARN | (uint32_t)lost_core << 4 | 1 << 8,
+                ring->lost,
+            };
+            if (used + sizeof(marker) > capacity) {
+                break;
+            }
+            memcpy(bytes + used, marker, sizeof(marker));
+            used += sizeof(marker);
+            ring->lost = 0;
+            continue;
+        }
+        if (!next) {
+            break;
+        }
+        size_t size = (BINLOG_HEADER_WORDS + (next->record[4] >> 8 & 0xFF)) * 4;
+        if (used + size > capacity) {
+            break;
+        }
+        memcpy(bytes + used, next->record, size);
+        used += size;
+        next->pending = false;
+    }
+    atomic_flag_clear_explicit(&s_log.busy, memory_order_release);
+    if (used == 0) {
+        return 0;
+    }
+    memcpy(line, BINLOG_LINE_PREFIX, prefix);
+    size_t n = prefix + base64_encode(line + prefix, bytes, used);
+    line[n++] = '\n';
+    line[n] = '\0';
+    return n;
+}
+
+#ifdef ESP_PLATFORM
+static void console_task(void *arg) {
+    const TickType_t period = pdMS_TO_TICKS((int)(intptr_t)arg);
+    char line[sizeof(BINLOG_LINE_PREFIX) + LINE_RECORD_BYTES / 3 * 4 + 2];
+    while (true) {
+        while (binlog_read_line(line, sizeof(line)) > 0) {
+            fputs(line, stdout);
+        }
+        vTaskDelay(period);
+    }
+}
+
+bool binlog_start_console_task(int period_ms, int priority) {
+    return xTaskCreate(console_task, "binlog", 3072, (void *)(intptr_t)period_ms, priority, NULL) == pdPASS;
+}
+#endif
@@ -0,0 +1,114 @@
+/**
+ * @file binlog.h
+ * @brief Deferred binary log of the hot paths, formatted on the host from the firmware ELF.
+ *
+ * BINLOGI(TAG, "Got frame_start for ID: %d", id) does not format the
+ * message: it writes the address of the format string, the address of the
+ * tag, the time and the raw arguments (strings copied, truncated) as one
+ * record into a lock-free ring of the core it runs on. A low priority task
+ * drains the rings in time order and prints the records as base64 lines
+ * ("BL:..."), between the normal log lines. cloud-tier binlog_decode finds
+ * the format strings and tags in the ELF of the firmware and prints the
+ * messages as ESP_LOGx would.
+ *
+ * Each call site has a rate limit: more than `burst` messages in a window
+ * are dropped and counted, the next message kept carries the count.
+ * Before binlog_init() (or without it) the messages go through esp_log.
+ *
+ * The format must be a string literal. Conversions: d i u x X o c p s f e g
+ * a with flags, width and precision (also *), length hh h l ll j z t; l, z
+ * and t are 32 bits on the target, as the decoder reads them.
+ */
+
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    BINLOG_ERROR = 1, // same values as esp_log_level_t
+    BINLOG_WARN,
+    BINLOG_INFO,
+    BINLOG_DEBUG,
+} binlog_level_t;
+
+typedef struct {
+    int records;   // per core, a power of 2
+    int burst;     // messages of one call site per window, 0: no rate limit
+    int window_ms;
+} binlog_config_t;
+
+// Rate limit state of a call site, a static of BINLOG()
+typedef struct {
+    uint32_t window_start_ms;
+    uint32_t count;
+    uint32_t suppressed;
+} binlog_site_t;
+
+/*
+ * Record as binlog_read_line() encodes it, little endian 32-bit words:
+ *   fmt   address of the format string, 0 for a lost marker (args[0]: records lost)
+ *   tag   address of the tag
+ *   t_lo, t_hi  time, us since boot
+ *   info  level | core << 4 | arg words << 8 | suppressed before this one << 16
+ *   args  one word per integer (two for ll and j), two per double, strings as a
+ *         length byte (bit 7: truncated) and the bytes, padded to a word
+ */
+#define BINLOG_HEADER_WORDS 5
+#define BINLOG_MAX_ARG_WORDS 10
+#define BINLOG_LINE_PREFIX "BL:"
+
+#define BINLOG(level, tag, fmt, ...)                                       \
+    do {                                                                   \
+        static binlog_site_t binlog_site_;                                 \
+        binlog_write(&binlog_site_, level, tag, fmt, ##__VA_ARGS__);       \
+    } while (0)
+#define BINLOGE(tag, fmt, ...) BINLOG(BINLOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define BINLOGW(tag, fmt, ...) BINLOG(BINLOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define BINLOGI(tag, fmt, ...) BINLOG(BINLOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define BINLOGD(tag, fmt, ...) BINLOG(BINLOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+
+/**
+ * @brief Allocates one ring per core. Messages written from now on are deferred.
+ */
+bool binlog_init(const binlog_config_t *config);
+
+/**
+ * @brief Frees the rings, later messages go through esp_log. No task may be writing.
+ */
+void binlog_deinit(void);
+
+/**
+ * @brief Records a message, use BINLOGx(). Lock-free, from any task (not from an ISR).
+ *
+ * @param site Rate limit state, NULL for none.
+ */
+void binlog_write(binlog_site_t *site, binlog_level_t level, const char *tag, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/**
+ * @brief Drains the oldest records into one line: BINLOG_LINE_PREFIX, base64, '\n'.
+ *
+ * @return Length of the line (without the terminating 0), 0 if there is nothing to drain,
+ *         the line is too short for a record or another task is draining.
+ */
+size_t binlog_read_line(char *line, size_t len);
+
+#ifdef ESP_PLATFORM
+/**
+ * @brief Starts the task printing the records to the console every period_ms.
+ */
+bool binlog_start_console_task(int period_ms, int priority);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BINLOG_H
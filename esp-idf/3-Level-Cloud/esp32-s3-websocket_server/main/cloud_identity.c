@@ -0,0 +1,228 @@
+/**
+ * @file cloud_identity.c
+ * @brief Identities from the cloud tier: downlink queue, TTL/capacity table, hit rate.
+ *
+ * The table is a fixed array of CLOUD_IDENTITY_CAPACITY entries, a linear
+ * scan is cheaper than the embedding enroll it goes with.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "mqtt.h"
+#include "face_upload_proto.h"
+#include "cloud_identity.h"
+
+static const char* TAG = "CLOUD_ID";
+
+typedef struct {
+    int local_id;         // recognition database id, -1 when free
+    int cloud_id;
+    int64_t expires_us;
+    int64_t last_seen_us; // stored or recognized, for the eviction
+} writeback_entry_t;
+
+static struct {
+    QueueHandle_t queue;  // cloud_identity_t, filled by the MQTT task
+    writeback_entry_t entries[CLOUD_IDENTITY_CAPACITY];
+
+    // hit rate, current window and history ring
+    int64_t window_start_us;
+    uint32_t window_faces;
+    uint32_t window_hits;
+    float history[CLOUD_IDENTITY_HISTORY];
+    int history_pos;
+    int history_count;
+
+    cloud_identity_stats_t stats;
+} s_identity;
+
+static void copy_str(char* dst, size_t size, const char* src, size_t len) {
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+// MQTT task: identity message from the cloud, decoded and handed to the image processor
+static void on_data(const char* topic, int topic_len, const char* data, int data_len, int offset, int total_len) {
+    if (topic_len != (int)strlen(CLOUD_IDENTITY_TOPIC) || strncmp(topic, CLOUD_IDENTITY_TOPIC, topic_len) != 0) {
+        return;
+    }
+    face_upload_identity_t msg;
+    if (offset != 0 || data_len != total_len ||
+        !face_upload_parse_identity((const uint8_t*)data, data_len, &msg) || msg.feat_len == 0) {
+        // Bigger than the MQTT buffer is fragmented: the cloud sends int8 embeddings
+        ESP_LOGW(TAG, "Invalid identity message (%d of %d bytes)", data_len, total_len);
+        s_identity.stats.invalid++;
+        return;
+    }
+    cloud_identity_t identity = {
+        .ref_id = msg.ref_id,
+        .cloud_id = msg.face_id,
+        .ttl_s = msg.ttl_s,
+        .access_level = msg.access_level,
+        .feat_len = msg.feat_len,
+        .feat = malloc(msg.feat_len * sizeof(float)),
+    };
+    if (!identity.feat) {
+        s_identity.stats.invalid++;
+        return;
+    }
+    face_upload_decode_feat(msg.feat_type, msg.feat_len, msg.feat, identity.feat);
+    copy_str(identity.name, sizeof(identity.name), msg.name, msg.name_len);
+    copy_str(identity.title, sizeof(identity.title), msg.title, msg.title_len);
+    if (xQueueSend(s_identity.queue, &identity, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Identity queue full, cloud id %d dropped", identity.cloud_id);
+        free(identity.feat);
+        s_identity.stats.invalid++;
+        return;
+    }
+    s_identity.stats.received++;
+}
+
+esp_err_t cloud_identity_init(esp_mqtt_client_handle_t client) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_identity.queue) {
+        return ESP_OK;
+    }
+    s_identity.queue = xQueueCreate(CLOUD_IDENTITY_QUEUE_LEN, sizeof(cloud_identity_t));
+    if (!s_identity.queue) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < CLOUD_IDENTITY_CAPACITY; i++) {
+        s_identity.entries[i].local_id = -1;
+    }
+    s_identity.window_start_us = esp_timer_get_time();
+    if (mqtt_register_data_callback(on_data) != ESP_OK || mqtt_subscribe(client, CLOUD_IDENTITY_TOPIC, 1) != ESP_OK) {
+        ESP_LOGE(TAG, "No MQTT slot for the identities");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Cloud identities on %s, up to %d written back", CLOUD_IDENTITY_TOPIC, CLOUD_IDENTITY_CAPACITY);
+    return ESP_OK;
+}
+
+bool cloud_identity_receive(cloud_identity_t* out) {
+    return s_identity.queue && xQueueReceive(s_identity.queue, out, 0) == pdTRUE;
+}
+
+void cloud_identity_release(cloud_identity_t* identity) {
+    free(identity->feat);
+    identity->feat = NULL;
+}
+
+static int64_t expiry(uint32_t ttl_s) {
+    return esp_timer_get_time() + (int64_t)(ttl_s ? ttl_s : CLOUD_IDENTITY_TTL_S) * 1000000;
+}
+
+int cloud_identity_find(int cloud_id, uint32_t ttl_s) {
+    for (int i = 0; i < CLOUD_IDENTITY_CAPACITY; i++) {
+        writeback_entry_t* e = &s_identity.entries[i];
+        if (e->local_id >= 0 && e->cloud_id == cloud_id) {
+            e->expires_us = expiry(ttl_s);
+            s_identity.stats.refreshed++;
+            return e->local_id;
+        }
+    }
+    return -1;
+}
+
+int cloud_identity_track(int local_id, int cloud_id, uint32_t ttl_s) {
+    // A free entry, else the one seen least recently
+    writeback_entry_t* slot = &s_identity.entries[0];
+    for (int i = 0; i < CLOUD_IDENTITY_CAPACITY; i++) {
+        writeback_entry_t* e = &s_identity.entries[i];
+        if (e->local_id < 0) {
+            slot = e;
+            break;
+        }
+        if (e->last_seen_us < slot->last_seen_us) {
+            slot = e;
+        }
+    }
+    int evicted = slot->local_id;
+    if (evicted >= 0) {
+        s_identity.stats.evicted++;
+        s_identity.stats.entries--;
+    }
+    slot->local_id = local_id;
+    slot->cloud_id = cloud_id;
+    slot->expires_us = expiry(ttl_s);
+    slot->last_seen_us = esp_timer_get_time();
+    s_identity.stats.stored++;
+    s_identity.stats.entries++;
+    return evicted;
+}
+
+int cloud_identity_pop_expired(void) {
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < CLOUD_IDENTITY_CAPACITY; i++) {
+        writeback_entry_t* e = &s_identity.entries[i];
+        if (e->local_id >= 0 && now >= e->expires_us) {
+            int local_id = e->local_id;
+            e->local_id = -1;
+            s_identity.stats.expired++;
+            s_identity.stats.entries--;
+            return local_id;
+        }
+    }
+    return -1;
+}
+
+int cloud_identity_metadata_id(int local_id) {
+    for (int i = 0; local_id >= 0 && i < CLOUD_IDENTITY_CAPACITY; i++) {
+        if (s_identity.entries[i].local_id == local_id) {
+            return CLOUD_IDENTITY_ID_BASE + local_id;
+        }
+    }
+    return local_id;
+}
+
+void cloud_identity_record(int face_id) {
+    int64_t now = esp_timer_get_time();
+    if (now - s_identity.window_start_us >= (int64_t)CLOUD_IDENTITY_WINDOW_MS * 1000) {
+        if (s_identity.window_faces > 0) {
+            s_identity.history[s_identity.history_pos] = (float)s_identity.window_hits / s_identity.window_faces;
+            s_identity.history_pos = (s_identity.history_pos + 1) % CLOUD_IDENTITY_HISTORY;
+            if (s_identity.history_count < CLOUD_IDENTITY_HISTORY) {
+                s_identity.history_count++;
+            }
+        }
+        s_identity.window_start_us = now;
+        s_identity.window_faces = 0;
+        s_identity.window_hits = 0;
+    }
+    s_identity.stats.faces++;
+    s_identity.window_faces++;
+    if (face_id < 0) {
+        return;
+    }
+    s_identity.stats.local_hits++;
+    s_identity.window_hits++;
+    for (int i = 0; i < CLOUD_IDENTITY_CAPACITY; i++) {
+        if (s_identity.entries[i].local_id == face_id) {
+            s_identity.entries[i].last_seen_us = now;
+            s_identity.stats.writeback_hits++;
+            break;
+        }
+    }
+}
+
+void cloud_identity_get_stats(cloud_identity_stats_t* out) {
+    if (!out) {
+        return;
+    }
+    *out = s_identity.stats;
+    out->hit_rate = out->faces ? (float)out->local_hits / out->faces : 0.0f;
+    out->windows = s_identity.history_count;
+    int first = (s_identity.history_pos - s_identity.history_count + CLOUD_IDENTITY_HISTORY) % CLOUD_IDENTITY_HISTORY;
+    for (int i = 0; i < s_identity.history_count; i++) {
+        out->window_hit_rate[i] = s_identity.history[(first + i) % CLOUD_IDENTITY_HISTORY];
+    }
+}
@@ -0,0 +1,122 @@
+/**
+ * @file cloud_identity.h
+ * @brief Write-back of the identities the cloud tier found for uploaded faces.
+ *
+ * An unknown face goes to the cloud (face_upload.h). When the cloud knows
+ * it, it answers on CLOUD_IDENTITY_TOPIC with the identity and an embedding
+ * (face_upload_proto.h identity message). The image processor enrolls the
+ * embedding in the recognition database and stores the name in the face
+ * metadata database, so the next pass of that person is recognized on the
+ * S3 and nothing is uploaded.
+ *
+ * Written-back faces are bounded: each one has a TTL (given by the cloud,
+ * or CLOUD_IDENTITY_TTL_S), and when CLOUD_IDENTITY_CAPACITY are stored the
+ * least recently seen one makes room. The table is in RAM only, the image
+ * processor purges the leftovers of a previous boot (status "cloud").
+ *
+ * The metadata of a written-back face is stored under
+ * CLOUD_IDENTITY_ID_BASE + its recognition id, never under the recognition
+ * id itself: that one may be the id of a face of faces.json.
+ *
+ * @note Except cloud_identity_get_stats(), call it from the image
+ *       processing task only. Messages are received in the MQTT task and
+ *       handed over through a queue.
+ */
+
+#ifndef CLOUD_IDENTITY_H
+#define CLOUD_IDENTITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CLOUD_IDENTITY_STATUS "cloud" // face_info_t status of written-back faces
+#define CLOUD_IDENTITY_ID_BASE 0x10000 // metadata id = this + recognition id, above every 16-bit recognition id
+
+// A received identity, the embedding decoded to floats
+typedef struct {
+    uint32_t ref_id;      // upload the cloud answered
+    int cloud_id;
+    uint32_t ttl_s;
+    int access_level;
+    char name[64];
+    char title[64];
+    int feat_len;
+    float* feat;
+} cloud_identity_t;
+
+typedef struct {
+    uint32_t received;    // identity messages accepted
+    uint32_t invalid;     // messages not parsed, fragmented or dropped (queue full)
+    uint32_t stored;      // identities written back
+    uint32_t refreshed;   // identity already stored, TTL renewed
+    uint32_t evicted;     // removed to make room
+    uint32_t expired;     // removed at the end of their TTL
+    uint32_t entries;     // written-back faces right now
+    uint32_t faces;       // faces seen by the recognizer
+    uint32_t local_hits;  // recognized on the S3 (no upload)
+    uint32_t writeback_hits; // of which thanks to a written-back identity
+    float hit_rate;       // local_hits / faces, since boot
+    float window_hit_rate[CLOUD_IDENTITY_HISTORY]; // oldest first
+    int windows;          // valid entries in window_hit_rate
+} cloud_identity_stats_t;
+
+/**
+ * @brief Subscribes to CLOUD_IDENTITY_TOPIC and starts queueing the identities received.
+ */
+esp_err_t cloud_identity_init(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Takes the next received identity, does not block.
+ * @return false if none is waiting. Release the identity with cloud_identity_release().
+ */
+bool cloud_identity_receive(cloud_identity_t* out);
+
+void cloud_identity_release(cloud_identity_t* identity);
+
+/**
+ * @brief Local id already holding a cloud identity, -1 if none. Renews its TTL.
+ */
+int cloud_identity_find(int cloud_id, uint32_t ttl_s);
+
+/**
+ * @brief Records a written-back face.
+ *
+ * @param local_id Id the recognition database gave the embedding.
+ * @param cloud_id Id of the cloud.
+ * @param ttl_s Lifetime, 0 for CLOUD_IDENTITY_TTL_S.
+ * @return Local id evicted to make room (delete it from the databases), -1 if none.
+ */
+int cloud_identity_track(int local_id, int cloud_id, uint32_t ttl_s);
+
+/**
+ * @brief Removes one written-back face whose TTL is over.
+ * @return Its local id (delete it from the databases), -1 if none expired.
+ */
+int cloud_identity_pop_expired(void);
+
+/**
+ * @brief Metadata id of a recognition id.
+ * @return CLOUD_IDENTITY_ID_BASE + local_id for a written-back face, local_id otherwise.
+ */
+int cloud_identity_metadata_id(int local_id);
+
+/**
+ * @brief Records a recognition result for the hit rate.
+ * @param face_id Recognizer result, -1 for an unknown face.
+ */
+void cloud_identity_record(int face_id);
+
+void cloud_identity_get_stats(cloud_identity_stats_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CLOUD_IDENTITY_H
@@ -14,12 +14,106 @@
 // Module enable flags
 #define MQTT_ENABLED 0
 
+// MQTT 5 (needs CONFIG_MQTT_PROTOCOL_5=y in sdkconfig): registered topics are sent as a 2-byte topic alias
+// after their first publish on a connection
+#define MQTT_V5_ENABLED 1
+#define MQTT_TOPIC_ALIAS_MAX 8 // aliases used for our topics (AWS IoT allows 8) and accepted from the broker
+
 #define WIFI_ENABLED 1
 #define WIFI_MAXIMUM_RETRY 5
 
 #define WEBSOCKET_ENABLED 1
 #define WEBSOCKET_PORT 80 
 
+#define STORAGE_ENABLED 1 // SPIFFS 'storage' partition + face metadata database
+
+#define DIAGNOSTICS_ENABLED 1
+#define DIAGNOSTICS_DB_BENCHMARK_RECORDS 0 // >0 runs the face database benchmark at boot (e.g. 10000, ~770 KB on SPIFFS)
+
+// Image kernel microbenchmarks at boot, before the models load, one line per case on the console
+#define KERNEL_BENCH_ENABLED 0
+#define KERNEL_BENCH_WARMUP 3
+#define KERNEL_BENCH_REPS 20
+#define KERNEL_BENCH_JSON_OUTPUT 0 // 1: one JSON object per line, 0: CSV
+#define KERNEL_BENCH_FILTER NULL // e.g. "resize", only kernels whose name contains it
+
+// End-to-end latency of the camera frames: stage timestamps from capture to result, p50/p95/p99 per stage.
+// Query with {"type":"trace_stats"} over the WebSocket (add "reset":true to clear), logged with the diagnostics.
+#define LATENCY_TRACE_ENABLED 1
+#define LATENCY_TRACE_RING_SIZE 256 // stage timestamps waiting to be collected, power of 2
+
+// Hot-path messages (frame transfer, MQTT publish) as binary records: format string address and raw arguments,
+// printed as base64 "BL:" lines by a low priority task, decoded with the ELF by cloud-tier binlog_decode.
+// 0: the same messages go through esp_log.
+#define BINLOG_ENABLED 1
+#define BINLOG_RECORDS 128 // per core, power of 2
+#define BINLOG_RATE_BURST 20 // messages of one line per window, the rest are counted
+#define BINLOG_RATE_WINDOW_MS 1000
+#define BINLOG_PRINT_PERIOD_MS 200
+
+// Runtime health: heap/PSRAM free, largest block and low-water marks, stack margins and CPU share per task,
+// load per core. Published to HEALTH_TELEMETRY_TOPIC/<device> (the cameras' snapshots come over the WebSocket),
+// logged when MQTT is off. Query the S3 one with {"type":"health"} over the WebSocket.
+#define HEALTH_TELEMETRY_ENABLED 1
+#define HEALTH_TELEMETRY_TOPIC MQTT_TOPIC_BASE "/health"
+#define HEALTH_TELEMETRY_PERIOD_MS 60000
+
+// Face recognition on the frames received over WebSocket
+#define FACE_RECOGNITION_ENABLED 1
+#define IMAGE_PROCESSOR_QUEUE_LEN 4 // frames queued while the models load / recognition is busy
+#define IMAGE_PROCESSOR_TASK_STACK 16384
+#define IMAGE_PROCESSOR_TASK_PRIORITY 5
+// Recognition database (embeddings) on the SPIFFS storage partition, mounted at STORAGE_BASE_PATH
+#define FACE_RECOGNITION_DB_PATH "/spiffs/face.db"
+#if FACE_RECOGNITION_ENABLED && !STORAGE_ENABLED
+#error "FACE_RECOGNITION_ENABLED needs STORAGE_ENABLED for its database"
+#endif
+
+// Detector and feature model share one activation arena (they never run at the same time)
+#define FACE_MODELS_SHARED_ARENA 1
+
+// Recent-identity cache, checked before the full face database query
+#define IDENTITY_CACHE_ENABLED 1
+#define IDENTITY_CACHE_MAX_CAMERAS 4 // camera slots, memory is allocated when a camera is first seen
+#define IDENTITY_CACHE_SIZE 8 // identities remembered per camera (LRU)
+#define IDENTITY_CACHE_TTL_MS 30000 // cached identity is re-checked against the database after this
+
+// Unknown faces (image + embedding) forwarded to the cloud tier, needs MQTT
+#define FACE_UPLOAD_ENABLED MQTT_ENABLED
+#define FACE_UPLOAD_TOPIC MQTT_TOPIC_BASE "/faces/upload"
+#define FACE_UPLOAD_CHUNK_SIZE 4096 // payload bytes per MQTT message
+#define FACE_UPLOAD_WINDOW 4 // QoS1 chunks in flight (not yet acknowledged)
+#define FACE_UPLOAD_ACK_TIMEOUT_MS 5000 // no PUBACK for this long: the upload starts over
+#define FACE_UPLOAD_RETRIES 2
+#define FACE_UPLOAD_QUEUE_LEN 2 // uploads waiting, more are dropped
+#define FACE_UPLOAD_TASK_STACK 4096
+#define FACE_UPLOAD_TASK_PRIORITY 4
+// Embedding-only: send the int8 embedding, keep the image until the cloud asks for it
+#define FACE_UPLOAD_EMBEDDING_ONLY 1
+#define FACE_UPLOAD_REQUEST_TOPIC MQTT_TOPIC_BASE "/faces/request"
+#define FACE_UPLOAD_HELD_IMAGES 2 // images kept for requests (no PSRAM), the oldest is replaced
+#define FACE_UPLOAD_HELD_TTL_MS 60000 // held image freed after this
+
+// Unknown faces clustered on the S3: one upload per stranger, later sightings sent as counts
+#define UNKNOWN_CLUSTER_ENABLED FACE_UPLOAD_ENABLED
+#define UNKNOWN_CLUSTER_TOPIC MQTT_TOPIC_BASE "/faces/sighting"
+#define UNKNOWN_CLUSTER_CAPACITY 32 // strangers remembered, 512 bytes each (int8 leader)
+#define UNKNOWN_CLUSTER_THRESHOLD 0.5f // similarity to join a cluster, same as the recognition threshold
+#define UNKNOWN_CLUSTER_HALF_LIFE_MS 600000 // cluster weight halves after this without sightings
+#define UNKNOWN_CLUSTER_MIN_WEIGHT 0.25f // forgotten below this (a single sighting: after 2 half lives)
+#define UNKNOWN_CLUSTER_BEST_MARGIN 0.2f // a face this much better than the uploaded one is uploaded too
+#define UNKNOWN_CLUSTER_MAX_UPLOADS 2 // per cluster, the first one included
+#define UNKNOWN_CLUSTER_REPORT_MS 10000 // sightings of a cluster reported at most this often
+
+// Identities the cloud found for uploaded faces, written back into the local databases, needs MQTT
+#define CLOUD_IDENTITY_ENABLED MQTT_ENABLED
+#define CLOUD_IDENTITY_TOPIC MQTT_TOPIC_BASE "/faces/identity"
+#define CLOUD_IDENTITY_CAPACITY 32 // written-back faces, the least recently seen is evicted
+#define CLOUD_IDENTITY_TTL_S 86400 // lifetime when the cloud gives none
+#define CLOUD_IDENTITY_QUEUE_LEN 4 // identities received, waiting for the image processor
+#define CLOUD_IDENTITY_WINDOW_MS 600000 // local hit rate kept per window of this length
+#define CLOUD_IDENTITY_HISTORY 6 // windows kept
+
 #define SAMPLING_INTERVAL_MS 120000  // 2 minutes for publishing interval
 
 #endif // CONFIG_H
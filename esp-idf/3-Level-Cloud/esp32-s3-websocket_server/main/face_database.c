@@ -1,150 +1,818 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "esp_log.h"
 #include "cJSON.h"
 #include "storage_manager.h"
 #include "face_database.h"
 
 static const char* TAG = "FACE_DATABASE";
-static const char* DB_PATH = "/spiffs/faces.json";
+static const char* DB_PATH = "/spiffs/faces.db";
+static const char* JSON_PATH = "/spiffs/faces.json"; // only read once, for the import
 
 // Declare symbols for the start and end of the embedded faces.json file.
 extern const uint8_t faces_json_start[] asm("_binary_faces_json_start");
 extern const uint8_t faces_json_end[]   asm("_binary_faces_json_end");
 
+/*
+ * Log layout (little endian):
+ *   header: "FDB1", u16 version, u16 reserved
+ *   entries, each starting with an opcode:
+ *     OP_STR  u16 str_id, u8 len, len bytes   (defines the next interned string)
+ *     OP_PUT  i32 id, u8 access_level, u16 str_id[FACE_FIELD_COUNT]
+ *     OP_DEL  i32 id
+ * A later PUT for the same id replaces the earlier one.
+ */
+#define DB_MAGIC "FDB1"
+#define DB_VERSION 1
+#define DB_HEADER_SIZE 8
+
+#define OP_STR 1
+#define OP_PUT 2
+#define OP_DEL 3
+
+#define PUT_SIZE (1 + 4 + 1 + 2 * FACE_FIELD_COUNT)
+#define DEL_SIZE (1 + 4)
+
+#define COMPACT_MIN_DEAD 64 // don't bother compacting small logs
+
+// Small growable byte buffer used to batch log entries into one write
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+} log_buf_t;
+
+// State before changes are staged in memory, restored if their log entries can't be written:
+// the file must never be behind the memory (later string ids would not match on replay)
+typedef struct {
+    int count;
+    int str_count;
+    size_t pool_used;
+    int dead_entries;
+    face_record_t* replaced; // records overwritten in place, in order
+    int replaced_count;
+    int replaced_capacity;
+} undo_t;
+
 // In-memory representation of the database
 static struct {
+    char* path;
+    bool fresh;            // log file was just created
+    bool log_damaged;      // a failed append left a partial entry that could not be cut off
+    int dead_entries;      // superseded entries still in the log file
+
     face_record_t* records;
     int count;
-} s_db = { .records = NULL, .count = 0 };
+    int capacity;
+    int32_t* index;        // id hash table, slot -> record index + 1 (0 = empty)
+    uint32_t index_mask;
 
+    char* pool;            // interned strings, NUL separated
+    size_t pool_used;
+    size_t pool_size;
+    uint32_t* str_offsets; // str_id -> offset in pool
+    int str_count;
+    int str_capacity;
+    uint16_t* str_index;   // string hash table, slot -> str_id + 1 (0 = empty)
+    uint32_t str_index_mask;
+} s_db;
 
-static esp_err_t create_db_from_embedded(void) {
-    ESP_LOGI(TAG, "Creating database file from embedded firmware data...");
-    const size_t json_size = faces_json_end - faces_json_start;
-    
-    char* json_data = malloc(json_size + 1);
-    if (!json_data) {
-        ESP_LOGE(TAG, "Failed to allocate memory to create embedded db file!");
-        return ESP_ERR_NO_MEM;
+static esp_err_t database_load(const char* path);
+
+/* ---------- hashing ---------- */
+
+static inline uint32_t hash_id(int32_t id) {
+    uint32_t x = (uint32_t)id;
+    x ^= x >> 16;
+    x *= 0x45d9f3bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline uint32_t hash_str(const char* s, size_t len) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
     }
-    memcpy(json_data, faces_json_start, json_size);
-    json_data[json_size] = '\0'; // Null-terminate
+    return h;
+}
 
-    esp_err_t err = storage_write_file(DB_PATH, json_data);
-    free(json_data);
+/* ---------- id index ---------- */
 
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to write embedded data to file!");
+static int index_find_slot(int32_t id) {
+    if (!s_db.index) return -1;
+    uint32_t i = hash_id(id) & s_db.index_mask;
+    while (s_db.index[i] != 0) {
+        if (s_db.records[s_db.index[i] - 1].id == id) {
+            return (int)i;
+        }
+        i = (i + 1) & s_db.index_mask;
     }
-    return err;
+    return -1;
 }
 
+static void index_insert(int32_t id, int record_idx) {
+    uint32_t i = hash_id(id) & s_db.index_mask;
+    while (s_db.index[i] != 0) {
+        i = (i + 1) & s_db.index_mask;
+    }
+    s_db.index[i] = record_idx + 1;
+}
 
-esp_err_t database_init(void) {
-    if (s_db.records) {
-        ESP_LOGW(TAG, "Database already initialized.");
+// Backward-shift delete, keeps probe chains intact without tombstones
+static void index_remove_slot(uint32_t i) {
+    uint32_t j = i;
+    while (true) {
+        j = (j + 1) & s_db.index_mask;
+        if (s_db.index[j] == 0) break;
+        uint32_t home = hash_id(s_db.records[s_db.index[j] - 1].id) & s_db.index_mask;
+        bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            s_db.index[i] = s_db.index[j];
+            i = j;
+        }
+    }
+    s_db.index[i] = 0;
+}
+
+static esp_err_t index_reserve(int count) {
+    uint32_t size = s_db.index ? s_db.index_mask + 1 : 0;
+    if ((uint32_t)count * 2 <= size) return ESP_OK;
+
+    uint32_t new_size = size ? size : 64;
+    while ((uint32_t)count * 2 > new_size) new_size <<= 1;
+
+    int32_t* new_index = calloc(new_size, sizeof(int32_t));
+    if (!new_index) return ESP_ERR_NO_MEM;
+    free(s_db.index);
+    s_db.index = new_index;
+    s_db.index_mask = new_size - 1;
+    for (int r = 0; r < s_db.count; r++) {
+        index_insert(s_db.records[r].id, r);
+    }
+    return ESP_OK;
+}
+
+/* ---------- string pool ---------- */
+
+static int str_find(const char* s, size_t len, uint32_t h) {
+    if (!s_db.str_index) return -1;
+    uint32_t i = h & s_db.str_index_mask;
+    while (s_db.str_index[i] != 0) {
+        int sid = s_db.str_index[i] - 1;
+        const char* candidate = s_db.pool + s_db.str_offsets[sid];
+        if (strncmp(candidate, s, len) == 0 && candidate[len] == '\0') {
+            return sid;
+        }
+        i = (i + 1) & s_db.str_index_mask;
+    }
+    return -1;
+}
+
+static void str_index_insert(int sid) {
+    const char* s = s_db.pool + s_db.str_offsets[sid];
+    uint32_t i = hash_str(s, strlen(s)) & s_db.str_index_mask;
+    while (s_db.str_index[i] != 0) {
+        i = (i + 1) & s_db.str_index_mask;
+    }
+    s_db.str_index[i] = (uint16_t)(sid + 1);
+}
+
+// Appends a new string to the pool. Returns its id, -1 on failure.
+static int str_add(const char* s, size_t len) {
+    if (s_db.str_count >= FACE_DB_MAX_STRINGS) {
+        ESP_LOGE(TAG, "String pool is full.");
+        return -1;
+    }
+    if (s_db.pool_used + len + 1 > s_db.pool_size) {
+        size_t new_size = s_db.pool_size ? s_db.pool_size * 2 : 1024;
+        while (s_db.pool_used + len + 1 > new_size) new_size *= 2;
+        char* new_pool = realloc(s_db.pool, new_size);
+        if (!new_pool) return -1;
+        s_db.pool = new_pool;
+        s_db.pool_size = new_size;
+    }
+    if (s_db.str_count == s_db.str_capacity) {
+        int new_cap = s_db.str_capacity ? s_db.str_capacity * 2 : 32;
+        uint32_t* new_offsets = realloc(s_db.str_offsets, new_cap * sizeof(uint32_t));
+        if (!new_offsets) return -1;
+        s_db.str_offsets = new_offsets;
+        s_db.str_capacity = new_cap;
+    }
+    uint32_t index_size = s_db.str_index ? s_db.str_index_mask + 1 : 0;
+    if ((uint32_t)(s_db.str_count + 1) * 2 > index_size) {
+        uint32_t new_size = index_size ? index_size * 2 : 64;
+        uint16_t* new_index = calloc(new_size, sizeof(uint16_t));
+        if (!new_index) return -1;
+        free(s_db.str_index);
+        s_db.str_index = new_index;
+        s_db.str_index_mask = new_size - 1;
+        for (int i = 0; i < s_db.str_count; i++) {
+            str_index_insert(i);
+        }
+    }
+
+    int sid = s_db.str_count++;
+    s_db.str_offsets[sid] = s_db.pool_used;
+    memcpy(s_db.pool + s_db.pool_used, s, len);
+    s_db.pool[s_db.pool_used + len] = '\0';
+    s_db.pool_used += len + 1;
+    str_index_insert(sid);
+    return sid;
+}
+
+/* ---------- log encoding ---------- */
+
+static bool buf_reserve(log_buf_t* b, size_t extra) {
+    if (b->len + extra <= b->cap) return true;
+    size_t new_cap = b->cap ? b->cap * 2 : 256;
+    while (b->len + extra > new_cap) new_cap *= 2;
+    uint8_t* p = realloc(b->data, new_cap);
+    if (!p) return false;
+    b->data = p;
+    b->cap = new_cap;
+    return true;
+}
+
+static inline void put_u16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline void put_u32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static inline uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool encode_str(log_buf_t* b, int sid) {
+    const char* s = s_db.pool + s_db.str_offsets[sid];
+    size_t len = strlen(s);
+    if (!buf_reserve(b, 4 + len)) return false;
+    uint8_t* p = b->data + b->len;
+    p[0] = OP_STR;
+    put_u16(p + 1, (uint16_t)sid);
+    p[3] = (uint8_t)len;
+    memcpy(p + 4, s, len);
+    b->len += 4 + len;
+    return true;
+}
+
+static bool encode_put(log_buf_t* b, const face_record_t* rec, const uint16_t* str_ids) {
+    if (!buf_reserve(b, PUT_SIZE)) return false;
+    uint8_t* p = b->data + b->len;
+    p[0] = OP_PUT;
+    put_u32(p + 1, (uint32_t)rec->id);
+    p[5] = rec->access_level;
+    for (int f = 0; f < FACE_FIELD_COUNT; f++) {
+        put_u16(p + 6 + 2 * f, str_ids[f]);
+    }
+    b->len += PUT_SIZE;
+    return true;
+}
+
+static bool encode_del(log_buf_t* b, int32_t id) {
+    if (!buf_reserve(b, DEL_SIZE)) return false;
+    b->data[b->len] = OP_DEL;
+    put_u32(b->data + b->len + 1, (uint32_t)id);
+    b->len += DEL_SIZE;
+    return true;
+}
+
+static esp_err_t log_append(const log_buf_t* b) {
+    if (b->len == 0) return ESP_OK;
+    FILE* f = fopen(s_db.path, "ab");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to open %s for append", s_db.path);
+        return ESP_FAIL;
+    }
+    fseek(f, 0, SEEK_END);
+    long start = ftell(f);
+    size_t written = fwrite(b->data, 1, b->len, f);
+    bool closed = fclose(f) == 0; // the buffered part is written here
+    if (written == b->len && closed) {
         return ESP_OK;
     }
+    ESP_LOGE(TAG, "Short write to %s (%d of %d)", s_db.path, (int)written, (int)b->len);
+    // Cut the partial entry off, entries appended behind it would be lost on replay
+    if (start < DB_HEADER_SIZE || truncate(s_db.path, start) != 0) {
+        ESP_LOGE(TAG, "Failed to cut %s back to %ld bytes", s_db.path, start);
+        s_db.log_damaged = true;
+    }
+    return ESP_FAIL;
+}
 
-    char* json_string = NULL;
-    bool must_recreate = false;
+static esp_err_t write_header(FILE* f) {
+    uint8_t header[DB_HEADER_SIZE] = { 0 };
+    memcpy(header, DB_MAGIC, 4);
+    put_u16(header + 4, DB_VERSION);
+    return fwrite(header, 1, sizeof(header), f) == sizeof(header) ? ESP_OK : ESP_FAIL;
+}
 
-    esp_err_t err = storage_read_file(DB_PATH, &json_string);
+/* ---------- in-memory apply (shared by log replay and live changes) ---------- */
 
-    if (err == ESP_ERR_NOT_FOUND) {
-        ESP_LOGW(TAG, "Database file not found. Will create from embedded.");
-        must_recreate = true;
-    } else if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read database file (%s).", esp_err_to_name(err));
-        return err;
-    } else if (strlen(json_string) < 5) { // Check if file is empty or invalid ("[]")
-        ESP_LOGW(TAG, "Existing database file is empty. Will recreate from embedded.");
-        must_recreate = true;
+// undo: NULL when replaying the log
+static esp_err_t apply_put(const face_record_t* rec, undo_t* undo) {
+    int slot = index_find_slot(rec->id);
+    if (slot >= 0) {
+        face_record_t* old = &s_db.records[s_db.index[slot] - 1];
+        if (undo) {
+            if (undo->replaced_count == undo->replaced_capacity) {
+                int new_cap = undo->replaced_capacity ? undo->replaced_capacity * 2 : 4;
+                face_record_t* p = realloc(undo->replaced, new_cap * sizeof(face_record_t));
+                if (!p) return ESP_ERR_NO_MEM;
+                undo->replaced = p;
+                undo->replaced_capacity = new_cap;
+            }
+            undo->replaced[undo->replaced_count++] = *old;
+        }
+        *old = *rec;
+        s_db.dead_entries++;
+        return ESP_OK;
+    }
+    if (s_db.count == s_db.capacity) {
+        int new_cap = s_db.capacity ? s_db.capacity * 2 : 16;
+        face_record_t* p = realloc(s_db.records, new_cap * sizeof(face_record_t));
+        if (!p) return ESP_ERR_NO_MEM;
+        s_db.records = p;
+        s_db.capacity = new_cap;
+    }
+    if (index_reserve(s_db.count + 1) != ESP_OK) return ESP_ERR_NO_MEM;
+    s_db.records[s_db.count] = *rec;
+    index_insert(rec->id, s_db.count);
+    s_db.count++;
+    return ESP_OK;
+}
+
+static bool apply_del(int32_t id) {
+    int slot = index_find_slot(id);
+    if (slot < 0) {
+        s_db.dead_entries++;
+        return false;
+    }
+    int r = s_db.index[slot] - 1;
+    index_remove_slot((uint32_t)slot);
+    int last = s_db.count - 1;
+    if (r != last) {
+        // keep the array dense: move the last record into the hole
+        s_db.records[r] = s_db.records[last];
+        s_db.index[index_find_slot(s_db.records[r].id)] = r + 1;
+    }
+    s_db.count--;
+    s_db.dead_entries += 2; // the PUT and the DEL
+    return true;
+}
+
+// Interns one field, writing an OP_STR entry if it is new
+static bool intern_field(log_buf_t* b, const char* s, uint16_t* out_sid) {
+    if (!s) s = "";
+    size_t len = strnlen(s, FACE_DB_MAX_STR_LEN);
+    int sid = str_find(s, len, hash_str(s, len));
+    if (sid < 0) {
+        sid = str_add(s, len);
+        if (sid < 0 || !encode_str(b, sid)) return false;
+    }
+    *out_sid = (uint16_t)sid;
+    return true;
+}
+
+static void undo_begin(undo_t* undo) {
+    memset(undo, 0, sizeof(*undo));
+    undo->count = s_db.count;
+    undo->str_count = s_db.str_count;
+    undo->pool_used = s_db.pool_used;
+    undo->dead_entries = s_db.dead_entries;
+}
+
+// Drops the staged records and strings, puts the overwritten records back
+static void undo_apply(undo_t* undo) {
+    for (int i = undo->replaced_count - 1; i >= 0; i--) {
+        int slot = index_find_slot(undo->replaced[i].id);
+        if (slot >= 0) {
+            s_db.records[s_db.index[slot] - 1] = undo->replaced[i];
+        }
+    }
+    while (s_db.count > undo->count) {
+        int slot = index_find_slot(s_db.records[s_db.count - 1].id);
+        if (slot >= 0) {
+            index_remove_slot((uint32_t)slot);
+        }
+        s_db.count--;
+    }
+    if (s_db.str_count > undo->str_count) {
+        s_db.str_count = undo->str_count;
+        s_db.pool_used = undo->pool_used;
+        memset(s_db.str_index, 0, (s_db.str_index_mask + 1) * sizeof(uint16_t));
+        for (int i = 0; i < s_db.str_count; i++) {
+            str_index_insert(i);
+        }
+    }
+    s_db.dead_entries = undo->dead_entries;
+}
+
+static void undo_end(undo_t* undo) {
+    free(undo->replaced);
+    undo->replaced = NULL;
+}
+
+static esp_err_t stage_put(log_buf_t* b, const face_info_t* info, undo_t* undo) {
+    face_record_t rec = { 0 };
+    rec.id = info->id;
+    rec.access_level = (uint8_t)info->access_level;
+    const char* fields[FACE_FIELD_COUNT] = {
+        info->name, info->title, info->status, info->image_file, info->embedding_file
+    };
+    for (int f = 0; f < FACE_FIELD_COUNT; f++) {
+        if (!intern_field(b, fields[f], &rec.str[f])) return ESP_ERR_NO_MEM;
+    }
+    if (!encode_put(b, &rec, rec.str)) return ESP_ERR_NO_MEM;
+    return apply_put(&rec, undo);
+}
+
+static void maybe_compact(void) {
+    if (s_db.log_damaged || (s_db.dead_entries > COMPACT_MIN_DEAD && s_db.dead_entries > s_db.count)) {
+        database_compact();
+    }
+}
+
+/* ---------- load ---------- */
+
+static void free_memory(void) {
+    free(s_db.records);
+    free(s_db.index);
+    free(s_db.pool);
+    free(s_db.str_offsets);
+    free(s_db.str_index);
+    free(s_db.path);
+    memset(&s_db, 0, sizeof(s_db));
+}
+
+// Replays the log. Returns the offset of the first byte that could not be
+// parsed (== len when the whole file is valid).
+static size_t replay_log(const uint8_t* data, size_t len) {
+    size_t off = DB_HEADER_SIZE;
+    while (off < len) {
+        const uint8_t* p = data + off;
+        size_t left = len - off;
+        if (p[0] == OP_STR) {
+            if (left < 4 || left < 4u + p[3]) break;
+            if (get_u16(p + 1) != s_db.str_count) {
+                ESP_LOGE(TAG, "String id out of sequence at offset %d", (int)off);
+                break;
+            }
+            if (str_add((const char*)p + 4, p[3]) < 0) break;
+            off += 4 + p[3];
+        } else if (p[0] == OP_PUT) {
+            if (left < PUT_SIZE) break;
+            face_record_t rec = { 0 };
+            rec.id = (int32_t)get_u32(p + 1);
+            rec.access_level = p[5];
+            bool valid = true;
+            for (int f = 0; f < FACE_FIELD_COUNT; f++) {
+                rec.str[f] = get_u16(p + 6 + 2 * f);
+                if (rec.str[f] >= s_db.str_count) valid = false;
+            }
+            if (!valid || apply_put(&rec, NULL) != ESP_OK) break;
+            off += PUT_SIZE;
+        } else if (p[0] == OP_DEL) {
+            if (left < DEL_SIZE) break;
+            apply_del((int32_t)get_u32(p + 1));
+            off += DEL_SIZE;
+        } else {
+            break;
+        }
+    }
+    return off;
+}
+
+static esp_err_t database_load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        return ESP_FAIL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < DB_HEADER_SIZE) {
+        fclose(f);
+        ESP_LOGE(TAG, "%s is too small to be a database", path);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t* data = malloc(size);
+    if (!data) {
+        fclose(f);
+        ESP_LOGE(TAG, "Failed to allocate %ld bytes to load the database", size);
+        return ESP_ERR_NO_MEM;
+    }
+    size_t read = fread(data, 1, size, f);
+    fclose(f);
+
+    if (read != (size_t)size || memcmp(data, DB_MAGIC, 4) != 0 || get_u16(data + 4) != DB_VERSION) {
+        free(data);
+        ESP_LOGE(TAG, "%s is not a valid database file", path);
+        return ESP_ERR_INVALID_CRC;
     }
 
-    // Free the buffer if it was allocated
-    if (json_string) {
-        free(json_string);
-        json_string = NULL;
+    size_t valid = replay_log(data, size);
+    free(data);
+
+    if (valid != (size_t)size) {
+        // Most likely a write cut off by a reset. Keep what we have and rewrite clean.
+        ESP_LOGW(TAG, "Database log damaged at offset %d of %ld, rewriting.", (int)valid, size);
+        return database_compact();
+    }
+    return ESP_OK;
+}
+
+/* ---------- public API ---------- */
+
+esp_err_t database_open(const char* db_path) {
+    if (s_db.path) {
+        ESP_LOGW(TAG, "Database already open (%s).", s_db.path);
+        return ESP_OK;
+    }
+
+    s_db.path = strdup(db_path);
+    if (!s_db.path) return ESP_ERR_NO_MEM;
+
+    // A compaction interrupted between remove() and rename() leaves only the temp file
+    char tmp_path[128];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", db_path);
+    if (!storage_file_exists(db_path) && storage_file_exists(tmp_path)) {
+        ESP_LOGW(TAG, "Recovering database from interrupted compaction.");
+        rename(tmp_path, db_path);
     }
 
-    // If the file was missing or empty, create it now.
-    if (must_recreate) {
-        if (create_db_from_embedded() != ESP_OK) {
+    if (!storage_file_exists(db_path)) {
+        FILE* f = fopen(db_path, "wb");
+        if (!f || write_header(f) != ESP_OK) {
+            if (f) fclose(f);
+            ESP_LOGE(TAG, "Failed to create %s", db_path);
+            free_memory();
             return ESP_FAIL;
         }
+        fclose(f);
+        s_db.fresh = true;
+        return ESP_OK;
     }
 
-    // Now, read the file again. It's guaranteed to exist and should have content.
-    err = storage_read_file(DB_PATH, &json_string);
+    esp_err_t err = database_load(db_path);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read database file after potential creation.");
+        free_memory();
         return err;
     }
+    ESP_LOGI(TAG, "Loaded %d face records (%d strings) from %s.", s_db.count, s_db.str_count, db_path);
+    return ESP_OK;
+}
 
-    // BE CAREFUL: It will print the whole database to terminal!
-    //ESP_LOGI(TAG, "Final raw content read from %s:\n%s", DB_PATH, json_string);
+esp_err_t database_init(void) {
+    if (s_db.path) {
+        ESP_LOGW(TAG, "Database already initialized.");
+        return ESP_OK;
+    }
 
-    cJSON* root = cJSON_Parse(json_string);
+    esp_err_t err = database_open(DB_PATH);
+    if (err != ESP_OK || !s_db.fresh) {
+        return err;
+    }
+
+    // First boot with the binary store: one-time import of the JSON metadata
+    char* json_string = NULL;
+    err = storage_read_file(JSON_PATH, &json_string);
+    if (err == ESP_OK && strlen(json_string) >= 5) { // skip an empty "[]"
+        ESP_LOGI(TAG, "Importing %s into %s...", JSON_PATH, DB_PATH);
+        err = database_import_json(json_string);
+    } else {
+        ESP_LOGI(TAG, "Importing embedded faces.json into %s...", DB_PATH);
+        err = database_import_json((const char*)faces_json_start);
+    }
     free(json_string);
 
-    if (!root || !cJSON_IsArray(root)) {
-        ESP_LOGE(TAG, "Failed to parse JSON or root is not an array.");
-        cJSON_Delete(root);
-        return ESP_FAIL;
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Imported %d face records.", s_db.count);
     }
+    return err;
+}
 
-    s_db.count = cJSON_GetArraySize(root);
-    ESP_LOGI(TAG, "Found %d face records in database.", s_db.count);
+void database_deinit(void) {
+    free_memory();
+    ESP_LOGI(TAG, "Database deinitialized.");
+}
 
-    if (s_db.count == 0) {
-        ESP_LOGW(TAG, "Database is still empty after attempting to create it. Check embedded file.");
-        s_db.records = NULL;
-        cJSON_Delete(root);
-        return ESP_OK;
-    }
+static const char* json_str(const cJSON* obj, const char* key) {
+    const cJSON* item = cJSON_GetObjectItem(obj, key);
+    return cJSON_IsString(item) ? item->valuestring : "";
+}
 
-    s_db.records = calloc(s_db.count, sizeof(face_record_t));
-    if (!s_db.records) {
-        ESP_LOGE(TAG, "Failed to allocate memory for %d records!", s_db.count);
-        s_db.count = 0;
+esp_err_t database_import_json(const char* json) {
+    if (!s_db.path) return ESP_ERR_INVALID_STATE;
+
+    cJSON* root = cJSON_Parse(json);
+    if (!root || !cJSON_IsArray(root)) {
+        ESP_LOGE(TAG, "Failed to parse JSON or root is not an array.");
         cJSON_Delete(root);
-        return ESP_ERR_NO_MEM;
+        return ESP_FAIL;
     }
 
+    log_buf_t b = { 0 };
+    undo_t undo;
+    undo_begin(&undo);
+    esp_err_t err = ESP_OK;
     cJSON* elem = NULL;
-    int i = 0;
     cJSON_ArrayForEach(elem, root) {
-        s_db.records[i].id = cJSON_GetObjectItem(elem, "id")->valueint;
-        s_db.records[i].access_level = cJSON_GetObjectItem(elem, "access_level")->valueint;
-        strncpy(s_db.records[i].name, cJSON_GetObjectItem(elem, "name")->valuestring, MAX_NAME_LEN - 1);
-        strncpy(s_db.records[i].title, cJSON_GetObjectItem(elem, "title")->valuestring, MAX_TITLE_LEN - 1);
-        strncpy(s_db.records[i].status, cJSON_GetObjectItem(elem, "status")->valuestring, MAX_STATUS_LEN - 1);
-        strncpy(s_db.records[i].image_file, cJSON_GetObjectItem(elem, "image_file")->valuestring, MAX_FILENAME_LEN - 1);
-        strncpy(s_db.records[i].embedding_file, cJSON_GetObjectItem(elem, "embedding_file")->valuestring, MAX_FILENAME_LEN - 1);
-        i++;
+        const cJSON* id = cJSON_GetObjectItem(elem, "id");
+        if (!cJSON_IsNumber(id)) {
+            ESP_LOGW(TAG, "Skipping JSON record without a numeric id.");
+            continue;
+        }
+        const cJSON* level = cJSON_GetObjectItem(elem, "access_level");
+        face_info_t info = {
+            .id = id->valueint,
+            .access_level = cJSON_IsNumber(level) ? level->valueint : 0,
+            .name = json_str(elem, "name"),
+            .title = json_str(elem, "title"),
+            .status = json_str(elem, "status"),
+            .image_file = json_str(elem, "image_file"),
+            .embedding_file = json_str(elem, "embedding_file"),
+        };
+        err = stage_put(&b, &info, &undo);
+        if (err != ESP_OK) break;
     }
-
     cJSON_Delete(root);
+
+    if (err == ESP_OK) {
+        err = log_append(&b);
+    }
+    if (err != ESP_OK) {
+        undo_apply(&undo);
+    }
+    undo_end(&undo);
+    free(b.data);
+    maybe_compact();
+    return err;
+}
+
+const face_record_t* database_find_by_id(int id) {
+    int slot = index_find_slot(id);
+    return slot < 0 ? NULL : &s_db.records[s_db.index[slot] - 1];
+}
+
+const char* database_get_str(uint16_t str_id) {
+    if (str_id >= s_db.str_count) return "";
+    return s_db.pool + s_db.str_offsets[str_id];
+}
+
+esp_err_t database_get_info(int id, face_info_t* out) {
+    const face_record_t* rec = database_find_by_id(id);
+    if (!rec) return ESP_ERR_NOT_FOUND;
+    out->id = rec->id;
+    out->access_level = rec->access_level;
+    out->name = database_get_str(rec->str[FACE_FIELD_NAME]);
+    out->title = database_get_str(rec->str[FACE_FIELD_TITLE]);
+    out->status = database_get_str(rec->str[FACE_FIELD_STATUS]);
+    out->image_file = database_get_str(rec->str[FACE_FIELD_IMAGE_FILE]);
+    out->embedding_file = database_get_str(rec->str[FACE_FIELD_EMBEDDING_FILE]);
     return ESP_OK;
 }
 
-void database_deinit(void) {
-    if (s_db.records) {
-        free(s_db.records);
-        s_db.records = NULL;
+esp_err_t database_put_face(const face_info_t* info) {
+    if (!s_db.path) return ESP_ERR_INVALID_STATE;
+    if (!info) return ESP_ERR_INVALID_ARG;
+
+    log_buf_t b = { 0 };
+    undo_t undo;
+    undo_begin(&undo);
+    esp_err_t err = stage_put(&b, info, &undo);
+    if (err == ESP_OK) {
+        err = log_append(&b);
     }
-    s_db.count = 0;
-    ESP_LOGI(TAG, "Database deinitialized.");
+    if (err != ESP_OK) {
+        undo_apply(&undo); // memory stays what the file replays to
+    }
+    undo_end(&undo);
+    free(b.data);
+    maybe_compact();
+    return err;
 }
 
-esp_err_t database_get_all_faces(face_record_t** out_faces, int* out_count) {
-    if (s_db.count > 0 && !s_db.records) {
-        ESP_LOGE(TAG, "Database not initialized or in inconsistent state.");
+esp_err_t database_delete_face(int id) {
+    if (!s_db.path) return ESP_ERR_INVALID_STATE;
+    if (!database_find_by_id(id)) return ESP_ERR_NOT_FOUND;
+
+    log_buf_t b = { 0 };
+    esp_err_t err = encode_del(&b, id) ? log_append(&b) : ESP_ERR_NO_MEM;
+    free(b.data);
+    if (err == ESP_OK) {
+        apply_del(id);
+    }
+    maybe_compact();
+    return err;
+}
+
+esp_err_t database_compact(void) {
+    if (!s_db.path) return ESP_ERR_INVALID_STATE;
+
+    char tmp_path[128];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", s_db.path);
+
+    // Renumber the strings still referenced, in record order
+    uint16_t* remap = malloc((s_db.str_count + 1) * sizeof(uint16_t));
+    if (!remap) return ESP_ERR_NO_MEM;
+    memset(remap, 0xFF, (s_db.str_count + 1) * sizeof(uint16_t));
+
+    log_buf_t b = { 0 };
+    bool ok = buf_reserve(&b, DB_HEADER_SIZE);
+    if (ok) {
+        memcpy(b.data, DB_MAGIC, 4);
+        put_u16(b.data + 4, DB_VERSION);
+        put_u16(b.data + 6, 0);
+        b.len = DB_HEADER_SIZE;
+    }
+    uint16_t next_sid = 0;
+    for (int r = 0; ok && r < s_db.count; r++) {
+        uint16_t ids[FACE_FIELD_COUNT];
+        for (int f = 0; ok && f < FACE_FIELD_COUNT; f++) {
+            uint16_t old = s_db.records[r].str[f];
+            if (remap[old] == 0xFFFF) {
+                const char* s = s_db.pool + s_db.str_offsets[old];
+                size_t len = strlen(s);
+                ok = buf_reserve(&b, 4 + len);
+                if (!ok) break;
+                uint8_t* p = b.data + b.len;
+                p[0] = OP_STR;
+                put_u16(p + 1, next_sid);
+                p[3] = (uint8_t)len;
+                memcpy(p + 4, s, len);
+                b.len += 4 + len;
+                remap[old] = next_sid++;
+            }
+            ids[f] = remap[old];
+        }
+        ok = ok && encode_put(&b, &s_db.records[r], ids);
+    }
+    free(remap);
+
+    if (!ok) {
+        free(b.data);
+        ESP_LOGE(TAG, "Out of memory while compacting the database.");
+        return ESP_ERR_NO_MEM;
+    }
+
+    FILE* f = fopen(tmp_path, "wb");
+    size_t written = f ? fwrite(b.data, 1, b.len, f) : 0;
+    if (f) fclose(f);
+    size_t total = b.len;
+    free(b.data);
+    if (written != total) {
+        ESP_LOGE(TAG, "Failed to write compacted database to %s", tmp_path);
+        remove(tmp_path);
         return ESP_FAIL;
     }
+
+    // SPIFFS can't rename over an existing file
+    char* path = strdup(s_db.path);
+    if (!path) return ESP_ERR_NO_MEM;
+    remove(path);
+    if (rename(tmp_path, path) != 0) {
+        ESP_LOGE(TAG, "Failed to replace %s with the compacted copy", path);
+        free(path);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Database compacted: %d records, %d bytes (%d dead entries dropped).",
+             s_db.count, (int)total, s_db.dead_entries);
+
+    // Reload so the in-memory string ids match the file
+    free_memory();
+    esp_err_t err = database_open(path);
+    free(path);
+    return err;
+}
+
+esp_err_t database_get_all_faces(const face_record_t** out_faces, int* out_count) {
+    if (!s_db.path) {
+        ESP_LOGE(TAG, "Database not initialized.");
+        return ESP_ERR_INVALID_STATE;
+    }
     *out_faces = s_db.records;
     *out_count = s_db.count;
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+int database_get_count(void) {
+    return s_db.count;
+}
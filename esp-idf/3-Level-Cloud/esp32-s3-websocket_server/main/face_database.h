@@ -2,8 +2,15 @@
  * @file face_database.h
  * @brief Manages loading and accessing face metadata from storage.
  *
- * This is responsible for parsing the faces.json file on startup,
- * holding the face records in memory, and providing access to them.
+ * Face metadata lives in a compact binary log (/spiffs/faces.db). Strings
+ * (names, titles, file paths) are interned once and records only hold
+ * 16-bit string ids. Records are indexed by id in a hash table, so the id
+ * returned by the recognizer can be joined to its metadata in O(1).
+ * Changes are appended to the log (no full rewrite) and the file is
+ * compacted when too many superseded entries pile up.
+ *
+ * On first boot the log is imported once from faces.json (SPIFFS copy or
+ * the one embedded in the firmware).
  */
 
 #ifndef FACE_DATABASE_H
@@ -11,45 +18,153 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
-#define MAX_NAME_LEN 32
-#define MAX_TITLE_LEN 32
-#define MAX_STATUS_LEN 16
-#define MAX_FILENAME_LEN 64
+#define FACE_DB_MAX_STR_LEN 255 // longest string a record field can hold (longer ones are cut)
+#define FACE_DB_MAX_STRINGS 65534 // distinct interned strings, 16-bit ids
 
-// A single face record in memory
+// Interned string fields of a record
+typedef enum {
+    FACE_FIELD_NAME = 0,
+    FACE_FIELD_TITLE,
+    FACE_FIELD_STATUS,
+    FACE_FIELD_IMAGE_FILE,
+    FACE_FIELD_EMBEDDING_FILE,
+    FACE_FIELD_COUNT
+} face_field_t;
+
+// A single face record in memory (16 bytes). Use database_get_str() for the strings.
+typedef struct {
+    int32_t id;
+    uint16_t str[FACE_FIELD_COUNT];
+    uint8_t access_level;
+} face_record_t;
+
+// Decoded record, used to add/update faces and for printing
 typedef struct {
     int id;
     int access_level;
-    char name[MAX_NAME_LEN];
-    char title[MAX_TITLE_LEN];
-    char status[MAX_STATUS_LEN];
-    char image_file[MAX_FILENAME_LEN];
-    char embedding_file[MAX_FILENAME_LEN];
-} face_record_t;
+    const char* name;
+    const char* title;
+    const char* status;
+    const char* image_file;
+    const char* embedding_file;
+} face_info_t;
 
 /**
  * @brief Initializes the face database.
  *
- * Reads and parses /spiffs/faces.json. If the file doesn't exist,
- * it creates an empty one. This is called after storage_init().
+ * Loads /spiffs/faces.db. If it doesn't exist, it is imported once from
+ * /spiffs/faces.json (or the embedded faces.json). Call after storage_init().
  *
  * @return esp_err_t ESP_OK on success.
  */
 esp_err_t database_init(void);
 
+/**
+ * @brief Opens (or creates) a database log at a specific path.
+ *
+ * database_init() uses this with the default path. Handy for diagnostics
+ * and benchmarks on a scratch file.
+ *
+ * @param db_path Full path of the binary log.
+ * @return esp_err_t ESP_OK on success.
+ */
+esp_err_t database_open(const char* db_path);
+
 /**
  * @brief Deinitialize the database, free all allocated memory.
  */
 void database_deinit(void);
 
+/**
+ * @brief Imports a faces.json document (array of objects) into the open database.
+ *
+ * Records with an existing id are updated. Everything is appended in one write.
+ * If it fails, no record is changed in memory either.
+ *
+ * @param json Null-terminated JSON text.
+ * @return esp_err_t ESP_OK on success.
+ */
+esp_err_t database_import_json(const char* json);
+
+/**
+ * @brief Looks up a record by id (e.g. the recognizer result id). O(1).
+ *
+ * @note The pointer is valid until the next add/update/delete/compact.
+ *
+ * @param id Face id.
+ * @return const face_record_t* The record, NULL if not found.
+ */
+const face_record_t* database_find_by_id(int id);
+
+/**
+ * @brief Looks up a record by id and decodes its strings.
+ *
+ * @param id Face id.
+ * @param[out] out Decoded record. Strings point into the intern pool.
+ * @return esp_err_t ESP_OK, or ESP_ERR_NOT_FOUND.
+ */
+esp_err_t database_get_info(int id, face_info_t* out);
+
+/**
+ * @brief Returns an interned string by its id.
+ *
+ * @param str_id String id taken from face_record_t::str.
+ * @return const char* The string ("" for an unknown id).
+ */
+const char* database_get_str(uint16_t str_id);
+
+/**
+ * @brief Adds a new record or updates the one with the same id.
+ *
+ * The change is appended to the log, the rest of the file is untouched.
+ * If the append fails, the memory is left as the file replays (old record or none).
+ *
+ * @param info Record to store. NULL strings are stored as "".
+ * @return esp_err_t ESP_OK on success.
+ */
+esp_err_t database_put_face(const face_info_t* info);
+
+/**
+ * @brief Deletes a record.
+ *
+ * @param id Face id.
+ * @return esp_err_t ESP_OK, or ESP_ERR_NOT_FOUND.
+ */
+esp_err_t database_delete_face(int id);
+
+/**
+ * @brief Rewrites the log with live records only.
+ *
+ * Done automatically when superseded entries outnumber live ones.
+ *
+ * @return esp_err_t ESP_OK on success.
+ */
+esp_err_t database_compact(void);
+
 /**
  * @brief Gets a pointer to the in-memory array of all face records.
  *
- * @param[out] out_faces Pointer to a face_record_t holding the array.
+ * @note Order is not stable across deletes.
+ *
+ * @param[out] out_faces Pointer to the record array.
  * @param[out] out_count Pointer to the integer number of records.
  * @return esp_err_t ESP_OK on success.
  */
-esp_err_t database_get_all_faces(face_record_t** out_faces, int* out_count);
+esp_err_t database_get_all_faces(const face_record_t** out_faces, int* out_count);
+
+/**
+ * @brief Number of records currently in the database.
+ */
+int database_get_count(void);
+
+#ifdef __cplusplus
+}
+#endif
 
-#endif // FACE_DATABASE_H
\ No newline at end of file
+#endif // FACE_DATABASE_H
@@ -2,13 +2,78 @@
 #include "human_face_detect.hpp"
 #include "human_face_recognition.hpp"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "dl_model_arena.hpp"
+#include "config.h"
+#include "identity_cache.h"
+#include <algorithm>
+#include <math.h>
 
 static const char *TAG = "FACE_RECOGN";
 
+// Same acceptance threshold for the database and the identity cache
+#define FACE_MATCH_THRESHOLD 0.5f
+// Feature model input side: smaller faces are upscaled, their quality is scaled down
+#define FACE_QUALITY_SIDE 112
+
+// Logs how long a model took to load and the heap it took (drop of the free size)
+static void log_model_load(const char* name, int64_t start_us, size_t internal_free, size_t psram_free) {
+    ESP_LOGI(TAG, "%s loaded in %lld ms, %u KB internal RAM, %u KB PSRAM.", name,
+             (long long)((esp_timer_get_time() - start_us) / 1000),
+             (unsigned)((internal_free - heap_caps_get_free_size(MALLOC_CAP_INTERNAL)) / 1024),
+             (unsigned)((psram_free - heap_caps_get_free_size(MALLOC_CAP_SPIRAM)) / 1024));
+}
+
 FaceRecognizer::FaceRecognizer() {
+    size_t internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    m_arena = NULL;
+    m_models_ready = true;
+    m_unknown_feat = NULL;
+    m_unknown_quality = 0;
+    m_timing = {};
+
+#if FACE_MODELS_SHARED_ARENA
+    // Detector and feature model never run at the same time:
+    // their intermediate tensors are planned in one arena, sized to the bigger model.
+    m_arena = new dl::ModelArena();
+    m_arena->bind();
+#endif
+    int64_t start = esp_timer_get_time();
+    size_t model_internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t model_psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
     m_detector = new HumanFaceDetect();
+    log_model_load("Detector", start, model_internal_free, model_psram_free);
+
+    start = esp_timer_get_time();
+    model_internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    model_psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
     m_feat_model = new HumanFaceFeat();
-    m_recognizer = new HumanFaceRecognizer(m_feat_model, (char*)"face.db");
+    log_model_load("Feature model", start, model_internal_free, model_psram_free);
+#if FACE_MODELS_SHARED_ARENA
+    m_arena->unbind();
+    if (m_arena->commit()) {
+        size_t internal_private, psram_private;
+        m_arena->get_private_size(internal_private, psram_private);
+        ESP_LOGI(TAG, "Shared activations: %u KB internal, %u KB PSRAM (separate: %u KB, %u KB)",
+                 (unsigned)(m_arena->get_internal_size() / 1024), (unsigned)(m_arena->get_psram_size() / 1024),
+                 (unsigned)(internal_private / 1024), (unsigned)(psram_private / 1024));
+    } else {
+        ESP_LOGE(TAG, "No memory for the shared model arena, face recognition disabled.");
+        m_models_ready = false;
+    }
+#endif
+    // Free heap before the detector minus free heap now: parameters, activations (the arena once committed) and
+    // the model objects. The "total" of Model::get_memory_info() leaves the shared activations out: the models
+    // only plan them, commit() allocates them.
+    ESP_LOGI(TAG, "Models use %u KB internal RAM, %u KB PSRAM.",
+             (unsigned)((internal_free - heap_caps_get_free_size(MALLOC_CAP_INTERNAL)) / 1024),
+             (unsigned)((psram_free - heap_caps_get_free_size(MALLOC_CAP_SPIRAM)) / 1024));
+    m_recognizer = new HumanFaceRecognizer(m_feat_model, (char*)FACE_RECOGNITION_DB_PATH, FACE_MATCH_THRESHOLD);
+#if IDENTITY_CACHE_ENABLED
+    identity_cache_init(m_feat_model->m_feat_len);
+#endif
     ESP_LOGI(TAG, "ESP-WHO libs Init.");
 }
 
@@ -16,28 +81,94 @@ FaceRecognizer::~FaceRecognizer() {
     delete m_detector;
     delete m_recognizer;
     delete m_feat_model; // Clean up the feature model
+    delete m_arena; // After the models, they still point into it
+#if IDENTITY_CACHE_ENABLED
+    identity_cache_deinit();
+#endif
     ESP_LOGI(TAG, "ESP-WHO libs unloaded (deleted objects).");
 }
 
-int FaceRecognizer::recognize_face(uint8_t *image_buffer, int width, int height) {
+int FaceRecognizer::get_feat_len() const {
+    return m_feat_model->m_feat_len;
+}
+
+int FaceRecognizer::enroll_feat(const float* feat) {
+    if (!m_models_ready || !feat) {
+        return -1;
+    }
+    // Wraps the caller's floats, no copy (the database copies on enroll)
+    dl::TensorBase tensor({ m_feat_model->m_feat_len }, feat, 0, dl::DATA_TYPE_FLOAT, false);
+    if (m_recognizer->enroll_feat(&tensor) != ESP_OK) {
+        return -1;
+    }
+    return m_recognizer->get_last_feat_id();
+}
+
+bool FaceRecognizer::delete_feat(int id) {
+#if IDENTITY_CACHE_ENABLED
+    identity_cache_invalidate(id);
+#endif
+    return m_models_ready && m_recognizer->delete_feat((uint16_t)id) == ESP_OK;
+}
+
+int FaceRecognizer::recognize_face(int camera_id, uint8_t *image_buffer, int width, int height, bool rgb565) {
     dl::image::img_t image;
     image.width = width;
     image.height = height;
     image.data = image_buffer;
-    image.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888;
+    image.pix_type = rgb565 ? dl::image::DL_IMAGE_PIX_TYPE_RGB565 : dl::image::DL_IMAGE_PIX_TYPE_RGB888;
+    m_unknown_feat = NULL;
+    m_timing = {};
+
+    if (!m_models_ready) {
+        return -1;
+    }
 
     std::list<dl::detect::result_t> faces = m_detector->run(image);
+    m_timing.detect_us = esp_timer_get_time();
 
     if (faces.empty()) {
         ESP_LOGI(TAG, "No face detected in image.");
         return -1;
     }
-    std::vector<dl::recognition::result_t> results = m_recognizer->recognize(image, faces);
+
+    // Same as HumanFaceRecognizer::recognize(): the largest face is the one recognized.
+    // Done here so the embedding can be checked against the identity cache first.
+    auto largest = std::max_element(faces.begin(), faces.end(),
+        [](const dl::detect::result_t &a, const dl::detect::result_t &b) -> bool {
+            return a.box_area() < b.box_area();
+        });
+    dl::TensorBase* feat = m_feat_model->run(image, largest->keypoint);
+    m_timing.feature_us = esp_timer_get_time();
+
+#if IDENTITY_CACHE_ENABLED
+    float sim = 0;
+    int cached_id = identity_cache_lookup(camera_id, (const float*)feat->data, FACE_MATCH_THRESHOLD, &sim);
+    if (cached_id >= 0) {
+        m_timing.query_us = esp_timer_get_time();
+        ESP_LOGD(TAG, "Cache hit, camera %d, ID %d (sim %.2f)", camera_id, cached_id, sim);
+        return cached_id;
+    }
+    int64_t query_start = esp_timer_get_time();
+#endif
+
+    std::vector<dl::recognition::result_t> results = m_recognizer->query_feat(feat, FACE_MATCH_THRESHOLD, 1);
+    m_timing.query_us = esp_timer_get_time();
+
+#if IDENTITY_CACHE_ENABLED
+    identity_cache_record_query(esp_timer_get_time() - query_start);
+#endif
 
     if (results.empty()) {
         ESP_LOGI(TAG, "Unknown face detected (no match in dB).");
+        m_unknown_feat = (const float*)feat->data;
+        float side = sqrtf((float)largest->box_area());
+        m_unknown_quality = largest->score * std::min(1.0f, side / FACE_QUALITY_SIDE);
         return -1;
     }
 
+#if IDENTITY_CACHE_ENABLED
+    identity_cache_insert(camera_id, results.front().id, (const float*)feat->data);
+#endif
     return results.front().id;
 }
\ No newline at end of file
@@ -4,16 +4,46 @@
 
 // Forward declaration without need for the full definition.
 class HumanFaceFeat;
+namespace dl { class ModelArena; }
 
 class FaceRecognizer {
 public:
     FaceRecognizer();
     ~FaceRecognizer();
 
-    int recognize_face(uint8_t* image_buffer, int width, int height);
+    // camera_id selects the recent-identity cache of the camera the frame came from
+    int recognize_face(int camera_id, uint8_t* image_buffer, int width, int height, bool rgb565 = false);
+
+    // False if the models could not be loaded
+    bool is_ready() const { return m_models_ready; }
+
+    // Embedding of the face of the last frame if it was not recognized, NULL otherwise.
+    // Points into the model output, valid until the next recognize_face().
+    const float* get_unknown_feat() const { return m_unknown_feat; }
+    // When the last recognize_face() finished each stage (esp_timer us), 0 for the stages it did not reach
+    struct Timing {
+        int64_t detect_us;
+        int64_t feature_us; // alignment and embedding
+        int64_t query_us;   // identity cache or database
+    };
+    const Timing& get_timing() const { return m_timing; }
+    // Quality of that face in [0, 1]: detection score, scaled down for faces smaller than the model input
+    float get_unknown_quality() const { return m_unknown_quality; }
+    int get_feat_len() const;
+
+    // Adds an embedding (get_feat_len() floats) to the recognition database.
+    // Returns its id, -1 on failure.
+    int enroll_feat(const float* feat);
+    // Removes an embedding from the recognition database and from the identity cache.
+    bool delete_feat(int id);
 
 private:
     class HumanFaceDetect* m_detector;
     class HumanFaceRecognizer* m_recognizer;
     HumanFaceFeat* m_feat_model;
+    dl::ModelArena* m_arena; // activations shared by the detector and feature models, NULL if disabled
+    bool m_models_ready;
+    const float* m_unknown_feat;
+    float m_unknown_quality;
+    Timing m_timing;
 };
\ No newline at end of file
@@ -0,0 +1,470 @@
+/**
+ * @file face_upload.c
+ * @brief Chunked, windowed upload of unknown faces to the cloud tier.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "config.h"
+#include "mqtt.h"
+#include "face_upload.h"
+#include "face_upload_proto.h"
+
+static const char* TAG = "FACE_UPLOAD";
+
+// One queued upload, the whole object in one buffer, or an image request from the cloud (object NULL)
+typedef struct {
+    uint8_t* object;
+    size_t len;
+    int camera_id;
+    // Embedding-only: the image, held after the upload. FACE_UPLOAD_META_LEN bytes free in front
+    // for the meta of the reply, so the reply goes out without another copy
+    uint8_t* held;
+    face_upload_meta_t held_meta;
+    uint32_t request_id;
+} upload_job_t;
+
+// Image kept for a request, owned by the uploader task
+typedef struct {
+    uint32_t upload_id;
+    uint8_t* buffer;            // meta space + image, NULL when free
+    face_upload_meta_t meta;
+    int64_t expires_us;
+} held_image_t;
+
+static struct {
+    esp_mqtt_client_handle_t client;
+    mqtt_topic_t chunk_topic;
+    mqtt_topic_t sighting_topic;        // QoS 0, sent as a topic alias over MQTT 5
+    QueueHandle_t queue;
+    SemaphoreHandle_t slots;            // free window slots
+    portMUX_TYPE lock;                  // window arrays, shared with the MQTT task
+    int inflight[FACE_UPLOAD_WINDOW];   // msg_ids waiting for their PUBACK, -1 when free
+    int early[FACE_UPLOAD_WINDOW];      // PUBACKs that arrived before their msg_id was recorded
+    int early_pos;
+    uint32_t next_upload_id;
+    uint8_t* chunk_buf;                 // header + payload of the chunk being published
+    held_image_t held[FACE_UPLOAD_HELD_IMAGES];
+
+    // stats
+    face_upload_stats_t stats;
+    int64_t latency_us_total;
+} s_upload = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+// MQTT task: a chunk was acknowledged
+static void on_published(int msg_id) {
+    bool freed = false;
+    portENTER_CRITICAL(&s_upload.lock);
+    for (int i = 0; i < FACE_UPLOAD_WINDOW; i++) {
+        if (s_upload.inflight[i] == msg_id) {
+            s_upload.inflight[i] = -1;
+            freed = true;
+            break;
+        }
+    }
+    if (!freed) {
+        // Not ours, or the PUBACK beat window_add(): remember it
+        s_upload.early[s_upload.early_pos] = msg_id;
+        s_upload.early_pos = (s_upload.early_pos + 1) % FACE_UPLOAD_WINDOW;
+    }
+    portEXIT_CRITICAL(&s_upload.lock);
+    if (freed) {
+        xSemaphoreGive(s_upload.slots);
+    }
+}
+
+// Records a published chunk in the slot taken for it
+static void window_add(int msg_id) {
+    bool acked = false;
+    portENTER_CRITICAL(&s_upload.lock);
+    for (int i = 0; i < FACE_UPLOAD_WINDOW; i++) {
+        if (s_upload.early[i] == msg_id) {
+            s_upload.early[i] = -1;
+            acked = true;
+            break;
+        }
+    }
+    if (!acked) {
+        for (int i = 0; i < FACE_UPLOAD_WINDOW; i++) {
+            if (s_upload.inflight[i] < 0) {
+                s_upload.inflight[i] = msg_id;
+                break;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&s_upload.lock);
+    if (acked) {
+        xSemaphoreGive(s_upload.slots);
+    }
+}
+
+// Forgets the chunks in flight (upload abandoned), all slots free again
+static void window_reset(void) {
+    portENTER_CRITICAL(&s_upload.lock);
+    for (int i = 0; i < FACE_UPLOAD_WINDOW; i++) {
+        s_upload.inflight[i] = -1;
+        s_upload.early[i] = -1;
+    }
+    portEXIT_CRITICAL(&s_upload.lock);
+    while (xSemaphoreTake(s_upload.slots, 0) == pdTRUE) {
+    }
+    for (int i = 0; i < FACE_UPLOAD_WINDOW; i++) {
+        xSemaphoreGive(s_upload.slots);
+    }
+}
+
+// Waits until every chunk in flight is acknowledged
+static bool window_drain(TickType_t timeout) {
+    int taken = 0;
+    while (taken < FACE_UPLOAD_WINDOW && xSemaphoreTake(s_upload.slots, timeout) == pdTRUE) {
+        taken++;
+    }
+    for (int i = 0; i < taken; i++) {
+        xSemaphoreGive(s_upload.slots);
+    }
+    return taken == FACE_UPLOAD_WINDOW;
+}
+
+// One attempt: publish all chunks through the window, wait for the last PUBACK
+static bool send_object(const upload_job_t* job, uint32_t upload_id) {
+    const TickType_t timeout = pdMS_TO_TICKS(FACE_UPLOAD_ACK_TIMEOUT_MS);
+    face_upload_chunk_t chunk = {
+        .upload_id = upload_id,
+        .count = face_upload_chunk_count(job->len, FACE_UPLOAD_CHUNK_SIZE),
+        .total_len = job->len,
+    };
+    for (uint16_t i = 0; i < chunk.count; i++) {
+        if (xSemaphoreTake(s_upload.slots, timeout) != pdTRUE) {
+            ESP_LOGW(TAG, "Upload %lu: no PUBACK for %d ms", (unsigned long)upload_id, FACE_UPLOAD_ACK_TIMEOUT_MS);
+            return false;
+        }
+        if (!mqtt_is_connected()) {
+            xSemaphoreGive(s_upload.slots);
+            return false;
+        }
+        chunk.index = i;
+        chunk.offset = (uint32_t)i * FACE_UPLOAD_CHUNK_SIZE;
+        size_t payload = job->len - chunk.offset;
+        if (payload > FACE_UPLOAD_CHUNK_SIZE) {
+            payload = FACE_UPLOAD_CHUNK_SIZE;
+        }
+        face_upload_write_chunk_header(s_upload.chunk_buf, &chunk);
+        memcpy(s_upload.chunk_buf + FACE_UPLOAD_CHUNK_HEADER_LEN, job->object + chunk.offset, payload);
+
+        // QoS1 copies the message to the outbox, chunk_buf is free again on return
+        int msg_id = mqtt_publish_topic(s_upload.client, s_upload.chunk_topic, s_upload.chunk_buf,
+                                        FACE_UPLOAD_CHUNK_HEADER_LEN + payload, 1, 0);
+        if (msg_id < 0) {
+            xSemaphoreGive(s_upload.slots);
+            return false;
+        }
+        window_add(msg_id);
+        s_upload.stats.chunks++;
+    }
+    if (!window_drain(timeout)) {
+        ESP_LOGW(TAG, "Upload %lu: last chunks not acknowledged", (unsigned long)upload_id);
+        return false;
+    }
+    return true;
+}
+
+// Sends one object with the retries, true once fully acknowledged
+static bool upload_object(const upload_job_t* job, uint32_t upload_id) {
+    for (int attempt = 0; attempt <= FACE_UPLOAD_RETRIES; attempt++) {
+        while (!mqtt_is_connected()) {
+            vTaskDelay(pdMS_TO_TICKS(500));
+        }
+        if (attempt > 0) {
+            s_upload.stats.retries++;
+        }
+        int64_t start = esp_timer_get_time();
+        if (send_object(job, upload_id)) {
+            int64_t latency = esp_timer_get_time() - start;
+            s_upload.stats.completed++;
+            s_upload.stats.bytes += job->len;
+            s_upload.latency_us_total += latency;
+            if (latency > s_upload.stats.max_latency_us) {
+                s_upload.stats.max_latency_us = latency;
+            }
+            ESP_LOGI(TAG, "Upload %lu (camera %d): %u bytes in %d chunks, %lld ms, %.1f KB/s",
+                     (unsigned long)upload_id, job->camera_id, (unsigned)job->len,
+                     face_upload_chunk_count(job->len, FACE_UPLOAD_CHUNK_SIZE), (long long)(latency / 1000),
+                     latency > 0 ? job->len * 1000000.0f / latency / 1024 : 0.0f);
+            return true;
+        }
+        window_reset();
+    }
+    s_upload.stats.failed++;
+    ESP_LOGE(TAG, "Upload %lu (camera %d) failed after %d attempts", (unsigned long)upload_id, job->camera_id,
+             FACE_UPLOAD_RETRIES + 1);
+    return false;
+}
+
+#if FACE_UPLOAD_EMBEDDING_ONLY
+// MQTT task: image request from the cloud, handed to the uploader task
+static void on_data(const char* topic, int topic_len, const char* data, int data_len, int offset, int total_len) {
+    if (topic_len != (int)strlen(FACE_UPLOAD_REQUEST_TOPIC) ||
+        strncmp(topic, FACE_UPLOAD_REQUEST_TOPIC, topic_len) != 0 || offset != 0 || data_len != total_len) {
+        return;
+    }
+    upload_job_t job = { 0 };
+    if (!face_upload_parse_request((const uint8_t*)data, data_len, &job.request_id)) {
+        ESP_LOGW(TAG, "Invalid image request (%d bytes)", data_len);
+        return;
+    }
+    if (xQueueSend(s_upload.queue, &job, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Upload queue full, image request for %lu dropped", (unsigned long)job.request_id);
+        s_upload.stats.request_misses++;
+    }
+}
+
+static void held_free(held_image_t* held) {
+    free(held->buffer);
+    held->buffer = NULL;
+    s_upload.stats.held--;
+}
+
+static void held_expire(int64_t now) {
+    for (int i = 0; i < FACE_UPLOAD_HELD_IMAGES; i++) {
+        if (s_upload.held[i].buffer && now >= s_upload.held[i].expires_us) {
+            held_free(&s_upload.held[i]);
+        }
+    }
+}
+
+// Keeps the image of a sent upload, replacing the one closest to expiry when all are taken
+static void held_store(const upload_job_t* job, uint32_t upload_id) {
+    held_image_t* slot = &s_upload.held[0];
+    for (int i = 0; i < FACE_UPLOAD_HELD_IMAGES; i++) {
+        if (!s_upload.held[i].buffer) {
+            slot = &s_upload.held[i];
+            break;
+        }
+        if (s_upload.held[i].expires_us < slot->expires_us) {
+            slot = &s_upload.held[i];
+        }
+    }
+    if (slot->buffer) {
+        held_free(slot);
+    }
+    slot->upload_id = upload_id;
+    slot->buffer = job->held;
+    slot->meta = job->held_meta;
+    slot->expires_us = esp_timer_get_time() + (int64_t)FACE_UPLOAD_HELD_TTL_MS * 1000;
+    s_upload.stats.held++;
+}
+
+// Answers an image request with the held image as a new upload (meta IMAGE_REPLY, ref_id)
+static void send_held_image(uint32_t ref_id) {
+    s_upload.stats.requests++;
+    held_image_t* held = NULL;
+    for (int i = 0; i < FACE_UPLOAD_HELD_IMAGES; i++) {
+        if (s_upload.held[i].buffer && s_upload.held[i].upload_id == ref_id) {
+            held = &s_upload.held[i];
+            break;
+        }
+    }
+    if (!held) {
+        ESP_LOGW(TAG, "Image of upload %lu requested, no longer held", (unsigned long)ref_id);
+        s_upload.stats.request_misses++;
+        return;
+    }
+    face_upload_meta_t meta = held->meta;
+    meta.flags = FACE_UPLOAD_FLAG_IMAGE_REPLY;
+    meta.ref_id = ref_id;
+    face_upload_write_meta(held->buffer, &meta);
+    upload_job_t reply = {
+        .object = held->buffer,
+        .len = face_upload_object_len(&meta),
+        .camera_id = meta.camera_id,
+    };
+    if (upload_object(&reply, s_upload.next_upload_id++)) {
+        s_upload.stats.images_sent++;
+        held_free(held); // a second request for the same face is a miss
+    }
+}
+#endif // End of FACE_UPLOAD_EMBEDDING_ONLY
+
+static void upload_task(void* pvParameters) {
+    upload_job_t job;
+    while (true) {
+#if FACE_UPLOAD_EMBEDDING_ONLY
+        // Wakes up regularly to free expired images
+        held_expire(esp_timer_get_time());
+        if (xQueueReceive(s_upload.queue, &job, pdMS_TO_TICKS(1000)) != pdTRUE) {
+            continue;
+        }
+        if (!job.object) {
+            send_held_image(job.request_id);
+            continue;
+        }
+        uint32_t upload_id = s_upload.next_upload_id++;
+        if (upload_object(&job, upload_id) && job.held) {
+            held_store(&job, upload_id);
+        } else {
+            free(job.held);
+        }
+#else
+        if (xQueueReceive(s_upload.queue, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        upload_object(&job, s_upload.next_upload_id++);
+#endif
+        free(job.object);
+    }
+}
+
+esp_err_t face_upload_init(esp_mqtt_client_handle_t client) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_upload.queue) {
+        s_upload.client = client;
+        return ESP_OK;
+    }
+    s_upload.client = client;
+    s_upload.chunk_topic = mqtt_topic_register(FACE_UPLOAD_TOPIC);
+    s_upload.sighting_topic = mqtt_topic_register(UNKNOWN_CLUSTER_TOPIC);
+    s_upload.chunk_buf = malloc(FACE_UPLOAD_CHUNK_HEADER_LEN + FACE_UPLOAD_CHUNK_SIZE);
+    s_upload.queue = xQueueCreate(FACE_UPLOAD_QUEUE_LEN, sizeof(upload_job_t));
+    s_upload.slots = xSemaphoreCreateCounting(FACE_UPLOAD_WINDOW, FACE_UPLOAD_WINDOW);
+    if (!s_upload.chunk_buf || !s_upload.queue || !s_upload.slots) {
+        ESP_LOGE(TAG, "No memory for the uploader");
+        return ESP_ERR_NO_MEM;
+    }
+    if (s_upload.chunk_topic == MQTT_TOPIC_INVALID || s_upload.sighting_topic == MQTT_TOPIC_INVALID) {
+        return ESP_ERR_NO_MEM; // logged by mqtt_topic_register()
+    }
+    for (int i = 0; i < FACE_UPLOAD_WINDOW; i++) {
+        s_upload.inflight[i] = -1;
+        s_upload.early[i] = -1;
+    }
+    // Random start, the receiver must not take a new boot's uploads for old ones
+    s_upload.next_upload_id = esp_random();
+    mqtt_register_published_callback(on_published);
+#if FACE_UPLOAD_EMBEDDING_ONLY
+    if (mqtt_register_data_callback(on_data) != ESP_OK ||
+        mqtt_subscribe(client, FACE_UPLOAD_REQUEST_TOPIC, 1) != ESP_OK) {
+        ESP_LOGE(TAG, "No MQTT slot for the image requests");
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    if (xTaskCreate(upload_task, "face_upload", FACE_UPLOAD_TASK_STACK, NULL, FACE_UPLOAD_TASK_PRIORITY,
+                    NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create uploader task");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Face upload to %s: %d byte chunks, window %d, %s", FACE_UPLOAD_TOPIC, FACE_UPLOAD_CHUNK_SIZE,
+             FACE_UPLOAD_WINDOW, FACE_UPLOAD_EMBEDDING_ONLY ? "embedding only, images on request" : "with images");
+    return ESP_OK;
+}
+
+esp_err_t face_upload_submit(int camera_id, const uint8_t* image, size_t image_len, int width, int height,
+                             int format, const float* feat, int feat_len, uint32_t cluster_id) {
+    if (!s_upload.queue) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!image || image_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    face_upload_meta_t meta = {
+        .camera_id = camera_id,
+        .width = width,
+        .height = height,
+        .format = format,
+        .feat_type = FACE_UPLOAD_FEAT_F32,
+        .feat_len = feat ? feat_len : 0,
+        .image_len = image_len,
+        .ref_id = cluster_id,
+    };
+    upload_job_t job = {
+        .camera_id = camera_id,
+    };
+#if FACE_UPLOAD_EMBEDDING_ONLY
+    if (meta.feat_len > 0) {
+        // int8 embedding now, the image only if the cloud asks for it
+        job.held_meta = meta;
+        meta.feat_type = FACE_UPLOAD_FEAT_I8;
+        meta.flags = FACE_UPLOAD_FLAG_IMAGE_HELD;
+        meta.image_len = 0;
+        job.held_meta.feat_len = 0;
+        if (FACE_UPLOAD_META_LEN + image_len > FACE_UPLOAD_MAX_OBJECT_LEN) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        job.held = malloc(FACE_UPLOAD_META_LEN + image_len);
+        if (!job.held) {
+            s_upload.stats.dropped++;
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(job.held + FACE_UPLOAD_META_LEN, image, image_len);
+    }
+#endif
+    job.len = face_upload_object_len(&meta);
+    if (job.len > FACE_UPLOAD_MAX_OBJECT_LEN) {
+        free(job.held);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    job.object = malloc(job.len);
+    if (!job.object) {
+        free(job.held);
+        s_upload.stats.dropped++;
+        return ESP_ERR_NO_MEM;
+    }
+    face_upload_write_meta(job.object, &meta);
+    uint8_t* feat_out = job.object + FACE_UPLOAD_META_LEN;
+    if (meta.feat_type == FACE_UPLOAD_FEAT_I8) {
+        face_upload_quantize_i8(feat, meta.feat_len, feat_out);
+    } else if (meta.feat_len > 0) {
+        memcpy(feat_out, feat, (size_t)meta.feat_len * sizeof(float)); // little endian, as the wire format
+    }
+    if (meta.image_len > 0) {
+        memcpy(feat_out + face_upload_feat_bytes(meta.feat_type, meta.feat_len), image, image_len);
+    }
+
+    if (xQueueSend(s_upload.queue, &job, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Upload queue full, face from camera %d dropped", camera_id);
+        free(job.object);
+        free(job.held);
+        s_upload.stats.dropped++;
+        return ESP_ERR_NO_MEM;
+    }
+    s_upload.stats.submitted++;
+    return ESP_OK;
+}
+
+esp_err_t face_upload_send_sighting(const face_upload_sighting_t* sighting) {
+    if (!s_upload.queue || !mqtt_is_connected()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint8_t msg[FACE_UPLOAD_SIGHTING_LEN];
+    face_upload_write_sighting(msg, sighting);
+    // QoS 0: no PUBACK to tell apart from the chunk window, a lost count is not worth a retry
+    if (mqtt_publish_topic(s_upload.client, s_upload.sighting_topic, msg, sizeof(msg), 0, 0) < 0) {
+        return ESP_FAIL;
+    }
+    s_upload.stats.sightings++;
+    return ESP_OK;
+}
+
+void face_upload_get_stats(face_upload_stats_t* out) {
+    if (!out) {
+        return;
+    }
+    *out = s_upload.stats;
+    if (s_upload.stats.completed > 0) {
+        out->avg_latency_us = s_upload.latency_us_total / s_upload.stats.completed;
+    }
+    if (s_upload.latency_us_total > 0) {
+        out->avg_kbps = s_upload.stats.bytes * 1000000.0f / s_upload.latency_us_total / 1024;
+    }
+}
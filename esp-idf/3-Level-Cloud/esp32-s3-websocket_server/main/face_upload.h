@@ -0,0 +1,87 @@
+/**
+ * @file face_upload.h
+ * @brief Forwards unknown faces (image + embedding) to the cloud tier over MQTT.
+ *
+ * Each upload is split into chunks (face_upload_proto.h) published with
+ * QoS 1. At most FACE_UPLOAD_WINDOW chunks are in flight: a chunk leaves
+ * the window when the broker acknowledges it (MQTT_EVENT_PUBLISHED with its
+ * msg_id). An upload that does not get its acknowledgements in time, or is
+ * cut by a disconnect, is sent again from the start; the receiver drops
+ * the chunks it already has.
+ *
+ * With FACE_UPLOAD_EMBEDDING_ONLY an unknown face is sent as its int8
+ * embedding and meta only (about 540 bytes instead of a raw frame); the
+ * image stays on the S3 (FACE_UPLOAD_HELD_IMAGES, FACE_UPLOAD_HELD_TTL_MS)
+ * and is uploaded only when the cloud publishes an image request for the
+ * upload id on FACE_UPLOAD_REQUEST_TOPIC.
+ *
+ * Faces of the same stranger are grouped on the S3 (unknown_cluster.h):
+ * uploads carry their cluster id in the meta ref_id, the sightings that
+ * are not uploaded are sent as counts (face_upload_send_sighting()).
+ */
+
+#ifndef FACE_UPLOAD_H
+#define FACE_UPLOAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+#include "face_upload_proto.h"
+
+typedef struct {
+    uint32_t submitted;    // uploads accepted
+    uint32_t completed;    // uploads fully acknowledged
+    uint32_t failed;       // uploads given up after the retries
+    uint32_t dropped;      // uploads rejected, queue full or no memory
+    uint32_t retries;      // uploads restarted
+    uint32_t chunks;       // chunks published (including restarts)
+    uint64_t bytes;        // object bytes of the completed uploads (embeddings and images)
+    uint32_t requests;     // image requests received
+    uint32_t images_sent;  // held images uploaded on request
+    uint32_t request_misses; // requested image expired, replaced or unknown
+    uint32_t held;         // images held right now
+    uint32_t sightings;    // sighting messages published
+    int64_t avg_latency_us;  // first chunk published to last chunk acknowledged
+    int64_t max_latency_us;
+    float avg_kbps;        // object bytes over latency, completed uploads
+} face_upload_stats_t;
+
+/**
+ * @brief Starts the uploader task, publishing through the given client.
+ *
+ * Registers the MQTT published callback, and the data callback for the
+ * image requests in embedding-only mode.
+ */
+esp_err_t face_upload_init(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Queues an unknown face for upload.
+ *
+ * Image and embedding are copied, the caller keeps its buffers. In
+ * embedding-only mode a face with an embedding is sent without its image.
+ *
+ * @param camera_id Source camera.
+ * @param image Raw image.
+ * @param image_len Image size in bytes.
+ * @param width Image width in pixels.
+ * @param height Image height in pixels.
+ * @param format image_pix_format_t of the image.
+ * @param feat Embedding, may be NULL.
+ * @param feat_len Embedding elements (floats).
+ * @param cluster_id Unknown-face cluster of the face, 0 if none.
+ * @return ESP_OK if queued, ESP_ERR_INVALID_STATE if not initialized, ESP_ERR_NO_MEM if the queue is full.
+ */
+esp_err_t face_upload_submit(int camera_id, const uint8_t *image, size_t image_len, int width, int height,
+                             int format, const float *feat, int feat_len, uint32_t cluster_id);
+
+/**
+ * @brief Publishes the sighting counts of a cluster (QoS 0, small, not queued).
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if not initialized or not connected.
+ */
+esp_err_t face_upload_send_sighting(const face_upload_sighting_t *sighting);
+
+void face_upload_get_stats(face_upload_stats_t *out);
+
+#endif // FACE_UPLOAD_H
@@ -0,0 +1,405 @@
+/**
+ * @file face_upload_proto.c
+ * @brief Chunk/object encoding and receiver-side reassembly of face uploads.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "face_upload_proto.h"
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_f32(uint8_t *p, float v) {
+    uint32_t u;
+    memcpy(&u, &v, 4);
+    put_u32(p, u);
+}
+
+static float get_f32(const uint8_t *p) {
+    uint32_t u = get_u32(p);
+    float v;
+    memcpy(&v, &u, 4);
+    return v;
+}
+
+size_t face_upload_feat_bytes(uint8_t feat_type, uint16_t feat_len) {
+    if (feat_len == 0) {
+        return 0;
+    }
+    switch (feat_type) {
+    case FACE_UPLOAD_FEAT_F32:
+        return (size_t)feat_len * 4;
+    case FACE_UPLOAD_FEAT_I8:
+        return 4 + (size_t)feat_len;
+    default:
+        return 0;
+    }
+}
+
+void face_upload_quantize_i8(const float *feat, uint16_t len, uint8_t *out) {
+    float max_abs = 0;
+    for (int i = 0; i < len; i++) {
+        float a = fabsf(feat[i]);
+        if (a > max_abs) {
+            max_abs = a;
+        }
+    }
+    float scale = max_abs > 0 ? max_abs / 127.0f : 1.0f;
+    float inv = 1.0f / scale;
+    put_f32(out, scale);
+    for (int i = 0; i < len; i++) {
+        int q = (int)lrintf(feat[i] * inv);
+        out[4 + i] = (uint8_t)(int8_t)(q > 127 ? 127 : (q < -127 ? -127 : q));
+    }
+}
+
+bool face_upload_decode_feat(uint8_t feat_type, uint16_t feat_len, const uint8_t *in, float *out) {
+    switch (feat_type) {
+    case FACE_UPLOAD_FEAT_F32:
+        for (int i = 0; i < feat_len; i++) {
+            out[i] = get_f32(in + i * 4);
+        }
+        return true;
+    case FACE_UPLOAD_FEAT_I8: {
+        float scale = get_f32(in);
+        for (int i = 0; i < feat_len; i++) {
+            out[i] = (int8_t)in[4 + i] * scale;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+size_t face_upload_object_len(const face_upload_meta_t *meta) {
+    return FACE_UPLOAD_META_LEN + face_upload_feat_bytes(meta->feat_type, meta->feat_len) + meta->image_len;
+}
+
+void face_upload_write_meta(uint8_t *out, const face_upload_meta_t *meta) {
+    put_u16(out, meta->camera_id);
+    put_u16(out + 2, meta->width);
+    put_u16(out + 4, meta->height);
+    out[6] = meta->format;
+    out[7] = meta->feat_type;
+    put_u16(out + 8, meta->feat_len);
+    put_u16(out + 10, meta->flags);
+    put_u32(out + 12, meta->image_len);
+    put_u32(out + 16, meta->ref_id);
+}
+
+bool face_upload_read_meta(const uint8_t *object, size_t object_len, face_upload_meta_t *meta) {
+    if (object_len < FACE_UPLOAD_META_LEN) {
+        return false;
+    }
+    meta->camera_id = get_u16(object);
+    meta->width = get_u16(object + 2);
+    meta->height = get_u16(object + 4);
+    meta->format = object[6];
+    meta->feat_type = object[7];
+    meta->feat_len = get_u16(object + 8);
+    meta->flags = get_u16(object + 10);
+    meta->image_len = get_u32(object + 12);
+    meta->ref_id = get_u32(object + 16);
+    if (meta->feat_len > 0 && face_upload_feat_bytes(meta->feat_type, meta->feat_len) == 0) {
+        return false;
+    }
+    return face_upload_object_len(meta) == object_len;
+}
+
+uint16_t face_upload_chunk_count(size_t object_len, size_t chunk_payload) {
+    if (chunk_payload == 0) {
+        return 0;
+    }
+    size_t count = (object_len + chunk_payload - 1) / chunk_payload;
+    return count > FACE_UPLOAD_MAX_CHUNKS ? 0 : (uint16_t)count;
+}
+
+void face_upload_write_chunk_header(uint8_t *out, const face_upload_chunk_t *chunk) {
+    out[0] = FACE_UPLOAD_MAGIC0;
+    out[1] = FACE_UPLOAD_MAGIC1;
+    out[2] = FACE_UPLOAD_VERSION;
+    out[3] = 0;
+    put_u32(out + 4, chunk->upload_id);
+    put_u16(out + 8, chunk->index);
+    put_u16(out + 10, chunk->count);
+    put_u32(out + 12, chunk->total_len);
+    put_u32(out + 16, chunk->offset);
+}
+
+bool face_upload_parse_chunk(const uint8_t *msg, size_t len, face_upload_chunk_t *chunk,
+                             const uint8_t **payload, size_t *payload_len) {
+    if (len < FACE_UPLOAD_CHUNK_HEADER_LEN || msg[0] != FACE_UPLOAD_MAGIC0 || msg[1] != FACE_UPLOAD_MAGIC1 ||
+        msg[2] != FACE_UPLOAD_VERSION) {
+        return false;
+    }
+    chunk->upload_id = get_u32(msg + 4);
+    chunk->index = get_u16(msg + 8);
+    chunk->count = get_u16(msg + 10);
+    chunk->total_len = get_u32(msg + 12);
+    chunk->offset = get_u32(msg + 16);
+    *payload = msg + FACE_UPLOAD_CHUNK_HEADER_LEN;
+    *payload_len = len - FACE_UPLOAD_CHUNK_HEADER_LEN;
+    if (chunk->count == 0 || chunk->count > FACE_UPLOAD_MAX_CHUNKS || chunk->index >= chunk->count ||
+        chunk->total_len > FACE_UPLOAD_MAX_OBJECT_LEN) {
+        return false;
+    }
+    // Payload must lie inside the object (32-bit safe)
+    return chunk->offset <= chunk->total_len && *payload_len <= chunk->total_len - chunk->offset;
+}
+
+void face_upload_write_request(uint8_t *out, uint32_t upload_id) {
+    out[0] = FACE_UPLOAD_MAGIC0;
+    out[1] = FACE_UPLOAD_REQUEST_MAGIC1;
+    out[2] = FACE_UPLOAD_VERSION;
+    out[3] = 0;
+    put_u32(out + 4, upload_id);
+}
+
+bool face_upload_parse_request(const uint8_t *msg, size_t len, uint32_t *upload_id) {
+    if (len < FACE_UPLOAD_REQUEST_LEN || msg[0] != FACE_UPLOAD_MAGIC0 || msg[1] != FACE_UPLOAD_REQUEST_MAGIC1 ||
+        msg[2] != FACE_UPLOAD_VERSION) {
+        return false;
+    }
+    *upload_id = get_u32(msg + 4);
+    return true;
+}
+
+size_t face_upload_identity_len(const face_upload_identity_t *identity) {
+    return FACE_UPLOAD_IDENTITY_HEADER_LEN + identity->name_len + identity->title_len +
+           face_upload_feat_bytes(identity->feat_type, identity->feat_len);
+}
+
+void face_upload_write_identity(uint8_t *out, const face_upload_identity_t *identity) {
+    out[0] = FACE_UPLOAD_MAGIC0;
+    out[1] = FACE_UPLOAD_IDENTITY_MAGIC1;
+    out[2] = FACE_UPLOAD_VERSION;
+    out[3] = identity->feat_type;
+    put_u32(out + 4, identity->ref_id);
+    put_u32(out + 8, (uint32_t)identity->face_id);
+    put_u32(out + 12, identity->ttl_s);
+    put_u16(out + 16, identity->feat_len);
+    out[18] = identity->access_level;
+    out[19] = identity->name_len;
+    out[20] = identity->title_len;
+    memset(out + 21, 0, 3);
+    uint8_t *p = out + FACE_UPLOAD_IDENTITY_HEADER_LEN;
+    memcpy(p, identity->name, identity->name_len);
+    p += identity->name_len;
+    memcpy(p, identity->title, identity->title_len);
+    p += identity->title_len;
+    memcpy(p, identity->feat, face_upload_feat_bytes(identity->feat_type, identity->feat_len));
+}
+
+bool face_upload_parse_identity(const uint8_t *msg, size_t len, face_upload_identity_t *identity) {
+    if (len < FACE_UPLOAD_IDENTITY_HEADER_LEN || msg[0] != FACE_UPLOAD_MAGIC0 ||
+        msg[1] != FACE_UPLOAD_IDENTITY_MAGIC1 || msg[2] != FACE_UPLOAD_VERSION) {
+        return false;
+    }
+    identity->feat_type = msg[3];
+    identity->ref_id = get_u32(msg + 4);
+    identity->face_id = (int32_t)get_u32(msg + 8);
+    identity->ttl_s = get_u32(msg + 12);
+    identity->feat_len = get_u16(msg + 16);
+    identity->access_level = msg[18];
+    identity->name_len = msg[19];
+    identity->title_len = msg[20];
+    identity->name = (const char *)msg + FACE_UPLOAD_IDENTITY_HEADER_LEN;
+    identity->title = identity->name + identity->name_len;
+    identity->feat = (const uint8_t *)identity->title + identity->title_len;
+    if (identity->feat_len > 0 && face_upload_feat_bytes(identity->feat_type, identity->feat_len) == 0) {
+        return false;
+    }
+    return face_upload_identity_len(identity) == len;
+}
+
+void face_upload_write_sighting(uint8_t *out, const face_upload_sighting_t *sighting) {
+    out[0] = FACE_UPLOAD_MAGIC0;
+    out[1] = FACE_UPLOAD_SIGHTING_MAGIC1;
+    out[2] = FACE_UPLOAD_VERSION;
+    out[3] = 0;
+    put_u32(out + 4, sighting->cluster_id);
+    put_u32(out + 8, sighting->sightings);
+    put_u32(out + 12, sighting->new_sightings);
+    put_u16(out + 16, sighting->camera_id);
+    put_u16(out + 18, sighting->duration_s);
+}
+
+bool face_upload_parse_sighting(const uint8_t *msg, size_t len, face_upload_sighting_t *sighting) {
+    if (len < FACE_UPLOAD_SIGHTING_LEN || msg[0] != FACE_UPLOAD_MAGIC0 || msg[1] != FACE_UPLOAD_SIGHTING_MAGIC1 ||
+        msg[2] != FACE_UPLOAD_VERSION) {
+        return false;
+    }
+    sighting->cluster_id = get_u32(msg + 4);
+    sighting->sightings = get_u32(msg + 8);
+    sighting->new_sightings = get_u32(msg + 12);
+    sighting->camera_id = get_u16(msg + 16);
+    sighting->duration_s = get_u16(msg + 18);
+    return true;
+}
+
+size_t face_upload_matches_len(uint8_t count) {
+    return FACE_UPLOAD_MATCH_HEADER_LEN + (size_t)count * 8;
+}
+
+void face_upload_write_matches(uint8_t *out, uint32_t ref_id, const face_upload_match_t *matches, uint8_t count) {
+    out[0] = FACE_UPLOAD_MAGIC0;
+    out[1] = FACE_UPLOAD_MATCH_MAGIC1;
+    out[2] = FACE_UPLOAD_VERSION;
+    out[3] = count;
+    put_u32(out + 4, ref_id);
+    for (int i = 0; i < count; i++) {
+        put_u32(out + FACE_UPLOAD_MATCH_HEADER_LEN + i * 8, (uint32_t)matches[i].face_id);
+        put_f32(out + FACE_UPLOAD_MATCH_HEADER_LEN + i * 8 + 4, matches[i].similarity);
+    }
+}
+
+int face_upload_parse_matches(const uint8_t *msg, size_t len, uint32_t *ref_id, face_upload_match_t *matches,
+                              int max) {
+    if (len < FACE_UPLOAD_MATCH_HEADER_LEN || msg[0] != FACE_UPLOAD_MAGIC0 || msg[1] != FACE_UPLOAD_MATCH_MAGIC1 ||
+        msg[2] != FACE_UPLOAD_VERSION || len != face_upload_matches_len(msg[3])) {
+        return -1;
+    }
+    *ref_id = get_u32(msg + 4);
+    for (int i = 0; i < msg[3] && i < max; i++) {
+        matches[i].face_id = (int32_t)get_u32(msg + FACE_UPLOAD_MATCH_HEADER_LEN + i * 8);
+        matches[i].similarity = get_f32(msg + FACE_UPLOAD_MATCH_HEADER_LEN + i * 8 + 4);
+    }
+    return msg[3];
+}
+
+/* ---------- Receiver side ---------- */
+
+static void release_slot(face_upload_rx_slot_t *slot) {
+    free(slot->object);
+    free(slot->seen);
+    memset(slot, 0, sizeof(*slot));
+}
+
+void face_upload_rx_init(face_upload_rx_t *rx) {
+    memset(rx, 0, sizeof(*rx));
+    rx->done_slot = -1;
+}
+
+void face_upload_rx_free(face_upload_rx_t *rx) {
+    for (int i = 0; i < FACE_UPLOAD_RX_SLOTS; i++) {
+        release_slot(&rx->slots[i]);
+    }
+    rx->done_slot = -1;
+}
+
+// Slot of an upload: the one already receiving it, a free one, or the stalest
+static face_upload_rx_slot_t *get_slot(face_upload_rx_t *rx, const face_upload_chunk_t *chunk, int64_t now_us) {
+    face_upload_rx_slot_t *free_slot = NULL;
+    face_upload_rx_slot_t *stale = &rx->slots[0];
+    for (int i = 0; i < FACE_UPLOAD_RX_SLOTS; i++) {
+        face_upload_rx_slot_t *slot = &rx->slots[i];
+        if (slot->object && slot->upload_id == chunk->upload_id) {
+            // Same id with another shape: the sender restarted, start over
+            if (slot->total_len != chunk->total_len || slot->count != chunk->count) {
+                release_slot(slot);
+                free_slot = slot;
+                break;
+            }
+            return slot;
+        }
+        if (!slot->object && !free_slot) {
+            free_slot = slot;
+        }
+        if (slot->last_us < stale->last_us) {
+            stale = slot;
+        }
+    }
+    face_upload_rx_slot_t *slot = free_slot;
+    if (!slot) {
+        rx->dropped++;
+        release_slot(stale);
+        slot = stale;
+    }
+    slot->object = malloc(chunk->total_len > 0 ? chunk->total_len : 1);
+    slot->seen = calloc((chunk->count + 7) / 8, 1);
+    if (!slot->object || !slot->seen) {
+        release_slot(slot);
+        return NULL;
+    }
+    slot->upload_id = chunk->upload_id;
+    slot->total_len = chunk->total_len;
+    slot->count = chunk->count;
+    slot->first_us = now_us;
+    slot->last_us = now_us;
+    return slot;
+}
+
+bool face_upload_rx_feed(face_upload_rx_t *rx, const uint8_t *msg, size_t len, int64_t now_us,
+                         face_upload_rx_done_t *done) {
+    if (rx->done_slot >= 0) {
+        release_slot(&rx->slots[rx->done_slot]);
+        rx->done_slot = -1;
+    }
+
+    face_upload_chunk_t chunk;
+    const uint8_t *payload;
+    size_t payload_len;
+    if (!face_upload_parse_chunk(msg, len, &chunk, &payload, &payload_len)) {
+        rx->dropped++;
+        return false;
+    }
+    for (int i = 0; i < FACE_UPLOAD_RX_SLOTS; i++) {
+        if (rx->recent[i] == chunk.upload_id && chunk.upload_id != 0) {
+            rx->duplicates++;
+            return false;
+        }
+    }
+    face_upload_rx_slot_t *slot = get_slot(rx, &chunk, now_us);
+    if (!slot) {
+        rx->dropped++;
+        return false;
+    }
+    if (slot->seen[chunk.index / 8] & (1 << (chunk.index % 8))) {
+        rx->duplicates++;
+        return false;
+    }
+    memcpy(slot->object + chunk.offset, payload, payload_len);
+    slot->seen[chunk.index / 8] |= 1 << (chunk.index % 8);
+    slot->received++;
+    slot->last_us = now_us;
+    if (slot->received < slot->count) {
+        return false;
+    }
+
+    rx->done_slot = (int)(slot - rx->slots);
+    rx->recent[rx->recent_pos] = slot->upload_id;
+    rx->recent_pos = (rx->recent_pos + 1) % FACE_UPLOAD_RX_SLOTS;
+    memset(done, 0, sizeof(*done));
+    if (!face_upload_read_meta(slot->object, slot->total_len, &done->meta)) {
+        rx->dropped++;
+        return false;
+    }
+    done->upload_id = slot->upload_id;
+    done->object = slot->object;
+    done->object_len = slot->total_len;
+    done->feat = slot->object + FACE_UPLOAD_META_LEN;
+    done->image = done->feat + face_upload_feat_bytes(done->meta.feat_type, done->meta.feat_len);
+    done->first_us = slot->first_us;
+    done->last_us = slot->last_us;
+    return true;
+}
@@ -0,0 +1,251 @@
+/**
+ * @file face_upload_proto.h
+ * @brief Wire format of the face uploads to the cloud tier (MQTT).
+ *
+ * An upload is one object: a meta header, the embedding and the image
+ * (either may be absent: embedding-only uploads, image replies).
+ * It is split into chunks that fit one MQTT message each. Every chunk
+ * carries a small header (upload id, index, offset, total length), so the
+ * receiver can reassemble chunks in any order and ignore duplicates
+ * (QoS1 redelivery).
+ *
+ * All fields are little endian. No ESP-IDF dependencies: the same file is
+ * built by the cloud-tier receiver on the host.
+ *
+ * Chunk:  | magic 'F''U' | version | flags | upload_id u32 | index u16 | count u16 |
+ *         | total_len u32 | offset u32 | payload ... |
+ * Object: | camera_id u16 | width u16 | height u16 | format u8 | feat_type u8 |
+ *         | feat_len u16 | flags u16 | image_len u32 | ref_id u32 | feat ... | image ... |
+ * Feat:   F32: feat_len floats. I8: scale f32, then feat_len int8 (value = q * scale).
+ *
+ * Image request (downlink, cloud to S3): | magic 'F''R' | version | 0 | upload_id u32 |
+ * Identity (downlink, cloud to S3):      | magic 'F''I' | version | feat_type | ref_id u32 | face_id i32 |
+ *         | ttl_s u32 | feat_len u16 | access_level u8 | name_len u8 | title_len u8 | 0 0 0 |
+ *         | name ... | title ... | feat ... |
+ * Sighting (uplink, no chunks):          | magic 'F''S' | version | 0 | cluster_id u32 | sightings u32 |
+ *         | new_sightings u32 | camera_id u16 | duration_s u16 |
+ * Matches (downlink, top-k of an upload): | magic 'F''M' | version | count u8 | ref_id u32 |
+ *         | count x (face_id i32 | similarity f32) |
+ */
+
+#ifndef FACE_UPLOAD_PROTO_H
+#define FACE_UPLOAD_PROTO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FACE_UPLOAD_MAGIC0 'F'
+#define FACE_UPLOAD_MAGIC1 'U'
+#define FACE_UPLOAD_VERSION 2
+#define FACE_UPLOAD_CHUNK_HEADER_LEN 20
+#define FACE_UPLOAD_META_LEN 20
+#define FACE_UPLOAD_REQUEST_MAGIC1 'R'
+#define FACE_UPLOAD_REQUEST_LEN 8
+#define FACE_UPLOAD_IDENTITY_MAGIC1 'I'
+#define FACE_UPLOAD_IDENTITY_HEADER_LEN 24
+#define FACE_UPLOAD_SIGHTING_MAGIC1 'S'
+#define FACE_UPLOAD_SIGHTING_LEN 20
+#define FACE_UPLOAD_MATCH_MAGIC1 'M'
+#define FACE_UPLOAD_MATCH_HEADER_LEN 8
+#define FACE_UPLOAD_MATCH_MAX 32 // results per message
+#define FACE_UPLOAD_MAX_CHUNKS 4096 // bounds the receiver bitmap
+#define FACE_UPLOAD_MAX_OBJECT_LEN (1024 * 1024) // bounds the receiver buffer
+
+// Embedding encoding in the object
+typedef enum {
+    FACE_UPLOAD_FEAT_F32 = 0,
+    FACE_UPLOAD_FEAT_I8 = 1, // symmetric, one scale per vector
+} face_upload_feat_type_t;
+
+// Meta flags
+#define FACE_UPLOAD_FLAG_IMAGE_HELD 0x0001 // no image sent, the S3 keeps it for an image request
+#define FACE_UPLOAD_FLAG_IMAGE_REPLY 0x0002 // image requested for upload ref_id
+
+typedef struct {
+    uint32_t upload_id;   // unique per upload (per device boot)
+    uint16_t index;       // chunk number, 0..count-1
+    uint16_t count;       // chunks in the upload
+    uint32_t total_len;   // object length
+    uint32_t offset;      // position of the payload in the object
+} face_upload_chunk_t;
+
+typedef struct {
+    uint16_t camera_id;
+    uint16_t width;
+    uint16_t height;
+    uint8_t format;       // image_pix_format_t of the S3
+    uint8_t feat_type;    // face_upload_feat_type_t
+    uint16_t feat_len;    // elements
+    uint16_t flags;       // FACE_UPLOAD_FLAG_*
+    uint32_t image_len;   // bytes
+    uint32_t ref_id;      // image reply: the upload the image belongs to; face: its unknown-face cluster, 0 if none
+} face_upload_meta_t;
+
+/** @brief Sightings of an unknown-face cluster that were not uploaded (unknown_cluster.h). */
+typedef struct {
+    uint32_t cluster_id;  // ref_id of the uploads of the cluster
+    uint32_t sightings;   // total so far
+    uint32_t new_sightings; // since the last upload or report
+    uint16_t camera_id;   // last sighting
+    uint16_t duration_s;  // first to last sighting
+} face_upload_sighting_t;
+
+/** @brief Bytes of an encoded embedding, 0 for an unknown type. */
+size_t face_upload_feat_bytes(uint8_t feat_type, uint16_t feat_len);
+
+/**
+ * @brief Encodes a float embedding as FACE_UPLOAD_FEAT_I8 (scale + int8), feat_bytes(I8, len) bytes.
+ */
+void face_upload_quantize_i8(const float *feat, uint16_t len, uint8_t *out);
+
+/**
+ * @brief Decodes an embedding of any type to floats.
+ * @return false for an unknown type.
+ */
+bool face_upload_decode_feat(uint8_t feat_type, uint16_t feat_len, const uint8_t *in, float *out);
+
+/** @brief Writes an image request for an upload, FACE_UPLOAD_REQUEST_LEN bytes. */
+void face_upload_write_request(uint8_t *out, uint32_t upload_id);
+
+/** @brief Parses an image request. */
+bool face_upload_parse_request(const uint8_t *msg, size_t len, uint32_t *upload_id);
+
+/** @brief An identity the cloud found for an upload. Strings are not NUL terminated. */
+typedef struct {
+    uint32_t ref_id;      // upload answered, 0 if unsolicited
+    int32_t face_id;      // cloud id
+    uint32_t ttl_s;       // how long the S3 may keep it, 0 for its default
+    uint8_t access_level;
+    uint8_t feat_type;    // face_upload_feat_type_t
+    uint16_t feat_len;    // elements
+    const char *name;
+    uint8_t name_len;
+    const char *title;
+    uint8_t title_len;
+    const uint8_t *feat;  // feat_bytes(feat_type, feat_len) bytes
+} face_upload_identity_t;
+
+/** @brief Encoded length of an identity message. */
+size_t face_upload_identity_len(const face_upload_identity_t *identity);
+
+/** @brief Writes an identity message, face_upload_identity_len() bytes. */
+void face_upload_write_identity(uint8_t *out, const face_upload_identity_t *identity);
+
+/**
+ * @brief Parses an identity message. The pointers of the result point into msg.
+ * @return false if it is not a valid identity message.
+ */
+bool face_upload_parse_identity(const uint8_t *msg, size_t len, face_upload_identity_t *identity);
+
+/** @brief Writes a sighting message, FACE_UPLOAD_SIGHTING_LEN bytes. */
+void face_upload_write_sighting(uint8_t *out, const face_upload_sighting_t *sighting);
+
+/** @brief Parses a sighting message. */
+bool face_upload_parse_sighting(const uint8_t *msg, size_t len, face_upload_sighting_t *sighting);
+
+/** @brief One result of a top-k identification. */
+typedef struct {
+    int32_t face_id;      // cloud id
+    float similarity;     // cosine
+} face_upload_match_t;
+
+/** @brief Encoded length of a match list. */
+size_t face_upload_matches_len(uint8_t count);
+
+/** @brief Writes a match list (count <= FACE_UPLOAD_MATCH_MAX), face_upload_matches_len() bytes. */
+void face_upload_write_matches(uint8_t *out, uint32_t ref_id, const face_upload_match_t *matches, uint8_t count);
+
+/**
+ * @brief Parses a match list, keeps up to max results.
+ * @return Results in the message, -1 if it is not a valid match list.
+ */
+int face_upload_parse_matches(const uint8_t *msg, size_t len, uint32_t *ref_id, face_upload_match_t *matches,
+                              int max);
+
+/** @brief Object length for the meta (header + embedding + image). */
+size_t face_upload_object_len(const face_upload_meta_t *meta);
+
+/** @brief Writes the meta header, FACE_UPLOAD_META_LEN bytes. */
+void face_upload_write_meta(uint8_t *out, const face_upload_meta_t *meta);
+
+/**
+ * @brief Reads and checks the meta header of a complete object.
+ * @return false if the object length does not match the meta.
+ */
+bool face_upload_read_meta(const uint8_t *object, size_t object_len, face_upload_meta_t *meta);
+
+/** @brief Chunks needed for an object, each carrying up to chunk_payload bytes. */
+uint16_t face_upload_chunk_count(size_t object_len, size_t chunk_payload);
+
+/** @brief Writes a chunk header, FACE_UPLOAD_CHUNK_HEADER_LEN bytes. */
+void face_upload_write_chunk_header(uint8_t *out, const face_upload_chunk_t *chunk);
+
+/**
+ * @brief Parses a received chunk message.
+ * @return false if it is not a valid chunk.
+ */
+bool face_upload_parse_chunk(const uint8_t *msg, size_t len, face_upload_chunk_t *chunk,
+                             const uint8_t **payload, size_t *payload_len);
+
+/* ---------- Receiver side ---------- */
+
+#define FACE_UPLOAD_RX_SLOTS 4 // uploads reassembled at the same time
+
+typedef struct {
+    uint32_t upload_id;
+    uint8_t *object;      // total_len bytes, NULL when the slot is free
+    uint32_t total_len;
+    uint16_t count;
+    uint16_t received;
+    uint8_t *seen;        // bitmap of received chunks
+    int64_t first_us;     // arrival of the first chunk
+    int64_t last_us;      // arrival of the latest chunk
+} face_upload_rx_slot_t;
+
+typedef struct {
+    face_upload_rx_slot_t slots[FACE_UPLOAD_RX_SLOTS];
+    uint32_t duplicates;  // chunks received twice
+    uint32_t dropped;     // invalid chunks or uploads evicted before completion
+    int done_slot;        // completed upload, released on the next feed, -1 if none
+    uint32_t recent[FACE_UPLOAD_RX_SLOTS]; // completed upload ids, late redeliveries are duplicates
+    int recent_pos;
+} face_upload_rx_t;
+
+/** @brief A completed upload. The object stays valid until the next feed. */
+typedef struct {
+    uint32_t upload_id;
+    face_upload_meta_t meta;
+    const uint8_t *object;
+    size_t object_len;
+    const uint8_t *feat;  // into object
+    const uint8_t *image; // into object
+    int64_t first_us;
+    int64_t last_us;
+} face_upload_rx_done_t;
+
+void face_upload_rx_init(face_upload_rx_t *rx);
+void face_upload_rx_free(face_upload_rx_t *rx);
+
+/**
+ * @brief Feeds one received chunk message.
+ *
+ * A new upload takes a free slot, or the slot that made progress longest
+ * ago (that incomplete upload is dropped).
+ *
+ * @param now_us Arrival time, any monotonic clock.
+ * @param done Filled when this chunk completed an upload.
+ * @return true if an upload completed.
+ */
+bool face_upload_rx_feed(face_upload_rx_t *rx, const uint8_t *msg, size_t len, int64_t now_us,
+                         face_upload_rx_done_t *done);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FACE_UPLOAD_PROTO_H
@@ -0,0 +1,276 @@
+/**
+ * @file health_telemetry.c
+ * @brief Heap, stack and CPU snapshots sampled by a task, published as compact JSON.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "health_telemetry.h"
+
+#define CPU_STATS (configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS)
+#if defined(configTASKLIST_INCLUDE_COREID) && configTASKLIST_INCLUDE_COREID
+#define TASK_CORE 1
+#else
+#define TASK_CORE 0 // TaskStatus_t has no xCoreID
+#endif
+#define PREVIOUS_TASKS 48 // run-time counters of the previous sample, matched by task number
+
+static const char *TAG = "HEALTH";
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint8_t priority;
+    int8_t core;          // pinned core, -1 for none
+    uint32_t stack_free;  // bytes never used
+    int16_t cpu_permille; // of one core, -1 unknown
+} task_health_t;
+
+typedef struct {
+    int64_t uptime_us;
+    uint32_t internal[3]; // free, largest free block, minimum ever free
+    uint32_t psram[3];
+    uint32_t heap_min;
+    bool has_cpu;
+    int16_t core_permille[portNUM_PROCESSORS];
+    int task_count;       // listed, the busiest
+    task_health_t tasks[HEALTH_TELEMETRY_MAX_TASKS];
+} snapshot_t;
+
+static struct {
+    const char *device;
+    int period_ms;
+    health_telemetry_publish_t publish;
+    void *ctx;
+    SemaphoreHandle_t lock; // latest
+    snapshot_t latest;
+    bool has_latest;
+    snapshot_t work;
+#if CPU_STATS
+    configRUN_TIME_COUNTER_TYPE previous_total;
+    int previous_count;   // -1 before the first sample
+    UBaseType_t previous_number[PREVIOUS_TASKS];
+    configRUN_TIME_COUNTER_TYPE previous_counter[PREVIOUS_TASKS];
+#endif
+} s_health = {
+#if CPU_STATS
+    .previous_count = -1,
+#endif
+};
+
+static void sample_memory(snapshot_t *snap) {
+    const uint32_t caps[2] = { MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_SPIRAM };
+    uint32_t *out[2] = { snap->internal, snap->psram };
+    for (int i = 0; i < 2; i++) {
+        out[i][0] = heap_caps_get_free_size(caps[i]);
+        out[i][1] = heap_caps_get_largest_free_block(caps[i]);
+        out[i][2] = heap_caps_get_minimum_free_size(caps[i]);
+    }
+    snap->heap_min = esp_get_minimum_free_heap_size();
+}
+
+#if configUSE_TRACE_FACILITY
+#if CPU_STATS
+// Run time of the task since the previous sample, all of it for a task started since
+static configRUN_TIME_COUNTER_TYPE task_delta(const TaskStatus_t *status) {
+    for (int i = 0; i < s_health.previous_count; i++) {
+        if (s_health.previous_number[i] == status->xTaskNumber) {
+            return status->ulRunTimeCounter - s_health.previous_counter[i];
+        }
+    }
+    return status->ulRunTimeCounter;
+}
+
+static int16_t permille(configRUN_TIME_COUNTER_TYPE part, configRUN_TIME_COUNTER_TYPE total) {
+    uint64_t p = total ? (uint64_t)part * 1000 / total : 0;
+    return (int16_t)(p > 1000 ? 1000 : p);
+}
+#endif
+
+static void sample_tasks(snapshot_t *snap) {
+    snap->task_count = 0;
+    snap->has_cpu = false;
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + 4; // tasks created meanwhile
+    TaskStatus_t *status = malloc(capacity * sizeof(TaskStatus_t));
+    task_health_t *all = malloc(capacity * sizeof(task_health_t));
+    if (!status || !all) {
+        free(status);
+        free(all);
+        ESP_LOGW(TAG, "No memory for the task list");
+        return;
+    }
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, capacity, &total);
+
+#if CPU_STATS
+    configRUN_TIME_COUNTER_TYPE elapsed = total - s_health.previous_total;
+    snap->has_cpu = s_health.previous_count >= 0 && elapsed > 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        snap->core_permille[core] = -1;
+    }
+#endif
+    for (UBaseType_t i = 0; i < count; i++) {
+        task_health_t *t = &all[i];
+        strlcpy(t->name, status[i].pcTaskName, sizeof(t->name));
+        t->priority = (uint8_t)status[i].uxCurrentPriority;
+#if TASK_CORE
+        t->core = status[i].xCoreID == tskNO_AFFINITY ? -1 : (int8_t)status[i].xCoreID;
+#else
+        t->core = -1;
+#endif
+        t->stack_free = (uint32_t)status[i].usStackHighWaterMark; // bytes: ESP-IDF stacks are in bytes
+        t->cpu_permille = -1;
+#if CPU_STATS
+        if (snap->has_cpu) {
+            t->cpu_permille = permille(task_delta(&status[i]), elapsed);
+            for (int core = 0; core < portNUM_PROCESSORS; core++) {
+                if (status[i].xHandle == xTaskGetIdleTaskHandleForCore(core)) {
+                    snap->core_permille[core] = (int16_t)(1000 - t->cpu_permille);
+                }
+            }
+        }
+#endif
+    }
+#if CPU_STATS
+    s_health.previous_total = total;
+    s_health.previous_count = count < PREVIOUS_TASKS ? (int)count : PREVIOUS_TASKS;
+    for (int i = 0; i < s_health.previous_count; i++) {
+        s_health.previous_number[i] = status[i].xTaskNumber;
+        s_health.previous_counter[i] = status[i].ulRunTimeCounter;
+    }
+#endif
+
+    // The busiest first, by the smallest stack margin without CPU shares
+    for (UBaseType_t i = 1; i < count; i++) {
+        task_health_t t = all[i];
+        UBaseType_t j = i;
+        while (j > 0 && (snap->has_cpu ? all[j - 1].cpu_permille < t.cpu_permille
+                                       : all[j - 1].stack_free > t.stack_free)) {
+            all[j] = all[j - 1];
+            j--;
+        }
+        all[j] = t;
+    }
+    snap->task_count = count < HEALTH_TELEMETRY_MAX_TASKS ? (int)count : HEALTH_TELEMETRY_MAX_TASKS;
+    memcpy(snap->tasks, all, snap->task_count * sizeof(task_health_t));
+    free(status);
+    free(all);
+}
+#endif
+
+static size_t snapshot_to_json(const snapshot_t *snap, char *buf, size_t len) {
+    size_t n = (size_t)snprintf(buf, len,
+                                "{\"type\":\"health\",\"dev\":\"%s\",\"up\":%lld,\"int\":[%lu,%lu,%lu],"
+                                "\"psram\":[%lu,%lu,%lu],\"heap_min\":%lu",
+                                s_health.device, (long long)(snap->uptime_us / 1000000),
+                                (unsigned long)snap->internal[0], (unsigned long)snap->internal[1],
+                                (unsigned long)snap->internal[2], (unsigned long)snap->psram[0],
+                                (unsigned long)snap->psram[1], (unsigned long)snap->psram[2],
+                                (unsigned long)snap->heap_min);
+    if (snap->has_cpu && n < len) {
+        n += (size_t)snprintf(buf + n, len - n, ",\"cpu\":[");
+        for (int core = 0; core < portNUM_PROCESSORS && n < len; core++) {
+            n += (size_t)snprintf(buf + n, len - n, "%s%.1f", core ? "," : "", snap->core_permille[core] / 10.0);
+        }
+        if (n < len) {
+            n += (size_t)snprintf(buf + n, len - n, "]");
+        }
+    }
+    if (snap->task_count > 0 && n < len) {
+        n += (size_t)snprintf(buf + n, len - n, ",\"tasks\":[");
+        for (int i = 0; i < snap->task_count && n < len; i++) {
+            const task_health_t *t = &snap->tasks[i];
+            n += (size_t)snprintf(buf + n, len - n, "%s[\"%s\",%u,%d,%lu,%.1f]", i ? "," : "", t->name,
+                                  (unsigned)t->priority, (int)t->core, (unsigned long)t->stack_free,
+                                  t->cpu_permille < 0 ? -1.0 : t->cpu_permille / 10.0);
+        }
+        if (n < len) {
+            n += (size_t)snprintf(buf + n, len - n, "]");
+        }
+    }
+    if (n < len) {
+        n += (size_t)snprintf(buf + n, len - n, "}");
+    }
+    return n < len ? n : 0;
+}
+
+static void health_task(void *arg) {
+    char *json = malloc(HEALTH_TELEMETRY_JSON_SIZE);
+    while (json) {
+        snapshot_t *snap = &s_health.work;
+        memset(snap, 0, sizeof(*snap));
+        snap->uptime_us = esp_timer_get_time();
+        sample_memory(snap);
+#if configUSE_TRACE_FACILITY
+        sample_tasks(snap);
+#endif
+        xSemaphoreTake(s_health.lock, portMAX_DELAY);
+        s_health.latest = *snap;
+        s_health.has_latest = true;
+        xSemaphoreGive(s_health.lock);
+
+        if (snapshot_to_json(snap, json, HEALTH_TELEMETRY_JSON_SIZE) > 0) {
+            s_health.publish(s_health.device, json, s_health.ctx);
+        } else {
+            ESP_LOGW(TAG, "Snapshot larger than %d bytes, not published", HEALTH_TELEMETRY_JSON_SIZE);
+        }
+        vTaskDelay(pdMS_TO_TICKS(s_health.period_ms));
+    }
+    ESP_LOGE(TAG, "No memory for the snapshot, telemetry stopped");
+    vTaskDelete(NULL);
+}
+
+esp_err_t health_telemetry_start(const char *device, int period_ms, health_telemetry_publish_t publish, void *ctx) {
+    if (s_health.lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!device || !publish || period_ms <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_health.lock = xSemaphoreCreateMutex();
+    if (!s_health.lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_health.device = device;
+    s_health.period_ms = period_ms;
+    s_health.publish = publish;
+    s_health.ctx = ctx;
+#if !configUSE_TRACE_FACILITY
+    ESP_LOGW(TAG, "CONFIG_FREERTOS_USE_TRACE_FACILITY is off, no task stacks and CPU shares");
+#elif !CPU_STATS
+    ESP_LOGW(TAG, "CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS is off, no CPU shares");
+#endif
+    if (xTaskCreate(health_task, "health", 4096, NULL, 2, NULL) != pdPASS) {
+        vSemaphoreDelete(s_health.lock);
+        s_health.lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Health telemetry of '%s' every %d ms", device, period_ms);
+    return ESP_OK;
+}
+
+void health_telemetry_forward(const char *source, const char *json) {
+    if (s_health.lock && source && json) {
+        s_health.publish(source, json, s_health.ctx);
+    }
+}
+
+size_t health_telemetry_to_json(char *buf, size_t len) {
+    if (!s_health.lock || !buf || len == 0) {
+        return 0;
+    }
+    size_t n = 0;
+    xSemaphoreTake(s_health.lock, portMAX_DELAY);
+    if (s_health.has_latest) {
+        n = snapshot_to_json(&s_health.latest, buf, len);
+    }
+    xSemaphoreGive(s_health.lock);
+    return n;
+}
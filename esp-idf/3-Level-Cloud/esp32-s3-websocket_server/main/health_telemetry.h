@@ -0,0 +1,75 @@
+/**
+ * @file health_telemetry.h
+ * @brief Periodic runtime health snapshot: heap, PSRAM, stack watermarks, CPU per task and per core.
+ *
+ * A task samples every period:
+ *   - free size, largest free block and minimum ever free of the internal RAM and of the PSRAM,
+ *     the minimum ever free heap
+ *   - per task: priority, pinned core, stack high-water mark (bytes never used) and the CPU share
+ *     since the previous sample, from the FreeRTOS run-time counters (uxTaskGetSystemState())
+ *   - per core: 100% minus the share of its idle task
+ * and hands it to a callback as one compact JSON text (MQTT on the S3, the WebSocket on the camera):
+ *   {"type":"health","dev":"s3","up":s,"int":[free,largest,min],"psram":[free,largest,min],"heap_min":b,
+ *    "cpu":[core0,core1],"tasks":[[name,priority,core,stack_free,cpu],..]}
+ * Sizes in bytes, CPU in % of one core, tasks by CPU share (the busiest HEALTH_TELEMETRY_MAX_TASKS),
+ * core -1 for a task that is not pinned. The first snapshot has no CPU shares yet (-1).
+ *
+ * The task list needs CONFIG_FREERTOS_USE_TRACE_FACILITY, the CPU shares
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS and the pinned core
+ * CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID (TaskStatus_t::xCoreID), all set in the
+ * sdkconfig of both firmwares. Without them the fields are left out.
+ *
+ * Both firmwares build this file.
+ */
+
+#ifndef HEALTH_TELEMETRY_H
+#define HEALTH_TELEMETRY_H
+
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HEALTH_TELEMETRY_MAX_TASKS 24
+#define HEALTH_TELEMETRY_JSON_SIZE 1600 // a snapshot with HEALTH_TELEMETRY_MAX_TASKS tasks fits
+
+/**
+ * @brief Receives the snapshots, from the telemetry task.
+ *
+ * @param source The device: the name given to health_telemetry_start(), or the one given to
+ *               health_telemetry_forward() for a snapshot of another device.
+ * @param json The snapshot.
+ */
+typedef void (*health_telemetry_publish_t)(const char *source, const char *json, void *ctx);
+
+/**
+ * @brief Starts the telemetry task.
+ *
+ * @param device Name of this device in the snapshots ("dev"), a string literal.
+ * @param period_ms Time between two snapshots.
+ * @param publish Called with each snapshot.
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if already started, ESP_ERR_INVALID_ARG, ESP_ERR_NO_MEM.
+ */
+esp_err_t health_telemetry_start(const char *device, int period_ms, health_telemetry_publish_t publish, void *ctx);
+
+/**
+ * @brief Hands the snapshot of another device (e.g. a camera over the WebSocket) to the callback.
+ *
+ * Called from the task that received it. Does nothing before health_telemetry_start().
+ */
+void health_telemetry_forward(const char *source, const char *json);
+
+/**
+ * @brief Writes the latest snapshot of this device.
+ *
+ * @return Length written (without the terminating 0), 0 before the first snapshot or if the buffer is too small.
+ */
+size_t health_telemetry_to_json(char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HEALTH_TELEMETRY_H
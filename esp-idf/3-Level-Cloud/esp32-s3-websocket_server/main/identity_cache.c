@@ -0,0 +1,253 @@
+/**
+ * @file identity_cache.c
+ * @brief Per-camera LRU cache of recently recognized identities.
+ *
+ * Each camera slot holds IDENTITY_CACHE_SIZE entries. The embeddings of a
+ * slot are one contiguous float block, so a lookup is a few dot products
+ * over memory that is already hot, instead of a walk over the whole
+ * database list.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "config.h"
+#include "identity_cache.h"
+
+static const char* TAG = "ID_CACHE";
+
+typedef struct {
+    int id;              // database id, -1 when the entry is free
+    int64_t expires_us;  // entry is ignored after this time
+    uint32_t last_used;  // LRU stamp
+} cache_entry_t;
+
+typedef struct {
+    int camera_id;       // owner of the slot, -1 when unused
+    uint32_t last_used;  // LRU stamp of the camera, for the slot takeover
+    cache_entry_t entries[IDENTITY_CACHE_SIZE];
+    float* feats;        // IDENTITY_CACHE_SIZE * feat_len floats
+} camera_cache_t;
+
+static struct {
+    int feat_len;
+    uint32_t clock;      // LRU clock, bumped on every use
+    camera_cache_t cameras[IDENTITY_CACHE_MAX_CAMERAS];
+
+    // stats
+    uint32_t lookups;
+    uint32_t hits;
+    uint32_t inserts;
+    uint32_t evictions;
+    uint32_t camera_evictions;
+    uint32_t db_queries;
+    int64_t lookup_us_total;
+    int64_t query_us_total;
+} s_cache = { 0 };
+
+static void clear_camera(camera_cache_t* cam) {
+    for (int i = 0; i < IDENTITY_CACHE_SIZE; i++) {
+        cam->entries[i].id = -1;
+        cam->entries[i].expires_us = 0;
+        cam->entries[i].last_used = 0;
+    }
+}
+
+// Slot of a camera. A new camera takes an unused slot, else the slot of the
+// camera seen least recently: only more than IDENTITY_CACHE_MAX_CAMERAS cameras
+// push each other out, whatever their ids. With create=false a missing camera returns NULL.
+static camera_cache_t* get_camera(int camera_id, bool create) {
+    if (s_cache.feat_len <= 0 || camera_id < 0) {
+        return NULL;
+    }
+    camera_cache_t* cam = NULL;
+    for (int c = 0; c < IDENTITY_CACHE_MAX_CAMERAS; c++) {
+        camera_cache_t* slot = &s_cache.cameras[c];
+        if (slot->camera_id == camera_id) {
+            return slot;
+        }
+        if (!cam || (cam->camera_id >= 0 && (slot->camera_id < 0 || slot->last_used < cam->last_used))) {
+            cam = slot;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    if (!cam->feats) {
+        cam->feats = malloc((size_t)IDENTITY_CACHE_SIZE * s_cache.feat_len * sizeof(float));
+        if (!cam->feats) {
+            ESP_LOGE(TAG, "No memory for camera %d cache", camera_id);
+            return NULL;
+        }
+    }
+    if (cam->camera_id >= 0) {
+        ESP_LOGD(TAG, "Camera %d takes over cache slot of camera %d", camera_id, cam->camera_id);
+        s_cache.camera_evictions++;
+    }
+    cam->camera_id = camera_id;
+    clear_camera(cam);
+    return cam;
+}
+
+static float dot(const float* a, const float* b, int len) {
+    float sum = 0;
+    for (int i = 0; i < len; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+esp_err_t identity_cache_init(int feat_len) {
+    if (feat_len <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    identity_cache_deinit();
+    s_cache.feat_len = feat_len;
+    ESP_LOGI(TAG, "Identity cache: %d cameras x %d entries, TTL %d ms, %d floats per embedding",
+             IDENTITY_CACHE_MAX_CAMERAS, IDENTITY_CACHE_SIZE, IDENTITY_CACHE_TTL_MS, feat_len);
+    return ESP_OK;
+}
+
+void identity_cache_deinit(void) {
+    for (int c = 0; c < IDENTITY_CACHE_MAX_CAMERAS; c++) {
+        free(s_cache.cameras[c].feats);
+    }
+    memset(&s_cache, 0, sizeof(s_cache));
+    for (int c = 0; c < IDENTITY_CACHE_MAX_CAMERAS; c++) {
+        s_cache.cameras[c].camera_id = -1;
+    }
+}
+
+int identity_cache_lookup(int camera_id, const float* feat, float thr, float* out_sim) {
+    int64_t start = esp_timer_get_time();
+    s_cache.lookups++;
+
+    int best = -1;
+    float best_sim = thr;
+    camera_cache_t* cam = get_camera(camera_id, false);
+    if (cam) {
+        cam->last_used = ++s_cache.clock;
+    }
+    if (cam && feat) {
+        for (int i = 0; i < IDENTITY_CACHE_SIZE; i++) {
+            cache_entry_t* e = &cam->entries[i];
+            if (e->id < 0 || e->expires_us <= start) {
+                continue;
+            }
+            // Same rule as the database: similarity must be above thr
+            float sim = dot(&cam->feats[i * s_cache.feat_len], feat, s_cache.feat_len);
+            if (sim > best_sim) {
+                best_sim = sim;
+                best = i;
+            }
+        }
+    }
+
+    int id = -1;
+    if (best >= 0) {
+        // Expiry is not extended on a hit: the database re-confirms the identity at least every TTL
+        cam->entries[best].last_used = ++s_cache.clock;
+        id = cam->entries[best].id;
+        s_cache.hits++;
+        if (out_sim) {
+            *out_sim = best_sim;
+        }
+    }
+    s_cache.lookup_us_total += esp_timer_get_time() - start;
+    return id;
+}
+
+void identity_cache_insert(int camera_id, int id, const float* feat) {
+    camera_cache_t* cam = get_camera(camera_id, true);
+    if (!cam || !feat || id < 0) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    cam->last_used = ++s_cache.clock;
+
+    // Same id already cached: refresh it with the newest embedding.
+    // Otherwise take a free/expired entry, or evict the least recently used one.
+    int slot = -1;
+    int victim = 0;
+    for (int i = 0; i < IDENTITY_CACHE_SIZE; i++) {
+        cache_entry_t* e = &cam->entries[i];
+        if (e->id == id) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && (e->id < 0 || e->expires_us <= now)) {
+            slot = i;
+        }
+        if (e->last_used < cam->entries[victim].last_used) {
+            victim = i;
+        }
+    }
+    if (slot < 0) {
+        slot = victim;
+        s_cache.evictions++;
+    }
+
+    cache_entry_t* e = &cam->entries[slot];
+    e->id = id;
+    e->expires_us = now + (int64_t)IDENTITY_CACHE_TTL_MS * 1000;
+    e->last_used = ++s_cache.clock;
+    memcpy(&cam->feats[slot * s_cache.feat_len], feat, s_cache.feat_len * sizeof(float));
+    s_cache.inserts++;
+}
+
+void identity_cache_record_query(int64_t query_us) {
+    s_cache.db_queries++;
+    s_cache.query_us_total += query_us;
+}
+
+void identity_cache_invalidate(int id) {
+    for (int c = 0; c < IDENTITY_CACHE_MAX_CAMERAS; c++) {
+        camera_cache_t* cam = &s_cache.cameras[c];
+        for (int i = 0; i < IDENTITY_CACHE_SIZE; i++) {
+            if (cam->entries[i].id == id) {
+                cam->entries[i].id = -1;
+            }
+        }
+    }
+}
+
+void identity_cache_reset_camera(int camera_id) {
+    camera_cache_t* cam = get_camera(camera_id, false);
+    if (cam) {
+        clear_camera(cam);
+    }
+}
+
+void identity_cache_get_stats(identity_cache_stats_t* out) {
+    if (!out) {
+        return;
+    }
+    memset(out, 0, sizeof(*out));
+    out->lookups = s_cache.lookups;
+    out->hits = s_cache.hits;
+    out->inserts = s_cache.inserts;
+    out->evictions = s_cache.evictions;
+    out->camera_evictions = s_cache.camera_evictions;
+    out->db_queries = s_cache.db_queries;
+    if (s_cache.lookups > 0) {
+        out->hit_rate = (float)s_cache.hits / s_cache.lookups;
+        out->avg_lookup_us = s_cache.lookup_us_total / s_cache.lookups;
+    }
+    if (s_cache.db_queries > 0) {
+        out->avg_query_us = s_cache.query_us_total / s_cache.db_queries;
+    }
+    out->saved_us = (int64_t)s_cache.hits * out->avg_query_us - s_cache.lookup_us_total;
+}
+
+void identity_cache_reset_stats(void) {
+    s_cache.lookups = 0;
+    s_cache.hits = 0;
+    s_cache.inserts = 0;
+    s_cache.evictions = 0;
+    s_cache.camera_evictions = 0;
+    s_cache.db_queries = 0;
+    s_cache.lookup_us_total = 0;
+    s_cache.query_us_total = 0;
+}
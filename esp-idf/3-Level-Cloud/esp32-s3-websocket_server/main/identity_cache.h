@@ -0,0 +1,117 @@
+/**
+ * @file identity_cache.h
+ * @brief Per-camera cache of recently recognized identities.
+ *
+ * The same people walk past the same cameras all day. Each camera keeps a
+ * small LRU list of the faces it matched recently (embedding + id + expiry).
+ * A new embedding is compared against that list first, and only if nothing
+ * is similar enough the full database query (DataBase::query_feat) runs.
+ *
+ * Entries expire IDENTITY_CACHE_TTL_MS after the database confirmed them, so
+ * a cached identity is re-checked against the database now and then. A cache
+ * hit does not extend the TTL, only a database match does.
+ *
+ * Up to IDENTITY_CACHE_MAX_CAMERAS cameras have a slot each, whatever their
+ * ids. A camera beyond that takes the slot of the camera seen least recently.
+ *
+ * @note Not thread safe, call it from the image processing task only.
+ */
+
+#ifndef IDENTITY_CACHE_H
+#define IDENTITY_CACHE_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t lookups;       // identity_cache_lookup() calls
+    uint32_t hits;          // lookups answered from the cache
+    uint32_t inserts;       // identities stored after a database match
+    uint32_t evictions;     // live entries pushed out by the LRU
+    uint32_t camera_evictions; // camera slots taken over by another camera
+    uint32_t db_queries;    // database queries timed (cache misses)
+    float hit_rate;         // hits / lookups (0..1)
+    int64_t avg_lookup_us;  // average cost of a cache lookup
+    int64_t avg_query_us;   // average cost of a database query
+    int64_t saved_us;       // hits * avg_query_us minus the time spent in lookups
+} identity_cache_stats_t;
+
+/**
+ * @brief Initializes the cache for a given embedding length.
+ *
+ * Memory for a camera is allocated when the camera is first seen.
+ *
+ * @param feat_len Number of floats in an embedding (e.g. 512).
+ * @return esp_err_t ESP_OK on success.
+ */
+esp_err_t identity_cache_init(int feat_len);
+
+/**
+ * @brief Frees all cache memory.
+ */
+void identity_cache_deinit(void);
+
+/**
+ * @brief Looks for a cached identity similar to the embedding.
+ *
+ * Embeddings are L2 normalized, similarity is their dot product (same as
+ * the recognition database).
+ *
+ * @param camera_id Camera (client) the frame came from.
+ * @param feat Embedding of the face, feat_len floats.
+ * @param thr Acceptance threshold, same one used for the database query.
+ * @param[out] out_sim Similarity of the hit. Can be NULL.
+ * @return int The cached id, -1 on a miss.
+ */
+int identity_cache_lookup(int camera_id, const float* feat, float thr, float* out_sim);
+
+/**
+ * @brief Stores an identity the database just matched for a camera.
+ *
+ * An existing entry with the same id is refreshed, otherwise a free,
+ * expired or the least recently used entry is replaced.
+ *
+ * @param camera_id Camera (client) the frame came from.
+ * @param id Database id of the match.
+ * @param feat Embedding of the face, feat_len floats.
+ */
+void identity_cache_insert(int camera_id, int id, const float* feat);
+
+/**
+ * @brief Records how long a database query took (on a cache miss).
+ *
+ * Used to estimate the time the hits saved.
+ *
+ * @param query_us Duration of the query in microseconds.
+ */
+void identity_cache_record_query(int64_t query_us);
+
+/**
+ * @brief Drops an id from every camera, e.g. after it was deleted from the database.
+ */
+void identity_cache_invalidate(int id);
+
+/**
+ * @brief Drops all entries of a camera, e.g. when it disconnects.
+ */
+void identity_cache_reset_camera(int camera_id);
+
+/**
+ * @brief Returns the hit/miss counters and time estimates.
+ */
+void identity_cache_get_stats(identity_cache_stats_t* out);
+
+/**
+ * @brief Clears the counters, cached entries are kept.
+ */
+void identity_cache_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IDENTITY_CACHE_H
@@ -1,36 +1,336 @@
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
 #include "image_processor.h"
 #include "face_recognizer.hpp" // Directly include the C++ header
+#include "face_database.h"
+#include "storage_manager.h"
+#if FACE_UPLOAD_ENABLED
+#include "face_upload.h"
+#endif
+#if UNKNOWN_CLUSTER_ENABLED
+#include "unknown_cluster.h"
+#endif
+#if CLOUD_IDENTITY_ENABLED
+#include "cloud_identity.h"
+#endif
+#if LATENCY_TRACE_ENABLED
+#include "latency_trace.h"
+#endif
 
 static const char* TAG = "IMAGE_PROCESSOR";
 
-// Create a static instance of the FaceRecognizer.
-// Its constructor is called automatically at startup.
-static FaceRecognizer g_recognizer;
+// A frame waiting for recognition
+typedef struct {
+    int camera_id;
+    uint8_t* buffer;
+    size_t len;
+    int width;
+    int height;
+    image_pix_format_t format;
+    int64_t accepted_us; // when it was queued
+    uint32_t trace_id;
+} image_job_t;
 
-// This function is exposed to C code via image_processor.h
-esp_err_t image_processor_init(void) {
-    ESP_LOGI(TAG, "Image processor initialized (C++).");
-    // The g_recognizer object is already constructed by this point.
-    return ESP_OK;
-}
-
-// This function is also exposed to C code via image_processor.h
-esp_err_t image_processor_handle_new_image(uint8_t *image_buffer, size_t image_len, int width, int height) {
-    ESP_LOGI(TAG, "New image received (%d bytes, %dx%d).", (int)image_len, width, height);
-
-    // Directly call the C++ method on the static object
-    int face_id = g_recognizer.recognize_face(image_buffer, width, height);
+// Created by the image processor task, NOT at static init: the models take
+// seconds to load and failures must show up in the log.
+static FaceRecognizer* s_recognizer = NULL;
+static QueueHandle_t s_job_queue = NULL;
+static volatile bool s_ready = false;
+static bool s_first_accepted = false;
+static bool s_first_processed = false;
 
+static void log_result(int face_id) {
     if (face_id >= 0) {
+        // The recognizer id is the metadata id (moved up for a written-back face), direct index lookup
+#if CLOUD_IDENTITY_ENABLED
+        int metadata_id = cloud_identity_metadata_id(face_id);
+#else
+        int metadata_id = face_id;
+#endif
+        face_info_t info;
+        bool has_info = database_get_info(metadata_id, &info) == ESP_OK;
         ESP_LOGI(TAG, "********************************");
         ESP_LOGI(TAG, "* RESULT: FACE RECOGNIZED! ID: %d *", face_id);
+        if (has_info) {
+            ESP_LOGI(TAG, "* %s (%s), access level %d *", info.name, info.title, info.access_level);
+        } else {
+            ESP_LOGW(TAG, "* No metadata for ID %d *", metadata_id);
+        }
         ESP_LOGI(TAG, "********************************");
     } else {
         ESP_LOGW(TAG, "********************************");
         ESP_LOGW(TAG, "* RESULT: UNKNOWN FACE / ERROR *");
         ESP_LOGW(TAG, "********************************");
     }
+}
+
+#if CLOUD_IDENTITY_ENABLED
+static void remove_cloud_face(int local_id) {
+    s_recognizer->delete_feat(local_id);
+    database_delete_face(CLOUD_IDENTITY_ID_BASE + local_id);
+}
+
+// The write-back table is in RAM: faces written back before a reboot have no TTL any more.
+// Only the cloud id range is touched, the faces of faces.json stay whatever their status.
+static void purge_cloud_faces(void) {
+    const face_record_t* records;
+    int count = 0;
+    if (database_get_all_faces(&records, &count) != ESP_OK || count == 0) {
+        return;
+    }
+    int* ids = (int*)malloc(count * sizeof(int));
+    if (!ids) {
+        return;
+    }
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (records[i].id >= CLOUD_IDENTITY_ID_BASE &&
+            strcmp(database_get_str(records[i].str[FACE_FIELD_STATUS]), CLOUD_IDENTITY_STATUS) == 0) {
+            ids[n++] = records[i].id - CLOUD_IDENTITY_ID_BASE;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        remove_cloud_face(ids[i]);
+    }
+    free(ids);
+    if (n > 0) {
+        ESP_LOGI(TAG, "%d cloud faces of the previous boot removed.", n);
+    }
+}
+
+// Identities from the cloud: expired ones out, new ones into the recognition and metadata databases
+static void apply_cloud_identities(void) {
+    int local_id;
+    while ((local_id = cloud_identity_pop_expired()) >= 0) {
+        remove_cloud_face(local_id);
+    }
+    cloud_identity_t identity;
+    while (cloud_identity_receive(&identity)) {
+        if (identity.feat_len != s_recognizer->get_feat_len()) {
+            ESP_LOGW(TAG, "Cloud identity %d: %d-d embedding, the model gives %d.", identity.cloud_id,
+                     identity.feat_len, s_recognizer->get_feat_len());
+        } else if (cloud_identity_find(identity.cloud_id, identity.ttl_s) < 0) {
+            local_id = s_recognizer->enroll_feat(identity.feat);
+            if (local_id >= 0) {
+                face_info_t info = {
+                    .id = CLOUD_IDENTITY_ID_BASE + local_id,
+                    .access_level = identity.access_level,
+                    .name = identity.name,
+                    .title = identity.title,
+                    .status = CLOUD_IDENTITY_STATUS,
+                    .image_file = NULL,
+                    .embedding_file = NULL,
+                };
+                if (database_put_face(&info) != ESP_OK) {
+                    ESP_LOGW(TAG, "Cloud identity %d: metadata not stored, embedding removed.", identity.cloud_id);
+                    s_recognizer->delete_feat(local_id);
+                } else {
+                    int evicted = cloud_identity_track(local_id, identity.cloud_id, identity.ttl_s);
+                    if (evicted >= 0) {
+                        remove_cloud_face(evicted);
+                    }
+                    ESP_LOGI(TAG, "Cloud identity %d (%s) of upload %lu stored as ID %d (metadata %d).",
+                             identity.cloud_id, identity.name, (unsigned long)identity.ref_id, local_id, info.id);
+                }
+            }
+        }
+        cloud_identity_release(&identity);
+    }
+}
+#endif // End of CLOUD_IDENTITY_ENABLED
+
+static void process_job(image_job_t* job) {
+#if CLOUD_IDENTITY_ENABLED
+    apply_cloud_identities();
+#endif
+    int64_t start = esp_timer_get_time();
+    int face_id = s_recognizer->recognize_face(job->camera_id, job->buffer, job->width, job->height,
+                                               job->format == IMAGE_PIX_RGB565);
+    int64_t end = esp_timer_get_time();
+#if LATENCY_TRACE_ENABLED
+    const FaceRecognizer::Timing& timing = s_recognizer->get_timing();
+    latency_trace_stamp(job->trace_id, (uint8_t)job->camera_id, TRACE_PROC_START, start);
+    latency_trace_stamp(job->trace_id, (uint8_t)job->camera_id, TRACE_S3_DETECT, timing.detect_us);
+    latency_trace_stamp(job->trace_id, (uint8_t)job->camera_id, TRACE_S3_FEATURE, timing.feature_us);
+    latency_trace_stamp(job->trace_id, (uint8_t)job->camera_id, TRACE_S3_QUERY, timing.query_us);
+#endif
+    ESP_LOGI(TAG, "Frame from camera %d (%dx%d): waited %lld ms, recognition %lld ms.", job->camera_id,
+             job->width, job->height, (long long)((start - job->accepted_us) / 1000), (long long)((end - start) / 1000));
+    if (!s_first_processed) {
+        s_first_processed = true;
+        ESP_LOGI(TAG, "First frame recognized %lld ms after reset.", (long long)(end / 1000));
+    }
+    log_result(face_id);
+#if CLOUD_IDENTITY_ENABLED
+    if (face_id >= 0 || s_recognizer->get_unknown_feat()) {
+        cloud_identity_record(face_id);
+    }
+#endif
+#if FACE_UPLOAD_ENABLED
+    // Not known here: the cloud tier takes it (copied, the frame buffer is freed after this)
+    const float* feat = s_recognizer->get_unknown_feat();
+    uint32_t cluster_id = 0;
+    bool upload = feat != NULL;
+#if UNKNOWN_CLUSTER_ENABLED
+    // The same stranger in front of the camera: uploaded once, then only counted
+    if (feat) {
+        unknown_cluster_result_t cluster;
+        unknown_cluster_add(feat, s_recognizer->get_unknown_quality(), job->camera_id, end, &cluster);
+        cluster_id = cluster.cluster_id;
+        upload = cluster.upload;
+        ESP_LOGI(TAG, "Unknown face: cluster %lu%s, sighting %lu (sim %.2f)%s.", (unsigned long)cluster_id,
+                 cluster.new_cluster ? " (new)" : "", (unsigned long)cluster.sightings, cluster.similarity,
+                 upload ? ", uploaded" : "");
+    }
+    unknown_cluster_report_t report;
+    while (unknown_cluster_next_report(end, &report)) {
+        int64_t duration_s = (report.last_us - report.first_us) / 1000000;
+        face_upload_sighting_t sighting = {
+            .cluster_id = report.cluster_id,
+            .sightings = report.sightings,
+            .new_sightings = report.new_sightings,
+            .camera_id = (uint16_t)report.camera_id,
+            .duration_s = (uint16_t)(duration_s > UINT16_MAX ? UINT16_MAX : duration_s),
+        };
+        face_upload_send_sighting(&sighting);
+    }
+#endif
+    if (upload) {
+        face_upload_submit(job->camera_id, job->buffer, job->len, job->width, job->height, job->format, feat,
+                           s_recognizer->get_feat_len(), cluster_id);
+    }
+#endif
+}
+
+static void image_processor_task(void* pvParameters) {
+    int64_t start = esp_timer_get_time();
+    ESP_LOGI(TAG, "Loading face models...");
+    s_recognizer = new FaceRecognizer();
+    s_ready = s_recognizer->is_ready();
+    if (s_ready) {
+        ESP_LOGI(TAG, "Face models ready in %lld ms (%lld ms after reset), %d frames waiting.",
+                 (long long)((esp_timer_get_time() - start) / 1000), (long long)(esp_timer_get_time() / 1000),
+                 (int)uxQueueMessagesWaiting(s_job_queue));
+    } else {
+        ESP_LOGE(TAG, "Face models failed to load, frames will be dropped.");
+    }
+#if CLOUD_IDENTITY_ENABLED
+    if (s_ready) {
+        purge_cloud_faces();
+    }
+#endif
+#if UNKNOWN_CLUSTER_ENABLED
+    unknown_cluster_config_t cluster_config = {
+        .capacity = UNKNOWN_CLUSTER_CAPACITY,
+        .feat_len = s_ready ? s_recognizer->get_feat_len() : 0,
+        .threshold = UNKNOWN_CLUSTER_THRESHOLD,
+        .half_life_ms = UNKNOWN_CLUSTER_HALF_LIFE_MS,
+        .min_weight = UNKNOWN_CLUSTER_MIN_WEIGHT,
+        .best_margin = UNKNOWN_CLUSTER_BEST_MARGIN,
+        .max_uploads = UNKNOWN_CLUSTER_MAX_UPLOADS,
+        .report_ms = UNKNOWN_CLUSTER_REPORT_MS,
+    };
+    if (s_ready && !unknown_cluster_init(&cluster_config)) {
+        ESP_LOGW(TAG, "No memory for the unknown-face clusters, every unknown face is uploaded.");
+    }
+#endif
+
+    image_job_t job;
+    while (true) {
+        if (xQueueReceive(s_job_queue, &job, portMAX_DELAY) == pdTRUE) {
+            if (s_ready) {
+                process_job(&job);
+            }
+            free(job.buffer);
+#if LATENCY_TRACE_ENABLED
+            latency_trace_stamp(job.trace_id, (uint8_t)job.camera_id, TRACE_DONE, esp_timer_get_time());
+            latency_trace_collect();
+#endif
+        }
+    }
+}
+
+// This function is exposed to C code via image_processor.h
+esp_err_t image_processor_init(void) {
+    if (s_job_queue) {
+        return ESP_OK;
+    }
+    // Without it every enroll fails: no cloud identity could be written back
+    if (!storage_is_mounted()) {
+        ESP_LOGE(TAG, "Storage not mounted, no recognition database at %s: face recognition disabled.",
+                 FACE_RECOGNITION_DB_PATH);
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_job_queue = xQueueCreate(IMAGE_PROCESSOR_QUEUE_LEN, sizeof(image_job_t));
+    if (!s_job_queue) {
+        ESP_LOGE(TAG, "Failed to create frame queue.");
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(image_processor_task, "image_proc_task", IMAGE_PROCESSOR_TASK_STACK, NULL,
+                    IMAGE_PROCESSOR_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create image processor task.");
+        vQueueDelete(s_job_queue);
+        s_job_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Image processor initialized (C++), models loading in background.");
+    return ESP_OK;
+}
 
+bool image_processor_is_ready(void) {
+    return s_ready;
+}
+
+esp_err_t image_processor_submit(int camera_id, uint8_t *image_buffer, size_t image_len, int width, int height,
+                                 image_pix_format_t format, uint32_t trace_id) {
+    if (!s_job_queue || !image_buffer) {
+        free(image_buffer);
+        return ESP_ERR_INVALID_STATE;
+    }
+    image_job_t job = {
+        .camera_id = camera_id,
+        .buffer = image_buffer,
+        .len = image_len,
+        .width = width,
+        .height = height,
+        .format = format,
+        .accepted_us = esp_timer_get_time(),
+        .trace_id = trace_id,
+    };
+    if (xQueueSend(s_job_queue, &job, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Frame queue full, frame from camera %d dropped.", camera_id);
+        free(image_buffer);
+#if LATENCY_TRACE_ENABLED
+        latency_trace_stamp(trace_id, (uint8_t)camera_id, TRACE_DONE, esp_timer_get_time());
+#endif
+        return ESP_ERR_NO_MEM;
+    }
+    if (!s_first_accepted) {
+        s_first_accepted = true;
+        ESP_LOGI(TAG, "First frame accepted %lld ms after reset (models %s).",
+                 (long long)(job.accepted_us / 1000), s_ready ? "ready" : "still loading");
+    }
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+// This function is also exposed to C code via image_processor.h
+// The recognizer is owned by the image processor task, so the frame is copied and queued like the WebSocket ones
+esp_err_t image_processor_handle_new_image(int camera_id, uint8_t *image_buffer, size_t image_len, int width, int height) {
+    ESP_LOGI(TAG, "New image from camera %d (%d bytes, %dx%d).", camera_id, (int)image_len, width, height);
+    if (!image_buffer || image_len < (size_t)width * height * 3) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t* copy = (uint8_t*)malloc(image_len);
+    if (!copy) {
+        ESP_LOGW(TAG, "No memory for the frame copy.");
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, image_buffer, image_len);
+    return image_processor_submit(camera_id, copy, image_len, width, height, IMAGE_PIX_RGB888, 0);
+}
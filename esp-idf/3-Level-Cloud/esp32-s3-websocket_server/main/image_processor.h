@@ -1,6 +1,7 @@
 #pragma once
 
 #include "esp_err.h"
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -8,22 +9,61 @@
 extern "C" {
 #endif
 
+typedef enum {
+    IMAGE_PIX_RGB888 = 0,
+    IMAGE_PIX_RGB565, // camera byte order (big endian)
+} image_pix_format_t;
+
 /**
  * @brief Initializes the image processor module.
+ *
+ * Returns right away. The face models are loaded by the image processor
+ * task in the background (in parallel with WiFi/WebSocket bring-up), with
+ * load time and memory of each model logged. Frames submitted meanwhile
+ * are queued and processed once the models are ready.
  */
 esp_err_t image_processor_init(void);
 
+/**
+ * @brief Checks if the face models finished loading.
+ */
+bool image_processor_is_ready(void);
+
+/**
+ * @brief Queues a frame for recognition.
+ *
+ * The image processor takes ownership of the buffer (malloc'ed) and frees
+ * it, also when the frame is rejected.
+ *
+ * @param camera_id Source of the image (e.g. WebSocket client index), selects its identity cache.
+ * @param image_buffer Pointer to the raw image data.
+ * @param image_len The total size of the image buffer in bytes.
+ * @param width The width of the image in pixels.
+ * @param height The height of the image in pixels.
+ * @param format Pixel format of the image.
+ * @param trace_id Frame id, stages are stamped under it with camera_id as the source (latency_trace.h).
+ * @return esp_err_t ESP_OK if queued, ESP_ERR_NO_MEM if the queue is full.
+ */
+esp_err_t image_processor_submit(int camera_id, uint8_t *image_buffer, size_t image_len, int width, int height,
+                                 image_pix_format_t format, uint32_t trace_id);
+
 /**
  * @brief Handles a new complete image received from any source.
  *
+ * Copies the image and queues it as image_processor_submit() does: the recognition
+ * runs in the image processor task, the only one using the models. The caller keeps
+ * its buffer.
+ *
+ * @param camera_id Source of the image (e.g. WebSocket client index), selects its identity cache.
  * @param image_buffer Pointer to the raw image data (RGB888).
  * @param image_len The total size of the image buffer in bytes.
  * @param width The width of the image in pixels.
  * @param height The height of the image in pixels.
- * @return esp_err_t ESP_OK on success.
+ * @return esp_err_t ESP_OK if queued, ESP_ERR_INVALID_ARG for a buffer smaller than the image,
+ *         ESP_ERR_NO_MEM if there is no memory for the copy or the queue is full.
  */
-esp_err_t image_processor_handle_new_image(uint8_t *image_buffer, size_t image_len, int width, int height);
+esp_err_t image_processor_handle_new_image(int camera_id, uint8_t *image_buffer, size_t image_len, int width, int height);
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,307 @@
+/**
+ * @file kernel_bench.cpp
+ * @brief S3 suite of the kernel microbenchmarks: the esp-dl image code of the preprocessing.
+ *
+ * On camera frames (QVGA and VGA, RGB565 in camera byte order and RGB888):
+ *   convert   convert_img to RGB888, gray and normalized int8
+ *   resize    resize with a cached ResizeTable to the detector input and a face crop, nearest and bilinear
+ *   warp      warp_affine to the 112x112 int8 input of the feature model, nearest and bilinear
+ *   draw      a detection box and its 5 keypoints (draw_hollow_rectangle, draw_point)
+ *   jpeg      software encode (quality 80) and decode back to RGB565, target only: esp_new_jpeg is a
+ *             prebuilt library
+ *   log       the info messages of one face on the camera and on the S3, formatted as ESP_LOGx does
+ *             (without the UART) and as binlog records
+ * A frame that does not fit the heap is skipped. Built for the host by cloud-tier (kernel_bench).
+ */
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdlib>
+
+#include "kernel_bench.hpp"
+#include "binlog.h"
+#include "dl_image_draw.hpp"
+#include "dl_image_process.hpp"
+#ifdef ESP_PLATFORM
+#include "dl_image_jpeg.hpp"
+#include "esp_heap_caps.h"
+#endif
+
+using namespace dl::image;
+
+namespace {
+
+// Frees a malloc'ed buffer at the end of the scope
+struct Buffer {
+    void *data;
+    explicit Buffer(size_t size) : data(malloc(size)) {}
+    ~Buffer() { free(data); }
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+};
+
+// Gradients with noise, roughly the statistics of a camera frame (and of its JPEG size)
+void fill_frame(int width, int height, uint8_t *rgb888, uint16_t *rgb565)
+{
+    uint32_t seed = 1;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t noise = seed >> 16;
+            uint8_t r = (uint8_t)(x * 255 / width + noise % 32);
+            uint8_t g = (uint8_t)(y * 255 / height + (noise >> 5) % 32);
+            uint8_t b = (uint8_t)((x + y) * 2 + (noise >> 10) % 64);
+            uint8_t *p = rgb888 + ((size_t)y * width + x) * 3;
+            p[0] = r;
+            p[1] = g;
+            p[2] = b;
+            uint16_t le = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+            rgb565[(size_t)y * width + x] = (uint16_t)((le << 8) | (le >> 8)); // camera byte order
+        }
+    }
+}
+
+// Same normalization as ImagePreprocessor (mean 128, std 2, exponent 0)
+void fill_norm_lut(int8_t *lut)
+{
+    for (int v = 0; v < 256; v++) {
+        int8_t q = (int8_t)std::lround(std::max(-128.f, std::min(127.f, (v - 128) / 2.f)));
+        lut[v] = lut[256 + v] = lut[512 + v] = q;
+    }
+}
+
+// Aligned face of the given size centered on the frame, scale source pixels per output pixel
+void face_transform(dl::math::Matrix<float> &M, int size, float cx, float cy, float scale, float angle)
+{
+    float a = angle * (float)M_PI / 180.f;
+    M.array[0][0] = scale * std::cos(a);
+    M.array[0][1] = -scale * std::sin(a);
+    M.array[1][0] = scale * std::sin(a);
+    M.array[1][1] = scale * std::cos(a);
+    M.array[0][2] = cx - (M.array[0][0] + M.array[0][1]) * size / 2;
+    M.array[1][2] = cy - (M.array[1][0] + M.array[1][1]) * size / 2;
+}
+
+const char *interpolate_name(interpolate_type_t interpolate)
+{
+    return interpolate == DL_IMAGE_INTERPOLATE_BILINEAR ? "bilinear" : "nearest";
+}
+
+void run_frame(KernelBench &bench, int width, int height)
+{
+    const size_t pixels = (size_t)width * height;
+    Buffer rgb888_buf(pixels * 3), rgb565_buf(pixels * 2), out_buf(pixels * 3), lut_buf(3 * 256);
+    if (!rgb888_buf.data || !rgb565_buf.data || !out_buf.data || !lut_buf.data) {
+        printf("# %dx%d frame skipped, no memory\n", width, height);
+        return;
+    }
+    uint8_t *rgb888 = (uint8_t *)rgb888_buf.data;
+    uint16_t *rgb565 = (uint16_t *)rgb565_buf.data;
+    int8_t *norm_lut = (int8_t *)lut_buf.data;
+    fill_frame(width, height, rgb888, rgb565);
+    fill_norm_lut(norm_lut);
+
+    struct Frame {
+        const char *name;
+        pix_type_t pix_type;
+        uint32_t caps;
+        void *data;
+    };
+    const Frame frames[] = {
+        { "rgb565be", DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_CAP_RGB565_BIG_ENDIAN, rgb565 },
+        { "rgb888", DL_IMAGE_PIX_TYPE_RGB888, 0, rgb888 },
+    };
+    const interpolate_type_t interpolations[] = { DL_IMAGE_INTERPOLATE_NEAREST, DL_IMAGE_INTERPOLATE_BILINEAR };
+
+    struct Conversion {
+        const char *variant;
+        const Frame &src;
+        pix_type_t dst_type;
+        uint32_t caps;
+        void *norm_lut;
+    };
+    const Conversion conversions[] = {
+        { "to_rgb888", frames[0], DL_IMAGE_PIX_TYPE_RGB888, DL_IMAGE_CAP_RGB565_BIG_ENDIAN, nullptr },
+        { "to_gray", frames[0], DL_IMAGE_PIX_TYPE_GRAY, DL_IMAGE_CAP_RGB565_BIG_ENDIAN, nullptr },
+        { "to_int8", frames[0], DL_IMAGE_PIX_TYPE_RGB888_QINT8,
+          DL_IMAGE_CAP_RGB_SWAP | DL_IMAGE_CAP_RGB565_BIG_ENDIAN, norm_lut },
+        { "to_int8", frames[1], DL_IMAGE_PIX_TYPE_RGB888_QINT8, 0, norm_lut },
+    };
+    for (const Conversion &c : conversions) {
+        img_t src = { c.src.data, (uint16_t)width, (uint16_t)height, c.src.pix_type };
+        img_t dst = { out_buf.data, (uint16_t)width, (uint16_t)height, c.dst_type };
+        bench.run("convert", c.variant, width, height, c.src.name, [&] { convert_img(src, dst, c.caps, c.norm_lut); });
+    }
+
+    // Detector input (whole frame) and a face crop of a third of the frame height
+    const int crop = height / 3;
+    const std::vector<int> face_box = { width / 2 - crop / 2, height / 2 - crop / 2, width / 2 + crop / 2,
+                                        height / 2 + crop / 2 };
+    struct Resize {
+        const char *name;
+        int width, height;
+        std::vector<int> box;
+    };
+    const Resize resizes[] = { { "msr", 160, 120, {} }, { "face", 112, 112, face_box } };
+    for (const Frame &frame : frames) {
+        img_t src = { frame.data, (uint16_t)width, (uint16_t)height, frame.pix_type };
+        for (const Resize &r : resizes) {
+            for (interpolate_type_t interpolate : interpolations) {
+                char variant[32];
+                snprintf(variant, sizeof(variant), "%s_%dx%d_%s", r.name, r.width, r.height,
+                         interpolate_name(interpolate));
+                img_t dst = { out_buf.data, (uint16_t)r.width, (uint16_t)r.height, DL_IMAGE_PIX_TYPE_RGB888 };
+                ResizeTable table;
+                bench.run("resize", variant, width, height, frame.name, [&] {
+                    resize(src, dst, interpolate, frame.caps, nullptr, r.box, nullptr, nullptr, &table);
+                });
+            }
+        }
+    }
+
+    // The feature model input, as the S3 aligns faces: RGB565 frame, BGR int8 output
+    dl::math::Matrix<float> M(2, 3);
+    face_transform(M, 112, width / 2.f, height / 2.f, crop / 112.f, 12);
+    {
+        img_t src = { rgb565, (uint16_t)width, (uint16_t)height, DL_IMAGE_PIX_TYPE_RGB565 };
+        img_t dst = { out_buf.data, 112, 112, DL_IMAGE_PIX_TYPE_RGB888_QINT8 };
+        for (interpolate_type_t interpolate : interpolations) {
+            bench.run("warp_affine", interpolate_name(interpolate), width, height, "rgb565be", [&] {
+                warp_affine(src, dst, interpolate, &M, DL_IMAGE_CAP_RGB_SWAP | DL_IMAGE_CAP_RGB565_BIG_ENDIAN,
+                            norm_lut);
+            });
+        }
+    }
+
+    // A detection: box and 5 keypoints (eyes, nose, mouth corners), radius 4 as the camera draws them
+    const std::vector<uint8_t> green = { 0, 255, 0 }, red = { 255, 0, 0 };
+    const int x1 = face_box[0], y1 = face_box[1], x2 = face_box[2], y2 = face_box[3];
+    const int points[5][2] = { { x1 + crop / 3, y1 + crop / 3 }, { x2 - crop / 3, y1 + crop / 3 },
+                               { (x1 + x2) / 2, (y1 + y2) / 2 }, { x1 + crop / 3, y2 - crop / 4 },
+                               { x2 - crop / 3, y2 - crop / 4 } };
+    for (const Frame &frame : frames) {
+        img_t img = { frame.data, (uint16_t)width, (uint16_t)height, frame.pix_type };
+        bench.run("draw", "box_keypoints", width, height, frame.name, [&] {
+            draw_hollow_rectangle(img, x1, y1, x2, y2, green, 2, frame.caps);
+            for (const auto &p : points) {
+                draw_point(img, p[0], p[1], red, 4, frame.caps);
+            }
+        });
+    }
+
+#ifdef ESP_PLATFORM
+    if (bench.selected("jpeg")) {
+        img_t src = { rgb565, (uint16_t)width, (uint16_t)height, DL_IMAGE_PIX_TYPE_RGB565 };
+        bench.run("jpeg", "encode_q80", width, height, "rgb565be", [&] {
+            jpeg_img_t jpeg = sw_encode_jpeg(src, DL_IMAGE_CAP_RGB565_BIG_ENDIAN, 80);
+            heap_caps_free(jpeg.data);
+        });
+        jpeg_img_t jpeg = sw_encode_jpeg(src, DL_IMAGE_CAP_RGB565_BIG_ENDIAN, 80);
+        if (jpeg.data) {
+            bench.run("jpeg", "decode_rgb565", width, height, "jpeg_q80", [&] {
+                img_t img = sw_decode_jpeg(jpeg, DL_IMAGE_PIX_TYPE_RGB565, DL_IMAGE_CAP_RGB565_BIG_ENDIAN);
+                heap_caps_free(img.data);
+            });
+            heap_caps_free(jpeg.data);
+        }
+    }
+#endif
+}
+
+// What ESP_LOGx does before the UART: the line formatted into the stdio buffer
+int format_text(char *line, size_t len, const char *tag, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = snprintf(line, len, "I (%lu) %s: ", 123456ul, tag);
+    n += vsnprintf(line + n, len - n, fmt, ap);
+    va_end(ap);
+    return n + 1; // '\n'
+}
+
+// The info messages of one face, same formats as the call sites (app_main.cpp and websocket_client.cpp of the
+// camera, websocket_server.c). The BINLOGI() of the log macro is the one of the call sites, with its rate limit.
+const char *const FRAME_START = "{\"type\":\"frame_start\", \"size\":15488, \"id\":1234, \"w\":88, \"h\":88, "
+                                "\"trace\":[61234567,61301234,61356789,61357000,61357400,61368000]}";
+const char *const FRAME_END = "{\"type\":\"frame_end\"}";
+
+#define CAM_FRAME_MESSAGES(LOG)                                                                                    \
+    LOG("MAIN_APP", "Face detected in frame %d. Stopping camera.", 1234);                                          \
+    LOG("MAIN_APP", "Flushing processing queues.");                                                                \
+    LOG("MAIN_APP", "Waiting for WIFI...");                                                                        \
+    LOG("MAIN_APP", "Starting transfer for frame  %d, size: %zu Bytes, Box: [x=%d, y=%d, w=%d, h=%d]", 1234,       \
+        (size_t)15488, 116, 76, 88, 88);                                                                           \
+    LOG("WEBSOCK_CL", "Sending: %s", FRAME_START);                                                                 \
+    LOG("MAIN_APP", "Finished sending chunks for frame %d", 1234);                                                 \
+    LOG("WEBSOCK_CL", "Sending: %s", FRAME_END);                                                                   \
+    LOG("WEBSOCK_CL", "Got frame ACK.");                                                                           \
+    LOG("MAIN_APP", "Got ACK for frame %d!", 1234);                                                                \
+    LOG("MAIN_APP", "Frame buffer released.");                                                                     \
+    LOG("MAIN_APP", "Cropped frame buffer released.");                                                             \
+    LOG("MAIN_APP", "Halt camera for %d sec.", 30);                                                                \
+    LOG("MAIN_APP", "Restarting camera.")
+
+#define S3_FRAME_MESSAGES(LOG)                                                                                     \
+    LOG("WEBSOCKET_SERVER", "Got frame_start for ID: %d, Size: %d", 1234, 15488);                                  \
+    LOG("WEBSOCKET_SERVER", "Transfer complete for Frame ID: %d. Total size: %d", 1234, 15488)
+
+void run_log(KernelBench &bench)
+{
+    if (!bench.selected("log")) {
+        return;
+    }
+    // The firmwares start binlog after the benchmark
+    binlog_config_t config = { 256, 0, 1000 };
+    if (!binlog_init(&config)) {
+        printf("# log skipped, no memory\n");
+        return;
+    }
+    char line[320];
+    int text_bytes[2] = { 0, 0 };
+#define TEXT(tag, ...) bytes += format_text(line, sizeof(line), tag, __VA_ARGS__)
+#define BINARY(tag, ...) BINLOGI(tag, __VA_ARGS__)
+    bench.run("log", "esp_log", 0, 0, "cam_frame", [&] {
+        int bytes = 0;
+        CAM_FRAME_MESSAGES(TEXT);
+        text_bytes[0] = bytes;
+    });
+    bench.run("log", "binlog", 0, 0, "cam_frame", [&] { CAM_FRAME_MESSAGES(BINARY); });
+    bench.run("log", "esp_log", 0, 0, "s3_frame", [&] {
+        int bytes = 0;
+        S3_FRAME_MESSAGES(TEXT);
+        text_bytes[1] = bytes;
+    });
+    bench.run("log", "binlog", 0, 0, "s3_frame", [&] { S3_FRAME_MESSAGES(BINARY); });
+#undef TEXT
+    // Console bytes of a frame: esp_log prints them from the task, at 115200 baud 86.8 us per byte,
+    // binlog from a low priority task (base64 lines of the records)
+    int binlog_bytes[2] = { 0, 0 };
+    for (int set = 0; set < 2; set++) {
+        binlog_init(&config);
+        if (set == 0) {
+            CAM_FRAME_MESSAGES(BINARY);
+        } else {
+            S3_FRAME_MESSAGES(BINARY);
+        }
+        while (size_t n = binlog_read_line(line, sizeof(line))) {
+            binlog_bytes[set] += (int)n;
+        }
+    }
+#undef BINARY
+    binlog_deinit();
+    printf("# log: console bytes per frame, esp_log cam %d s3 %d, binlog cam %d s3 %d\n", text_bytes[0],
+           text_bytes[1], binlog_bytes[0], binlog_bytes[1]);
+}
+
+} // namespace
+
+int kernel_bench_run(const kernel_bench_config_t *config)
+{
+    KernelBench bench("s3", *config);
+    const int frame_sizes[][2] = { { 320, 240 }, { 640, 480 } };
+    for (const auto &size : frame_sizes) {
+        run_frame(bench, size[0], size[1]);
+    }
+    run_log(bench);
+    return bench.cases();
+}
@@ -0,0 +1,41 @@
+/**
+ * @file kernel_bench.h
+ * @brief Microbenchmarks of the image kernels, one line of results per kernel and input.
+ *
+ * The S3 suite (kernel_bench.cpp) runs on the S3 and on the host
+ * (cloud-tier kernel_bench). The ESP32-CAM firmware has its own suite
+ * behind the same function (its main/kernel_bench.cpp).
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    KERNEL_BENCH_CSV = 0,  // header line, then one line per case
+    KERNEL_BENCH_JSON,     // one object per line
+} kernel_bench_format_t;
+
+typedef struct {
+    int warmup;                   // untimed calls before the timed ones
+    int reps;                     // timed calls, one at a time
+    kernel_bench_format_t format;
+    const char *filter;           // only kernels whose name contains this, NULL for all
+} kernel_bench_config_t;
+
+/**
+ * @brief Runs the suite of this firmware and prints the results to stdout.
+ *
+ * Columns: suite, kernel, variant, size (WxH), format (of the input), reps,
+ * unit, min, p50, p95, mean, max. The unit is us on the target (CPU cycles
+ * with DL_LOG_LATENCY_UNIT 1 in esp-dl's dl_define.hpp) and ns on the host.
+ *
+ * @return Number of cases run.
+ */
+int kernel_bench_run(const kernel_bench_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
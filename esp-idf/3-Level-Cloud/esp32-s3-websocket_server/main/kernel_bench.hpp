@@ -0,0 +1,109 @@
+/**
+ * @file kernel_bench.hpp
+ * @brief Runner of the kernel microbenchmarks, shared by the S3, the ESP32-CAM and the host.
+ *
+ * Each case is called `warmup` times, then timed `reps` times one call at a
+ * time: with dl::tool::Latency on the target, with steady_clock on the host.
+ * Sorting the samples gives min, p50, p95 and max, which are steadier than
+ * the mean when an interrupt or a cache refill hits one call.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "kernel_bench.h"
+
+#ifdef ESP_PLATFORM
+#include "dl_tool.hpp"
+#else
+#include <chrono>
+#endif
+
+class KernelBench {
+public:
+    KernelBench(const char *suite, const kernel_bench_config_t &config) : m_suite(suite), m_config(config)
+    {
+        if (m_config.format == KERNEL_BENCH_CSV) {
+            printf("suite,kernel,variant,size,format,reps,unit,min,p50,p95,mean,max\n");
+        }
+    }
+
+    bool selected(const char *kernel) const { return !m_config.filter || strstr(kernel, m_config.filter); }
+
+    /**
+     * @brief Times fn on an input of width x height and prints one line. Nothing if the kernel is not selected.
+     */
+    void run(const char *kernel, const char *variant, int width, int height, const char *format,
+             const std::function<void()> &fn)
+    {
+        if (!selected(kernel)) {
+            return;
+        }
+        for (int i = 0; i < m_config.warmup; i++) {
+            fn();
+        }
+        int reps = std::max(m_config.reps, 1);
+        std::vector<uint64_t> samples(reps);
+        uint64_t sum = 0;
+        for (int i = 0; i < reps; i++) {
+            samples[i] = measure(fn);
+            sum += samples[i];
+        }
+        std::sort(samples.begin(), samples.end());
+        uint64_t p50 = samples[(reps - 1) / 2];
+        uint64_t p95 = samples[(reps - 1) * 95 / 100];
+        double mean = (double)sum / reps;
+
+        char size[24];
+        snprintf(size, sizeof(size), "%dx%d", width, height);
+        if (m_config.format == KERNEL_BENCH_JSON) {
+            printf("{\"suite\":\"%s\",\"kernel\":\"%s\",\"variant\":\"%s\",\"size\":\"%s\",\"format\":\"%s\","
+                   "\"reps\":%d,\"unit\":\"%s\",\"min\":%llu,\"p50\":%llu,\"p95\":%llu,\"mean\":%.1f,\"max\":%llu}\n",
+                   m_suite, kernel, variant, size, format, reps, unit(), (unsigned long long)samples[0],
+                   (unsigned long long)p50, (unsigned long long)p95, mean, (unsigned long long)samples[reps - 1]);
+        } else {
+            printf("%s,%s,%s,%s,%s,%d,%s,%llu,%llu,%llu,%.1f,%llu\n", m_suite, kernel, variant, size, format, reps,
+                   unit(), (unsigned long long)samples[0], (unsigned long long)p50, (unsigned long long)p95, mean,
+                   (unsigned long long)samples[reps - 1]);
+        }
+        fflush(stdout);
+        m_cases++;
+    }
+
+    int cases() const { return m_cases; }
+
+private:
+    const char *m_suite;
+    kernel_bench_config_t m_config;
+    int m_cases = 0;
+
+    static uint64_t measure(const std::function<void()> &fn)
+    {
+#ifdef ESP_PLATFORM
+        dl::tool::Latency latency;
+        latency.start();
+        fn();
+        latency.end();
+        return latency.get_period();
+#else
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+#endif
+    }
+
+    static const char *unit()
+    {
+#ifdef ESP_PLATFORM
+        return DL_LOG_LATENCY_UNIT ? "cycles" : "us";
+#else
+        return "ns";
+#endif
+    }
+};
@@ -0,0 +1,325 @@
+/**
+ * @file latency_trace.c
+ * @brief Stage timestamps in a lock-free ring, assembled per frame into log-bucket histograms.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "latency_trace.h"
+
+#define OPEN_TRACES 8 // frames assembled at the same time (in flight on the device)
+#define SUB_BITS 2
+#define SUB (1 << SUB_BITS) // buckets per octave
+#define BUCKETS (SUB + (32 - SUB_BITS) * SUB) // the whole uint32_t range
+
+// The time between two stages of a frame
+typedef struct {
+    const char *name;
+    trace_stage_t from;
+    trace_stage_t to;
+} interval_def_t;
+
+static const interval_def_t s_intervals[] = {
+    { "detect_msr", TRACE_CAPTURE, TRACE_DETECT_1 },
+    { "detect_mnp", TRACE_DETECT_1, TRACE_DETECT_2 },
+    { "send_queue", TRACE_DETECT_2, TRACE_DEQUEUE },
+    { "crop", TRACE_DEQUEUE, TRACE_CROP },
+    { "link_wait", TRACE_CROP, TRACE_TX_START },
+    { "transmit", TRACE_TX_START, TRACE_TX_END },
+    { "ack_wait", TRACE_TX_END, TRACE_ACK },
+    { "capture_to_ack", TRACE_CAPTURE, TRACE_ACK },
+    { "uplink", TRACE_TX_START, TRACE_RX_START },
+    { "reassembly", TRACE_RX_START, TRACE_RX_END },
+    { "s3_queue", TRACE_RX_END, TRACE_PROC_START },
+    { "s3_detect", TRACE_PROC_START, TRACE_S3_DETECT },
+    { "s3_feature", TRACE_S3_DETECT, TRACE_S3_FEATURE },
+    { "s3_query", TRACE_S3_FEATURE, TRACE_S3_QUERY },
+    { "end_to_end", TRACE_CAPTURE, TRACE_DONE },
+};
+#define INTERVAL_COUNT ((int)(sizeof(s_intervals) / sizeof(s_intervals[0])))
+
+// Fields are 32-bit atomics, accessed relaxed (plain loads and stores): seq tells if they are whole
+typedef struct {
+    atomic_uint seq;      // ring index + 1 once written, 0 while being written
+    atomic_uint trace_id;
+    atomic_uint tag;      // source << 8 | stage
+    atomic_uint t_lo;
+    atomic_uint t_hi;
+} trace_event_t;
+
+typedef struct {
+    bool used;
+    uint8_t source;
+    uint32_t trace_id;
+    uint32_t last_seen;   // event count when last stamped, the oldest is pushed out
+    int64_t t_us[TRACE_STAGE_COUNT]; // 0: stage not passed
+} open_trace_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[BUCKETS];
+} histogram_t;
+
+static struct {
+    trace_event_t *ring;
+    uint32_t mask;
+    atomic_uint head;     // next index to write
+    uint32_t tail;        // next index to collect
+    atomic_flag busy;     // a task is collecting
+    open_trace_t open[OPEN_TRACES];
+    histogram_t *histograms; // one per interval
+    uint32_t events;
+    latency_trace_counters_t counters;
+} s_trace = { .busy = ATOMIC_FLAG_INIT };
+
+static int bucket_index(uint32_t v) {
+    if (v < SUB) {
+        return (int)v;
+    }
+    int e = 31 - __builtin_clz(v);
+    return SUB + (e - SUB_BITS) * SUB + (int)((v >> (e - SUB_BITS)) & (SUB - 1));
+}
+
+// Middle of the bucket
+static uint32_t bucket_value(int index) {
+    if (index < SUB) {
+        return (uint32_t)index;
+    }
+    int e = (index - SUB) / SUB + SUB_BITS;
+    uint64_t lower = (uint64_t)(SUB + (index - SUB) % SUB) << (e - SUB_BITS);
+    uint64_t mid = lower + ((1ull << (e - SUB_BITS)) >> 1);
+    return mid > UINT32_MAX ? UINT32_MAX : (uint32_t)mid;
+}
+
+static void histogram_add(histogram_t *h, int64_t d_us) {
+    uint32_t v = d_us <= 0 ? 0 : (d_us > UINT32_MAX ? UINT32_MAX : (uint32_t)d_us);
+    h->count++;
+    h->sum += v;
+    if (v > h->max) {
+        h->max = v;
+    }
+    h->buckets[bucket_index(v)]++;
+}
+
+static uint32_t histogram_percentile(const histogram_t *h, int percent) {
+    uint32_t rank = (uint32_t)(((uint64_t)h->count * percent + 99) / 100);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint32_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint32_t v = bucket_value(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+static void finish_trace(open_trace_t *t) {
+    for (int i = 0; i < INTERVAL_COUNT; i++) {
+        int64_t from = t->t_us[s_intervals[i].from];
+        int64_t to = t->t_us[s_intervals[i].to];
+        if (from && to) {
+            histogram_add(&s_trace.histograms[i], to - from);
+        }
+    }
+    s_trace.counters.traces++;
+    t->used = false;
+}
+
+static open_trace_t *find_trace(uint32_t trace_id, uint8_t source) {
+    open_trace_t *free_slot = NULL;
+    open_trace_t *oldest = NULL;
+    for (int i = 0; i < OPEN_TRACES; i++) {
+        open_trace_t *t = &s_trace.open[i];
+        if (!t->used) {
+            if (!free_slot) {
+                free_slot = t;
+            }
+        } else if (t->trace_id == trace_id && t->source == source) {
+            return t;
+        } else if (!oldest || (int32_t)(t->last_seen - oldest->last_seen) < 0) {
+            oldest = t;
+        }
+    }
+    if (!free_slot) {
+        // A frame that never got done (dropped on the way), make room
+        s_trace.counters.abandoned++;
+        free_slot = oldest;
+    }
+    memset(free_slot, 0, sizeof(*free_slot));
+    free_slot->used = true;
+    free_slot->trace_id = trace_id;
+    free_slot->source = source;
+    return free_slot;
+}
+
+static void add_event(uint32_t trace_id, uint8_t source, uint8_t stage, int64_t t_us) {
+    if (stage >= TRACE_STAGE_COUNT) {
+        return;
+    }
+    open_trace_t *t = find_trace(trace_id, source);
+    t->last_seen = ++s_trace.events;
+    t->t_us[stage] = t_us;
+    if (stage == TRACE_DONE) {
+        finish_trace(t);
+    }
+}
+
+static void collect_locked(void) {
+    uint32_t head = atomic_load_explicit(&s_trace.head, memory_order_acquire);
+    uint32_t size = s_trace.mask + 1;
+    if (head - s_trace.tail > size) {
+        s_trace.counters.lost += head - s_trace.tail - size;
+        s_trace.tail = head - size;
+    }
+    while (s_trace.tail != head) {
+        trace_event_t *e = &s_trace.ring[s_trace.tail & s_trace.mask];
+        uint32_t expected = s_trace.tail + 1;
+        uint32_t seq = atomic_load_explicit(&e->seq, memory_order_acquire);
+        if (seq != expected) {
+            if (seq != 0 && (int32_t)(seq - expected) > 0) {
+                s_trace.counters.lost++; // overwritten by a later lap
+                s_trace.tail++;
+                continue;
+            }
+            break; // still being written, next time
+        }
+        uint32_t trace_id = atomic_load_explicit(&e->trace_id, memory_order_relaxed);
+        uint32_t tag = atomic_load_explicit(&e->tag, memory_order_relaxed);
+        uint64_t t_us = atomic_load_explicit(&e->t_lo, memory_order_relaxed) |
+                        (uint64_t)atomic_load_explicit(&e->t_hi, memory_order_relaxed) << 32;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&e->seq, memory_order_relaxed) != expected) {
+            s_trace.counters.lost++; // overwritten while read
+        } else {
+            add_event(trace_id, (uint8_t)(tag >> 8), (uint8_t)tag, (int64_t)t_us);
+        }
+        s_trace.tail++;
+    }
+}
+
+bool latency_trace_init(int ring_size) {
+    latency_trace_deinit();
+    if (ring_size <= 0 || (ring_size & (ring_size - 1)) != 0) {
+        return false;
+    }
+    s_trace.ring = calloc(ring_size, sizeof(trace_event_t));
+    s_trace.histograms = calloc(INTERVAL_COUNT, sizeof(histogram_t));
+    if (!s_trace.ring || !s_trace.histograms) {
+        latency_trace_deinit();
+        return false;
+    }
+    s_trace.mask = (uint32_t)ring_size - 1;
+    atomic_store(&s_trace.head, 0);
+    s_trace.tail = 0;
+    return true;
+}
+
+void latency_trace_deinit(void) {
+    free(s_trace.ring);
+    free(s_trace.histograms);
+    s_trace.ring = NULL;
+    s_trace.histograms = NULL;
+    memset(s_trace.open, 0, sizeof(s_trace.open));
+    memset(&s_trace.counters, 0, sizeof(s_trace.counters));
+}
+
+void latency_trace_stamp(uint32_t trace_id, uint8_t source, trace_stage_t stage, int64_t t_us) {
+    if (!s_trace.ring || t_us == 0) {
+        return;
+    }
+    uint32_t index = atomic_fetch_add_explicit(&s_trace.head, 1, memory_order_relaxed);
+    trace_event_t *e = &s_trace.ring[index & s_trace.mask];
+    atomic_store_explicit(&e->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&e->trace_id, trace_id, memory_order_relaxed);
+    atomic_store_explicit(&e->tag, (uint32_t)source << 8 | (uint8_t)stage, memory_order_relaxed);
+    atomic_store_explicit(&e->t_lo, (uint32_t)t_us, memory_order_relaxed);
+    atomic_store_explicit(&e->t_hi, (uint32_t)((uint64_t)t_us >> 32), memory_order_relaxed);
+    atomic_store_explicit(&e->seq, index + 1, memory_order_release);
+}
+
+bool latency_trace_collect(void) {
+    if (!s_trace.ring || atomic_flag_test_and_set_explicit(&s_trace.busy, memory_order_acquire)) {
+        return false;
+    }
+    collect_locked();
+    atomic_flag_clear_explicit(&s_trace.busy, memory_order_release);
+    return true;
+}
+
+int latency_trace_interval_count(void) {
+    return INTERVAL_COUNT;
+}
+
+const char *latency_trace_interval_name(int interval) {
+    return interval >= 0 && interval < INTERVAL_COUNT ? s_intervals[interval].name : NULL;
+}
+
+bool latency_trace_get_stats(latency_trace_interval_t *out, latency_trace_counters_t *counters) {
+    if (!s_trace.ring || atomic_flag_test_and_set_explicit(&s_trace.busy, memory_order_acquire)) {
+        return false;
+    }
+    collect_locked();
+    for (int i = 0; i < INTERVAL_COUNT; i++) {
+        const histogram_t *h = &s_trace.histograms[i];
+        out[i].name = s_intervals[i].name;
+        out[i].count = h->count;
+        out[i].p50_us = h->count ? histogram_percentile(h, 50) : 0;
+        out[i].p95_us = h->count ? histogram_percentile(h, 95) : 0;
+        out[i].p99_us = h->count ? histogram_percentile(h, 99) : 0;
+        out[i].max_us = h->max;
+        out[i].mean_us = h->count ? (uint32_t)(h->sum / h->count) : 0;
+    }
+    if (counters) {
+        *counters = s_trace.counters;
+    }
+    atomic_flag_clear_explicit(&s_trace.busy, memory_order_release);
+    return true;
+}
+
+size_t latency_trace_to_json(char *buf, size_t len) {
+    latency_trace_interval_t stats[INTERVAL_COUNT];
+    latency_trace_counters_t counters;
+    if (!buf || len == 0 || !latency_trace_get_stats(stats, &counters)) {
+        return 0;
+    }
+    size_t n = (size_t)snprintf(buf, len, "{\"type\":\"trace_stats\",\"traces\":%lu,\"lost\":%lu,\"abandoned\":%lu,\"stages\":[",
+                                (unsigned long)counters.traces, (unsigned long)counters.lost,
+                                (unsigned long)counters.abandoned);
+    bool first = true;
+    for (int i = 0; i < INTERVAL_COUNT && n < len; i++) {
+        if (stats[i].count == 0) {
+            continue;
+        }
+        n += (size_t)snprintf(buf + n, len - n,
+                              "%s{\"name\":\"%s\",\"n\":%lu,\"p50\":%lu,\"p95\":%lu,\"p99\":%lu,\"max\":%lu,\"mean\":%lu}",
+                              first ? "" : ",", stats[i].name, (unsigned long)stats[i].count,
+                              (unsigned long)stats[i].p50_us, (unsigned long)stats[i].p95_us,
+                              (unsigned long)stats[i].p99_us, (unsigned long)stats[i].max_us,
+                              (unsigned long)stats[i].mean_us);
+        first = false;
+    }
+    if (n < len) {
+        n += (size_t)snprintf(buf + n, len - n, "]}");
+    }
+    return n < len ? n : 0;
+}
+
+bool latency_trace_reset(void) {
+    if (!s_trace.ring || atomic_flag_test_and_set_explicit(&s_trace.busy, memory_order_acquire)) {
+        return false;
+    }
+    collect_locked();
+    memset(s_trace.histograms, 0, INTERVAL_COUNT * sizeof(histogram_t));
+    memset(&s_trace.counters, 0, sizeof(s_trace.counters));
+    atomic_flag_clear_explicit(&s_trace.busy, memory_order_release);
+    return true;
+}
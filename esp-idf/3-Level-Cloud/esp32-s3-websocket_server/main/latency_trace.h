@@ -0,0 +1,135 @@
+/**
+ * @file latency_trace.h
+ * @brief End-to-end latency tracing of the camera frames, per-stage percentiles.
+ *
+ * Every face frame carries a trace: its id (the frame id of the transfer)
+ * and the time it passed each stage, from the capture on the camera to the
+ * recognition result on the S3. Stages are stamped from any task with
+ * latency_trace_stamp(), which only writes an event into a lock-free ring.
+ * latency_trace_collect() drains the ring, puts the events of each frame
+ * together and, when the frame is done (TRACE_DONE), adds the time between
+ * pairs of stages (latency_trace_interval_name()) to a histogram per pair.
+ * Percentiles come from the histograms: log buckets, 4 per octave, so
+ * within 12% of the exact value.
+ *
+ * Both firmwares run this file: the camera traces its own stages and the
+ * ack, the S3 its stages plus the camera ones received with the frame, in
+ * the S3 clock (the camera estimates the offset from the heartbeats).
+ * Intervals between the two clocks are as good as that estimate, an
+ * interval that comes out negative counts as 0.
+ *
+ * No ESP-IDF dependencies, times are passed in (us). Stamping is safe from
+ * any task, collect and the stats are for one task at a time: a second
+ * caller gets false instead of waiting.
+ */
+
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    TRACE_CAPTURE = 0, // camera: first DMA buffer of the frame (camera_fb_t::timestamp)
+    TRACE_DETECT_1,    // camera: MSR candidates
+    TRACE_DETECT_2,    // camera: MNP faces
+    TRACE_DEQUEUE,     // camera: taken by the sender task
+    TRACE_CROP,        // camera: face cropped
+    TRACE_TX_START,    // camera: frame_start sent (after waiting for the link)
+    TRACE_TX_END,      // camera: frame_end sent
+    TRACE_ACK,         // camera: frame_ack received
+    TRACE_RX_START,    // S3: frame_start received
+    TRACE_RX_END,      // S3: frame reassembled, ack queued
+    TRACE_PROC_START,  // S3: taken by the image processor
+    TRACE_S3_DETECT,   // S3: face detection done
+    TRACE_S3_FEATURE,  // S3: alignment and feature extraction done
+    TRACE_S3_QUERY,    // S3: identity cache or database answered
+    TRACE_DONE,        // the device is done with the frame, closes its trace
+    TRACE_STAGE_COUNT
+} trace_stage_t;
+
+typedef struct {
+    const char *name;
+    uint32_t count;    // frames that passed both stages
+    uint32_t p50_us;
+    uint32_t p95_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    uint32_t mean_us;
+} latency_trace_interval_t;
+
+typedef struct {
+    uint32_t traces;   // frames done
+    uint32_t lost;     // events overwritten before they were collected
+    uint32_t abandoned; // frames never done, pushed out of the open table
+} latency_trace_counters_t;
+
+/**
+ * @brief Allocates the ring and the histograms, clears the previous ones.
+ *
+ * @param ring_size Events buffered until collected, a power of 2 (a frame stamps up to 15).
+ */
+bool latency_trace_init(int ring_size);
+
+void latency_trace_deinit(void);
+
+/**
+ * @brief Records that the frame passed a stage. Lock-free, from any task.
+ *
+ * @param trace_id Frame id.
+ * @param source Where the frame comes from (e.g. the WebSocket client index), frames of different sources never mix.
+ * @param stage Stage passed.
+ * @param t_us Time, us since boot of the device (0 is ignored).
+ */
+void latency_trace_stamp(uint32_t trace_id, uint8_t source, trace_stage_t stage, int64_t t_us);
+
+/**
+ * @brief Moves the events of the ring into the histograms.
+ *
+ * Call it often enough that the ring does not wrap (e.g. after each frame).
+ *
+ * @return false if another task is collecting.
+ */
+bool latency_trace_collect(void);
+
+/** @brief Number of intervals (pairs of stages) with a histogram. */
+int latency_trace_interval_count(void);
+
+/** @brief Name of an interval, e.g. "s3_detect". */
+const char *latency_trace_interval_name(int interval);
+
+/**
+ * @brief Collects, then gives the percentiles of every interval.
+ *
+ * @param out latency_trace_interval_count() entries.
+ * @param counters Optional.
+ * @return false if another task is collecting.
+ */
+bool latency_trace_get_stats(latency_trace_interval_t *out, latency_trace_counters_t *counters);
+
+/**
+ * @brief Collects, then writes the stats as one JSON object:
+ * {"type":"trace_stats","traces":N,"lost":N,"abandoned":N,"stages":[{"name":..,"n":..,"p50":..,"p95":..,"p99":..,"max":..,"mean":..},..]}
+ * Times in us, intervals without frames are left out.
+ *
+ * @return Length written (without the terminating 0), 0 if the buffer is too small or another task is collecting.
+ */
+size_t latency_trace_to_json(char *buf, size_t len);
+
+/**
+ * @brief Clears the histograms and the counters, keeps the frames in flight.
+ *
+ * @return false if another task is collecting.
+ */
+bool latency_trace_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LATENCY_TRACE_H
@@ -22,10 +22,46 @@
 #include "mqtt.h"
 #endif
 
+#if FACE_UPLOAD_ENABLED
+#include "face_upload.h"
+#endif
+
+#if CLOUD_IDENTITY_ENABLED
+#include "cloud_identity.h"
+#endif
+
 #if WEBSOCKET_ENABLED
 #include "websocket_server.h"
 #endif
 
+#if STORAGE_ENABLED
+#include "storage_manager.h"
+#include "face_database.h"
+#endif
+
+#if DIAGNOSTICS_ENABLED
+#include "app_diagnostics.h"
+#endif
+#if KERNEL_BENCH_ENABLED
+#include "kernel_bench.h"
+#endif
+
+#if FACE_RECOGNITION_ENABLED
+#include "image_processor.h"
+#endif
+
+#if LATENCY_TRACE_ENABLED
+#include "latency_trace.h"
+#endif
+
+#if BINLOG_ENABLED
+#include "binlog.h"
+#endif
+
+#if HEALTH_TELEMETRY_ENABLED
+#include "health_telemetry.h"
+#endif
+
 static const char* TAG = "MAIN";
 
 #if MQTT_ENABLED
@@ -40,6 +76,22 @@ static void on_mqtt_connection_change(bool connected, esp_mqtt_client_handle_t c
 }
 #endif // End of MQTT_ENABLED
 
+#if HEALTH_TELEMETRY_ENABLED
+// Health snapshots of the S3 and of the cameras: MQTT when connected (ctx: the client), the console otherwise
+static void publish_health(const char *source, const char *json, void *ctx) {
+#if MQTT_ENABLED
+    esp_mqtt_client_handle_t client = ctx;
+    if (client != NULL && mqtt_is_connected()) {
+        char topic[96];
+        snprintf(topic, sizeof(topic), HEALTH_TELEMETRY_TOPIC "/%s", source);
+        mqtt_publish_message(client, topic, json, 0, 0);
+        return;
+    }
+#endif
+    ESP_LOGI(TAG, "Health of %s: %s", source, json);
+}
+#endif // End of HEALTH_TELEMETRY_ENABLED
+
 void app_main(void) {
     // Logging
     esp_log_level_set("*", ESP_LOG_INFO);
@@ -56,6 +108,69 @@ void app_main(void) {
         ESP_ERROR_CHECK(nvs_flash_init());
     }
 
+#if STORAGE_ENABLED
+    // Storage & face metadata
+    if (storage_init() == ESP_OK) {
+        ret = database_init();
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Face database failed: %s", esp_err_to_name(ret));
+        }
+#if DIAGNOSTICS_ENABLED
+        diagnostics_run_storage_test();
+        diagnostics_run_database_test();
+#if DIAGNOSTICS_DB_BENCHMARK_RECORDS > 0
+        diagnostics_run_database_benchmark(DIAGNOSTICS_DB_BENCHMARK_RECORDS);
+#endif
+#endif // End of DIAGNOSTICS_ENABLED
+    }
+    else {
+        ESP_LOGE(TAG, "Storage failed! Face database not available.");
+    }
+#endif // End of STORAGE_ENABLED
+
+#if DIAGNOSTICS_ENABLED && IDENTITY_CACHE_ENABLED
+    diagnostics_run_identity_cache_test();
+#endif
+
+#if KERNEL_BENCH_ENABLED
+    // Before the models take the memory, nothing else runs yet
+    kernel_bench_config_t bench_config = {
+        .warmup = KERNEL_BENCH_WARMUP,
+        .reps = KERNEL_BENCH_REPS,
+        .format = KERNEL_BENCH_JSON_OUTPUT ? KERNEL_BENCH_JSON : KERNEL_BENCH_CSV,
+        .filter = KERNEL_BENCH_FILTER,
+    };
+    ESP_LOGI(TAG, "Kernel benchmark: %d cases", kernel_bench_run(&bench_config));
+#endif
+
+#if LATENCY_TRACE_ENABLED
+    // Before the WebSocket server and the image processor stamp frames
+    if (!latency_trace_init(LATENCY_TRACE_RING_SIZE)) {
+        ESP_LOGE(TAG, "Latency trace failed, frames are not traced.");
+    }
+#endif
+
+#if BINLOG_ENABLED
+    // After the kernel benchmark, it times binlog on its own rings
+    binlog_config_t binlog_config = {
+        .records = BINLOG_RECORDS,
+        .burst = BINLOG_RATE_BURST,
+        .window_ms = BINLOG_RATE_WINDOW_MS,
+    };
+    if (!binlog_init(&binlog_config) || !binlog_start_console_task(BINLOG_PRINT_PERIOD_MS, 1)) {
+        binlog_deinit();
+        ESP_LOGE(TAG, "Binary log failed, messages go through esp_log.");
+    }
+#endif
+
+#if FACE_RECOGNITION_ENABLED
+    // Models load in the background while WiFi and the WebSocket server come up
+    ret = image_processor_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Image processor failed: %s", esp_err_to_name(ret));
+    }
+#endif // End of FACE_RECOGNITION_ENABLED
+
     // WiFi
     if (WIFI_ENABLED) { //
         ESP_LOGI(TAG, "Initializing WiFi...");
@@ -81,6 +196,18 @@ void app_main(void) {
         if (mqtt_client != NULL) {
             ESP_ERROR_CHECK(mqtt_start(mqtt_client)); //
             ESP_LOGI(TAG, "MQTT initialized and started");
+#if FACE_UPLOAD_ENABLED
+            ret = face_upload_init(mqtt_client);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Face upload failed: %s", esp_err_to_name(ret));
+            }
+#endif
+#if CLOUD_IDENTITY_ENABLED
+            ret = cloud_identity_init(mqtt_client);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Cloud identities failed: %s", esp_err_to_name(ret));
+            }
+#endif
         }
         else {
             ESP_LOGE(TAG, "Failed to initialize MQTT");
@@ -91,6 +218,18 @@ void app_main(void) {
     }
 #endif // End of MQTT_ENABLED
 
+#if HEALTH_TELEMETRY_ENABLED
+    // Before the WebSocket server, it forwards the cameras' snapshots
+#if MQTT_ENABLED
+    ret = health_telemetry_start("s3", HEALTH_TELEMETRY_PERIOD_MS, publish_health, mqtt_client);
+#else
+    ret = health_telemetry_start("s3", HEALTH_TELEMETRY_PERIOD_MS, publish_health, NULL);
+#endif
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Health telemetry failed: %s", esp_err_to_name(ret));
+    }
+#endif // End of HEALTH_TELEMETRY_ENABLED
+
 #if WEBSOCKET_ENABLED
     if (WIFI_ENABLED && wifi_is_connected()) { //
         ESP_LOGI(TAG, "Starting WebSocket Server...");
@@ -125,6 +264,21 @@ void app_main(void) {
     // Main loop: not doing much currently, load periodic tasks here...
     while (1) {
         ESP_LOGD(TAG, "Main loop running...");
+#if DIAGNOSTICS_ENABLED && IDENTITY_CACHE_ENABLED
+        diagnostics_print_identity_cache_stats();
+#endif
+#if DIAGNOSTICS_ENABLED && FACE_UPLOAD_ENABLED
+        diagnostics_print_face_upload_stats();
+#endif
+#if DIAGNOSTICS_ENABLED && UNKNOWN_CLUSTER_ENABLED
+        diagnostics_print_unknown_cluster_stats();
+#endif
+#if DIAGNOSTICS_ENABLED && CLOUD_IDENTITY_ENABLED
+        diagnostics_print_cloud_identity_stats();
+#endif
+#if DIAGNOSTICS_ENABLED && LATENCY_TRACE_ENABLED
+        diagnostics_print_latency_trace_stats();
+#endif
         vTaskDelay(pdMS_TO_TICKS(SAMPLING_INTERVAL_MS)); 
     }
 }
@@ -13,8 +13,11 @@
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "esp_mac.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "mqtt.h"
 #include "config.h"
+#include "binlog.h"
 #include "../certificates/secret.h" // Contains AWS_IOT_ENDPOINT, AWS_IOT_CLIENT_ID, MQTT_TOPIC_BASE
 
 
@@ -27,18 +30,53 @@ extern const char _binary_new_certificate_pem_start[]; // asm("_binary_new_certi
 extern const char _binary_new_private_key_start[]; // asm("_binary_new_private_key_start");
 
 static void (*connection_state_callback)(bool connected, esp_mqtt_client_handle_t client) = NULL;
+static void (*published_callback)(int msg_id) = NULL;
+
+#define MQTT_MAX_DATA_CALLBACKS 4
+static void (*data_callbacks[MQTT_MAX_DATA_CALLBACKS])(const char *topic, int topic_len, const char *data,
+                                                       int data_len, int offset, int total_len);
+
+// Topics subscribed with mqtt_subscribe(), subscribed again on every connect (clean session)
+#define MQTT_MAX_SUBSCRIPTIONS 4
+static struct {
+    const char *topic;
+    int qos;
+} subscriptions[MQTT_MAX_SUBSCRIPTIONS];
+
+#if MQTT_V5_ENABLED && !defined(CONFIG_MQTT_PROTOCOL_5)
+#error "MQTT_V5_ENABLED needs CONFIG_MQTT_PROTOCOL_5=y (menuconfig: ESP-MQTT Configurations)"
+#endif
+
+// Publish properties are set with one call and used by the next publish of any task, publishes go one at a time
+static SemaphoreHandle_t publish_lock = NULL;
 
 // function implementation
 void mqtt_register_connection_callback(void (*callback)(bool connected, esp_mqtt_client_handle_t client)) {
     connection_state_callback = callback;
 }
 
+void mqtt_register_published_callback(void (*callback)(int msg_id)) {
+    published_callback = callback;
+}
+
+esp_err_t mqtt_register_data_callback(void (*callback)(const char *topic, int topic_len, const char *data, int data_len,
+                                                       int offset, int total_len)) {
+    for (int i = 0; i < MQTT_MAX_DATA_CALLBACKS; i++) {
+        if (data_callbacks[i] == NULL || data_callbacks[i] == callback) {
+            data_callbacks[i] = callback;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
 // Update the MQTT event handler function to use the callback
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
     esp_mqtt_event_handle_t event = event_data;
     esp_mqtt_client_handle_t client = event->client;
     
+    mqtt_topic_handle_event(client, (esp_mqtt_event_id_t)event_id);
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT connected to AWS IoT!");
@@ -64,9 +102,15 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
                      "{\"message\":\"Device connected\",\"client_id\":\"%s\",\"topic\":\"%s\",\"timestamp\":%llu}",
                      client_id, MQTT_TOPIC_BASE, (unsigned long long)(esp_timer_get_time() / 1000));
             
-            // Publish to a dedicated connection status topic
+            // Publish to a dedicated connection status topic. Not through mqtt_publish_message(): the
+            // MQTT task must not wait for publish_lock, a publishing task may wait for the MQTT task
             ESP_LOGI(TAG, "Sending initialization message: %s", init_message);
-            mqtt_publish_message(client, MQTT_TOPIC_BASE "/status/connect", init_message, 1, 0);
+            esp_mqtt_client_publish(client, MQTT_TOPIC_BASE "/status/connect", init_message, 0, 1, 0);
+
+            for (int i = 0; i < MQTT_MAX_SUBSCRIPTIONS && subscriptions[i].topic != NULL; i++) {
+                int msg_id = esp_mqtt_client_subscribe(client, subscriptions[i].topic, subscriptions[i].qos);
+                ESP_LOGI(TAG, "Subscribed to %s, msg_id=%d", subscriptions[i].topic, msg_id);
+            }
             
             // Call the connection callback if registered
             if (connection_state_callback != NULL) {
@@ -86,13 +130,20 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             break;
             
         case MQTT_EVENT_PUBLISHED:
-            ESP_LOGI(TAG, "MQTT message published, msg_id=%d", event->msg_id);
+            ESP_LOGD(TAG, "MQTT message published, msg_id=%d", event->msg_id);
+            if (published_callback != NULL) {
+                published_callback(event->msg_id);
+            }
             break;
             
         case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG, "MQTT data received:");
-            ESP_LOGI(TAG, "  Topic: %.*s", event->topic_len, event->topic);
-            ESP_LOGI(TAG, "  Data: %.*s", event->data_len, event->data);
+            // Payloads can be binary, only the topic and the size are logged
+            ESP_LOGD(TAG, "MQTT data received: topic %.*s, %d bytes (offset %d of %d)", event->topic_len, event->topic,
+                     event->data_len, event->current_data_offset, event->total_data_len);
+            for (int i = 0; i < MQTT_MAX_DATA_CALLBACKS && data_callbacks[i] != NULL; i++) {
+                data_callbacks[i](event->topic, event->topic_len, event->data, event->data_len,
+                                  event->current_data_offset, event->total_data_len);
+            }
             break;
             
         case MQTT_EVENT_ERROR:
@@ -129,6 +180,9 @@ esp_mqtt_client_handle_t mqtt_aws_init(void)
             .client_id = AWS_IOT_CLIENT_ID
         },
         .session = {
+#if MQTT_V5_ENABLED
+            .protocol_ver = MQTT_PROTOCOL_V_5,
+#endif
             .last_will = {
                 .topic = MQTT_TOPIC_STATUS,
                 .msg = "offline",
@@ -137,12 +191,22 @@ esp_mqtt_client_handle_t mqtt_aws_init(void)
         }
     };
     
-    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
+    publish_lock = xSemaphoreCreateMutex();
+    mqtt_topic_init(publish_lock, MQTT_V5_ENABLED, MQTT_TOPIC_ALIAS_MAX);
+    esp_mqtt_client_handle_t client = publish_lock ? esp_mqtt_client_init(&mqtt_cfg) : NULL;
     if (client == NULL) {
         ESP_LOGE(TAG, "Failed to initialize MQTT client");
         return NULL;
     }
     
+#if MQTT_V5_ENABLED
+    // Aliases the broker may use for the topics it sends us, ours are limited by its CONNACK
+    esp_mqtt5_connection_property_config_t connect_property = {
+        .topic_alias_maximum = MQTT_TOPIC_ALIAS_MAX,
+    };
+    esp_mqtt5_client_set_connect_property(client, &connect_property);
+#endif
+    
     esp_err_t err = esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, client);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register MQTT event handler: %s", esp_err_to_name(err));
@@ -176,20 +240,69 @@ int mqtt_publish_message(esp_mqtt_client_handle_t client, const char *topic, con
         return -1;
     }
     
-    ESP_LOGI(TAG, "Publishing to topic: %s", topic);
-    ESP_LOGI(TAG, "Message data: %s", data);
-    ESP_LOGI(TAG, "QoS: %d, Retain: %d", qos, retain);
+    BINLOGI(TAG, "Publishing to topic: %s", topic);
+    BINLOGI(TAG, "Message data: %s", data);
+    BINLOGI(TAG, "QoS: %d, Retain: %d", qos, retain);
     
-    int msg_id = esp_mqtt_client_publish(client, topic, data, 0, qos, retain);
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    int msg_id = esp_mqtt_client_publish(client, topic, data, strlen(data), qos, retain);
+    xSemaphoreGive(publish_lock);
     if (msg_id < 0) {
         ESP_LOGE(TAG, "Failed to publish to topic %s", topic);
     } else {
-        ESP_LOGI(TAG, "Published to topic %s, msg_id=%d", topic, msg_id);
+        BINLOGI(TAG, "Published to topic %s, msg_id=%d", topic, msg_id);
     }
     
     return msg_id;
 }
 
+int mqtt_publish_binary(esp_mqtt_client_handle_t client, const char *topic, const void *data, int len, int qos, int retain)
+{
+    if (client == NULL || topic == NULL || data == NULL || len <= 0) {
+        ESP_LOGE(TAG, "Invalid arguments for mqtt_publish_binary");
+        return -1;
+    }
+
+    // Explicit length: esp_mqtt_client_publish() treats len 0 as a C string and stops at the first zero byte
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    int msg_id = esp_mqtt_client_publish(client, topic, (const char *)data, len, qos, retain);
+    xSemaphoreGive(publish_lock);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to publish %d bytes to topic %s", len, topic);
+    } else {
+        ESP_LOGD(TAG, "Published %d bytes to topic %s, msg_id=%d", len, topic, msg_id);
+    }
+    
+    return msg_id;
+}
+
+esp_err_t mqtt_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    if (client == NULL || topic == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int slot = 0;
+    while (slot < MQTT_MAX_SUBSCRIPTIONS && subscriptions[slot].topic != NULL &&
+           strcmp(subscriptions[slot].topic, topic) != 0) {
+        slot++;
+    }
+    if (slot == MQTT_MAX_SUBSCRIPTIONS) {
+        ESP_LOGE(TAG, "No subscription slot for %s", topic);
+        return ESP_ERR_NO_MEM;
+    }
+    subscriptions[slot].topic = topic;
+    subscriptions[slot].qos = qos;
+    if (!mqtt_connected_status) {
+        return ESP_OK; // on MQTT_EVENT_CONNECTED
+    }
+    int msg_id = esp_mqtt_client_subscribe(client, topic, qos);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to subscribe to %s", topic);
+    } else {
+        ESP_LOGI(TAG, "Subscribed to %s, msg_id=%d", topic, msg_id);
+    }
+    return ESP_OK;
+}
 
 bool mqtt_is_connected(void)
 {
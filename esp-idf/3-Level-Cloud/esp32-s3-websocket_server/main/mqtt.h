@@ -8,8 +8,10 @@
 #ifndef MQTT_H
 #define MQTT_H
 
+#include <stdint.h>
 #include "esp_err.h"
 #include "mqtt_client.h"
+#include "mqtt_topic.h" // mqtt_topic_register(), mqtt_publish_topic()
 
 /**
  * @brief Initialize MQTT client for AWS IoT
@@ -38,6 +40,21 @@ esp_err_t mqtt_start(esp_mqtt_client_handle_t client);
  */
 int mqtt_publish_message(esp_mqtt_client_handle_t client, const char *topic, const char *data, int qos, int retain);
 
+/**
+ * @brief Publish a binary payload (may contain zero bytes)
+ * 
+ * For QoS 1/2 the payload is copied to the outbox, the buffer can be reused on return.
+ * 
+ * @param client MQTT client handle
+ * @param topic MQTT topic to publish to
+ * @param data Payload
+ * @param len Payload length in bytes
+ * @param qos Quality of Service (0, 1, or 2)
+ * @param retain Retain flag
+ * @return Message ID of the publish operation (0 for QoS 0), -1 on failure
+ */
+int mqtt_publish_binary(esp_mqtt_client_handle_t client, const char *topic, const void *data, int len, int qos, int retain);
+
 /**
  * @brief Check if MQTT client is connected to broker
  * 
@@ -52,4 +69,35 @@ bool mqtt_is_connected(void);
  */
  void mqtt_register_connection_callback(void (*callback)(bool connected, esp_mqtt_client_handle_t client));
 
+/**
+ * Register a callback function to be called when the broker acknowledged a publish (MQTT_EVENT_PUBLISHED)
+ * 
+ * @param callback Function to call with the msg_id of the acknowledged message. Runs in the MQTT task.
+ */
+void mqtt_register_published_callback(void (*callback)(int msg_id));
+
+/**
+ * Register a callback function to be called for every received message (MQTT_EVENT_DATA)
+ * 
+ * Up to MQTT_MAX_DATA_CALLBACKS callbacks, each one gets every message and checks the topic itself.
+ * Messages bigger than the MQTT buffer arrive in fragments (offset/total_len), small ones in one call.
+ * 
+ * @param callback Function to call. Runs in the MQTT task.
+ * @return ESP_OK, ESP_ERR_NO_MEM if all callback slots are taken
+ */
+esp_err_t mqtt_register_data_callback(void (*callback)(const char *topic, int topic_len, const char *data, int data_len,
+                                                       int offset, int total_len));
+
+/**
+ * @brief Subscribe to a topic, now if connected and again after every reconnect
+ * 
+ * Up to MQTT_MAX_SUBSCRIPTIONS topics. The received messages go to the data callbacks.
+ * 
+ * @param client MQTT client handle
+ * @param topic Topic filter, must stay valid (a string literal)
+ * @param qos Maximum QoS of the messages received
+ * @return ESP_OK, ESP_ERR_NO_MEM if all subscription slots are taken
+ */
+esp_err_t mqtt_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+
 #endif // MQTT_H
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/unistd.h>
 #include <sys/stat.h>
@@ -8,11 +9,13 @@
 
 static const char* TAG = "STORAGE_MANAGER";
 
+static bool s_mounted = false;
+
 esp_err_t storage_init(void) {
     ESP_LOGI(TAG, "Initializing SPIFFS");
 
     esp_vfs_spiffs_conf_t conf = {
-      .base_path = "/spiffs",
+      .base_path = STORAGE_BASE_PATH,
       .partition_label = "storage", // Must match the name in partitions.csv
       .max_files = 5,               // Max number of files open at once
       .format_if_mount_failed = true
@@ -39,9 +42,14 @@ esp_err_t storage_init(void) {
         ESP_LOGI(TAG, "Partition size: total: %d, used: %d", total, used);
     }
     ESP_LOGI(TAG, "SPIFFS mounted successfully at %s", conf.base_path);
+    s_mounted = true;
     return ESP_OK;
 }
 
+bool storage_is_mounted(void) {
+    return s_mounted;
+}
+
 esp_err_t storage_write_file(const char* path, const char* data) {
     ESP_LOGD(TAG, "Writing to file: %s", path);
     FILE* f = fopen(path, "w");
@@ -12,6 +12,12 @@
 #include "esp_err.h"
 #include <stdbool.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STORAGE_BASE_PATH "/spiffs"
+
 /**
  * @brief Initializes the SPIFFS filesystem.
  *
@@ -22,6 +28,13 @@
  */
 esp_err_t storage_init(void);
 
+/**
+ * @brief Checks if storage_init() mounted the filesystem.
+ *
+ * @return bool true if files under STORAGE_BASE_PATH can be opened.
+ */
+bool storage_is_mounted(void);
+
 /**
  * @brief Writes (overwrites) data to a file on the filesystem.
  *
@@ -52,4 +65,8 @@ esp_err_t storage_read_file(const char* path, char** buffer);
  */
 bool storage_file_exists(const char* path);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // STORAGE_MANAGER_H
\ No newline at end of file
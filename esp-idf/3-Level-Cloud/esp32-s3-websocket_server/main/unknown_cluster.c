@@ -0,0 +1,216 @@
+/**
+ * @file unknown_cluster.c
+ * @brief Leader clustering of unknown faces with decaying cluster weights.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unknown_cluster.h"
+
+typedef struct {
+    uint32_t id;          // 0 when the slot is free
+    float scale;          // leader = int8 values * scale
+    float weight;         // at weight_us
+    int64_t weight_us;
+    uint32_t sightings;
+    uint32_t covered;     // sightings uploaded or reported
+    int uploads;
+    float best_quality;   // of the uploaded faces
+    int camera_id;
+    int64_t first_us;
+    int64_t last_us;
+    int64_t last_report_us;
+} cluster_t;
+
+static struct {
+    unknown_cluster_config_t config;
+    cluster_t *clusters;
+    int8_t *leaders;      // capacity * feat_len
+    int8_t *query;        // feat_len, quantized input
+    uint32_t next_id;
+    unknown_cluster_stats_t stats;
+} s_clusters;
+
+// Symmetric int8, returns the scale
+static float quantize(const float *feat, int len, int8_t *out) {
+    float max_abs = 0;
+    for (int i = 0; i < len; i++) {
+        float a = fabsf(feat[i]);
+        if (a > max_abs) {
+            max_abs = a;
+        }
+    }
+    float scale = max_abs > 0 ? max_abs / 127.0f : 1.0f;
+    float inv = 1.0f / scale;
+    for (int i = 0; i < len; i++) {
+        int q = (int)lrintf(feat[i] * inv);
+        out[i] = (int8_t)(q > 127 ? 127 : (q < -127 ? -127 : q));
+    }
+    return scale;
+}
+
+static int32_t dot_i8(const int8_t *a, const int8_t *b, int len) {
+    int32_t sum = 0;
+    for (int i = 0; i < len; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static float decayed_weight(const cluster_t *c, int64_t now_us) {
+    int64_t dt = now_us - c->weight_us;
+    if (dt <= 0) {
+        return c->weight;
+    }
+    return c->weight * exp2f(-(float)dt / (float)(s_clusters.config.half_life_ms * 1000));
+}
+
+bool unknown_cluster_init(const unknown_cluster_config_t *config) {
+    unknown_cluster_deinit();
+    if (!config || config->capacity <= 0 || config->feat_len <= 0 || config->half_life_ms <= 0) {
+        return false;
+    }
+    s_clusters.config = *config;
+    s_clusters.clusters = calloc(config->capacity, sizeof(cluster_t));
+    s_clusters.leaders = malloc((size_t)config->capacity * config->feat_len);
+    s_clusters.query = malloc(config->feat_len);
+    if (!s_clusters.clusters || !s_clusters.leaders || !s_clusters.query) {
+        unknown_cluster_deinit();
+        return false;
+    }
+    s_clusters.next_id = 1;
+    return true;
+}
+
+void unknown_cluster_deinit(void) {
+    free(s_clusters.clusters);
+    free(s_clusters.leaders);
+    free(s_clusters.query);
+    memset(&s_clusters, 0, sizeof(s_clusters));
+}
+
+void unknown_cluster_add(const float *feat, float quality, int camera_id, int64_t now_us,
+                         unknown_cluster_result_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!s_clusters.clusters) {
+        out->upload = true; // not clustering, everything goes up
+        return;
+    }
+    const unknown_cluster_config_t *cfg = &s_clusters.config;
+    float query_scale = quantize(feat, cfg->feat_len, s_clusters.query);
+    s_clusters.stats.faces++;
+
+    // One pass: best match, forget decayed clusters, find the slot a new cluster would take
+    cluster_t *best = NULL;
+    float best_sim = cfg->threshold;
+    cluster_t *slot = NULL;
+    float slot_weight = INFINITY;
+    for (int i = 0; i < cfg->capacity; i++) {
+        cluster_t *c = &s_clusters.clusters[i];
+        if (c->id == 0) {
+            if (slot_weight > -1.0f) {
+                slot = c;
+                slot_weight = -1.0f; // free slots first
+            }
+            continue;
+        }
+        float weight = decayed_weight(c, now_us);
+        if (weight < cfg->min_weight) {
+            c->id = 0;
+            s_clusters.stats.expired++;
+            s_clusters.stats.active--;
+            slot = c;
+            slot_weight = -1.0f;
+            continue;
+        }
+        float sim = dot_i8(s_clusters.query, s_clusters.leaders + (size_t)i * cfg->feat_len, cfg->feat_len) *
+                    query_scale * c->scale;
+        if (sim > best_sim) {
+            best_sim = sim;
+            best = c;
+        }
+        if (weight < slot_weight) {
+            slot = c;
+            slot_weight = weight;
+        }
+    }
+
+    if (best) {
+        best->weight = decayed_weight(best, now_us) + 1.0f;
+        best->weight_us = now_us;
+        best->sightings++;
+        best->last_us = now_us;
+        best->camera_id = camera_id;
+        out->cluster_id = best->id;
+        out->sightings = best->sightings;
+        out->similarity = best_sim;
+        if (best->uploads < cfg->max_uploads && quality > best->best_quality + cfg->best_margin) {
+            out->upload = true;
+            best->uploads++;
+            best->best_quality = quality;
+            best->covered = best->sightings;
+            best->last_report_us = now_us;
+            s_clusters.stats.uploads++;
+        } else {
+            s_clusters.stats.suppressed++;
+        }
+        return;
+    }
+
+    if (slot->id != 0) {
+        s_clusters.stats.evicted++;
+        s_clusters.stats.active--;
+    }
+    memset(slot, 0, sizeof(*slot));
+    slot->id = s_clusters.next_id++;
+    if (s_clusters.next_id == 0) {
+        s_clusters.next_id = 1;
+    }
+    slot->scale = query_scale;
+    memcpy(s_clusters.leaders + (size_t)(slot - s_clusters.clusters) * cfg->feat_len, s_clusters.query,
+           cfg->feat_len);
+    slot->weight = 1.0f;
+    slot->weight_us = now_us;
+    slot->sightings = 1;
+    slot->covered = 1;
+    slot->uploads = 1;
+    slot->best_quality = quality;
+    slot->camera_id = camera_id;
+    slot->first_us = now_us;
+    slot->last_us = now_us;
+    slot->last_report_us = now_us;
+    s_clusters.stats.clusters++;
+    s_clusters.stats.uploads++;
+    s_clusters.stats.active++;
+
+    out->cluster_id = slot->id;
+    out->sightings = 1;
+    out->new_cluster = true;
+    out->upload = true;
+    out->similarity = 1.0f;
+}
+
+bool unknown_cluster_next_report(int64_t now_us, unknown_cluster_report_t *out) {
+    for (int i = 0; s_clusters.clusters && i < s_clusters.config.capacity; i++) {
+        cluster_t *c = &s_clusters.clusters[i];
+        if (c->id == 0 || c->sightings == c->covered ||
+            now_us - c->last_report_us < s_clusters.config.report_ms * 1000) {
+            continue;
+        }
+        out->cluster_id = c->id;
+        out->sightings = c->sightings;
+        out->new_sightings = c->sightings - c->covered;
+        out->camera_id = c->camera_id;
+        out->first_us = c->first_us;
+        out->last_us = c->last_us;
+        c->covered = c->sightings;
+        c->last_report_us = now_us;
+        return true;
+    }
+    return false;
+}
+
+void unknown_cluster_get_stats(unknown_cluster_stats_t *out) {
+    *out = s_clusters.stats;
+}
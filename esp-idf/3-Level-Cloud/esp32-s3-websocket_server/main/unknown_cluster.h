@@ -0,0 +1,105 @@
+/**
+ * @file unknown_cluster.h
+ * @brief Online clustering of unknown faces, so a stranger is uploaded once.
+ *
+ * Leader clustering: an unknown embedding joins the most similar cluster
+ * if the similarity is above the threshold, otherwise it starts a new
+ * cluster and becomes its leader. Only the first face of a cluster is
+ * uploaded, or a later one whose quality beats the uploaded one by a
+ * margin. The other sightings are only counted and reported periodically
+ * (unknown_cluster_next_report()).
+ *
+ * Every cluster has a weight: +1 per sighting, halved every half_life_ms
+ * without sightings. A cluster whose weight drops below min_weight is
+ * forgotten. When the table is full, the cluster with the lowest weight
+ * makes room.
+ *
+ * Leaders are stored as int8 with one scale (feat_len bytes each), the
+ * query is quantized once and compared with integer dot products.
+ *
+ * No ESP-IDF dependencies: the cloud-tier tool runs the same file in its
+ * cluster benchmark. Not thread safe, use it from one task.
+ */
+
+#ifndef UNKNOWN_CLUSTER_H
+#define UNKNOWN_CLUSTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int capacity;         // clusters kept
+    int feat_len;         // embedding elements
+    float threshold;      // similarity to join a cluster (embeddings are L2 normalized)
+    int64_t half_life_ms; // weight halves after this without sightings
+    float min_weight;     // cluster forgotten below this
+    float best_margin;    // upload again if the quality beats the uploaded one by this
+    int max_uploads;      // uploads per cluster, first one included
+    int64_t report_ms;    // sightings of a cluster reported at most this often
+} unknown_cluster_config_t;
+
+typedef struct {
+    uint32_t cluster_id;  // unique, never 0
+    uint32_t sightings;   // sightings of the cluster, this one included
+    bool new_cluster;
+    bool upload;          // upload this face as the cluster representative
+    float similarity;     // to the leader, 1 for a new cluster
+} unknown_cluster_result_t;
+
+typedef struct {
+    uint32_t cluster_id;
+    uint32_t sightings;   // total so far
+    uint32_t new_sightings; // since the last report
+    int camera_id;        // of the last sighting
+    int64_t first_us;
+    int64_t last_us;
+} unknown_cluster_report_t;
+
+typedef struct {
+    uint32_t faces;       // unknown faces added
+    uint32_t clusters;    // clusters created
+    uint32_t uploads;     // faces marked for upload
+    uint32_t suppressed;  // faces only counted
+    uint32_t expired;     // clusters forgotten by decay
+    uint32_t evicted;     // clusters pushed out, table full
+    uint32_t active;      // clusters in the table
+} unknown_cluster_stats_t;
+
+/** @brief Allocates the table, clears the previous one. */
+bool unknown_cluster_init(const unknown_cluster_config_t *config);
+
+void unknown_cluster_deinit(void);
+
+/**
+ * @brief Adds an unknown face.
+ *
+ * @param feat Embedding, feat_len floats, L2 normalized.
+ * @param quality Face quality, higher is better (e.g. detection score x size).
+ * @param camera_id Source camera.
+ * @param now_us Any monotonic clock.
+ * @param[out] out Cluster of the face and whether to upload it.
+ */
+void unknown_cluster_add(const float *feat, float quality, int camera_id, int64_t now_us,
+                         unknown_cluster_result_t *out);
+
+/**
+ * @brief Takes the next sighting report that is due.
+ *
+ * A cluster is reported when it has sightings that were not uploaded or
+ * reported, and report_ms passed since its last report (or its upload).
+ *
+ * @return false if none is due.
+ */
+bool unknown_cluster_next_report(int64_t now_us, unknown_cluster_report_t *out);
+
+void unknown_cluster_get_stats(unknown_cluster_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UNKNOWN_CLUSTER_H
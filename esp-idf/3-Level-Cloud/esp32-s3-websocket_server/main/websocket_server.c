@@ -11,10 +11,22 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
 
 #include "websocket_server.h"
 #include "config.h"
 #include "cJSON.h" 
+#include "binlog.h"
+
+#if FACE_RECOGNITION_ENABLED
+#include "image_processor.h"
+#endif
+#if LATENCY_TRACE_ENABLED
+#include "latency_trace.h"
+#endif
+#if HEALTH_TELEMETRY_ENABLED
+#include "health_telemetry.h"
+#endif
 
 #ifndef WEBSOCKET_PORT
 #define WEBSOCKET_PORT 80
@@ -29,6 +41,8 @@ typedef struct {
     size_t received_size;
     bool is_receiving;
     uint32_t id; // frame ID: maybe use some more advanced than int++, MAC ADDRESS?
+    int width; // crop size (RGB565), 0 if the client didn't send it
+    int height;
 } frame_receive_state_t;
 
 typedef struct {
@@ -73,6 +87,8 @@ static void reset_client_frame_state(int fd) {
         client_frame_states[client_index].received_size = 0;
         client_frame_states[client_index].total_size = 0;
         client_frame_states[client_index].id = 0; // Reset ID
+        client_frame_states[client_index].width = 0;
+        client_frame_states[client_index].height = 0;
     }
 }
 
@@ -141,15 +157,51 @@ static esp_err_t websocket_handler(httpd_req_t* req) {
                 free(buf);
                 return ret;
             }
+            int64_t received_us = esp_timer_get_time();
 
             cJSON *root = cJSON_Parse((const char*)buf);
             if (root) {
                 cJSON *type = cJSON_GetObjectItem(root, "type");
                 if (cJSON_IsString(type)) {
                     if (strcmp(type->valuestring, "heartbeat") == 0) {
-                        ESP_LOGI(TAG, "Heartbeat received from fd %d", httpd_req_to_sockfd(req));
-                        const char* pong_msg = "{\"type\":\"heartbeat_ack\"}";
+                        BINLOGI(TAG, "Heartbeat received from fd %d", httpd_req_to_sockfd(req));
+                        // With the client's send time "t": echoed with our receive and send times, the client
+                        // estimates the offset between the clocks from the four (NTP style)
+                        cJSON *t = cJSON_GetObjectItem(root, "t");
+                        char pong_msg[112];
+                        if (cJSON_IsNumber(t)) {
+                            snprintf(pong_msg, sizeof(pong_msg), "{\"type\":\"heartbeat_ack\",\"t1\":%.0f,\"t2\":%lld,\"t3\":%lld}",
+                                     t->valuedouble, (long long)received_us, (long long)esp_timer_get_time());
+                        } else {
+                            snprintf(pong_msg, sizeof(pong_msg), "{\"type\":\"heartbeat_ack\"}");
+                        }
                         websocket_server_send_text_client(httpd_req_to_sockfd(req), pong_msg);
+#if LATENCY_TRACE_ENABLED
+                    } else if (strcmp(type->valuestring, "trace_stats") == 0) {
+                        char *stats = malloc(2048);
+                        if (stats && latency_trace_to_json(stats, 2048) > 0) {
+                            websocket_server_send_text_client(httpd_req_to_sockfd(req), stats);
+                        }
+                        free(stats);
+                        if (cJSON_IsTrue(cJSON_GetObjectItem(root, "reset"))) {
+                            latency_trace_reset();
+                        }
+#endif
+#if HEALTH_TELEMETRY_ENABLED
+                    } else if (strcmp(type->valuestring, "health") == 0) {
+                        if (cJSON_IsString(cJSON_GetObjectItem(root, "dev"))) {
+                            // A camera's snapshot, published as cam<client index>
+                            char source[16];
+                            snprintf(source, sizeof(source), "cam%d", client_index);
+                            health_telemetry_forward(source, (const char*)buf);
+                        } else {
+                            char *health = malloc(HEALTH_TELEMETRY_JSON_SIZE);
+                            if (health && health_telemetry_to_json(health, HEALTH_TELEMETRY_JSON_SIZE) > 0) {
+                                websocket_server_send_text_client(httpd_req_to_sockfd(req), health);
+                            }
+                            free(health);
+                        }
+#endif
 
                     } else if (strcmp(type->valuestring, "frame_start") == 0) {
                         if (client_frame_states[client_index].is_receiving) {
@@ -162,10 +214,33 @@ static esp_err_t websocket_handler(httpd_req_t* req) {
                             client_frame_states[client_index].total_size = size->valueint;
                             client_frame_states[client_index].id = id->valueint; // Store the ID
                             client_frame_states[client_index].received_size = 0;
+                            // Optional crop size, needed to run recognition on the frame
+                            cJSON *w = cJSON_GetObjectItem(root, "w");
+                            cJSON *h = cJSON_GetObjectItem(root, "h");
+                            client_frame_states[client_index].width = cJSON_IsNumber(w) ? w->valueint : 0;
+                            client_frame_states[client_index].height = cJSON_IsNumber(h) ? h->valueint : 0;
                             client_frame_states[client_index].buffer = malloc(size->valueint);
+#if LATENCY_TRACE_ENABLED
+                            // Camera stages, already in our clock: capture, detect 1, detect 2, dequeue, crop, frame_start sent
+                            cJSON *trace = cJSON_GetObjectItem(root, "trace");
+                            if (cJSON_IsArray(trace)) {
+                                int stage = TRACE_CAPTURE;
+                                cJSON *t;
+                                cJSON_ArrayForEach(t, trace) {
+                                    if (stage > TRACE_TX_START) {
+                                        break;
+                                    }
+                                    if (cJSON_IsNumber(t)) {
+                                        latency_trace_stamp(id->valueint, client_index, stage, (int64_t)t->valuedouble);
+                                    }
+                                    stage++;
+                                }
+                            }
+                            latency_trace_stamp(id->valueint, client_index, TRACE_RX_START, received_us);
+#endif
                             if (client_frame_states[client_index].buffer) {
                                 client_frame_states[client_index].is_receiving = true;
-                                ESP_LOGI(TAG, "Got frame_start for ID: %d, Size: %d", (int)id->valueint, (int)size->valueint);
+                                BINLOGI(TAG, "Got frame_start for ID: %d, Size: %d", (int)id->valueint, (int)size->valueint);
                             } else {
                                 ESP_LOGE(TAG, "Failed to allocate buffer!");
                             }
@@ -174,15 +249,38 @@ static esp_err_t websocket_handler(httpd_req_t* req) {
                          if (client_frame_states[client_index].is_receiving) {
                             if (client_frame_states[client_index].received_size == client_frame_states[client_index].total_size) {
                                 // NEW: Log the ID on completion
-                                ESP_LOGI(TAG, "Transfer complete for Frame ID: %d. Total size: %d",
+                                BINLOGI(TAG, "Transfer complete for Frame ID: %d. Total size: %d",
                                     (int)client_frame_states[client_index].id, (int)client_frame_states[client_index].total_size);
                                 const char* ack_msg = "{\"type\":\"frame_ack\"}";
                                 websocket_server_send_text_client(httpd_req_to_sockfd(req), ack_msg);
+                                frame_receive_state_t* st = &client_frame_states[client_index];
+#if LATENCY_TRACE_ENABLED
+                                latency_trace_stamp(st->id, client_index, TRACE_RX_END, received_us);
+#endif
+#if FACE_RECOGNITION_ENABLED
+                                if (st->width > 0 && st->height > 0 && (size_t)st->width * st->height * 2 == st->total_size) {
+                                    // Queued even while the models are loading, the image processor owns the buffer now
+                                    image_processor_submit(client_index, st->buffer, st->total_size, st->width, st->height,
+                                                           IMAGE_PIX_RGB565, st->id);
+                                    st->buffer = NULL;
+                                } else {
+                                    ESP_LOGW(TAG, "Frame ID %d has no valid crop size, not recognized.", (int)st->id);
+#if LATENCY_TRACE_ENABLED
+                                    latency_trace_stamp(st->id, client_index, TRACE_DONE, received_us);
+#endif
+                                }
+#elif LATENCY_TRACE_ENABLED
+                                latency_trace_stamp(st->id, client_index, TRACE_DONE, received_us);
+#endif
+
                             } else {
                                 ESP_LOGE(TAG, "Frame end for ID %d received, but size mismatch! Expected %d, got %d", 
                                     (int)client_frame_states[client_index].id,
                                     (int)client_frame_states[client_index].total_size, 
                                     (int)client_frame_states[client_index].received_size);
+#if LATENCY_TRACE_ENABLED
+                                latency_trace_stamp(client_frame_states[client_index].id, client_index, TRACE_DONE, received_us);
+#endif
                             }
                          }
                          reset_client_frame_state(httpd_req_to_sockfd(req));
@@ -57,6 +57,7 @@ private:
     std::string m_doc_string;                      /*!< doc string of model */
     size_t m_internal_size;                        /*!< Internal RAM usage */
     size_t m_psram_size;                           /*!< PSRAM usage */
+    static runtime_mode_t s_default_runtime_mode;  /*!< Runtime mode of run() calls without a mode */
 
 public:
     Model() {}
@@ -254,7 +255,7 @@ public:
      *
      * @param mode  Runtime mode.
      */
-    virtual void run(runtime_mode_t mode = RUNTIME_MODE_SINGLE_CORE);
+    virtual void run(runtime_mode_t mode = get_default_runtime_mode());
 
     /**
      * @brief Run the model module by module.
@@ -262,7 +263,7 @@ public:
      * @param input  The model input.
      * @param mode   Runtime mode.
      */
-    virtual void run(TensorBase *input, runtime_mode_t mode = RUNTIME_MODE_SINGLE_CORE);
+    virtual void run(TensorBase *input, runtime_mode_t mode = get_default_runtime_mode());
 
     /**
      * @brief Run the model module by module.
@@ -274,9 +275,26 @@ public:
      * graphical output, which can be obtained through Model::get_outputs().
      */
     virtual void run(std::map<std::string, TensorBase *> &user_inputs,
-                     runtime_mode_t mode = RUNTIME_MODE_SINGLE_CORE,
+                     runtime_mode_t mode = get_default_runtime_mode(),
                      std::map<std::string, TensorBase *> user_outputs = {});
 
+    /**
+     * @brief Set the runtime mode used by run() when no mode is passed, for all models.
+     *
+     * Wrappers (detectors, feature extractors) call run() without a mode, this selects single core or multi core
+     * inference for them. Takes effect on the next run().
+     *
+     * @param mode Runtime mode.
+     */
+    static void set_default_runtime_mode(runtime_mode_t mode) { s_default_runtime_mode = mode; }
+
+    /**
+     * @brief Get the runtime mode used by run() when no mode is passed.
+     *
+     * @return runtime_mode_t RUNTIME_MODE_SINGLE_CORE unless changed by set_default_runtime_mode().
+     */
+    static runtime_mode_t get_default_runtime_mode() { return s_default_runtime_mode; }
+
     /**
      * @brief Minimize the model.
      */
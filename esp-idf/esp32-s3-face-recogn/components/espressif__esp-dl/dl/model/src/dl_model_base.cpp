@@ -10,6 +10,8 @@ static const char *TAG = "dl::Model";
 
 namespace dl {
 
+runtime_mode_t Model::s_default_runtime_mode = RUNTIME_MODE_SINGLE_CORE;
+
 Model::Model(const char *rodata_address_or_partition_label_or_path,
              fbs::model_location_type_t location,
              int max_internal_size,
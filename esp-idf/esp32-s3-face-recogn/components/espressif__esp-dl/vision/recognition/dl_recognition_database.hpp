@@ -19,6 +19,8 @@ public:
     std::vector<result_t> query_feat(TensorBase *feat, float thr, int top_k);
     void print();
     int get_num_feats() { return m_meta.num_feats_valid; }
+    // Id given to the last enrolled feature (ids are not reused), 0 if empty
+    int get_last_feat_id() { return m_feats.empty() ? 0 : m_feats.back().id; }
 
 private:
     char *m_db_path;
@@ -1,9 +1,35 @@
 #include "esp_log.h"
+#include "esp_spiffs.h"
 #include "nvs_flash.h"
 #include "image_processor.hpp"
 
 static const char *TAG = "APP_MAIN";
 
+// Throughput of single-core / multi-core / pipelined recognition over the bundled faces
+#define RUN_BENCHMARK 1
+#define BENCHMARK_ROUNDS 4
+
+// The recognition database is a file (FACE_DB_PATH) on the 'storage' partition of partitions.csv
+static esp_err_t mount_storage(void)
+{
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = FACE_DB_MOUNT_POINT,
+        .partition_label = "storage",
+        .max_files = 5,
+        .format_if_mount_failed = true,
+    };
+    esp_err_t ret = esp_vfs_spiffs_register(&conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mount the 'storage' partition at %s (%s).", conf.base_path, esp_err_to_name(ret));
+        return ret;
+    }
+    size_t total = 0, used = 0;
+    if (esp_spiffs_info(conf.partition_label, &total, &used) == ESP_OK) {
+        ESP_LOGI(TAG, "Storage mounted at %s: %u of %u bytes used.", conf.base_path, (unsigned)used, (unsigned)total);
+    }
+    return ESP_OK;
+}
+
 // face recong based on esp-who. no functionailities....
 extern "C" void app_main(void)
 {
@@ -14,10 +40,19 @@ extern "C" void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    // Without it no face can be enrolled, every test and benchmark would come out empty
+    if (mount_storage() != ESP_OK) {
+        ESP_LOGE(TAG, "No recognition database, app stopped.");
+        return;
+    }
+
     ESP_LOGI(TAG, "ESP-WHO face recognition start...");
 
     ImageProcessor *app_processor = new ImageProcessor();
     app_processor->run_recognition_test();
+#if RUN_BENCHMARK
+    app_processor->run_benchmark(BENCHMARK_ROUNDS);
+#endif
 
     ESP_LOGI(TAG, "App finished...");
 
@@ -1,24 +1,82 @@
 #include "face_recognizer.hpp"
 #include "human_face_detect.hpp"
 #include "human_face_recognition.hpp"
+#include "dl_model_base.hpp"
 #include "esp_log.h"
+#include <algorithm>
 
 static const char *TAG = "FACE_RECOGN";
 
+// Same as the HumanFaceRecognizer default
+#define FACE_MATCH_THRESHOLD 0.5f
+
 // from esp-who libraries. BE VERY CAREFUL WITH THE VERSIONS!
+// The feature model and the database are used directly (not through
+// HumanFaceRecognizer) so feature extraction can run as its own stage.
 FaceRecognizer::FaceRecognizer() {
     m_detector = new HumanFaceDetect();
-    m_recognizer = new HumanFaceRecognizer((char*)"face.db"); // db needs to be created!
-    ESP_LOGI(TAG, "ESP-WHO libs Init.");
+    m_feat = new HumanFaceFeat();
+    m_db = new dl::recognition::DataBase(FACE_DB_PATH, m_feat->m_feat_len); // created if missing
+    ESP_LOGI(TAG, "ESP-WHO libs Init, %d faces in %s.", m_db->get_num_feats(), FACE_DB_PATH);
 }
 
 // Free the memory when object is destroyed
 FaceRecognizer::~FaceRecognizer() {
     delete m_detector;
-    delete m_recognizer;
+    delete m_db;
+    delete m_feat;
     ESP_LOGI(TAG, "ESP-WHO libs unloaded (deleted objects).");
 }
 
+void FaceRecognizer::set_runtime_mode(dl::runtime_mode_t mode) {
+    dl::Model::set_default_runtime_mode(mode);
+}
+
+dl::runtime_mode_t FaceRecognizer::get_runtime_mode() {
+    return dl::Model::get_default_runtime_mode();
+}
+
+int FaceRecognizer::get_num_faces() {
+    return m_db->get_num_feats();
+}
+
+bool FaceRecognizer::clear_faces() {
+    return m_db->clear_all_feats() == ESP_OK;
+}
+
+bool FaceRecognizer::detect_face(const dl::image::img_t& image, std::vector<int>& keypoints) {
+    std::list<dl::detect::result_t>& faces = m_detector->run(image);
+    if (faces.empty()) {
+        return false;
+    }
+    auto largest = std::max_element(faces.begin(), faces.end(),
+                                    [](const dl::detect::result_t& a, const dl::detect::result_t& b) {
+                                        return a.box_area() < b.box_area();
+                                    });
+    // Copied, the detector reuses its result list on the next run
+    keypoints = largest->keypoint;
+    return true;
+}
+
+int FaceRecognizer::enroll_face(const dl::image::img_t& image, const std::vector<int>& keypoints) {
+    dl::TensorBase* feat = m_feat->run(image, keypoints);
+    if (m_db->enroll_feat(feat) != ESP_OK) {
+        ESP_LOGW(TAG, "Face not stored in db file.");
+        return -1;
+    }
+    // Ids are not reused, so after a delete they no longer match the count
+    return m_db->get_last_feat_id();
+}
+
+int FaceRecognizer::identify_face(const dl::image::img_t& image, const std::vector<int>& keypoints) {
+    dl::TensorBase* feat = m_feat->run(image, keypoints);
+    std::vector<dl::recognition::result_t> results = m_db->query_feat(feat, FACE_MATCH_THRESHOLD, 1);
+    if (results.empty()) {
+        return -1;
+    }
+    return results.front().id;
+}
+
 int FaceRecognizer::enroll_face(uint8_t *image_buffer) {
     dl::image::img_t image;
     image.width = 160;
@@ -26,15 +84,14 @@ int FaceRecognizer::enroll_face(uint8_t *image_buffer) {
     image.data = image_buffer;
     image.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888;
 
-    std::list<dl::detect::result_t> faces = m_detector->run(image);
-
-    if (faces.empty()) {
+    std::vector<int> keypoints;
+    if (!detect_face(image, keypoints)) {
         ESP_LOGW(TAG, "No face found in incoming image.");
         return -1;
     }
 
     // Returns the ID of the new face
-    int enrolled_id = m_recognizer->enroll(image, faces);
+    int enrolled_id = enroll_face(image, keypoints);
     ESP_LOGI(TAG, "Ported image result ID: %d", enrolled_id);
     return enrolled_id;
 }
@@ -46,20 +103,16 @@ int FaceRecognizer::recognize_face(uint8_t *image_buffer) {
     image.data = image_buffer;
     image.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888;
 
-    std::list<dl::detect::result_t> faces = m_detector->run(image);
-
-    if (faces.empty()) {
+    std::vector<int> keypoints;
+    if (!detect_face(image, keypoints)) {
         ESP_LOGI(TAG, "No face detected in image.");
         return -1;
-    } 
+    }
 
-    std::vector<dl::recognition::result_t> results = m_recognizer->recognize(image, faces);
-    
-    if (results.empty()) {
+    int id = identify_face(image, keypoints);
+    if (id < 0) {
         ESP_LOGI(TAG, "UNknown face detected (no match in dB).");
-        return -1;
     }
-    
     // Return the ID of the best match if any
-    return results.front().id;
+    return id;
 }
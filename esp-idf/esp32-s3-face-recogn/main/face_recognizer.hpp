@@ -1,15 +1,27 @@
 #pragma once
 
+#include "dl_define.hpp"
 #include "dl_image_define.hpp"
 #include "dl_detect_define.hpp"
 #include "dl_recognition_define.hpp"
 #include <list>
 #include <vector>
 
+namespace dl { namespace recognition { class DataBase; } }
+
+// Recognition database, on the SPIFFS 'storage' partition that app_main mounts
+#define FACE_DB_MOUNT_POINT "/spiffs"
+#define FACE_DB_PATH FACE_DB_MOUNT_POINT "/face.db"
+
 /**
  * @class FaceRecognizer
  * @brief ESP-WHO libs for enrolling and recognizing raw images.
  * No FreeRTOS dependencies.
+ *
+ * Besides the one-call enroll/recognize API, the two stages are exposed
+ * separately (detect_face, then enroll/identify with the keypoints), so a
+ * caller can run them on different tasks and overlap the detection of one
+ * frame with the feature extraction of the previous one.
  */
 class FaceRecognizer {
 public:
@@ -30,7 +42,43 @@ public:
      */
     int recognize_face(uint8_t* image_buffer);
 
+    /**
+     * @brief Stage 1: finds the largest face of an image.
+     * @param image Image of any size (RGB888 or RGB565).
+     * @param keypoints Filled with the landmarks of the largest face.
+     * @return true if a face was found.
+     */
+    bool detect_face(const dl::image::img_t& image, std::vector<int>& keypoints);
+
+    /**
+     * @brief Stage 2: extracts the features of a detected face and adds them to the database.
+     * @return The new ID of the enrolled face, or -1 on falure.
+     */
+    int enroll_face(const dl::image::img_t& image, const std::vector<int>& keypoints);
+
+    /**
+     * @brief Stage 2: extracts the features of a detected face and queries the database.
+     * @return The ID of the best match, or -1 if unknown.
+     */
+    int identify_face(const dl::image::img_t& image, const std::vector<int>& keypoints);
+
+    /**
+     * @brief Selects single-core or multi-core (both cores per layer) inference for both models.
+     * Applies to every model in the application, from the next inference on.
+     */
+    static void set_runtime_mode(dl::runtime_mode_t mode);
+    static dl::runtime_mode_t get_runtime_mode();
+
+    int get_num_faces();
+
+    /**
+     * @brief Removes every face from the database, the file included. Ids start over.
+     * @return true on success.
+     */
+    bool clear_faces();
+
 private:
     class HumanFaceDetect* m_detector;
-    class HumanFaceRecognizer* m_recognizer;
+    class HumanFaceFeat* m_feat;
+    dl::recognition::DataBase* m_db;
 };
@@ -1,14 +1,61 @@
 #include "image_processor.hpp"
 #include "esp_log.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "dl_image_jpeg.hpp"
+#include <vector>
 
 // Image resolution for QQVGA (160x120) in RGB888 format from ESP32-CAM. Change at will...
 #define IMAGE_WIDTH 160
 #define IMAGE_HEIGHT 120
 #define IMAGE_SIZE (IMAGE_WIDTH * IMAGE_HEIGHT * 3)
 
+// Pipelined benchmark: detection on one core, features + db query on the other
+#define PIPELINE_DETECT_CORE 0
+#define PIPELINE_FEAT_CORE 1
+#define PIPELINE_QUEUE_LEN 2
+#define PIPELINE_TASK_STACK 8192
+
 static const char *TAG = "IMG_PROCESS";
 
+// Bundled faces, see EMBED_FILES in CMakeLists.txt
+extern const uint8_t face1_jpg_start[] asm("_binary_face1_jpg_start");
+extern const uint8_t face1_jpg_end[] asm("_binary_face1_jpg_end");
+extern const uint8_t face6_jpg_start[] asm("_binary_face6_jpg_start");
+extern const uint8_t face6_jpg_end[] asm("_binary_face6_jpg_end");
+extern const uint8_t face7_jpg_start[] asm("_binary_face7_jpg_start");
+extern const uint8_t face7_jpg_end[] asm("_binary_face7_jpg_end");
+extern const uint8_t face8_jpg_start[] asm("_binary_face8_jpg_start");
+extern const uint8_t face8_jpg_end[] asm("_binary_face8_jpg_end");
+extern const uint8_t face9_jpg_start[] asm("_binary_face9_jpg_start");
+extern const uint8_t face9_jpg_end[] asm("_binary_face9_jpg_end");
+
+// A decoded image with the id it got at enrollment
+struct bench_image_t {
+    dl::image::img_t image;
+    int id;
+};
+
+// Detected face handed from the detection task to the feature task
+struct pipeline_job_t {
+    const bench_image_t* bench;
+    std::vector<int> keypoints;
+};
+
+struct pipeline_ctx_t {
+    FaceRecognizer* recognizer;
+    std::vector<bench_image_t>* images;
+    int rounds;
+    QueueHandle_t jobs;        // pipeline_job_t*, nullptr ends the run
+    SemaphoreHandle_t done;    // given once by each task
+    int detected;
+    int recognized;
+};
+
 ImageProcessor::ImageProcessor() {
     m_face_recognizer = new FaceRecognizer();
 }
@@ -59,3 +106,188 @@ void ImageProcessor::run_recognition_test() {
     
     ESP_LOGI(TAG, "============ END RECOGNITION ============");
 }
+
+static bool decode_jpeg(const uint8_t* start, const uint8_t* end, dl::image::img_t& image) {
+    dl::image::jpeg_img_t jpeg = {
+        .data = (void*)start,
+        .data_len = (size_t)(end - start),
+    };
+    image = dl::image::sw_decode_jpeg(jpeg, dl::image::DL_IMAGE_PIX_TYPE_RGB888);
+    return image.data != nullptr;
+}
+
+// Sequential: every image goes through detection then feature extraction
+static void run_sequential(FaceRecognizer* recognizer, std::vector<bench_image_t>& images, int rounds,
+                           int& detected, int& recognized) {
+    std::vector<int> keypoints;
+    detected = 0;
+    recognized = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (bench_image_t& bench : images) {
+            if (!recognizer->detect_face(bench.image, keypoints)) {
+                continue;
+            }
+            detected++;
+            if (recognizer->identify_face(bench.image, keypoints) == bench.id) {
+                recognized++;
+            }
+        }
+    }
+}
+
+static void pipeline_detect_task(void* arg) {
+    pipeline_ctx_t* ctx = (pipeline_ctx_t*)arg;
+    for (int r = 0; r < ctx->rounds; r++) {
+        for (bench_image_t& bench : *ctx->images) {
+            pipeline_job_t* job = new pipeline_job_t();
+            job->bench = &bench;
+            if (!ctx->recognizer->detect_face(bench.image, job->keypoints)) {
+                delete job;
+                continue;
+            }
+            ctx->detected++;
+            // Blocks while the feature task is PIPELINE_QUEUE_LEN faces behind
+            xQueueSend(ctx->jobs, &job, portMAX_DELAY);
+        }
+    }
+    pipeline_job_t* end = nullptr;
+    xQueueSend(ctx->jobs, &end, portMAX_DELAY);
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+static void pipeline_feat_task(void* arg) {
+    pipeline_ctx_t* ctx = (pipeline_ctx_t*)arg;
+    pipeline_job_t* job;
+    while (xQueueReceive(ctx->jobs, &job, portMAX_DELAY) == pdTRUE && job) {
+        if (ctx->recognizer->identify_face(job->bench->image, job->keypoints) == job->bench->id) {
+            ctx->recognized++;
+        }
+        delete job;
+    }
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+// Pipelined: detection of image N+1 overlaps the feature extraction of image N.
+// Each model is only used by its own task, both single core.
+static bool run_pipelined(FaceRecognizer* recognizer, std::vector<bench_image_t>& images, int rounds,
+                          int& detected, int& recognized) {
+    pipeline_ctx_t ctx = {
+        .recognizer = recognizer,
+        .images = &images,
+        .rounds = rounds,
+        .jobs = xQueueCreate(PIPELINE_QUEUE_LEN, sizeof(pipeline_job_t*)),
+        .done = xSemaphoreCreateCounting(2, 0),
+        .detected = 0,
+        .recognized = 0,
+    };
+    bool ok = ctx.jobs && ctx.done;
+    if (ok && xTaskCreatePinnedToCore(pipeline_feat_task, "pipe_feat", PIPELINE_TASK_STACK, &ctx,
+                                      uxTaskPriorityGet(NULL), NULL, PIPELINE_FEAT_CORE) != pdPASS) {
+        ok = false;
+    }
+    if (ok && xTaskCreatePinnedToCore(pipeline_detect_task, "pipe_detect", PIPELINE_TASK_STACK, &ctx,
+                                      uxTaskPriorityGet(NULL), NULL, PIPELINE_DETECT_CORE) != pdPASS) {
+        // Stop the feature task that is already waiting
+        pipeline_job_t* end = nullptr;
+        xQueueSend(ctx.jobs, &end, portMAX_DELAY);
+        xSemaphoreTake(ctx.done, portMAX_DELAY);
+        ok = false;
+    }
+    if (ok) {
+        xSemaphoreTake(ctx.done, portMAX_DELAY);
+        xSemaphoreTake(ctx.done, portMAX_DELAY);
+    } else {
+        ESP_LOGE(TAG, "Failed to start the pipeline tasks.");
+    }
+    if (ctx.jobs) vQueueDelete(ctx.jobs);
+    if (ctx.done) vSemaphoreDelete(ctx.done);
+    detected = ctx.detected;
+    recognized = ctx.recognized;
+    return ok;
+}
+
+static void log_throughput(const char* mode, int64_t elapsed_us, int images, int detected, int recognized) {
+    float seconds = elapsed_us / 1000000.0f;
+    ESP_LOGI(TAG, "%-12s %6.2f faces/s  (%d images in %lld ms, %d detected, %d recognized)", mode,
+             seconds > 0 ? detected / seconds : 0.0f, images, (long long)(elapsed_us / 1000), detected, recognized);
+}
+
+void ImageProcessor::run_benchmark(int rounds) {
+    ESP_LOGI(TAG, "========== START BENCHMARK ==========");
+
+    const uint8_t* jpegs[][2] = {
+        { face1_jpg_start, face1_jpg_end },
+        { face6_jpg_start, face6_jpg_end },
+        { face7_jpg_start, face7_jpg_end },
+        { face8_jpg_start, face8_jpg_end },
+        { face9_jpg_start, face9_jpg_end },
+    };
+    dl::runtime_mode_t saved_mode = FaceRecognizer::get_runtime_mode();
+    FaceRecognizer::set_runtime_mode(dl::RUNTIME_MODE_SINGLE_CORE);
+
+    // The database persists across boots: the copies enrolled by an earlier run would be the best matches
+    if (!m_face_recognizer->clear_faces()) {
+        ESP_LOGE(TAG, "Failed to clear the recognition database, benchmark skipped.");
+        FaceRecognizer::set_runtime_mode(saved_mode);
+        return;
+    }
+
+    // Decode and enroll, the recognized id of each image must match its own
+    std::vector<bench_image_t> images;
+    std::vector<int> keypoints;
+    for (int i = 0; i < (int)(sizeof(jpegs) / sizeof(jpegs[0])); i++) {
+        bench_image_t bench = {};
+        if (!decode_jpeg(jpegs[i][0], jpegs[i][1], bench.image)) {
+            ESP_LOGW(TAG, "Failed to decode bundled face %d.", i);
+            continue;
+        }
+        if (!m_face_recognizer->detect_face(bench.image, keypoints)) {
+            ESP_LOGW(TAG, "No face in bundled face %d (%dx%d), skipped.", i, bench.image.width, bench.image.height);
+            heap_caps_free(bench.image.data);
+            continue;
+        }
+        bench.id = m_face_recognizer->enroll_face(bench.image, keypoints);
+        if (bench.id < 0) {
+            ESP_LOGW(TAG, "Bundled face %d not enrolled, skipped.", i);
+            heap_caps_free(bench.image.data);
+            continue;
+        }
+        images.push_back(bench);
+    }
+    int total = images.size() * rounds;
+    if (images.empty()) {
+        ESP_LOGE(TAG, "No bundled face enrolled, nothing to benchmark.");
+    } else {
+        ESP_LOGI(TAG, "%d faces enrolled (%d in the database), %d rounds.", (int)images.size(),
+                 m_face_recognizer->get_num_faces(), rounds);
+    }
+
+    if (!images.empty()) {
+        int detected, recognized;
+        int64_t start;
+
+        FaceRecognizer::set_runtime_mode(dl::RUNTIME_MODE_SINGLE_CORE);
+        start = esp_timer_get_time();
+        run_sequential(m_face_recognizer, images, rounds, detected, recognized);
+        log_throughput("single-core", esp_timer_get_time() - start, total, detected, recognized);
+
+        FaceRecognizer::set_runtime_mode(dl::RUNTIME_MODE_MULTI_CORE);
+        start = esp_timer_get_time();
+        run_sequential(m_face_recognizer, images, rounds, detected, recognized);
+        log_throughput("multi-core", esp_timer_get_time() - start, total, detected, recognized);
+
+        FaceRecognizer::set_runtime_mode(dl::RUNTIME_MODE_SINGLE_CORE);
+        start = esp_timer_get_time();
+        if (run_pipelined(m_face_recognizer, images, rounds, detected, recognized)) {
+            log_throughput("pipelined", esp_timer_get_time() - start, total, detected, recognized);
+        }
+    }
+
+    for (bench_image_t& bench : images) {
+        heap_caps_free(bench.image.data);
+    }
+    FaceRecognizer::set_runtime_mode(saved_mode);
+    ESP_LOGI(TAG, "============ END BENCHMARK ============");
+}
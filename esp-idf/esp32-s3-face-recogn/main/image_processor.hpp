@@ -17,6 +17,16 @@ public:
      */
     void run_recognition_test();
 
+    /**
+     * @brief Throughput of the recognition over the bundled database JPEGs.
+     * Enrolls every image, then recognizes them all `rounds` times with:
+     * single-core models, multi-core models (each layer split over both
+     * cores) and a pipeline (detection on core 0 overlapping the feature
+     * extraction of the previous image on core 1). Logs faces/s per mode.
+     * @param rounds passes over the image set per mode.
+     */
+    void run_benchmark(int rounds);
+
 private:
     /**
      * @brief Creates a dummy QQVGA image for testing.
@@ -4,44 +4,65 @@
  * 
  * Handles BME280 sensor initialization and reading temperature, 
  * humidity, and pressure data.
+ *
+ * The sensor sleeps between samples: every sample is a forced-mode
+ * measurement, read once its datasheet measurement time has passed, with
+ * status and data registers in one burst. Compensation is the integer
+ * version from the datasheet. Periodic sampling runs on the sampler
+ * (sampler.c), deadline-driven from a timer.
  */
 
  #include <stdio.h>
  #include <string.h>
  #include <stdlib.h>
+ #include <sys/time.h>
  #include "freertos/FreeRTOS.h"
  #include "freertos/task.h"
  #include "esp_log.h"
- #include "driver/i2c.h"
+ #include "driver/i2c_master.h"
  #include "esp_err.h"
+ #include "esp_timer.h"
  #include "mqtt_client.h"
  
  #include "bme280.h"
  #include "mqtt.h"
  #include "config.h"
+ #include "sampler.h"
+ #include "telemetry_batch.h"
+ #include "sensor_aggregate.h"
+ #include "ts_store.h"
  
  static const char *TAG = "BME280";
- static TaskHandle_t bme280_task_handle = NULL;
  static bool bme280_initialized = false;
- static uint8_t BME280_I2C_ADDR = 0x77;  // Default, will be updated during init if needed
-
+ static esp_mqtt_client_handle_t bme280_mqtt_client = NULL;
+ 
+ // Registered once, sent as a topic alias over MQTT 5
+ static mqtt_topic_t topic_json = MQTT_TOPIC_INVALID;
+ static mqtt_topic_t topic_batch = MQTT_TOPIC_INVALID;
+ static mqtt_topic_t topic_field[3] = { MQTT_TOPIC_INVALID, MQTT_TOPIC_INVALID, MQTT_TOPIC_INVALID };
+ static i2c_master_bus_handle_t i2c_bus = NULL;
+ static i2c_master_dev_handle_t i2c_dev = NULL;
+ 
+ #define I2C_TIMEOUT_MS 100
+ 
  // BME280 registers
+ #define BME280_REG_CALIB_00         0x88  // 0x88..0xA1: T1..T3, P1..P9, H1
  #define BME280_REG_CHIP_ID          0xD0
  #define BME280_REG_RESET            0xE0
+ #define BME280_REG_CALIB_26         0xE1  // 0xE1..0xE7: H2..H6
  #define BME280_REG_CTRL_HUM         0xF2
  #define BME280_REG_STATUS           0xF3
  #define BME280_REG_CTRL_MEAS        0xF4
  #define BME280_REG_CONFIG           0xF5
  #define BME280_REG_PRESS_MSB        0xF7
- #define BME280_REG_PRESS_LSB        0xF8
- #define BME280_REG_PRESS_XLSB       0xF9
- #define BME280_REG_TEMP_MSB         0xFA
- #define BME280_REG_TEMP_LSB         0xFB
- #define BME280_REG_TEMP_XLSB        0xFC
- #define BME280_REG_HUM_MSB          0xFD
- #define BME280_REG_HUM_LSB          0xFE
  
  #define BME280_CHIP_ID              0x60
+ #define BME280_STATUS_MEASURING     0x08
+ #define BME280_MODE_FORCED          0x01
+ 
+ #define BME280_CALIB_00_LEN         26
+ #define BME280_CALIB_26_LEN         7
+ #define BME280_BURST_LEN            12  // status .. hum_lsb (0xF3..0xFE)
  
  // Calibration data
  typedef struct {
@@ -67,199 +88,74 @@
  
  static bme280_calib_data_t calib_data;
  static int32_t t_fine;
+ static uint8_t ctrl_meas;       // oversampling settings, forced mode
+ static int32_t measurement_us;  // maximum measurement time for them
  
- // I2C functions
- static esp_err_t i2c_master_init(void)
+ static esp_err_t bme280_read_reg(uint8_t reg_addr, uint8_t *data, size_t len)
  {
-     int i2c_master_port = I2C_NUM_0;
-     i2c_config_t conf = {
-         .mode = I2C_MODE_MASTER,
-         .sda_io_num = BME280_SDA_PIN,
-         .scl_io_num = BME280_SCL_PIN,
-         .sda_pullup_en = GPIO_PULLUP_ENABLE,
-         .scl_pullup_en = GPIO_PULLUP_ENABLE,
-         .master.clk_speed = 100000,  // 100 KHz
-     };
-     
-     esp_err_t err = i2c_param_config(i2c_master_port, &conf);
-     if (err != ESP_OK) {
-         ESP_LOGE(TAG, "I2C config failed: %s", esp_err_to_name(err));
-         return err;
-     }
-     
-     err = i2c_driver_install(i2c_master_port, conf.mode, 0, 0, 0);
-     if (err != ESP_OK) {
-         ESP_LOGE(TAG, "I2C driver install failed: %s", esp_err_to_name(err));
-         return err;
+     // Register address, repeated start, then len bytes (auto-increment) in one transaction
+     esp_err_t ret = i2c_master_transmit_receive(i2c_dev, &reg_addr, 1, data, len, I2C_TIMEOUT_MS);
+     if (ret != ESP_OK) {
+         ESP_LOGE(TAG, "Failed to read register 0x%02x: %s", reg_addr, esp_err_to_name(ret));
      }
-     
-     ESP_LOGI(TAG, "I2C initialized successfully");
-     return ESP_OK;
+     return ret;
  }
  
-static esp_err_t bme280_read_reg(uint8_t reg_addr, uint8_t *data, size_t len)
-{
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BME280_I2C_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg_addr, true);
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BME280_I2C_ADDR << 1) | I2C_MASTER_READ, true);
-    if (len > 1) {
-        i2c_master_read(cmd, data, len - 1, I2C_MASTER_ACK);
-    }
-    i2c_master_read_byte(cmd, data + len - 1, I2C_MASTER_NACK);
-    i2c_master_stop(cmd);
-    
-    // Increase timeout to 100ms for more reliable communication
-    esp_err_t ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, 100 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read register 0x%02x: %s", reg_addr, esp_err_to_name(ret));
-    }
-    
-    // Add delay between I2C operations to prevent bus flooding
-    vTaskDelay(1 / portTICK_PERIOD_MS);
-    
-    return ret;
-}
- 
  static esp_err_t bme280_write_reg(uint8_t reg_addr, uint8_t data)
  {
-     i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-     
-     i2c_master_start(cmd);
-     i2c_master_write_byte(cmd, (BME280_I2C_ADDR << 1) | I2C_MASTER_WRITE, true);
-     i2c_master_write_byte(cmd, reg_addr, true);
-     i2c_master_write_byte(cmd, data, true);
-     i2c_master_stop(cmd);
-     
-     esp_err_t ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, 1000 / portTICK_PERIOD_MS);
-     i2c_cmd_link_delete(cmd);
-     
+     const uint8_t buf[2] = { reg_addr, data };
+     esp_err_t ret = i2c_master_transmit(i2c_dev, buf, sizeof(buf), I2C_TIMEOUT_MS);
      if (ret != ESP_OK) {
          ESP_LOGE(TAG, "Failed to write to register 0x%02x: %s", reg_addr, esp_err_to_name(ret));
      }
-     
      return ret;
  }
  
-
  static esp_err_t bme280_read_calibration_data(void)
  {
-     esp_err_t ret;
-     uint8_t reg_data;
-     
-     // Read each calibration register individually
-     // Temperature trimming parameters
-     uint8_t temp_msb, temp_lsb;
-     
-     // Read T1 (2 bytes at 0x88 and 0x89)
-     ret = bme280_read_reg(0x88, &temp_lsb, 1);
-     if (ret != ESP_OK) return ret;
-     
-     ret = bme280_read_reg(0x89, &temp_msb, 1);
-     if (ret != ESP_OK) return ret;
-     
-     calib_data.dig_T1 = (temp_msb << 8) | temp_lsb;
-     
-     // Read T2 (2 bytes at 0x8A and 0x8B)
-     ret = bme280_read_reg(0x8A, &temp_lsb, 1);
-     if (ret != ESP_OK) return ret;
-     
-     ret = bme280_read_reg(0x8B, &temp_msb, 1);
-     if (ret != ESP_OK) return ret;
-     
-     calib_data.dig_T2 = (int16_t)((temp_msb << 8) | temp_lsb);
-     
-     // Read T3 (2 bytes at 0x8C and 0x8D)
-     ret = bme280_read_reg(0x8C, &temp_lsb, 1);
-     if (ret != ESP_OK) return ret;
-     
-     ret = bme280_read_reg(0x8D, &temp_msb, 1);
-     if (ret != ESP_OK) return ret;
-     
-     calib_data.dig_T3 = (int16_t)((temp_msb << 8) | temp_lsb);
-     
-	 // Pressure trimming parameters (read a few to test). Compare with others for reliability!
-     // Read P1 (2 bytes at 0x8E and 0x8F)
-     ret = bme280_read_reg(0x8E, &temp_lsb, 1);
-     if (ret != ESP_OK) return ret;
-     
-     ret = bme280_read_reg(0x8F, &temp_msb, 1);
-     if (ret != ESP_OK) return ret;
-     
-     calib_data.dig_P1 = (temp_msb << 8) | temp_lsb;
-     
-     // Read H1 (1 byte at 0xA1)
-     ret = bme280_read_reg(0xA1, &reg_data, 1);
-     if (ret != ESP_OK) return ret;
-     
-     calib_data.dig_H1 = reg_data;
-     
-     // Read H2 (2 bytes at 0xE1 and 0xE2)
-     ret = bme280_read_reg(0xE1, &temp_lsb, 1);
-     if (ret != ESP_OK) return ret;
-     
-     ret = bme280_read_reg(0xE2, &temp_msb, 1);
-     if (ret != ESP_OK) return ret;
-     
-     calib_data.dig_H2 = (int16_t)((temp_msb << 8) | temp_lsb);
-     
-     // Read H3 (1 byte at 0xE3)
-     ret = bme280_read_reg(0xE3, &reg_data, 1);
-     if (ret != ESP_OK) return ret;
-     
-     calib_data.dig_H3 = reg_data;
+     uint8_t c[BME280_CALIB_00_LEN];
+     uint8_t e[BME280_CALIB_26_LEN];
      
-     // Read H4 and H5 (3 bytes at 0xE4, 0xE5, 0xE6 - shared)
-     uint8_t e4, e5, e6;
-     
-     ret = bme280_read_reg(0xE4, &e4, 1);
+     // Two bursts instead of one transaction per register
+     esp_err_t ret = bme280_read_reg(BME280_REG_CALIB_00, c, sizeof(c));
      if (ret != ESP_OK) return ret;
-     
-     ret = bme280_read_reg(0xE5, &e5, 1);
+     ret = bme280_read_reg(BME280_REG_CALIB_26, e, sizeof(e));
      if (ret != ESP_OK) return ret;
      
-     ret = bme280_read_reg(0xE6, &e6, 1);
-     if (ret != ESP_OK) return ret;
-     
-     // H4 = (0xE4[7:0] << 4) | (0xE5[3:0])
-     calib_data.dig_H4 = ((int16_t)e4 << 4) | (e5 & 0x0F);
-     
-     // H5 = (0xE6[7:0] << 4) | (0xE5[7:4])
-     calib_data.dig_H5 = ((int16_t)e6 << 4) | (e5 >> 4);
-     
-     // Read H6 (1 byte at 0xE7)
-     ret = bme280_read_reg(0xE7, &reg_data, 1);
-     if (ret != ESP_OK) return ret;
-     
-     calib_data.dig_H6 = (int8_t)reg_data;
-     
-     // Print the calibration values read successfully
-     ESP_LOGI(TAG, "Calibration data read (partial): T1=%u, T2=%d, T3=%d, P1=%u, H1=%u", 
-              calib_data.dig_T1, calib_data.dig_T2, calib_data.dig_T3, 
-              calib_data.dig_P1, calib_data.dig_H1);
-     
-     ESP_LOGI(TAG, "Humidity calibration: H1=%u, H2=%d, H3=%u, H4=%d, H5=%d, H6=%d", 
-              calib_data.dig_H1, calib_data.dig_H2, calib_data.dig_H3,
-              calib_data.dig_H4, calib_data.dig_H5, calib_data.dig_H6);
-     
-     // Get temperature working, set values if T1 is zero
-     if (calib_data.dig_T1 == 0) {
-         ESP_LOGW(TAG, "Using default calibration values for temperature");
-         calib_data.dig_T1 = 27504;  // Typical value
-         calib_data.dig_T2 = 26435;  // Typical value
-         calib_data.dig_T3 = -1000;  // Typical value
+     calib_data.dig_T1 = (uint16_t)(c[1] << 8 | c[0]);
+     calib_data.dig_T2 = (int16_t)(c[3] << 8 | c[2]);
+     calib_data.dig_T3 = (int16_t)(c[5] << 8 | c[4]);
+     calib_data.dig_P1 = (uint16_t)(c[7] << 8 | c[6]);
+     calib_data.dig_P2 = (int16_t)(c[9] << 8 | c[8]);
+     calib_data.dig_P3 = (int16_t)(c[11] << 8 | c[10]);
+     calib_data.dig_P4 = (int16_t)(c[13] << 8 | c[12]);
+     calib_data.dig_P5 = (int16_t)(c[15] << 8 | c[14]);
+     calib_data.dig_P6 = (int16_t)(c[17] << 8 | c[16]);
+     calib_data.dig_P7 = (int16_t)(c[19] << 8 | c[18]);
+     calib_data.dig_P8 = (int16_t)(c[21] << 8 | c[20]);
+     calib_data.dig_P9 = (int16_t)(c[23] << 8 | c[22]);
+     calib_data.dig_H1 = c[25];
+     calib_data.dig_H2 = (int16_t)(e[1] << 8 | e[0]);
+     calib_data.dig_H3 = e[2];
+     // H4 = 0xE4[7:0] << 4 | 0xE5[3:0], H5 = 0xE6[7:0] << 4 | 0xE5[7:4], both signed 12 bit
+     calib_data.dig_H4 = (int16_t)((int8_t)e[3] * 16 | (e[4] & 0x0F));
+     calib_data.dig_H5 = (int16_t)((int8_t)e[5] * 16 | (e[4] >> 4));
+     calib_data.dig_H6 = (int8_t)e[6];
+     
+     ESP_LOGI(TAG, "Calibration data: T1=%u, T2=%d, T3=%d, P1=%u, P9=%d, H1=%u, H2=%d, H4=%d, H5=%d",
+              calib_data.dig_T1, calib_data.dig_T2, calib_data.dig_T3, calib_data.dig_P1, calib_data.dig_P9,
+              calib_data.dig_H1, calib_data.dig_H2, calib_data.dig_H4, calib_data.dig_H5);
+     
+     if (calib_data.dig_T1 == 0 || calib_data.dig_P1 == 0) {
+         ESP_LOGE(TAG, "Invalid calibration data");
+         return ESP_ERR_INVALID_RESPONSE;
      }
      
      return ESP_OK;
  }
 
- // Compensate temperature reading based on calibration data
- static float bme280_compensate_temperature(int32_t adc_T)
+ // Temperature in 0.01 °C, sets t_fine for the other two
+ static int32_t bme280_compensate_temperature(int32_t adc_T)
  {
      int32_t var1, var2;
      
@@ -272,12 +168,11 @@ static esp_err_t bme280_read_reg(uint8_t reg_addr, uint8_t *data, size_t len)
              
      t_fine = var1 + var2;
      
-     float temperature = (t_fine * 5 + 128) >> 8;
-     return temperature / 100.0f;
+     return (t_fine * 5 + 128) >> 8;
  }
  
- // Compensate pressure reading based on calibration data
- static float bme280_compensate_pressure(int32_t adc_P)
+ // Pressure in Pa as Q24.8 (1/256 Pa)
+ static uint32_t bme280_compensate_pressure(int32_t adc_P)
  {
      int64_t var1, var2, p;
      
@@ -299,11 +194,11 @@ static esp_err_t bme280_read_reg(uint8_t reg_addr, uint8_t *data, size_t len)
      var2 = (((int64_t)calib_data.dig_P8) * p) >> 19;
      
      p = ((p + var1 + var2) >> 8) + (((int64_t)calib_data.dig_P7) << 4);
-     return (float)p / 256.0f / 100.0f; // Return pressure in hPa
+     return (uint32_t)p;
  }
  
- // Compensate humidity reading based on calibration data
- static float bme280_compensate_humidity(int32_t adc_H)
+ // Relative humidity in % as Q22.10 (1/1024 %)
+ static uint32_t bme280_compensate_humidity(int32_t adc_H)
  {
      int32_t v_x1_u32r;
      
@@ -320,47 +215,86 @@ static esp_err_t bme280_read_reg(uint8_t reg_addr, uint8_t *data, size_t len)
      v_x1_u32r = (v_x1_u32r < 0) ? 0 : v_x1_u32r;
      v_x1_u32r = (v_x1_u32r > 419430400) ? 419430400 : v_x1_u32r;
      
-     return (float)(v_x1_u32r >> 12) / 1024.0f;
+     return (uint32_t)(v_x1_u32r >> 12);
+ }
+ 
+ // osrs_x register field for an oversampling of 0 (skipped), 1, 2, 4, 8 or 16
+ static uint8_t oversampling_code(int oversampling)
+ {
+     uint8_t code = 0;
+     while (oversampling > 0 && code < 5) {
+         code++;
+         oversampling >>= 1;
+     }
+     return code;
+ }
+ 
+ // Maximum measurement time in µs (datasheet 9.1): 1.25 ms + 2.3 ms per T/P/H oversample + 0.575 ms each for P and H
+ static int32_t bme280_measurement_time_us(int osrs_t, int osrs_p, int osrs_h)
+ {
+     int32_t us = 1250 + 2300 * osrs_t;
+     if (osrs_p > 0) {
+         us += 2300 * osrs_p + 575;
+     }
+     if (osrs_h > 0) {
+         us += 2300 * osrs_h + 575;
+     }
+     return us;
  }
  
  esp_err_t bme280_init(void)
  {
      ESP_LOGI(TAG, "Initializing BME280 sensor");
      
-     // Initialize I2C
-     esp_err_t ret = i2c_master_init();
-     if (ret != ESP_OK) {
-         ESP_LOGE(TAG, "I2C initialization failed");
-         return ret;
+     // Initialize I2C (new master driver)
+     if (i2c_bus == NULL) {
+         i2c_master_bus_config_t bus_config = {
+             .i2c_port = I2C_NUM_0,
+             .sda_io_num = BME280_SDA_PIN,
+             .scl_io_num = BME280_SCL_PIN,
+             .clk_source = I2C_CLK_SRC_DEFAULT,
+             .glitch_ignore_cnt = 7,
+             .flags.enable_internal_pullup = true,
+         };
+         esp_err_t ret = i2c_new_master_bus(&bus_config, &i2c_bus);
+         if (ret != ESP_OK) {
+             ESP_LOGE(TAG, "I2C initialization failed: %s", esp_err_to_name(ret));
+             return ret;
+         }
      }
      
      // Check chip ID DYNAMICALLY - try both common I2C addresses
-     uint8_t chip_id = 0;
-     uint8_t addresses[] = {0x77, 0x76};  // Try both common addresses
-     bool sensor_found = false;
+     const uint8_t addresses[] = {0x77, 0x76};
+     esp_err_t ret = ESP_ERR_NOT_FOUND;
      
-     for (int i = 0; i < 2; i++) {
+     for (int i = 0; i < 2 && i2c_dev == NULL; i++) {
          ESP_LOGI(TAG, "Trying BME280 at address 0x%02x", addresses[i]);
+         if (i2c_master_probe(i2c_bus, addresses[i], I2C_TIMEOUT_MS) != ESP_OK) {
+             continue;
+         }
          
-         // Update the address for this attempt
-         BME280_I2C_ADDR = addresses[i];
-         
-         // Try to read chip ID
-         ret = bme280_read_reg(BME280_REG_CHIP_ID, &chip_id, 1);
-         if (ret == ESP_OK) {
-             ESP_LOGI(TAG, "BME280 chip ID: 0x%02x", chip_id);
-             if (chip_id == BME280_CHIP_ID) {
-                 ESP_LOGI(TAG, "BME280 found at address 0x%02x", addresses[i]);
-                 sensor_found = true;
-                 break;
-             }
+         i2c_device_config_t dev_config = {
+             .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+             .device_address = addresses[i],
+             .scl_speed_hz = BME280_I2C_SPEED_HZ,
+         };
+         ret = i2c_master_bus_add_device(i2c_bus, &dev_config, &i2c_dev);
+         if (ret != ESP_OK) {
+             ESP_LOGE(TAG, "Failed to add I2C device: %s", esp_err_to_name(ret));
+             return ret;
          }
          
-         vTaskDelay(50 / portTICK_PERIOD_MS);  // Delay before trying next address
-         ESP_LOGI(TAG, "BME280 reset completed, reading calibration data");
+         uint8_t chip_id = 0;
+         if (bme280_read_reg(BME280_REG_CHIP_ID, &chip_id, 1) == ESP_OK && chip_id == BME280_CHIP_ID) {
+             ESP_LOGI(TAG, "BME280 found at address 0x%02x", addresses[i]);
+         } else {
+             ESP_LOGW(TAG, "Device at 0x%02x is not a BME280 (chip ID 0x%02x)", addresses[i], chip_id);
+             i2c_master_bus_rm_device(i2c_dev);
+             i2c_dev = NULL;
+         }
      }
      
-     if (!sensor_found) {
+     if (i2c_dev == NULL) {
          ESP_LOGE(TAG, "BME280 sensor not found at any address");
          return ESP_ERR_NOT_FOUND;
      }
@@ -369,32 +303,76 @@ static esp_err_t bme280_read_reg(uint8_t reg_addr, uint8_t *data, size_t len)
      ret = bme280_write_reg(BME280_REG_RESET, 0xB6);
      if (ret != ESP_OK) return ret;
      
-     // Wait for reset to complete
-     vTaskDelay(5 / portTICK_PERIOD_MS);
+     // Wait for reset to complete (start-up time 2 ms)
+     vTaskDelay(pdMS_TO_TICKS(5));
      
      // Read calibration data
      ret = bme280_read_calibration_data();
      if (ret != ESP_OK) return ret;
      
-     /* Configure the sensor*/
-     // Set humidity oversampling to 1x
-     ret = bme280_write_reg(BME280_REG_CTRL_HUM, 0x01);
+     /* Configure the sensor: forced mode, it sleeps between samples */
+     // Humidity oversampling, takes effect with the next ctrl_meas write
+     ret = bme280_write_reg(BME280_REG_CTRL_HUM, oversampling_code(BME280_OVERSAMPLING_H));
      if (ret != ESP_OK) return ret;
      
-     // Set temperature oversampling to 2x, pressure oversampling to 16x, and normal mode
-     ret = bme280_write_reg(BME280_REG_CTRL_MEAS, 0x57); // 0x57 = 0b01010111
+     // IIR filter off: with minutes between samples it would only add lag
+     ret = bme280_write_reg(BME280_REG_CONFIG, 0x00);
      if (ret != ESP_OK) return ret;
      
-     // Set standby time to 1000ms and IIR filter to 16
-     ret = bme280_write_reg(BME280_REG_CONFIG, 0x50); // 0x50 = 0b01010000
-     if (ret != ESP_OK) return ret;
+     ctrl_meas = (uint8_t)(oversampling_code(BME280_OVERSAMPLING_T) << 5 | oversampling_code(BME280_OVERSAMPLING_P) << 2 |
+                           BME280_MODE_FORCED);
+     measurement_us = bme280_measurement_time_us(BME280_OVERSAMPLING_T, BME280_OVERSAMPLING_P, BME280_OVERSAMPLING_H);
      
      bme280_initialized = true;
-     ESP_LOGI(TAG, "BME280 initialized successfully");
+     ESP_LOGI(TAG, "BME280 initialized successfully, measurement time %ld us", (long)measurement_us);
      
      return ESP_OK;
  }
  
+ // Starts a forced measurement, returns the µs until it can be read, -1 on error
+ static int32_t bme280_start_measurement(void)
+ {
+     if (bme280_write_reg(BME280_REG_CTRL_MEAS, ctrl_meas) != ESP_OK) {
+         return -1;
+     }
+     return measurement_us;
+ }
+ 
+ // Reads status and data in one burst: 0 and the reading when done, > 0 µs to try again, -1 on error
+ static int32_t bme280_fetch_measurement(bme280_reading_t *reading)
+ {
+     uint8_t data[BME280_BURST_LEN];
+     if (bme280_read_reg(BME280_REG_STATUS, data, sizeof(data)) != ESP_OK) {
+         ESP_LOGE(TAG, "Failed to read raw sensor data");
+         return -1;
+     }
+     if (data[0] & BME280_STATUS_MEASURING) {
+         return 1000;
+     }
+     
+     // Convert pressure, temperature, and humidity ADC values (0xF7..0xFE)
+     const uint8_t *adc = data + (BME280_REG_PRESS_MSB - BME280_REG_STATUS);
+     int32_t adc_P = ((uint32_t)adc[0] << 12) | ((uint32_t)adc[1] << 4) | ((uint32_t)adc[2] >> 4);
+     int32_t adc_T = ((uint32_t)adc[3] << 12) | ((uint32_t)adc[4] << 4) | ((uint32_t)adc[5] >> 4);
+     int32_t adc_H = ((uint32_t)adc[6] << 8) | (uint32_t)adc[7];
+     
+     ESP_LOGD(TAG, "Raw ADC readings - Temperature: %ld, Pressure: %ld, Humidity: %ld", 
+              (long)adc_T, (long)adc_P, (long)adc_H);
+     
+     // Calculate compensated values, in fixed point; floats only for the callers that want them
+     reading->temperature_centi = bme280_compensate_temperature(adc_T);
+     reading->pressure_q8 = bme280_compensate_pressure(adc_P);
+     reading->humidity_q10 = bme280_compensate_humidity(adc_H);
+     reading->temperature = reading->temperature_centi / 100.0f;
+     reading->pressure = reading->pressure_q8 / 25600.0f;
+     reading->humidity = reading->humidity_q10 / 1024.0f;
+     
+     ESP_LOGI(TAG, "BME280 reading: %.2f °C, %.2f %%, %.2f hPa", 
+              reading->temperature, reading->humidity, reading->pressure);
+     
+     return 0;
+ }
+ 
  esp_err_t bme280_read_data(bme280_reading_t *reading)
  {
      if (!bme280_initialized) {
@@ -407,73 +385,343 @@ static esp_err_t bme280_read_reg(uint8_t reg_addr, uint8_t *data, size_t len)
          return ESP_ERR_INVALID_ARG;
      }
      
-     uint8_t data[8];
-     esp_err_t ret = bme280_read_reg(BME280_REG_PRESS_MSB, data, 8);
-     if (ret != ESP_OK) {
-         ESP_LOGE(TAG, "Failed to read raw sensor data");
-         return ret;
+     // Blocking one-shot measurement, the periodic sampling uses the sampler instead
+     int32_t wait_us = bme280_start_measurement();
+     for (int tries = 0; wait_us > 0 && tries < 4; tries++) {
+         vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000) + 1);
+         wait_us = bme280_fetch_measurement(reading);
+     }
+     return wait_us == 0 ? ESP_OK : ESP_FAIL;
+ }
+ 
+ #if SENSOR_AGGREGATE_ENABLED
+ static sensor_aggregate_t sensor_agg;
+ static bool sensor_agg_ready = false;
+ 
+ static const char *const report_reasons[] = { "none", "first", "change", "heartbeat" };
+ 
+ // Adds a reading to the window, true (and the window summary) when it is to be published
+ static bool sensor_report_due(const bme280_reading_t *reading, sensor_report_t *report)
+ {
+     if (!sensor_agg_ready) {
+         const float deadband[3] = { SENSOR_DEADBAND_TEMPERATURE, SENSOR_DEADBAND_HUMIDITY, SENSOR_DEADBAND_PRESSURE };
+         sensor_aggregate_init(&sensor_agg, 3, deadband, SENSOR_HEARTBEAT_MS);
+         sensor_agg_ready = true;
+     }
+     const float values[3] = { reading->temperature, reading->humidity, reading->pressure };
+     if (sensor_aggregate_add(&sensor_agg, esp_timer_get_time() / 1000, values, report) == SENSOR_REPORT_NONE) {
+         ESP_LOGD(TAG, "Within deadband, %lu readings in the window", (unsigned long)sensor_agg.samples);
+         return false;
+     }
+     ESP_LOGI(TAG, "Report (%s) after %lu readings. Since boot: %lu reports for %lu readings",
+              report_reasons[report->reason], (unsigned long)report->samples, (unsigned long)sensor_agg.reports,
+              (unsigned long)sensor_agg.total_samples);
+     return true;
+ }
+ #endif // SENSOR_AGGREGATE_ENABLED
+ 
+ #if !TELEMETRY_BATCH_ENABLED || TELEMETRY_FIELD_TOPICS
+ // One text message per field, QoS 0: after the first one on a connection only the topic alias is sent
+ static void bme280_publish_fields(const bme280_reading_t *reading)
+ {
+     const float values[3] = { reading->temperature, reading->humidity, reading->pressure };
+     char mqtt_data[16];
+     for (int i = 0; i < 3; i++) {
+         int len = snprintf(mqtt_data, sizeof(mqtt_data), "%.2f", values[i]);
+         mqtt_publish_topic(bme280_mqtt_client, topic_field[i], mqtt_data, len, 0, 0);
+     }
+ }
+ #endif
+ 
+ #if TELEMETRY_BATCH_ENABLED
+ // Kept across task restarts: samples taken while MQTT was down are sent with the next batch
+ static telemetry_sample_t telemetry_ring[TELEMETRY_RING_LEN];
+ static telemetry_batch_t telemetry;
+ static bool telemetry_ready = false;
+ 
+ // Totals since boot, and what the JSON + per-field text messages would have cost for the same samples
+ static struct {
+     uint32_t samples;
+     uint32_t publishes;
+     uint32_t legacy_publishes;
+     uint32_t legacy_wire_bytes;
+ } telemetry_stats;
+ 
+ static void telemetry_count_legacy(const bme280_reading_t *reading)
+ {
+     char text[96];
+     static const char *const fields[] = { "/temperature", "/humidity", "/pressure" };
+     const float values[] = { reading->temperature, reading->humidity, reading->pressure };
+     
+     int len = snprintf(text, sizeof(text), "{\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f}",
+                        reading->temperature, reading->humidity, reading->pressure);
+     telemetry_stats.legacy_wire_bytes += telemetry_mqtt_wire_len(strlen(MQTT_TOPIC_BME280), len, 0);
+     for (int i = 0; i < 3; i++) {
+         len = snprintf(text, sizeof(text), "%.2f", values[i]);
+         telemetry_stats.legacy_wire_bytes += telemetry_mqtt_wire_len(strlen(MQTT_TOPIC_BME280) + strlen(fields[i]), len, 0);
+     }
+     telemetry_stats.legacy_publishes += 4;
+ }
+ 
+ // Unix time minus uptime once SNTP has set the clock, false before
+ static bool telemetry_clock_offset(int64_t *offset_ms)
+ {
+     struct timeval tv;
+     gettimeofday(&tv, NULL);
+     if (tv.tv_sec <= 1600000000) {
+         *offset_ms = 0;
+         return false;
+     }
+     *offset_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 - esp_timer_get_time() / 1000;
+     return true;
+ }
+ 
+ static void telemetry_add_reading(const bme280_reading_t *reading)
+ {
+     if (!telemetry_ready) {
+         telemetry_batch_init(&telemetry, telemetry_ring, TELEMETRY_RING_LEN, 3);
+         telemetry_ready = true;
+     }
+     // Fixed units: 0.01 °C, 0.01 %RH, Pa, rounded from the compensated fixed-point values
+     telemetry_sample_t sample = {
+         .time_ms = esp_timer_get_time() / 1000,
+         .value = { reading->temperature_centi, (int32_t)((reading->humidity_q10 * 100 + 512) >> 10),
+                    (int32_t)((reading->pressure_q8 + 128) >> 8) },
+     };
+     telemetry_batch_add(&telemetry, &sample);
+ }
+ 
+ // Publishes full batches and the ones whose oldest sample waited for the window (all of them if now),
+ // samples stay queued on failure
+ static void telemetry_flush(esp_mqtt_client_handle_t mqtt_client, bool now)
+ {
+     static uint8_t buf[TELEMETRY_BATCH_MAX_LEN(3, TELEMETRY_BATCH_SAMPLES)];
+     
+     while (telemetry.count > 0 &&
+            (now || telemetry.count >= TELEMETRY_BATCH_SAMPLES ||
+             esp_timer_get_time() / 1000 - telemetry_batch_oldest_ms(&telemetry) >= TELEMETRY_BATCH_WINDOW_MS)) {
+         // Unix timestamps once SNTP has set the clock, uptime before
+         int64_t offset_ms;
+         uint8_t flags = telemetry_clock_offset(&offset_ms) ? TELEMETRY_FLAG_UNIX_TIME : 0;
+         
+         int encoded;
+         size_t len = telemetry_batch_encode(&telemetry, flags, offset_ms, TELEMETRY_BATCH_SAMPLES, buf, sizeof(buf), &encoded);
+         if (len == 0) {
+             return;
+         }
+         if (mqtt_publish_topic(mqtt_client, topic_batch, buf, len, TELEMETRY_BATCH_QOS, 0) < 0) {
+             ESP_LOGW(TAG, "Batch publish failed, %d samples kept", telemetry.count);
+             return;
+         }
+         telemetry_batch_consume(&telemetry, encoded);
+         telemetry_stats.publishes++;
+         
+         mqtt_topic_stats_t wire = { 0 };
+         mqtt_topic_get_stats(topic_batch, &wire);
+         ESP_LOGI(TAG, "Published %d samples in %u bytes (dropped %lu). Since boot: %lu samples, %lu publishes / %lu bytes, "
+                  "JSON + per-field topics: %lu publishes / %lu bytes",
+                  encoded, (unsigned)len, (unsigned long)telemetry.dropped, (unsigned long)telemetry_stats.samples,
+                  (unsigned long)telemetry_stats.publishes, (unsigned long)wire.wire_bytes,
+                  (unsigned long)telemetry_stats.legacy_publishes, (unsigned long)telemetry_stats.legacy_wire_bytes);
+     }
+ }
+ 
+ #if TS_STORE_ENABLED
+ static bool store_ready = false;
+ static bool store_compact_due = true; // at boot, then after every outage
+ 
+ // Without the partition, samples taken while MQTT is down wait in the RAM ring only
+ static void telemetry_store_open(void)
+ {
+     static bool tried = false;
+     if (tried) {
+         return;
+     }
+     tried = true;
+     const ts_store_config_t config = {
+         .partition = TS_STORE_PARTITION,
+         .fields = 3,
+         .resolution_ms = TS_STORE_RESOLUTION_MS,
+         .flush_samples = TS_STORE_FLUSH_SAMPLES,
+     };
+     store_ready = ts_store_open(&config) == ESP_OK;
+     if (!store_ready) {
+         ESP_LOGW(TAG, "No offline store, up to %d samples are kept in RAM while MQTT is down", TELEMETRY_RING_LEN);
+     }
+ }
+ 
+ // MQTT is down: the queued samples move to flash, oldest first
+ static void telemetry_store_queued(void)
+ {
+     int64_t offset_ms;
+     bool unix_time = telemetry_clock_offset(&offset_ms);
+     while (telemetry.count > 0) {
+         const telemetry_sample_t *sample = &telemetry.ring[telemetry.head];
+         if (ts_store_append(sample->time_ms + offset_ms, unix_time, sample->value) != ESP_OK) {
+             ESP_LOGW(TAG, "Offline store failed, %d samples kept in RAM", telemetry.count);
+             return;
+         }
+         telemetry_batch_consume(&telemetry, 1);
+         store_compact_due = true;
+     }
+ }
+ 
+ // Sends a chunk of stored samples as a batch; uptime of this boot becomes Unix time if the clock is set now
+ static esp_err_t telemetry_upload_stored(const telemetry_sample_t *samples, int count, bool unix_time,
+                                          bool this_boot, void *ctx)
+ {
+     static uint8_t buf[TELEMETRY_BATCH_MAX_LEN(3, TS_STORE_UPLOAD_SAMPLES)];
+     
+     int64_t offset_ms = 0;
+     uint8_t flags = 0;
+     if (unix_time) {
+         flags = TELEMETRY_FLAG_UNIX_TIME;
+     } else if (!this_boot) {
+         flags = TELEMETRY_FLAG_PREVIOUS_BOOT;
+     } else if (telemetry_clock_offset(&offset_ms)) {
+         flags = TELEMETRY_FLAG_UNIX_TIME;
+     }
+     int encoded;
+     size_t len = telemetry_encode_samples(samples, count, 3, flags, offset_ms, buf, sizeof(buf), &encoded);
+     if (len == 0 || encoded < count) {
+         return ESP_ERR_INVALID_SIZE;
+     }
+     if (mqtt_publish_topic(bme280_mqtt_client, topic_batch, buf, len, TELEMETRY_BATCH_QOS, 0) < 0) {
+         return ESP_FAIL;
+     }
+     telemetry_stats.publishes++;
+     return ESP_OK;
+ }
+ 
+ // MQTT is back: what was stored meanwhile is sent a few blocks per reading, before the new samples
+ static void telemetry_backfill(void)
+ {
+     if (!store_ready) {
+         return;
+     }
+     if (store_compact_due) {
+         ts_store_seal();
+         int64_t offset_ms;
+         bool unix_time = telemetry_clock_offset(&offset_ms);
+         ts_store_compact(esp_timer_get_time() / 1000 + offset_ms, unix_time, TS_STORE_RETENTION_S * 1000LL);
+         store_compact_due = false;
+     }
+     if (!ts_store_pending()) {
+         return;
      }
      
-     // Convert pressure, temperature, and humidity ADC values
-     int32_t adc_P = ((uint32_t)data[0] << 12) | ((uint32_t)data[1] << 4) | ((uint32_t)data[2] >> 4);
-     int32_t adc_T = ((uint32_t)data[3] << 12) | ((uint32_t)data[4] << 4) | ((uint32_t)data[5] >> 4);
-     int32_t adc_H = ((uint32_t)data[6] << 8) | (uint32_t)data[7];
+     esp_err_t ret = ts_store_backfill(TS_STORE_BACKFILL_BLOCKS, telemetry_upload_stored, NULL);
+     ts_store_stats_t stats;
+     ts_store_get_stats(&stats);
+     if (ret == ESP_OK || ret == ESP_ERR_NOT_FINISHED) {
+         ESP_LOGI(TAG, "Backfill: %lu stored samples sent, %lu blocks left (dropped %lu, expired %lu)",
+                  (unsigned long)stats.uploaded, (unsigned long)stats.pending_blocks, (unsigned long)stats.dropped,
+                  (unsigned long)stats.expired);
+     } else {
+         ESP_LOGW(TAG, "Backfill stopped: %s, %lu blocks left", esp_err_to_name(ret), (unsigned long)stats.pending_blocks);
+     }
+ }
+ #endif // TS_STORE_ENABLED
+ 
+ // Publishes a reading: queued for the next batch, only changes and heartbeats with SENSOR_AGGREGATE_ENABLED
+ static void bme280_publish_reading(const bme280_reading_t *reading)
+ {
+     telemetry_stats.samples++;
+     telemetry_count_legacy(reading);
+     
+     bool publish = true;
+     bool urgent = false;
+ #if SENSOR_AGGREGATE_ENABLED
+     // Readings that left the deadband are sent right away, heartbeats are batched
+     sensor_report_t report;
+     publish = sensor_report_due(reading, &report);
+     urgent = publish && report.reason == SENSOR_REPORT_CHANGE;
+ #endif
+     // Queued even while MQTT is down, sent with the next batch
+     if (publish) {
+         telemetry_add_reading(reading);
+     }
      
-     ESP_LOGD(TAG, "Raw ADC readings - Temperature: %ld, Pressure: %ld, Humidity: %ld", 
-              adc_T, adc_P, adc_H);
+     if (!mqtt_is_connected()) {
+ #if TS_STORE_ENABLED
+         if (store_ready) {
+             telemetry_store_queued();
+             ESP_LOGW(TAG, "MQTT not connected, samples stored on flash");
+             return;
+         }
+ #endif
+         ESP_LOGW(TAG, "MQTT not connected, %d samples queued", telemetry.count);
+         return;
+     }
+ #if TELEMETRY_FIELD_TOPICS
+     if (publish) {
+         // Per-field text topics for dashboards that can't decode the batch
+         bme280_publish_fields(reading);
+     }
+ #endif
+ #if TS_STORE_ENABLED
+     telemetry_backfill();
+ #endif
+     telemetry_flush(bme280_mqtt_client, urgent);
+ }
+ #else
+ static void bme280_publish_reading(const bme280_reading_t *reading)
+ {
+     char mqtt_data[320]; // Larger buffer for JSON data (with the window summary)
      
-     // Calculate compensated values
-     reading->temperature = bme280_compensate_temperature(adc_T);
-     reading->pressure = bme280_compensate_pressure(adc_P);
-     reading->humidity = bme280_compensate_humidity(adc_H);
+ #if SENSOR_AGGREGATE_ENABLED
+     sensor_report_t report;
+     if (!sensor_report_due(reading, &report)) {
+         return; // Within the deadbands of the last published reading
+     }
+ #endif
+     // Only if MQTT is connected, try to publish the data
+     if (!mqtt_is_connected()) {
+         ESP_LOGW(TAG, "MQTT not connected, skipping publishing");
+         return;
+     }
      
-     ESP_LOGI(TAG, "BME280 reading: %.2f °C, %.2f %%, %.2f hPa", 
+     // Format and publish all readings in a single JSON message
+ #if SENSOR_AGGREGATE_ENABLED
+     // The readings since the last report, to show what the deadband hid
+     snprintf(mqtt_data, sizeof(mqtt_data),
+              "{\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f,\"reason\":\"%s\",\"samples\":%lu,"
+              "\"min\":{\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f},"
+              "\"max\":{\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f},"
+              "\"mean\":{\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f}}",
+              reading->temperature, reading->humidity, reading->pressure,
+              report_reasons[report.reason], (unsigned long)report.samples,
+              report.field[0].min, report.field[1].min, report.field[2].min,
+              report.field[0].max, report.field[1].max, report.field[2].max,
+              report.field[0].mean, report.field[1].mean, report.field[2].mean);
+ #else
+     snprintf(mqtt_data, sizeof(mqtt_data), 
+              "{\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f}",
               reading->temperature, reading->humidity, reading->pressure);
+ #endif
      
-     return ESP_OK;
+     ESP_LOGI(TAG, "Publishing to topic %s: %s", MQTT_TOPIC_BME280, mqtt_data);
+     mqtt_publish_topic(bme280_mqtt_client, topic_json, mqtt_data, strlen(mqtt_data), 0, 0);
+     
+     // publish individual readings to separate topics as well for easier parsing
+     bme280_publish_fields(reading);
+ }
+ #endif // TELEMETRY_BATCH_ENABLED
+ 
+ // Sampler steps: trigger a forced measurement, read it when the measurement time has passed
+ static int32_t bme280_sampler_start(void *ctx)
+ {
+     return bme280_start_measurement();
  }
  
- static void bme280_periodic_reading_task(void *pvParameters)
+ static int32_t bme280_sampler_read(void *ctx)
  {
-     esp_mqtt_client_handle_t mqtt_client = (esp_mqtt_client_handle_t)pvParameters;
      bme280_reading_t reading;
-     char mqtt_data[128]; // Larger buffer for JSON data
-     
-     while (1) {
-         // Read BME280 data
-         if (bme280_read_data(&reading) == ESP_OK) {
-             // Only if MQTT is connected, try to publish the data
-             if (mqtt_is_connected()) {
-                 // Format and publish all readings in a single JSON message
-                 snprintf(mqtt_data, sizeof(mqtt_data), 
-                          "{\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f}",
-                          reading.temperature, reading.humidity, reading.pressure);
-                 
-                 ESP_LOGI(TAG, "Publishing to topic %s: %s", MQTT_TOPIC_BME280, mqtt_data);
-                 mqtt_publish_message(mqtt_client, MQTT_TOPIC_BME280, mqtt_data, 0, 0);
-                 
-                 // publish individual readings to separate topics as well for easier parsing
-                 snprintf(mqtt_data, sizeof(mqtt_data), "%.2f", reading.temperature);
-                 ESP_LOGI(TAG, "Publishing to topic %s/temperature: %s", MQTT_TOPIC_BME280, mqtt_data);
-                 mqtt_publish_message(mqtt_client, MQTT_TOPIC_BME280 "/temperature", mqtt_data, 0, 0);
-                 
-                 snprintf(mqtt_data, sizeof(mqtt_data), "%.2f", reading.humidity);
-                 ESP_LOGI(TAG, "Publishing to topic %s/humidity: %s", MQTT_TOPIC_BME280, mqtt_data);
-                 mqtt_publish_message(mqtt_client, MQTT_TOPIC_BME280 "/humidity", mqtt_data, 0, 0);
-                 
-                 snprintf(mqtt_data, sizeof(mqtt_data), "%.2f", reading.pressure);
-                 ESP_LOGI(TAG, "Publishing to topic %s/pressure: %s", MQTT_TOPIC_BME280, mqtt_data);
-                 mqtt_publish_message(mqtt_client, MQTT_TOPIC_BME280 "/pressure", mqtt_data, 0, 0);
-             } else {
-                 ESP_LOGW(TAG, "MQTT not connected, skipping publishing");
-             }
-         } else {
-             ESP_LOGE(TAG, "Failed to read BME280 data");
-         }
-         
-         // Wait for the next sampling interval
-         vTaskDelay(BME280_SAMPLING_INTERVAL_MS / portTICK_PERIOD_MS);
+     int32_t ret = bme280_fetch_measurement(&reading);
+     if (ret == 0) {
+         bme280_publish_reading(&reading);
      }
+     return ret;
  }
  
  esp_err_t bme280_start_periodic_reading(void *mqtt_client)
@@ -488,41 +736,44 @@ static esp_err_t bme280_read_reg(uint8_t reg_addr, uint8_t *data, size_t len)
          return ESP_ERR_INVALID_ARG;
      }
      
-     if (bme280_task_handle != NULL) {
-         ESP_LOGW(TAG, "Periodic reading task already running");
+     bme280_mqtt_client = (esp_mqtt_client_handle_t)mqtt_client;
+     topic_json = mqtt_topic_register(MQTT_TOPIC_BME280);
+     topic_batch = mqtt_topic_register(MQTT_TOPIC_BME280 "/batch");
+     topic_field[0] = mqtt_topic_register(MQTT_TOPIC_BME280 "/temperature");
+     topic_field[1] = mqtt_topic_register(MQTT_TOPIC_BME280 "/humidity");
+     topic_field[2] = mqtt_topic_register(MQTT_TOPIC_BME280 "/pressure");
+ #if TELEMETRY_BATCH_ENABLED && TS_STORE_ENABLED
+     // Before the first sample: blocks left by the previous boot are sent once MQTT is up
+     telemetry_store_open();
+ #endif
+     
+     const sampler_sensor_t sensor = {
+         .name = "bme280",
+         .period_ms = BME280_SAMPLING_INTERVAL_MS,
+         .start = bme280_sampler_start,
+         .read = bme280_sampler_read,
+     };
+     esp_err_t ret = sampler_add(&sensor);
+     if (ret == ESP_ERR_INVALID_STATE) {
+         ESP_LOGW(TAG, "Periodic reading already running");
          return ESP_OK;
      }
-     
-     // Create the periodic reading task
-     BaseType_t xReturned = xTaskCreate(
-         bme280_periodic_reading_task,
-         "bme280_task",
-         4096,
-         mqtt_client,  // Pass the MQTT client as a parameter
-         5,
-         &bme280_task_handle
-     );
-     
-     if (xReturned != pdPASS) {
-         ESP_LOGE(TAG, "Failed to create BME280 task");
-         return ESP_FAIL;
+     if (ret != ESP_OK) {
+         ESP_LOGE(TAG, "Failed to start periodic reading: %s", esp_err_to_name(ret));
+         return ret;
      }
      
-     ESP_LOGI(TAG, "BME280 periodic reading task started");
+     ESP_LOGI(TAG, "BME280 periodic reading started");
      return ESP_OK;
  }
  
  esp_err_t bme280_stop_periodic_reading(void)
  {
-     if (bme280_task_handle == NULL) {
-         ESP_LOGW(TAG, "Periodic reading task not running");
+     if (sampler_remove("bme280") != ESP_OK) {
+         ESP_LOGW(TAG, "Periodic reading not running");
          return ESP_OK;
      }
      
-	 // Delete the task at the end of execution
-     vTaskDelete(bme280_task_handle);
-     bme280_task_handle = NULL;
-     
-     ESP_LOGI(TAG, "BME280 periodic reading task stopped");
+     ESP_LOGI(TAG, "BME280 periodic reading stopped");
      return ESP_OK;
- }
\ No newline at end of file
+ }
@@ -9,6 +9,7 @@
 #ifndef BME280_H
 #define BME280_H
 
+#include <stdint.h>
 #include "esp_err.h"
 
 /**
@@ -18,6 +19,9 @@ typedef struct {
     float temperature;  // Temperature in Celsius
     float humidity;     // Relative humidity in percentage
     float pressure;     // Pressure in hPa (hectopascals)
+    int32_t temperature_centi; // Same values in the sensor's fixed point: 0.01 °C
+    uint32_t humidity_q10;     // 1/1024 %RH
+    uint32_t pressure_q8;      // 1/256 Pa
 } bme280_reading_t;
 
 /**
@@ -28,7 +32,7 @@ typedef struct {
 esp_err_t bme280_init(void);
 
 /**
- * @brief Read sensor data from BME280
+ * @brief Read sensor data from BME280 (one forced measurement, blocks for its measurement time)
  * 
  * @param reading Pointer to a bme280_reading_t structure to store the readings
  * @return ESP_OK on success, appropriate error code otherwise
@@ -36,7 +40,7 @@ esp_err_t bme280_init(void);
 esp_err_t bme280_read_data(bme280_reading_t *reading);
 
 /**
- * @brief Start a task to periodically read BME280 sensor data and publish via MQTT
+ * @brief Start periodic reading of BME280 sensor data (on the sampler) and publishing via MQTT
  * 
  * @param mqtt_client The MQTT client handle to use for publishing
  * @return ESP_OK on success, appropriate error code otherwise
@@ -44,7 +48,7 @@ esp_err_t bme280_read_data(bme280_reading_t *reading);
 esp_err_t bme280_start_periodic_reading(void *mqtt_client);
 
 /**
- * @brief Stop the periodic reading task
+ * @brief Stop the periodic reading
  * 
  * @return ESP_OK on success, appropriate error code otherwise
  */
@@ -16,6 +16,11 @@
 #define MQTT_ENABLED 1
 #define BME280_ENABLED 1
 
+// MQTT 5 (needs CONFIG_MQTT_PROTOCOL_5=y, see sdkconfig.defaults): registered topics are sent as a 2-byte
+// topic alias after their first publish on a connection
+#define MQTT_V5_ENABLED 1
+#define MQTT_TOPIC_ALIAS_MAX 8 // aliases used for our topics (AWS IoT allows 8) and accepted from the broker
+
 // WiFi configuration
 #define WIFI_MAXIMUM_RETRY 5
 
@@ -24,5 +29,40 @@
 #define BME280_SDA_PIN 18     // Default SDA GPIO pin is 21
 #define BME280_SCL_PIN 17     // Default SCL GPIO pin is 22
 #define BME280_SAMPLING_INTERVAL_MS 120000  // 2 minutes - same as your publishing interval
+#define BME280_I2C_SPEED_HZ 400000
+// Oversampling per measurement: 0 (skipped), 1, 2, 4, 8 or 16. Sets the measurement time (46 ms for 2/16/1)
+#define BME280_OVERSAMPLING_T 2
+#define BME280_OVERSAMPLING_P 16
+#define BME280_OVERSAMPLING_H 1
+
+// Sampler: timer-driven deadlines for the sensors, one task runs their measurement steps
+#define SAMPLER_TASK_STACK 4096
+#define SAMPLER_TASK_PRIORITY 5
+
+// Telemetry batching: samples kept in a ring, published as one binary message (MQTT_TOPIC_BME280 "/batch")
+// instead of a JSON message and three per-field messages per sample
+#define TELEMETRY_BATCH_ENABLED 1
+#define TELEMETRY_BATCH_SAMPLES 15       // publish when this many samples wait (15 x 2 min = 30 min)
+#define TELEMETRY_BATCH_WINDOW_MS 1800000 // or when the oldest sample is this old
+#define TELEMETRY_RING_LEN 64            // samples kept while MQTT is down, the oldest is overwritten
+#define TELEMETRY_BATCH_QOS 1            // a lost batch is many samples
+#define TELEMETRY_FIELD_TOPICS 0         // also publish every sample as text on the per-field topics
+
+// Report-by-exception: a reading is published only when a field left its deadband around the last
+// published value (right away) or as a heartbeat when nothing was published for SENSOR_HEARTBEAT_MS
+#define SENSOR_AGGREGATE_ENABLED 1
+#define SENSOR_DEADBAND_TEMPERATURE 0.2f // °C
+#define SENSOR_DEADBAND_HUMIDITY 1.0f    // %RH
+#define SENSOR_DEADBAND_PRESSURE 0.5f    // hPa
+#define SENSOR_HEARTBEAT_MS 1800000      // 30 minutes
+
+// Offline store: while MQTT is down the samples go to the "tsdb" flash partition (partitions.csv) instead
+// of the RAM ring, Gorilla-compressed, and are sent as batches once it is back. Needs TELEMETRY_BATCH_ENABLED
+#define TS_STORE_ENABLED 1
+#define TS_STORE_PARTITION "tsdb"
+#define TS_STORE_RESOLUTION_MS 1000            // timestamps are rounded to this
+#define TS_STORE_FLUSH_SAMPLES 1               // samples kept in RAM before a flash write (lost on a reset)
+#define TS_STORE_RETENTION_S (30 * 24 * 3600)  // older samples are erased, sent or not
+#define TS_STORE_BACKFILL_BLOCKS 2             // stored blocks sent per reading once MQTT is back
 
 #endif // CONFIG_H
\ No newline at end of file
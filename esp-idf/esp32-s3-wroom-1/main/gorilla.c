@@ -0,0 +1,223 @@
+/**
+ * @file gorilla.c
+ * @brief Delta-of-delta and XOR bit packing
+ */
+
+#include <string.h>
+#include "gorilla.h"
+
+// Bits a reused window may waste before a tighter one is described: describing costs 10 bits once, a wide
+// window costs its extra bits on every following sample (3 gave the smallest BME280-like series)
+#define WINDOW_SLACK 3
+
+static void put_bits(gorilla_encoder_t *enc, uint64_t value, int n) {
+    while (n > 0) {
+        int used = enc->bits & 7;
+        int take = 8 - used < n ? 8 - used : n;
+        uint8_t chunk = (uint8_t)((value >> (n - take)) & ((1u << take) - 1));
+        if (used == 0) {
+            enc->buf[enc->bits >> 3] = 0;
+        }
+        enc->buf[enc->bits >> 3] |= (uint8_t)(chunk << (8 - used - take));
+        enc->bits += take;
+        n -= take;
+    }
+}
+
+// false if fewer than n bits are left
+static bool get_bits(gorilla_decoder_t *dec, int n, uint64_t *value) {
+    if (dec->pos + n > dec->bits) {
+        return false;
+    }
+    *value = 0;
+    while (n > 0) {
+        int used = dec->pos & 7;
+        int take = 8 - used < n ? 8 - used : n;
+        uint8_t byte = dec->buf[dec->pos >> 3];
+        *value = (*value << take) | ((byte >> (8 - used - take)) & ((1u << take) - 1));
+        dec->pos += take;
+        n -= take;
+    }
+    return true;
+}
+
+static int64_t sign_extend(uint64_t v, int bits) {
+    uint64_t sign = 1ull << (bits - 1);
+    return (int64_t)((v ^ sign) - sign);
+}
+
+static int clz32(uint32_t x) {
+    return __builtin_clz(x);
+}
+
+static int ctz32(uint32_t x) {
+    return __builtin_ctz(x);
+}
+
+void gorilla_encoder_init(gorilla_encoder_t *enc, uint8_t *buf, size_t size, int fields, int64_t base) {
+    memset(enc, 0, sizeof(*enc));
+    enc->buf = buf;
+    enc->size = size;
+    enc->fields = fields > GORILLA_MAX_FIELDS ? GORILLA_MAX_FIELDS : fields;
+    enc->prev_time = base;
+}
+
+gorilla_status_t gorilla_append(gorilla_encoder_t *enc, int64_t time, const int32_t *values) {
+    if (enc->bits + GORILLA_MAX_SAMPLE_BITS(enc->fields) > enc->size * 8) {
+        return GORILLA_FULL;
+    }
+    int64_t delta = time - enc->prev_time;
+    int64_t dod = delta - enc->prev_delta;
+    if (dod < INT32_MIN || dod > INT32_MAX) {
+        return GORILLA_RANGE;
+    }
+
+    if (dod == 0) {
+        put_bits(enc, 0, 1);
+    } else if (dod >= -64 && dod <= 63) {
+        put_bits(enc, 0x2, 2);
+        put_bits(enc, (uint64_t)dod, 7);
+    } else if (dod >= -256 && dod <= 255) {
+        put_bits(enc, 0x6, 3);
+        put_bits(enc, (uint64_t)dod, 9);
+    } else if (dod >= -2048 && dod <= 2047) {
+        put_bits(enc, 0xE, 4);
+        put_bits(enc, (uint64_t)dod, 12);
+    } else {
+        put_bits(enc, 0xF, 4);
+        put_bits(enc, (uint64_t)dod, 32);
+    }
+    enc->prev_time = time;
+    enc->prev_delta = delta;
+
+    for (int f = 0; f < enc->fields; f++) {
+        uint32_t v = (uint32_t)values[f];
+        if (enc->count == 0) {
+            put_bits(enc, v, 32);
+            enc->prev_value[f] = v;
+            continue;
+        }
+        uint32_t x = v ^ enc->prev_value[f];
+        enc->prev_value[f] = v;
+        if (x == 0) {
+            put_bits(enc, 0, 1);
+            continue;
+        }
+        int leading = clz32(x);
+        int trailing = ctz32(x);
+        int window = 32 - enc->leading[f] - enc->trailing[f];
+        // Reuse the previous window if the bits fit and it is not much wider than they need
+        // (a window never shrinks otherwise: one large change would widen all the later ones)
+        if (enc->leading[f] + enc->trailing[f] > 0 && leading >= enc->leading[f] && trailing >= enc->trailing[f] &&
+            window <= 32 - leading - trailing + WINDOW_SLACK) {
+            put_bits(enc, 0x2, 2);
+            put_bits(enc, x >> enc->trailing[f], window);
+        } else {
+            int length = 32 - leading - trailing;
+            put_bits(enc, 0x3, 2);
+            put_bits(enc, (uint64_t)leading, 5);
+            put_bits(enc, (uint64_t)(length - 1), 5);
+            put_bits(enc, x >> trailing, length);
+            enc->leading[f] = (uint8_t)leading;
+            enc->trailing[f] = (uint8_t)trailing;
+        }
+    }
+    enc->count++;
+    return GORILLA_OK;
+}
+
+size_t gorilla_flush(gorilla_encoder_t *enc) {
+    size_t len = (enc->bits + 7) / 8;
+    enc->bits = 0;
+    return len;
+}
+
+void gorilla_decoder_init(gorilla_decoder_t *dec, int fields, int64_t base) {
+    memset(dec, 0, sizeof(*dec));
+    dec->fields = fields > GORILLA_MAX_FIELDS ? GORILLA_MAX_FIELDS : fields;
+    dec->prev_time = base;
+}
+
+void gorilla_decoder_input(gorilla_decoder_t *dec, const uint8_t *buf, size_t len) {
+    dec->buf = buf;
+    dec->bits = len * 8;
+    dec->pos = 0;
+}
+
+bool gorilla_decode(gorilla_decoder_t *dec, int64_t *time, int32_t *values) {
+    uint64_t bit;
+    int64_t dod = 0;
+    int prefix = 0;
+    // Up to four 1 bits select the width of the delta of delta
+    while (prefix < 4) {
+        if (!get_bits(dec, 1, &bit)) {
+            return false;
+        }
+        if (bit == 0) {
+            break;
+        }
+        prefix++;
+    }
+    if (prefix > 0) {
+        static const int widths[] = { 0, 7, 9, 12, 32 };
+        uint64_t v;
+        if (!get_bits(dec, widths[prefix], &v)) {
+            return false;
+        }
+        dod = sign_extend(v, widths[prefix]);
+    }
+    int64_t delta = dec->prev_delta + dod;
+    int64_t t = dec->prev_time + delta;
+
+    uint32_t decoded[GORILLA_MAX_FIELDS];
+    uint8_t leading[GORILLA_MAX_FIELDS];
+    uint8_t trailing[GORILLA_MAX_FIELDS];
+    memcpy(leading, dec->leading, sizeof(leading));
+    memcpy(trailing, dec->trailing, sizeof(trailing));
+    for (int f = 0; f < dec->fields; f++) {
+        uint64_t v;
+        if (dec->count == 0) {
+            if (!get_bits(dec, 32, &v)) {
+                return false;
+            }
+            decoded[f] = (uint32_t)v;
+            continue;
+        }
+        if (!get_bits(dec, 1, &bit)) {
+            return false;
+        }
+        if (bit == 0) {
+            decoded[f] = dec->prev_value[f];
+            continue;
+        }
+        if (!get_bits(dec, 1, &bit)) {
+            return false;
+        }
+        if (bit == 1) {
+            uint64_t lead, len;
+            if (!get_bits(dec, 5, &lead) || !get_bits(dec, 5, &len)) {
+                return false;
+            }
+            leading[f] = (uint8_t)lead;
+            trailing[f] = (uint8_t)(32 - lead - (len + 1));
+        }
+        int length = 32 - leading[f] - trailing[f];
+        if (length <= 0 || !get_bits(dec, length, &v)) {
+            return false;
+        }
+        decoded[f] = dec->prev_value[f] ^ ((uint32_t)v << trailing[f]);
+    }
+
+    // Commit only complete samples
+    dec->prev_time = t;
+    dec->prev_delta = delta;
+    memcpy(dec->leading, leading, sizeof(leading));
+    memcpy(dec->trailing, trailing, sizeof(trailing));
+    for (int f = 0; f < dec->fields; f++) {
+        dec->prev_value[f] = decoded[f];
+        values[f] = (int32_t)decoded[f];
+    }
+    dec->count++;
+    *time = t;
+    return true;
+}
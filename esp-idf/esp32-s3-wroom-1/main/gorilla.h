@@ -0,0 +1,101 @@
+/**
+ * @file gorilla.h
+ * @brief Gorilla-style bit packing of time series: delta-of-delta timestamps, XOR values
+ *
+ * Timestamps are integer ticks. Per sample the change of the time step is
+ * written with a variable-length prefix:
+ *   0                 same step as before
+ *   10   + 7 bits     [-64, 63]
+ *   110  + 9 bits     [-256, 255]
+ *   1110 + 12 bits    [-2048, 2047]
+ *   1111 + 32 bits    anything else that fits 32 bits
+ * Every field is an int32 XORed with its previous value:
+ *   0                 unchanged
+ *   10 + bits         the changed bits fit the leading/trailing zero window of the previous XOR
+ *   11 + 5 bits leading zeros + 5 bits (length - 1) + length bits, a new window
+ * Unlike the original, a new window is also written when the previous one
+ * is more than 3 bits wider than needed, so it shrinks back after a large
+ * change (a carry in a slowly changing integer).
+ * The first sample of a stream has its full 32-bit values, its time is a
+ * step from the base given at init.
+ *
+ * The encoder packs MSB first into a caller buffer that is drained with
+ * gorilla_flush(); the compression state carries over, so a stream can be
+ * written to flash in byte-aligned pieces and decoded piece by piece.
+ *
+ * No ESP-IDF dependencies, builds on the host too.
+ */
+
+#ifndef GORILLA_H
+#define GORILLA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GORILLA_MAX_FIELDS 4
+
+/** @brief Worst case bits of one sample: 1111 + 32, then 11 + 5 + 5 + 32 per field. */
+#define GORILLA_MAX_SAMPLE_BITS(fields) (36 + (fields) * 44)
+
+typedef enum {
+    GORILLA_OK = 0,
+    GORILLA_FULL,  // no room left in the buffer for a worst case sample
+    GORILLA_RANGE, // the time step changed by more than 32 bits
+} gorilla_status_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t bits;     // written to buf since the last flush
+    int fields;
+    uint32_t count;  // samples in the stream
+    int64_t prev_time;
+    int64_t prev_delta;
+    uint32_t prev_value[GORILLA_MAX_FIELDS];
+    uint8_t leading[GORILLA_MAX_FIELDS];  // window of the previous XOR
+    uint8_t trailing[GORILLA_MAX_FIELDS];
+} gorilla_encoder_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t bits;     // in buf
+    size_t pos;
+    int fields;
+    uint32_t count;
+    int64_t prev_time;
+    int64_t prev_delta;
+    uint32_t prev_value[GORILLA_MAX_FIELDS];
+    uint8_t leading[GORILLA_MAX_FIELDS];
+    uint8_t trailing[GORILLA_MAX_FIELDS];
+} gorilla_decoder_t;
+
+/** @brief Starts a stream over the caller's buffer, base is the time the first step is taken from. */
+void gorilla_encoder_init(gorilla_encoder_t *enc, uint8_t *buf, size_t size, int fields, int64_t base);
+
+/**
+ * @brief Appends a sample.
+ *
+ * Nothing is written unless GORILLA_OK: with GORILLA_FULL the buffer has
+ * to be drained first, with GORILLA_RANGE the sample needs a new stream.
+ */
+gorilla_status_t gorilla_append(gorilla_encoder_t *enc, int64_t time, const int32_t *values);
+
+/**
+ * @brief Pads the buffer to a byte and returns its length in bytes.
+ *
+ * The caller copies them out, the next sample is written from buf[0]
+ * and continues the stream.
+ */
+size_t gorilla_flush(gorilla_encoder_t *enc);
+
+/** @brief Starts decoding a stream, same fields and base as the encoder. */
+void gorilla_decoder_init(gorilla_decoder_t *dec, int fields, int64_t base);
+
+/** @brief Next flushed piece of the stream, the state of the previous samples is kept. */
+void gorilla_decoder_input(gorilla_decoder_t *dec, const uint8_t *buf, size_t len);
+
+/** @brief Decodes the next sample of the current piece, false if it is truncated. */
+bool gorilla_decode(gorilla_decoder_t *dec, int64_t *time, int32_t *values);
+
+#endif // GORILLA_H
@@ -33,8 +33,13 @@
              ESP_LOGI(TAG, "BME280 periodic readings started successfully");
          }
      } else if (!connected) {
+ #if TELEMETRY_BATCH_ENABLED
+         // Keep sampling, the readings are queued for the next batch
+         ESP_LOGI(TAG, "MQTT disconnected, BME280 readings are queued");
+ #else
          ESP_LOGI(TAG, "MQTT disconnected, stopping BME280 readings");
          bme280_stop_periodic_reading();
+ #endif
      }
  }
  
@@ -12,6 +12,8 @@
 #include "esp_system.h"
 #include "esp_log.h"
 #include "mqtt_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #include "mqtt.h"
 #include "config.h"
@@ -27,6 +29,13 @@ extern const char _binary_new_private_key_start[]; // asm("_binary_new_private_k
 
 static void (*connection_state_callback)(bool connected, esp_mqtt_client_handle_t client) = NULL;
 
+#if MQTT_V5_ENABLED && !defined(CONFIG_MQTT_PROTOCOL_5)
+#error "MQTT_V5_ENABLED needs CONFIG_MQTT_PROTOCOL_5=y (menuconfig: ESP-MQTT Configurations)"
+#endif
+
+// Publish properties are set with one call and used by the next publish of any task, publishes go one at a time
+static SemaphoreHandle_t publish_lock = NULL;
+
 // function implementation
 void mqtt_register_connection_callback(void (*callback)(bool connected, esp_mqtt_client_handle_t client)) {
     connection_state_callback = callback;
@@ -38,6 +47,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     esp_mqtt_event_handle_t event = event_data;
     esp_mqtt_client_handle_t client = event->client;
     
+    mqtt_topic_handle_event(client, (esp_mqtt_event_id_t)event_id);
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT connected to AWS IoT!");
@@ -63,9 +73,10 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
                      "{\"message\":\"Device connected\",\"client_id\":\"%s\",\"topic\":\"%s\",\"timestamp\":%llu}",
                      client_id, MQTT_TOPIC_BASE, (unsigned long long)(esp_timer_get_time() / 1000));
             
-            // Publish to a dedicated connection status topic
+            // Publish to a dedicated connection status topic. Not through mqtt_publish_message(): the
+            // MQTT task must not wait for publish_lock, a publishing task may wait for the MQTT task
             ESP_LOGI(TAG, "Sending initialization message: %s", init_message);
-            mqtt_publish_message(client, MQTT_TOPIC_BASE "/status/connect", init_message, 1, 0);
+            esp_mqtt_client_publish(client, MQTT_TOPIC_BASE "/status/connect", init_message, 0, 1, 0);
             
             // Call the connection callback if registered
             if (connection_state_callback != NULL) {
@@ -85,7 +96,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             break;
             
         case MQTT_EVENT_PUBLISHED:
-            ESP_LOGI(TAG, "MQTT message published, msg_id=%d", event->msg_id);
+            ESP_LOGD(TAG, "MQTT message published, msg_id=%d", event->msg_id);
             break;
             
         case MQTT_EVENT_DATA:
@@ -128,6 +139,9 @@ esp_mqtt_client_handle_t mqtt_aws_init(void)
             .client_id = AWS_IOT_CLIENT_ID
         },
         .session = {
+#if MQTT_V5_ENABLED
+            .protocol_ver = MQTT_PROTOCOL_V_5,
+#endif
             .last_will = {
                 .topic = MQTT_TOPIC_STATUS,
                 .msg = "offline",
@@ -136,12 +150,22 @@ esp_mqtt_client_handle_t mqtt_aws_init(void)
         }
     };
     
-    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
+    publish_lock = xSemaphoreCreateMutex();
+    mqtt_topic_init(publish_lock, MQTT_V5_ENABLED, MQTT_TOPIC_ALIAS_MAX);
+    esp_mqtt_client_handle_t client = publish_lock ? esp_mqtt_client_init(&mqtt_cfg) : NULL;
     if (client == NULL) {
         ESP_LOGE(TAG, "Failed to initialize MQTT client");
         return NULL;
     }
     
+#if MQTT_V5_ENABLED
+    // Aliases the broker may use for the topics it sends us, ours are limited by its CONNACK
+    esp_mqtt5_connection_property_config_t connect_property = {
+        .topic_alias_maximum = MQTT_TOPIC_ALIAS_MAX,
+    };
+    esp_mqtt5_client_set_connect_property(client, &connect_property);
+#endif
+    
     esp_err_t err = esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, client);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register MQTT event handler: %s", esp_err_to_name(err));
@@ -175,20 +199,37 @@ int mqtt_publish_message(esp_mqtt_client_handle_t client, const char *topic, con
         return -1;
     }
     
-    ESP_LOGI(TAG, "Publishing to topic: %s", topic);
-    ESP_LOGI(TAG, "Message data: %s", data);
-    ESP_LOGI(TAG, "QoS: %d, Retain: %d", qos, retain);
-    
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
     int msg_id = esp_mqtt_client_publish(client, topic, data, 0, qos, retain);
+    xSemaphoreGive(publish_lock);
     if (msg_id < 0) {
         ESP_LOGE(TAG, "Failed to publish to topic %s", topic);
     } else {
-        ESP_LOGI(TAG, "Published to topic %s, msg_id=%d", topic, msg_id);
+        // One line per publish, at debug level: the payload is logged by the caller if needed
+        ESP_LOGD(TAG, "Published to %s (QoS %d, retain %d, msg_id=%d): %s", topic, qos, retain, msg_id, data);
     }
     
     return msg_id;
 }
 
+int mqtt_publish_binary(esp_mqtt_client_handle_t client, const char *topic, const void *data, int len, int qos, int retain)
+{
+    if (client == NULL || topic == NULL || data == NULL || len <= 0) {
+        ESP_LOGE(TAG, "Invalid arguments for mqtt_publish_binary");
+        return -1;
+    }
+    
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    int msg_id = esp_mqtt_client_publish(client, topic, (const char *)data, len, qos, retain);
+    xSemaphoreGive(publish_lock);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to publish to topic %s", topic);
+    } else {
+        ESP_LOGD(TAG, "Published %d bytes to %s (QoS %d, msg_id=%d)", len, topic, qos, msg_id);
+    }
+    
+    return msg_id;
+}
 
 bool mqtt_is_connected(void)
 {
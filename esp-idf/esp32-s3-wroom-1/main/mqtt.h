@@ -8,8 +8,10 @@
 #ifndef MQTT_H
 #define MQTT_H
 
+#include <stdint.h>
 #include "esp_err.h"
 #include "mqtt_client.h"
+#include "mqtt_topic.h" // mqtt_topic_register(), mqtt_publish_topic()
 
 /**
  * @brief Initialize MQTT client for AWS IoT
@@ -38,6 +40,19 @@ esp_err_t mqtt_start(esp_mqtt_client_handle_t client);
  */
 int mqtt_publish_message(esp_mqtt_client_handle_t client, const char *topic, const char *data, int qos, int retain);
 
+/**
+ * @brief Publish a binary message (not NUL terminated)
+ * 
+ * @param client MQTT client handle
+ * @param topic MQTT topic to publish to
+ * @param data Payload
+ * @param len Payload length in bytes
+ * @param qos Quality of Service (0, 1, or 2)
+ * @param retain Retain flag
+ * @return Message ID of the publish operation, -1 on failure
+ */
+int mqtt_publish_binary(esp_mqtt_client_handle_t client, const char *topic, const void *data, int len, int qos, int retain);
+
 /**
  * @brief Check if MQTT client is connected to broker
  * 
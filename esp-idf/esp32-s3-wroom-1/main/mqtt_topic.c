@@ -0,0 +1,180 @@
+/**
+ * @file mqtt_topic.c
+ * @brief Registry of the MQTT topics published often, sent with MQTT 5 topic aliases
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt_topic.h"
+
+static const char *TAG = "MQTT_TOPIC";
+
+// Topics registered with mqtt_topic_register(), handle = index
+static struct {
+    const char *name;
+    uint16_t len;
+    uint16_t alias;          // given on the first QoS 0 publish, 0: none (yet)
+    uint32_t announced_conn; // connection on which the broker learned the alias
+    uint32_t refused_conn;   // connection whose broker allows fewer aliases
+    mqtt_topic_stats_t stats;
+} topics[MQTT_MAX_TOPICS];
+static int topic_count = 0;
+static bool use_mqtt5 = false;
+static uint16_t alias_limit = 0;
+static uint16_t next_alias = 1;
+static bool connected = false;
+
+// Topic aliases only hold for one network connection: counted up before every connection attempt
+static volatile uint32_t connection_id = 1;
+
+// Publish properties are set with one call and used by the next publish of any task, publishes go one at a time
+static SemaphoreHandle_t publish_lock = NULL;
+
+// Size of a PUBLISH packet: fixed header, topic, packet id, properties, payload
+static uint32_t publish_wire_len(size_t topic_len, size_t props_len, size_t payload_len, int qos)
+{
+    size_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + payload_len;
+    if (use_mqtt5) {
+        remaining += 1 + props_len; // property length varint, one byte below 128
+    }
+    size_t len_bytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : remaining < 2097152 ? 3 : 4;
+    return 1 + len_bytes + remaining;
+}
+
+void mqtt_topic_init(SemaphoreHandle_t lock, bool mqtt5, uint16_t alias_max)
+{
+    publish_lock = lock;
+    use_mqtt5 = mqtt5;
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    alias_limit = mqtt5 ? alias_max : 0;
+#else
+    alias_limit = 0;
+#endif
+}
+
+void mqtt_topic_handle_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event_id)
+{
+    switch (event_id) {
+        case MQTT_EVENT_BEFORE_CONNECT:
+            connection_id++; // the aliases of the previous connection are gone
+            break;
+        case MQTT_EVENT_CONNECTED:
+            connected = true;
+#ifdef CONFIG_MQTT_PROTOCOL_5
+            if (alias_limit > 0) {
+                // Drops an alias a task set up for its publish on the previous connection. Not under
+                // publish_lock: the MQTT task must not wait for it, a publishing task may wait for the MQTT task
+                esp_mqtt5_client_set_publish_property(client, &(esp_mqtt5_publish_property_config_t){ 0 });
+            }
+#endif
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            connected = false;
+            connection_id++;
+            break;
+        default:
+            break;
+    }
+}
+
+mqtt_topic_t mqtt_topic_register(const char *topic)
+{
+    if (topic == NULL || topic[0] == '\0' || publish_lock == NULL) {
+        return MQTT_TOPIC_INVALID;
+    }
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    mqtt_topic_t handle = 0;
+    while (handle < topic_count && strcmp(topics[handle].name, topic) != 0) {
+        handle++;
+    }
+    if (handle == topic_count) {
+        if (topic_count == MQTT_MAX_TOPICS) {
+            handle = MQTT_TOPIC_INVALID;
+        } else {
+            topics[handle].name = topic;
+            topics[handle].len = strlen(topic);
+            topic_count++;
+        }
+    }
+    xSemaphoreGive(publish_lock);
+    if (handle == MQTT_TOPIC_INVALID) {
+        ESP_LOGE(TAG, "No topic slot for %s", topic);
+    }
+    return handle;
+}
+
+int mqtt_publish_topic(esp_mqtt_client_handle_t client, mqtt_topic_t topic, const void *data, int len, int qos, int retain)
+{
+    if (client == NULL || topic < 0 || topic >= topic_count || data == NULL || len <= 0) {
+        ESP_LOGE(TAG, "Invalid arguments for mqtt_publish_topic");
+        return -1;
+    }
+
+    int64_t start = esp_timer_get_time();
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    const char *name = topics[topic].name;
+    size_t topic_len = topics[topic].len;
+    size_t props_len = 0;
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    // QoS 0 only: QoS 1/2 messages stay in the outbox and can be resent on a new connection, a bare alias
+    // would be unknown there. A reconnect between reading connection_id and the publish could still send
+    // one: the broker closes the connection as a protocol error and the next one announces the alias again
+    uint32_t conn = connection_id;
+    if (qos == 0 && topics[topic].alias == 0 && next_alias <= alias_limit) {
+        topics[topic].alias = next_alias++;
+    }
+    bool alias = qos == 0 && topics[topic].alias != 0 && topics[topic].refused_conn != conn && connected;
+    if (alias) {
+        esp_mqtt5_publish_property_config_t property = { .topic_alias = topics[topic].alias };
+        if (esp_mqtt5_client_set_publish_property(client, &property) == ESP_OK) {
+            props_len = 3;
+            if (topics[topic].announced_conn == conn) {
+                name = "";
+                topic_len = 0;
+            }
+        } else {
+            // Over the Topic Alias Maximum of the broker's CONNACK (0 if it has none)
+            topics[topic].refused_conn = conn;
+            alias = false;
+        }
+    }
+#endif
+    int msg_id = esp_mqtt_client_publish(client, name, (const char *)data, len, qos, retain);
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    if (alias && msg_id < 0) {
+        // Not sent: the alias must not stay set for the next publish, whatever its topic
+        esp_mqtt5_client_set_publish_property(client, &(esp_mqtt5_publish_property_config_t){ 0 });
+    } else if (alias && topic_len > 0) {
+        topics[topic].announced_conn = conn;
+    }
+#endif
+    if (msg_id >= 0) {
+        topics[topic].stats.publishes++;
+        if (topic_len == 0) {
+            topics[topic].stats.aliased++;
+        }
+        topics[topic].stats.wire_bytes += publish_wire_len(topic_len, props_len, len, qos);
+    }
+    topics[topic].stats.publish_us += (uint32_t)(esp_timer_get_time() - start);
+    xSemaphoreGive(publish_lock);
+
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to publish to topic %s", topics[topic].name);
+    } else {
+        ESP_LOGD(TAG, "Published %d bytes to %s%s (QoS %d, msg_id=%d)", len, topics[topic].name,
+                 topic_len == 0 ? " by alias" : "", qos, msg_id);
+    }
+    return msg_id;
+}
+
+esp_err_t mqtt_topic_get_stats(mqtt_topic_t topic, mqtt_topic_stats_t *stats)
+{
+    if (topic < 0 || topic >= topic_count || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    *stats = topics[topic].stats;
+    xSemaphoreGive(publish_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file mqtt_topic.h
+ * @brief Registry of the MQTT topics published often, sent with MQTT 5 topic aliases
+ *
+ * Shared with the 3-Level-Cloud S3 server, whose main/CMakeLists.txt builds it from here.
+ * The client stays in mqtt.c: it hands its publish lock to mqtt_topic_init() and
+ * forwards every MQTT event to mqtt_topic_handle_event().
+ */
+
+#ifndef MQTT_TOPIC_H
+#define MQTT_TOPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MQTT_MAX_TOPICS 8
+
+/** @brief Handle of a topic registered with mqtt_topic_register() */
+typedef int mqtt_topic_t;
+
+#define MQTT_TOPIC_INVALID (-1)
+
+/** @brief What the publishes on a registered topic cost since boot */
+typedef struct {
+    uint32_t publishes;
+    uint32_t aliased;     // sent with the topic alias instead of the topic name
+    uint32_t wire_bytes;  // MQTT PUBLISH packets, before TLS
+    uint32_t publish_us;  // time spent in mqtt_publish_topic()
+} mqtt_topic_stats_t;
+
+/**
+ * @brief Set up the registry, once, before the client starts
+ *
+ * @param publish_lock Mutex taken by every publish of the client: esp-mqtt applies a publish
+ *                     property to the next publish, whatever task makes it
+ * @param mqtt5 The client connects with MQTT 5 (MQTT_PROTOCOL_V_5)
+ * @param alias_max Topic aliases to give out (MQTT_TOPIC_ALIAS_MAX), ignored without mqtt5
+ */
+void mqtt_topic_init(SemaphoreHandle_t publish_lock, bool mqtt5, uint16_t alias_max);
+
+/**
+ * @brief Follow the connection of the client: topic aliases only hold for one network connection
+ *
+ * Called by the MQTT event handler for every event, before it publishes anything.
+ *
+ * @param client MQTT client handle
+ * @param event_id Event of the handler
+ */
+void mqtt_topic_handle_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event_id);
+
+/**
+ * @brief Register a topic published often
+ *
+ * Over MQTT 5 the first alias_max topics published at QoS 0
+ * get a topic alias: on every connection the first QoS 0 publish sends the
+ * name and the alias, the later ones only the 2-byte alias. QoS 1/2 messages carry the
+ * name only, they can be resent on a new connection where the alias is
+ * unknown. A topic registered twice gets the same handle.
+ *
+ * @param topic Topic name, must stay valid (a string literal)
+ * @return Handle, MQTT_TOPIC_INVALID if all MQTT_MAX_TOPICS slots are taken or before mqtt_topic_init()
+ */
+mqtt_topic_t mqtt_topic_register(const char *topic);
+
+/**
+ * @brief Publish a binary payload to a registered topic
+ *
+ * @param client MQTT client handle
+ * @param topic Handle from mqtt_topic_register()
+ * @param data Payload
+ * @param len Payload length in bytes
+ * @param qos Quality of Service (0, 1, or 2)
+ * @param retain Retain flag
+ * @return Message ID of the publish operation (0 for QoS 0), -1 on failure
+ */
+int mqtt_publish_topic(esp_mqtt_client_handle_t client, mqtt_topic_t topic, const void *data, int len, int qos, int retain);
+
+/**
+ * @brief Get the counters of a registered topic
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an unknown handle
+ */
+esp_err_t mqtt_topic_get_stats(mqtt_topic_t topic, mqtt_topic_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MQTT_TOPIC_H
@@ -0,0 +1,258 @@
+/**
+ * @file sampler.c
+ * @brief Deadline-driven sampling of several sensors
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "sampler.h"
+#include "config.h"
+
+static const char *TAG = "SAMPLER";
+
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_IDLE,      // waiting for the deadline of the next measurement
+    SLOT_MEASURING, // started, waiting until it can be read
+} slot_state_t;
+
+typedef struct {
+    sampler_sensor_t sensor;
+    slot_state_t state;
+    bool remove;         // freed by the sampler task, it may be in a callback of this sensor
+    int64_t deadline_us; // start of the current/next measurement
+    int64_t due_us;      // next step: the deadline or the read
+    sampler_stats_t stats;
+} slot_t;
+
+// Slots are claimed by sampler_add() and freed by the sampler task only; the callbacks run
+// without a lock held, they may publish over MQTT while the MQTT task calls sampler_remove()
+static slot_t slots[SAMPLER_MAX_SENSORS];
+static portMUX_TYPE slots_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t sampler_task_handle = NULL;
+static esp_timer_handle_t wake_timer = NULL;
+
+// Counts in the stats of a slot: sampler_get_stats() and sampler_remove() copy them from other tasks
+static void count(uint32_t *counter, uint32_t n)
+{
+    portENTER_CRITICAL(&slots_lock);
+    *counter += n;
+    portEXIT_CRITICAL(&slots_lock);
+}
+
+// Next deadline after now, the ones already passed are skipped
+static void schedule_next(slot_t *slot, int64_t now_us)
+{
+    int64_t period_us = (int64_t)slot->sensor.period_ms * 1000;
+    uint32_t missed = 0;
+    slot->deadline_us += period_us;
+    while (slot->deadline_us < now_us) {
+        slot->deadline_us += period_us;
+        missed++;
+    }
+    if (missed > 0) {
+        count(&slot->stats.missed, missed);
+    }
+    slot->state = SLOT_IDLE;
+    slot->due_us = slot->deadline_us;
+}
+
+// Runs the steps due at now_us, returns the time of the next one (INT64_MAX if there is none)
+static int64_t sampler_poll(int64_t now_us)
+{
+    int64_t next_us = INT64_MAX;
+
+    for (int i = 0; i < SAMPLER_MAX_SENSORS; i++) {
+        slot_t *slot = &slots[i];
+        portENTER_CRITICAL(&slots_lock);
+        if (slot->remove) {
+            slot->state = SLOT_FREE;
+            slot->remove = false;
+        }
+        slot_state_t state = slot->state;
+        portEXIT_CRITICAL(&slots_lock);
+        if (state == SLOT_FREE) {
+            continue;
+        }
+        if (slot->due_us <= now_us) {
+            if (slot->state == SLOT_IDLE) {
+                uint32_t late_us = (uint32_t)(now_us - slot->deadline_us);
+                portENTER_CRITICAL(&slots_lock);
+                if (late_us > slot->stats.max_late_us) {
+                    slot->stats.max_late_us = late_us;
+                }
+                portEXIT_CRITICAL(&slots_lock);
+                int32_t wait_us = slot->sensor.start(slot->sensor.ctx);
+                if (wait_us >= 0) {
+                    slot->state = SLOT_MEASURING;
+                    slot->due_us = now_us + wait_us;
+                } else {
+                    ESP_LOGW(TAG, "%s: measurement not started", slot->sensor.name);
+                    count(&slot->stats.errors, 1);
+                    schedule_next(slot, now_us);
+                }
+            } else {
+                int32_t wait_us = slot->sensor.read(slot->sensor.ctx);
+                if (wait_us > 0) {
+                    // Not finished yet
+                    slot->due_us = now_us + wait_us;
+                } else {
+                    if (wait_us == 0) {
+                        count(&slot->stats.samples, 1);
+                    } else {
+                        ESP_LOGW(TAG, "%s: measurement not read", slot->sensor.name);
+                        count(&slot->stats.errors, 1);
+                    }
+                    schedule_next(slot, now_us);
+                }
+            }
+        }
+        if (slot->due_us < next_us) {
+            next_us = slot->due_us;
+        }
+    }
+    return next_us;
+}
+
+static void sampler_timer_callback(void *arg)
+{
+    xTaskNotifyGive(sampler_task_handle);
+}
+
+static void sampler_task(void *pvParameters)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        int64_t next_us = sampler_poll(esp_timer_get_time());
+
+        // Sleep until the earliest step of any sensor: no polling, no drift from the sensor callbacks
+        esp_timer_stop(wake_timer);
+        if (next_us != INT64_MAX) {
+            int64_t wait_us = next_us - esp_timer_get_time();
+            if (wait_us > 0) {
+                esp_timer_start_once(wake_timer, wait_us);
+            } else {
+                xTaskNotifyGive(sampler_task_handle);
+            }
+        }
+    }
+}
+
+static esp_err_t sampler_init(void)
+{
+    if (sampler_task_handle != NULL) {
+        return ESP_OK;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = sampler_timer_callback,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "sampler",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &wake_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (xTaskCreate(sampler_task, "sampler", SAMPLER_TASK_STACK, NULL, SAMPLER_TASK_PRIORITY,
+                    &sampler_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create sampler task");
+        esp_timer_delete(wake_timer);
+        wake_timer = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sampler_add(const sampler_sensor_t *sensor)
+{
+    if (sensor == NULL || sensor->start == NULL || sensor->read == NULL || sensor->period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = sampler_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    slot_t *free_slot = NULL;
+    bool duplicate = false;
+    portENTER_CRITICAL(&slots_lock);
+    for (int i = 0; i < SAMPLER_MAX_SENSORS; i++) {
+        if (slots[i].state != SLOT_FREE && !slots[i].remove && strcmp(slots[i].sensor.name, sensor->name) == 0) {
+            duplicate = true;
+        }
+        if (slots[i].state == SLOT_FREE && free_slot == NULL) {
+            free_slot = &slots[i];
+        }
+    }
+    if (!duplicate && free_slot != NULL) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->sensor = *sensor;
+        free_slot->deadline_us = esp_timer_get_time();
+        free_slot->due_us = free_slot->deadline_us;
+        free_slot->state = SLOT_IDLE;
+    }
+    portEXIT_CRITICAL(&slots_lock);
+
+    if (duplicate) {
+        ESP_LOGW(TAG, "%s is already sampled", sensor->name);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (free_slot == NULL) {
+        ESP_LOGE(TAG, "No slot for %s, SAMPLER_MAX_SENSORS is %d", sensor->name, SAMPLER_MAX_SENSORS);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Sampling %s every %lu ms", sensor->name, (unsigned long)sensor->period_ms);
+    xTaskNotifyGive(sampler_task_handle);
+    return ESP_OK;
+}
+
+esp_err_t sampler_remove(const char *name)
+{
+    slot_t *found = NULL;
+    sampler_stats_t stats;
+    portENTER_CRITICAL(&slots_lock);
+    for (int i = 0; i < SAMPLER_MAX_SENSORS; i++) {
+        if (slots[i].state != SLOT_FREE && !slots[i].remove && strcmp(slots[i].sensor.name, name) == 0) {
+            found = &slots[i];
+            found->remove = true;
+            stats = found->stats;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&slots_lock);
+
+    if (found == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGI(TAG, "%s removed: %lu samples, %lu errors, %lu missed, latest start %lu us late", name,
+             (unsigned long)stats.samples, (unsigned long)stats.errors, (unsigned long)stats.missed,
+             (unsigned long)stats.max_late_us);
+    // The slot is freed by the sampler task, between two callbacks
+    xTaskNotifyGive(sampler_task_handle);
+    return ESP_OK;
+}
+
+esp_err_t sampler_get_stats(const char *name, sampler_stats_t *stats)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&slots_lock);
+    for (int i = 0; i < SAMPLER_MAX_SENSORS; i++) {
+        if (slots[i].state != SLOT_FREE && !slots[i].remove && strcmp(slots[i].sensor.name, name) == 0) {
+            *stats = slots[i].stats;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&slots_lock);
+    return ret;
+}
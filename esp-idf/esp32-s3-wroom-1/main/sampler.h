@@ -0,0 +1,52 @@
+/**
+ * @file sampler.h
+ * @brief Deadline-driven sampling of several sensors
+ *
+ * Every sensor has a period and two steps: start a measurement, then read
+ * it once the sensor says it is done. One esp_timer is armed for the
+ * earliest deadline of all sensors and wakes the sampler task, which runs
+ * every step that is due. Deadlines advance by the period from the
+ * previous deadline, not from when the read finished, so the sampling
+ * does not drift; a missed deadline is skipped and counted.
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define SAMPLER_MAX_SENSORS 4
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    /** Starts a measurement, returns the µs until it can be read, < 0 on error. */
+    int32_t (*start)(void *ctx);
+    /** Reads and handles the measurement, returns 0 when done, > 0 µs to try again, < 0 on error. */
+    int32_t (*read)(void *ctx);
+    void *ctx;
+} sampler_sensor_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t errors;
+    uint32_t missed;     // deadlines skipped because the previous sample was late
+    uint32_t max_late_us; // latest start after its deadline
+} sampler_stats_t;
+
+/**
+ * @brief Adds a sensor, its first measurement starts right away.
+ *
+ * Starts the sampler task and timer on first use. The sensor struct is
+ * copied.
+ */
+esp_err_t sampler_add(const sampler_sensor_t *sensor);
+
+/** @brief Removes a sensor by name, a measurement in progress is abandoned. */
+esp_err_t sampler_remove(const char *name);
+
+/** @brief Statistics of a sensor, ESP_ERR_NOT_FOUND if it is not sampled. */
+esp_err_t sampler_get_stats(const char *name, sampler_stats_t *stats);
+
+#endif // SAMPLER_H
@@ -0,0 +1,176 @@
+/**
+ * @file telemetry_batch.c
+ * @brief Sample ring and delta/varint batch encoding
+ */
+
+#include <string.h>
+#include "telemetry_batch.h"
+
+#define HEADER_LEN 5 // without base_ms
+#define VARINT_MAX 10 // 64-bit
+
+static size_t put_varint(uint8_t *p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+// 0 if truncated or too long
+static size_t get_varint(const uint8_t *p, size_t len, uint64_t *v) {
+    *v = 0;
+    for (size_t n = 0; n < len && n < VARINT_MAX; n++) {
+        *v |= (uint64_t)(p[n] & 0x7F) << (7 * n);
+        if (!(p[n] & 0x80)) {
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static const telemetry_sample_t *sample_at(const telemetry_batch_t *batch, int i) {
+    return &batch->ring[(batch->head + i) % batch->capacity];
+}
+
+void telemetry_batch_init(telemetry_batch_t *batch, telemetry_sample_t *storage, int capacity, int fields) {
+    memset(batch, 0, sizeof(*batch));
+    batch->ring = storage;
+    batch->capacity = capacity;
+    batch->fields = fields > TELEMETRY_MAX_FIELDS ? TELEMETRY_MAX_FIELDS : fields;
+}
+
+void telemetry_batch_add(telemetry_batch_t *batch, const telemetry_sample_t *sample) {
+    if (batch->count == batch->capacity) {
+        batch->head = (batch->head + 1) % batch->capacity;
+        batch->count--;
+        batch->dropped++;
+    }
+    batch->ring[(batch->head + batch->count) % batch->capacity] = *sample;
+    batch->count++;
+}
+
+int64_t telemetry_batch_oldest_ms(const telemetry_batch_t *batch) {
+    return sample_at(batch, 0)->time_ms;
+}
+
+size_t telemetry_batch_encode(const telemetry_batch_t *batch, uint8_t flags, int64_t time_offset_ms, int max_samples,
+                              uint8_t *out, size_t size, int *encoded) {
+    *encoded = 0;
+    if (batch->count == 0 || size < HEADER_LEN + VARINT_MAX) {
+        return 0;
+    }
+    int limit = batch->count;
+    if (limit > max_samples) {
+        limit = max_samples;
+    }
+    if (limit > TELEMETRY_MAX_BATCH) {
+        limit = TELEMETRY_MAX_BATCH;
+    }
+    out[0] = TELEMETRY_MAGIC;
+    out[1] = TELEMETRY_VERSION;
+    out[2] = flags;
+    out[3] = (uint8_t)batch->fields;
+    const telemetry_sample_t *prev = sample_at(batch, 0);
+    size_t pos = HEADER_LEN + put_varint(out + HEADER_LEN, (uint64_t)(prev->time_ms + time_offset_ms));
+    uint8_t tmp[VARINT_MAX + TELEMETRY_MAX_FIELDS * VARINT_MAX];
+    int n = 0;
+    for (; n < limit; n++) {
+        const telemetry_sample_t *s = sample_at(batch, n);
+        size_t len = put_varint(tmp, n == 0 ? 0 : (uint64_t)(s->time_ms - prev->time_ms));
+        for (int f = 0; f < batch->fields; f++) {
+            int64_t base = n == 0 ? 0 : prev->value[f];
+            len += put_varint(tmp + len, zigzag((int64_t)s->value[f] - base));
+        }
+        if (pos + len > size) {
+            break;
+        }
+        memcpy(out + pos, tmp, len);
+        pos += len;
+        prev = s;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    out[4] = (uint8_t)n;
+    *encoded = n;
+    return pos;
+}
+
+// An array is a ring that starts at 0
+size_t telemetry_encode_samples(const telemetry_sample_t *samples, int count, int fields, uint8_t flags,
+                                int64_t time_offset_ms, uint8_t *out, size_t size, int *encoded) {
+    const telemetry_batch_t array = {
+        .ring = (telemetry_sample_t *)samples,
+        .capacity = count,
+        .fields = fields > TELEMETRY_MAX_FIELDS ? TELEMETRY_MAX_FIELDS : fields,
+        .count = count,
+    };
+    return telemetry_batch_encode(&array, flags, time_offset_ms, count, out, size, encoded);
+}
+
+void telemetry_batch_consume(telemetry_batch_t *batch, int n) {
+    if (n > batch->count) {
+        n = batch->count;
+    }
+    batch->head = (batch->head + n) % batch->capacity;
+    batch->count -= n;
+}
+
+int telemetry_batch_decode(const uint8_t *msg, size_t len, int *fields, uint8_t *flags, telemetry_sample_t *out,
+                           int max) {
+    if (len < HEADER_LEN || msg[0] != TELEMETRY_MAGIC || msg[1] != TELEMETRY_VERSION ||
+        msg[3] > TELEMETRY_MAX_FIELDS) {
+        return -1;
+    }
+    *flags = msg[2];
+    *fields = msg[3];
+    int count = msg[4];
+    uint64_t v;
+    size_t pos = HEADER_LEN;
+    size_t n = get_varint(msg + pos, len - pos, &v);
+    if (n == 0) {
+        return -1;
+    }
+    pos += n;
+    telemetry_sample_t prev = { .time_ms = (int64_t)v };
+    for (int i = 0; i < count; i++) {
+        telemetry_sample_t s = { 0 };
+        if ((n = get_varint(msg + pos, len - pos, &v)) == 0) {
+            return -1;
+        }
+        pos += n;
+        s.time_ms = prev.time_ms + (int64_t)v;
+        for (int f = 0; f < *fields; f++) {
+            if ((n = get_varint(msg + pos, len - pos, &v)) == 0) {
+                return -1;
+            }
+            pos += n;
+            s.value[f] = (int32_t)((i == 0 ? 0 : prev.value[f]) + unzigzag(v));
+        }
+        if (i < max) {
+            out[i] = s;
+        }
+        prev = s;
+    }
+    if (pos != len) {
+        return -1;
+    }
+    return count < max ? count : max;
+}
+
+size_t telemetry_mqtt_wire_len(size_t topic_len, size_t payload_len, int qos) {
+    size_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + payload_len;
+    size_t len_bytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : remaining < 2097152 ? 3 : 4;
+    return 1 + len_bytes + remaining;
+}
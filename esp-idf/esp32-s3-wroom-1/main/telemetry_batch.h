@@ -0,0 +1,90 @@
+/**
+ * @file telemetry_batch.h
+ * @brief Sensor samples kept in a ring and published as one compact binary batch
+ *
+ * Samples are integers in fixed units chosen by the caller (e.g. 0.01 °C).
+ * A batch is encoded with a base timestamp, then per sample the time since
+ * the previous one and the change of every field, as zigzag varints:
+ * slowly changing values take one byte per field.
+ *
+ * Batch: | 'T' | version | flags | fields u8 | count u8 | base_ms varint |
+ *        | count x (dt_ms varint | fields x zigzag(delta) varint) |
+ * The first sample has dt 0 and deltas from 0 (its full values).
+ *
+ * No ESP-IDF dependencies, the encoder and decoder build on the host too.
+ */
+
+#ifndef TELEMETRY_BATCH_H
+#define TELEMETRY_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_MAGIC 'T'
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_MAX_FIELDS 4
+#define TELEMETRY_MAX_BATCH 255 // samples per message (count is one byte)
+#define TELEMETRY_FLAG_UNIX_TIME 0x01 // base_ms is Unix time, otherwise uptime
+#define TELEMETRY_FLAG_PREVIOUS_BOOT 0x02 // uptime of an earlier boot (backfilled from flash)
+
+typedef struct {
+    int64_t time_ms;
+    int32_t value[TELEMETRY_MAX_FIELDS];
+} telemetry_sample_t;
+
+typedef struct {
+    telemetry_sample_t *ring; // capacity samples, owned by the caller
+    int capacity;
+    int fields;
+    int head;                 // oldest sample
+    int count;
+    uint32_t dropped;         // overwritten before they were sent
+} telemetry_batch_t;
+
+/** @brief Sets up an empty ring over the caller's storage. */
+void telemetry_batch_init(telemetry_batch_t *batch, telemetry_sample_t *storage, int capacity, int fields);
+
+/** @brief Adds a sample, the oldest is overwritten when the ring is full. */
+void telemetry_batch_add(telemetry_batch_t *batch, const telemetry_sample_t *sample);
+
+/** @brief Time of the oldest sample waiting, only valid if count > 0. */
+int64_t telemetry_batch_oldest_ms(const telemetry_batch_t *batch);
+
+/** @brief Worst case encoded length of a batch: header, base_ms, then dt and one delta per field per sample. */
+#define TELEMETRY_BATCH_MAX_LEN(fields, samples) (5 + 10 + (samples) * (10 + (fields) * 5))
+
+/**
+ * @brief Encodes the oldest samples, as many as fit (at most max_samples).
+ *
+ * The samples stay in the ring until telemetry_batch_consume().
+ *
+ * @param flags TELEMETRY_FLAG_* for the header.
+ * @param time_offset_ms Added to base_ms only, e.g. to turn the uptime of the samples into Unix time.
+ * @param[out] encoded Samples encoded.
+ * @return Bytes written, 0 if the ring is empty or not even one sample fits.
+ */
+size_t telemetry_batch_encode(const telemetry_batch_t *batch, uint8_t flags, int64_t time_offset_ms, int max_samples,
+                              uint8_t *out, size_t size, int *encoded);
+
+/** @brief Same as telemetry_batch_encode() for samples in an array, oldest first. */
+size_t telemetry_encode_samples(const telemetry_sample_t *samples, int count, int fields, uint8_t flags,
+                                int64_t time_offset_ms, uint8_t *out, size_t size, int *encoded);
+
+/** @brief Removes the n oldest samples (sent). */
+void telemetry_batch_consume(telemetry_batch_t *batch, int n);
+
+/**
+ * @brief Decodes a batch message.
+ *
+ * @param[out] fields Fields per sample.
+ * @param[out] flags Header flags.
+ * @return Samples decoded (at most max), -1 if the message is invalid.
+ */
+int telemetry_batch_decode(const uint8_t *msg, size_t len, int *fields, uint8_t *flags, telemetry_sample_t *out,
+                           int max);
+
+/** @brief Bytes of an MQTT 3.1.1 PUBLISH packet on the wire (before TLS), to compare schemes. */
+size_t telemetry_mqtt_wire_len(size_t topic_len, size_t payload_len, int qos);
+
+#endif // TELEMETRY_BATCH_H
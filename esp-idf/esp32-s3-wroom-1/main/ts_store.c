@@ -0,0 +1,677 @@
+/**
+ * @file ts_store.c
+ * @brief Flash blocks of Gorilla-packed samples
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_log.h"
+
+#include "gorilla.h"
+#include "ts_store.h"
+
+static const char *TAG = "TS_STORE";
+
+#define BLOCK_MAGIC 0x31425354 // "TSB1"
+#define FRAME_HEADER_LEN 4     // payload length u16, samples u16
+#define FRAME_END 0xFFFF       // erased flash after the last frame
+#define PENDING_LEN 512        // packed samples not written yet
+#define MERGE_SLACK 64         // bytes a merge may add per joined block (its first sample is no longer raw)
+
+// Block flags, set when the block is opened
+#define BLOCK_FLAG_UNIX_TIME 0x01
+#define BLOCK_FLAG_MERGED 0x02 // written by a merge, replaces the blocks of its seq range once committed
+
+// State bits, cleared in this order as the block gets there
+#define STATE_SEALED 0x01
+#define STATE_UPLOADED 0x02
+#define STATE_COMMITTED 0x04 // merged blocks only
+
+typedef struct {
+    uint32_t magic;         // written last when opened: a torn header reads as a free block
+    uint32_t seq;           // allocation order
+    uint32_t seq_end;       // last seq a merged block replaces, seq otherwise
+    uint16_t boot;
+    uint16_t resolution_ms;
+    int64_t first_ms;       // time of the first sample, the others are ticks of resolution_ms from it
+    uint8_t fields;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t state;
+    // Written when sealed
+    uint32_t count;
+    uint32_t used;          // bytes of the header and frames
+    int64_t last_ms;
+} block_header_t;
+
+_Static_assert(sizeof(block_header_t) == 48, "block header layout");
+
+typedef struct {
+    int block;
+    uint32_t used;          // bytes on flash
+    uint32_t count;         // samples, the pending ones included
+    uint32_t pending;       // samples in buf only
+    uint16_t flush_samples;
+    int64_t last_ms;
+    gorilla_encoder_t enc;
+    uint8_t buf[PENDING_LEN];
+} block_writer_t;
+
+typedef esp_err_t (*sample_fn_t)(const telemetry_sample_t *sample, void *ctx);
+
+// The frames of a block decoded whole
+typedef struct {
+    uint32_t end;
+    uint32_t count;
+    int64_t last_ms;
+} block_extent_t;
+
+static const esp_partition_t *partition = NULL;
+static block_header_t *blocks = NULL; // copy of every header, magic is not BLOCK_MAGIC for free blocks
+static int block_count;
+static ts_store_config_t config;
+static uint32_t next_seq;
+static uint16_t boot;
+static int last_alloc = -1;
+static block_writer_t writer = { .block = -1 };       // block the samples are appended to
+static block_writer_t merge_writer = { .block = -1 };
+static uint8_t block_buf[TS_STORE_BLOCK_SIZE];        // a block read back
+static ts_store_stats_t stats;
+
+static struct {
+    ts_store_upload_t upload;
+    void *ctx;
+    bool unix_time;
+    bool this_boot;
+    int count;
+    telemetry_sample_t chunk[TS_STORE_UPLOAD_SAMPLES];
+} upload_state;
+
+static bool block_valid(int block)
+{
+    return blocks[block].magic == BLOCK_MAGIC;
+}
+
+static bool has_state(int block, uint32_t bit)
+{
+    return (blocks[block].state & bit) == 0;
+}
+
+static esp_err_t flash_write(int block, uint32_t offset, const void *data, size_t len)
+{
+    esp_err_t ret = esp_partition_write(partition, (size_t)block * TS_STORE_BLOCK_SIZE + offset, data, len);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Write to block %d failed: %s", block, esp_err_to_name(ret));
+        return ret;
+    }
+    stats.bytes_written += len;
+    return ESP_OK;
+}
+
+static esp_err_t block_erase(int block)
+{
+    memset(&blocks[block], 0xFF, sizeof(block_header_t));
+    esp_err_t ret = esp_partition_erase_range(partition, (size_t)block * TS_STORE_BLOCK_SIZE, TS_STORE_BLOCK_SIZE);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Erase of block %d failed: %s", block, esp_err_to_name(ret));
+        return ret;
+    }
+    stats.erases++;
+    return ESP_OK;
+}
+
+static esp_err_t block_set_state(int block, uint32_t bit)
+{
+    blocks[block].state &= ~bit;
+    return flash_write(block, offsetof(block_header_t, state), &blocks[block].state, sizeof(uint32_t));
+}
+
+// Rounded to the nearest tick
+static int64_t to_ticks(int64_t ms, uint16_t resolution_ms)
+{
+    int64_t half = resolution_ms / 2;
+    return ms >= 0 ? (ms + half) / resolution_ms : -((-ms + half) / resolution_ms);
+}
+
+// An erased block to write to: the next free one after the last allocated (spreads the wear), else the
+// oldest uploaded one, else (if may_drop) the oldest one
+static int block_alloc(bool may_drop)
+{
+    int found = -1;
+    for (int n = 1; n <= block_count && found < 0; n++) {
+        int i = (last_alloc + n) % block_count;
+        if (!block_valid(i)) {
+            found = i;
+        }
+    }
+    for (int pass = 0; pass < (may_drop ? 2 : 1) && found < 0; pass++) {
+        for (int i = 0; i < block_count; i++) {
+            if (!block_valid(i) || i == writer.block || i == merge_writer.block ||
+                (pass == 0 && !has_state(i, STATE_UPLOADED))) {
+                continue;
+            }
+            if (found < 0 || blocks[i].seq < blocks[found].seq) {
+                found = i;
+            }
+        }
+    }
+    if (found < 0) {
+        return -1;
+    }
+    if (block_valid(found) && !has_state(found, STATE_UPLOADED)) {
+        ESP_LOGW(TAG, "Store full, %lu samples not uploaded are dropped", (unsigned long)blocks[found].count);
+        stats.dropped += blocks[found].count;
+    }
+    if (block_erase(found) != ESP_OK) {
+        return -1;
+    }
+    last_alloc = found;
+    return found;
+}
+
+static esp_err_t writer_open(block_writer_t *w, const block_header_t *header, uint16_t flush_samples, bool may_drop)
+{
+    int block = block_alloc(may_drop);
+    if (block < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    block_header_t h = *header;
+    h.magic = BLOCK_MAGIC;
+    memset(&h.state, 0xFF, sizeof(h) - offsetof(block_header_t, state));
+
+    esp_err_t ret = flash_write(block, sizeof(h.magic), &h.seq, offsetof(block_header_t, state) - sizeof(h.magic));
+    if (ret == ESP_OK) {
+        ret = flash_write(block, 0, &h.magic, sizeof(h.magic));
+    }
+    if (ret != ESP_OK) {
+        block_erase(block);
+        return ret;
+    }
+    blocks[block] = h;
+
+    w->block = block;
+    w->used = sizeof(block_header_t);
+    w->count = 0;
+    w->pending = 0;
+    w->flush_samples = flush_samples;
+    w->last_ms = h.first_ms;
+    gorilla_encoder_init(&w->enc, w->buf, sizeof(w->buf), h.fields, 0);
+    return ESP_OK;
+}
+
+// The pending samples as one frame; they are lost if it can't be written
+static esp_err_t writer_flush(block_writer_t *w)
+{
+    if (w->block < 0 || w->pending == 0) {
+        return ESP_OK;
+    }
+    uint16_t frame[2] = { (uint16_t)gorilla_flush(&w->enc), (uint16_t)w->pending };
+    // Payload first: a frame without its header is ignored after a reset
+    esp_err_t ret = flash_write(w->block, w->used + FRAME_HEADER_LEN, w->buf, frame[0]);
+    if (ret == ESP_OK) {
+        ret = flash_write(w->block, w->used, frame, sizeof(frame));
+    }
+    if (ret != ESP_OK) {
+        w->count -= w->pending;
+        w->pending = 0;
+        return ret;
+    }
+    w->used += FRAME_HEADER_LEN + frame[0];
+    w->pending = 0;
+    stats.frames++;
+    return ESP_OK;
+}
+
+// ESP_ERR_NO_MEM when the sample belongs in a new block: this one is full or the time step does not fit
+static esp_err_t writer_append(block_writer_t *w, int64_t time_ms, const int32_t *values)
+{
+    const block_header_t *h = &blocks[w->block];
+    size_t pending_len = (w->enc.bits + 7) / 8;
+    size_t sample_len = (GORILLA_MAX_SAMPLE_BITS(h->fields) + 7) / 8;
+    if (w->used + FRAME_HEADER_LEN + pending_len + sample_len > TS_STORE_BLOCK_SIZE) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    int64_t ticks = to_ticks(time_ms - h->first_ms, h->resolution_ms);
+    gorilla_status_t status = gorilla_append(&w->enc, ticks, values);
+    if (status == GORILLA_FULL) {
+        esp_err_t ret = writer_flush(w);
+        return ret == ESP_OK ? writer_append(w, time_ms, values) : ret;
+    }
+    if (status == GORILLA_RANGE) {
+        return ESP_ERR_NO_MEM;
+    }
+    w->count++;
+    w->pending++;
+    w->last_ms = h->first_ms + ticks * h->resolution_ms;
+    return w->pending >= w->flush_samples ? writer_flush(w) : ESP_OK;
+}
+
+static esp_err_t writer_seal(block_writer_t *w)
+{
+    if (w->block < 0) {
+        return ESP_OK;
+    }
+    esp_err_t ret = writer_flush(w);
+    int block = w->block;
+    w->block = -1;
+    if (w->count == 0) {
+        block_erase(block);
+        return ret;
+    }
+
+    block_header_t *h = &blocks[block];
+    h->count = w->count;
+    h->used = w->used;
+    h->last_ms = w->last_ms;
+    esp_err_t seal_ret = flash_write(block, offsetof(block_header_t, count), &h->count,
+                                     sizeof(*h) - offsetof(block_header_t, count));
+    if (seal_ret == ESP_OK) {
+        seal_ret = block_set_state(block, STATE_SEALED);
+    }
+    return ret != ESP_OK ? ret : seal_ret;
+}
+
+// Decodes the frames of a block in order: up to used once sealed, up to the first missing one otherwise.
+// ESP_ERR_INVALID_CRC if the data is damaged (a torn frame), else the first error of fn
+static esp_err_t block_for_each(int block, sample_fn_t fn, void *ctx, block_extent_t *extent)
+{
+    const block_header_t *h = &blocks[block];
+    esp_err_t ret = esp_partition_read(partition, (size_t)block * TS_STORE_BLOCK_SIZE, block_buf, TS_STORE_BLOCK_SIZE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    uint32_t end = has_state(block, STATE_SEALED) && h->used <= TS_STORE_BLOCK_SIZE ? h->used : TS_STORE_BLOCK_SIZE;
+
+    gorilla_decoder_t dec;
+    gorilla_decoder_init(&dec, h->fields, 0);
+    uint32_t pos = sizeof(block_header_t);
+    block_extent_t whole = { .end = pos, .count = 0, .last_ms = h->first_ms };
+    if (extent != NULL) {
+        *extent = whole;
+    }
+    while (pos + FRAME_HEADER_LEN <= end) {
+        uint16_t frame[2];
+        memcpy(frame, block_buf + pos, sizeof(frame));
+        // Either half still erased: the header write was interrupted
+        if (frame[0] == FRAME_END || frame[1] == FRAME_END) {
+            break;
+        }
+        if (pos + FRAME_HEADER_LEN + frame[0] > end) {
+            return ESP_ERR_INVALID_CRC;
+        }
+        gorilla_decoder_input(&dec, block_buf + pos + FRAME_HEADER_LEN, frame[0]);
+        for (int n = 0; n < frame[1]; n++) {
+            telemetry_sample_t sample = { 0 };
+            int64_t ticks;
+            if (!gorilla_decode(&dec, &ticks, sample.value)) {
+                return ESP_ERR_INVALID_CRC;
+            }
+            sample.time_ms = h->first_ms + ticks * h->resolution_ms;
+            if (fn != NULL && (ret = fn(&sample, ctx)) != ESP_OK) {
+                return ret;
+            }
+            whole.last_ms = sample.time_ms;
+        }
+        pos += FRAME_HEADER_LEN + frame[0];
+        whole.end = pos;
+        whole.count += frame[1];
+        if (extent != NULL) {
+            *extent = whole;
+        }
+    }
+    return ESP_OK;
+}
+
+// Seals the block a reset interrupted, up to its last complete frame
+static void block_recover(int block)
+{
+    block_extent_t extent;
+    esp_err_t ret = block_for_each(block, NULL, NULL, &extent);
+    if ((ret != ESP_OK && ret != ESP_ERR_INVALID_CRC) || extent.count == 0) {
+        ESP_LOGW(TAG, "Block %d (seq %lu) empty, erased", block, (unsigned long)blocks[block].seq);
+        block_erase(block);
+        return;
+    }
+    // Sealed through a writer with nothing pending
+    block_writer_t *w = &merge_writer;
+    w->block = block;
+    w->used = extent.end;
+    w->count = extent.count;
+    w->pending = 0;
+    w->last_ms = extent.last_ms;
+    ESP_LOGI(TAG, "Block %d (seq %lu) recovered with %lu samples", block, (unsigned long)blocks[block].seq,
+             (unsigned long)extent.count);
+    writer_seal(w);
+}
+
+esp_err_t ts_store_open(const ts_store_config_t *cfg)
+{
+    if (blocks != NULL) {
+        return ESP_OK;
+    }
+    if (cfg->fields < 1 || cfg->fields > TELEMETRY_MAX_FIELDS || cfg->resolution_ms == 0 || cfg->flush_samples == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, cfg->partition);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "No partition \"%s\" (see partitions.csv)", cfg->partition);
+        return ESP_ERR_NOT_FOUND;
+    }
+    block_count = partition->size / TS_STORE_BLOCK_SIZE;
+    if (block_count < 2) {
+        ESP_LOGE(TAG, "Partition \"%s\" is too small", cfg->partition);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    blocks = calloc(block_count, sizeof(block_header_t));
+    if (blocks == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    config = *cfg;
+
+    uint16_t last_boot = 0;
+    next_seq = 0;
+    for (int i = 0; i < block_count; i++) {
+        if (esp_partition_read(partition, (size_t)i * TS_STORE_BLOCK_SIZE, &blocks[i], sizeof(block_header_t)) != ESP_OK) {
+            memset(&blocks[i], 0xFF, sizeof(block_header_t));
+        }
+        if (!block_valid(i)) {
+            continue;
+        }
+        if (blocks[i].seq_end >= next_seq) {
+            next_seq = blocks[i].seq_end + 1;
+            last_alloc = i;
+        }
+        if (blocks[i].boot > last_boot) {
+            last_boot = blocks[i].boot;
+        }
+    }
+    boot = last_boot + 1;
+
+    // A merge that did not finish: the blocks it was replacing are all still there
+    for (int i = 0; i < block_count; i++) {
+        if (block_valid(i) && (blocks[i].flags & BLOCK_FLAG_MERGED) && !has_state(i, STATE_COMMITTED)) {
+            block_erase(i);
+        }
+    }
+    // A merge that finished before all the blocks it replaces were erased
+    for (int m = 0; m < block_count; m++) {
+        if (!block_valid(m) || !(blocks[m].flags & BLOCK_FLAG_MERGED)) {
+            continue;
+        }
+        for (int i = 0; i < block_count; i++) {
+            if (i != m && block_valid(i) && blocks[i].seq >= blocks[m].seq && blocks[i].seq_end <= blocks[m].seq_end) {
+                block_erase(i);
+            }
+        }
+    }
+    for (int i = 0; i < block_count; i++) {
+        if (block_valid(i) && !has_state(i, STATE_SEALED)) {
+            block_recover(i);
+        }
+    }
+
+    ts_store_get_stats(&stats);
+    ESP_LOGI(TAG, "Opened \"%s\": %lu blocks, %lu free, %lu to upload, boot %u", cfg->partition,
+             (unsigned long)stats.blocks, (unsigned long)stats.free_blocks, (unsigned long)stats.pending_blocks, boot);
+    return ESP_OK;
+}
+
+esp_err_t ts_store_append(int64_t time_ms, bool unix_time, const int32_t *values)
+{
+    if (blocks == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint8_t flags = unix_time ? BLOCK_FLAG_UNIX_TIME : 0;
+    if (writer.block >= 0 && blocks[writer.block].flags != flags) {
+        writer_seal(&writer);
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (writer.block < 0) {
+            const block_header_t header = {
+                .seq = next_seq,
+                .seq_end = next_seq,
+                .boot = boot,
+                .resolution_ms = config.resolution_ms,
+                .first_ms = time_ms,
+                .fields = (uint8_t)config.fields,
+                .flags = flags,
+                .reserved = 0xFFFF,
+            };
+            esp_err_t ret = writer_open(&writer, &header, config.flush_samples, true);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            next_seq++;
+        }
+        esp_err_t ret = writer_append(&writer, time_ms, values);
+        if (ret == ESP_OK) {
+            stats.appended++;
+            return ESP_OK;
+        }
+        writer_seal(&writer);
+        if (ret != ESP_ERR_NO_MEM) {
+            return ret;
+        }
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t ts_store_flush(void)
+{
+    return writer_flush(&writer);
+}
+
+esp_err_t ts_store_seal(void)
+{
+    return writer_seal(&writer);
+}
+
+static bool block_pending(int block)
+{
+    return block_valid(block) && has_state(block, STATE_SEALED) && !has_state(block, STATE_UPLOADED) &&
+           (!(blocks[block].flags & BLOCK_FLAG_MERGED) || has_state(block, STATE_COMMITTED));
+}
+
+static int oldest_pending(void)
+{
+    int found = -1;
+    for (int i = 0; i < block_count; i++) {
+        if (block_pending(i) && (found < 0 || blocks[i].seq < blocks[found].seq)) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+bool ts_store_pending(void)
+{
+    return blocks != NULL && oldest_pending() >= 0;
+}
+
+static esp_err_t upload_chunk(void)
+{
+    if (upload_state.count == 0) {
+        return ESP_OK;
+    }
+    esp_err_t ret = upload_state.upload(upload_state.chunk, upload_state.count, upload_state.unix_time,
+                                        upload_state.this_boot, upload_state.ctx);
+    upload_state.count = 0;
+    return ret;
+}
+
+static esp_err_t upload_sample(const telemetry_sample_t *sample, void *ctx)
+{
+    upload_state.chunk[upload_state.count++] = *sample;
+    return upload_state.count < TS_STORE_UPLOAD_SAMPLES ? ESP_OK : upload_chunk();
+}
+
+esp_err_t ts_store_backfill(int max_blocks, ts_store_upload_t upload, void *ctx)
+{
+    if (blocks == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (int n = 0; n < max_blocks; n++) {
+        int block = oldest_pending();
+        if (block < 0) {
+            return ESP_OK;
+        }
+        upload_state.upload = upload;
+        upload_state.ctx = ctx;
+        upload_state.unix_time = blocks[block].flags & BLOCK_FLAG_UNIX_TIME;
+        upload_state.this_boot = blocks[block].boot == boot;
+        upload_state.count = 0;
+
+        esp_err_t ret = block_for_each(block, upload_sample, NULL, NULL);
+        if (ret == ESP_OK) {
+            ret = upload_chunk();
+        }
+        if (ret == ESP_ERR_INVALID_CRC) {
+            ESP_LOGW(TAG, "Block %d (seq %lu) unreadable, %lu samples dropped", block,
+                     (unsigned long)blocks[block].seq, (unsigned long)blocks[block].count);
+            stats.dropped += blocks[block].count;
+            block_erase(block);
+            continue;
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        stats.uploaded += blocks[block].count;
+        block_set_state(block, STATE_UPLOADED);
+    }
+    return oldest_pending() < 0 ? ESP_OK : ESP_ERR_NOT_FINISHED;
+}
+
+static esp_err_t merge_sample(const telemetry_sample_t *sample, void *ctx)
+{
+    return writer_append(&merge_writer, sample->time_ms, sample->value);
+}
+
+// Re-encodes a run of blocks into one, then erases them
+static esp_err_t merge_run(const int *run, int n)
+{
+    block_header_t header = blocks[run[0]];
+    header.seq_end = blocks[run[n - 1]].seq_end;
+    header.flags |= BLOCK_FLAG_MERGED;
+    esp_err_t ret = writer_open(&merge_writer, &header, UINT16_MAX, false);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    int target = merge_writer.block;
+    for (int k = 0; k < n && ret == ESP_OK; k++) {
+        ret = block_for_each(run[k], merge_sample, NULL, NULL);
+    }
+    if (ret == ESP_OK) {
+        ret = writer_seal(&merge_writer);
+    }
+    if (ret == ESP_OK) {
+        ret = block_set_state(target, STATE_COMMITTED);
+    }
+    if (ret != ESP_OK) {
+        merge_writer.block = -1;
+        block_erase(target);
+        return ret;
+    }
+
+    for (int k = 0; k < n; k++) {
+        block_erase(run[k]);
+    }
+    stats.merged_blocks += n;
+    ESP_LOGI(TAG, "Merged %d blocks into block %d: %lu samples in %lu bytes", n, target,
+             (unsigned long)blocks[target].count, (unsigned long)blocks[target].used);
+    return ESP_OK;
+}
+
+static bool mergeable(int block)
+{
+    return block_pending(block) && block != writer.block;
+}
+
+static bool same_kind(int a, int b)
+{
+    return blocks[a].boot == blocks[b].boot && blocks[a].fields == blocks[b].fields &&
+           blocks[a].resolution_ms == blocks[b].resolution_ms &&
+           (blocks[a].flags & BLOCK_FLAG_UNIX_TIME) == (blocks[b].flags & BLOCK_FLAG_UNIX_TIME);
+}
+
+// Merges runs of consecutive (by seq) blocks waiting for upload that fit in one
+static esp_err_t compact_merge(void)
+{
+    int *order = malloc(block_count * sizeof(int));
+    if (order == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    int n = 0;
+    for (int i = 0; i < block_count; i++) {
+        if (!block_valid(i)) {
+            continue;
+        }
+        int k = n++;
+        while (k > 0 && blocks[order[k - 1]].seq > blocks[i].seq) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = i;
+    }
+
+    esp_err_t ret = ESP_OK;
+    int start = 0;
+    while (start < n && ret == ESP_OK) {
+        int end = start;
+        uint32_t size = sizeof(block_header_t);
+        while (end < n && mergeable(order[end]) && same_kind(order[start], order[end]) &&
+               size + blocks[order[end]].used - sizeof(block_header_t) + (end > start ? MERGE_SLACK : 0) <=
+                   TS_STORE_BLOCK_SIZE) {
+            size += blocks[order[end]].used - sizeof(block_header_t) + (end > start ? MERGE_SLACK : 0);
+            end++;
+        }
+        if (end - start >= 2) {
+            ret = merge_run(&order[start], end - start);
+        }
+        start = end > start ? end : start + 1;
+    }
+    free(order);
+    // No block to merge into, or the slack was not enough: not an error of the store
+    return ret == ESP_ERR_NO_MEM ? ESP_OK : ret;
+}
+
+esp_err_t ts_store_compact(int64_t now_ms, bool unix_time, int64_t retention_ms)
+{
+    if (blocks == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (int i = 0; i < block_count; i++) {
+        if (!block_valid(i) || !has_state(i, STATE_SEALED)) {
+            continue;
+        }
+        bool block_unix = blocks[i].flags & BLOCK_FLAG_UNIX_TIME;
+        bool same_clock = unix_time ? block_unix : !block_unix && blocks[i].boot == boot;
+        if (same_clock && now_ms - blocks[i].last_ms > retention_ms) {
+            if (!has_state(i, STATE_UPLOADED)) {
+                ESP_LOGW(TAG, "%lu samples past the retention were not uploaded", (unsigned long)blocks[i].count);
+                stats.expired += blocks[i].count;
+            }
+            block_erase(i);
+        }
+    }
+    return compact_merge();
+}
+
+void ts_store_get_stats(ts_store_stats_t *out)
+{
+    *out = stats;
+    out->blocks = block_count;
+    out->boot = boot;
+    out->free_blocks = 0;
+    out->pending_blocks = 0;
+    for (int i = 0; blocks != NULL && i < block_count; i++) {
+        if (!block_valid(i)) {
+            out->free_blocks++;
+        } else if (block_pending(i)) {
+            out->pending_blocks++;
+        }
+    }
+}
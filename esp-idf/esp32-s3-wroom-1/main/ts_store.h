@@ -0,0 +1,120 @@
+/**
+ * @file ts_store.h
+ * @brief Append-only time-series store on a raw flash partition
+ *
+ * The partition is split into 4 KB blocks (one flash sector each). A block
+ * starts with a header, then frames of Gorilla-packed samples (gorilla.h):
+ *
+ *   | header 48 B | len u16 | count u16 | len bytes | len u16 | count u16 | ... | 0xFF |
+ *
+ * Samples are packed in RAM and written as a frame every flush_samples;
+ * the frame payload is programmed before its header, so a frame is either
+ * complete or absent after a reset. Flash bits are only ever cleared: the
+ * header is written once when the block is opened, its count and state
+ * words when it is sealed, uploaded or merged. A block is erased only to be
+ * reused.
+ *
+ * Sealed blocks are uploaded oldest first with ts_store_backfill() and
+ * stay on flash until their space is needed. When no free block is left the
+ * oldest one is reused, uploaded or not. ts_store_compact() erases blocks
+ * past the retention and merges runs of small blocks (left by resets and
+ * reconnects) into one.
+ *
+ * Not thread-safe, all calls from one task. Needs a partition without
+ * flash encryption.
+ */
+
+#ifndef TS_STORE_H
+#define TS_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry_batch.h"
+
+#define TS_STORE_BLOCK_SIZE 4096
+#define TS_STORE_UPLOAD_SAMPLES 60 // samples per upload callback
+
+typedef struct {
+    const char *partition;  // label of a data partition
+    int fields;             // values per sample, at most TELEMETRY_MAX_FIELDS
+    uint16_t resolution_ms; // timestamps are rounded to this
+    uint16_t flush_samples; // samples kept in RAM before they are written, lost on a reset
+} ts_store_config_t;
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t free_blocks;
+    uint32_t pending_blocks;   // sealed, not uploaded yet
+    uint16_t boot;             // boot number, one more than the newest block found at open
+    uint32_t appended;         // samples since open
+    uint32_t uploaded;
+    uint32_t dropped;          // not uploaded when their block was reused
+    uint32_t expired;          // not uploaded when the retention erased them
+    uint32_t merged_blocks;    // replaced by merged ones
+    uint32_t frames;
+    uint32_t bytes_written;    // frames and headers programmed
+    uint32_t erases;
+} ts_store_stats_t;
+
+/**
+ * @brief Uploads a chunk of samples of one block.
+ *
+ * @param unix_time The times are Unix ms, otherwise uptime ms.
+ * @param this_boot The samples were taken since the current boot (matters for uptime).
+ * @return ESP_OK when sent, anything else stops the backfill and keeps the block.
+ */
+typedef esp_err_t (*ts_store_upload_t)(const telemetry_sample_t *samples, int count, bool unix_time, bool this_boot,
+                                       void *ctx);
+
+/**
+ * @brief Opens the store on a partition.
+ *
+ * Recovers from a reset: the block that was being written is sealed with
+ * its complete frames, an interrupted merge is undone or finished.
+ */
+esp_err_t ts_store_open(const ts_store_config_t *config);
+
+/**
+ * @brief Appends a sample, in time order.
+ *
+ * A new block is started when the current one is full, when unix_time
+ * changes or when the time step no longer fits. Samples reach flash
+ * every flush_samples.
+ */
+esp_err_t ts_store_append(int64_t time_ms, bool unix_time, const int32_t *values);
+
+/** @brief Writes the samples kept in RAM as a frame. */
+esp_err_t ts_store_flush(void);
+
+/** @brief Closes the block being written, its samples can then be uploaded. */
+esp_err_t ts_store_seal(void);
+
+/** @brief True if sealed blocks wait for an upload. */
+bool ts_store_pending(void);
+
+/**
+ * @brief Uploads sealed blocks, oldest first, each in chunks of TS_STORE_UPLOAD_SAMPLES.
+ *
+ * A block is marked uploaded once all its chunks were accepted; if a chunk
+ * fails the whole block is sent again next time (at least once delivery,
+ * receivers dedupe by timestamp).
+ *
+ * @param max_blocks Blocks to upload in this call.
+ * @return ESP_OK when nothing is left, ESP_ERR_NOT_FINISHED when blocks remain,
+ *         or the error of the upload callback.
+ */
+esp_err_t ts_store_backfill(int max_blocks, ts_store_upload_t upload, void *ctx);
+
+/**
+ * @brief Erases the blocks older than the retention and merges small ones.
+ *
+ * @param now_ms Current time, Unix ms if unix_time, otherwise uptime ms
+ *        (only blocks of the same kind, and for uptime of this boot, are aged).
+ * @param retention_ms Age of the newest sample of a block after which it is erased.
+ */
+esp_err_t ts_store_compact(int64_t now_ms, bool unix_time, int64_t retention_ms);
+
+void ts_store_get_stats(ts_store_stats_t *stats);
+
+#endif // TS_STORE_H